@@ -38,6 +38,8 @@
 
 #include "audin_main.h"
 
+#define AUDIN_ALSA_OPUS_BITRATE		32000 /* per channel */
+
 typedef struct _AudinALSADevice
 {
 	IAudinDevice iface;
@@ -156,6 +158,17 @@ static BOOL audin_alsa_thread_receive(AudinALSADevice* alsa, BYTE* src, int size
 				DEBUG_DVC("encoded %d to %d",
 					alsa->buffer_frames * tbytes_per_frame, encoded_size);
 			}
+			else if (alsa->wformat == WAVE_FORMAT_OPUS)
+			{
+				alsa->dsp_context->adpcm_size = 0;
+				alsa->dsp_context->encode_opus(alsa->dsp_context,
+					alsa->buffer, alsa->buffer_frames * tbytes_per_frame,
+					alsa->target_channels, alsa->target_rate,
+					alsa->target_channels * AUDIN_ALSA_OPUS_BITRATE);
+
+				encoded_data = alsa->dsp_context->adpcm_buffer;
+				encoded_size = alsa->dsp_context->adpcm_size;
+			}
 			else
 			{
 				encoded_data = alsa->buffer;
@@ -164,6 +177,11 @@ static BOOL audin_alsa_thread_receive(AudinALSADevice* alsa, BYTE* src, int size
 
 			if (WaitForSingleObject(alsa->stopEvent, 0) == WAIT_OBJECT_0)
 				break;
+			else if (encoded_size == 0)
+			{
+				/* the encoder holds less than a packet */
+				ret = TRUE;
+			}
 			else
 			{
 				DEBUG_DVC("encoded %d [%d] to %d [%X]", alsa->buffer_frames,
@@ -200,7 +218,7 @@ static void* audin_alsa_thread_func(void* arg)
 	tbytes_per_frame = alsa->target_channels * alsa->bytes_per_channel;
 	buffer = (BYTE*) malloc(rbytes_per_frame * alsa->frames_per_packet);
 	ZeroMemory(buffer, rbytes_per_frame * alsa->frames_per_packet);
-	freerdp_dsp_context_reset_adpcm(alsa->dsp_context);
+	freerdp_dsp_context_reset(alsa->dsp_context);
 
 	do
 	{
@@ -280,6 +298,16 @@ static BOOL audin_alsa_format_supported(IAudinDevice* device, audinFormat* forma
 				return TRUE;
 			}
 			break;
+
+#ifdef WITH_OPUS
+		case WAVE_FORMAT_OPUS:
+			if (freerdp_dsp_opus_rate_supported(format->nSamplesPerSec) &&
+				(format->nChannels == 1 || format->nChannels == 2))
+			{
+				return TRUE;
+			}
+			break;
+#endif
 	}
 
 	return FALSE;
@@ -320,6 +348,11 @@ static void audin_alsa_set_format(IAudinDevice* device, audinFormat* format, UIN
 			DEBUG_DVC("aligned FramesPerPacket=%d",
 				alsa->frames_per_packet);
 			break;
+
+		case WAVE_FORMAT_OPUS:
+			alsa->format = SND_PCM_FORMAT_S16_LE;
+			alsa->bytes_per_channel = 2;
+			break;
 	}
 
 	alsa->wformat = format->wFormatTag;
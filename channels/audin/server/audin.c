@@ -195,6 +195,7 @@ static void audin_server_send_open(audin_server* audin, wStream* s)
 		return;
 
 	audin->opened = TRUE;
+	freerdp_dsp_context_reset(audin->dsp_context);
 
 	Stream_SetPosition(s, 0);
 	Stream_Write_UINT8(s, MSG_SNDIN_OPEN);
@@ -262,6 +263,16 @@ static BOOL audin_server_recv_data(audin_server* audin, wStream* s, UINT32 lengt
 		sbytes_per_sample = 2;
 		sbytes_per_frame = format->nChannels * 2;
 	}
+	else if (format->wFormatTag == WAVE_FORMAT_OPUS)
+	{
+		if (!audin->dsp_context->decode_opus(audin->dsp_context,
+			Stream_Pointer(s), length, format->nChannels, format->nSamplesPerSec))
+			return FALSE;
+		size = audin->dsp_context->adpcm_size;
+		src = audin->dsp_context->adpcm_buffer;
+		sbytes_per_sample = 2;
+		sbytes_per_frame = format->nChannels * 2;
+	}
 	else
 	{
 		size = length;
@@ -296,6 +296,7 @@ void dvcman_free(IWTSVirtualChannelManager* pChannelMgr)
 	dvcman->num_plugins = 0;
 
 	StreamPool_Free(dvcman->pool);
+	zgfx_context_free(dvcman->zgfx);
 
 	free(dvcman);
 }
@@ -516,6 +517,48 @@ int dvcman_receive_channel_data(IWTSVirtualChannelManager* pChannelMgr, UINT32 C
 	return status;
 }
 
+int dvcman_receive_channel_data_compressed(IWTSVirtualChannelManager* pChannelMgr, UINT32 ChannelId,
+		wStream* data, BOOL first, UINT32 length)
+{
+	int status = 0;
+	wStream* s;
+	DVCMAN* dvcman = (DVCMAN*) pChannelMgr;
+
+	/**
+	 * The server compresses the PDUs of all channels with one RDP8 bulk
+	 * history: decompress before looking the channel up, so that the
+	 * history stays in step even when the data is dropped.
+	 */
+	if (!dvcman->zgfx)
+	{
+		dvcman->zgfx = zgfx_context_new(FALSE);
+
+		if (!dvcman->zgfx)
+			return 1;
+	}
+
+	if (zgfx_decompress_segment(dvcman->zgfx, Stream_Pointer(data), Stream_GetRemainingLength(data)) < 0)
+	{
+		WLog_ERR(TAG, "ChannelId %d decompression failed!", ChannelId);
+		return 1;
+	}
+
+	s = Stream_New(dvcman->zgfx->OutputBuffer, dvcman->zgfx->OutputCount);
+
+	if (!s)
+		return 1;
+
+	if (first)
+		status = dvcman_receive_channel_data_first(pChannelMgr, ChannelId, length);
+
+	if (!status)
+		status = dvcman_receive_channel_data(pChannelMgr, ChannelId, s);
+
+	Stream_Free(s, FALSE);
+
+	return status;
+}
+
 static int drdynvc_write_variable_uint(wStream* s, UINT32 val)
 {
 	int cb;
@@ -686,7 +729,7 @@ static int drdynvc_process_capability_request(drdynvcPlugin* drdynvc, int Sp, in
 	Stream_Read_UINT16(s, drdynvc->version);
 
 	/* RDP8 servers offer version 3, though Microsoft forgot to document it
-	 * in their early documents.  It behaves the same as version 2.
+	 * in their early documents.  It adds the compressed data PDUs to version 2.
 	 */
 	if ((drdynvc->version == 2) || (drdynvc->version == 3))
 	{
@@ -816,6 +859,28 @@ static int drdynvc_process_data(drdynvcPlugin* drdynvc, int Sp, int cbChId, wStr
 	return dvcman_receive_channel_data(drdynvc->channel_mgr, ChannelId, s);
 }
 
+static int drdynvc_process_data_first_compressed(drdynvcPlugin* drdynvc, int Sp, int cbChId, wStream* s)
+{
+	UINT32 Length;
+	UINT32 ChannelId;
+
+	ChannelId = drdynvc_read_variable_uint(s, cbChId);
+	Length = drdynvc_read_variable_uint(s, Sp);
+	WLog_DBG(TAG, "process_data_first_compressed: Sp=%d cbChId=%d, ChannelId=%d Length=%d", Sp, cbChId, ChannelId, Length);
+
+	return dvcman_receive_channel_data_compressed(drdynvc->channel_mgr, ChannelId, s, TRUE, Length);
+}
+
+static int drdynvc_process_data_compressed(drdynvcPlugin* drdynvc, int Sp, int cbChId, wStream* s)
+{
+	UINT32 ChannelId;
+
+	ChannelId = drdynvc_read_variable_uint(s, cbChId);
+	WLog_DBG(TAG, "process_data_compressed: Sp=%d cbChId=%d, ChannelId=%d", Sp, cbChId, ChannelId);
+
+	return dvcman_receive_channel_data_compressed(drdynvc->channel_mgr, ChannelId, s, FALSE, 0);
+}
+
 static int drdynvc_process_close_request(drdynvcPlugin* drdynvc, int Sp, int cbChId, wStream* s)
 {
 	int value;
@@ -886,6 +951,14 @@ static void drdynvc_order_recv(drdynvcPlugin* drdynvc, wStream* s)
 			drdynvc_process_close_request(drdynvc, Sp, cbChId, s);
 			break;
 
+		case DATA_FIRST_COMPRESSED_PDU:
+			drdynvc_process_data_first_compressed(drdynvc, Sp, cbChId, s);
+			break;
+
+		case DATA_COMPRESSED_PDU:
+			drdynvc_process_data_compressed(drdynvc, Sp, cbChId, s);
+			break;
+
 		default:
 			WLog_ERR(TAG, "unknown drdynvc cmd 0x%x", Cmd);
 			break;
@@ -29,6 +29,7 @@
 #include <freerdp/svc.h>
 #include <freerdp/dvc.h>
 #include <freerdp/addin.h>
+#include <freerdp/codec/zgfx.h>
 #include <freerdp/channels/log.h>
 #include <freerdp/client/drdynvc.h>
 
@@ -51,6 +52,9 @@ struct _DVCMAN
 
 	wArrayList* channels;
 	wStreamPool* pool;
+
+	/* one RDP8 bulk history for the compressed PDUs of all channels */
+	ZGFX_CONTEXT* zgfx;
 };
 typedef struct _DVCMAN DVCMAN;
 
@@ -108,6 +112,8 @@ typedef enum _DRDYNVC_STATE DRDYNVC_STATE;
 #define DATA_PDU			0x03
 #define CLOSE_REQUEST_PDU		0x04
 #define CAPABILITY_REQUEST_PDU		0x05
+#define DATA_FIRST_COMPRESSED_PDU	0x06
+#define DATA_COMPRESSED_PDU		0x07
 
 struct drdynvc_plugin
 {
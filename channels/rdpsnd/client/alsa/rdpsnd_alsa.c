@@ -235,6 +235,7 @@ static void rdpsnd_alsa_set_format(rdpsndDevicePlugin* device, AUDIO_FORMAT* for
 
 			case WAVE_FORMAT_ADPCM:
 			case WAVE_FORMAT_DVI_ADPCM:
+			case WAVE_FORMAT_OPUS:
 				alsa->format = SND_PCM_FORMAT_S16_LE;
 				alsa->bytes_per_channel = 2;
 				break;
@@ -312,7 +313,7 @@ static void rdpsnd_alsa_open(rdpsndDevicePlugin* device, AUDIO_FORMAT* format, i
 	}
 	else
 	{
-		freerdp_dsp_context_reset_adpcm(alsa->dsp_context);
+		freerdp_dsp_context_reset(alsa->dsp_context);
 		rdpsnd_alsa_set_format(device, format, latency);
 		rdpsnd_alsa_open_mixer(alsa);
 	}
@@ -393,6 +394,16 @@ static BOOL rdpsnd_alsa_format_supported(rdpsndDevicePlugin* device, AUDIO_FORMA
 
 		case WAVE_FORMAT_GSM610:
 			break;
+
+#ifdef WITH_OPUS
+		case WAVE_FORMAT_OPUS:
+			if (freerdp_dsp_opus_rate_supported(format->nSamplesPerSec) &&
+				(format->nChannels == 1 || format->nChannels == 2))
+			{
+				return TRUE;
+			}
+			break;
+#endif
 	}
 
 	return FALSE;
@@ -490,6 +501,15 @@ static BYTE* rdpsnd_alsa_process_audio_sample(rdpsndDevicePlugin* device, BYTE*
 		*size = alsa->dsp_context->adpcm_size;
 		srcData = alsa->dsp_context->adpcm_buffer;
 	}
+	else if (alsa->wformat == WAVE_FORMAT_OPUS)
+	{
+		alsa->dsp_context->adpcm_size = 0;
+		alsa->dsp_context->decode_opus(alsa->dsp_context,
+			data, *size, alsa->source_channels, alsa->source_rate);
+
+		*size = alsa->dsp_context->adpcm_size;
+		srcData = alsa->dsp_context->adpcm_buffer;
+	}
 	else
 	{
 		srcData = data;
@@ -240,6 +240,7 @@ static void rdpsnd_pulse_set_format_spec(rdpsndPulsePlugin* pulse, AUDIO_FORMAT*
 			break;
 
 		case WAVE_FORMAT_GSM610:
+		case WAVE_FORMAT_OPUS:
 			sample_spec.format = PA_SAMPLE_S16LE;
 			break;
 	}
@@ -419,6 +420,16 @@ static BOOL rdpsnd_pulse_format_supported(rdpsndDevicePlugin* device, AUDIO_FORM
 			}
 			break;
 #endif
+
+#ifdef WITH_OPUS
+		case WAVE_FORMAT_OPUS:
+			if (freerdp_dsp_opus_rate_supported(format->nSamplesPerSec) &&
+				(format->nChannels == 1 || format->nChannels == 2))
+			{
+				return TRUE;
+			}
+			break;
+#endif
 	}
 
 	return FALSE;
@@ -490,6 +501,15 @@ static BYTE* rdpsnd_pulse_convert_audio(rdpsndDevicePlugin* device, BYTE* data,
 		*size = pulse->dsp_context->adpcm_size;
 		pcmData = pulse->dsp_context->adpcm_buffer;
 	}
+	else if (pulse->format == WAVE_FORMAT_OPUS)
+	{
+		pulse->dsp_context->adpcm_size = 0;
+		pulse->dsp_context->decode_opus(pulse->dsp_context,
+			data, *size, pulse->sample_spec.channels, pulse->sample_spec.rate);
+
+		*size = pulse->dsp_context->adpcm_size;
+		pcmData = pulse->dsp_context->adpcm_buffer;
+	}
 #ifdef WITH_GSM
 	else if (pulse->format == WAVE_FORMAT_GSM610)
 	{
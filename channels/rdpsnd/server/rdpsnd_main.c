@@ -258,6 +258,12 @@ static BOOL rdpsnd_server_select_format(RdpsndServerContext* context, int client
 			bs = (format->nBlockAlign - 7 * format->nChannels) * 2 / format->nChannels + 2;
 			context->priv->out_frames = bs * 4;
 			break;
+
+		case WAVE_FORMAT_OPUS:
+			/* 100ms, five packets, at the client rate */
+			context->priv->out_frames = format->nSamplesPerSec / 10;
+			break;
+
 		default:
 			context->priv->out_frames = 0x4000 / context->priv->src_bytes_per_frame;
 			break;
@@ -283,11 +289,11 @@ static BOOL rdpsnd_server_select_format(RdpsndServerContext* context, int client
 		context->priv->out_buffer_size = out_buffer_size;
 	}
 
-	freerdp_dsp_context_reset_adpcm(context->priv->dsp_context);
+	freerdp_dsp_context_reset(context->priv->dsp_context);
 	return TRUE;
 }
 
-static BOOL rdpsnd_server_send_audio_pdu(RdpsndServerContext* context, UINT16 wTimestamp)
+static BOOL rdpsnd_server_send_audio_pdu(RdpsndServerContext* context, UINT16 wTimestamp, BOOL flush)
 {
 	int size;
 	BYTE* src;
@@ -308,6 +314,19 @@ static BOOL rdpsnd_server_send_audio_pdu(RdpsndServerContext* context, UINT16 wT
 		src = context->priv->out_buffer;
 		frames = context->priv->out_pending_frames;
 	}
+	else if (flush)
+	{
+		/* the samples the resampler still holds back at the end of the stream */
+		if (!freerdp_dsp_resample_flush(context->priv->dsp_context))
+			return FALSE;
+
+		frames = context->priv->dsp_context->resampled_frames;
+		src = context->priv->dsp_context->resampled_buffer;
+
+		/* the Opus encoder may still hold back a partial packet */
+		if ((frames < 1) && (format->wFormatTag != WAVE_FORMAT_OPUS))
+			return TRUE;
+	}
 	else
 	{
 		context->priv->dsp_context->resample(context->priv->dsp_context, context->priv->out_buffer,
@@ -333,6 +352,31 @@ static BOOL rdpsnd_server_send_audio_pdu(RdpsndServerContext* context, UINT16 wT
 		src = context->priv->dsp_context->adpcm_buffer;
 		size = context->priv->dsp_context->adpcm_size;
 	}
+	else if (format->wFormatTag == WAVE_FORMAT_OPUS)
+	{
+		if (!context->priv->dsp_context->encode_opus(context->priv->dsp_context,
+			src, size, format->nChannels, format->nSamplesPerSec, format->nAvgBytesPerSec * 8))
+		{
+			status = FALSE;
+			goto out;
+		}
+
+		if (flush && !freerdp_dsp_encode_opus_flush(context->priv->dsp_context))
+		{
+			status = FALSE;
+			goto out;
+		}
+
+		src = context->priv->dsp_context->adpcm_buffer;
+		size = context->priv->dsp_context->adpcm_size;
+	}
+
+	/* The WaveInfo PDU carries the first four bytes */
+	if (size < 4)
+	{
+		status = TRUE;
+		goto out;
+	}
 
 	context->block_no = (context->block_no + 1) % 256;
 
@@ -404,7 +448,7 @@ static BOOL rdpsnd_server_send_samples(RdpsndServerContext* context, const void*
 
 		if (context->priv->out_pending_frames >= context->priv->out_frames)
 		{
-			if (!rdpsnd_server_send_audio_pdu(context, wTimestamp))
+			if (!rdpsnd_server_send_audio_pdu(context, wTimestamp, FALSE))
 				return FALSE;
 		}
 	}
@@ -441,6 +485,7 @@ static BOOL rdpsnd_server_close(RdpsndServerContext* context)
 	int pos;
 	BOOL status;
 	ULONG written;
+	AUDIO_FORMAT* format;
 	wStream* s = context->priv->rdpsnd_pdu;
 
 	if (context->selected_client_format < 0)
@@ -448,7 +493,17 @@ static BOOL rdpsnd_server_close(RdpsndServerContext* context)
 
 	if (context->priv->out_pending_frames > 0)
 	{
-		if (!rdpsnd_server_send_audio_pdu(context, 0))
+		if (!rdpsnd_server_send_audio_pdu(context, 0, FALSE))
+			return FALSE;
+	}
+
+	format = &context->client_formats[context->selected_client_format];
+
+	if ((format->nSamplesPerSec != context->src_format.nSamplesPerSec) ||
+			(format->nChannels != context->src_format.nChannels) ||
+			(format->wFormatTag == WAVE_FORMAT_OPUS))
+	{
+		if (!rdpsnd_server_send_audio_pdu(context, 0, TRUE))
 			return FALSE;
 	}
 
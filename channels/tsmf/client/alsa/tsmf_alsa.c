@@ -89,6 +89,7 @@ static BOOL tsmf_alsa_set_format(ITSMFAudioDevice *audio,
 	if(!alsa->out_handle)
 		return FALSE;
 	snd_pcm_drop(alsa->out_handle);
+	freerdp_dsp_context_reset(alsa->dsp_context);
 	alsa->actual_rate = alsa->source_rate = sample_rate;
 	alsa->actual_channels = alsa->source_channels = channels;
 	alsa->bytes_per_sample = bits_per_sample / 8;
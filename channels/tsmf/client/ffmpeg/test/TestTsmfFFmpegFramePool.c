@@ -0,0 +1,325 @@
+#include <winpr/crt.h>
+#include <winpr/sysinfo.h>
+
+#include <libavcodec/avcodec.h>
+
+#include "tsmf_constants.h"
+#include "tsmf_decoder.h"
+
+#ifdef STATIC_CHANNELS
+#define tsmf_ffmpeg_decoder_entry	ffmpeg_freerdp_tsmf_client_decoder_subsystem_entry
+#else
+#define tsmf_ffmpeg_decoder_entry	freerdp_tsmf_client_subsystem_entry
+#endif
+
+ITSMFDecoder* tsmf_ffmpeg_decoder_entry(void);
+void tsmf_ffmpeg_get_statistics(ITSMFDecoder* decoder, UINT32* frames, UINT32* allocations, UINT32* copies);
+
+#define TEST_FRAME_WIDTH	1280
+#define TEST_FRAME_HEIGHT	720
+#define TEST_FRAME_COUNT	120
+
+/* frames the presentation queue holds on to before releasing them */
+#define TEST_FRAMES_IN_FLIGHT	2
+
+typedef struct
+{
+	UINT32 size;
+	BYTE* data;
+} TEST_SAMPLE;
+
+/* the encoder and the frame pool both need the refcounted frame API */
+#if LIBAVCODEC_VERSION_MAJOR >= 55
+
+static void test_fill_frame(AVFrame* frame, int index)
+{
+	int x, y;
+
+	for (y = 0; y < frame->height; y++)
+	{
+		for (x = 0; x < frame->width; x++)
+			frame->data[0][y * frame->linesize[0] + x] = (BYTE) (x + y + index * 3);
+	}
+
+	for (y = 0; y < frame->height / 2; y++)
+	{
+		for (x = 0; x < frame->width / 2; x++)
+		{
+			frame->data[1][y * frame->linesize[1] + x] = (BYTE) (128 + y + index * 2);
+			frame->data[2][y * frame->linesize[2] + x] = (BYTE) (64 + x + index * 5);
+		}
+	}
+}
+
+static BOOL test_append_packet(TEST_SAMPLE* samples, int* count, AVPacket* pkt)
+{
+	TEST_SAMPLE* sample;
+
+	if (*count >= TEST_FRAME_COUNT)
+		return TRUE;
+
+	sample = &samples[*count];
+	sample->data = (BYTE*) malloc(pkt->size + FF_INPUT_BUFFER_PADDING_SIZE);
+
+	if (!sample->data)
+		return FALSE;
+
+	CopyMemory(sample->data, pkt->data, pkt->size);
+	ZeroMemory(&sample->data[pkt->size], FF_INPUT_BUFFER_PADDING_SIZE);
+	sample->size = pkt->size;
+	(*count)++;
+
+	return TRUE;
+}
+
+/**
+ * Encodes a synthetic elementary stream with the local libavcodec, using
+ * the H.264 encoder when one is built in and MPEG-2 video otherwise.
+ */
+
+static int test_encode_stream(TEST_SAMPLE* samples, UINT32* subType)
+{
+	int index;
+	int count = 0;
+	int gotPacket;
+	AVPacket pkt;
+	AVCodec* codec;
+	AVFrame* frame = NULL;
+	AVCodecContext* context = NULL;
+
+	*subType = TSMF_SUB_TYPE_H264;
+	codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+
+	if (!codec)
+	{
+		*subType = TSMF_SUB_TYPE_MP2V;
+		codec = avcodec_find_encoder(AV_CODEC_ID_MPEG2VIDEO);
+	}
+
+	if (!codec)
+		return 0;
+
+	context = avcodec_alloc_context3(codec);
+
+	if (!context)
+		return -1;
+
+	context->width = TEST_FRAME_WIDTH;
+	context->height = TEST_FRAME_HEIGHT;
+	context->pix_fmt = PIX_FMT_YUV420P;
+	context->time_base.num = 1;
+	context->time_base.den = 30;
+	context->gop_size = 30;
+	context->max_b_frames = 0;
+	context->bit_rate = 4000000;
+
+	if (avcodec_open2(context, codec, NULL) < 0)
+		goto fail;
+
+	frame = av_frame_alloc();
+
+	if (!frame)
+		goto fail;
+
+	frame->format = context->pix_fmt;
+	frame->width = context->width;
+	frame->height = context->height;
+
+	if (av_frame_get_buffer(frame, 32) < 0)
+		goto fail;
+
+	for (index = 0; index <= TEST_FRAME_COUNT; index++)
+	{
+		AVFrame* input = NULL;
+
+		if (index < TEST_FRAME_COUNT)
+		{
+			if (av_frame_make_writable(frame) < 0)
+				goto fail;
+
+			test_fill_frame(frame, index);
+			frame->pts = index;
+			input = frame;
+		}
+
+		do
+		{
+			av_init_packet(&pkt);
+			pkt.data = NULL;
+			pkt.size = 0;
+
+			if (avcodec_encode_video2(context, &pkt, input, &gotPacket) < 0)
+				goto fail;
+
+			if (gotPacket)
+			{
+				BOOL status = test_append_packet(samples, &count, &pkt);
+
+				av_free_packet(&pkt);
+
+				if (!status)
+					goto fail;
+			}
+		}
+		while (!input && gotPacket && (count < TEST_FRAME_COUNT));
+	}
+
+	av_frame_free(&frame);
+	avcodec_close(context);
+	av_free(context);
+
+	return count;
+
+fail:
+	av_frame_free(&frame);
+	avcodec_close(context);
+	av_free(context);
+
+	return -1;
+}
+
+static int test_decode_stream(TEST_SAMPLE* samples, int count, UINT32 subType)
+{
+	int index;
+	int inflight = 0;
+	UINT32 size;
+	UINT32 width;
+	UINT32 height;
+	UINT32 frames;
+	UINT32 copies;
+	UINT32 allocations;
+	UINT32 checksum = 0;
+	UINT32 start, elapsed;
+	BYTE* data;
+	BYTE* pending[TEST_FRAMES_IN_FLIGHT] = { NULL };
+	BYTE* planes[3];
+	UINT32 strides[3];
+	TS_AM_MEDIA_TYPE mediaType;
+	ITSMFDecoder* decoder;
+
+	decoder = tsmf_ffmpeg_decoder_entry();
+
+	if (!decoder)
+		return -1;
+
+	ZeroMemory(&mediaType, sizeof(TS_AM_MEDIA_TYPE));
+	mediaType.MajorType = TSMF_MAJOR_TYPE_VIDEO;
+	mediaType.SubType = subType;
+	mediaType.FormatType = TSMF_FORMAT_TYPE_MFVIDEOFORMAT;
+	mediaType.Width = TEST_FRAME_WIDTH;
+	mediaType.Height = TEST_FRAME_HEIGHT;
+
+	if (!decoder->SetFormat(decoder, &mediaType))
+	{
+		decoder->Free(decoder);
+		return -1;
+	}
+
+	start = GetTickCount();
+
+	for (index = 0; index < count; index++)
+	{
+		if (!decoder->Decode(decoder, samples[index].data, samples[index].size,
+				(index == 0) ? TSMM_SAMPLE_EXT_CLEANPOINT : 0))
+			continue;
+
+		data = decoder->GetDecodedData(decoder, &size);
+
+		if (!data)
+			continue;
+
+		if (!decoder->GetDecodedDimension(decoder, &width, &height) ||
+				(width != TEST_FRAME_WIDTH) || (height != TEST_FRAME_HEIGHT))
+		{
+			printf("unexpected frame dimension %dx%d\n", width, height);
+			decoder->ReleaseDecodedData(decoder, data);
+			break;
+		}
+
+		/* touch the frame the way the presentation sink would */
+		if (decoder->GetDecodedPlanes(decoder, data, planes, strides))
+			checksum += planes[0][0] + planes[1][0] + planes[2][0];
+		else
+			checksum += data[0];
+
+		if (pending[inflight])
+			decoder->ReleaseDecodedData(decoder, pending[inflight]);
+
+		pending[inflight] = data;
+		inflight = (inflight + 1) % TEST_FRAMES_IN_FLIGHT;
+	}
+
+	elapsed = GetTickCount() - start;
+
+	for (index = 0; index < TEST_FRAMES_IN_FLIGHT; index++)
+	{
+		if (pending[index])
+			decoder->ReleaseDecodedData(decoder, pending[index]);
+	}
+
+	tsmf_ffmpeg_get_statistics(decoder, &frames, &allocations, &copies);
+	decoder->Free(decoder);
+
+	printf("%s %dx%d: %d samples, %d frames in %d ms (checksum 0x%08X)\n",
+		(subType == TSMF_SUB_TYPE_H264) ? "H.264" : "MPEG-2",
+		TEST_FRAME_WIDTH, TEST_FRAME_HEIGHT, count, frames, elapsed, checksum);
+
+	if (!frames)
+		return -1;
+
+	printf("allocations: %d (%.3f per frame) copies: %d (%.3f per frame)\n",
+		allocations, ((double) allocations) / frames, copies, ((double) copies) / frames);
+
+	/* with the frame pool, decoded frames are passed by reference */
+	if (copies || (allocations >= frames))
+		return -1;
+
+	return 0;
+}
+
+#endif
+
+int TestTsmfFFmpegFramePool(int argc, char* argv[])
+{
+#if LIBAVCODEC_VERSION_MAJOR >= 55
+	int index;
+	int count;
+	int status;
+	UINT32 subType;
+	TEST_SAMPLE* samples;
+
+	avcodec_register_all();
+
+	samples = (TEST_SAMPLE*) calloc(TEST_FRAME_COUNT, sizeof(TEST_SAMPLE));
+
+	if (!samples)
+		return -1;
+
+	count = test_encode_stream(samples, &subType);
+
+	if (count < 0)
+	{
+		printf("failed to encode test stream\n");
+		status = -1;
+	}
+	else if (count == 0)
+	{
+		printf("no H.264 or MPEG-2 encoder available, skipping\n");
+		status = 0;
+	}
+	else
+	{
+		status = test_decode_stream(samples, count, subType);
+	}
+
+	for (index = 0; index < TEST_FRAME_COUNT; index++)
+		free(samples[index].data);
+
+	free(samples);
+
+	return status;
+#else
+	printf("libavcodec %d has no refcounted frames, skipping\n", LIBAVCODEC_VERSION_MAJOR);
+	return 0;
+#endif
+}
@@ -26,6 +26,8 @@
 #include <string.h>
 
 #include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/interlocked.h>
 
 #include <freerdp/channels/log.h>
 #include <freerdp/client/tsmf.h>
@@ -61,6 +63,41 @@
 #define AV_CODEC_ID_AC3 CODEC_ID_AC3
 #endif
 
+/**
+ * Decoded video frames are allocated from a frame pool through the
+ * get_buffer2 callback, and handed to the presentation sink by reference
+ * instead of being copied into a packed buffer. This needs refcounted
+ * frames, available since libavcodec 55.
+ */
+#if LIBAVCODEC_VERSION_MAJOR >= 55
+#define TSMF_FFMPEG_FRAME_POOL
+#endif
+
+#define TSMF_FFMPEG_MAX_OUTPUT_FRAMES	4
+
+typedef struct _TSMF_FRAME_POOL TSMF_FRAME_POOL;
+typedef struct _TSMF_FRAME_BUFFER TSMF_FRAME_BUFFER;
+
+struct _TSMF_FRAME_BUFFER
+{
+	TSMF_FRAME_POOL* pool;
+	TSMF_FRAME_BUFFER* next;
+	size_t size;
+	BYTE* data;
+};
+
+struct _TSMF_FRAME_POOL
+{
+	CRITICAL_SECTION lock;
+	LONG refCount;
+	size_t size;
+	TSMF_FRAME_BUFFER* freeList;
+
+	/* statistics, reported by the decoder benchmark */
+	UINT32 allocations;
+	UINT32 reuses;
+};
+
 
 typedef struct _TSMFFFmpegDecoder
 {
@@ -80,8 +117,260 @@ typedef struct _TSMFFFmpegDecoder
 	BYTE *decoded_data;
 	UINT32 decoded_size;
 	UINT32 decoded_size_max;
+
+	TSMF_FRAME_POOL *pool;
+	AVFrame *output_frames[TSMF_FFMPEG_MAX_OUTPUT_FRAMES];
+	UINT32 frame_count;
+	UINT32 copy_count;
 } TSMFFFmpegDecoder;
 
+#ifdef TSMF_FFMPEG_FRAME_POOL
+static TSMF_FRAME_POOL* tsmf_frame_pool_new(void)
+{
+	TSMF_FRAME_POOL* pool;
+
+	pool = (TSMF_FRAME_POOL*) calloc(1, sizeof(TSMF_FRAME_POOL));
+
+	if (!pool)
+		return NULL;
+
+	if (!InitializeCriticalSectionAndSpinCount(&pool->lock, 4000))
+	{
+		free(pool);
+		return NULL;
+	}
+
+	pool->refCount = 1;
+
+	return pool;
+}
+
+static void tsmf_frame_buffer_free(TSMF_FRAME_BUFFER* buffer)
+{
+	_aligned_free(buffer->data);
+	free(buffer);
+}
+
+static void tsmf_frame_pool_unref(TSMF_FRAME_POOL* pool)
+{
+	TSMF_FRAME_BUFFER* buffer;
+
+	if (InterlockedDecrement(&pool->refCount) > 0)
+		return;
+
+	while (pool->freeList)
+	{
+		buffer = pool->freeList;
+		pool->freeList = buffer->next;
+		tsmf_frame_buffer_free(buffer);
+	}
+
+	DeleteCriticalSection(&pool->lock);
+	free(pool);
+}
+
+/**
+ * Takes a buffer of the given size from the pool. All buffers of a pool
+ * have the same size, the free list is dropped when the size changes.
+ */
+
+static TSMF_FRAME_BUFFER* tsmf_frame_pool_take(TSMF_FRAME_POOL* pool, size_t size)
+{
+	TSMF_FRAME_BUFFER* buffer = NULL;
+	TSMF_FRAME_BUFFER* stale = NULL;
+
+	EnterCriticalSection(&pool->lock);
+
+	if (pool->size != size)
+	{
+		stale = pool->freeList;
+		pool->freeList = NULL;
+		pool->size = size;
+	}
+
+	if (pool->freeList)
+	{
+		buffer = pool->freeList;
+		pool->freeList = buffer->next;
+		pool->reuses++;
+	}
+	else
+	{
+		pool->allocations++;
+	}
+
+	LeaveCriticalSection(&pool->lock);
+
+	while (stale)
+	{
+		TSMF_FRAME_BUFFER* next = stale->next;
+		tsmf_frame_buffer_free(stale);
+		stale = next;
+	}
+
+	if (!buffer)
+	{
+		buffer = (TSMF_FRAME_BUFFER*) calloc(1, sizeof(TSMF_FRAME_BUFFER));
+
+		if (!buffer)
+			return NULL;
+
+		buffer->data = (BYTE*) _aligned_malloc(size, 64);
+
+		if (!buffer->data)
+		{
+			free(buffer);
+			return NULL;
+		}
+
+		buffer->size = size;
+	}
+
+	buffer->pool = pool;
+	InterlockedIncrement(&pool->refCount);
+
+	return buffer;
+}
+
+static void tsmf_frame_pool_return(TSMF_FRAME_BUFFER* buffer)
+{
+	TSMF_FRAME_POOL* pool = buffer->pool;
+
+	EnterCriticalSection(&pool->lock);
+
+	if (buffer->size == pool->size)
+	{
+		buffer->next = pool->freeList;
+		pool->freeList = buffer;
+		buffer = NULL;
+	}
+
+	LeaveCriticalSection(&pool->lock);
+
+	if (buffer)
+		tsmf_frame_buffer_free(buffer);
+
+	tsmf_frame_pool_unref(pool);
+}
+
+static void tsmf_ffmpeg_release_buffer(void* opaque, uint8_t* data)
+{
+	tsmf_frame_pool_return((TSMF_FRAME_BUFFER*) opaque);
+}
+
+/**
+ * get_buffer2 callback: lays the YUV420P planes out in a pooled buffer, with
+ * strides and plane heights aligned as required by the codec. Other pixel
+ * formats use the default allocator.
+ */
+
+static int tsmf_ffmpeg_get_buffer2(AVCodecContext* context, AVFrame* frame, int flags)
+{
+	int index;
+	int width;
+	int height;
+	size_t size;
+	int linesize[3];
+	int linesize_align[AV_NUM_DATA_POINTERS];
+	TSMF_FRAME_BUFFER* buffer;
+	TSMFFFmpegDecoder* mdecoder = (TSMFFFmpegDecoder*) context->opaque;
+
+	if ((frame->format != PIX_FMT_YUV420P) || !mdecoder || !mdecoder->pool ||
+			!(context->codec->capabilities & CODEC_CAP_DR1))
+		return avcodec_default_get_buffer2(context, frame, flags);
+
+	width = frame->width;
+	height = frame->height;
+	avcodec_align_dimensions2(context, &width, &height, linesize_align);
+
+	linesize[0] = FFALIGN(width, 64);
+	linesize[1] = linesize[2] = linesize[0] / 2;
+
+	for (index = 0; index < 3; index++)
+	{
+		if (linesize_align[index] && (linesize[index] % linesize_align[index]))
+			return avcodec_default_get_buffer2(context, frame, flags);
+	}
+
+	height = FFALIGN(height, 2);
+	size = linesize[0] * height + linesize[1] * (height / 2) * 2 + 64;
+
+	buffer = tsmf_frame_pool_take(mdecoder->pool, size);
+
+	if (!buffer)
+		return AVERROR(ENOMEM);
+
+	frame->buf[0] = av_buffer_create(buffer->data, size, tsmf_ffmpeg_release_buffer, buffer, 0);
+
+	if (!frame->buf[0])
+	{
+		tsmf_frame_pool_return(buffer);
+		return AVERROR(ENOMEM);
+	}
+
+	frame->data[0] = buffer->data;
+	frame->data[1] = frame->data[0] + linesize[0] * height;
+	frame->data[2] = frame->data[1] + linesize[1] * (height / 2);
+
+	for (index = 0; index < 3; index++)
+		frame->linesize[index] = linesize[index];
+
+	frame->extended_data = frame->data;
+
+	return 0;
+}
+
+/**
+ * Keeps a reference on the decoded frame and exposes it as decoded data,
+ * so that no copy is made. Returns FALSE when all output slots are in use.
+ */
+
+static BOOL tsmf_ffmpeg_output_frame(TSMFFFmpegDecoder* mdecoder)
+{
+	int index;
+	AVFrame* frame;
+
+	for (index = 0; index < TSMF_FFMPEG_MAX_OUTPUT_FRAMES; index++)
+	{
+		if (!mdecoder->output_frames[index])
+			break;
+	}
+
+	if (index >= TSMF_FFMPEG_MAX_OUTPUT_FRAMES)
+		return FALSE;
+
+	frame = av_frame_alloc();
+
+	if (!frame)
+		return FALSE;
+
+	av_frame_move_ref(frame, mdecoder->frame);
+	mdecoder->output_frames[index] = frame;
+
+	mdecoder->decoded_data = frame->data[0];
+	mdecoder->decoded_size = avpicture_get_size(mdecoder->codec_context->pix_fmt,
+			mdecoder->codec_context->width, mdecoder->codec_context->height);
+
+	return TRUE;
+}
+#endif
+
+static int tsmf_ffmpeg_find_output_frame(TSMFFFmpegDecoder* mdecoder, BYTE* data)
+{
+	int index;
+
+	if (!data)
+		return -1;
+
+	for (index = 0; index < TSMF_FFMPEG_MAX_OUTPUT_FRAMES; index++)
+	{
+		if (mdecoder->output_frames[index] && (mdecoder->output_frames[index]->data[0] == data))
+			return index;
+	}
+
+	return -1;
+}
+
 static BOOL tsmf_ffmpeg_init_context(ITSMFDecoder* decoder)
 {
 	TSMFFFmpegDecoder* mdecoder = (TSMFFFmpegDecoder*) decoder;
@@ -103,6 +392,18 @@ static BOOL tsmf_ffmpeg_init_video_stream(ITSMFDecoder* decoder, const TS_AM_MED
 	mdecoder->codec_context->time_base.den = media_type->SamplesPerSecond.Numerator;
 	mdecoder->codec_context->time_base.num = media_type->SamplesPerSecond.Denominator;
 	mdecoder->frame = avcodec_alloc_frame();
+#ifdef TSMF_FFMPEG_FRAME_POOL
+	mdecoder->pool = tsmf_frame_pool_new();
+	if (mdecoder->pool)
+	{
+		mdecoder->codec_context->opaque = mdecoder;
+		mdecoder->codec_context->get_buffer2 = tsmf_ffmpeg_get_buffer2;
+		mdecoder->codec_context->refcounted_frames = 1;
+#ifdef CODEC_FLAG_EMU_EDGE
+		mdecoder->codec_context->flags |= CODEC_FLAG_EMU_EDGE;
+#endif
+	}
+#endif
 	return TRUE;
 }
 
@@ -316,6 +617,13 @@ static BOOL tsmf_ffmpeg_decode_video(ITSMFDecoder* decoder, const BYTE *data, UI
 				   mdecoder->frame->linesize[2], mdecoder->frame->linesize[3],
 				   mdecoder->codec_context->pix_fmt,
 				   mdecoder->codec_context->width, mdecoder->codec_context->height);
+		mdecoder->frame_count++;
+#ifdef TSMF_FFMPEG_FRAME_POOL
+		if ((mdecoder->codec_context->pix_fmt == PIX_FMT_YUV420P) && mdecoder->frame->buf[0] &&
+				tsmf_ffmpeg_output_frame(mdecoder))
+			return TRUE;
+#endif
+		mdecoder->copy_count++;
 		mdecoder->decoded_size = avpicture_get_size(mdecoder->codec_context->pix_fmt,
 								 mdecoder->codec_context->width, mdecoder->codec_context->height);
 		mdecoder->decoded_data = malloc(mdecoder->decoded_size);
@@ -330,6 +638,11 @@ static BOOL tsmf_ffmpeg_decode_video(ITSMFDecoder* decoder, const BYTE *data, UI
 		av_free(frame);
 	}
 
+#ifdef TSMF_FFMPEG_FRAME_POOL
+	if (mdecoder->codec_context->refcounted_frames)
+		av_frame_unref(mdecoder->frame);
+#endif
+
 	return ret;
 }
 
@@ -431,12 +744,52 @@ static BOOL tsmf_ffmpeg_decode_audio(ITSMFDecoder* decoder, const BYTE *data, UI
 	return TRUE;
 }
 
+static void tsmf_ffmpeg_release_decoded_data(ITSMFDecoder* decoder, BYTE *data)
+{
+	int index;
+	TSMFFFmpegDecoder* mdecoder = (TSMFFFmpegDecoder*) decoder;
+
+	index = tsmf_ffmpeg_find_output_frame(mdecoder, data);
+
+	if (index < 0)
+	{
+		free(data);
+		return;
+	}
+
+#ifdef TSMF_FFMPEG_FRAME_POOL
+	av_frame_free(&mdecoder->output_frames[index]);
+#endif
+}
+
+static BOOL tsmf_ffmpeg_get_decoded_planes(ITSMFDecoder* decoder, BYTE *data, BYTE *planes[3], UINT32 strides[3])
+{
+	int index;
+	AVFrame *frame;
+	TSMFFFmpegDecoder* mdecoder = (TSMFFFmpegDecoder*) decoder;
+
+	index = tsmf_ffmpeg_find_output_frame(mdecoder, data);
+
+	if (index < 0)
+		return FALSE;
+
+	frame = mdecoder->output_frames[index];
+
+	for (index = 0; index < 3; index++)
+	{
+		planes[index] = frame->data[index];
+		strides[index] = frame->linesize[index];
+	}
+
+	return TRUE;
+}
+
 static BOOL tsmf_ffmpeg_decode(ITSMFDecoder* decoder, const BYTE *data, UINT32 data_size, UINT32 extensions)
 {
 	TSMFFFmpegDecoder* mdecoder = (TSMFFFmpegDecoder*) decoder;
 	if (mdecoder->decoded_data)
 	{
-		free(mdecoder->decoded_data);
+		tsmf_ffmpeg_release_decoded_data(decoder, mdecoder->decoded_data);
 		mdecoder->decoded_data = NULL;
 	}
 	mdecoder->decoded_size = 0;
@@ -494,13 +847,47 @@ static BOOL tsmf_ffmpeg_get_decoded_dimension(ITSMFDecoder* decoder, UINT32 *wid
 	}
 }
 
+/**
+ * Reports the number of decoded video frames, and how many of them needed
+ * a frame buffer allocation or a copy. Used by the decoder benchmark.
+ */
+
+void tsmf_ffmpeg_get_statistics(ITSMFDecoder* decoder, UINT32* frames, UINT32* allocations, UINT32* copies)
+{
+	TSMFFFmpegDecoder* mdecoder = (TSMFFFmpegDecoder*) decoder;
+
+	*frames = mdecoder->frame_count;
+	*copies = mdecoder->copy_count;
+
+	/* every copied frame was also copied into a freshly allocated buffer */
+	*allocations = mdecoder->copy_count;
+
+	if (mdecoder->pool)
+		*allocations += mdecoder->pool->allocations;
+}
+
 static void tsmf_ffmpeg_free(ITSMFDecoder* decoder)
 {
+#ifdef TSMF_FFMPEG_FRAME_POOL
+	int index;
+#endif
 	TSMFFFmpegDecoder* mdecoder = (TSMFFFmpegDecoder*) decoder;
+
+	tsmf_ffmpeg_release_decoded_data(decoder, mdecoder->decoded_data);
+
+#ifdef TSMF_FFMPEG_FRAME_POOL
+	for (index = 0; index < TSMF_FFMPEG_MAX_OUTPUT_FRAMES; index++)
+	{
+		if (mdecoder->output_frames[index])
+			av_frame_free(&mdecoder->output_frames[index]);
+	}
+
 	if (mdecoder->frame)
-		av_free(mdecoder->frame);
+		av_frame_unref(mdecoder->frame);
+#endif
 
-	free(mdecoder->decoded_data);
+	if (mdecoder->frame)
+		av_free(mdecoder->frame);
 
 	if (mdecoder->codec_context)
 	{
@@ -510,6 +897,13 @@ static void tsmf_ffmpeg_free(ITSMFDecoder* decoder)
 		free(mdecoder->codec_context->extradata);
 		av_free(mdecoder->codec_context);
 	}
+
+#ifdef TSMF_FFMPEG_FRAME_POOL
+	/* buffers still referenced by the codec were returned by avcodec_close */
+	if (mdecoder->pool)
+		tsmf_frame_pool_unref(mdecoder->pool);
+#endif
+
 	free(decoder);
 }
 
@@ -542,6 +936,8 @@ ITSMFDecoder* freerdp_tsmf_client_subsystem_entry(void)
 	decoder->iface.GetDecodedFormat = tsmf_ffmpeg_get_decoded_format;
 	decoder->iface.GetDecodedDimension = tsmf_ffmpeg_get_decoded_dimension;
 	decoder->iface.Free = tsmf_ffmpeg_free;
+	decoder->iface.GetDecodedPlanes = tsmf_ffmpeg_get_decoded_planes;
+	decoder->iface.ReleaseDecodedData = tsmf_ffmpeg_release_decoded_data;
 
 	return (ITSMFDecoder*) decoder;
 }
@@ -63,6 +63,10 @@ struct _ITSMFDecoder
 	BOOL (*SetAckFunc)(ITSMFDecoder *decoder, BOOL (*cb)(void *,BOOL), void *stream);
 	/* Register a callback for stream seek detection. */
 	BOOL (*SetSyncFunc)(ITSMFDecoder *decoder, void (*cb)(void *), void *stream);
+	/* Get the planes of a decoded video frame which is not tightly packed (optional) */
+	BOOL (*GetDecodedPlanes)(ITSMFDecoder *decoder, BYTE *data, BYTE *planes[3], UINT32 strides[3]);
+	/* Release data returned by GetDecodedData, free() is used when not set (optional) */
+	void (*ReleaseDecodedData)(ITSMFDecoder *decoder, BYTE *data);
 };
 
 #define TSMF_DECODER_EXPORT_FUNC_NAME "TSMFDecoderEntry"
@@ -382,6 +382,13 @@ static void tsmf_sample_playback_video(TSMF_SAMPLE* sample)
 		event.frameWidth = sample->stream->width;
 		event.frameHeight = sample->stream->height;
 
+		if (stream->decoder->GetDecodedPlanes)
+		{
+			if (!stream->decoder->GetDecodedPlanes(stream->decoder, sample->data,
+					event.framePlanes, event.frameStrides))
+				event.framePlanes[0] = NULL;
+		}
+
 #if 0
 		/* Dump a .ppm image for every 30 frames. Assuming the frame is in YUV format, we
 		   extract the Y values to create a grayscale image. */
@@ -412,7 +419,10 @@ static void tsmf_sample_playback_video(TSMF_SAMPLE* sample)
 		if (tsmf->FrameEvent)
 			tsmf->FrameEvent(tsmf, &event);
 
-		free(event.frameData);
+		if (stream->decoder->ReleaseDecodedData)
+			stream->decoder->ReleaseDecodedData(stream->decoder, event.frameData);
+		else
+			free(event.frameData);
 	}
 }
 
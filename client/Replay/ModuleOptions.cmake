@@ -0,0 +1,4 @@
+
+set(FREERDP_CLIENT_NAME "freerdp-replay")
+set(FREERDP_CLIENT_PLATFORM "Replay")
+set(FREERDP_CLIENT_VENDOR "FreeRDP")
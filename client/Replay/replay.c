@@ -0,0 +1,537 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Headless Session Replay
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/constants.h>
+#include <freerdp/event.h>
+#include <freerdp/gdi/gdi.h>
+#include <freerdp/gdi/gfx.h>
+#include <freerdp/client/cmdline.h>
+#include <freerdp/client/rdpgfx.h>
+#include <freerdp/channels/channels.h>
+#include <freerdp/utils/stopwatch.h>
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+#include <winpr/interlocked.h>
+#include <freerdp/log.h>
+
+#include "allocations.h"
+
+#define TAG CLIENT_TAG("replay")
+
+/**
+ * Replays a session recorded with /record-session through the regular client
+ * update pipeline into a gdi primary surface, as fast as possible, and reports
+ * the frame rate along with the time and allocations spent in each codec.
+ *
+ * freerdp-replay /play-session:<file> [/gfx] [/rfx] ...
+ *
+ * The channel options must match the ones of the recording session, so that
+ * the same static and dynamic channels are there to receive the recorded data.
+ */
+
+/**
+ * Allocations are counted per thread for the codecs, so that codecs running
+ * on the dynamic channel thread are not charged for the allocations of the
+ * thread feeding the replay, and for all threads for the whole session.
+ */
+
+enum REPLAY_CODEC
+{
+	REPLAY_CODEC_REMOTEFX,
+	REPLAY_CODEC_NSCODEC,
+	REPLAY_CODEC_UNCOMPRESSED,
+	REPLAY_CODEC_INTERLEAVED,
+	REPLAY_CODEC_PLANAR,
+	REPLAY_CODEC_BITMAP,
+	REPLAY_CODEC_GFX_UNCOMPRESSED,
+	REPLAY_CODEC_GFX_REMOTEFX,
+	REPLAY_CODEC_GFX_CLEARCODEC,
+	REPLAY_CODEC_GFX_PLANAR,
+	REPLAY_CODEC_GFX_H264,
+	REPLAY_CODEC_GFX_ALPHA,
+	REPLAY_CODEC_GFX_PROGRESSIVE,
+	REPLAY_CODEC_COUNT
+};
+
+static const char* replay_codec_names[REPLAY_CODEC_COUNT] =
+{
+	"remotefx",
+	"nscodec",
+	"uncompressed",
+	"interleaved",
+	"planar",
+	"bitmap",
+	"gfx-uncompressed",
+	"gfx-remotefx",
+	"gfx-clearcodec",
+	"gfx-planar",
+	"gfx-h264",
+	"gfx-alpha",
+	"gfx-progressive"
+};
+
+struct replay_codec
+{
+	STOPWATCH* stopwatch;
+	UINT64 allocations;
+	UINT64 allocatedBytes;
+	UINT64 startAllocations;
+	UINT64 startAllocatedBytes;
+};
+typedef struct replay_codec replayCodec;
+
+struct replay_context
+{
+	rdpContext _p;
+
+	pBitmapUpdate BitmapUpdate;
+	pSurfaceBits SurfaceBits;
+	pcRdpgfxSurfaceCommand SurfaceCommand;
+	pcRdpgfxEndFrame EndFrame;
+
+	UINT32 paints;
+	volatile LONG gfxFrames;
+	volatile LONG gfxCommands;
+	UINT64 startTime;
+	UINT64 lastGfxTime;
+	UINT64 startAllocations;
+	UINT64 startAllocatedBytes;
+	replayCodec codecs[REPLAY_CODEC_COUNT];
+};
+typedef struct replay_context replayContext;
+
+static void replay_codec_start(replayCodec* codec)
+{
+#ifdef FREERDP_COUNT_ALLOCATIONS
+	freerdp_allocations_get_thread(&codec->startAllocations, &codec->startAllocatedBytes);
+#endif
+	stopwatch_start(codec->stopwatch);
+}
+
+static void replay_codec_stop(replayCodec* codec)
+{
+	stopwatch_stop(codec->stopwatch);
+#ifdef FREERDP_COUNT_ALLOCATIONS
+	{
+		UINT64 allocations;
+		UINT64 allocatedBytes;
+
+		freerdp_allocations_get_thread(&allocations, &allocatedBytes);
+		codec->allocations += allocations - codec->startAllocations;
+		codec->allocatedBytes += allocatedBytes - codec->startAllocatedBytes;
+	}
+#endif
+}
+
+static BOOL replay_context_new(freerdp* instance, rdpContext* context)
+{
+	int index;
+	replayContext* replay = (replayContext*) context;
+
+	for (index = 0; index < REPLAY_CODEC_COUNT; index++)
+	{
+		if (!(replay->codecs[index].stopwatch = stopwatch_create()))
+			return FALSE;
+	}
+
+	if (!(context->channels = freerdp_channels_new()))
+		return FALSE;
+
+	return TRUE;
+}
+
+static void replay_context_free(freerdp* instance, rdpContext* context)
+{
+	int index;
+	replayContext* replay = (replayContext*) context;
+
+	if (context && context->channels)
+	{
+		freerdp_channels_close(context->channels, instance);
+		freerdp_channels_free(context->channels);
+		context->channels = NULL;
+	}
+
+	for (index = 0; index < REPLAY_CODEC_COUNT; index++)
+	{
+		stopwatch_free(replay->codecs[index].stopwatch);
+		replay->codecs[index].stopwatch = NULL;
+	}
+}
+
+static BOOL replay_begin_paint(rdpContext* context)
+{
+	rdpGdi* gdi = context->gdi;
+	gdi->primary->hdc->hwnd->invalid->null = 1;
+	return TRUE;
+}
+
+static BOOL replay_end_paint(rdpContext* context)
+{
+	replayContext* replay = (replayContext*) context;
+	rdpGdi* gdi = context->gdi;
+
+	if (!gdi->primary->hdc->hwnd->invalid->null)
+		replay->paints++;
+
+	return TRUE;
+}
+
+static BOOL replay_bitmap_update(rdpContext* context, BITMAP_UPDATE* bitmap)
+{
+	BOOL status;
+	replayCodec* codec;
+	int index = REPLAY_CODEC_BITMAP;
+	replayContext* replay = (replayContext*) context;
+
+	if (bitmap->number && bitmap->rectangles[0].compressed)
+	{
+		if (bitmap->rectangles[0].bitsPerPixel == 32)
+			index = REPLAY_CODEC_PLANAR;
+		else
+			index = REPLAY_CODEC_INTERLEAVED;
+	}
+
+	codec = &replay->codecs[index];
+
+	replay_codec_start(codec);
+	status = replay->BitmapUpdate(context, bitmap);
+	replay_codec_stop(codec);
+
+	return status;
+}
+
+static BOOL replay_surface_bits(rdpContext* context, SURFACE_BITS_COMMAND* cmd)
+{
+	BOOL status;
+	replayCodec* codec;
+	int index = REPLAY_CODEC_UNCOMPRESSED;
+	replayContext* replay = (replayContext*) context;
+
+	if (cmd->codecID == RDP_CODEC_ID_REMOTEFX)
+		index = REPLAY_CODEC_REMOTEFX;
+	else if (cmd->codecID == RDP_CODEC_ID_NSCODEC)
+		index = REPLAY_CODEC_NSCODEC;
+
+	codec = &replay->codecs[index];
+
+	replay_codec_start(codec);
+	status = replay->SurfaceBits(context, cmd);
+	replay_codec_stop(codec);
+
+	return status;
+}
+
+static int replay_gfx_surface_command(RdpgfxClientContext* context, RDPGFX_SURFACE_COMMAND* cmd)
+{
+	int status;
+	replayCodec* codec;
+	int index = REPLAY_CODEC_GFX_UNCOMPRESSED;
+	rdpGdi* gdi = (rdpGdi*) context->custom;
+	replayContext* replay = (replayContext*) gdi->context;
+
+	switch (cmd->codecId)
+	{
+		case RDPGFX_CODECID_CAVIDEO:
+			index = REPLAY_CODEC_GFX_REMOTEFX;
+			break;
+
+		case RDPGFX_CODECID_CLEARCODEC:
+			index = REPLAY_CODEC_GFX_CLEARCODEC;
+			break;
+
+		case RDPGFX_CODECID_PLANAR:
+			index = REPLAY_CODEC_GFX_PLANAR;
+			break;
+
+		case RDPGFX_CODECID_H264:
+			index = REPLAY_CODEC_GFX_H264;
+			break;
+
+		case RDPGFX_CODECID_ALPHA:
+			index = REPLAY_CODEC_GFX_ALPHA;
+			break;
+
+		case RDPGFX_CODECID_CAPROGRESSIVE:
+		case RDPGFX_CODECID_CAPROGRESSIVE_V2:
+			index = REPLAY_CODEC_GFX_PROGRESSIVE;
+			break;
+	}
+
+	codec = &replay->codecs[index];
+
+	replay_codec_start(codec);
+	status = replay->SurfaceCommand(context, cmd);
+	replay_codec_stop(codec);
+
+	InterlockedIncrement(&replay->gfxCommands);
+	replay->lastGfxTime = GetTickCount64();
+
+	return status;
+}
+
+static int replay_gfx_end_frame(RdpgfxClientContext* context, RDPGFX_END_FRAME_PDU* endFrame)
+{
+	rdpGdi* gdi = (rdpGdi*) context->custom;
+	replayContext* replay = (replayContext*) gdi->context;
+
+	InterlockedIncrement(&replay->gfxFrames);
+	replay->lastGfxTime = GetTickCount64();
+
+	return replay->EndFrame(context, endFrame);
+}
+
+static void replay_OnChannelConnectedEventHandler(rdpContext* context, ChannelConnectedEventArgs* e)
+{
+	replayContext* replay = (replayContext*) context;
+	RdpgfxClientContext* gfx;
+
+	if (strcmp(e->name, RDPGFX_DVC_CHANNEL_NAME) == 0)
+	{
+		gfx = (RdpgfxClientContext*) e->pInterface;
+		gdi_graphics_pipeline_init(context->gdi, gfx);
+
+		replay->SurfaceCommand = gfx->SurfaceCommand;
+		replay->EndFrame = gfx->EndFrame;
+		gfx->SurfaceCommand = replay_gfx_surface_command;
+		gfx->EndFrame = replay_gfx_end_frame;
+	}
+}
+
+static void replay_OnChannelDisconnectedEventHandler(rdpContext* context, ChannelDisconnectedEventArgs* e)
+{
+	if (strcmp(e->name, RDPGFX_DVC_CHANNEL_NAME) == 0)
+		gdi_graphics_pipeline_uninit(context->gdi, (RdpgfxClientContext*) e->pInterface);
+}
+
+static BOOL replay_pre_connect(freerdp* instance)
+{
+	rdpSettings* settings = instance->settings;
+
+	settings->OrderSupport[NEG_DSTBLT_INDEX] = TRUE;
+	settings->OrderSupport[NEG_PATBLT_INDEX] = TRUE;
+	settings->OrderSupport[NEG_SCRBLT_INDEX] = TRUE;
+	settings->OrderSupport[NEG_OPAQUE_RECT_INDEX] = TRUE;
+	settings->OrderSupport[NEG_DRAWNINEGRID_INDEX] = TRUE;
+	settings->OrderSupport[NEG_MULTIDSTBLT_INDEX] = TRUE;
+	settings->OrderSupport[NEG_MULTIPATBLT_INDEX] = TRUE;
+	settings->OrderSupport[NEG_MULTISCRBLT_INDEX] = TRUE;
+	settings->OrderSupport[NEG_MULTIOPAQUERECT_INDEX] = TRUE;
+	settings->OrderSupport[NEG_MULTI_DRAWNINEGRID_INDEX] = TRUE;
+	settings->OrderSupport[NEG_LINETO_INDEX] = TRUE;
+	settings->OrderSupport[NEG_POLYLINE_INDEX] = TRUE;
+	settings->OrderSupport[NEG_MEMBLT_INDEX] = TRUE;
+	settings->OrderSupport[NEG_MEM3BLT_INDEX] = TRUE;
+	settings->OrderSupport[NEG_SAVEBITMAP_INDEX] = TRUE;
+	settings->OrderSupport[NEG_GLYPH_INDEX_INDEX] = TRUE;
+	settings->OrderSupport[NEG_FAST_INDEX_INDEX] = TRUE;
+	settings->OrderSupport[NEG_FAST_GLYPH_INDEX] = TRUE;
+	settings->OrderSupport[NEG_POLYGON_SC_INDEX] = TRUE;
+	settings->OrderSupport[NEG_POLYGON_CB_INDEX] = TRUE;
+	settings->OrderSupport[NEG_ELLIPSE_SC_INDEX] = TRUE;
+	settings->OrderSupport[NEG_ELLIPSE_CB_INDEX] = TRUE;
+
+	freerdp_channels_pre_connect(instance->context->channels, instance);
+
+	return TRUE;
+}
+
+static BOOL replay_post_connect(freerdp* instance)
+{
+	rdpUpdate* update = instance->update;
+	replayContext* replay = (replayContext*) instance->context;
+
+	if (!gdi_init(instance, CLRCONV_ALPHA | CLRCONV_INVERT | CLRBUF_32BPP, NULL))
+		return FALSE;
+
+	update->BeginPaint = replay_begin_paint;
+	update->EndPaint = replay_end_paint;
+
+	replay->BitmapUpdate = update->BitmapUpdate;
+	replay->SurfaceBits = update->SurfaceBits;
+	update->BitmapUpdate = replay_bitmap_update;
+	update->SurfaceBits = replay_surface_bits;
+
+	freerdp_channels_post_connect(instance->context->channels, instance);
+
+	/* everything from here on is the recorded session itself */
+#ifdef FREERDP_COUNT_ALLOCATIONS
+	freerdp_allocations_get_total(&replay->startAllocations, &replay->startAllocatedBytes);
+#endif
+	replay->startTime = GetTickCount64();
+
+	return TRUE;
+}
+
+/**
+ * The dynamic channel data is decoded on the drdynvc thread, which may still
+ * be working through its queue when the last PDU has been replayed.
+ */
+
+static void replay_wait_for_channels(freerdp* instance)
+{
+	LONG commands;
+	int idle = 0;
+	replayContext* replay = (replayContext*) instance->context;
+
+	commands = replay->gfxCommands + replay->gfxFrames;
+
+	while (idle < 50)
+	{
+		freerdp_channels_check_fds(instance->context->channels, instance);
+		Sleep(10);
+
+		if (commands == (replay->gfxCommands + replay->gfxFrames))
+		{
+			idle++;
+		}
+		else
+		{
+			commands = replay->gfxCommands + replay->gfxFrames;
+			idle = 0;
+		}
+	}
+}
+
+static void replay_print_report(replayContext* replay, UINT64 endTime)
+{
+	int index;
+	double seconds;
+	UINT32 frames;
+	replayCodec* codec;
+
+	seconds = (endTime - replay->startTime) / 1000.0;
+	frames = replay->gfxFrames ? replay->gfxFrames : replay->paints;
+
+	printf("replay time:   %.3f s\n", seconds);
+	printf("frames:        %u (%.1f frames/s)\n", frames, (seconds > 0.0) ? (frames / seconds) : 0.0);
+	printf("paints:        %u, gfx frames %d\n", replay->paints, (int) replay->gfxFrames);
+
+#ifdef FREERDP_COUNT_ALLOCATIONS
+	{
+		UINT64 allocations;
+		UINT64 allocatedBytes;
+
+		freerdp_allocations_get_total(&allocations, &allocatedBytes);
+		printf("allocations:   %llu (%llu bytes)\n",
+				(unsigned long long) (allocations - replay->startAllocations),
+				(unsigned long long) (allocatedBytes - replay->startAllocatedBytes));
+	}
+#endif
+
+	printf("\n%-18s %10s %12s %10s %12s %14s\n", "codec", "calls", "total ms", "avg us", "allocations", "bytes");
+
+	for (index = 0; index < REPLAY_CODEC_COUNT; index++)
+	{
+		codec = &replay->codecs[index];
+
+		if (!codec->stopwatch->count)
+			continue;
+
+		printf("%-18s %10u %12.3f %10.1f %12llu %14llu\n", replay_codec_names[index],
+				codec->stopwatch->count, codec->stopwatch->elapsed / 1000.0,
+				((double) codec->stopwatch->elapsed) / codec->stopwatch->count,
+				(unsigned long long) codec->allocations,
+				(unsigned long long) codec->allocatedBytes);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int status;
+	UINT64 endTime;
+	freerdp* instance;
+	replayContext* replay;
+
+	instance = freerdp_new();
+
+	if (!instance)
+	{
+		WLog_ERR(TAG, "Couldn't create instance");
+		return 1;
+	}
+
+	instance->PreConnect = replay_pre_connect;
+	instance->PostConnect = replay_post_connect;
+
+	instance->ContextSize = sizeof(replayContext);
+	instance->ContextNew = replay_context_new;
+	instance->ContextFree = replay_context_free;
+
+	if (!freerdp_context_new(instance))
+	{
+		WLog_ERR(TAG, "Couldn't create context");
+		freerdp_free(instance);
+		return 1;
+	}
+
+	replay = (replayContext*) instance->context;
+
+	status = freerdp_client_settings_parse_command_line(instance->settings, argc, argv, FALSE);
+
+	if ((status < 0) || !instance->settings->PlaySession)
+	{
+		if (status >= 0)
+			printf("usage: %s /play-session:<file> [channel options of the recording]\n", argv[0]);
+
+		freerdp_context_free(instance);
+		freerdp_free(instance);
+		return 1;
+	}
+
+	instance->settings->SoftwareGdi = TRUE;
+
+	PubSub_SubscribeChannelConnected(instance->context->pubSub,
+			(pChannelConnectedEventHandler) replay_OnChannelConnectedEventHandler);
+	PubSub_SubscribeChannelDisconnected(instance->context->pubSub,
+			(pChannelDisconnectedEventHandler) replay_OnChannelDisconnectedEventHandler);
+
+	freerdp_client_load_addins(instance->context->channels, instance->settings);
+
+	if (!freerdp_connect(instance))
+	{
+		WLog_ERR(TAG, "replay of %s failed", instance->settings->PlaySessionFile);
+		status = 1;
+	}
+	else
+	{
+		endTime = GetTickCount64();
+		replay_wait_for_channels(instance);
+
+		if (replay->lastGfxTime > endTime)
+			endTime = replay->lastGfxTime;
+
+		replay_print_report(replay, endTime);
+		status = 0;
+	}
+
+	freerdp_disconnect(instance);
+	freerdp_context_free(instance);
+	freerdp_free(instance);
+
+	return status;
+}
@@ -325,7 +325,7 @@ static void xf_cliprdr_process_requested_data(xfClipboard* clipboard, BOOL hasDa
 	if (bSuccess && altFormatId)
 	{
 		DstSize = 0;
-		pDstData = (BYTE*) ClipboardGetData(clipboard->system, altFormatId, &DstSize);
+		pDstData = (BYTE*) ClipboardGetSharedData(clipboard->system, altFormatId, &DstSize);
 	}
 
 	if (!pDstData)
@@ -335,7 +335,7 @@ static void xf_cliprdr_process_requested_data(xfClipboard* clipboard, BOOL hasDa
 	}
 
 	xf_cliprdr_send_data_response(clipboard, pDstData, (int) DstSize);
-	free(pDstData);
+	ClipboardReleaseSharedData(clipboard->system, pDstData);
 }
 
 static BOOL xf_cliprdr_get_requested_data(xfClipboard* clipboard, Atom target)
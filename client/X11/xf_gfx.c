@@ -406,7 +406,6 @@ int xf_SurfaceCommand_Planar(xfContext* xfc, RdpgfxClientContext* context, RDPGF
 int xf_SurfaceCommand_H264(xfContext* xfc, RdpgfxClientContext* context, RDPGFX_SURFACE_COMMAND* cmd)
 {
 	int status;
-	UINT32 i;
 	BYTE* DstData = NULL;
 	H264_CONTEXT* h264;
 	xfGfxSurface* surface;
@@ -442,10 +441,8 @@ int xf_SurfaceCommand_H264(xfContext* xfc, RdpgfxClientContext* context, RDPGFX_
 		return -1;
 	}
 
-	for (i = 0; i < meta->numRegionRects; i++)
-	{
-		region16_union_rect(&surface->invalidRegion, &surface->invalidRegion, (RECTANGLE_16*) &(meta->regionRects[i]));
-	}
+	region16_union_rects(&surface->invalidRegion, &surface->invalidRegion,
+			(RECTANGLE_16*) meta->regionRects, meta->numRegionRects);
 
 	if (!xfc->inGfxFrame)
 		xf_UpdateSurfaces(xfc);
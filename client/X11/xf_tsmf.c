@@ -78,8 +78,13 @@ int xf_tsmf_xv_video_frame_event(TsmfClientContext* tsmf, TSMF_VIDEO_FRAME_EVENT
 	int x, y;
 	UINT32 width;
 	UINT32 height;
+	BYTE* tmp;
+	BYTE* data0;
 	BYTE* data1;
 	BYTE* data2;
+	UINT32 stride0;
+	UINT32 stride1;
+	UINT32 stride2;
 	UINT32 pixfmt;
 	UINT32 xvpixfmt;
 	XvImage* image;
@@ -223,11 +228,43 @@ int xf_tsmf_xv_video_frame_event(TsmfClientContext* tsmf, TSMF_VIDEO_FRAME_EVENT
 	{
 		case RDP_PIXFMT_I420:
 		case RDP_PIXFMT_YV12:
+			if (event->framePlanes[0])
+			{
+				/* planes decoded in place, possibly with padded strides */
+				data0 = event->framePlanes[0];
+				data1 = event->framePlanes[1];
+				data2 = event->framePlanes[2];
+				stride0 = event->frameStrides[0];
+				stride1 = event->frameStrides[1];
+				stride2 = event->frameStrides[2];
+			}
+			else
+			{
+				data0 = event->frameData;
+				data1 = event->frameData + event->frameWidth * event->frameHeight;
+				data2 = event->frameData + event->frameWidth * event->frameHeight +
+					event->frameWidth * event->frameHeight / 4;
+				stride0 = event->frameWidth;
+				stride1 = stride2 = event->frameWidth / 2;
+			}
+
+			/* Conversion between I420 and YV12 is to simply swap U and V */
+			if (converti420yv12)
+			{
+				tmp = data1;
+				data1 = data2;
+				data2 = tmp;
+				i = stride1;
+				stride1 = stride2;
+				stride2 = i;
+				image->id = pixfmt == RDP_PIXFMT_I420 ? RDP_PIXFMT_YV12 : RDP_PIXFMT_I420;
+			}
+
 			/* Y */
-			if (image->pitches[0] == event->frameWidth)
+			if ((image->pitches[0] == event->frameWidth) && (stride0 == event->frameWidth))
 			{
 				CopyMemory(image->data + image->offsets[0],
-					event->frameData,
+					data0,
 					event->frameWidth * event->frameHeight);
 			}
 			else
@@ -235,27 +272,14 @@ int xf_tsmf_xv_video_frame_event(TsmfClientContext* tsmf, TSMF_VIDEO_FRAME_EVENT
 				for (i = 0; i < event->frameHeight; i++)
 				{
 					CopyMemory(image->data + image->offsets[0] + i * image->pitches[0],
-						event->frameData + i * event->frameWidth,
+						data0 + i * stride0,
 						event->frameWidth);
 				}
 			}
-			/* UV */
-			/* Conversion between I420 and YV12 is to simply swap U and V */
-			if (!converti420yv12)
-			{
-				data1 = event->frameData + event->frameWidth * event->frameHeight;
-				data2 = event->frameData + event->frameWidth * event->frameHeight +
-					event->frameWidth * event->frameHeight / 4;
-			}
-			else
-			{
-				data2 = event->frameData + event->frameWidth * event->frameHeight;
-				data1 = event->frameData + event->frameWidth * event->frameHeight +
-					event->frameWidth * event->frameHeight / 4;
-				image->id = pixfmt == RDP_PIXFMT_I420 ? RDP_PIXFMT_YV12 : RDP_PIXFMT_I420;
-			}
 
-			if (image->pitches[1] * 2 == event->frameWidth)
+			/* UV */
+			if ((image->pitches[1] * 2 == event->frameWidth) && (stride1 * 2 == event->frameWidth) &&
+				(image->pitches[2] * 2 == event->frameWidth) && (stride2 * 2 == event->frameWidth))
 			{
 				CopyMemory(image->data + image->offsets[1],
 					data1,
@@ -269,10 +293,10 @@ int xf_tsmf_xv_video_frame_event(TsmfClientContext* tsmf, TSMF_VIDEO_FRAME_EVENT
 				for (i = 0; i < event->frameHeight / 2; i++)
 				{
 					CopyMemory(image->data + image->offsets[1] + i * image->pitches[1],
-						data1 + i * event->frameWidth / 2,
+						data1 + i * stride1,
 						event->frameWidth / 2);
 					CopyMemory(image->data + image->offsets[2] + i * image->pitches[2],
-						data2 + i * event->frameWidth / 2,
+						data2 + i * stride2,
 						event->frameWidth / 2);
 				}
 			}
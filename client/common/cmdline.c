@@ -79,6 +79,7 @@ COMMAND_LINE_ARGUMENT_A args[] =
 	{ "gp", COMMAND_LINE_VALUE_REQUIRED, "<password>", NULL, NULL, -1, NULL, "Gateway password" },
 	{ "gd", COMMAND_LINE_VALUE_REQUIRED, "<domain>", NULL, NULL, -1, NULL, "Gateway domain" },
 	{ "gt", COMMAND_LINE_VALUE_REQUIRED, "<rpc|http|auto>", NULL, NULL, -1, NULL, "Gateway transport type" },
+	{ "gateway-websocket", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL, "Use a WebSocket connection for the HTTP gateway transport" },
 	{ "gateway-usage-method", COMMAND_LINE_VALUE_REQUIRED, "<direct|detect>", NULL, NULL, -1, "gum", "Gateway usage method" },
 	{ "load-balance-info", COMMAND_LINE_VALUE_REQUIRED, "<info string>", NULL, NULL, -1, NULL, "Load balance info" },
 	{ "app", COMMAND_LINE_VALUE_REQUIRED, "<executable path> or <||alias>", NULL, NULL, -1, NULL, "Remote application program" },
@@ -154,6 +155,7 @@ COMMAND_LINE_ARGUMENT_A args[] =
 	{ "fast-path", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueTrue, NULL, -1, NULL, "fast-path input/output" },
 	{ "max-fast-path-size", COMMAND_LINE_VALUE_OPTIONAL, "<size>", NULL, NULL, -1, NULL, "maximum fast-path update size" },
 	{ "async-input", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL, "asynchronous input" },
+	{ "input-batching", COMMAND_LINE_VALUE_OPTIONAL, "<milliseconds>", NULL, NULL, -1, NULL, "Coalesce mouse motion and batch fast-path input events" },
 	{ "async-update", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL, "asynchronous update" },
 	{ "async-transport", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL, "asynchronous transport (unstable)" },
 	{ "async-channels", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL, "asynchronous channels (unstable)" },
@@ -161,12 +163,15 @@ COMMAND_LINE_ARGUMENT_A args[] =
 	{ "version", COMMAND_LINE_VALUE_FLAG | COMMAND_LINE_PRINT_VERSION, NULL, NULL, NULL, -1, NULL, "print version" },
 	{ "help", COMMAND_LINE_VALUE_FLAG | COMMAND_LINE_PRINT_HELP, NULL, NULL, NULL, -1, "?", "print help" },
 	{ "play-rfx", COMMAND_LINE_VALUE_REQUIRED, "<pcap file>", NULL, NULL, -1, NULL, "Replay rfx pcap file" },
+	{ "record-session", COMMAND_LINE_VALUE_REQUIRED, "<pcap file>", NULL, NULL, -1, NULL, "Record incoming session PDUs to a pcap file" },
+	{ "play-session", COMMAND_LINE_VALUE_REQUIRED, "<pcap file>", NULL, NULL, -1, NULL, "Replay a recorded session pcap file" },
 	{ "auth-only", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL, "Authenticate only." },
 	{ "auto-reconnect", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL, "Automatic reconnection" },
 	{ "reconnect-cookie", COMMAND_LINE_VALUE_REQUIRED, "<base64 cookie>", NULL, NULL, -1, NULL, "Pass base64 reconnect cookie to the connection" },
 	{ "print-reconnect-cookie", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL, "Print base64 reconnect cookie after connecting" },
 	{ "heartbeat", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL, "Support heartbeat PDUs" },
 	{ "multitransport", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL, "Support multitransport protocol" },
+	{ "pipeline-channel-join", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL, "Send all MCS channel join requests without waiting for confirms" },
 	{ "assistance", COMMAND_LINE_VALUE_REQUIRED, "<password>", NULL, NULL, -1, NULL, "Remote assistance password" },
 	{ "encryption-methods", COMMAND_LINE_VALUE_REQUIRED, "<40,56,128,FIPS>", NULL, NULL, -1, NULL, "RDP standard security encryption methods" },
 	{ NULL, 0, NULL, NULL, NULL, -1, NULL, NULL }
@@ -786,6 +791,10 @@ int freerdp_client_command_line_post_filter(void* context, COMMAND_LINE_ARGUMENT
 		settings->SupportMultitransport = TRUE;
 		settings->MultitransportFlags = (TRANSPORT_TYPE_UDP_FECR | TRANSPORT_TYPE_UDP_FECL | TRANSPORT_TYPE_UDP_PREFERRED);
 	}
+	CommandLineSwitchCase(arg, "pipeline-channel-join")
+	{
+		settings->PipelineChannelJoin = arg->Value ? TRUE : FALSE;
+	}
 
 	CommandLineSwitchEnd(arg)
 
@@ -1544,6 +1553,10 @@ int freerdp_client_settings_parse_command_line_arguments(rdpSettings* settings,
 				settings->GatewayHttpTransport = TRUE;
 			}
 		}
+		CommandLineSwitchCase(arg, "gateway-websocket")
+		{
+			settings->GatewayHttpUseWebsockets = arg->Value ? TRUE : FALSE;
+		}
 		CommandLineSwitchCase(arg, "gateway-usage-method")
 		{
 			int type;
@@ -1956,6 +1969,13 @@ int freerdp_client_settings_parse_command_line_arguments(rdpSettings* settings,
 		{
 			settings->AsyncInput = arg->Value ? TRUE : FALSE;
 		}
+		CommandLineSwitchCase(arg, "input-batching")
+		{
+			settings->InputBatching = TRUE;
+
+			if (arg->Value)
+				settings->InputBatchingInterval = atoi(arg->Value);
+		}
 		CommandLineSwitchCase(arg, "async-update")
 		{
 			settings->AsyncUpdate = arg->Value ? TRUE : FALSE;
@@ -1977,6 +1997,16 @@ int freerdp_client_settings_parse_command_line_arguments(rdpSettings* settings,
 			settings->PlayRemoteFxFile = _strdup(arg->Value);
 			settings->PlayRemoteFx = TRUE;
 		}
+		CommandLineSwitchCase(arg, "record-session")
+		{
+			settings->DumpSessionFile = _strdup(arg->Value);
+			settings->DumpSession = TRUE;
+		}
+		CommandLineSwitchCase(arg, "play-session")
+		{
+			settings->PlaySessionFile = _strdup(arg->Value);
+			settings->PlaySession = TRUE;
+		}
 		CommandLineSwitchCase(arg, "auth-only")
 		{
 			settings->AuthenticationOnly = arg->Value ? TRUE : FALSE;
@@ -57,6 +57,7 @@ option(BUILD_TESTING "Build unit tests" OFF)
 CMAKE_DEPENDENT_OPTION(TESTS_WTSAPI_EXTRA "Build extra WTSAPI tests (interactive)" OFF "BUILD_TESTING" ON)
 
 option(WITH_SAMPLE "Build sample code" OFF)
+option(WITH_REPLAY "Build the headless session replay benchmark" OFF)
 
 option(WITH_CLIENT "Build client binaries" ON)
 option(WITH_SERVER "Build server binaries" OFF)
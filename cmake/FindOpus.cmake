@@ -0,0 +1,13 @@
+
+find_path(OPUS_INCLUDE_DIR opus/opus.h)
+
+find_library(OPUS_LIBRARY opus)
+
+find_package_handle_standard_args(Opus DEFAULT_MSG OPUS_INCLUDE_DIR OPUS_LIBRARY)
+
+if(OPUS_FOUND)
+	set(OPUS_LIBRARIES ${OPUS_LIBRARY})
+	set(OPUS_INCLUDE_DIRS ${OPUS_INCLUDE_DIR})
+endif()
+
+mark_as_advanced(OPUS_INCLUDE_DIR OPUS_LIBRARY)
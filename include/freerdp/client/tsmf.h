@@ -42,6 +42,9 @@ struct _TSMF_VIDEO_FRAME_EVENT
 	INT16 height;
 	UINT16 numVisibleRects;
 	RECTANGLE_16* visibleRects;
+	/* when framePlanes[0] is set, the planes of frameData are not packed */
+	BYTE* framePlanes[3];
+	UINT32 frameStrides[3];
 };
 typedef struct _TSMF_VIDEO_FRAME_EVENT TSMF_VIDEO_FRAME_EVENT;
 
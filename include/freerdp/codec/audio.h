@@ -181,6 +181,7 @@ typedef struct AUDIO_FORMAT AUDIO_FORMAT;
 #define WAVE_FORMAT_NORRIS			0x1400
 #define WAVE_FORMAT_SOUNDSPACE_MUSICOMPRESS	0x1500
 #define WAVE_FORMAT_DVM				0x2000
+#define WAVE_FORMAT_OPUS			0x704F
 
 /**
  * Audio Format Functions
@@ -39,6 +39,9 @@ union _ADPCM
 };
 typedef union _ADPCM ADPCM;
 
+typedef struct _FREERDP_DSP_RESAMPLER FREERDP_DSP_RESAMPLER;
+typedef struct _FREERDP_DSP_OPUS FREERDP_DSP_OPUS;
+
 typedef struct _FREERDP_DSP_CONTEXT FREERDP_DSP_CONTEXT;
 
 struct _FREERDP_DSP_CONTEXT
@@ -68,6 +71,18 @@ struct _FREERDP_DSP_CONTEXT
 		const BYTE* src, int size, int channels, int block_size);
 	BOOL (*encode_ms_adpcm)(FREERDP_DSP_CONTEXT* context,
 		const BYTE* src, int size, int channels, int block_size);
+
+	/* Opus packets, each preceded by its UINT16 length, to and from 16-bit PCM in adpcm_buffer */
+	BOOL (*decode_opus)(FREERDP_DSP_CONTEXT* context,
+		const BYTE* src, int size, int channels, int rate);
+	BOOL (*encode_opus)(FREERDP_DSP_CONTEXT* context,
+		const BYTE* src, int size, int channels, int rate, int bitrate);
+
+	/* One output sample of the polyphase resampler, in 1.14 fixed point */
+	INT32 (*resample_filter)(const INT16* samples, const INT16* coeffs, UINT32 taps);
+
+	FREERDP_DSP_RESAMPLER* resampler;
+	FREERDP_DSP_OPUS* opus;
 };
 
 #ifdef __cplusplus
@@ -76,7 +91,11 @@ extern "C" {
 
 FREERDP_API FREERDP_DSP_CONTEXT* freerdp_dsp_context_new(void);
 FREERDP_API void freerdp_dsp_context_free(FREERDP_DSP_CONTEXT* context);
+FREERDP_API void freerdp_dsp_context_reset(FREERDP_DSP_CONTEXT* context);
+FREERDP_API BOOL freerdp_dsp_resample_flush(FREERDP_DSP_CONTEXT* context);
+FREERDP_API BOOL freerdp_dsp_encode_opus_flush(FREERDP_DSP_CONTEXT* context);
 #define freerdp_dsp_context_reset_adpcm(_c) memset(&_c->adpcm, 0, sizeof(ADPCM))
+#define freerdp_dsp_opus_rate_supported(_r) ((_r) == 8000 || (_r) == 12000 || (_r) == 16000 || (_r) == 24000 || (_r) == 48000)
 
 #ifdef __cplusplus
 }
@@ -95,6 +95,11 @@ struct _BITMAP_PLANAR_CONTEXT
 
 	UINT32 TempSize;
 	BYTE* TempBuffer;
+
+	BYTE* YCoCgBuffer;
+
+	UINT32 ChromaTempSize;
+	BYTE* ChromaTempBuffer;
 };
 
 #ifdef __cplusplus
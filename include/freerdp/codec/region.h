@@ -121,6 +121,24 @@ FREERDP_API BOOL region16_copy(REGION16 *dst, const REGION16 *src);
  */
 FREERDP_API BOOL region16_union_rect(REGION16 *dst, const REGION16 *src, const RECTANGLE_16 *rect);
 
+/** adds an array of rectangles in src and stores the resulting region in dst.
+ * The rectangles may overlap and come in any order, dst can be src.
+ * @param dst destination region
+ * @param src source region
+ * @param rects the rectangles to add
+ * @param count the number of rectangles
+ * @return if the operation was successful (false meaning out-of-memory)
+ */
+FREERDP_API BOOL region16_union_rects(REGION16 *dst, const REGION16 *src, const RECTANGLE_16 *rects, int count);
+
+/** sets dst to the union of an array of rectangles
+ * @param dst destination region
+ * @param rects the rectangles
+ * @param count the number of rectangles
+ * @return if the operation was successful (false meaning out-of-memory)
+ */
+FREERDP_API BOOL region16_from_rects(REGION16 *dst, const RECTANGLE_16 *rects, int count);
+
 /** returns if a rectangle intersects the region
  * @param src the region
  * @param arg2 the rectangle
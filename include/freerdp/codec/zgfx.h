@@ -23,6 +23,8 @@
 #include <freerdp/api.h>
 #include <freerdp/types.h>
 
+#include <winpr/stream.h>
+
 #include <freerdp/codec/bulk.h>
 
 #define ZGFX_SEGMENTED_SINGLE			0xE0
@@ -46,6 +48,8 @@ struct _ZGFX_CONTEXT
 	BYTE HistoryBuffer[2500000];
 	UINT32 HistoryIndex;
 	UINT32 HistoryBufferSize;
+
+	UINT32* HashTable;
 };
 typedef struct _ZGFX_CONTEXT ZGFX_CONTEXT;
 
@@ -53,6 +57,9 @@ typedef struct _ZGFX_CONTEXT ZGFX_CONTEXT;
 extern "C" {
 #endif
 
+FREERDP_API int zgfx_compress_segment(ZGFX_CONTEXT* zgfx, wStream* s, const BYTE* pSrcData, UINT32 SrcSize, UINT32* pFlags);
+FREERDP_API int zgfx_decompress_segment(ZGFX_CONTEXT* zgfx, BYTE* pbSegment, UINT32 cbSegment);
+
 FREERDP_API int zgfx_compress(ZGFX_CONTEXT* zgfx, BYTE* pSrcData, UINT32 SrcSize, BYTE** ppDstData, UINT32* pDstSize, UINT32* pFlags);
 FREERDP_API int zgfx_decompress(ZGFX_CONTEXT* zgfx, BYTE* pSrcData, UINT32 SrcSize, BYTE** ppDstData, UINT32* pDstSize, UINT32 flags);
 
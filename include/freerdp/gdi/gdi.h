@@ -20,6 +20,8 @@
 #ifndef FREERDP_GDI_H
 #define FREERDP_GDI_H
 
+#include <winpr/pool.h>
+
 #include <freerdp/api.h>
 #include <freerdp/log.h>
 #include <freerdp/freerdp.h>
@@ -270,14 +272,25 @@ typedef struct gdi_bitmap gdiBitmap;
 
 struct gdi_glyph
 {
-	rdpBitmap _p;
+	rdpGlyph _p;
 
-	HGDI_DC hdc;
-	HGDI_BITMAP bitmap;
-	HGDI_BITMAP org_bitmap;
+	BYTE* mask;
+	UINT32 maskStride;
 };
 typedef struct gdi_glyph gdiGlyph;
 
+/* state of the glyph run drawn between Glyph_BeginDraw and Glyph_EndDraw */
+struct gdi_glyph_run
+{
+	BOOL active;
+	UINT32 color;
+	GDI_RECT clip;
+	GDI_RECT bounds;
+};
+typedef struct gdi_glyph_run gdiGlyphRun;
+
+typedef struct gdi_bitmap_worker gdiBitmapWorker;
+
 struct rdp_gdi
 {
 	rdpContext* context;
@@ -300,6 +313,7 @@ struct rdp_gdi
 	BYTE* bitmap_buffer;
 	BYTE* primary_buffer;
 	GDI_COLOR textColor;
+	gdiGlyphRun glyphRun;
 	BYTE palette[256 * 4];
 	gdiBitmap* tile;
 	gdiBitmap* image;
@@ -309,6 +323,16 @@ struct rdp_gdi
 	UINT16 outputSurfaceId;
 	REGION16 invalidRegion;
 	RdpgfxClientContext* gfx;
+
+	PTP_POOL bitmapThreadPool;
+	TP_CALLBACK_ENVIRON bitmapThreadPoolEnv;
+	BOOL bitmapWorkersInit;
+	int maxBitmapWorkers;
+	int numBitmapWorkers;
+	gdiBitmapWorker* bitmapWorkers;
+	BITMAP_UPDATE* bitmapUpdate;
+	LONG bitmapIndex;
+	LONG bitmapFailed;
 };
 
 #ifdef __cplusplus
@@ -59,6 +59,7 @@ typedef struct rdp_input rdpInput;
 
 /* defined inside libfreerdp-core */
 typedef struct rdp_input_proxy rdpInputProxy;
+typedef struct rdp_input_batch rdpInputBatch;
 
 /* Input Interface */
 
@@ -91,6 +92,7 @@ struct rdp_input
 	BOOL asynchronous;
 	rdpInputProxy* proxy;
 	wMessageQueue* queue;
+	rdpInputBatch* batch;
 };
 
 #ifdef __cplusplus
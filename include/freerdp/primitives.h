@@ -163,11 +163,33 @@ typedef pstatus_t (*__YCoCgToRGB_8u_AC4R_t)(
 	UINT8 shift,
 	BOOL withAlpha,
 	BOOL invert);
+typedef pstatus_t (*__RGBToYCoCg_8u_AC4R_t)(
+	const BYTE *pSrc, INT32 srcStep,
+	BYTE *pDst, INT32 dstStep,
+	UINT32 width, UINT32 height,
+	UINT8 shift,
+	BOOL withAlpha,
+	BOOL invert);
 typedef pstatus_t (*__RGB565ToARGB_16u32u_C3C4_t)(
 	const UINT16* pSrc, INT32 srcStep,
 	UINT32* pDst, INT32 dstStep,
 	UINT32 width, UINT32 height,
 	BOOL alpha, BOOL invert);
+typedef pstatus_t (*__RGB555ToARGB_16u32u_C3C4_t)(
+	const UINT16* pSrc, INT32 srcStep,
+	UINT32* pDst, INT32 dstStep,
+	UINT32 width, UINT32 height,
+	BOOL alpha, BOOL invert);
+typedef pstatus_t (*__RGBToBGR_8u_AC4R_t)(
+	const BYTE* pSrc, INT32 srcStep,
+	BYTE* pDst, INT32 dstStep,
+	UINT32 width, UINT32 height,
+	BOOL alpha);
+typedef pstatus_t (*__RGB24ToRGB32_8u_C3AC4R_t)(
+	const BYTE* pSrc, INT32 srcStep,
+	BYTE* pDst, INT32 dstStep,
+	UINT32 width, UINT32 height,
+	BOOL invert);
 typedef pstatus_t (*__YUV420ToRGB_8u_P3AC4R_t)(
 	const BYTE* pSrc[3], INT32 srcStep[3],
 	BYTE* pDst, INT32 dstStep,
@@ -186,6 +208,11 @@ typedef pstatus_t (*__orC_32u_t)(
 	UINT32 val,
 	UINT32 *pDst,
 	INT32 len);
+typedef pstatus_t (*__rop3_32u_t)(
+	const UINT32* pSrc, INT32 srcStep,
+	const UINT32* pPat, UINT32 patX, UINT32 patY,
+	UINT32* pDst, INT32 dstStep,
+	UINT32 width, UINT32 height, BYTE rop);
 
 typedef struct
 {
@@ -203,6 +230,8 @@ typedef struct
 	/* And/or */
 	__andC_32u_t andC_32u;
 	__orC_32u_t orC_32u;
+	/* Ternary raster operations, pPat being an 8x8 pattern */
+	__rop3_32u_t rop3_32u;
 	/* Shifts */
 	__lShiftC_16s_t lShiftC_16s;
 	__lShiftC_16u_t lShiftC_16u;
@@ -224,6 +253,10 @@ typedef struct
 	__RGB565ToARGB_16u32u_C3C4_t RGB565ToARGB_16u32u_C3C4;
 	__YUV420ToRGB_8u_P3AC4R_t YUV420ToRGB_8u_P3AC4R;
 	__RGBToYUV420_8u_P3AC4R_t RGBToYUV420_8u_P3AC4R;
+	__RGBToYCoCg_8u_AC4R_t RGBToYCoCg_8u_AC4R;
+	__RGB555ToARGB_16u32u_C3C4_t RGB555ToARGB_16u32u_C3C4;
+	__RGBToBGR_8u_AC4R_t RGBToBGR_8u_AC4R;
+	__RGB24ToRGB32_8u_C3AC4R_t RGB24ToRGB32_8u_C3AC4R;
 } primitives_t;
 
 #ifdef __cplusplus
@@ -0,0 +1,59 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * RDP Server Peer Reactor
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_REACTOR_H
+#define FREERDP_REACTOR_H
+
+typedef struct rdp_freerdp_reactor freerdp_reactor;
+
+#include <freerdp/api.h>
+#include <freerdp/types.h>
+#include <freerdp/peer.h>
+
+/**
+ * The reactor is an alternative to running one thread per peer: the event
+ * handles of every registered peer are watched from a single epoll set, and
+ * peers with a signaled handle are dispatched to a bounded pool of worker
+ * threads. The check callback of a peer is never run concurrently.
+ *
+ * The reactor is only available where epoll is, freerdp_reactor_new()
+ * returns NULL elsewhere and servers should fall back to a thread per peer.
+ */
+
+#define FREERDP_REACTOR_MAX_PEER_HANDLES	8
+
+/* Called from a worker thread when one of the peer handles is signaled, returning FALSE removes the peer */
+typedef BOOL (*psReactorPeerCheck)(freerdp_peer* client);
+/* Called from a worker thread (or from freerdp_reactor_free) once the peer has been removed */
+typedef void (*psReactorPeerClosed)(freerdp_peer* client);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+FREERDP_API freerdp_reactor* freerdp_reactor_new(DWORD workers);
+FREERDP_API void freerdp_reactor_free(freerdp_reactor* reactor);
+
+FREERDP_API BOOL freerdp_reactor_add_peer(freerdp_reactor* reactor, freerdp_peer* client,
+		HANDLE* events, DWORD nCount, psReactorPeerCheck check, psReactorPeerClosed closed);
+FREERDP_API DWORD freerdp_reactor_get_peer_count(freerdp_reactor* reactor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_REACTOR_H */
@@ -25,6 +25,7 @@
 
 #include <freerdp/settings.h>
 #include <freerdp/listener.h>
+#include <freerdp/reactor.h>
 
 #include <freerdp/channels/wtsvc.h>
 #include <freerdp/channels/channels.h>
@@ -94,6 +95,8 @@ struct rdp_shadow_client
 	HANDLE vcm;
 	EncomspServerContext* encomsp;
 	RemdeskServerContext* remdesk;
+
+	void* updateSubscriber;
 };
 
 struct rdp_shadow_server
@@ -112,6 +115,7 @@ struct rdp_shadow_server
 	BOOL mayInteract;
 	BOOL shareSubRect;
 	BOOL authentication;
+	BOOL reactorMode;
 	int selectedMonitor;
 	RECTANGLE_16 subRect;
 	char* ipcSocket;
@@ -120,6 +124,7 @@ struct rdp_shadow_server
 	char* PrivateKeyFile;
 	CRITICAL_SECTION lock;
 	freerdp_listener* listener;
+	freerdp_reactor* reactor;
 };
 
 struct _RDP_SHADOW_ENTRY_POINTS
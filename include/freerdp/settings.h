@@ -543,6 +543,7 @@ typedef struct _RDPDR_PARALLEL RDPDR_PARALLEL;
 #define FreeRDP_ChannelCount					256
 #define FreeRDP_ChannelDefArraySize				257
 #define FreeRDP_ChannelDefArray					258
+#define FreeRDP_PipelineChannelJoin				259
 #define FreeRDP_ClusterInfoFlags				320
 #define FreeRDP_RedirectedSessionId				321
 #define FreeRDP_ConsoleSession					322
@@ -682,6 +683,10 @@ typedef struct _RDPDR_PARALLEL RDPDR_PARALLEL;
 #define FreeRDP_PlayRemoteFx					1857
 #define FreeRDP_DumpRemoteFxFile				1858
 #define FreeRDP_PlayRemoteFxFile				1859
+#define FreeRDP_DumpSession					1860
+#define FreeRDP_PlaySession					1861
+#define FreeRDP_DumpSessionFile					1862
+#define FreeRDP_PlaySessionFile					1863
 #define FreeRDP_GatewayUsageMethod				1984
 #define FreeRDP_GatewayPort					1985
 #define FreeRDP_GatewayHostname					1986
@@ -695,6 +700,7 @@ typedef struct _RDPDR_PARALLEL RDPDR_PARALLEL;
 #define FreeRDP_GatewayRpcTransport				1994
 #define FreeRDP_GatewayHttpTransport				1995
 #define FreeRDP_GatewayUdpTransport				1996
+#define FreeRDP_GatewayHttpUseWebsockets			1997
 #define FreeRDP_RemoteApplicationMode				2112
 #define FreeRDP_RemoteApplicationName				2113
 #define FreeRDP_RemoteApplicationIcon				2114
@@ -744,6 +750,8 @@ typedef struct _RDPDR_PARALLEL RDPDR_PARALLEL;
 #define FreeRDP_MultiTouchInput					2631
 #define FreeRDP_MultiTouchGestures				2632
 #define FreeRDP_KeyboardHook					2633
+#define FreeRDP_InputBatching					2634
+#define FreeRDP_InputBatchingInterval				2635
 #define FreeRDP_BrushSupportLevel				2688
 #define FreeRDP_GlyphSupportLevel				2752
 #define FreeRDP_GlyphCache					2753
@@ -881,7 +889,8 @@ struct rdp_settings
 	ALIGN64 UINT32 ChannelCount; /* 256 */
 	ALIGN64 UINT32 ChannelDefArraySize; /* 257 */
 	ALIGN64 CHANNEL_DEF* ChannelDefArray; /* 258 */
-	UINT64 padding0320[320 - 259]; /* 259 */
+	ALIGN64 BOOL PipelineChannelJoin; /* 259 */
+	UINT64 padding0320[320 - 260]; /* 260 */
 
 	/* Client Cluster Data */
 	ALIGN64 UINT32 ClusterInfoFlags; /* 320 */
@@ -1115,7 +1124,11 @@ struct rdp_settings
 	ALIGN64 BOOL PlayRemoteFx; /* 1857 */
 	ALIGN64 char* DumpRemoteFxFile; /* 1858 */
 	ALIGN64 char* PlayRemoteFxFile; /* 1859 */
-	UINT64 padding1920[1920 - 1860]; /* 1860 */
+	ALIGN64 BOOL DumpSession; /* 1860 */
+	ALIGN64 BOOL PlaySession; /* 1861 */
+	ALIGN64 char* DumpSessionFile; /* 1862 */
+	ALIGN64 char* PlaySessionFile; /* 1863 */
+	UINT64 padding1920[1920 - 1864]; /* 1864 */
 	UINT64 padding1984[1984 - 1920]; /* 1920 */
 
 	/**
@@ -1136,7 +1149,8 @@ struct rdp_settings
 	ALIGN64 BOOL GatewayRpcTransport; /* 1994 */
 	ALIGN64 BOOL GatewayHttpTransport; /* 1995 */
 	ALIGN64 BOOL GatewayUdpTransport; /* 1996 */
-	UINT64 padding2048[2048 - 1997]; /* 1997 */
+	ALIGN64 BOOL GatewayHttpUseWebsockets; /* 1997 */
+	UINT64 padding2048[2048 - 1998]; /* 1998 */
 	UINT64 padding2112[2112 - 2048]; /* 2048 */
 
 	/**
@@ -1219,7 +1233,9 @@ struct rdp_settings
 	ALIGN64 BOOL MultiTouchInput; /* 2631 */
 	ALIGN64 BOOL MultiTouchGestures; /* 2632 */
 	ALIGN64 UINT32 KeyboardHook; /* 2633 */
-	UINT64 padding2688[2688 - 2634]; /* 2634 */
+	ALIGN64 BOOL InputBatching; /* 2634 */
+	ALIGN64 UINT32 InputBatchingInterval; /* 2635 */
+	UINT64 padding2688[2688 - 2636]; /* 2636 */
 
 	/* Brush Capabilities */
 	ALIGN64 UINT32 BrushSupportLevel; /* 2688 */
@@ -0,0 +1,718 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Codec Benchmark
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <winpr/crt.h>
+#include <winpr/cmdline.h>
+
+#include <freerdp/utils/stopwatch.h>
+
+#include "bench.h"
+#include "allocations.h"
+
+/**
+ * Runs every codec over every corpus and reports encode and decode speed,
+ * compression ratio and steady state allocations per frame as JSON:
+ *
+ * freerdp-codec-bench [/quick] [/size:<width>x<height>] [/iterations:<count>]
+ *                     [/codec:<name>] [/output:<file>]
+ *                     [/baseline:<file> [/tolerance:<percent>] [/metrics:speed,ratio,allocations]]
+ *
+ * With /baseline the results are compared to a file written by an earlier
+ * /output run of the same size, and the exit status is non-zero when one of
+ * the selected metrics is worse than the baseline by more than the tolerance.
+ * Ratios and allocations do not depend on the machine, speed does and is
+ * only worth comparing against a baseline recorded on the same host.
+ */
+
+#define BENCH_JSON_VERSION	1
+
+#define BENCH_METRIC_SPEED		0x00000001
+#define BENCH_METRIC_RATIO		0x00000002
+#define BENCH_METRIC_ALLOCATIONS	0x00000004
+
+static UINT64 bench_get_allocations(void)
+{
+	UINT64 count;
+	UINT64 bytes;
+
+	freerdp_allocations_get_thread(&count, &bytes);
+	return count;
+}
+
+struct _BENCH_RESULT
+{
+	char codec[32];
+	char corpus[32];
+	double encodeSpeed;
+	double decodeSpeed;
+	double ratio;
+	double encodeAllocations;
+	double decodeAllocations;
+};
+typedef struct _BENCH_RESULT BENCH_RESULT;
+
+struct _BENCH_SETTINGS
+{
+	UINT32 width;
+	UINT32 height;
+	UINT32 iterations;
+	UINT32 metrics;
+	double tolerance;
+	char* codec;
+	char* output;
+	char* baseline;
+};
+typedef struct _BENCH_SETTINGS BENCH_SETTINGS;
+
+static COMMAND_LINE_ARGUMENT_A bench_args[] =
+{
+	{ "size", COMMAND_LINE_VALUE_REQUIRED, "<width>x<height>", "1024x768", NULL, -1, NULL, "Frame size" },
+	{ "iterations", COMMAND_LINE_VALUE_REQUIRED, "<count>", "5", NULL, -1, NULL, "Timed passes over each corpus" },
+	{ "quick", COMMAND_LINE_VALUE_FLAG, NULL, NULL, NULL, -1, NULL, "Small frames and a single pass" },
+	{ "codec", COMMAND_LINE_VALUE_REQUIRED, "<name>", NULL, NULL, -1, NULL, "Run a single codec" },
+	{ "output", COMMAND_LINE_VALUE_REQUIRED, "<file>", NULL, NULL, -1, NULL, "Write the results to a file" },
+	{ "baseline", COMMAND_LINE_VALUE_REQUIRED, "<file>", NULL, NULL, -1, NULL, "Fail on regressions against a baseline" },
+	{ "tolerance", COMMAND_LINE_VALUE_REQUIRED, "<percent>", "5", NULL, -1, NULL, "Regression tolerance" },
+	{ "metrics", COMMAND_LINE_VALUE_REQUIRED, "speed,ratio,allocations", NULL, NULL, -1, NULL, "Metrics compared to the baseline" },
+	{ "help", COMMAND_LINE_VALUE_FLAG | COMMAND_LINE_PRINT_HELP, NULL, NULL, NULL, -1, "?", "Print help" },
+	{ NULL, 0, NULL, NULL, NULL, -1, NULL, NULL }
+};
+
+static void bench_print_help(const char* name)
+{
+	int index;
+	COMMAND_LINE_ARGUMENT_A* arg = bench_args;
+
+	printf("Usage: %s [options]\n\n", name);
+
+	while (arg->Name)
+	{
+		if (arg->Format)
+			printf("    /%s:%-28s %s\n", arg->Name, arg->Format, arg->Text);
+		else
+			printf("    /%-29s %s\n", arg->Name, arg->Text);
+
+		arg++;
+	}
+
+	printf("\ncodecs:");
+
+	for (index = 0; bench_codecs[index]; index++)
+		printf(" %s", bench_codecs[index]->name);
+
+	printf("\n");
+}
+
+static int bench_parse_command_line(BENCH_SETTINGS* settings, int argc, char** argv)
+{
+	int status;
+	DWORD flags;
+	COMMAND_LINE_ARGUMENT_A* arg;
+
+	settings->width = 1024;
+	settings->height = 768;
+	settings->iterations = 5;
+	settings->tolerance = 5.0;
+	settings->metrics = BENCH_METRIC_SPEED | BENCH_METRIC_RATIO | BENCH_METRIC_ALLOCATIONS;
+
+	CommandLineClearArgumentsA(bench_args);
+
+	flags = COMMAND_LINE_SEPARATOR_COLON | COMMAND_LINE_SIGIL_SLASH;
+
+	status = CommandLineParseArgumentsA(argc, (const char**) argv, bench_args, flags, settings, NULL, NULL);
+
+	if (status == COMMAND_LINE_STATUS_PRINT_HELP)
+	{
+		bench_print_help(argv[0]);
+		return status;
+	}
+
+	if (status < 0)
+		return status;
+
+	arg = bench_args;
+
+	do
+	{
+		if (!(arg->Flags & COMMAND_LINE_ARGUMENT_PRESENT))
+			continue;
+
+		CommandLineSwitchStart(arg)
+
+		CommandLineSwitchCase(arg, "size")
+		{
+			if (sscanf(arg->Value, "%ux%u", &settings->width, &settings->height) != 2)
+				return -1;
+		}
+		CommandLineSwitchCase(arg, "iterations")
+		{
+			settings->iterations = (UINT32) atoi(arg->Value);
+		}
+		CommandLineSwitchCase(arg, "quick")
+		{
+			settings->width = 320;
+			settings->height = 240;
+			settings->iterations = 1;
+		}
+		CommandLineSwitchCase(arg, "codec")
+		{
+			settings->codec = arg->Value;
+		}
+		CommandLineSwitchCase(arg, "output")
+		{
+			settings->output = arg->Value;
+		}
+		CommandLineSwitchCase(arg, "baseline")
+		{
+			settings->baseline = arg->Value;
+		}
+		CommandLineSwitchCase(arg, "tolerance")
+		{
+			settings->tolerance = atof(arg->Value);
+		}
+		CommandLineSwitchCase(arg, "metrics")
+		{
+			settings->metrics = 0;
+
+			if (strstr(arg->Value, "speed"))
+				settings->metrics |= BENCH_METRIC_SPEED;
+
+			if (strstr(arg->Value, "ratio"))
+				settings->metrics |= BENCH_METRIC_RATIO;
+
+			if (strstr(arg->Value, "allocations"))
+				settings->metrics |= BENCH_METRIC_ALLOCATIONS;
+		}
+		CommandLineSwitchDefault(arg)
+		{
+
+		}
+
+		CommandLineSwitchEnd(arg)
+	}
+	while ((arg = CommandLineFindNextArgumentA(arg)) != NULL);
+
+	/* interleaved bitmaps are a multiple of 4 pixels wide, so is the corpus */
+	if ((settings->width < 64) || (settings->height < 64) || (settings->width % 4) ||
+			(settings->width > 4096) || (settings->height > 4096) || (settings->iterations < 1))
+		return -1;
+
+	return 1;
+}
+
+static BOOL bench_verify(const BENCH_CODEC* codec, BENCH_CORPUS* corpus, UINT32 frame, BYTE* pDstData)
+{
+	UINT32 x, y;
+	UINT32 channel;
+	int delta;
+	double mse = 0.0;
+	double psnr;
+	BYTE* pSrcPixel;
+	BYTE* pDstPixel;
+
+	for (y = 0; y < corpus->height; y++)
+	{
+		pSrcPixel = &corpus->frames[frame][y * corpus->step];
+		pDstPixel = &pDstData[y * corpus->step];
+
+		for (x = 0; x < corpus->width; x++)
+		{
+			for (channel = 0; channel < 3; channel++)
+			{
+				delta = ((int) pSrcPixel[channel]) - ((int) pDstPixel[channel]);
+
+				if (delta && codec->lossless)
+				{
+					fprintf(stderr, "%s/%s: frame %u differs at %u,%u\n",
+							codec->name, corpus->name, frame, x, y);
+					return FALSE;
+				}
+
+				mse += delta * delta;
+			}
+
+			pSrcPixel += 4;
+			pDstPixel += 4;
+		}
+	}
+
+	mse /= (corpus->width * corpus->height * 3);
+	psnr = (mse > 0.0) ? (10.0 * log10((255.0 * 255.0) / mse)) : 99.0;
+
+	if (psnr < 20.0)
+	{
+		fprintf(stderr, "%s/%s: frame %u has a PSNR of %.2f dB\n", codec->name, corpus->name, frame, psnr);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * One warm-up pass encodes, decodes and verifies the frames and lets the
+ * codecs grow their buffers, the timed passes only encode or only decode.
+ * Codec state is reset before every pass, outside of the timed region.
+ */
+
+static int bench_run(BENCH_SETTINGS* settings, const BENCH_CODEC* codec, BENCH_CORPUS* corpus,
+		void* context, wStream* s, BYTE* pDstData, BENCH_RESULT* result)
+{
+	UINT32 frame;
+	UINT32 iteration;
+	UINT32 offsets[BENCH_FRAME_COUNT + 1];
+	UINT64 allocations;
+	double seconds;
+	double bytes;
+	STOPWATCH* stopwatch;
+
+	codec->Reset(context);
+	Stream_SetPosition(s, 0);
+
+	for (frame = 0; frame < BENCH_FRAME_COUNT; frame++)
+	{
+		offsets[frame] = (UINT32) Stream_GetPosition(s);
+
+		if (codec->Encode(context, corpus->frames[frame], corpus->width, corpus->height, corpus->step, s) < 0)
+		{
+			fprintf(stderr, "%s/%s: failed to encode frame %u\n", codec->name, corpus->name, frame);
+			return -1;
+		}
+	}
+
+	offsets[BENCH_FRAME_COUNT] = (UINT32) Stream_GetPosition(s);
+
+	for (frame = 0; frame < BENCH_FRAME_COUNT; frame++)
+	{
+		ZeroMemory(pDstData, corpus->step * corpus->height);
+
+		if (codec->Decode(context, &Stream_Buffer(s)[offsets[frame]], offsets[frame + 1] - offsets[frame],
+				pDstData, corpus->width, corpus->height, corpus->step) < 0)
+		{
+			fprintf(stderr, "%s/%s: failed to decode frame %u\n", codec->name, corpus->name, frame);
+			return -1;
+		}
+
+		if (!bench_verify(codec, corpus, frame, pDstData))
+			return -1;
+	}
+
+	stopwatch = stopwatch_create();
+
+	if (!stopwatch)
+		return -1;
+
+	bytes = ((double) corpus->step) * corpus->height * BENCH_FRAME_COUNT * settings->iterations;
+
+	strncpy(result->codec, codec->name, sizeof(result->codec) - 1);
+	strncpy(result->corpus, corpus->name, sizeof(result->corpus) - 1);
+	result->ratio = ((double) corpus->step) * corpus->height * BENCH_FRAME_COUNT / offsets[BENCH_FRAME_COUNT];
+
+	/* encode */
+
+	allocations = 0;
+
+	for (iteration = 0; iteration < settings->iterations; iteration++)
+	{
+		codec->Reset(context);
+		Stream_SetPosition(s, 0);
+
+		allocations -= bench_get_allocations();
+		stopwatch_start(stopwatch);
+
+		for (frame = 0; frame < BENCH_FRAME_COUNT; frame++)
+			codec->Encode(context, corpus->frames[frame], corpus->width, corpus->height, corpus->step, s);
+
+		stopwatch_stop(stopwatch);
+		allocations += bench_get_allocations();
+	}
+
+	seconds = stopwatch_get_elapsed_time_in_seconds(stopwatch);
+	result->encodeSpeed = (seconds > 0.0) ? (bytes / seconds / 1000000.0) : 0.0;
+	result->encodeAllocations = ((double) allocations) / (BENCH_FRAME_COUNT * settings->iterations);
+
+	/* decode, the stream still holds the frames of the last encode pass */
+
+	stopwatch_reset(stopwatch);
+	allocations = 0;
+
+	for (iteration = 0; iteration < settings->iterations; iteration++)
+	{
+		codec->Reset(context);
+
+		allocations -= bench_get_allocations();
+		stopwatch_start(stopwatch);
+
+		for (frame = 0; frame < BENCH_FRAME_COUNT; frame++)
+		{
+			codec->Decode(context, &Stream_Buffer(s)[offsets[frame]], offsets[frame + 1] - offsets[frame],
+					pDstData, corpus->width, corpus->height, corpus->step);
+		}
+
+		stopwatch_stop(stopwatch);
+		allocations += bench_get_allocations();
+	}
+
+	seconds = stopwatch_get_elapsed_time_in_seconds(stopwatch);
+	result->decodeSpeed = (seconds > 0.0) ? (bytes / seconds / 1000000.0) : 0.0;
+	result->decodeAllocations = ((double) allocations) / (BENCH_FRAME_COUNT * settings->iterations);
+
+#ifndef FREERDP_COUNT_ALLOCATIONS
+	result->encodeAllocations = -1.0;
+	result->decodeAllocations = -1.0;
+#endif
+
+	stopwatch_free(stopwatch);
+	return 1;
+}
+
+static void bench_write_results(FILE* fp, BENCH_SETTINGS* settings, BENCH_RESULT* results, int count)
+{
+	int index;
+
+	fprintf(fp, "{\"version\": %d, \"width\": %u, \"height\": %u, \"frames\": %d, \"iterations\": %u, \"results\": [\n",
+			BENCH_JSON_VERSION, settings->width, settings->height, BENCH_FRAME_COUNT, settings->iterations);
+
+	for (index = 0; index < count; index++)
+	{
+		fprintf(fp, "{\"codec\": \"%s\", \"corpus\": \"%s\", \"encode_mbps\": %.2f, \"decode_mbps\": %.2f, "
+				"\"ratio\": %.3f, \"encode_allocations\": %.2f, \"decode_allocations\": %.2f}%s\n",
+				results[index].codec, results[index].corpus, results[index].encodeSpeed,
+				results[index].decodeSpeed, results[index].ratio, results[index].encodeAllocations,
+				results[index].decodeAllocations, (index < (count - 1)) ? "," : "");
+	}
+
+	fprintf(fp, "]}\n");
+}
+
+static BOOL bench_read_number(const char* line, const char* key, double* value)
+{
+	const char* p = strstr(line, key);
+
+	if (!p)
+		return FALSE;
+
+	return (sscanf(p + strlen(key), " : %lf", value) == 1) ? TRUE : FALSE;
+}
+
+static BOOL bench_read_string(const char* line, const char* key, char* value, int size)
+{
+	int length;
+	const char* end;
+	const char* p = strstr(line, key);
+
+	if (!p || !(p = strchr(p + strlen(key), '"')))
+		return FALSE;
+
+	p++;
+
+	if (!(end = strchr(p, '"')))
+		return FALSE;
+
+	length = (int) (end - p);
+
+	if (length >= size)
+		return FALSE;
+
+	CopyMemory(value, p, length);
+	value[length] = '\0';
+
+	return TRUE;
+}
+
+/**
+ * The baseline is read back line by line, it is expected in the layout
+ * written by bench_write_results and nothing more general.
+ */
+
+static int bench_read_baseline(const char* filename, BENCH_SETTINGS* settings, BENCH_RESULT** ppResults)
+{
+	FILE* fp;
+	int count = 0;
+	double width = 0.0;
+	double height = 0.0;
+	char line[1024];
+	BENCH_RESULT* result;
+	BENCH_RESULT* results = NULL;
+
+	fp = fopen(filename, "r");
+
+	if (!fp)
+	{
+		fprintf(stderr, "failed to open baseline %s\n", filename);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), fp))
+	{
+		if (strstr(line, "\"version\""))
+		{
+			bench_read_number(line, "\"width\"", &width);
+			bench_read_number(line, "\"height\"", &height);
+			continue;
+		}
+
+		if (!strstr(line, "\"codec\""))
+			continue;
+
+		result = (BENCH_RESULT*) realloc(results, sizeof(BENCH_RESULT) * (count + 1));
+
+		if (!result)
+		{
+			free(results);
+			fclose(fp);
+			return -1;
+		}
+
+		results = result;
+		result = &results[count];
+		ZeroMemory(result, sizeof(BENCH_RESULT));
+
+		if (!bench_read_string(line, "\"codec\"", result->codec, sizeof(result->codec)) ||
+			!bench_read_string(line, "\"corpus\"", result->corpus, sizeof(result->corpus)) ||
+			!bench_read_number(line, "\"encode_mbps\"", &result->encodeSpeed) ||
+			!bench_read_number(line, "\"decode_mbps\"", &result->decodeSpeed) ||
+			!bench_read_number(line, "\"ratio\"", &result->ratio) ||
+			!bench_read_number(line, "\"encode_allocations\"", &result->encodeAllocations) ||
+			!bench_read_number(line, "\"decode_allocations\"", &result->decodeAllocations))
+		{
+			fprintf(stderr, "malformed baseline entry: %s", line);
+			free(results);
+			fclose(fp);
+			return -1;
+		}
+
+		count++;
+	}
+
+	fclose(fp);
+
+	if ((((UINT32) width) != settings->width) || (((UINT32) height) != settings->height))
+	{
+		fprintf(stderr, "baseline %s was recorded at %ux%u, not %ux%u\n", filename,
+				(UINT32) width, (UINT32) height, settings->width, settings->height);
+		free(results);
+		return -1;
+	}
+
+	*ppResults = results;
+	return count;
+}
+
+static BOOL bench_check_lower(const BENCH_RESULT* result, const char* metric,
+		double value, double baseline, double tolerance)
+{
+	if (value >= (baseline * (1.0 - tolerance)))
+		return TRUE;
+
+	fprintf(stderr, "regression: %s/%s %s %.3f, baseline %.3f\n",
+			result->codec, result->corpus, metric, value, baseline);
+
+	return FALSE;
+}
+
+static BOOL bench_check_higher(const BENCH_RESULT* result, const char* metric,
+		double value, double baseline, double tolerance)
+{
+	/* half an allocation of slack, so that a baseline of zero allows none */
+	if ((baseline < 0.0) || (value < 0.0) || (value <= ((baseline * (1.0 + tolerance)) + 0.5)))
+		return TRUE;
+
+	fprintf(stderr, "regression: %s/%s %s %.2f, baseline %.2f\n",
+			result->codec, result->corpus, metric, value, baseline);
+
+	return FALSE;
+}
+
+static int bench_compare(BENCH_SETTINGS* settings, BENCH_RESULT* results, int count,
+		BENCH_RESULT* baseline, int baselineCount)
+{
+	int i, j;
+	int regressions = 0;
+	double tolerance = settings->tolerance / 100.0;
+	BENCH_RESULT* result;
+	BENCH_RESULT* base;
+
+	for (i = 0; i < count; i++)
+	{
+		result = &results[i];
+		base = NULL;
+
+		for (j = 0; j < baselineCount; j++)
+		{
+			if (!strcmp(result->codec, baseline[j].codec) && !strcmp(result->corpus, baseline[j].corpus))
+			{
+				base = &baseline[j];
+				break;
+			}
+		}
+
+		if (!base)
+		{
+			fprintf(stderr, "%s/%s is not in the baseline\n", result->codec, result->corpus);
+			continue;
+		}
+
+		if (settings->metrics & BENCH_METRIC_SPEED)
+		{
+			if (!bench_check_lower(result, "encode_mbps", result->encodeSpeed, base->encodeSpeed, tolerance))
+				regressions++;
+
+			if (!bench_check_lower(result, "decode_mbps", result->decodeSpeed, base->decodeSpeed, tolerance))
+				regressions++;
+		}
+
+		if (settings->metrics & BENCH_METRIC_RATIO)
+		{
+			if (!bench_check_lower(result, "ratio", result->ratio, base->ratio, tolerance))
+				regressions++;
+		}
+
+		if (settings->metrics & BENCH_METRIC_ALLOCATIONS)
+		{
+			if (!bench_check_higher(result, "encode_allocations", result->encodeAllocations,
+					base->encodeAllocations, tolerance))
+				regressions++;
+
+			if (!bench_check_higher(result, "decode_allocations", result->decodeAllocations,
+					base->decodeAllocations, tolerance))
+				regressions++;
+		}
+	}
+
+	return regressions;
+}
+
+int main(int argc, char* argv[])
+{
+	int status;
+	int index;
+	int content;
+	int count = 0;
+	int baselineCount;
+	void* context;
+	wStream* s = NULL;
+	BYTE* pDstData = NULL;
+	FILE* fp;
+	const BENCH_CODEC* codec;
+	BENCH_SETTINGS settings;
+	BENCH_CORPUS corpus[BENCH_CONTENT_COUNT];
+	BENCH_RESULT* results = NULL;
+	BENCH_RESULT* baseline = NULL;
+
+	ZeroMemory(&settings, sizeof(BENCH_SETTINGS));
+	ZeroMemory(corpus, sizeof(corpus));
+
+	status = bench_parse_command_line(&settings, argc, argv);
+
+	if (status == COMMAND_LINE_STATUS_PRINT_HELP)
+		return 0;
+
+	if (status < 0)
+	{
+		bench_print_help(argv[0]);
+		return 1;
+	}
+
+	status = 1;
+
+	for (content = 0; content < BENCH_CONTENT_COUNT; content++)
+	{
+		if (!bench_corpus_init(&corpus[content], content, settings.width, settings.height))
+			goto out;
+	}
+
+	s = Stream_New(NULL, settings.width * settings.height * 4 * BENCH_FRAME_COUNT);
+	pDstData = (BYTE*) _aligned_malloc(settings.width * settings.height * 4, 16);
+	results = (BENCH_RESULT*) calloc(BENCH_CONTENT_COUNT * 16, sizeof(BENCH_RESULT));
+
+	if (!s || !pDstData || !results)
+		goto out;
+
+	for (index = 0; bench_codecs[index] && (index < 16); index++)
+	{
+		codec = bench_codecs[index];
+
+		if (settings.codec && strcmp(settings.codec, codec->name))
+			continue;
+
+		context = codec->New(settings.width, settings.height);
+
+		if (!context)
+		{
+			fprintf(stderr, "%s: not available, skipped\n", codec->name);
+			continue;
+		}
+
+		for (content = 0; content < BENCH_CONTENT_COUNT; content++)
+		{
+			if (bench_run(&settings, codec, &corpus[content], context, s, pDstData, &results[count]) < 0)
+			{
+				codec->Free(context);
+				goto out;
+			}
+
+			count++;
+		}
+
+		codec->Free(context);
+	}
+
+	fp = settings.output ? fopen(settings.output, "w") : stdout;
+
+	if (!fp)
+	{
+		fprintf(stderr, "failed to open %s\n", settings.output);
+		goto out;
+	}
+
+	bench_write_results(fp, &settings, results, count);
+
+	if (fp != stdout)
+		fclose(fp);
+
+	if (settings.baseline)
+	{
+		baselineCount = bench_read_baseline(settings.baseline, &settings, &baseline);
+
+		if (baselineCount < 0)
+			goto out;
+
+		if (bench_compare(&settings, results, count, baseline, baselineCount) > 0)
+			goto out;
+	}
+
+	status = 0;
+
+out:
+	for (content = 0; content < BENCH_CONTENT_COUNT; content++)
+		bench_corpus_uninit(&corpus[content]);
+
+	Stream_Free(s, TRUE);
+	_aligned_free(pDstData);
+	free(results);
+	free(baseline);
+
+	return status;
+}
@@ -0,0 +1,95 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Codec Benchmark
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_CODEC_BENCH_H
+#define FREERDP_CODEC_BENCH_H
+
+#include <winpr/crt.h>
+#include <winpr/stream.h>
+
+#include <freerdp/types.h>
+
+#define BENCH_FRAME_COUNT		4
+
+enum BENCH_CONTENT
+{
+	BENCH_CONTENT_TEXT,
+	BENCH_CONTENT_PHOTO,
+	BENCH_CONTENT_GRADIENT,
+	BENCH_CONTENT_SCROLLING,
+	BENCH_CONTENT_COUNT
+};
+
+/**
+ * A corpus is a sequence of BENCH_FRAME_COUNT XRGB32 frames of one kind of
+ * content, generated from fixed seeds so that every run and every machine
+ * compresses the exact same pixels.
+ */
+
+struct _BENCH_CORPUS
+{
+	const char* name;
+	UINT32 width;
+	UINT32 height;
+	UINT32 step;
+	BYTE* frames[BENCH_FRAME_COUNT];
+};
+typedef struct _BENCH_CORPUS BENCH_CORPUS;
+
+typedef void* (*pBenchCodecNew)(UINT32 width, UINT32 height);
+typedef void (*pBenchCodecFree)(void* context);
+typedef void (*pBenchCodecReset)(void* context);
+typedef int (*pBenchCodecEncode)(void* context, BYTE* pSrcData, UINT32 width, UINT32 height, UINT32 step, wStream* s);
+typedef int (*pBenchCodecDecode)(void* context, BYTE* pSrcData, UINT32 SrcSize,
+		BYTE* pDstData, UINT32 width, UINT32 height, UINT32 step);
+
+/**
+ * Encode appends one encoded frame to the stream, Decode writes the frame it
+ * decodes into an XRGB32 buffer of the corpus size. Reset is called before
+ * each pass over the frames of a corpus, outside of the timed region, and
+ * brings the encoder and decoder state back to the start of a session.
+ * New returns NULL when the codec is not available in this build.
+ */
+
+struct _BENCH_CODEC
+{
+	const char* name;
+	BOOL lossless;
+	pBenchCodecNew New;
+	pBenchCodecFree Free;
+	pBenchCodecReset Reset;
+	pBenchCodecEncode Encode;
+	pBenchCodecDecode Decode;
+};
+typedef struct _BENCH_CODEC BENCH_CODEC;
+
+typedef struct _BENCH_PROGRESSIVE_ENCODER BENCH_PROGRESSIVE_ENCODER;
+
+BOOL bench_corpus_init(BENCH_CORPUS* corpus, int content, UINT32 width, UINT32 height);
+void bench_corpus_uninit(BENCH_CORPUS* corpus);
+
+extern const BENCH_CODEC* bench_codecs[];
+
+BENCH_PROGRESSIVE_ENCODER* bench_progressive_encoder_new(void);
+void bench_progressive_encoder_free(BENCH_PROGRESSIVE_ENCODER* encoder);
+void bench_progressive_encoder_reset(BENCH_PROGRESSIVE_ENCODER* encoder);
+int bench_progressive_compose(BENCH_PROGRESSIVE_ENCODER* encoder, BYTE* pSrcData,
+		UINT32 width, UINT32 height, UINT32 step, wStream* s);
+
+int bench_clear_compose(BYTE seqNumber, BYTE* pSrcData, UINT32 width, UINT32 height, UINT32 step, wStream* s);
+
+#endif /* FREERDP_CODEC_BENCH_H */
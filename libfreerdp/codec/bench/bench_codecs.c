@@ -0,0 +1,1057 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Codec Benchmark Codecs
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <freerdp/codec/color.h>
+#include <freerdp/codec/rfx.h>
+#include <freerdp/codec/nsc.h>
+#include <freerdp/codec/planar.h>
+#include <freerdp/codec/interleaved.h>
+#include <freerdp/codec/clear.h>
+#include <freerdp/codec/progressive.h>
+#include <freerdp/codec/h264.h>
+#include <freerdp/codec/mppc.h>
+#include <freerdp/codec/ncrush.h>
+#include <freerdp/codec/xcrush.h>
+#include <freerdp/codec/zgfx.h>
+
+#include "../rfx_types.h"
+
+#include "bench.h"
+
+/**
+ * Each codec is driven the way the server encoder and the client gdi drive
+ * it: RemoteFX, NSCodec, progressive, ClearCodec and H.264 take the whole
+ * frame, planar and interleaved take it as 64x64 bitmap tiles, the bulk
+ * compressors take its bytes as fast-path sized chunks.
+ */
+
+#define BENCH_TILE_SIZE		64
+#define BENCH_BULK_CHUNK_SIZE	16384
+
+/* RemoteFX */
+
+struct _BENCH_RFX
+{
+	RFX_CONTEXT* encoder;
+	RFX_CONTEXT* decoder;
+};
+typedef struct _BENCH_RFX BENCH_RFX;
+
+static void bench_rfx_free(void* context)
+{
+	BENCH_RFX* rfx = (BENCH_RFX*) context;
+
+	rfx_context_free(rfx->encoder);
+	rfx_context_free(rfx->decoder);
+	free(rfx);
+}
+
+static void* bench_rfx_new(UINT32 width, UINT32 height)
+{
+	BENCH_RFX* rfx = (BENCH_RFX*) calloc(1, sizeof(BENCH_RFX));
+
+	if (!rfx)
+		return NULL;
+
+	rfx->encoder = rfx_context_new(TRUE);
+	rfx->decoder = rfx_context_new(FALSE);
+
+	if (!rfx->encoder || !rfx->decoder)
+	{
+		bench_rfx_free(rfx);
+		return NULL;
+	}
+
+	rfx->encoder->mode = RLGR3;
+	rfx->encoder->width = width;
+	rfx->encoder->height = height;
+	rfx_context_set_pixel_format(rfx->encoder, RDP_PIXEL_FORMAT_B8G8R8A8);
+	rfx_context_set_pixel_format(rfx->decoder, RDP_PIXEL_FORMAT_B8G8R8A8);
+
+	/* single threaded, the numbers must not depend on the number of processors */
+	rfx->encoder->priv->UseThreads = FALSE;
+	rfx->decoder->priv->UseThreads = FALSE;
+
+	return rfx;
+}
+
+static void bench_rfx_reset(void* context)
+{
+	BENCH_RFX* rfx = (BENCH_RFX*) context;
+
+	rfx_context_reset(rfx->encoder);
+	rfx_context_reset(rfx->decoder);
+}
+
+static int bench_rfx_encode(void* context, BYTE* pSrcData, UINT32 width, UINT32 height, UINT32 step, wStream* s)
+{
+	RFX_RECT rect;
+	BENCH_RFX* rfx = (BENCH_RFX*) context;
+
+	rect.x = 0;
+	rect.y = 0;
+	rect.width = width;
+	rect.height = height;
+
+	return rfx_compose_message(rfx->encoder, s, &rect, 1, pSrcData, width, height, step) ? 1 : -1;
+}
+
+static int bench_rfx_decode(void* context, BYTE* pSrcData, UINT32 SrcSize,
+		BYTE* pDstData, UINT32 width, UINT32 height, UINT32 step)
+{
+	int index;
+	int count;
+	UINT32 nWidth;
+	UINT32 nHeight;
+	RFX_TILE* tile;
+	RFX_MESSAGE* message;
+	BENCH_RFX* rfx = (BENCH_RFX*) context;
+
+	message = rfx_process_message(rfx->decoder, pSrcData, SrcSize);
+
+	if (!message)
+		return -1;
+
+	count = rfx_message_get_tile_count(message);
+
+	for (index = 0; index < count; index++)
+	{
+		tile = rfx_message_get_tile(message, index);
+
+		if ((tile->x >= width) || (tile->y >= height))
+			continue;
+
+		nWidth = MIN(64, width - tile->x);
+		nHeight = MIN(64, height - tile->y);
+
+		freerdp_image_copy(pDstData, PIXEL_FORMAT_XRGB32, step, tile->x, tile->y, nWidth, nHeight,
+				tile->data, PIXEL_FORMAT_XRGB32, 64 * 4, 0, 0, NULL);
+	}
+
+	rfx_message_free(rfx->decoder, message);
+	return 1;
+}
+
+static const BENCH_CODEC bench_codec_rfx =
+{
+	"remotefx", FALSE, bench_rfx_new, bench_rfx_free, bench_rfx_reset, bench_rfx_encode, bench_rfx_decode
+};
+
+/* NSCodec */
+
+struct _BENCH_NSC
+{
+	NSC_CONTEXT* encoder;
+	NSC_CONTEXT* decoder;
+};
+typedef struct _BENCH_NSC BENCH_NSC;
+
+static void bench_nsc_free(void* context)
+{
+	BENCH_NSC* nsc = (BENCH_NSC*) context;
+
+	nsc_context_free(nsc->encoder);
+	nsc_context_free(nsc->decoder);
+	free(nsc);
+}
+
+static void* bench_nsc_new(UINT32 width, UINT32 height)
+{
+	BENCH_NSC* nsc = (BENCH_NSC*) calloc(1, sizeof(BENCH_NSC));
+
+	if (!nsc)
+		return NULL;
+
+	nsc->encoder = nsc_context_new();
+	nsc->decoder = nsc_context_new();
+
+	if (!nsc->encoder || !nsc->decoder)
+	{
+		bench_nsc_free(nsc);
+		return NULL;
+	}
+
+	nsc_context_set_pixel_format(nsc->encoder, RDP_PIXEL_FORMAT_B8G8R8A8);
+
+	return nsc;
+}
+
+static void bench_nsc_reset(void* context)
+{
+	BENCH_NSC* nsc = (BENCH_NSC*) context;
+
+	nsc_context_reset(nsc->encoder);
+	nsc_context_reset(nsc->decoder);
+}
+
+static int bench_nsc_encode(void* context, BYTE* pSrcData, UINT32 width, UINT32 height, UINT32 step, wStream* s)
+{
+	BENCH_NSC* nsc = (BENCH_NSC*) context;
+
+	nsc_compose_message(nsc->encoder, s, pSrcData, width, height, step);
+	return 1;
+}
+
+static int bench_nsc_decode(void* context, BYTE* pSrcData, UINT32 SrcSize,
+		BYTE* pDstData, UINT32 width, UINT32 height, UINT32 step)
+{
+	BENCH_NSC* nsc = (BENCH_NSC*) context;
+
+	if (nsc_process_message(nsc->decoder, 32, width, height, pSrcData, SrcSize) < 0)
+		return -1;
+
+	freerdp_image_copy(pDstData, PIXEL_FORMAT_XRGB32, step, 0, 0, width, height,
+			nsc->decoder->BitmapData, PIXEL_FORMAT_XRGB32_VF, width * 4, 0, 0, NULL);
+
+	return 1;
+}
+
+static const BENCH_CODEC bench_codec_nsc =
+{
+	"nscodec", FALSE, bench_nsc_new, bench_nsc_free, bench_nsc_reset, bench_nsc_encode, bench_nsc_decode
+};
+
+/**
+ * Planar and interleaved: the frame is split in 64x64 tiles, each encoded
+ * tile is stored behind its length.
+ */
+
+struct _BENCH_TILES
+{
+	void* encoder;
+	void* decoder;
+	BYTE* buffer;
+};
+typedef struct _BENCH_TILES BENCH_TILES;
+
+typedef int (*pBenchTileEncode)(BENCH_TILES* tiles, BYTE* pSrcData, UINT32 step,
+		UINT32 nXSrc, UINT32 nYSrc, UINT32 nWidth, UINT32 nHeight, BYTE** ppDstData, UINT32* pDstSize);
+typedef int (*pBenchTileDecode)(BENCH_TILES* tiles, BYTE* pSrcData, UINT32 SrcSize, BYTE* pDstData, UINT32 step,
+		UINT32 nXDst, UINT32 nYDst, UINT32 nWidth, UINT32 nHeight);
+
+static int bench_tiles_encode(BENCH_TILES* tiles, pBenchTileEncode encode,
+		BYTE* pSrcData, UINT32 width, UINT32 height, UINT32 step, wStream* s)
+{
+	UINT32 x, y;
+	UINT32 nWidth;
+	UINT32 nHeight;
+	BYTE* pDstData;
+	UINT32 DstSize;
+
+	for (y = 0; y < height; y += BENCH_TILE_SIZE)
+	{
+		for (x = 0; x < width; x += BENCH_TILE_SIZE)
+		{
+			nWidth = MIN(BENCH_TILE_SIZE, width - x);
+			nHeight = MIN(BENCH_TILE_SIZE, height - y);
+
+			if (encode(tiles, pSrcData, step, x, y, nWidth, nHeight, &pDstData, &DstSize) < 0)
+				return -1;
+
+			if (!Stream_EnsureRemainingCapacity(s, 4 + DstSize))
+				return -1;
+
+			Stream_Write_UINT32(s, DstSize);
+			Stream_Write(s, pDstData, DstSize);
+		}
+	}
+
+	return 1;
+}
+
+static int bench_tiles_decode(BENCH_TILES* tiles, pBenchTileDecode decode, BYTE* pSrcData, UINT32 SrcSize,
+		BYTE* pDstData, UINT32 width, UINT32 height, UINT32 step)
+{
+	UINT32 x, y;
+	UINT32 nWidth;
+	UINT32 nHeight;
+	UINT32 length;
+	UINT32 offset = 0;
+
+	for (y = 0; y < height; y += BENCH_TILE_SIZE)
+	{
+		for (x = 0; x < width; x += BENCH_TILE_SIZE)
+		{
+			nWidth = MIN(BENCH_TILE_SIZE, width - x);
+			nHeight = MIN(BENCH_TILE_SIZE, height - y);
+
+			if ((SrcSize - offset) < 4)
+				return -1;
+
+			length = *((UINT32*) &pSrcData[offset]);
+			offset += 4;
+
+			if ((SrcSize - offset) < length)
+				return -1;
+
+			if (decode(tiles, &pSrcData[offset], length, pDstData, step, x, y, nWidth, nHeight) < 0)
+				return -1;
+
+			offset += length;
+		}
+	}
+
+	return 1;
+}
+
+static void bench_planar_free(void* context)
+{
+	BENCH_TILES* planar = (BENCH_TILES*) context;
+
+	freerdp_bitmap_planar_context_free((BITMAP_PLANAR_CONTEXT*) planar->encoder);
+	freerdp_bitmap_planar_context_free((BITMAP_PLANAR_CONTEXT*) planar->decoder);
+	free(planar->buffer);
+	free(planar);
+}
+
+static void* bench_planar_new(UINT32 width, UINT32 height)
+{
+	BENCH_TILES* planar = (BENCH_TILES*) calloc(1, sizeof(BENCH_TILES));
+
+	if (!planar)
+		return NULL;
+
+	planar->encoder = freerdp_bitmap_planar_context_new(PLANAR_FORMAT_HEADER_NA | PLANAR_FORMAT_HEADER_RLE,
+			BENCH_TILE_SIZE, BENCH_TILE_SIZE);
+	planar->decoder = freerdp_bitmap_planar_context_new(0, BENCH_TILE_SIZE, BENCH_TILE_SIZE);
+	planar->buffer = (BYTE*) malloc(BENCH_TILE_SIZE * BENCH_TILE_SIZE * 4 * 2);
+
+	if (!planar->encoder || !planar->decoder || !planar->buffer)
+	{
+		bench_planar_free(planar);
+		return NULL;
+	}
+
+	return planar;
+}
+
+static void bench_planar_reset(void* context)
+{
+	BENCH_TILES* planar = (BENCH_TILES*) context;
+
+	freerdp_bitmap_planar_context_reset((BITMAP_PLANAR_CONTEXT*) planar->encoder);
+	freerdp_bitmap_planar_context_reset((BITMAP_PLANAR_CONTEXT*) planar->decoder);
+}
+
+static int bench_planar_encode_tile(BENCH_TILES* planar, BYTE* pSrcData, UINT32 step,
+		UINT32 nXSrc, UINT32 nYSrc, UINT32 nWidth, UINT32 nHeight, BYTE** ppDstData, UINT32* pDstSize)
+{
+	int size = BENCH_TILE_SIZE * BENCH_TILE_SIZE * 4 * 2;
+
+	*ppDstData = freerdp_bitmap_compress_planar((BITMAP_PLANAR_CONTEXT*) planar->encoder,
+			&pSrcData[(nYSrc * step) + (nXSrc * 4)], PIXEL_FORMAT_XRGB32,
+			nWidth, nHeight, step, planar->buffer, &size);
+
+	if (!*ppDstData)
+		return -1;
+
+	*pDstSize = (UINT32) size;
+	return 1;
+}
+
+static int bench_planar_decode_tile(BENCH_TILES* planar, BYTE* pSrcData, UINT32 SrcSize, BYTE* pDstData, UINT32 step,
+		UINT32 nXDst, UINT32 nYDst, UINT32 nWidth, UINT32 nHeight)
+{
+	return planar_decompress((BITMAP_PLANAR_CONTEXT*) planar->decoder, pSrcData, SrcSize, &pDstData,
+			PIXEL_FORMAT_XRGB32, step, nXDst, nYDst, nWidth, nHeight, TRUE);
+}
+
+static int bench_planar_encode(void* context, BYTE* pSrcData, UINT32 width, UINT32 height, UINT32 step, wStream* s)
+{
+	return bench_tiles_encode((BENCH_TILES*) context, bench_planar_encode_tile, pSrcData, width, height, step, s);
+}
+
+static int bench_planar_decode(void* context, BYTE* pSrcData, UINT32 SrcSize,
+		BYTE* pDstData, UINT32 width, UINT32 height, UINT32 step)
+{
+	return bench_tiles_decode((BENCH_TILES*) context, bench_planar_decode_tile,
+			pSrcData, SrcSize, pDstData, width, height, step);
+}
+
+static const BENCH_CODEC bench_codec_planar =
+{
+	"planar", TRUE, bench_planar_new, bench_planar_free, bench_planar_reset, bench_planar_encode, bench_planar_decode
+};
+
+static void bench_interleaved_free(void* context)
+{
+	BENCH_TILES* interleaved = (BENCH_TILES*) context;
+
+	bitmap_interleaved_context_free((BITMAP_INTERLEAVED_CONTEXT*) interleaved->encoder);
+	bitmap_interleaved_context_free((BITMAP_INTERLEAVED_CONTEXT*) interleaved->decoder);
+	free(interleaved->buffer);
+	free(interleaved);
+}
+
+static void* bench_interleaved_new(UINT32 width, UINT32 height)
+{
+	BENCH_TILES* interleaved;
+
+	/* interleaved bitmaps are a multiple of 4 pixels wide */
+	if (width % 4)
+		return NULL;
+
+	interleaved = (BENCH_TILES*) calloc(1, sizeof(BENCH_TILES));
+
+	if (!interleaved)
+		return NULL;
+
+	interleaved->encoder = bitmap_interleaved_context_new(TRUE);
+	interleaved->decoder = bitmap_interleaved_context_new(FALSE);
+	interleaved->buffer = (BYTE*) malloc(BENCH_TILE_SIZE * BENCH_TILE_SIZE * 4);
+
+	if (!interleaved->encoder || !interleaved->decoder || !interleaved->buffer)
+	{
+		bench_interleaved_free(interleaved);
+		return NULL;
+	}
+
+	return interleaved;
+}
+
+static void bench_interleaved_reset(void* context)
+{
+	BENCH_TILES* interleaved = (BENCH_TILES*) context;
+
+	bitmap_interleaved_context_reset((BITMAP_INTERLEAVED_CONTEXT*) interleaved->encoder);
+	bitmap_interleaved_context_reset((BITMAP_INTERLEAVED_CONTEXT*) interleaved->decoder);
+}
+
+static int bench_interleaved_encode_tile(BENCH_TILES* interleaved, BYTE* pSrcData, UINT32 step,
+		UINT32 nXSrc, UINT32 nYSrc, UINT32 nWidth, UINT32 nHeight, BYTE** ppDstData, UINT32* pDstSize)
+{
+	*pDstSize = BENCH_TILE_SIZE * BENCH_TILE_SIZE * 4;
+	*ppDstData = interleaved->buffer;
+
+	return interleaved_compress((BITMAP_INTERLEAVED_CONTEXT*) interleaved->encoder, interleaved->buffer, pDstSize,
+			nWidth, nHeight, pSrcData, PIXEL_FORMAT_XRGB32, step, nXSrc, nYSrc, NULL, 24);
+}
+
+static int bench_interleaved_decode_tile(BENCH_TILES* interleaved, BYTE* pSrcData, UINT32 SrcSize, BYTE* pDstData,
+		UINT32 step, UINT32 nXDst, UINT32 nYDst, UINT32 nWidth, UINT32 nHeight)
+{
+	return interleaved_decompress((BITMAP_INTERLEAVED_CONTEXT*) interleaved->decoder, pSrcData, SrcSize, 24,
+			&pDstData, PIXEL_FORMAT_XRGB32, step, nXDst, nYDst, nWidth, nHeight, NULL);
+}
+
+static int bench_interleaved_encode(void* context, BYTE* pSrcData, UINT32 width, UINT32 height, UINT32 step, wStream* s)
+{
+	return bench_tiles_encode((BENCH_TILES*) context, bench_interleaved_encode_tile,
+			pSrcData, width, height, step, s);
+}
+
+static int bench_interleaved_decode(void* context, BYTE* pSrcData, UINT32 SrcSize,
+		BYTE* pDstData, UINT32 width, UINT32 height, UINT32 step)
+{
+	return bench_tiles_decode((BENCH_TILES*) context, bench_interleaved_decode_tile,
+			pSrcData, SrcSize, pDstData, width, height, step);
+}
+
+static const BENCH_CODEC bench_codec_interleaved =
+{
+	"interleaved", TRUE, bench_interleaved_new, bench_interleaved_free, bench_interleaved_reset,
+	bench_interleaved_encode, bench_interleaved_decode
+};
+
+/* ClearCodec */
+
+struct _BENCH_CLEAR
+{
+	BYTE seqNumber;
+	CLEAR_CONTEXT* decoder;
+};
+typedef struct _BENCH_CLEAR BENCH_CLEAR;
+
+static void bench_clear_free(void* context)
+{
+	BENCH_CLEAR* clear = (BENCH_CLEAR*) context;
+
+	clear_context_free(clear->decoder);
+	free(clear);
+}
+
+static void* bench_clear_new(UINT32 width, UINT32 height)
+{
+	BENCH_CLEAR* clear;
+
+	if ((width > 0xFFFF) || (height > 0xFFFF))
+		return NULL;
+
+	clear = (BENCH_CLEAR*) calloc(1, sizeof(BENCH_CLEAR));
+
+	if (!clear)
+		return NULL;
+
+	clear->decoder = clear_context_new(FALSE);
+
+	if (!clear->decoder)
+	{
+		bench_clear_free(clear);
+		return NULL;
+	}
+
+	return clear;
+}
+
+static void bench_clear_reset(void* context)
+{
+	BENCH_CLEAR* clear = (BENCH_CLEAR*) context;
+
+	clear->seqNumber = 0;
+	clear_context_reset(clear->decoder);
+}
+
+static int bench_clear_encode(void* context, BYTE* pSrcData, UINT32 width, UINT32 height, UINT32 step, wStream* s)
+{
+	BENCH_CLEAR* clear = (BENCH_CLEAR*) context;
+
+	return bench_clear_compose(clear->seqNumber++, pSrcData, width, height, step, s);
+}
+
+static int bench_clear_decode(void* context, BYTE* pSrcData, UINT32 SrcSize,
+		BYTE* pDstData, UINT32 width, UINT32 height, UINT32 step)
+{
+	BENCH_CLEAR* clear = (BENCH_CLEAR*) context;
+
+	return clear_decompress(clear->decoder, pSrcData, SrcSize, &pDstData,
+			PIXEL_FORMAT_XRGB32, step, 0, 0, width, height);
+}
+
+static const BENCH_CODEC bench_codec_clear =
+{
+	"clearcodec", TRUE, bench_clear_new, bench_clear_free, bench_clear_reset, bench_clear_encode, bench_clear_decode
+};
+
+/* progressive */
+
+struct _BENCH_PROGRESSIVE
+{
+	BENCH_PROGRESSIVE_ENCODER* encoder;
+	PROGRESSIVE_CONTEXT* decoder;
+};
+typedef struct _BENCH_PROGRESSIVE BENCH_PROGRESSIVE;
+
+static void bench_progressive_free(void* context)
+{
+	BENCH_PROGRESSIVE* progressive = (BENCH_PROGRESSIVE*) context;
+
+	bench_progressive_encoder_free(progressive->encoder);
+
+	if (progressive->decoder)
+	{
+		progressive_delete_surface_context(progressive->decoder, 0);
+		progressive_context_free(progressive->decoder);
+	}
+
+	free(progressive);
+}
+
+static void* bench_progressive_new(UINT32 width, UINT32 height)
+{
+	BENCH_PROGRESSIVE* progressive = (BENCH_PROGRESSIVE*) calloc(1, sizeof(BENCH_PROGRESSIVE));
+
+	if (!progressive)
+		return NULL;
+
+	progressive->encoder = bench_progressive_encoder_new();
+	progressive->decoder = progressive_context_new(FALSE);
+
+	if (!progressive->encoder || !progressive->decoder ||
+			(progressive_create_surface_context(progressive->decoder, 0, width, height) < 0))
+	{
+		bench_progressive_free(progressive);
+		return NULL;
+	}
+
+	return progressive;
+}
+
+static void bench_progressive_reset(void* context)
+{
+	BENCH_PROGRESSIVE* progressive = (BENCH_PROGRESSIVE*) context;
+
+	bench_progressive_encoder_reset(progressive->encoder);
+}
+
+static int bench_progressive_encode(void* context, BYTE* pSrcData, UINT32 width, UINT32 height, UINT32 step, wStream* s)
+{
+	BENCH_PROGRESSIVE* progressive = (BENCH_PROGRESSIVE*) context;
+
+	return bench_progressive_compose(progressive->encoder, pSrcData, width, height, step, s);
+}
+
+static int bench_progressive_decode(void* context, BYTE* pSrcData, UINT32 SrcSize,
+		BYTE* pDstData, UINT32 width, UINT32 height, UINT32 step)
+{
+	UINT32 index;
+	UINT32 x, y;
+	RFX_PROGRESSIVE_TILE* tile;
+	PROGRESSIVE_BLOCK_REGION* region;
+	BENCH_PROGRESSIVE* progressive = (BENCH_PROGRESSIVE*) context;
+
+	if (progressive_decompress(progressive->decoder, pSrcData, SrcSize, &pDstData,
+			PIXEL_FORMAT_XRGB32, step, 0, 0, width, height, 0) < 0)
+		return -1;
+
+	/* the decoded tiles are copied to the surface the way gdi does it */
+
+	region = &(progressive->decoder->region);
+
+	for (index = 0; index < region->numTiles; index++)
+	{
+		tile = region->tiles[index];
+		x = tile->xIdx * 64;
+		y = tile->yIdx * 64;
+
+		if ((x >= width) || (y >= height))
+			continue;
+
+		freerdp_image_copy(pDstData, PIXEL_FORMAT_XRGB32, step, x, y, MIN(64, width - x), MIN(64, height - y),
+				tile->data, PIXEL_FORMAT_XRGB32, 64 * 4, 0, 0, NULL);
+	}
+
+	return 1;
+}
+
+static const BENCH_CODEC bench_codec_progressive =
+{
+	"progressive", FALSE, bench_progressive_new, bench_progressive_free, bench_progressive_reset,
+	bench_progressive_encode, bench_progressive_decode
+};
+
+/* H.264, only when libfreerdp was built with an encoding subsystem */
+
+struct _BENCH_H264
+{
+	H264_CONTEXT* encoder;
+	H264_CONTEXT* decoder;
+};
+typedef struct _BENCH_H264 BENCH_H264;
+
+static void bench_h264_free(void* context)
+{
+	BENCH_H264* h264 = (BENCH_H264*) context;
+
+	h264_context_free(h264->encoder);
+	h264_context_free(h264->decoder);
+	free(h264);
+}
+
+static void* bench_h264_new(UINT32 width, UINT32 height)
+{
+	BYTE* pFrame;
+	BYTE* pDstData = NULL;
+	UINT32 DstSize = 0;
+	BENCH_H264* h264 = (BENCH_H264*) calloc(1, sizeof(BENCH_H264));
+
+	if (!h264)
+		return NULL;
+
+	h264->encoder = h264_context_new(TRUE);
+	h264->decoder = h264_context_new(FALSE);
+	pFrame = (BYTE*) calloc(1, width * height * 4);
+
+	/* the dummy subsystem fails every compression */
+	if (!h264->encoder || !h264->decoder || !pFrame ||
+			(h264_compress(h264->encoder, pFrame, PIXEL_FORMAT_XRGB32, width * 4,
+					width, height, &pDstData, &DstSize) < 0))
+	{
+		free(pFrame);
+		bench_h264_free(h264);
+		return NULL;
+	}
+
+	free(pFrame);
+	return h264;
+}
+
+static void bench_h264_reset(void* context)
+{
+	BENCH_H264* h264 = (BENCH_H264*) context;
+
+	h264_context_reset(h264->encoder);
+	h264_context_reset(h264->decoder);
+}
+
+static int bench_h264_encode(void* context, BYTE* pSrcData, UINT32 width, UINT32 height, UINT32 step, wStream* s)
+{
+	BYTE* pDstData = NULL;
+	UINT32 DstSize = 0;
+	BENCH_H264* h264 = (BENCH_H264*) context;
+
+	if (h264_compress(h264->encoder, pSrcData, PIXEL_FORMAT_XRGB32, step, width, height, &pDstData, &DstSize) < 0)
+		return -1;
+
+	if (!Stream_EnsureRemainingCapacity(s, DstSize))
+		return -1;
+
+	Stream_Write(s, pDstData, DstSize);
+	return 1;
+}
+
+static int bench_h264_decode(void* context, BYTE* pSrcData, UINT32 SrcSize,
+		BYTE* pDstData, UINT32 width, UINT32 height, UINT32 step)
+{
+	RDPGFX_RECT16 rect;
+	BENCH_H264* h264 = (BENCH_H264*) context;
+
+	rect.left = 0;
+	rect.top = 0;
+	rect.right = width;
+	rect.bottom = height;
+
+	return h264_decompress(h264->decoder, pSrcData, SrcSize, &pDstData,
+			PIXEL_FORMAT_XRGB32, step, width, height, &rect, 1);
+}
+
+static const BENCH_CODEC bench_codec_h264 =
+{
+	"h264", FALSE, bench_h264_new, bench_h264_free, bench_h264_reset, bench_h264_encode, bench_h264_decode
+};
+
+/**
+ * Bulk compressors: each chunk is stored as its length and compression
+ * flags followed by the data, the compressed output or the chunk itself
+ * when the compressor left it uncompressed.
+ */
+
+#define BENCH_BULK_MPPC		0
+#define BENCH_BULK_NCRUSH	1
+#define BENCH_BULK_XCRUSH	2
+#define BENCH_BULK_ZGFX		3
+
+struct _BENCH_BULK
+{
+	int type;
+	void* encoder;
+	void* decoder;
+	BYTE* buffer;
+};
+typedef struct _BENCH_BULK BENCH_BULK;
+
+static void bench_bulk_free(void* context)
+{
+	BENCH_BULK* bulk = (BENCH_BULK*) context;
+
+	switch (bulk->type)
+	{
+		case BENCH_BULK_MPPC:
+			mppc_context_free((MPPC_CONTEXT*) bulk->encoder);
+			mppc_context_free((MPPC_CONTEXT*) bulk->decoder);
+			break;
+
+		case BENCH_BULK_NCRUSH:
+			ncrush_context_free((NCRUSH_CONTEXT*) bulk->encoder);
+			ncrush_context_free((NCRUSH_CONTEXT*) bulk->decoder);
+			break;
+
+		case BENCH_BULK_XCRUSH:
+			xcrush_context_free((XCRUSH_CONTEXT*) bulk->encoder);
+			xcrush_context_free((XCRUSH_CONTEXT*) bulk->decoder);
+			break;
+
+		case BENCH_BULK_ZGFX:
+			zgfx_context_free((ZGFX_CONTEXT*) bulk->encoder);
+			zgfx_context_free((ZGFX_CONTEXT*) bulk->decoder);
+			break;
+	}
+
+	free(bulk->buffer);
+	free(bulk);
+}
+
+static BENCH_BULK* bench_bulk_new(int type)
+{
+	BENCH_BULK* bulk = (BENCH_BULK*) calloc(1, sizeof(BENCH_BULK));
+
+	if (!bulk)
+		return NULL;
+
+	bulk->type = type;
+
+	switch (type)
+	{
+		case BENCH_BULK_MPPC:
+			bulk->encoder = mppc_context_new(1, TRUE);
+			bulk->decoder = mppc_context_new(1, FALSE);
+			break;
+
+		case BENCH_BULK_NCRUSH:
+			bulk->encoder = ncrush_context_new(TRUE);
+			bulk->decoder = ncrush_context_new(FALSE);
+			break;
+
+		case BENCH_BULK_XCRUSH:
+			bulk->encoder = xcrush_context_new(TRUE);
+			bulk->decoder = xcrush_context_new(FALSE);
+			break;
+
+		case BENCH_BULK_ZGFX:
+			bulk->encoder = zgfx_context_new(TRUE);
+			bulk->decoder = zgfx_context_new(FALSE);
+			break;
+	}
+
+	bulk->buffer = (BYTE*) malloc(BENCH_BULK_CHUNK_SIZE * 2);
+
+	if (!bulk->encoder || !bulk->decoder || !bulk->buffer)
+	{
+		bench_bulk_free(bulk);
+		return NULL;
+	}
+
+	return bulk;
+}
+
+static void bench_bulk_reset(void* context)
+{
+	BENCH_BULK* bulk = (BENCH_BULK*) context;
+
+	switch (bulk->type)
+	{
+		case BENCH_BULK_MPPC:
+			mppc_context_reset((MPPC_CONTEXT*) bulk->encoder, FALSE);
+			mppc_context_reset((MPPC_CONTEXT*) bulk->decoder, FALSE);
+			break;
+
+		case BENCH_BULK_NCRUSH:
+			ncrush_context_reset((NCRUSH_CONTEXT*) bulk->encoder, FALSE);
+			ncrush_context_reset((NCRUSH_CONTEXT*) bulk->decoder, FALSE);
+			break;
+
+		case BENCH_BULK_XCRUSH:
+			xcrush_context_reset((XCRUSH_CONTEXT*) bulk->encoder, FALSE);
+			xcrush_context_reset((XCRUSH_CONTEXT*) bulk->decoder, FALSE);
+			break;
+
+		case BENCH_BULK_ZGFX:
+			zgfx_context_reset((ZGFX_CONTEXT*) bulk->encoder, FALSE);
+			zgfx_context_reset((ZGFX_CONTEXT*) bulk->decoder, FALSE);
+			break;
+	}
+}
+
+static int bench_bulk_encode(void* context, BYTE* pSrcData, UINT32 width, UINT32 height, UINT32 step, wStream* s)
+{
+	int status = -1;
+	UINT32 flags;
+	UINT32 offset;
+	UINT32 SrcSize;
+	UINT32 DstSize;
+	BYTE* pDstData;
+	UINT32 size = height * step;
+	BENCH_BULK* bulk = (BENCH_BULK*) context;
+
+	for (offset = 0; offset < size; offset += SrcSize)
+	{
+		/* ZGFX splits large data into segments itself */
+		SrcSize = (bulk->type == BENCH_BULK_ZGFX) ? size : MIN(BENCH_BULK_CHUNK_SIZE, size - offset);
+
+		flags = 0;
+		pDstData = bulk->buffer;
+		DstSize = BENCH_BULK_CHUNK_SIZE * 2;
+
+		switch (bulk->type)
+		{
+			case BENCH_BULK_MPPC:
+				status = mppc_compress((MPPC_CONTEXT*) bulk->encoder, &pSrcData[offset], SrcSize,
+						&pDstData, &DstSize, &flags);
+				break;
+
+			case BENCH_BULK_NCRUSH:
+				status = ncrush_compress((NCRUSH_CONTEXT*) bulk->encoder, &pSrcData[offset], SrcSize,
+						&pDstData, &DstSize, &flags);
+				break;
+
+			case BENCH_BULK_XCRUSH:
+				status = xcrush_compress((XCRUSH_CONTEXT*) bulk->encoder, &pSrcData[offset], SrcSize,
+						&pDstData, &DstSize, &flags);
+				break;
+
+			case BENCH_BULK_ZGFX:
+				pDstData = NULL;
+				status = zgfx_compress((ZGFX_CONTEXT*) bulk->encoder, &pSrcData[offset], SrcSize,
+						&pDstData, &DstSize, &flags);
+				break;
+		}
+
+		if (status < 0)
+			return -1;
+
+		/* like fast-path, the chunk is sent as is when no compression flag is set */
+		if (!flags && (bulk->type != BENCH_BULK_ZGFX))
+		{
+			pDstData = &pSrcData[offset];
+			DstSize = SrcSize;
+		}
+
+		if (!Stream_EnsureRemainingCapacity(s, 8 + DstSize))
+			status = -1;
+		else
+		{
+			Stream_Write_UINT32(s, DstSize);
+			Stream_Write_UINT32(s, flags);
+			Stream_Write(s, pDstData, DstSize);
+		}
+
+		if (bulk->type == BENCH_BULK_ZGFX)
+			free(pDstData);
+
+		if (status < 0)
+			return -1;
+	}
+
+	return 1;
+}
+
+static int bench_bulk_decode(void* context, BYTE* pSrcData, UINT32 SrcSize,
+		BYTE* pDstData, UINT32 width, UINT32 height, UINT32 step)
+{
+	int status = -1;
+	UINT32 flags;
+	UINT32 length;
+	UINT32 offset = 0;
+	UINT32 position = 0;
+	UINT32 OutSize;
+	BYTE* pOutData;
+	UINT32 size = height * step;
+	BENCH_BULK* bulk = (BENCH_BULK*) context;
+
+	while (offset < SrcSize)
+	{
+		if ((SrcSize - offset) < 8)
+			return -1;
+
+		length = *((UINT32*) &pSrcData[offset]);
+		flags = *((UINT32*) &pSrcData[offset + 4]);
+		offset += 8;
+
+		if ((SrcSize - offset) < length)
+			return -1;
+
+		pOutData = &pSrcData[offset];
+		OutSize = length;
+		status = 1;
+
+		switch (bulk->type)
+		{
+			case BENCH_BULK_MPPC:
+				if (flags)
+					status = mppc_decompress((MPPC_CONTEXT*) bulk->decoder, &pSrcData[offset], length,
+							&pOutData, &OutSize, flags);
+				break;
+
+			case BENCH_BULK_NCRUSH:
+				if (flags)
+					status = ncrush_decompress((NCRUSH_CONTEXT*) bulk->decoder, &pSrcData[offset], length,
+							&pOutData, &OutSize, flags);
+				break;
+
+			case BENCH_BULK_XCRUSH:
+				if (flags)
+					status = xcrush_decompress((XCRUSH_CONTEXT*) bulk->decoder, &pSrcData[offset], length,
+							&pOutData, &OutSize, flags);
+				break;
+
+			case BENCH_BULK_ZGFX:
+				pOutData = NULL;
+				status = zgfx_decompress((ZGFX_CONTEXT*) bulk->decoder, &pSrcData[offset], length,
+						&pOutData, &OutSize, flags);
+				break;
+		}
+
+		if ((status >= 0) && ((size - position) >= OutSize))
+		{
+			CopyMemory(&pDstData[position], pOutData, OutSize);
+			position += OutSize;
+		}
+		else
+		{
+			status = -1;
+		}
+
+		if (bulk->type == BENCH_BULK_ZGFX)
+			free(pOutData);
+
+		if (status < 0)
+			return -1;
+
+		offset += length;
+	}
+
+	return (position == size) ? 1 : -1;
+}
+
+static void* bench_mppc_new(UINT32 width, UINT32 height)
+{
+	return bench_bulk_new(BENCH_BULK_MPPC);
+}
+
+static void* bench_ncrush_new(UINT32 width, UINT32 height)
+{
+	return bench_bulk_new(BENCH_BULK_NCRUSH);
+}
+
+static void* bench_xcrush_new(UINT32 width, UINT32 height)
+{
+	return bench_bulk_new(BENCH_BULK_XCRUSH);
+}
+
+static void* bench_zgfx_new(UINT32 width, UINT32 height)
+{
+	return bench_bulk_new(BENCH_BULK_ZGFX);
+}
+
+static const BENCH_CODEC bench_codec_mppc =
+{
+	"mppc", TRUE, bench_mppc_new, bench_bulk_free, bench_bulk_reset, bench_bulk_encode, bench_bulk_decode
+};
+
+static const BENCH_CODEC bench_codec_ncrush =
+{
+	"ncrush", TRUE, bench_ncrush_new, bench_bulk_free, bench_bulk_reset, bench_bulk_encode, bench_bulk_decode
+};
+
+static const BENCH_CODEC bench_codec_xcrush =
+{
+	"xcrush", TRUE, bench_xcrush_new, bench_bulk_free, bench_bulk_reset, bench_bulk_encode, bench_bulk_decode
+};
+
+static const BENCH_CODEC bench_codec_zgfx =
+{
+	"zgfx", TRUE, bench_zgfx_new, bench_bulk_free, bench_bulk_reset, bench_bulk_encode, bench_bulk_decode
+};
+
+const BENCH_CODEC* bench_codecs[] =
+{
+	&bench_codec_rfx,
+	&bench_codec_progressive,
+	&bench_codec_planar,
+	&bench_codec_interleaved,
+	&bench_codec_nsc,
+	&bench_codec_clear,
+	&bench_codec_zgfx,
+	&bench_codec_mppc,
+	&bench_codec_ncrush,
+	&bench_codec_xcrush,
+	&bench_codec_h264,
+	NULL
+};
@@ -0,0 +1,233 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Codec Benchmark Corpus
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "bench.h"
+
+/**
+ * The content is generated with integer arithmetic only, so that the
+ * frames do not depend on the floating point behavior of the platform
+ * and the compression ratios stay comparable to a stored baseline.
+ */
+
+static const char* bench_content_names[BENCH_CONTENT_COUNT] =
+{
+	"text",
+	"photo",
+	"gradient",
+	"scrolling"
+};
+
+#define BENCH_XRGB(_r, _g, _b)	(0xFF000000 | ((_r) << 16) | ((_g) << 8) | (_b))
+
+static UINT32 bench_hash(UINT32 a, UINT32 b)
+{
+	UINT32 h = (a * 0x9E3779B1) ^ (b * 0x85EBCA77);
+
+	h ^= h >> 15;
+	h *= 0xC2B2AE3D;
+	h ^= h >> 13;
+
+	return h;
+}
+
+/**
+ * Text: dark glyphs of 8x16 pixels on a light page with a gray margin.
+ * Glyph shapes come from a small alphabet so that they repeat the way
+ * characters of a font do. Successive frames type a few more characters
+ * on the line holding the caret, scrolling frames move the page up by
+ * a line and a few pixels.
+ */
+
+#define BENCH_TEXT_MARGIN		24
+#define BENCH_TEXT_LINE_HEIGHT		16
+#define BENCH_TEXT_GLYPH_WIDTH		8
+#define BENCH_TEXT_ALPHABET		40
+#define BENCH_TEXT_CARET_LINE		10
+
+static UINT32 bench_text_pixel(UINT32 x, UINT32 y, UINT32 typed)
+{
+	UINT32 line;
+	UINT32 row;
+	UINT32 column;
+	UINT32 glyph;
+	UINT32 length;
+
+	if (x < BENCH_TEXT_MARGIN)
+		return BENCH_XRGB(0xF0, 0xF0, 0xF0);
+
+	line = y / BENCH_TEXT_LINE_HEIGHT;
+	row = y % BENCH_TEXT_LINE_HEIGHT;
+	column = (x - BENCH_TEXT_MARGIN) / BENCH_TEXT_GLYPH_WIDTH;
+
+	length = bench_hash(line, 0) % 120;
+
+	if (line == BENCH_TEXT_CARET_LINE)
+		length = 20 + typed;
+
+	if ((column >= length) || (row < 3) || (row > 13))
+		return BENCH_XRGB(0xFF, 0xFF, 0xFF);
+
+	glyph = bench_hash(line, column + 1) % BENCH_TEXT_ALPHABET;
+
+	if (glyph < 6) /* space */
+		return BENCH_XRGB(0xFF, 0xFF, 0xFF);
+
+	if ((bench_hash(glyph, row) >> ((x - BENCH_TEXT_MARGIN) % BENCH_TEXT_GLYPH_WIDTH)) & 1)
+	{
+		/* every seventh line is a link */
+		return ((line % 7) == 3) ? BENCH_XRGB(0x10, 0x40, 0xC0) : BENCH_XRGB(0x20, 0x20, 0x20);
+	}
+
+	return BENCH_XRGB(0xFF, 0xFF, 0xFF);
+}
+
+/**
+ * Photo: two octaves of bilinearly interpolated value noise with some
+ * per pixel grain. Successive frames pan the picture.
+ */
+
+static int bench_noise(UINT32 x, UINT32 y, UINT32 cell, UINT32 channel)
+{
+	UINT32 ix = x / cell;
+	UINT32 iy = y / cell;
+	int fx = (int) (x % cell);
+	int fy = (int) (y % cell);
+	int v00, v01, v10, v11;
+	int top, bottom;
+
+	v00 = bench_hash(ix + (channel << 20), iy) & 0xFF;
+	v01 = bench_hash(ix + 1 + (channel << 20), iy) & 0xFF;
+	v10 = bench_hash(ix + (channel << 20), iy + 1) & 0xFF;
+	v11 = bench_hash(ix + 1 + (channel << 20), iy + 1) & 0xFF;
+
+	top = (v00 * ((int) cell - fx)) + (v01 * fx);
+	bottom = (v10 * ((int) cell - fx)) + (v11 * fx);
+
+	return ((top * ((int) cell - fy)) + (bottom * fy)) / (int) (cell * cell);
+}
+
+static UINT32 bench_photo_pixel(UINT32 x, UINT32 y, UINT32* seed)
+{
+	int value[3];
+	UINT32 channel;
+
+	for (channel = 0; channel < 3; channel++)
+	{
+		*seed = *seed * 1103515245 + 12345;
+
+		value[channel] = ((bench_noise(x, y, 64, channel) * 3) + bench_noise(x, y, 8, channel + 3)) / 4;
+		value[channel] += (int) ((*seed >> 16) % 13) - 6;
+
+		if (value[channel] < 0)
+			value[channel] = 0;
+		else if (value[channel] > 255)
+			value[channel] = 255;
+	}
+
+	return BENCH_XRGB(value[0], value[1], value[2]);
+}
+
+/**
+ * Gradient: smooth horizontal, vertical and diagonal ramps, the diagonal
+ * one moves from frame to frame.
+ */
+
+static UINT32 bench_gradient_pixel(UINT32 x, UINT32 y, UINT32 width, UINT32 height, UINT32 frame)
+{
+	UINT32 r, g, b;
+
+	r = (x * 255) / (width - 1);
+	g = (y * 255) / (height - 1);
+	b = (((x + y + (frame * 8)) * 255) / (width + height)) & 0xFF;
+
+	return BENCH_XRGB(r, g, b);
+}
+
+BOOL bench_corpus_init(BENCH_CORPUS* corpus, int content, UINT32 width, UINT32 height)
+{
+	UINT32 x, y;
+	UINT32 frame;
+	UINT32 seed;
+	UINT32* pixel;
+
+	ZeroMemory(corpus, sizeof(BENCH_CORPUS));
+
+	if ((content < 0) || (content >= BENCH_CONTENT_COUNT) || (width < 2) || (height < 2))
+		return FALSE;
+
+	corpus->name = bench_content_names[content];
+	corpus->width = width;
+	corpus->height = height;
+	corpus->step = width * 4;
+
+	for (frame = 0; frame < BENCH_FRAME_COUNT; frame++)
+	{
+		corpus->frames[frame] = (BYTE*) _aligned_malloc(corpus->step * height, 16);
+
+		if (!corpus->frames[frame])
+		{
+			bench_corpus_uninit(corpus);
+			return FALSE;
+		}
+
+		seed = 0x12345678 + frame;
+
+		for (y = 0; y < height; y++)
+		{
+			pixel = (UINT32*) &corpus->frames[frame][y * corpus->step];
+
+			for (x = 0; x < width; x++)
+			{
+				switch (content)
+				{
+					case BENCH_CONTENT_TEXT:
+						pixel[x] = bench_text_pixel(x, y, frame * 6);
+						break;
+
+					case BENCH_CONTENT_PHOTO:
+						pixel[x] = bench_photo_pixel(x + (frame * 5), y + (frame * 3), &seed);
+						break;
+
+					case BENCH_CONTENT_GRADIENT:
+						pixel[x] = bench_gradient_pixel(x, y, width, height, frame);
+						break;
+
+					case BENCH_CONTENT_SCROLLING:
+						pixel[x] = bench_text_pixel(x, y + (frame * (BENCH_TEXT_LINE_HEIGHT + 4)), 0);
+						break;
+				}
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+void bench_corpus_uninit(BENCH_CORPUS* corpus)
+{
+	UINT32 frame;
+
+	for (frame = 0; frame < BENCH_FRAME_COUNT; frame++)
+	{
+		_aligned_free(corpus->frames[frame]);
+		corpus->frames[frame] = NULL;
+	}
+}
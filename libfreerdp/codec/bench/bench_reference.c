@@ -0,0 +1,476 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Codec Benchmark Reference Encoders
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <freerdp/primitives.h>
+#include <freerdp/codec/progressive.h>
+
+#include "../rfx_rlgr.h"
+#include "../rfx_differential.h"
+
+#include "bench.h"
+
+/**
+ * libfreerdp has decoders only for the progressive codec and ClearCodec,
+ * the encoders below produce the simplest valid streams for them so that
+ * the decoders can be measured on the same corpus as the other codecs:
+ * progressive frames made of TILE_SIMPLE blocks with a single quantization,
+ * ClearCodec frames made of the residual layer alone.
+ */
+
+struct _BENCH_PROGRESSIVE_ENCODER
+{
+	BOOL sync;
+	UINT32 frameIndex;
+	BYTE* planes;
+	INT16* coeffs;
+	INT16* temp;
+	BYTE* entropy;
+};
+
+#define BENCH_PROGRESSIVE_ENTROPY_SIZE	8192
+
+struct _BENCH_PROGRESSIVE_BAND
+{
+	UINT32 offset;
+	UINT32 length;
+	UINT32 quant;
+};
+typedef struct _BENCH_PROGRESSIVE_BAND BENCH_PROGRESSIVE_BAND;
+
+/* the default RemoteFX quantization, stored in the layout of progressive_rfx_decode_component */
+static const BENCH_PROGRESSIVE_BAND bench_progressive_bands[10] =
+{
+	{ 0, 1023, 8 }, /* HL1 */
+	{ 1023, 1023, 8 }, /* LH1 */
+	{ 2046, 961, 9 }, /* HH1 */
+	{ 3007, 272, 7 }, /* HL2 */
+	{ 3279, 272, 7 }, /* LH2 */
+	{ 3551, 256, 8 }, /* HH2 */
+	{ 3807, 72, 6 }, /* HL3 */
+	{ 3879, 72, 6 }, /* LH3 */
+	{ 3951, 64, 6 }, /* HH3 */
+	{ 4015, 81, 6 } /* LL3 */
+};
+
+/* LL3 | HL3 << 4, LH3 | HH3 << 4, HL2 | LH2 << 4, HH2 | HL1 << 4, LH1 | HH1 << 4 */
+static const BYTE bench_progressive_quant[5] = { 0x66, 0x66, 0x77, 0x88, 0x98 };
+
+/**
+ * One level of the reduce-extrapolate 5/3 wavelet, the inverse of
+ * progressive_rfx_idwt_x and progressive_rfx_idwt_y: n input samples give
+ * (64 >> level) + 1 low and n - that many high band samples.
+ */
+
+static void bench_progressive_dwt(const INT16* pX, int nXStep, INT16* pL, int nLStep,
+		INT16* pH, int nHStep, int level)
+{
+	int k;
+	int nHigh;
+	INT16 H0;
+
+	nHigh = (level == 1) ? 31 : (64 >> level);
+
+	for (k = 0; k < nHigh; k++)
+	{
+		pH[k * nHStep] = (pX[(2 * k + 1) * nXStep] -
+				((pX[(2 * k) * nXStep] + pX[(2 * k + 2) * nXStep]) / 2)) / 2;
+	}
+
+	for (k = 0; k < nHigh; k++)
+	{
+		H0 = k ? pH[(k - 1) * nHStep] : pH[0];
+		pL[k * nLStep] = pX[(2 * k) * nXStep] + ((H0 + pH[k * nHStep]) / 2);
+	}
+
+	if (level == 1)
+	{
+		pL[31 * nLStep] = pX[62 * nXStep] + (pH[30 * nHStep] / 2);
+		pL[32 * nLStep] = (2 * pX[63 * nXStep]) - pX[62 * nXStep];
+	}
+	else
+	{
+		pL[nHigh * nLStep] = pX[(2 * nHigh) * nXStep] + pH[(nHigh - 1) * nHStep];
+	}
+}
+
+static void bench_progressive_dwt_2d(INT16* pSrc, INT16* pDst, INT16* temp, int level)
+{
+	int i;
+	int nBandL;
+	int nBandH;
+	int nSize;
+	INT16 *HL, *LH, *HH, *LL;
+	INT16 *L, *H;
+
+	nBandL = (64 >> level) + 1;
+	nBandH = (level == 1) ? 31 : (64 >> level);
+	nSize = nBandL + nBandH;
+
+	L = &temp[0];
+	H = &temp[nBandL * nSize];
+
+	/* vertical (X -> L + H), the source may overlap the destination */
+
+	for (i = 0; i < nSize; i++)
+		bench_progressive_dwt(&pSrc[i], nSize, &L[i], nSize, &H[i], nSize, level);
+
+	HL = &pDst[0];
+	LH = &HL[nBandH * nBandL];
+	HH = &LH[nBandL * nBandH];
+	LL = &HH[nBandH * nBandH];
+
+	/* horizontal (L -> LL + HL, H -> LH + HH) */
+
+	for (i = 0; i < nBandL; i++)
+		bench_progressive_dwt(&L[i * nSize], 1, &LL[i * nBandL], 1, &HL[i * nBandH], 1, level);
+
+	for (i = 0; i < nBandH; i++)
+		bench_progressive_dwt(&H[i * nSize], 1, &LH[i * nBandL], 1, &HH[i * nBandH], 1, level);
+}
+
+static int bench_progressive_encode_component(BENCH_PROGRESSIVE_ENCODER* encoder, INT16* pSrc, wStream* s)
+{
+	int size;
+	UINT32 band;
+	UINT32 index;
+	UINT32 shift;
+	INT16* coeffs = encoder->coeffs;
+
+	bench_progressive_dwt_2d(pSrc, &coeffs[0], encoder->temp, 1);
+	bench_progressive_dwt_2d(&coeffs[3007], &coeffs[3007], encoder->temp, 2);
+	bench_progressive_dwt_2d(&coeffs[3807], &coeffs[3807], encoder->temp, 3);
+
+	for (band = 0; band < 10; band++)
+	{
+		shift = bench_progressive_bands[band].quant - 1;
+
+		for (index = 0; index < bench_progressive_bands[band].length; index++)
+		{
+			INT16* value = &coeffs[bench_progressive_bands[band].offset + index];
+			*value = (*value + (1 << (shift - 1))) >> shift;
+		}
+	}
+
+	rfx_differential_encode(&coeffs[4015], 81);
+
+	/* the RLGR encoder expects a zeroed buffer */
+	ZeroMemory(encoder->entropy, BENCH_PROGRESSIVE_ENTROPY_SIZE);
+	size = rfx_rlgr_encode(RLGR1, coeffs, 4096, encoder->entropy, BENCH_PROGRESSIVE_ENTROPY_SIZE);
+
+	if ((size <= 0) || (size > 0xFFFF))
+		return -1;
+
+	if (!Stream_EnsureRemainingCapacity(s, size))
+		return -1;
+
+	Stream_Write(s, encoder->entropy, size);
+	return size;
+}
+
+static int bench_progressive_encode_tile(BENCH_PROGRESSIVE_ENCODER* encoder, BYTE* pSrcData,
+		UINT32 width, UINT32 height, UINT32 step, UINT32 xIdx, UINT32 yIdx, wStream* s)
+{
+	int size;
+	int length[3];
+	UINT32 x, y;
+	UINT32 nx, ny;
+	size_t start;
+	size_t header;
+	BYTE* pixel;
+	INT16* pSrcDst[3];
+	primitives_t* prims = primitives_get();
+	static const prim_size_t roi_64x64 = { 64, 64 };
+
+	pSrcDst[0] = (INT16*) &encoder->planes[((8192 + 32) * 0) + 16];
+	pSrcDst[1] = (INT16*) &encoder->planes[((8192 + 32) * 1) + 16];
+	pSrcDst[2] = (INT16*) &encoder->planes[((8192 + 32) * 2) + 16];
+
+	/* pixels past the right and bottom edges repeat the last column and row */
+
+	for (y = 0; y < 64; y++)
+	{
+		ny = (yIdx * 64) + y;
+
+		if (ny >= height)
+			ny = height - 1;
+
+		for (x = 0; x < 64; x++)
+		{
+			nx = (xIdx * 64) + x;
+
+			if (nx >= width)
+				nx = width - 1;
+
+			pixel = &pSrcData[(ny * step) + (nx * 4)];
+
+			pSrcDst[0][(y * 64) + x] = pixel[2];
+			pSrcDst[1][(y * 64) + x] = pixel[1];
+			pSrcDst[2][(y * 64) + x] = pixel[0];
+		}
+	}
+
+	prims->RGBToYCbCr_16s16s_P3P3((const INT16**) pSrcDst, 64 * sizeof(INT16),
+			pSrcDst, 64 * sizeof(INT16), &roi_64x64);
+
+	if (!Stream_EnsureRemainingCapacity(s, 22))
+		return -1;
+
+	start = Stream_GetPosition(s);
+
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_TILE_SIMPLE); /* blockType (2 bytes) */
+	Stream_Seek_UINT32(s); /* blockLen (4 bytes) */
+	Stream_Write_UINT8(s, 0); /* quantIdxY (1 byte) */
+	Stream_Write_UINT8(s, 0); /* quantIdxCb (1 byte) */
+	Stream_Write_UINT8(s, 0); /* quantIdxCr (1 byte) */
+	Stream_Write_UINT16(s, xIdx); /* xIdx (2 bytes) */
+	Stream_Write_UINT16(s, yIdx); /* yIdx (2 bytes) */
+	Stream_Write_UINT8(s, 0); /* flags (1 byte) */
+	header = Stream_GetPosition(s);
+	Stream_Seek(s, 8); /* yLen, cbLen, crLen, tailLen (8 bytes) */
+
+	for (x = 0; x < 3; x++)
+	{
+		if ((length[x] = bench_progressive_encode_component(encoder, pSrcDst[x], s)) < 0)
+			return -1;
+	}
+
+	size = (int) (Stream_GetPosition(s) - start);
+
+	Stream_SetPosition(s, start + 2);
+	Stream_Write_UINT32(s, size); /* blockLen (4 bytes) */
+	Stream_SetPosition(s, header);
+	Stream_Write_UINT16(s, length[0]); /* yLen (2 bytes) */
+	Stream_Write_UINT16(s, length[1]); /* cbLen (2 bytes) */
+	Stream_Write_UINT16(s, length[2]); /* crLen (2 bytes) */
+	Stream_Write_UINT16(s, 0); /* tailLen (2 bytes) */
+	Stream_SetPosition(s, start + size);
+
+	return 1;
+}
+
+int bench_progressive_compose(BENCH_PROGRESSIVE_ENCODER* encoder, BYTE* pSrcData,
+		UINT32 width, UINT32 height, UINT32 step, wStream* s)
+{
+	UINT32 xIdx;
+	UINT32 yIdx;
+	UINT32 gridWidth;
+	UINT32 gridHeight;
+	size_t region;
+	size_t tiles;
+	UINT32 regionLen;
+
+	gridWidth = (width + 63) / 64;
+	gridHeight = (height + 63) / 64;
+
+	if (!Stream_EnsureRemainingCapacity(s, 12 + 12 + 10 + 18 + 8 + 5))
+		return -1;
+
+	if (!encoder->sync)
+	{
+		Stream_Write_UINT16(s, PROGRESSIVE_WBT_SYNC); /* blockType (2 bytes) */
+		Stream_Write_UINT32(s, 12); /* blockLen (4 bytes) */
+		Stream_Write_UINT32(s, 0xCACCACCA); /* magic (4 bytes) */
+		Stream_Write_UINT16(s, 0x0100); /* version (2 bytes) */
+
+		Stream_Write_UINT16(s, PROGRESSIVE_WBT_CONTEXT); /* blockType (2 bytes) */
+		Stream_Write_UINT32(s, 10); /* blockLen (4 bytes) */
+		Stream_Write_UINT8(s, 0); /* ctxId (1 byte) */
+		Stream_Write_UINT16(s, 64); /* tileSize (2 bytes) */
+		Stream_Write_UINT8(s, 0); /* flags (1 byte) */
+
+		encoder->sync = TRUE;
+	}
+
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_FRAME_BEGIN); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, 12); /* blockLen (4 bytes) */
+	Stream_Write_UINT32(s, encoder->frameIndex++); /* frameIndex (4 bytes) */
+	Stream_Write_UINT16(s, 1); /* regionCount (2 bytes) */
+
+	region = Stream_GetPosition(s);
+
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_REGION); /* blockType (2 bytes) */
+	Stream_Seek_UINT32(s); /* blockLen (4 bytes) */
+	Stream_Write_UINT8(s, 64); /* tileSize (1 byte) */
+	Stream_Write_UINT16(s, 1); /* numRects (2 bytes) */
+	Stream_Write_UINT8(s, 1); /* numQuant (1 byte) */
+	Stream_Write_UINT8(s, 0); /* numProgQuant (1 byte) */
+	Stream_Write_UINT8(s, RFX_DWT_REDUCE_EXTRAPOLATE); /* flags (1 byte) */
+	Stream_Write_UINT16(s, gridWidth * gridHeight); /* numTiles (2 bytes) */
+	Stream_Seek_UINT32(s); /* tileDataSize (4 bytes) */
+
+	Stream_Write_UINT16(s, 0); /* x (2 bytes) */
+	Stream_Write_UINT16(s, 0); /* y (2 bytes) */
+	Stream_Write_UINT16(s, width); /* width (2 bytes) */
+	Stream_Write_UINT16(s, height); /* height (2 bytes) */
+
+	Stream_Write(s, bench_progressive_quant, 5); /* quantVals (5 bytes) */
+
+	tiles = Stream_GetPosition(s);
+
+	for (yIdx = 0; yIdx < gridHeight; yIdx++)
+	{
+		for (xIdx = 0; xIdx < gridWidth; xIdx++)
+		{
+			if (bench_progressive_encode_tile(encoder, pSrcData, width, height, step, xIdx, yIdx, s) < 0)
+				return -1;
+		}
+	}
+
+	regionLen = (UINT32) (Stream_GetPosition(s) - region);
+
+	Stream_SetPosition(s, region + 2);
+	Stream_Write_UINT32(s, regionLen); /* blockLen (4 bytes) */
+	Stream_SetPosition(s, region + 14);
+	Stream_Write_UINT32(s, (UINT32) (region + regionLen - tiles)); /* tileDataSize (4 bytes) */
+	Stream_SetPosition(s, region + regionLen);
+
+	if (!Stream_EnsureRemainingCapacity(s, 6))
+		return -1;
+
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_FRAME_END); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, 6); /* blockLen (4 bytes) */
+
+	return 1;
+}
+
+void bench_progressive_encoder_reset(BENCH_PROGRESSIVE_ENCODER* encoder)
+{
+	encoder->sync = FALSE;
+	encoder->frameIndex = 0;
+}
+
+BENCH_PROGRESSIVE_ENCODER* bench_progressive_encoder_new(void)
+{
+	BENCH_PROGRESSIVE_ENCODER* encoder;
+
+	encoder = (BENCH_PROGRESSIVE_ENCODER*) calloc(1, sizeof(BENCH_PROGRESSIVE_ENCODER));
+
+	if (!encoder)
+		return NULL;
+
+	encoder->planes = (BYTE*) _aligned_malloc((8192 + 32) * 3, 16);
+	encoder->coeffs = (INT16*) _aligned_malloc(4096 * sizeof(INT16), 16);
+	encoder->temp = (INT16*) _aligned_malloc(4096 * sizeof(INT16), 16);
+	encoder->entropy = (BYTE*) malloc(BENCH_PROGRESSIVE_ENTROPY_SIZE);
+
+	if (!encoder->planes || !encoder->coeffs || !encoder->temp || !encoder->entropy)
+	{
+		bench_progressive_encoder_free(encoder);
+		return NULL;
+	}
+
+	return encoder;
+}
+
+void bench_progressive_encoder_free(BENCH_PROGRESSIVE_ENCODER* encoder)
+{
+	if (!encoder)
+		return;
+
+	_aligned_free(encoder->planes);
+	_aligned_free(encoder->coeffs);
+	_aligned_free(encoder->temp);
+	free(encoder->entropy);
+	free(encoder);
+}
+
+/**
+ * ClearCodec residual layer: runs of identical pixels in raster order,
+ * each a BGR color followed by a run length of 1, 3 or 7 bytes.
+ */
+
+static BOOL bench_clear_write_run(wStream* s, UINT32 color, UINT32 run)
+{
+	if (!Stream_EnsureRemainingCapacity(s, 10))
+		return FALSE;
+
+	Stream_Write_UINT8(s, color & 0xFF); /* blueValue (1 byte) */
+	Stream_Write_UINT8(s, (color >> 8) & 0xFF); /* greenValue (1 byte) */
+	Stream_Write_UINT8(s, (color >> 16) & 0xFF); /* redValue (1 byte) */
+
+	if (run < 0xFF)
+	{
+		Stream_Write_UINT8(s, run); /* runLengthFactor1 (1 byte) */
+	}
+	else if (run < 0xFFFF)
+	{
+		Stream_Write_UINT8(s, 0xFF); /* runLengthFactor1 (1 byte) */
+		Stream_Write_UINT16(s, run); /* runLengthFactor2 (2 bytes) */
+	}
+	else
+	{
+		Stream_Write_UINT8(s, 0xFF); /* runLengthFactor1 (1 byte) */
+		Stream_Write_UINT16(s, 0xFFFF); /* runLengthFactor2 (2 bytes) */
+		Stream_Write_UINT32(s, run); /* runLengthFactor3 (4 bytes) */
+	}
+
+	return TRUE;
+}
+
+int bench_clear_compose(BYTE seqNumber, BYTE* pSrcData, UINT32 width, UINT32 height, UINT32 step, wStream* s)
+{
+	UINT32 x, y;
+	UINT32 run = 0;
+	UINT32 color = 0;
+	UINT32 pixel;
+	size_t residual;
+	UINT32 residualByteCount;
+
+	if (!Stream_EnsureRemainingCapacity(s, 14))
+		return -1;
+
+	Stream_Write_UINT8(s, 0); /* glyphFlags (1 byte) */
+	Stream_Write_UINT8(s, seqNumber); /* seqNumber (1 byte) */
+	residual = Stream_GetPosition(s);
+	Stream_Seek_UINT32(s); /* residualByteCount (4 bytes) */
+	Stream_Write_UINT32(s, 0); /* bandsByteCount (4 bytes) */
+	Stream_Write_UINT32(s, 0); /* subcodecByteCount (4 bytes) */
+
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			pixel = *((UINT32*) &pSrcData[(y * step) + (x * 4)]) & 0x00FFFFFF;
+
+			if (run && (pixel == color))
+			{
+				run++;
+				continue;
+			}
+
+			if (run && !bench_clear_write_run(s, color, run))
+				return -1;
+
+			color = pixel;
+			run = 1;
+		}
+	}
+
+	if (!bench_clear_write_run(s, color, run))
+		return -1;
+
+	residualByteCount = (UINT32) (Stream_GetPosition(s) - residual - 12);
+	Stream_SetPosition(s, residual);
+	Stream_Write_UINT32(s, residualByteCount); /* residualByteCount (4 bytes) */
+	Stream_Seek(s, 8 + residualByteCount);
+
+	return 1;
+}
@@ -169,7 +169,7 @@
 			temp = (0x4 << 5) | in_count; \
 			Stream_Write_UINT8(in_s, temp); \
 			temp = in_count * 3; \
-			Stream_Write(in_s, Stream_Pointer(in_data), temp); \
+			Stream_Write(in_s, Stream_Buffer(in_data), temp); \
 		} \
 		else if (in_count < 256 + 32) \
 		{ \
@@ -177,14 +177,14 @@
 			temp = in_count - 32; \
 			Stream_Write_UINT8(in_s, temp); \
 			temp = in_count * 3; \
-			Stream_Write(in_s, Stream_Pointer(in_data), temp); \
+			Stream_Write(in_s, Stream_Buffer(in_data), temp); \
 		} \
 		else \
 		{ \
 			Stream_Write_UINT8(in_s, 0xf4); \
 			Stream_Write_UINT16(in_s, in_count); \
 			temp = in_count * 3; \
-			Stream_Write(in_s, Stream_Pointer(in_data), temp); \
+			Stream_Write(in_s, Stream_Buffer(in_data), temp); \
 		} \
 	} \
 	in_count = 0; \
@@ -2178,93 +2178,25 @@ int freerdp_image15_copy(BYTE* pDstData, DWORD DstFormat, int nDstStep, int nXDs
 	{
 		if ((dstBitsPerPixel == 32) || (dstBitsPerPixel == 24))
 		{
-			UINT16* pSrcPixel;
-			UINT32* pDstPixel;
+			primitives_t* prims = primitives_get();
+			BYTE* pSrcPixel = &pSrcData[(nYSrc * nSrcStep) + (nXSrc * 2)];
+			BYTE* pDstPixel = &pDstData[(nYDst * nDstStep) + (nXDst * 4)];
 
-			if (!invert)
+			if (!vFlip)
 			{
-				if (!vFlip)
-				{
-					pSrcPixel = (UINT16*) &pSrcData[(nYSrc * nSrcStep) + (nXSrc * 2)];
-					pDstPixel = (UINT32*) &pDstData[(nYDst * nDstStep) + (nXDst * 4)];
-
-					for (y = 0; y < nHeight; y++)
-					{
-						for (x = 0; x < nWidth; x++)
-						{
-							GetRGB15(r, g, b, *pSrcPixel);
-							*pDstPixel = ARGB32(0xFF, r, g, b);
-
-							pSrcPixel++;
-							pDstPixel++;
-						}
-
-						pSrcPixel = (UINT16*) &((BYTE*) pSrcPixel)[nSrcPad];
-						pDstPixel = (UINT32*) &((BYTE*) pDstPixel)[nDstPad];
-					}
-				}
-				else
-				{
-					pSrcPixel = (UINT16*) &pSrcData[((nYSrc + nHeight - 1) * nSrcStep) + (nXSrc * 2)];
-					pDstPixel = (UINT32*) &pDstData[(nYDst * nDstStep) + (nXDst * 4)];
-
-					for (y = 0; y < nHeight; y++)
-					{
-						for (x = 0; x < nWidth; x++)
-						{
-							GetRGB15(r, g, b, *pSrcPixel);
-							*pDstPixel = ARGB32(0xFF, r, g, b);
-
-							pSrcPixel++;
-							pDstPixel++;
-						}
-
-						pSrcPixel = (UINT16*) &((BYTE*) pSrcPixel)[-((nSrcStep - nSrcPad) + nSrcStep)];
-						pDstPixel = (UINT32*) &((BYTE*) pDstPixel)[nDstPad];
-					}
-				}
+				prims->RGB555ToARGB_16u32u_C3C4((UINT16*) pSrcPixel, nSrcStep,
+						(UINT32*) pDstPixel, nDstStep, nWidth, nHeight, TRUE, invert);
 			}
 			else
 			{
-				if (!vFlip)
-				{
-					pSrcPixel = (UINT16*) &pSrcData[(nYSrc * nSrcStep) + (nXSrc * 2)];
-					pDstPixel = (UINT32*) &pDstData[(nYDst * nDstStep) + (nXDst * 4)];
-
-					for (y = 0; y < nHeight; y++)
-					{
-						for (x = 0; x < nWidth; x++)
-						{
-							GetRGB15(r, g, b, *pSrcPixel);
-							*pDstPixel = ABGR32(0xFF, r, g, b);
-
-							pSrcPixel++;
-							pDstPixel++;
-						}
+				pSrcPixel = &pSrcPixel[(nHeight - 1) * nSrcStep];
 
-						pSrcPixel = (UINT16*) &((BYTE*) pSrcPixel)[nSrcPad];
-						pDstPixel = (UINT32*) &((BYTE*) pDstPixel)[nDstPad];
-					}
-				}
-				else
+				for (y = 0; y < nHeight; y++)
 				{
-					pSrcPixel = (UINT16*) &pSrcData[((nYSrc + nHeight - 1) * nSrcStep) + (nXSrc * 2)];
-					pDstPixel = (UINT32*) &pDstData[(nYDst * nDstStep) + (nXDst * 4)];
-
-					for (y = 0; y < nHeight; y++)
-					{
-						for (x = 0; x < nWidth; x++)
-						{
-							GetRGB15(r, g, b, *pSrcPixel);
-							*pDstPixel = ABGR32(0xFF, r, g, b);
-
-							pSrcPixel++;
-							pDstPixel++;
-						}
-
-						pSrcPixel = (UINT16*) &((BYTE*) pSrcPixel)[-((nSrcStep - nSrcPad) + nSrcStep)];
-						pDstPixel = (UINT32*) &((BYTE*) pDstPixel)[nDstPad];
-					}
+					prims->RGB555ToARGB_16u32u_C3C4((UINT16*) pSrcPixel, nSrcStep,
+							(UINT32*) pDstPixel, nDstStep, nWidth, 1, TRUE, invert);
+					pSrcPixel = &pSrcPixel[-nSrcStep];
+					pDstPixel = &pDstPixel[nDstStep];
 				}
 			}
 
@@ -2512,93 +2444,25 @@ int freerdp_image16_copy(BYTE* pDstData, DWORD DstFormat, int nDstStep, int nXDs
 	{
 		if ((dstBitsPerPixel == 32) || (dstBitsPerPixel == 24))
 		{
-			UINT16* pSrcPixel;
-			UINT32* pDstPixel;
+			primitives_t* prims = primitives_get();
+			BYTE* pSrcPixel = &pSrcData[(nYSrc * nSrcStep) + (nXSrc * 2)];
+			BYTE* pDstPixel = &pDstData[(nYDst * nDstStep) + (nXDst * 4)];
 
-			if (!invert)
+			if (!vFlip)
 			{
-				if (!vFlip)
-				{
-					pSrcPixel = (UINT16*) &pSrcData[(nYSrc * nSrcStep) + (nXSrc * 2)];
-					pDstPixel = (UINT32*) &pDstData[(nYDst * nDstStep) + (nXDst * 4)];
-
-					for (y = 0; y < nHeight; y++)
-					{
-						for (x = 0; x < nWidth; x++)
-						{
-							GetRGB16(r, g, b, *pSrcPixel);
-							*pDstPixel = ARGB32(0xFF, r, g, b);
-
-							pSrcPixel++;
-							pDstPixel++;
-						}
-
-						pSrcPixel = (UINT16*) &((BYTE*) pSrcPixel)[nSrcPad];
-						pDstPixel = (UINT32*) &((BYTE*) pDstPixel)[nDstPad];
-					}
-				}
-				else
-				{
-					pSrcPixel = (UINT16*) &pSrcData[((nYSrc + nHeight - 1) * nSrcStep) + (nXSrc * 2)];
-					pDstPixel = (UINT32*) &pDstData[(nYDst * nDstStep) + (nXDst * 4)];
-
-					for (y = 0; y < nHeight; y++)
-					{
-						for (x = 0; x < nWidth; x++)
-						{
-							GetRGB16(r, g, b, *pSrcPixel);
-							*pDstPixel = ARGB32(0xFF, r, g, b);
-
-							pSrcPixel++;
-							pDstPixel++;
-						}
-
-						pSrcPixel = (UINT16*) &((BYTE*) pSrcPixel)[-((nSrcStep - nSrcPad) + nSrcStep)];
-						pDstPixel = (UINT32*) &((BYTE*) pDstPixel)[nDstPad];
-					}
-				}
+				prims->RGB565ToARGB_16u32u_C3C4((UINT16*) pSrcPixel, nSrcStep,
+						(UINT32*) pDstPixel, nDstStep, nWidth, nHeight, TRUE, invert);
 			}
 			else
 			{
-				if (!vFlip)
-				{
-					pSrcPixel = (UINT16*) &pSrcData[(nYSrc * nSrcStep) + (nXSrc * 2)];
-					pDstPixel = (UINT32*) &pDstData[(nYDst * nDstStep) + (nXDst * 4)];
+				pSrcPixel = &pSrcPixel[(nHeight - 1) * nSrcStep];
 
-					for (y = 0; y < nHeight; y++)
-					{
-						for (x = 0; x < nWidth; x++)
-						{
-							GetRGB16(r, g, b, *pSrcPixel);
-							*pDstPixel = ABGR32(0xFF, r, g, b);
-
-							pSrcPixel++;
-							pDstPixel++;
-						}
-
-						pSrcPixel = (UINT16*) &((BYTE*) pSrcPixel)[nSrcPad];
-						pDstPixel = (UINT32*) &((BYTE*) pDstPixel)[nDstPad];
-					}
-				}
-				else
+				for (y = 0; y < nHeight; y++)
 				{
-					pSrcPixel = (UINT16*) &pSrcData[((nYSrc + nHeight - 1) * nSrcStep) + (nXSrc * 2)];
-					pDstPixel = (UINT32*) &pDstData[(nYDst * nDstStep) + (nXDst * 4)];
-
-					for (y = 0; y < nHeight; y++)
-					{
-						for (x = 0; x < nWidth; x++)
-						{
-							GetRGB16(r, g, b, *pSrcPixel);
-							*pDstPixel = ABGR32(0xFF, r, g, b);
-
-							pSrcPixel++;
-							pDstPixel++;
-						}
-
-						pSrcPixel = (UINT16*) &((BYTE*) pSrcPixel)[-((nSrcStep - nSrcPad) + nSrcStep)];
-						pDstPixel = (UINT32*) &((BYTE*) pDstPixel)[nDstPad];
-					}
+					prims->RGB565ToARGB_16u32u_C3C4((UINT16*) pSrcPixel, nSrcStep,
+							(UINT32*) pDstPixel, nDstStep, nWidth, 1, TRUE, invert);
+					pSrcPixel = &pSrcPixel[-nSrcStep];
+					pDstPixel = &pDstPixel[nDstStep];
 				}
 			}
 
@@ -2829,95 +2693,25 @@ int freerdp_image24_copy(BYTE* pDstData, DWORD DstFormat, int nDstStep, int nXDs
 	{
 		if ((dstBitsPerPixel == 32) || (dstBitsPerPixel == 24))
 		{
-			BYTE* pSrcPixel;
-			BYTE* pDstPixel;
+			primitives_t* prims = primitives_get();
+			BYTE* pSrcPixel = &pSrcData[(nYSrc * nSrcStep) + (nXSrc * 3)];
+			BYTE* pDstPixel = &pDstData[(nYDst * nDstStep) + (nXDst * 4)];
 
-			if (!invert)
+			if (!vFlip)
 			{
-				if (!vFlip)
-				{
-					pSrcPixel = &pSrcData[(nYSrc * nSrcStep) + (nXSrc * 3)];
-					pDstPixel = &pDstData[(nYDst * nDstStep) + (nXDst * 4)];
-
-					for (y = 0; y < nHeight; y++)
-					{
-						for (x = 0; x < nWidth; x++)
-						{
-							*pDstPixel++ = *pSrcPixel++;
-							*pDstPixel++ = *pSrcPixel++;
-							*pDstPixel++ = *pSrcPixel++;
-							*pDstPixel++ = 0xFF;
-						}
-
-						pSrcPixel = &pSrcPixel[nSrcPad];
-						pDstPixel = &pDstPixel[nDstPad];
-					}
-				}
-				else
-				{
-					pSrcPixel = &pSrcData[((nYSrc + nHeight - 1) * nSrcStep) + (nXSrc * 3)];
-					pDstPixel = &pDstData[(nYDst * nDstStep) + (nXDst * 4)];
-
-					for (y = 0; y < nHeight; y++)
-					{
-						for (x = 0; x < nWidth; x++)
-						{
-							*pDstPixel++ = *pSrcPixel++;
-							*pDstPixel++ = *pSrcPixel++;
-							*pDstPixel++ = *pSrcPixel++;
-							*pDstPixel++ = 0xFF;
-						}
-
-						pSrcPixel = &pSrcPixel[-((nSrcStep - nSrcPad) + nSrcStep)];
-						pDstPixel = &pDstPixel[nDstPad];
-					}
-				}
+				prims->RGB24ToRGB32_8u_C3AC4R(pSrcPixel, nSrcStep,
+						pDstPixel, nDstStep, nWidth, nHeight, invert);
 			}
 			else
 			{
-				if (!vFlip)
-				{
-					pSrcPixel = &pSrcData[(nYSrc * nSrcStep) + (nXSrc * 3)];
-					pDstPixel = &pDstData[(nYDst * nDstStep) + (nXDst * 4)];
-
-					for (y = 0; y < nHeight; y++)
-					{
-						for (x = 0; x < nWidth; x++)
-						{
-							pDstPixel[0] = pSrcPixel[2];
-							pDstPixel[1] = pSrcPixel[1];
-							pDstPixel[2] = pSrcPixel[0];
-							pDstPixel[3] = 0xFF;
-
-							pSrcPixel += 3;
-							pDstPixel += 4;
-						}
+				pSrcPixel = &pSrcPixel[(nHeight - 1) * nSrcStep];
 
-						pSrcPixel = &pSrcPixel[nSrcPad];
-						pDstPixel = &pDstPixel[nDstPad];
-					}
-				}
-				else
+				for (y = 0; y < nHeight; y++)
 				{
-					pSrcPixel = &pSrcData[((nYSrc + nHeight - 1) * nSrcStep) + (nXSrc * 3)];
-					pDstPixel = &pDstData[(nYDst * nDstStep) + (nXDst * 4)];
-
-					for (y = 0; y < nHeight; y++)
-					{
-						for (x = 0; x < nWidth; x++)
-						{
-							pDstPixel[0] = pSrcPixel[2];
-							pDstPixel[1] = pSrcPixel[1];
-							pDstPixel[2] = pSrcPixel[0];
-							pDstPixel[3] = 0xFF;
-
-							pSrcPixel += 3;
-							pDstPixel += 4;
-						}
-
-						pSrcPixel = &pSrcPixel[-((nSrcStep - nSrcPad) + nSrcStep)];
-						pDstPixel = &pDstPixel[nDstPad];
-					}
+					prims->RGB24ToRGB32_8u_C3AC4R(pSrcPixel, nSrcStep,
+							pDstPixel, nDstStep, nWidth, 1, invert);
+					pSrcPixel = &pSrcPixel[-nSrcStep];
+					pDstPixel = &pDstPixel[nDstStep];
 				}
 			}
 
@@ -3183,7 +2977,7 @@ int freerdp_image32_copy(BYTE* pDstData, DWORD DstFormat, int nDstStep, int nXDs
 	int dstFlip;
 	int nSrcPad;
 	int nDstPad;
-	BYTE a, r, g, b;
+	BYTE r, g, b;
 	int srcBitsPerPixel;
 	int srcBytesPerPixel;
 	int dstBitsPerPixel;
@@ -3223,41 +3017,27 @@ int freerdp_image32_copy(BYTE* pDstData, DWORD DstFormat, int nDstStep, int nXDs
 		{
 			if (dstBitsPerPixel == 32)
 			{
-				UINT32* pSrcPixel;
-				UINT32* pDstPixel;
+				BYTE* pSrcPixel;
+				BYTE* pDstPixel;
 
-				pSrcPixel = (UINT32*) &pSrcData[(nYSrc * nSrcStep) + (nXSrc * 4)];
-				pDstPixel = (UINT32*) &pDstData[(nYDst * nDstStep) + (nXDst * 4)];
+				pSrcPixel = &pSrcData[(nYSrc * nSrcStep) + (nXSrc * 4)];
+				pDstPixel = &pDstData[(nYDst * nDstStep) + (nXDst * 4)];
 
 				if (!invert)
 				{
 					for (y = 0; y < nHeight; y++)
 					{
-						for (x = 0; x < nWidth; x++)
-						{
-							*pDstPixel++ = *pSrcPixel++;
-						}
-
-						pSrcPixel = (UINT32*) &((BYTE*) pSrcPixel)[nSrcPad];
-						pDstPixel = (UINT32*) &((BYTE*) pDstPixel)[nDstPad];
+						MoveMemory(pDstPixel, pSrcPixel, nWidth * 4);
+						pSrcPixel = &pSrcPixel[nSrcStep];
+						pDstPixel = &pDstPixel[nDstStep];
 					}
 				}
 				else
 				{
-					for (y = 0; y < nHeight; y++)
-					{
-						for (x = 0; x < nWidth; x++)
-						{
-							GetARGB32(a, r, g, b, *pSrcPixel);
-							*pDstPixel = ABGR32(a, r, g, b);
-
-							pSrcPixel++;
-							pDstPixel++;
-						}
+					primitives_t* prims = primitives_get();
 
-						pSrcPixel = (UINT32*) &((BYTE*) pSrcPixel)[nSrcPad];
-						pDstPixel = (UINT32*) &((BYTE*) pDstPixel)[nDstPad];
-					}
+					prims->RGBToBGR_8u_AC4R(pSrcPixel, nSrcStep, pDstPixel, nDstStep,
+							nWidth, nHeight, TRUE);
 				}
 
 				return 1;
@@ -3296,48 +3076,26 @@ int freerdp_image32_copy(BYTE* pDstData, DWORD DstFormat, int nDstStep, int nXDs
 				}
 				else
 				{
+					primitives_t* prims = primitives_get();
+
+					pSrcPixel = &pSrcData[(nYSrc * nSrcStep) + (nXSrc * 4)];
+					pDstPixel = &pDstData[(nYDst * nDstStep) + (nXDst * 4)];
+
 					if (!vFlip)
 					{
-						pSrcPixel = &pSrcData[(nYSrc * nSrcStep) + (nXSrc * 4)];
-						pDstPixel = &pDstData[(nYDst * nDstStep) + (nXDst * 4)];
-
-						for (y = 0; y < nHeight; y++)
-						{
-							for (x = 0; x < nWidth; x++)
-							{
-								pDstPixel[0] = pSrcPixel[2];
-								pDstPixel[1] = pSrcPixel[1];
-								pDstPixel[2] = pSrcPixel[0];
-								pDstPixel[3] = 0xFF;
-
-								pSrcPixel += 4;
-								pDstPixel += 4;
-							}
-
-							pSrcPixel = &pSrcPixel[nSrcPad];
-							pDstPixel = &pDstPixel[nDstPad];
-						}
+						prims->RGBToBGR_8u_AC4R(pSrcPixel, nSrcStep, pDstPixel, nDstStep,
+								nWidth, nHeight, FALSE);
 					}
 					else
 					{
-						pSrcPixel = &pSrcData[((nYSrc + nHeight - 1) * nSrcStep) + (nXSrc * 4)];
-						pDstPixel = &pDstData[(nYDst * nDstStep) + (nXDst * 4)];
+						pSrcPixel = &pSrcPixel[(nHeight - 1) * nSrcStep];
 
 						for (y = 0; y < nHeight; y++)
 						{
-							for (x = 0; x < nWidth; x++)
-							{
-								pDstPixel[0] = pSrcPixel[2];
-								pDstPixel[1] = pSrcPixel[1];
-								pDstPixel[2] = pSrcPixel[0];
-								pDstPixel[3] = 0xFF;
-
-								pSrcPixel += 4;
-								pDstPixel += 4;
-							}
-
-							pSrcPixel = &pSrcPixel[-((nSrcStep - nSrcPad) + nSrcStep)];
-							pDstPixel = &pDstPixel[nDstPad];
+							prims->RGBToBGR_8u_AC4R(pSrcPixel, nSrcStep, pDstPixel, nDstStep,
+									nWidth, 1, FALSE);
+							pSrcPixel = &pSrcPixel[-nSrcStep];
+							pDstPixel = &pDstPixel[nDstStep];
 						}
 					}
 				}
@@ -21,22 +21,41 @@
 #include "config.h"
 #endif
 
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include <winpr/crt.h>
 
+#include <freerdp/log.h>
 #include <freerdp/types.h>
 
 #include <freerdp/codec/dsp.h>
 
+#ifdef WITH_OPUS
+#include <opus/opus.h>
+#endif
+
+#include "dsp_sse2.h"
+#include "dsp_neon.h"
+
+#define TAG FREERDP_TAG("codec.dsp")
+
+#ifndef DSP_INIT_SIMD
+#define DSP_INIT_SIMD(_dsp_context) do { } while (0)
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
 /**
  * Microsoft Multimedia Standards Update
  * http://download.microsoft.com/download/9/8/6/9863C72A-A3AA-4DDB-B1BA-CA8D17EFD2D4/RIFFNEW.pdf
  */
 
-static BOOL freerdp_dsp_resample(FREERDP_DSP_CONTEXT* context,
+static BOOL freerdp_dsp_resample_nearest(FREERDP_DSP_CONTEXT* context,
 	const BYTE* src, int bytes_per_sample,
 	UINT32 schan, UINT32 srate, int sframes,
 	UINT32 rchan, UINT32 rrate)
@@ -90,6 +109,405 @@ static BOOL freerdp_dsp_resample(FREERDP_DSP_CONTEXT* context,
 	return TRUE;
 }
 
+/**
+ * Band-limited resampling of 16-bit samples: the rate changes by up / down,
+ * each output sample being filtered from the input by one of the phases of
+ * a Blackman windowed sinc. Input not consumed yet is kept across calls
+ * (history), so that consecutive buffers of a stream join without clicks.
+ * The output lags the input by half the filter length: the end of a stream
+ * is drained with freerdp_dsp_resample_flush, and a new stream starts from
+ * a clean history after freerdp_dsp_context_reset.
+ */
+
+#define DSP_RESAMPLE_TAPS		32
+#define DSP_RESAMPLE_MAX_TAPS		256
+#define DSP_RESAMPLE_MAX_PHASES		1024
+#define DSP_RESAMPLE_SHIFT		14
+#define DSP_RESAMPLE_CUTOFF		0.9
+
+struct _FREERDP_DSP_RESAMPLER
+{
+	UINT32 channels;
+	UINT32 srate;
+	UINT32 rrate;
+	UINT32 rchannels;
+
+	UINT32 up;
+	UINT32 down;
+	UINT32 phases;
+	UINT32 taps;
+	INT16* coeffs;
+
+	INT16* history;
+	UINT32 history_frames;
+	UINT32 history_maxframes;
+	UINT32 frac;
+
+	UINT64 input_frames;
+	UINT64 output_frames;
+};
+
+static INT32 freerdp_dsp_resample_filter(const INT16* samples, const INT16* coeffs, UINT32 taps)
+{
+	UINT32 i;
+	INT32 sum = 0;
+
+	for (i = 0; i < taps; i++)
+		sum += samples[i] * coeffs[i];
+
+	return sum;
+}
+
+static UINT32 dsp_gcd(UINT32 a, UINT32 b)
+{
+	UINT32 t;
+
+	while (b)
+	{
+		t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+static void dsp_resampler_free(FREERDP_DSP_RESAMPLER* resampler)
+{
+	if (!resampler)
+		return;
+
+	_aligned_free(resampler->coeffs);
+	free(resampler->history);
+	free(resampler);
+}
+
+static void dsp_resampler_init_phase(FREERDP_DSP_RESAMPLER* resampler,
+	UINT32 phase, double cutoff)
+{
+	UINT32 k;
+	UINT32 peak = 0;
+	INT32 total = 0;
+	double sum = 0.0;
+	double h[DSP_RESAMPLE_MAX_TAPS];
+	double x, center, window;
+	UINT32 taps = resampler->taps;
+	INT16* coeffs = &resampler->coeffs[phase * taps];
+
+	center = (taps / 2 - 1) + ((double) phase / resampler->phases);
+
+	for (k = 0; k < taps; k++)
+	{
+		x = k - center;
+		window = 0.42 + 0.5 * cos(2.0 * M_PI * x / taps) + 0.08 * cos(4.0 * M_PI * x / taps);
+		h[k] = window * ((x == 0.0) ? 1.0 : sin(M_PI * cutoff * x) / (M_PI * cutoff * x));
+		sum += h[k];
+	}
+
+	/* unity gain at DC, the rounding error going to the largest tap */
+	for (k = 0; k < taps; k++)
+	{
+		coeffs[k] = (INT16) floor(h[k] * (1 << DSP_RESAMPLE_SHIFT) / sum + 0.5);
+		total += coeffs[k];
+
+		if (h[k] > h[peak])
+			peak = k;
+	}
+
+	coeffs[peak] += (1 << DSP_RESAMPLE_SHIFT) - total;
+}
+
+static FREERDP_DSP_RESAMPLER* dsp_resampler_new(UINT32 channels, UINT32 srate, UINT32 rrate)
+{
+	UINT32 phase;
+	UINT32 divisor;
+	double ratio;
+	double cutoff;
+	FREERDP_DSP_RESAMPLER* resampler;
+
+	resampler = (FREERDP_DSP_RESAMPLER*) calloc(1, sizeof(FREERDP_DSP_RESAMPLER));
+
+	if (!resampler)
+		return NULL;
+
+	divisor = dsp_gcd(srate, rrate);
+
+	resampler->channels = channels;
+	resampler->srate = srate;
+	resampler->rrate = rrate;
+	resampler->up = rrate / divisor;
+	resampler->down = srate / divisor;
+	resampler->phases = MIN(resampler->up, DSP_RESAMPLE_MAX_PHASES);
+
+	/* downsampling lowers the cutoff below the input band, the filter gets longer to keep its slope */
+	ratio = (double) rrate / srate;
+	cutoff = DSP_RESAMPLE_CUTOFF * MIN(ratio, 1.0);
+	resampler->taps = DSP_RESAMPLE_TAPS;
+
+	if (ratio < 1.0)
+		resampler->taps = MIN(((UINT32) ceil(DSP_RESAMPLE_TAPS / ratio) + 7) & ~7, DSP_RESAMPLE_MAX_TAPS);
+
+	resampler->coeffs = (INT16*) _aligned_malloc(resampler->phases * resampler->taps * sizeof(INT16), 16);
+
+	if (!resampler->coeffs)
+	{
+		dsp_resampler_free(resampler);
+		return NULL;
+	}
+
+	for (phase = 0; phase < resampler->phases; phase++)
+		dsp_resampler_init_phase(resampler, phase, cutoff);
+
+	/* output sample 0 is centered on input sample 0 */
+	resampler->history_frames = resampler->taps / 2 - 1;
+
+	return resampler;
+}
+
+static void dsp_resampler_reset(FREERDP_DSP_RESAMPLER* resampler)
+{
+	UINT32 c;
+
+	resampler->history_frames = resampler->taps / 2 - 1;
+	resampler->frac = 0;
+	resampler->input_frames = 0;
+	resampler->output_frames = 0;
+
+	if (!resampler->history)
+		return;
+
+	for (c = 0; c < resampler->channels; c++)
+	{
+		ZeroMemory(&resampler->history[c * resampler->history_maxframes],
+			resampler->history_frames * sizeof(INT16));
+	}
+}
+
+static BOOL dsp_resampler_append(FREERDP_DSP_RESAMPLER* resampler,
+	const INT16* src, UINT32 schan, UINT32 sframes)
+{
+	UINT32 c, i;
+	INT16* dst;
+	INT16* history;
+	UINT32 maxframes;
+	UINT32 frames = resampler->history_frames + sframes;
+
+	if (frames > resampler->history_maxframes)
+	{
+		maxframes = frames + 1024;
+		history = (INT16*) calloc(maxframes * schan, sizeof(INT16));
+
+		if (!history)
+			return FALSE;
+
+		for (c = 0; c < schan; c++)
+		{
+			if (resampler->history)
+			{
+				CopyMemory(&history[c * maxframes], &resampler->history[c * resampler->history_maxframes],
+					resampler->history_frames * sizeof(INT16));
+			}
+		}
+
+		free(resampler->history);
+		resampler->history = history;
+		resampler->history_maxframes = maxframes;
+	}
+
+	/* no source appends silence */
+	for (c = 0; c < schan; c++)
+	{
+		dst = &resampler->history[c * resampler->history_maxframes + resampler->history_frames];
+
+		if (!src)
+		{
+			ZeroMemory(dst, sframes * sizeof(INT16));
+			continue;
+		}
+
+		for (i = 0; i < sframes; i++)
+			dst[i] = src[i * schan + c];
+	}
+
+	resampler->history_frames = frames;
+	return TRUE;
+}
+
+/* filters all the output samples the history allows, up to maxframes */
+static BOOL dsp_resampler_run(FREERDP_DSP_CONTEXT* context, FREERDP_DSP_RESAMPLER* resampler,
+	UINT64 maxframes)
+{
+	INT16* dst;
+	INT32 sample;
+	UINT32 c, j;
+	UINT32 pos = 0;
+	UINT32 phase;
+	UINT32 rframes = 0;
+	UINT32 rsize;
+	UINT32 frac;
+	UINT32 taps;
+	UINT32 schan = resampler->channels;
+	UINT32 rchan = resampler->rchannels;
+
+	taps = resampler->taps;
+	frac = resampler->frac;
+
+	if (resampler->history_frames >= taps)
+	{
+		rframes = (UINT32) ((((UINT64) (resampler->history_frames - taps + 1)) * resampler->up -
+			frac + resampler->down - 1) / resampler->down);
+	}
+
+	if (rframes > maxframes)
+		rframes = (UINT32) maxframes;
+
+	rsize = rframes * rchan * sizeof(INT16);
+
+	if (rsize > context->resampled_maxlength)
+	{
+		BYTE *newBuffer = (BYTE*) realloc(context->resampled_buffer, rsize + 1024);
+		if (!newBuffer)
+			return FALSE;
+
+		context->resampled_maxlength = rsize + 1024;
+		context->resampled_buffer = newBuffer;
+	}
+	dst = (INT16*) context->resampled_buffer;
+
+	for (j = 0; j < rframes; j++)
+	{
+		if (resampler->phases == resampler->up)
+			phase = frac;
+		else
+			phase = (UINT32) (((UINT64) frac * resampler->phases) / resampler->up);
+
+		for (c = 0; c < rchan; c++)
+		{
+			if (c >= schan)
+			{
+				dst[c] = dst[c % schan];
+				continue;
+			}
+
+			sample = context->resample_filter(&resampler->history[c * resampler->history_maxframes + pos],
+				&resampler->coeffs[phase * taps], taps);
+			sample = (sample + (1 << (DSP_RESAMPLE_SHIFT - 1))) >> DSP_RESAMPLE_SHIFT;
+
+			if (sample > 32767)
+				sample = 32767;
+			else if (sample < -32768)
+				sample = -32768;
+
+			dst[c] = (INT16) sample;
+		}
+
+		dst += rchan;
+		frac += resampler->down;
+		pos += frac / resampler->up;
+		frac %= resampler->up;
+	}
+
+	/* keep what the next output samples still need */
+	if (pos > resampler->history_frames)
+		pos = resampler->history_frames;
+
+	for (c = 0; c < schan; c++)
+	{
+		MoveMemory(&resampler->history[c * resampler->history_maxframes],
+			&resampler->history[c * resampler->history_maxframes + pos],
+			(resampler->history_frames - pos) * sizeof(INT16));
+	}
+
+	resampler->history_frames -= pos;
+	resampler->frac = frac;
+	resampler->output_frames += rframes;
+
+	context->resampled_frames = rframes;
+	context->resampled_size = rsize;
+	return TRUE;
+}
+
+static BOOL freerdp_dsp_resample_polyphase(FREERDP_DSP_CONTEXT* context,
+	const INT16* src, UINT32 schan, UINT32 srate, int sframes,
+	UINT32 rchan, UINT32 rrate)
+{
+	FREERDP_DSP_RESAMPLER* resampler = context->resampler;
+
+	if (!resampler || (resampler->channels != schan) ||
+		(resampler->srate != srate) || (resampler->rrate != rrate))
+	{
+		dsp_resampler_free(resampler);
+		context->resampler = resampler = dsp_resampler_new(schan, srate, rrate);
+
+		if (!resampler)
+			return FALSE;
+	}
+
+	if (!dsp_resampler_append(resampler, src, schan, sframes))
+		return FALSE;
+
+	resampler->rchannels = rchan;
+	resampler->input_frames += sframes;
+
+	return dsp_resampler_run(context, resampler, (UINT64) -1);
+}
+
+/**
+ * Ends a resampled stream: the output samples held back by the filter are
+ * computed against silence and left in resampled_buffer, the output of the
+ * whole stream then matches its input in length. The resampler is reset
+ * for the next stream.
+ */
+
+BOOL freerdp_dsp_resample_flush(FREERDP_DSP_CONTEXT* context)
+{
+	BOOL status;
+	UINT64 expected;
+	FREERDP_DSP_RESAMPLER* resampler;
+
+	if (!context)
+		return FALSE;
+
+	context->resampled_frames = 0;
+	context->resampled_size = 0;
+	resampler = context->resampler;
+
+	if (!resampler || !resampler->input_frames)
+		return TRUE;
+
+	/* output sample j is centered on input sample j * down / up */
+	expected = (resampler->input_frames * resampler->up + resampler->down - 1) / resampler->down;
+
+	if (expected <= resampler->output_frames)
+	{
+		dsp_resampler_reset(resampler);
+		return TRUE;
+	}
+
+	if (!dsp_resampler_append(resampler, NULL, resampler->channels, resampler->taps / 2))
+		return FALSE;
+
+	status = dsp_resampler_run(context, resampler, expected - resampler->output_frames);
+	dsp_resampler_reset(resampler);
+
+	return status;
+}
+
+static BOOL freerdp_dsp_resample(FREERDP_DSP_CONTEXT* context,
+	const BYTE* src, int bytes_per_sample,
+	UINT32 schan, UINT32 srate, int sframes,
+	UINT32 rchan, UINT32 rrate)
+{
+	if ((bytes_per_sample != 2) || (srate == rrate) || !srate || !rrate || !schan)
+	{
+		return freerdp_dsp_resample_nearest(context, src, bytes_per_sample,
+			schan, srate, sframes, rchan, rrate);
+	}
+
+	return freerdp_dsp_resample_polyphase(context, (const INT16*) src,
+		schan, srate, sframes, rchan, rrate);
+}
+
 /**
  * Microsoft IMA ADPCM specification:
  *
@@ -673,6 +1091,309 @@ static BOOL freerdp_dsp_encode_ms_adpcm(FREERDP_DSP_CONTEXT* context,
 	return TRUE;
 }
 
+/**
+ * Opus: http://tools.ietf.org/html/rfc6716
+ *
+ * A buffer holds whole 20ms packets, each preceded by its UINT16 length.
+ * Samples left over by the encoder are kept for the next buffer.
+ */
+
+#define DSP_OPUS_FRAMES_PER_SECOND	50
+#define DSP_OPUS_MAX_FRAME_SIZE		5760	/* 120ms at 48kHz */
+#define DSP_OPUS_MAX_PACKET_SIZE	1275
+
+#ifdef WITH_OPUS
+struct _FREERDP_DSP_OPUS
+{
+	OpusEncoder* encoder;
+	int encoder_channels;
+	int encoder_rate;
+	int encoder_bitrate;
+
+	OpusDecoder* decoder;
+	int decoder_channels;
+	int decoder_rate;
+
+	INT16* pending;
+	int pending_frames;
+};
+
+static FREERDP_DSP_OPUS* dsp_opus_get(FREERDP_DSP_CONTEXT* context)
+{
+	if (!context->opus)
+		context->opus = (FREERDP_DSP_OPUS*) calloc(1, sizeof(FREERDP_DSP_OPUS));
+
+	return context->opus;
+}
+
+static void dsp_opus_free(FREERDP_DSP_OPUS* opus)
+{
+	if (!opus)
+		return;
+
+	if (opus->encoder)
+		opus_encoder_destroy(opus->encoder);
+
+	if (opus->decoder)
+		opus_decoder_destroy(opus->decoder);
+
+	free(opus->pending);
+	free(opus);
+}
+
+static void dsp_opus_reset(FREERDP_DSP_OPUS* opus)
+{
+	if (!opus)
+		return;
+
+	opus->pending_frames = 0;
+
+	if (opus->encoder)
+		opus_encoder_ctl(opus->encoder, OPUS_RESET_STATE);
+
+	if (opus->decoder)
+		opus_decoder_ctl(opus->decoder, OPUS_RESET_STATE);
+}
+
+static BOOL dsp_opus_ensure_capacity(FREERDP_DSP_CONTEXT* context, UINT32 size)
+{
+	if (size > context->adpcm_maxlength)
+	{
+		BYTE *newBuffer = realloc(context->adpcm_buffer, size + 1024);
+		if (!newBuffer)
+			return FALSE;
+
+		context->adpcm_maxlength = size + 1024;
+		context->adpcm_buffer = newBuffer;
+	}
+
+	return TRUE;
+}
+
+static BOOL freerdp_dsp_decode_opus(FREERDP_DSP_CONTEXT* context,
+	const BYTE* src, int size, int channels, int rate)
+{
+	int error;
+	int frames;
+	UINT16 length;
+	UINT32 out_size = 0;
+	FREERDP_DSP_OPUS* opus = dsp_opus_get(context);
+
+	if (!opus)
+		return FALSE;
+
+	if (!opus->decoder || (opus->decoder_channels != channels) || (opus->decoder_rate != rate))
+	{
+		if (opus->decoder)
+			opus_decoder_destroy(opus->decoder);
+
+		opus->decoder = opus_decoder_create(rate, channels, &error);
+		opus->decoder_channels = channels;
+		opus->decoder_rate = rate;
+
+		if (!opus->decoder)
+		{
+			WLog_ERR(TAG, "opus_decoder_create failed: %s", opus_strerror(error));
+			return FALSE;
+		}
+	}
+
+	while (size >= 2)
+	{
+		length = ((UINT16) src[0]) | (((UINT16) src[1]) << 8);
+		src += 2;
+		size -= 2;
+
+		if (length > size)
+		{
+			WLog_ERR(TAG, "truncated opus packet: %d bytes left, %d expected", size, length);
+			return FALSE;
+		}
+
+		if (!dsp_opus_ensure_capacity(context, out_size + DSP_OPUS_MAX_FRAME_SIZE * channels * 2))
+			return FALSE;
+
+		frames = opus_decode(opus->decoder, src, length,
+			(opus_int16*) &context->adpcm_buffer[out_size], DSP_OPUS_MAX_FRAME_SIZE, 0);
+
+		if (frames < 0)
+		{
+			WLog_ERR(TAG, "opus_decode failed: %s", opus_strerror(frames));
+			return FALSE;
+		}
+
+		out_size += frames * channels * 2;
+		src += length;
+		size -= length;
+	}
+
+	context->adpcm_size = out_size;
+	return TRUE;
+}
+
+static BOOL freerdp_dsp_encode_opus(FREERDP_DSP_CONTEXT* context,
+	const BYTE* src, int size, int channels, int rate, int bitrate)
+{
+	int error;
+	int count;
+	int length;
+	int frames;
+	int frame_size;
+	const INT16* pcm;
+	UINT32 out_size = 0;
+	FREERDP_DSP_OPUS* opus = dsp_opus_get(context);
+
+	if (!opus)
+		return FALSE;
+
+	frame_size = rate / DSP_OPUS_FRAMES_PER_SECOND;
+
+	if (!opus->encoder || (opus->encoder_channels != channels) || (opus->encoder_rate != rate))
+	{
+		if (opus->encoder)
+			opus_encoder_destroy(opus->encoder);
+
+		free(opus->pending);
+		opus->pending = (INT16*) calloc(frame_size * channels, sizeof(INT16));
+		opus->pending_frames = 0;
+		opus->encoder_bitrate = 0;
+		opus->encoder = opus_encoder_create(rate, channels, OPUS_APPLICATION_AUDIO, &error);
+		opus->encoder_channels = channels;
+		opus->encoder_rate = rate;
+
+		if (!opus->encoder || !opus->pending)
+		{
+			WLog_ERR(TAG, "opus_encoder_create failed: %s", opus_strerror(error));
+			return FALSE;
+		}
+
+		/* constant bit rate, the client derives the duration from the size */
+		opus_encoder_ctl(opus->encoder, OPUS_SET_VBR(0));
+	}
+
+	if (opus->encoder_bitrate != bitrate)
+	{
+		opus_encoder_ctl(opus->encoder, OPUS_SET_BITRATE(bitrate));
+		opus->encoder_bitrate = bitrate;
+	}
+
+	frames = size / (channels * 2);
+	count = (opus->pending_frames + frames) / frame_size;
+
+	if (!dsp_opus_ensure_capacity(context, count * (DSP_OPUS_MAX_PACKET_SIZE + 2)))
+		return FALSE;
+
+	while (opus->pending_frames + frames >= frame_size)
+	{
+		if (opus->pending_frames)
+		{
+			count = frame_size - opus->pending_frames;
+			CopyMemory(&opus->pending[opus->pending_frames * channels], src, count * channels * 2);
+			pcm = opus->pending;
+			opus->pending_frames = 0;
+		}
+		else
+		{
+			count = frame_size;
+			pcm = (const INT16*) src;
+		}
+
+		length = opus_encode(opus->encoder, pcm, frame_size,
+			&context->adpcm_buffer[out_size + 2], DSP_OPUS_MAX_PACKET_SIZE);
+
+		if (length < 0)
+		{
+			WLog_ERR(TAG, "opus_encode failed: %s", opus_strerror(length));
+			return FALSE;
+		}
+
+		context->adpcm_buffer[out_size] = (BYTE) (length & 0xFF);
+		context->adpcm_buffer[out_size + 1] = (BYTE) ((length >> 8) & 0xFF);
+		out_size += length + 2;
+
+		src += count * channels * 2;
+		frames -= count;
+	}
+
+	CopyMemory(&opus->pending[opus->pending_frames * channels], src, frames * channels * 2);
+	opus->pending_frames += frames;
+
+	context->adpcm_size = out_size;
+	return TRUE;
+}
+
+/**
+ * Encodes the samples held back by the Opus encoder at the end of a stream,
+ * padded with silence to a whole packet. The packet is appended to the ones
+ * of the last encode_opus call.
+ */
+
+BOOL freerdp_dsp_encode_opus_flush(FREERDP_DSP_CONTEXT* context)
+{
+	int length;
+	int channels;
+	int frame_size;
+	UINT32 out_size;
+	FREERDP_DSP_OPUS* opus = context->opus;
+
+	if (!opus || !opus->encoder || !opus->pending_frames)
+		return TRUE;
+
+	channels = opus->encoder_channels;
+	frame_size = opus->encoder_rate / DSP_OPUS_FRAMES_PER_SECOND;
+	out_size = context->adpcm_size;
+
+	if (!dsp_opus_ensure_capacity(context, out_size + DSP_OPUS_MAX_PACKET_SIZE + 2))
+		return FALSE;
+
+	ZeroMemory(&opus->pending[opus->pending_frames * channels],
+		(frame_size - opus->pending_frames) * channels * 2);
+	opus->pending_frames = 0;
+
+	length = opus_encode(opus->encoder, opus->pending, frame_size,
+		&context->adpcm_buffer[out_size + 2], DSP_OPUS_MAX_PACKET_SIZE);
+
+	if (length < 0)
+	{
+		WLog_ERR(TAG, "opus_encode failed: %s", opus_strerror(length));
+		return FALSE;
+	}
+
+	context->adpcm_buffer[out_size] = (BYTE) (length & 0xFF);
+	context->adpcm_buffer[out_size + 1] = (BYTE) ((length >> 8) & 0xFF);
+	context->adpcm_size = out_size + length + 2;
+
+	return TRUE;
+}
+#else
+static void dsp_opus_free(FREERDP_DSP_OPUS* opus)
+{
+}
+
+static void dsp_opus_reset(FREERDP_DSP_OPUS* opus)
+{
+}
+
+BOOL freerdp_dsp_encode_opus_flush(FREERDP_DSP_CONTEXT* context)
+{
+	return TRUE;
+}
+
+static BOOL freerdp_dsp_decode_opus(FREERDP_DSP_CONTEXT* context,
+	const BYTE* src, int size, int channels, int rate)
+{
+	WLog_ERR(TAG, "built without opus support");
+	return FALSE;
+}
+
+static BOOL freerdp_dsp_encode_opus(FREERDP_DSP_CONTEXT* context,
+	const BYTE* src, int size, int channels, int rate, int bitrate)
+{
+	WLog_ERR(TAG, "built without opus support");
+	return FALSE;
+}
+#endif /* WITH_OPUS */
+
 FREERDP_DSP_CONTEXT* freerdp_dsp_context_new(void)
 {
 	FREERDP_DSP_CONTEXT* context;
@@ -686,16 +1407,36 @@ FREERDP_DSP_CONTEXT* freerdp_dsp_context_new(void)
 	context->encode_ima_adpcm = freerdp_dsp_encode_ima_adpcm;
 	context->decode_ms_adpcm = freerdp_dsp_decode_ms_adpcm;
 	context->encode_ms_adpcm = freerdp_dsp_encode_ms_adpcm;
+	context->decode_opus = freerdp_dsp_decode_opus;
+	context->encode_opus = freerdp_dsp_encode_opus;
+	context->resample_filter = freerdp_dsp_resample_filter;
+
+	DSP_INIT_SIMD(context);
 
 	return context;
 }
 
+void freerdp_dsp_context_reset(FREERDP_DSP_CONTEXT* context)
+{
+	if (!context)
+		return;
+
+	freerdp_dsp_context_reset_adpcm(context);
+
+	if (context->resampler)
+		dsp_resampler_reset(context->resampler);
+
+	dsp_opus_reset(context->opus);
+}
+
 void freerdp_dsp_context_free(FREERDP_DSP_CONTEXT* context)
 {
 	if (context)
 	{
 		free(context->resampled_buffer);
 		free(context->adpcm_buffer);
+		dsp_resampler_free(context->resampler);
+		dsp_opus_free(context->opus);
 		free(context);
 	}
 }
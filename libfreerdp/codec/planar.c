@@ -276,6 +276,67 @@ static int planar_decompress_planes_raw(const BYTE* pSrcData[4], int nSrcStep, B
 	return 1;
 }
 
+static int planar_decompress_plane_raw(const BYTE* pSrcData, BYTE* pDstData,
+		int nDstStep, int nXDst, int nYDst, int nWidth, int nHeight, int nChannel, BOOL vFlip)
+{
+	int x, y;
+	BYTE* dstp;
+	int beg, end, inc;
+	const BYTE* srcp = pSrcData;
+
+	if (vFlip)
+	{
+		beg = nHeight - 1;
+		end = -1;
+		inc = -1;
+	}
+	else
+	{
+		beg = 0;
+		end = nHeight;
+		inc = 1;
+	}
+
+	for (y = beg; y != end; y += inc)
+	{
+		dstp = &pDstData[((nYDst + y) * nDstStep) + (nXDst * 4) + nChannel];
+
+		for (x = 0; x < nWidth; x++)
+		{
+			*dstp = *srcp++;
+			dstp += 4;
+		}
+	}
+
+	return (int) (srcp - pSrcData);
+}
+
+/**
+ * Expands the subsampled chroma values (bytes 0 and 1 of each pixel in
+ * pSrcData, stored in plane order) by replicating each one over a 2x2 block.
+ */
+
+static void planar_supersample_chroma(const BYTE* pSrcData, int nSrcStep, BYTE* pDstData,
+		int nDstStep, int nXDst, int nYDst, int nWidth, int nHeight, BOOL vFlip)
+{
+	int x, y;
+	BYTE* dstp;
+	const BYTE* srcp;
+
+	for (y = 0; y < nHeight; y++)
+	{
+		srcp = &pSrcData[(y / 2) * nSrcStep];
+		dstp = &pDstData[((nYDst + (vFlip ? (nHeight - y - 1) : y)) * nDstStep) + (nXDst * 4)];
+
+		for (x = 0; x < nWidth; x++)
+		{
+			dstp[0] = srcp[(x / 2) * 4];
+			dstp[1] = srcp[((x / 2) * 4) + 1];
+			dstp += 4;
+		}
+	}
+}
+
 int planar_decompress(BITMAP_PLANAR_CONTEXT* planar, BYTE* pSrcData, UINT32 SrcSize,
 		BYTE** ppDstData, DWORD DstFormat, int nDstStep, int nXDst, int nYDst, int nWidth, int nHeight, BOOL vFlip)
 {
@@ -290,7 +351,8 @@ int planar_decompress(BITMAP_PLANAR_CONTEXT* planar, BYTE* pSrcData, UINT32 SrcS
 	int subHeight;
 	int planeSize;
 	BYTE* pDstData;
-	int rleSizes[4];
+	BYTE* pYCoCg;
+	int rleSizes[4] = { 0, 0, 0, 0 };
 	int rawSizes[4];
 	int rawWidths[4];
 	int rawHeights[4];
@@ -298,6 +360,9 @@ int planar_decompress(BITMAP_PLANAR_CONTEXT* planar, BYTE* pSrcData, UINT32 SrcS
 	BOOL useTempBuffer;
 	int dstBitsPerPixel;
 	int dstBytesPerPixel;
+	int nTempDstStep;
+	int nTempXDst;
+	int nTempYDst;
 	const BYTE* planes[4];
 	UINT32 UncompressedSize;
 	const primitives_t* prims = primitives_get();
@@ -308,6 +373,10 @@ int planar_decompress(BITMAP_PLANAR_CONTEXT* planar, BYTE* pSrcData, UINT32 SrcS
 	dstBitsPerPixel = FREERDP_PIXEL_FORMAT_DEPTH(DstFormat);
 	dstBytesPerPixel = (FREERDP_PIXEL_FORMAT_BPP(DstFormat) / 8);
 
+	nTempDstStep = nDstStep;
+	nTempXDst = nXDst;
+	nTempYDst = nYDst;
+
 	if (nDstStep < 0)
 		nDstStep = nWidth * 4;
 
@@ -339,7 +408,10 @@ int planar_decompress(BITMAP_PLANAR_CONTEXT* planar, BYTE* pSrcData, UINT32 SrcS
 		if (!planar->TempBuffer)
 			return -1;
 
+		/* decode into the temporary buffer, then convert into place */
 		pDstData = planar->TempBuffer;
+		nDstStep = nWidth * 4;
+		nXDst = nYDst = 0;
 	}
 
 	FormatHeader = *srcp++;
@@ -411,7 +483,7 @@ int planar_decompress(BITMAP_PLANAR_CONTEXT* planar, BYTE* pSrcData, UINT32 SrcS
 		}
 		else
 		{
-			if ((SrcSize - (srcp - pSrcData)) < (planeSize * 3))
+			if ((SrcSize - (srcp - pSrcData)) < (rawSizes[0] + rawSizes[1] + rawSizes[2]))
 				return -1;
 
 			planes[0] = srcp; /* LumaOrRedPlane */
@@ -534,13 +606,86 @@ int planar_decompress(BITMAP_PLANAR_CONTEXT* planar, BYTE* pSrcData, UINT32 SrcS
 			}
 		}
 	}
-	else /* YCoCg */
+	else if (cs) /* YCoCg, Chroma Subsampling */
 	{
-		if (cs)
+		int nChromaStep = subWidth * 4;
+		UINT32 ChromaSize = nChromaStep * subHeight;
+
+		if (ChromaSize > planar->ChromaTempSize)
 		{
-			WLog_ERR(TAG, "Chroma subsampling unimplemented");
+			planar->ChromaTempBuffer = _aligned_realloc(planar->ChromaTempBuffer, ChromaSize, 16);
+			planar->ChromaTempSize = ChromaSize;
+		}
+
+		if (!planar->ChromaTempBuffer)
 			return -1;
+
+		if (!rle) /* RAW */
+		{
+			if (alpha)
+			{
+				planar_decompress_plane_raw(planes[3], pDstData, nDstStep,
+						nXDst, nYDst, nWidth, nHeight, 3, vFlip); /* AlphaPlane */
+
+				srcp += rawSizes[3];
+			}
+
+			planar_decompress_plane_raw(planes[0], pDstData, nDstStep,
+					nXDst, nYDst, nWidth, nHeight, 2, vFlip); /* LumaPlane */
+
+			planar_decompress_plane_raw(planes[1], planar->ChromaTempBuffer, nChromaStep,
+					0, 0, subWidth, subHeight, 1, FALSE); /* OrangeChromaPlane */
+
+			planar_decompress_plane_raw(planes[2], planar->ChromaTempBuffer, nChromaStep,
+					0, 0, subWidth, subHeight, 0, FALSE); /* GreenChromaPlane */
+
+			srcp += rawSizes[0] + rawSizes[1] + rawSizes[2];
+
+			if ((SrcSize - (srcp - pSrcData)) == 1)
+				srcp++; /* pad */
 		}
+		else /* RLE */
+		{
+			if (alpha)
+			{
+				status = planar_decompress_plane_rle(planes[3], rleSizes[3],
+						pDstData, nDstStep, nXDst, nYDst, nWidth, nHeight, 3, vFlip); /* AlphaPlane */
+
+				if (status < 0)
+					return -1;
+
+				srcp += rleSizes[3];
+			}
+
+			status = planar_decompress_plane_rle(planes[0], rleSizes[0],
+					pDstData, nDstStep, nXDst, nYDst, nWidth, nHeight, 2, vFlip); /* LumaPlane */
+
+			if (status < 0)
+				return -1;
+
+			status = planar_decompress_plane_rle(planes[1], rleSizes[1],
+					planar->ChromaTempBuffer, nChromaStep, 0, 0, subWidth, subHeight, 1, FALSE); /* OrangeChromaPlane */
+
+			if (status < 0)
+				return -1;
+
+			status = planar_decompress_plane_rle(planes[2], rleSizes[2],
+					planar->ChromaTempBuffer, nChromaStep, 0, 0, subWidth, subHeight, 0, FALSE); /* GreenChromaPlane */
+
+			if (status < 0)
+				return -1;
+
+			srcp += rleSizes[0] + rleSizes[1] + rleSizes[2];
+		}
+
+		planar_supersample_chroma(planar->ChromaTempBuffer, nChromaStep, pDstData, nDstStep,
+				nXDst, nYDst, nWidth, nHeight, vFlip);
+
+		pYCoCg = &pDstData[(nYDst * nDstStep) + (nXDst * 4)];
+		prims->YCoCgToRGB_8u_AC4R(pYCoCg, nDstStep, pYCoCg, nDstStep, nWidth, nHeight, cll, alpha, FALSE);
+	}
+	else /* YCoCg */
+	{
 
 		if (!rle) /* RAW */
 		{
@@ -595,7 +740,8 @@ int planar_decompress(BITMAP_PLANAR_CONTEXT* planar, BYTE* pSrcData, UINT32 SrcS
 			}
 		}
 
-		prims->YCoCgToRGB_8u_AC4R(pDstData, nDstStep, pDstData, nDstStep, nWidth, nHeight, cll, alpha, FALSE);
+		pYCoCg = &pDstData[(nYDst * nDstStep) + (nXDst * 4)];
+		prims->YCoCgToRGB_8u_AC4R(pYCoCg, nDstStep, pYCoCg, nDstStep, nWidth, nHeight, cll, alpha, FALSE);
 	}
 
 	status = (SrcSize == (srcp - pSrcData)) ? 1 : -1;
@@ -607,8 +753,8 @@ int planar_decompress(BITMAP_PLANAR_CONTEXT* planar, BYTE* pSrcData, UINT32 SrcS
 	{
 		pDstData = *ppDstData;
 
-		status = freerdp_image_copy(pDstData, DstFormat, -1, 0, 0, nWidth, nHeight,
-				planar->TempBuffer, PIXEL_FORMAT_XRGB32, -1, 0, 0, NULL);
+		status = freerdp_image_copy(pDstData, DstFormat, nTempDstStep, nTempXDst, nTempYDst,
+				nWidth, nHeight, planar->TempBuffer, PIXEL_FORMAT_XRGB32, -1, 0, 0, NULL);
 	}
 
 	return status;
@@ -1004,73 +1150,191 @@ int freerdp_bitmap_planar_delta_encode_planes(BYTE* inPlanes[4], int width, int
 	return 0;
 }
 
+/**
+ * Dynamic color fidelity: only tiles which look photographic are worth the
+ * color loss, flat content (text, window decorations, solid fills) is kept
+ * lossless as it is mostly made of runs which compress well as RGB anyway.
+ * Every fourth scanline is sampled for pixels identical to their left neighbor.
+ */
+
+static BOOL freerdp_bitmap_planar_use_color_loss(BITMAP_PLANAR_CONTEXT* context, BYTE* data,
+		int width, int height, int scanline)
+{
+	int x, y;
+	UINT32* pixel;
+	int total = 0;
+	int repeats = 0;
+
+	if (!context->ColorLossLevel)
+		return FALSE;
+
+	if (!context->AllowDynamicColorFidelity)
+		return TRUE;
+
+	for (y = 0; y < height; y += 4)
+	{
+		pixel = (UINT32*) &data[scanline * y];
+
+		for (x = 1; x < width; x++)
+		{
+			if ((pixel[x] & 0x00FFFFFF) == (pixel[x - 1] & 0x00FFFFFF))
+				repeats++;
+		}
+
+		total += width - 1;
+	}
+
+	return (repeats * 2 < total) ? TRUE : FALSE;
+}
+
+/**
+ * Averages the 2x2 blocks of a signed chroma plane in place, the subsampled
+ * plane being stored at the beginning of the input plane.
+ */
+
+static void freerdp_bitmap_planar_subsample_plane(BYTE* plane, int width, int height)
+{
+	int x, y;
+	int i, j;
+	int sum, count;
+	BYTE* dstp = plane;
+
+	for (y = 0; y < height; y += 2)
+	{
+		for (x = 0; x < width; x += 2)
+		{
+			sum = count = 0;
+
+			for (j = y; (j < y + 2) && (j < height); j++)
+			{
+				for (i = x; (i < x + 2) && (i < width); i++)
+				{
+					sum += (INT8) plane[(j * width) + i];
+					count++;
+				}
+			}
+
+			sum += (sum < 0) ? -(count / 2) : (count / 2);
+			*dstp++ = (BYTE) (sum / count);
+		}
+	}
+}
+
 BYTE* freerdp_bitmap_compress_planar(BITMAP_PLANAR_CONTEXT* context, BYTE* data, UINT32 format,
 		int width, int height, int scanline, BYTE* dstData, int* pDstSize)
 {
+	int i;
 	int size;
 	BYTE* dstp;
 	int planeSize;
 	int dstSizes[4];
+	int rawSizes[4];
+	int rawWidths[4];
+	int rawHeights[4];
 	BYTE FormatHeader = 0;
+	const primitives_t* prims = primitives_get();
 
 	if (context->AllowSkipAlpha)
 		FormatHeader |= PLANAR_FORMAT_HEADER_NA;
 
 	planeSize = width * height;
 
+	if (planeSize > context->maxPlaneSize)
+		return NULL;
+
+	for (i = 0; i < 4; i++)
+	{
+		rawSizes[i] = planeSize;
+		rawWidths[i] = width;
+		rawHeights[i] = height;
+	}
+
+	if (freerdp_bitmap_planar_use_color_loss(context, data, width, height, scanline))
+	{
+		FormatHeader |= (context->ColorLossLevel & PLANAR_FORMAT_HEADER_CLL_MASK);
+
+		prims->RGBToYCoCg_8u_AC4R(data, scanline, context->YCoCgBuffer, width * 4, width, height,
+				context->ColorLossLevel, (FREERDP_PIXEL_FORMAT_BPP(format) == 32) ? TRUE : FALSE, FALSE);
+
+		data = context->YCoCgBuffer;
+		scanline = width * 4;
+
+		if (context->AllowColorSubsampling)
+		{
+			FormatHeader |= PLANAR_FORMAT_HEADER_CS;
+
+			for (i = 2; i < 4; i++)
+			{
+				rawWidths[i] = (width / 2) + (width % 2);
+				rawHeights[i] = (height / 2) + (height % 2);
+				rawSizes[i] = rawWidths[i] * rawHeights[i];
+			}
+		}
+	}
+
 	if (freerdp_split_color_planes(data, format, width, height, scanline, context->planes) < 0)
 	{
 		return NULL;
 	}
 
+	if (FormatHeader & PLANAR_FORMAT_HEADER_CS)
+	{
+		freerdp_bitmap_planar_subsample_plane(context->planes[2], width, height); /* OrangeChroma */
+		freerdp_bitmap_planar_subsample_plane(context->planes[3], width, height); /* GreenChroma */
+	}
+
 	if (context->AllowRunLengthEncoding)
 	{
-		freerdp_bitmap_planar_delta_encode_planes(context->planes, width, height, context->deltaPlanes);
+		int offset = 0;
+		int outPlanesSize = planeSize * 4;
 
-		if (freerdp_bitmap_planar_compress_planes_rle(context->deltaPlanes, width, height,
-				context->rlePlanesBuffer, (int*) &dstSizes, context->AllowSkipAlpha) > 0)
+		for (i = 0; i < 4; i++)
 		{
-			int offset = 0;
+			dstSizes[i] = 0;
 
-			FormatHeader |= PLANAR_FORMAT_HEADER_RLE;
+			if ((i == 0) && context->AllowSkipAlpha)
+				continue;
 
-			context->rlePlanes[0] = &context->rlePlanesBuffer[offset];
-			offset += dstSizes[0];
+			freerdp_bitmap_planar_delta_encode_plane(context->planes[i],
+					rawWidths[i], rawHeights[i], context->deltaPlanes[i]);
 
-			context->rlePlanes[1] = &context->rlePlanesBuffer[offset];
-			offset += dstSizes[1];
+			dstSizes[i] = outPlanesSize - offset;
+			context->rlePlanes[i] = &context->rlePlanesBuffer[offset];
 
-			context->rlePlanes[2] = &context->rlePlanesBuffer[offset];
-			offset += dstSizes[2];
+			if (!freerdp_bitmap_planar_compress_plane_rle(context->deltaPlanes[i],
+					rawWidths[i], rawHeights[i], context->rlePlanes[i], &dstSizes[i]))
+				break;
 
-			context->rlePlanes[3] = &context->rlePlanesBuffer[offset];
-			offset += dstSizes[3];
-			//WLog_DBG(TAG, "R: [%d/%d] G: [%d/%d] B: [%d/%d]",
-			//		dstSizes[1], planeSize, dstSizes[2], planeSize, dstSizes[3], planeSize);
+			offset += dstSizes[i];
 		}
+
+		if (i == 4)
+			FormatHeader |= PLANAR_FORMAT_HEADER_RLE;
 	}
 
 	if (!dstData)
 	{
 		size = 1;
 
-		if (!(FormatHeader & PLANAR_FORMAT_HEADER_NA))
+		for (i = 0; i < 4; i++)
 		{
+			if ((i == 0) && (FormatHeader & PLANAR_FORMAT_HEADER_NA))
+				continue;
+
 			if (FormatHeader & PLANAR_FORMAT_HEADER_RLE)
-				size += dstSizes[0];
+				size += dstSizes[i];
 			else
-				size += planeSize;
+				size += rawSizes[i];
 		}
 
-		if (FormatHeader & PLANAR_FORMAT_HEADER_RLE)
-			size += (dstSizes[1] + dstSizes[2] + dstSizes[3]);
-		else
-			size += (planeSize * 3);
-
 		if (!(FormatHeader & PLANAR_FORMAT_HEADER_RLE))
 			size++;
 
 		dstData = malloc(size);
+
+		if (!dstData)
+			return NULL;
+
 		*pDstSize = size;
 	}
 
@@ -1079,61 +1343,27 @@ BYTE* freerdp_bitmap_compress_planar(BITMAP_PLANAR_CONTEXT* context, BYTE* data,
 	*dstp = FormatHeader; /* FormatHeader */
 	dstp++;
 
-	/* AlphaPlane */
+	/**
+	 * AlphaPlane, LumaOrRedPlane, OrangeChromaOrGreenPlane, GreenChromaOrBluePlane
+	 */
 
-	if (!(FormatHeader & PLANAR_FORMAT_HEADER_NA))
+	for (i = 0; i < 4; i++)
 	{
+		if ((i == 0) && (FormatHeader & PLANAR_FORMAT_HEADER_NA))
+			continue;
+
 		if (FormatHeader & PLANAR_FORMAT_HEADER_RLE)
 		{
-			CopyMemory(dstp, context->rlePlanes[0], dstSizes[0]); /* Alpha */
-			dstp += dstSizes[0];
+			CopyMemory(dstp, context->rlePlanes[i], dstSizes[i]);
+			dstp += dstSizes[i];
 		}
 		else
 		{
-			CopyMemory(dstp, context->planes[0], planeSize); /* Alpha */
-			dstp += planeSize;
+			CopyMemory(dstp, context->planes[i], rawSizes[i]);
+			dstp += rawSizes[i];
 		}
 	}
 
-	/* LumaOrRedPlane */
-
-	if (FormatHeader & PLANAR_FORMAT_HEADER_RLE)
-	{
-		CopyMemory(dstp, context->rlePlanes[1], dstSizes[1]); /* Red */
-		dstp += dstSizes[1];
-	}
-	else
-	{
-		CopyMemory(dstp, context->planes[1], planeSize); /* Red */
-		dstp += planeSize;
-	}
-
-	/* OrangeChromaOrGreenPlane */
-
-	if (FormatHeader & PLANAR_FORMAT_HEADER_RLE)
-	{
-		CopyMemory(dstp, context->rlePlanes[2], dstSizes[2]); /* Green */
-		dstp += dstSizes[2];
-	}
-	else
-	{
-		CopyMemory(dstp, context->planes[2], planeSize); /* Green */
-		dstp += planeSize;
-	}
-
-	/* GreenChromeOrBluePlane */
-
-	if (FormatHeader & PLANAR_FORMAT_HEADER_RLE)
-	{
-		CopyMemory(dstp, context->rlePlanes[3], dstSizes[3]); /* Blue */
-		dstp += dstSizes[3];
-	}
-	else
-	{
-		CopyMemory(dstp, context->planes[3], planeSize); /* Blue */
-		dstp += planeSize;
-	}
-
 	/* Pad1 (1 byte) */
 
 	if (!(FormatHeader & PLANAR_FORMAT_HEADER_RLE))
@@ -1196,6 +1426,9 @@ BITMAP_PLANAR_CONTEXT* freerdp_bitmap_planar_context_new(DWORD flags, int maxWid
 
 	context->rlePlanesBuffer = malloc(context->maxPlaneSize * 4);
 
+	if (context->ColorLossLevel)
+		context->YCoCgBuffer = _aligned_malloc(context->maxPlaneSize * 4, 16);
+
 	return context;
 }
 
@@ -1208,5 +1441,9 @@ void freerdp_bitmap_planar_context_free(BITMAP_PLANAR_CONTEXT* context)
 	free(context->deltaPlanesBuffer);
 	free(context->rlePlanesBuffer);
 
+	_aligned_free(context->YCoCgBuffer);
+	_aligned_free(context->TempBuffer);
+	_aligned_free(context->ChromaTempBuffer);
+
 	free(context);
 }
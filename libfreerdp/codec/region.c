@@ -223,7 +223,8 @@ BOOL region16_copy(REGION16 *dst, const REGION16 *src)
 		if (!dst->data)
 			return FALSE;
 
-		CopyMemory(dst->data, src->data, src->data->size);
+		/* src may have spare capacity, only copy the used rectangles */
+		CopyMemory(&dst->data[1], &src->data[1], src->data->nbRects * sizeof(RECTANGLE_16));
 	}
 
 	return TRUE;
@@ -529,7 +530,7 @@ BOOL region16_union_rect(REGION16 *dst, const REGION16 *src, const RECTANGLE_16
 		dstRect->top = rect->top;
 		dstRect->left = rect->left;
 		dstRect->right = rect->right;
-		dstRect->bottom = srcExtents->top;
+		dstRect->bottom = MIN(srcExtents->top, rect->bottom);
 
 		usedRects++;
 		dstRect++;
@@ -688,6 +689,235 @@ BOOL region16_union_rect(REGION16 *dst, const REGION16 *src, const RECTANGLE_16
 	return region16_simplify_bands(dst);
 }
 
+static int region16_compare_tops(const void *arg1, const void *arg2)
+{
+	const RECTANGLE_16 *r1 = (const RECTANGLE_16 *)arg1;
+	const RECTANGLE_16 *r2 = (const RECTANGLE_16 *)arg2;
+
+	return (int)r1->top - (int)r2->top;
+}
+
+static int region16_compare_edges(const void *arg1, const void *arg2)
+{
+	return (int)*((const UINT16 *)arg1) - (int)*((const UINT16 *)arg2);
+}
+
+/** builds the banded representation of the union of two sets of rectangles
+ *
+ * The rectangles are sorted by top and swept from top to bottom, the band
+ * limits being the distinct top and bottom coordinates. For each band the
+ * rectangles crossing it are kept sorted by left side, so that overlapping
+ * or touching items are merged in a single pass. A band that matches the
+ * one right above it only extends its bottom.
+ *
+ * The rectangle storage of dst is reused when large enough, so dst may be
+ * one of the sources.
+ */
+static BOOL region16_build(REGION16 *dst, const RECTANGLE_16 *rects1, int nbRects1,
+		const RECTANGLE_16 *rects2, int nbRects2)
+{
+	RECTANGLE_16 *sorted, *active, *band, *dstRect;
+	UINT16 *edges;
+	BYTE *scratch;
+	REGION16_DATA *data;
+	RECTANGLE_16 extents;
+	long capacity, usedRects;
+	long prevBand, prevBandItems;
+	int i, j, nbRects, nbEdges, nbActive, nbItems, next;
+	UINT16 y1, y2;
+
+	assert(dst);
+	assert(dst->data);
+
+	if (!(nbRects1 + nbRects2))
+	{
+		region16_clear(dst);
+		return TRUE;
+	}
+
+	scratch = (BYTE *)malloc((nbRects1 + nbRects2) * (3 * sizeof(RECTANGLE_16) + 2 * sizeof(UINT16)));
+
+	if (!scratch)
+		return FALSE;
+
+	sorted = (RECTANGLE_16 *)scratch;
+	active = sorted + nbRects1 + nbRects2;
+	band = active + nbRects1 + nbRects2;
+	edges = (UINT16 *)(band + nbRects1 + nbRects2);
+
+	nbRects = 0;
+
+	for (i = 0; i < nbRects1; i++)
+	{
+		if (!rectangle_is_empty(&rects1[i]))
+			sorted[nbRects++] = rects1[i];
+	}
+
+	for (i = 0; i < nbRects2; i++)
+	{
+		if (!rectangle_is_empty(&rects2[i]))
+			sorted[nbRects++] = rects2[i];
+	}
+
+	if (!nbRects)
+	{
+		free(scratch);
+		region16_clear(dst);
+		return TRUE;
+	}
+
+	qsort(sorted, nbRects, sizeof(RECTANGLE_16), region16_compare_tops);
+
+	extents = sorted[0];
+
+	for (i = 0; i < nbRects; i++)
+	{
+		edges[2 * i] = sorted[i].top;
+		edges[2 * i + 1] = sorted[i].bottom;
+
+		extents.left = MIN(extents.left, sorted[i].left);
+		extents.right = MAX(extents.right, sorted[i].right);
+		extents.bottom = MAX(extents.bottom, sorted[i].bottom);
+	}
+
+	qsort(edges, 2 * nbRects, sizeof(UINT16), region16_compare_edges);
+
+	for (i = 1, nbEdges = 1; i < 2 * nbRects; i++)
+	{
+		if (edges[i] != edges[nbEdges - 1])
+			edges[nbEdges++] = edges[i];
+	}
+
+	data = dst->data->size ? dst->data : NULL;
+	capacity = data ? (data->size - (long)sizeof(REGION16_DATA)) / (long)sizeof(RECTANGLE_16) : 0;
+	usedRects = 0;
+	prevBand = prevBandItems = 0;
+	nbActive = 0;
+	next = 0;
+
+	for (i = 0; i < nbEdges - 1; i++)
+	{
+		y1 = edges[i];
+		y2 = edges[i + 1];
+
+		/* drop the rectangles ending at this band, keep the others sorted by left */
+		for (j = 0, nbItems = 0; j < nbActive; j++)
+		{
+			if (active[j].bottom > y1)
+				active[nbItems++] = active[j];
+		}
+
+		nbActive = nbItems;
+
+		/* insert the rectangles starting at this band */
+		for (; (next < nbRects) && (sorted[next].top <= y1); next++)
+		{
+			for (j = nbActive; (j > 0) && (active[j - 1].left > sorted[next].left); j--)
+				active[j] = active[j - 1];
+
+			active[j] = sorted[next];
+			nbActive++;
+		}
+
+		if (!nbActive)
+			continue;
+
+		/* merge overlapping and touching items */
+		band[0] = active[0];
+
+		for (j = 1, nbItems = 1; j < nbActive; j++)
+		{
+			if (active[j].left <= band[nbItems - 1].right)
+				band[nbItems - 1].right = MAX(band[nbItems - 1].right, active[j].right);
+			else
+				band[nbItems++] = active[j];
+		}
+
+		/* extend the previous band when it touches and has the same items */
+		if (usedRects && (prevBandItems == nbItems))
+		{
+			dstRect = (RECTANGLE_16 *)(&data[1]) + prevBand;
+
+			if (dstRect->bottom == y1)
+			{
+				for (j = 0; j < nbItems; j++)
+				{
+					if ((dstRect[j].left != band[j].left) || (dstRect[j].right != band[j].right))
+						break;
+				}
+
+				if (j == nbItems)
+				{
+					for (j = 0; j < nbItems; j++)
+						dstRect[j].bottom = y2;
+
+					continue;
+				}
+			}
+		}
+
+		if (usedRects + nbItems > capacity)
+		{
+			REGION16_DATA *newData;
+
+			capacity = MAX(MAX(capacity * 2, usedRects + nbItems), 16);
+			newData = (REGION16_DATA *)realloc(data, sizeof(REGION16_DATA) + capacity * sizeof(RECTANGLE_16));
+
+			if (!newData)
+			{
+				free(data);
+				free(scratch);
+				dst->data = &empty_region;
+				ZeroMemory(&dst->extents, sizeof(dst->extents));
+				return FALSE;
+			}
+
+			data = newData;
+			data->size = sizeof(REGION16_DATA) + capacity * sizeof(RECTANGLE_16);
+		}
+
+		dstRect = (RECTANGLE_16 *)(&data[1]) + usedRects;
+
+		for (j = 0; j < nbItems; j++)
+		{
+			dstRect[j].left = band[j].left;
+			dstRect[j].right = band[j].right;
+			dstRect[j].top = y1;
+			dstRect[j].bottom = y2;
+		}
+
+		prevBand = usedRects;
+		prevBandItems = nbItems;
+		usedRects += nbItems;
+	}
+
+	free(scratch);
+
+	data->nbRects = usedRects;
+	dst->data = data;
+	dst->extents = extents;
+
+	return TRUE;
+}
+
+BOOL region16_union_rects(REGION16 *dst, const REGION16 *src, const RECTANGLE_16 *rects, int count)
+{
+	const RECTANGLE_16 *srcRects;
+	int srcNbRects;
+
+	assert(src);
+	assert(src->data);
+
+	srcRects = region16_rects(src, &srcNbRects);
+
+	return region16_build(dst, srcRects, srcNbRects, rects, count);
+}
+
+BOOL region16_from_rects(REGION16 *dst, const RECTANGLE_16 *rects, int count)
+{
+	return region16_build(dst, NULL, 0, rects, count);
+}
+
 BOOL region16_intersects_rect(const REGION16 *src, const RECTANGLE_16 *arg2)
 {
 	const RECTANGLE_16 *rect, *endPtr, *srcExtents;
@@ -1316,21 +1316,29 @@ void CALLBACK rfx_compose_message_tile_work_callback(PTP_CALLBACK_INSTANCE insta
 static BOOL computeRegion(const RFX_RECT* rects, int numRects, REGION16 *region, int width, int height)
 {
 	int i;
+	BOOL status;
+	RECTANGLE_16* rects16;
 	const RFX_RECT *rect = rects;
 	const RECTANGLE_16 mainRect = { 0, 0, width, height };
 
-	for(i = 0; i < numRects; i++, rect++) {
-		RECTANGLE_16 rect16;
+	rects16 = (RECTANGLE_16*) malloc(sizeof(RECTANGLE_16) * (numRects ? numRects : 1));
 
-		rect16.left = rect->x;
-		rect16.top = rect->y;
-		rect16.right = rect->x + rect->width;
-		rect16.bottom = rect->y + rect->height;
+	if (!rects16)
+		return FALSE;
 
-		if (!region16_union_rect(region, region, &rect16))
-			return FALSE;
+	for(i = 0; i < numRects; i++, rect++) {
+		rects16[i].left = rect->x;
+		rects16[i].top = rect->y;
+		rects16[i].right = rect->x + rect->width;
+		rects16[i].bottom = rect->y + rect->height;
 	}
 
+	status = region16_union_rects(region, region, rects16, numRects);
+	free(rects16);
+
+	if (!status)
+		return FALSE;
+
 	return region16_intersect_rect(region, region, &mainRect);
 }
 
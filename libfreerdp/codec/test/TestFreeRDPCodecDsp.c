@@ -0,0 +1,577 @@
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+
+#include <winpr/crt.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/codec/dsp.h>
+#include <freerdp/codec/audio.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define TEST_CHUNK_FRAMES	1000
+#define TEST_BENCH_SECONDS	30
+
+/* Two tones per channel, well inside the band of every rate tested */
+static double test_dsp_signal(UINT32 channel, double t)
+{
+	if (channel == 0)
+		return 9000.0 * sin(2.0 * M_PI * 1000.0 * t) + 4000.0 * sin(2.0 * M_PI * 3000.0 * t);
+
+	return 9000.0 * sin(2.0 * M_PI * 440.0 * t) + 4000.0 * sin(2.0 * M_PI * 2500.0 * t);
+}
+
+static INT16* test_dsp_generate(UINT32 channels, UINT32 rate, UINT32 frames)
+{
+	UINT32 i, c;
+	INT16* samples;
+
+	samples = (INT16*) malloc(frames * channels * sizeof(INT16));
+
+	if (!samples)
+		return NULL;
+
+	for (i = 0; i < frames; i++)
+	{
+		for (c = 0; c < channels; c++)
+			samples[i * channels + c] = (INT16) floor(test_dsp_signal(c, (double) i / rate) + 0.5);
+	}
+
+	return samples;
+}
+
+/* Signal to noise ratio of samples against the ideal signal, skipping the first frames */
+static double test_dsp_snr(const INT16* samples, UINT32 stride, UINT32 channels, UINT32 rate,
+	UINT32 frames, UINT32 skip, UINT32 delay)
+{
+	UINT32 i, c;
+	double ref, diff;
+	double signal = 0.0;
+	double noise = 0.0;
+
+	for (i = skip; i < frames; i++)
+	{
+		for (c = 0; c < channels; c++)
+		{
+			ref = test_dsp_signal(c, (double) (i - delay) / rate);
+			diff = samples[i * stride + c] - ref;
+			signal += ref * ref;
+			noise += diff * diff;
+		}
+	}
+
+	if (noise == 0.0)
+		return 200.0;
+
+	return 10.0 * log10(signal / noise);
+}
+
+static INT32 test_dsp_resample_filter(const INT16* samples, const INT16* coeffs, UINT32 taps)
+{
+	UINT32 i;
+	INT32 sum = 0;
+
+	for (i = 0; i < taps; i++)
+		sum += samples[i] * coeffs[i];
+
+	return sum;
+}
+
+/* Resamples a stream in chunks, as the channels do, and its tail into a new buffer */
+static INT16* test_dsp_resample(FREERDP_DSP_CONTEXT* context, const INT16* src,
+	UINT32 schan, UINT32 srate, UINT32 frames, UINT32 rchan, UINT32 rrate, UINT32* rframes)
+{
+	UINT32 i;
+	UINT32 count;
+	UINT32 total = 0;
+	INT16* dst;
+
+	dst = (INT16*) malloc(((UINT64) frames * rrate / srate + 16) * rchan * sizeof(INT16));
+
+	if (!dst)
+		return NULL;
+
+	for (i = 0; i < frames; i += count)
+	{
+		count = MIN(TEST_CHUNK_FRAMES, frames - i);
+
+		if (!context->resample(context, (const BYTE*) &src[i * schan], 2,
+			schan, srate, count, rchan, rrate))
+		{
+			free(dst);
+			return NULL;
+		}
+
+		CopyMemory(&dst[total * rchan], context->resampled_buffer, context->resampled_size);
+		total += context->resampled_frames;
+	}
+
+	if (!freerdp_dsp_resample_flush(context))
+	{
+		free(dst);
+		return NULL;
+	}
+
+	CopyMemory(&dst[total * rchan], context->resampled_buffer, context->resampled_size);
+	total += context->resampled_frames;
+
+	*rframes = total;
+	return dst;
+}
+
+static int test_dsp_resample_quality(UINT32 schan, UINT32 srate, UINT32 rchan, UINT32 rrate, double threshold)
+{
+	int status = -1;
+	UINT32 i, c;
+	UINT32 frames = srate;
+	UINT32 rframes = 0;
+	UINT32 gframes = 0;
+	UINT32 aframes = 0;
+	double snr, nearest;
+	INT16* src = NULL;
+	INT16* dst = NULL;
+	INT16* again = NULL;
+	INT16* general = NULL;
+	INT16* reference = NULL;
+	FREERDP_DSP_CONTEXT* context = NULL;
+	FREERDP_DSP_CONTEXT* generalContext = NULL;
+
+	context = freerdp_dsp_context_new();
+	generalContext = freerdp_dsp_context_new();
+	src = test_dsp_generate(schan, srate, frames);
+
+	if (!context || !generalContext || !src)
+		goto fail;
+
+	generalContext->resample_filter = test_dsp_resample_filter;
+
+	dst = test_dsp_resample(context, src, schan, srate, frames, rchan, rrate, &rframes);
+	general = test_dsp_resample(generalContext, src, schan, srate, frames, rchan, rrate, &gframes);
+
+	if (!dst || !general)
+		goto fail;
+
+	if ((rframes != gframes) || memcmp(dst, general, rframes * rchan * sizeof(INT16)) != 0)
+	{
+		printf("resample %u -> %u: optimized filter differs from the general one\n", srate, rrate);
+		goto fail;
+	}
+
+	/* flushing the stream drains the filter, the output is as long as the input */
+	if (rframes != (UINT32) (((UINT64) frames * rrate + srate - 1) / srate))
+	{
+		printf("resample %u -> %u: %u frames out of %u\n", srate, rrate, rframes, frames);
+		goto fail;
+	}
+
+	/* the next stream starts from a clean filter, a reset mid-stream too */
+	if (!context->resample(context, (const BYTE*) src, 2, schan, srate, 100, rchan, rrate))
+		goto fail;
+
+	freerdp_dsp_context_reset(context);
+	again = test_dsp_resample(context, src, schan, srate, frames, rchan, rrate, &aframes);
+
+	if (!again || (aframes != rframes) || memcmp(dst, again, rframes * rchan * sizeof(INT16)) != 0)
+	{
+		printf("resample %u -> %u: a second stream differs from the first\n", srate, rrate);
+		goto fail;
+	}
+
+	/* what the former nearest sample resampling gave */
+	reference = (INT16*) malloc(rframes * rchan * sizeof(INT16));
+
+	if (!reference)
+		goto fail;
+
+	for (i = 0; i < rframes; i++)
+	{
+		UINT32 n = MIN((UINT32) (((UINT64) i * srate + rrate / 2) / rrate), frames - 1);
+
+		for (c = 0; c < rchan; c++)
+			reference[i * rchan + c] = src[n * schan + (c % schan)];
+	}
+
+	/* both ends of the stream are filtered against silence, leave them out */
+	snr = test_dsp_snr(dst, rchan, MIN(schan, rchan), rrate, rframes - 64, 64, 0);
+	nearest = test_dsp_snr(reference, rchan, MIN(schan, rchan), rrate, rframes - 64, 64, 0);
+
+	printf("resample %5u/%u -> %5u/%u: SNR %6.2f dB (nearest sample %6.2f dB)\n",
+		srate, schan, rrate, rchan, snr, nearest);
+
+	if (snr < threshold)
+	{
+		printf("resample %u -> %u: SNR %.2f dB below %.2f dB\n", srate, rrate, snr, threshold);
+		goto fail;
+	}
+
+	status = 0;
+fail:
+	free(src);
+	free(dst);
+	free(again);
+	free(general);
+	free(reference);
+	freerdp_dsp_context_free(context);
+	freerdp_dsp_context_free(generalContext);
+	return status;
+}
+
+static int test_dsp_adpcm_quality(BOOL ms, UINT32 channels, UINT32 rate, int block_size, double threshold)
+{
+	int status = -1;
+	UINT32 frames = rate;
+	UINT32 size;
+	UINT32 dframes;
+	double snr;
+	BYTE* encoded = NULL;
+	INT16* src = NULL;
+	FREERDP_DSP_CONTEXT* context = NULL;
+
+	context = freerdp_dsp_context_new();
+	src = test_dsp_generate(channels, rate, frames);
+
+	if (!context || !src)
+		goto fail;
+
+	if (ms)
+		context->encode_ms_adpcm(context, (BYTE*) src, frames * channels * 2, channels, block_size);
+	else
+		context->encode_ima_adpcm(context, (BYTE*) src, frames * channels * 2, channels, block_size);
+
+	size = context->adpcm_size;
+	encoded = (BYTE*) malloc(size);
+
+	if (!encoded)
+		goto fail;
+
+	CopyMemory(encoded, context->adpcm_buffer, size);
+	freerdp_dsp_context_reset_adpcm(context);
+
+	/* whole blocks only */
+	size -= size % block_size;
+
+	if (ms)
+		context->decode_ms_adpcm(context, encoded, size, channels, block_size);
+	else
+		context->decode_ima_adpcm(context, encoded, size, channels, block_size);
+
+	dframes = MIN(frames, context->adpcm_size / (channels * 2));
+	snr = test_dsp_snr((INT16*) context->adpcm_buffer, channels, channels, rate, dframes, 0, 0);
+
+	printf("%s ADPCM %5u/%u: %u bytes for %u frames, SNR %6.2f dB\n",
+		ms ? "MS " : "IMA", rate, channels, size, dframes, snr);
+
+	if (snr < threshold)
+	{
+		printf("%s ADPCM: SNR %.2f dB below %.2f dB\n", ms ? "MS" : "IMA", snr, threshold);
+		goto fail;
+	}
+
+	status = 0;
+fail:
+	free(src);
+	free(encoded);
+	freerdp_dsp_context_free(context);
+	return status;
+}
+
+#ifdef WITH_OPUS
+static int test_dsp_opus_quality(UINT32 channels, UINT32 rate, int bitrate, double threshold)
+{
+	int status = -1;
+	UINT32 frames = rate;
+	UINT32 dframes;
+	UINT32 delay;
+	UINT32 best = 0;
+	double snr;
+	double bestSnr = -1000.0;
+	BYTE* encoded = NULL;
+	UINT32 size;
+	INT16* src = NULL;
+	FREERDP_DSP_CONTEXT* context = NULL;
+
+	context = freerdp_dsp_context_new();
+	src = test_dsp_generate(channels, rate, frames);
+
+	if (!context || !src)
+		goto fail;
+
+	if (!context->encode_opus(context, (BYTE*) src, frames * channels * 2, channels, rate, bitrate))
+		goto fail;
+
+	size = context->adpcm_size;
+	encoded = (BYTE*) malloc(size);
+
+	if (!encoded)
+		goto fail;
+
+	CopyMemory(encoded, context->adpcm_buffer, size);
+
+	if (!context->decode_opus(context, encoded, size, channels, rate))
+		goto fail;
+
+	dframes = context->adpcm_size / (channels * 2);
+
+	/* the codec delays the signal by its look-ahead */
+	for (delay = 0; delay < rate / 50; delay++)
+	{
+		snr = test_dsp_snr((INT16*) context->adpcm_buffer, channels, channels, rate, dframes, rate / 50 + delay, delay);
+
+		if (snr > bestSnr)
+		{
+			bestSnr = snr;
+			best = delay;
+		}
+	}
+
+	printf("Opus %5u/%u at %d bit/s: %u bytes for %u frames, SNR %6.2f dB (delay %u)\n",
+		rate, channels, bitrate, size, dframes, bestSnr, best);
+
+	if (bestSnr < threshold)
+	{
+		printf("Opus: SNR %.2f dB below %.2f dB\n", bestSnr, threshold);
+		goto fail;
+	}
+
+	status = 0;
+fail:
+	free(src);
+	free(encoded);
+	freerdp_dsp_context_free(context);
+	return status;
+}
+
+static BOOL test_dsp_opus_stream(FREERDP_DSP_CONTEXT* context, const INT16* src, UINT32 frames,
+	UINT32 channels, UINT32 rate, int bitrate, BYTE** data, UINT32* size, UINT32* packets)
+{
+	UINT32 offset;
+
+	if (!context->encode_opus(context, (const BYTE*) src, frames * channels * 2, channels, rate, bitrate))
+		return FALSE;
+
+	if (!freerdp_dsp_encode_opus_flush(context))
+		return FALSE;
+
+	*size = context->adpcm_size;
+	*data = (BYTE*) malloc(*size);
+
+	if (!*data)
+		return FALSE;
+
+	CopyMemory(*data, context->adpcm_buffer, *size);
+
+	for (*packets = 0, offset = 0; offset + 2 <= *size; (*packets)++)
+		offset += 2 + ((*data)[offset] | ((*data)[offset + 1] << 8));
+
+	return (offset == *size) ? TRUE : FALSE;
+}
+
+static int test_dsp_opus_reset(UINT32 channels, UINT32 rate, int bitrate)
+{
+	int status = -1;
+	UINT32 frames = (rate / 50) * 10 + (rate / 100);
+	UINT32 size[2];
+	UINT32 packets[2];
+	BYTE* data[2] = { NULL, NULL };
+	INT16* src = NULL;
+	FREERDP_DSP_CONTEXT* context = NULL;
+
+	context = freerdp_dsp_context_new();
+	src = test_dsp_generate(channels, rate, frames);
+
+	if (!context || !src)
+		goto fail;
+
+	/* 10.5 packets: the flush must send the half packet padded with silence */
+	if (!test_dsp_opus_stream(context, src, frames, channels, rate, bitrate, &data[0], &size[0], &packets[0]))
+		goto fail;
+
+	if (packets[0] != 11)
+	{
+		printf("Opus: %u packets for 10.5 packets of samples, expected 11\n", packets[0]);
+		goto fail;
+	}
+
+	/* a stream interrupted mid-packet must not leak into the next one */
+	if (!context->encode_opus(context, (const BYTE*) src, (rate / 100) * channels * 2, channels, rate, bitrate))
+		goto fail;
+
+	freerdp_dsp_context_reset(context);
+
+	if (!test_dsp_opus_stream(context, src, frames, channels, rate, bitrate, &data[1], &size[1], &packets[1]))
+		goto fail;
+
+	if ((size[0] != size[1]) || (memcmp(data[0], data[1], size[0]) != 0))
+	{
+		printf("Opus: stream after a reset differs from the first stream\n");
+		goto fail;
+	}
+
+	status = 0;
+fail:
+	free(src);
+	free(data[0]);
+	free(data[1]);
+	freerdp_dsp_context_free(context);
+	return status;
+}
+#endif
+
+/* Milliseconds of CPU time per second of audio */
+static void test_dsp_bench_resample(const char* name, BOOL general,
+	UINT32 schan, UINT32 srate, UINT32 rchan, UINT32 rrate)
+{
+	UINT32 i, j;
+	UINT32 start, elapsed;
+	INT16* src;
+	FREERDP_DSP_CONTEXT* context;
+
+	context = freerdp_dsp_context_new();
+	src = test_dsp_generate(schan, srate, srate);
+
+	if (!context || !src)
+		goto out;
+
+	if (general)
+		context->resample_filter = test_dsp_resample_filter;
+
+	start = GetTickCount();
+
+	for (i = 0; i < TEST_BENCH_SECONDS; i++)
+	{
+		for (j = 0; j < srate; j += TEST_CHUNK_FRAMES)
+		{
+			context->resample(context, (const BYTE*) &src[j * schan], 2,
+				schan, srate, MIN(TEST_CHUNK_FRAMES, srate - j), rchan, rrate);
+		}
+	}
+
+	elapsed = GetTickCount() - start;
+
+	printf("%-32s %8.3f ms per second of audio\n", name, (double) elapsed / TEST_BENCH_SECONDS);
+
+out:
+	free(src);
+	freerdp_dsp_context_free(context);
+}
+
+static void test_dsp_bench_codec(const char* name, UINT16 format, UINT32 channels, UINT32 rate, int param)
+{
+	UINT32 i;
+	UINT32 size;
+	UINT32 start, encode, decode;
+	BYTE* encoded = NULL;
+	INT16* src;
+	FREERDP_DSP_CONTEXT* context;
+
+	context = freerdp_dsp_context_new();
+	src = test_dsp_generate(channels, rate, rate);
+	size = rate * channels * 2;
+
+	if (!context || !src)
+		goto out;
+
+	start = GetTickCount();
+
+	for (i = 0; i < TEST_BENCH_SECONDS; i++)
+	{
+		if (format == WAVE_FORMAT_OPUS)
+			context->encode_opus(context, (BYTE*) src, size, channels, rate, param);
+		else if (format == WAVE_FORMAT_ADPCM)
+			context->encode_ms_adpcm(context, (BYTE*) src, size, channels, param);
+		else
+			context->encode_ima_adpcm(context, (BYTE*) src, size, channels, param);
+	}
+
+	encode = GetTickCount() - start;
+
+	encoded = (BYTE*) malloc(context->adpcm_size);
+
+	if (!encoded)
+		goto out;
+
+	size = context->adpcm_size;
+	CopyMemory(encoded, context->adpcm_buffer, size);
+
+	if (format != WAVE_FORMAT_OPUS)
+		size -= size % param;
+
+	start = GetTickCount();
+
+	for (i = 0; i < TEST_BENCH_SECONDS; i++)
+	{
+		if (format == WAVE_FORMAT_OPUS)
+			context->decode_opus(context, encoded, size, channels, rate);
+		else if (format == WAVE_FORMAT_ADPCM)
+			context->decode_ms_adpcm(context, encoded, size, channels, param);
+		else
+			context->decode_ima_adpcm(context, encoded, size, channels, param);
+	}
+
+	decode = GetTickCount() - start;
+
+	printf("%-32s %8.3f ms encode, %8.3f ms decode per second of audio\n", name,
+		(double) encode / TEST_BENCH_SECONDS, (double) decode / TEST_BENCH_SECONDS);
+
+out:
+	free(src);
+	free(encoded);
+	freerdp_dsp_context_free(context);
+}
+
+int TestFreeRDPCodecDsp(int argc, char* argv[])
+{
+	if (test_dsp_resample_quality(2, 44100, 2, 48000, 60.0) < 0)
+		return -1;
+
+	if (test_dsp_resample_quality(2, 48000, 2, 44100, 60.0) < 0)
+		return -1;
+
+	if (test_dsp_resample_quality(2, 22050, 2, 44100, 60.0) < 0)
+		return -1;
+
+	if (test_dsp_resample_quality(1, 48000, 1, 16000, 60.0) < 0)
+		return -1;
+
+	if (test_dsp_resample_quality(1, 11025, 2, 48000, 60.0) < 0)
+		return -1;
+
+	if (test_dsp_resample_quality(2, 44100, 1, 22050, 60.0) < 0)
+		return -1;
+
+	if (test_dsp_adpcm_quality(FALSE, 2, 22050, 2048, 20.0) < 0)
+		return -1;
+
+	if (test_dsp_adpcm_quality(TRUE, 2, 22050, 2048, 20.0) < 0)
+		return -1;
+
+#ifdef WITH_OPUS
+	if (test_dsp_opus_quality(2, 48000, 96000, 15.0) < 0)
+		return -1;
+
+	if (test_dsp_opus_quality(1, 16000, 24000, 10.0) < 0)
+		return -1;
+
+	if (test_dsp_opus_reset(2, 48000, 96000) < 0)
+		return -1;
+#endif
+
+	test_dsp_bench_resample("resample 44100/2 -> 48000/2", TRUE, 2, 44100, 2, 48000);
+	test_dsp_bench_resample("resample 44100/2 -> 48000/2 (opt)", FALSE, 2, 44100, 2, 48000);
+	test_dsp_bench_resample("resample 48000/1 -> 16000/1", TRUE, 1, 48000, 1, 16000);
+	test_dsp_bench_resample("resample 48000/1 -> 16000/1 (opt)", FALSE, 1, 48000, 1, 16000);
+
+	test_dsp_bench_codec("IMA ADPCM 44100/2", WAVE_FORMAT_DVI_ADPCM, 2, 44100, 2048);
+	test_dsp_bench_codec("MS ADPCM 44100/2", WAVE_FORMAT_ADPCM, 2, 44100, 2048);
+#ifdef WITH_OPUS
+	test_dsp_bench_codec("Opus 48000/2", WAVE_FORMAT_OPUS, 2, 48000, 96000);
+#endif
+
+	return 0;
+}
@@ -3065,6 +3065,160 @@ int test_individual_planes_encoding_rle()
 	return 0;
 }
 
+static int test_color_loss_encoding_mode(DWORD planarFlags, int width, int height, int tolerance)
+{
+	int x, y;
+	int dstSize;
+	int maxError;
+	BYTE* pDstData;
+	BYTE* srcBitmap;
+	BYTE* compressedBitmap;
+	BYTE* decompressedBitmap;
+	BITMAP_PLANAR_CONTEXT* planar;
+	int status = -1;
+
+	planar = freerdp_bitmap_planar_context_new(planarFlags, 64, 64);
+	srcBitmap = (BYTE*) malloc(width * height * 4);
+	decompressedBitmap = (BYTE*) malloc(width * height * 4);
+
+	if (!planar || !srcBitmap || !decompressedBitmap)
+		goto out;
+
+	/* photographic content: smooth gradients with some noise */
+
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			BYTE* pixel = &srcBitmap[((y * width) + x) * 4];
+
+			pixel[0] = (BYTE) ((x + y) + (rand() & 7)); /* B */
+			pixel[1] = (BYTE) ((y * 4) + (rand() & 3)); /* G */
+			pixel[2] = (BYTE) (x * 4); /* R */
+			pixel[3] = (BYTE) (0x80 + x); /* A */
+		}
+	}
+
+	if (planarFlags & PLANAR_FORMAT_HEADER_NA)
+		fill_bitmap_alpha_channel(srcBitmap, width, height, 0xFF);
+
+	compressedBitmap = freerdp_bitmap_compress_planar(planar, srcBitmap, PIXEL_FORMAT_ARGB32,
+			width, height, width * 4, NULL, &dstSize);
+
+	if (!compressedBitmap)
+	{
+		printf("failed to compress color loss bitmap: flags: 0x%02X\n", planarFlags);
+		goto out;
+	}
+
+	if ((compressedBitmap[0] & PLANAR_FORMAT_HEADER_CLL_MASK) != (planarFlags & PLANAR_FORMAT_HEADER_CLL_MASK))
+	{
+		printf("unexpected color loss level in format header: 0x%02X\n", compressedBitmap[0]);
+		free(compressedBitmap);
+		goto out;
+	}
+
+	pDstData = decompressedBitmap;
+
+	if (planar_decompress(planar, compressedBitmap, dstSize, &pDstData,
+			PIXEL_FORMAT_ARGB32, width * 4, 0, 0, width, height, TRUE) < 0)
+	{
+		printf("failed to decompress color loss bitmap: flags: 0x%02X\n", planarFlags);
+		free(compressedBitmap);
+		goto out;
+	}
+
+	free(compressedBitmap);
+
+	maxError = 0;
+
+	for (x = 0; x < width * height * 4; x++)
+	{
+		if (abs(srcBitmap[x] - decompressedBitmap[x]) > maxError)
+			maxError = abs(srcBitmap[x] - decompressedBitmap[x]);
+
+		if (((x % 4) == 3) && (srcBitmap[x] != decompressedBitmap[x]))
+			maxError = 256; /* alpha is never lossy */
+	}
+
+	printf("color loss bitmap: flags: 0x%02X size: %d max error: %d\n", planarFlags, dstSize, maxError);
+
+	if (maxError > tolerance)
+	{
+		printf("error: decompressed color loss bitmap is off by %d\n", maxError);
+		goto out;
+	}
+
+	status = 1;
+out:
+	free(srcBitmap);
+	free(decompressedBitmap);
+	freerdp_bitmap_planar_context_free(planar);
+	return status;
+}
+
+int test_color_loss_encoding()
+{
+	int width;
+	int height;
+	int dstSize;
+	BYTE* pDstData;
+	BYTE* whiteBitmap;
+	BYTE* compressedBitmap;
+	BYTE* decompressedBitmap;
+	BITMAP_PLANAR_CONTEXT* planar;
+
+	if (test_color_loss_encoding_mode(PLANAR_FORMAT_HEADER_NA | PLANAR_FORMAT_HEADER_RLE | 1, 64, 64, 1) < 0)
+		return -1;
+
+	if (test_color_loss_encoding_mode(PLANAR_FORMAT_HEADER_RLE | 3, 61, 37, 12) < 0)
+		return -1;
+
+	if (test_color_loss_encoding_mode(PLANAR_FORMAT_HEADER_NA | PLANAR_FORMAT_HEADER_RLE |
+			PLANAR_FORMAT_HEADER_CS | 2, 64, 64, 24) < 0)
+		return -1;
+
+	if (test_color_loss_encoding_mode(PLANAR_FORMAT_HEADER_CS | 3, 61, 37, 24) < 0)
+		return -1;
+
+	/* flat content is kept lossless */
+
+	width = 32;
+	height = 32;
+	planar = freerdp_bitmap_planar_context_new(PLANAR_FORMAT_HEADER_NA | PLANAR_FORMAT_HEADER_RLE |
+			PLANAR_FORMAT_HEADER_CS | 3, 64, 64);
+	whiteBitmap = (BYTE*) malloc(width * height * 4);
+	decompressedBitmap = (BYTE*) malloc(width * height * 4);
+	FillMemory(whiteBitmap, width * height * 4, 0xFF);
+	FillMemory(decompressedBitmap, width * height * 4, 0xFF); /* no alpha plane */
+
+	compressedBitmap = freerdp_bitmap_compress_planar(planar, whiteBitmap, PIXEL_FORMAT_ARGB32,
+			width, height, width * 4, NULL, &dstSize);
+
+	if (!compressedBitmap || (compressedBitmap[0] & (PLANAR_FORMAT_HEADER_CLL_MASK | PLANAR_FORMAT_HEADER_CS)))
+	{
+		printf("error: flat bitmap was not encoded losslessly\n");
+		return -1;
+	}
+
+	pDstData = decompressedBitmap;
+
+	if ((planar_decompress(planar, compressedBitmap, dstSize, &pDstData,
+			PIXEL_FORMAT_ARGB32, width * 4, 0, 0, width, height, TRUE) < 0) ||
+			(memcmp(decompressedBitmap, whiteBitmap, width * height * 4) != 0))
+	{
+		printf("error: decompressed flat bitmap is corrupted\n");
+		return -1;
+	}
+
+	free(compressedBitmap);
+	free(whiteBitmap);
+	free(decompressedBitmap);
+	freerdp_bitmap_planar_context_free(planar);
+
+	return 1;
+}
+
 int TestFreeRDPCodecPlanar(int argc, char* argv[])
 {
 	int i;
@@ -3172,6 +3326,11 @@ int TestFreeRDPCodecPlanar(int argc, char* argv[])
 		free(decompressedBitmap);
 	}
 
+	if (test_color_loss_encoding() < 0)
+	{
+		return -1;
+	}
+
 	return 0;
 
 	/* Experimental Case 01 */
@@ -3,8 +3,197 @@
 
 #include <freerdp/codec/zgfx.h>
 
+static const char* test_zgfx_text =
+	"The quick brown fox jumps over the lazy dog. "
+	"The quick brown fox jumps over the lazy dog again, "
+	"and then the lazy dog jumps over the quick brown fox.";
+
+static void test_zgfx_fill(BYTE* data, UINT32 size, int kind)
+{
+	UINT32 i;
+	UINT32 seed = 0x12345678;
+	UINT32 length = strlen(test_zgfx_text);
+
+	for (i = 0; i < size; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+
+		switch (kind)
+		{
+			case 0: /* text */
+				data[i] = test_zgfx_text[i % length];
+				break;
+
+			case 1: /* noise */
+				data[i] = (BYTE) (seed >> 16);
+				break;
+
+			case 2: /* 32bpp image rows with a few changing pixels */
+				data[i] = ((i % 4) == 3) ? 0xFF : (BYTE) ((i / 64) + ((seed >> 28) == 0 ? (seed >> 20) : 0));
+				break;
+
+			default: /* zeros */
+				data[i] = 0;
+				break;
+		}
+	}
+}
+
+static int test_zgfx_round_trip(const char* name, int kind, UINT32 size, UINT32 rounds, BOOL expectSavings)
+{
+	UINT32 round;
+	int status = -1;
+	BYTE* pSrcData;
+	BYTE* pDstData = NULL;
+	BYTE* pOutData = NULL;
+	UINT32 DstSize = 0;
+	UINT32 OutSize = 0;
+	UINT32 flags = 0;
+	UINT32 totalSrc = 0;
+	UINT32 totalDst = 0;
+	ZGFX_CONTEXT* compressor;
+	ZGFX_CONTEXT* decompressor;
+
+	compressor = zgfx_context_new(TRUE);
+	decompressor = zgfx_context_new(FALSE);
+	pSrcData = (BYTE*) malloc(size);
+
+	if (!compressor || !decompressor || !pSrcData)
+		goto out;
+
+	test_zgfx_fill(pSrcData, size, kind);
+
+	/* later rounds match against the history of the earlier ones */
+	for (round = 0; round < rounds; round++)
+	{
+		if (round)
+			pSrcData[(round * 7919) % size] ^= (BYTE) round;
+
+		if (zgfx_compress(compressor, pSrcData, size, &pDstData, &DstSize, &flags) < 0)
+		{
+			printf("%s: zgfx_compress failure\n", name);
+			goto out;
+		}
+
+		if (zgfx_decompress(decompressor, pDstData, DstSize, &pOutData, &OutSize, 0) < 0)
+		{
+			printf("%s: zgfx_decompress failure\n", name);
+			goto out;
+		}
+
+		if ((OutSize != size) || (memcmp(pOutData, pSrcData, size) != 0))
+		{
+			printf("%s: round %d mismatch, %d bytes out of %d\n", name, round, OutSize, size);
+			goto out;
+		}
+
+		totalSrc += size;
+		totalDst += DstSize;
+
+		free(pDstData);
+		free(pOutData);
+		pDstData = pOutData = NULL;
+	}
+
+	printf("%s: %d bytes compressed to %d (%.1f%%)\n", name, totalSrc, totalDst,
+			(totalDst * 100.0) / totalSrc);
+
+	if (expectSavings && ((totalDst * 2) > totalSrc))
+	{
+		printf("%s: expected at least 50%% savings\n", name);
+		goto out;
+	}
+
+	/* incompressible data must not grow beyond its segment headers */
+	if (!expectSavings && (totalDst > totalSrc + (rounds * (7 + ((size + 65534) / 65535) * 5))))
+	{
+		printf("%s: expansion of %d bytes\n", name, totalDst - totalSrc);
+		goto out;
+	}
+
+	status = 0;
+
+out:
+	free(pDstData);
+	free(pOutData);
+	free(pSrcData);
+	zgfx_context_free(compressor);
+	zgfx_context_free(decompressor);
+	return status;
+}
+
+static int test_zgfx_segment(void)
+{
+	int index;
+	wStream* s;
+	UINT32 flags;
+	int status = -1;
+	BYTE data[256];
+	ZGFX_CONTEXT* compressor = zgfx_context_new(TRUE);
+	ZGFX_CONTEXT* decompressor = zgfx_context_new(FALSE);
+
+	s = Stream_New(NULL, 64);
+
+	if (!compressor || !decompressor || !s)
+		goto out;
+
+	for (index = 0; index < 256; index++)
+		data[index] = (BYTE) (index % 13);
+
+	/* tiny segments are sent raw, repeated ones are matched */
+	for (index = 1; index <= 256; index *= 2)
+	{
+		Stream_SetPosition(s, 0);
+
+		if (zgfx_compress_segment(compressor, s, data, index, &flags) < 0)
+			goto out;
+
+		if (zgfx_decompress_segment(decompressor, Stream_Buffer(s), Stream_GetPosition(s)) < 0)
+			goto out;
+
+		if ((decompressor->OutputCount != (UINT32) index) ||
+				(memcmp(decompressor->OutputBuffer, data, index) != 0))
+		{
+			printf("segment of %d bytes mismatch\n", index);
+			goto out;
+		}
+
+		if ((index == 256) && !(flags & PACKET_COMPRESSED))
+		{
+			printf("segment of %d bytes was not compressed\n", index);
+			goto out;
+		}
+	}
+
+	status = 0;
+
+out:
+	Stream_Free(s, TRUE);
+	zgfx_context_free(compressor);
+	zgfx_context_free(decompressor);
+	return status;
+}
+
 int TestFreeRDPCodecZGfx(int argc, char* argv[])
 {
+	if (test_zgfx_segment() < 0)
+		return -1;
+
+	if (test_zgfx_round_trip("text", 0, 4096, 16, TRUE) < 0)
+		return -1;
+
+	if (test_zgfx_round_trip("noise", 1, 4096, 16, FALSE) < 0)
+		return -1;
+
+	if (test_zgfx_round_trip("image", 2, 64 * 64 * 4, 8, TRUE) < 0)
+		return -1;
+
+	if (test_zgfx_round_trip("zeros", 3, 200000, 2, TRUE) < 0)
+		return -1;
+
+	/* multipart segments wrapping around the history buffer */
+	if (test_zgfx_round_trip("noise multipart", 1, 1000000, 4, FALSE) < 0)
+		return -1;
+
 	return 0;
 }
-
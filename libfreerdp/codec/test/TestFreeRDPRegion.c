@@ -747,6 +747,150 @@ out:
 	return retCode;
 }
 
+#define COVERAGE_SIZE 256
+
+static void fillCoverage(BYTE *coverage, const REGION16 *region, BYTE value)
+{
+	const RECTANGLE_16 *rects;
+	int nbRects, i, x, y;
+
+	rects = region16_rects(region, &nbRects);
+
+	for (i = 0; i < nbRects; i++)
+	{
+		for (y = rects[i].top; y < rects[i].bottom; y++)
+		{
+			for (x = rects[i].left; x < rects[i].right; x++)
+				coverage[y * COVERAGE_SIZE + x] += value;
+		}
+	}
+}
+
+/* checks that both regions cover the same area and that the first one is
+ * made of disjoint rectangles, with no touching items within a band */
+static BOOL compareCoverage(const REGION16 *region, const REGION16 *expected)
+{
+	const RECTANGLE_16 *rects;
+	int nbRects, i;
+	BOOL status = TRUE;
+	BYTE *coverage = (BYTE *) calloc(COVERAGE_SIZE * COVERAGE_SIZE, 1);
+
+	if (!coverage)
+		return FALSE;
+
+	fillCoverage(coverage, region, 1);
+	fillCoverage(coverage, expected, 2);
+
+	for (i = 0; i < COVERAGE_SIZE * COVERAGE_SIZE; i++)
+	{
+		if (coverage[i] && (coverage[i] != 3))
+		{
+			fprintf(stderr, "coverage mismatch at (%d,%d): %d\n",
+					i % COVERAGE_SIZE, i / COVERAGE_SIZE, coverage[i]);
+			status = FALSE;
+			break;
+		}
+	}
+
+	free(coverage);
+
+	rects = region16_rects(region, &nbRects);
+
+	for (i = 1; status && (i < nbRects); i++)
+	{
+		if ((rects[i].top == rects[i - 1].top) && (rects[i].left <= rects[i - 1].right))
+		{
+			fprintf(stderr, "touching rects in band %d\n", rects[i].top);
+			status = FALSE;
+		}
+	}
+
+	return status;
+}
+
+static int test_union_rects() {
+	REGION16 region, expected, bulk;
+	int retCode = -1;
+	const RECTANGLE_16 *rects, *expectedRects;
+	int nbRects, nbExpectedRects, i, j;
+	RECTANGLE_16 inRectangles[64];
+
+	region16_init(&region);
+	region16_init(&expected);
+	region16_init(&bulk);
+
+	srand(1);
+
+	/* the bulk union must cover the same area as unioning rectangles one by one */
+	for (i = 0; i < 100; i++)
+	{
+		for (j = 0; j < 64; j++)
+		{
+			inRectangles[j].left = rand() % 190;
+			inRectangles[j].top = rand() % 190;
+			inRectangles[j].right = inRectangles[j].left + 1 + (rand() % 60);
+			inRectangles[j].bottom = inRectangles[j].top + 1 + (rand() % 60);
+		}
+
+		region16_clear(&expected);
+
+		for (j = 0; j < 64; j++)
+		{
+			if (!region16_union_rect(&expected, &expected, &inRectangles[j]))
+				goto out;
+		}
+
+		if (!region16_from_rects(&bulk, inRectangles, 64))
+			goto out;
+
+		/* half of them one by one, then the rest in place */
+		region16_clear(&region);
+
+		for (j = 0; j < 32; j++)
+		{
+			if (!region16_union_rect(&region, &region, &inRectangles[j]))
+				goto out;
+		}
+
+		if (!region16_union_rects(&region, &region, &inRectangles[32], 32))
+			goto out;
+
+		if (!compareCoverage(&bulk, &expected) || !compareCoverage(&region, &expected))
+			goto out;
+
+		if (!compareRectangles(region16_extents(&bulk), region16_extents(&expected), 1))
+			goto out;
+
+		if (!compareRectangles(region16_extents(&region), region16_extents(&expected), 1))
+			goto out;
+
+		/* both are built the same way from the same area */
+		rects = region16_rects(&region, &nbRects);
+		expectedRects = region16_rects(&bulk, &nbExpectedRects);
+		if (nbRects != nbExpectedRects || !compareRectangles(rects, expectedRects, nbRects))
+			goto out;
+	}
+
+	/* the spare storage kept by the bulk operations must not leak through copies */
+	if (!region16_copy(&expected, &bulk))
+		goto out;
+
+	rects = region16_rects(&expected, &nbRects);
+	expectedRects = region16_rects(&bulk, &nbExpectedRects);
+	if (nbRects != nbExpectedRects || !compareRectangles(rects, expectedRects, nbRects))
+		goto out;
+
+	if (!region16_from_rects(&bulk, NULL, 0) || !region16_is_empty(&bulk))
+		goto out;
+
+	retCode = 0;
+out:
+	region16_uninit(&bulk);
+	region16_uninit(&expected);
+	region16_uninit(&region);
+	return retCode;
+}
+
 typedef int (*TestFunction)();
 struct UnitaryTest {
 	const char *name;
@@ -767,6 +911,7 @@ struct UnitaryTest tests[] = {
 	{"(R1+R3)&R11 (band merge)",test_r1_r3_inter_r11},
 	{"norbert case",			test_norbert_case},
 	{"empty rectangle case",	test_empty_rectangle},
+	{"bulk union of rectangles",test_union_rects},
 
 	{NULL, NULL}
 };
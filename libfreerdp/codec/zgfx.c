@@ -25,6 +25,7 @@
 #include <winpr/print.h>
 #include <winpr/bitstream.h>
 
+#include <freerdp/settings.h>
 #include <freerdp/codec/zgfx.h>
 
 /**
@@ -379,14 +380,319 @@ int zgfx_decompress(ZGFX_CONTEXT* zgfx, BYTE* pSrcData, UINT32 SrcSize, BYTE** p
 	return 1;
 }
 
+/**
+ * The compressor writes each segment into the history buffer up front, the
+ * same way the decompressor ends up with it, and looks for matches through
+ * a hash of the next three bytes to their most recent position in the ring.
+ *
+ * Matches may overlap the bytes being encoded, the decompressor expands
+ * these byte by byte. Distances are kept below HistoryBufferSize minus the
+ * largest segment, so that a match never reaches into history the current
+ * segment has already overwritten on the compressor side.
+ */
+
+#define ZGFX_SEGMENT_MAX_SIZE		65535
+#define ZGFX_HASH_BITS			16
+#define ZGFX_HASH(_p) \
+	(((((UINT32) (_p)[0]) << 16 | ((UINT32) (_p)[1]) << 8 | (_p)[2]) * 2654435761U) >> (32 - ZGFX_HASH_BITS))
+
+struct _ZGFX_BIT_WRITER
+{
+	BYTE* pbOutput;
+	UINT32 BitsCurrent;
+	UINT32 cBitsCurrent;
+	UINT32 cBitsTotal;
+};
+typedef struct _ZGFX_BIT_WRITER ZGFX_BIT_WRITER;
+
+#define zgfx_PutBits(_bw, _value, _nbits) \
+	do { \
+		(_bw)->BitsCurrent = ((_bw)->BitsCurrent << (_nbits)) | ((_value) & ((1 << (_nbits)) - 1)); \
+		(_bw)->cBitsCurrent += (_nbits); \
+		(_bw)->cBitsTotal += (_nbits); \
+		while ((_bw)->cBitsCurrent >= 8) { \
+			(_bw)->cBitsCurrent -= 8; \
+			*((_bw)->pbOutput)++ = (BYTE) ((_bw)->BitsCurrent >> (_bw)->cBitsCurrent); \
+		} \
+		(_bw)->BitsCurrent &= ((1 << (_bw)->cBitsCurrent) - 1); \
+	} while (0)
+
+static UINT32 zgfx_count_bits(UINT32 count)
+{
+	UINT32 k = 0;
+
+	if (count == 3)
+		return 1;
+
+	while (count >= (8U << k))
+		k++;
+
+	/* 1, k ones and a 0, then 2 + k bits */
+	return 1 + (k + 1) + (2 + k);
+}
+
+static void zgfx_put_count(ZGFX_BIT_WRITER* bw, UINT32 count)
+{
+	UINT32 k = 0;
+
+	if (count == 3)
+	{
+		zgfx_PutBits(bw, 0, 1);
+		return;
+	}
+
+	while (count >= (8U << k))
+		k++;
+
+	zgfx_PutBits(bw, (1 << (k + 2)) - 2, k + 2);
+	zgfx_PutBits(bw, count - (4U << k), 2 + k);
+}
+
+static const ZGFX_TOKEN* zgfx_distance_token(UINT32 distance)
+{
+	int opIndex;
+	const ZGFX_TOKEN* token = NULL;
+
+	for (opIndex = 0; ZGFX_TOKEN_TABLE[opIndex].prefixLength != 0; opIndex++)
+	{
+		if (ZGFX_TOKEN_TABLE[opIndex].tokenType != 1)
+			continue;
+
+		if (ZGFX_TOKEN_TABLE[opIndex].valueBase > distance)
+			continue;
+
+		if (!token || (ZGFX_TOKEN_TABLE[opIndex].valueBase > token->valueBase))
+			token = &ZGFX_TOKEN_TABLE[opIndex];
+	}
+
+	return token;
+}
+
+int zgfx_compress_segment(ZGFX_CONTEXT* zgfx, wStream* s, const BYTE* pSrcData, UINT32 SrcSize, UINT32* pFlags)
+{
+	int opIndex;
+	BYTE* pbHeader;
+	BYTE* pbOutputEnd;
+	UINT32 index;
+	UINT32 hash;
+	UINT32 length;
+	UINT32 distance;
+	UINT32 candidate;
+	UINT32 matchBits;
+	UINT32 literalBits;
+	UINT32 historyStart;
+	UINT32 maxDistance;
+	UINT32 historySize;
+	UINT32 srcIndex = 0;
+	UINT16 literalCode[256];
+	BYTE literalLength[256];
+	const ZGFX_TOKEN* token;
+	ZGFX_BIT_WRITER bw;
+
+	if (!zgfx->Compressor || !zgfx->HashTable || (SrcSize > ZGFX_SEGMENT_MAX_SIZE))
+		return -1;
+
+	/* the header, the data and room for the last token and the padding byte */
+	if (!Stream_EnsureRemainingCapacity(s, 1 + SrcSize + 16))
+		return -1;
+
+	/* a literal is a 0 bit followed by the byte, unless it has a token of its own */
+	for (index = 0; index < 256; index++)
+	{
+		literalCode[index] = (UINT16) index;
+		literalLength[index] = 9;
+	}
+
+	for (opIndex = 0; ZGFX_TOKEN_TABLE[opIndex].prefixLength != 0; opIndex++)
+	{
+		if (ZGFX_TOKEN_TABLE[opIndex].tokenType != 0 || ZGFX_TOKEN_TABLE[opIndex].valueBits)
+			continue;
+
+		index = ZGFX_TOKEN_TABLE[opIndex].valueBase;
+		literalCode[index] = (UINT16) ZGFX_TOKEN_TABLE[opIndex].prefixCode;
+		literalLength[index] = (BYTE) ZGFX_TOKEN_TABLE[opIndex].prefixLength;
+	}
+
+	historySize = zgfx->HistoryBufferSize;
+	historyStart = zgfx->HistoryIndex;
+	maxDistance = historySize - (ZGFX_SEGMENT_MAX_SIZE + 1);
+
+	zgfx_history_buffer_ring_write(zgfx, (BYTE*) pSrcData, SrcSize);
+
+	pbHeader = Stream_Pointer(s);
+	ZeroMemory(&bw, sizeof(bw));
+	bw.pbOutput = &pbHeader[1];
+
+	/* give up as soon as the bits no longer fit in the size of a raw segment */
+	pbOutputEnd = &pbHeader[SrcSize];
+
+	while ((srcIndex < SrcSize) && (bw.pbOutput < pbOutputEnd))
+	{
+		length = 0;
+		distance = 0;
+
+		if ((srcIndex + 3) <= SrcSize)
+		{
+			hash = ZGFX_HASH(&pSrcData[srcIndex]);
+			candidate = zgfx->HashTable[hash];
+			zgfx->HashTable[hash] = ((historyStart + srcIndex) % historySize) + 1;
+
+			if (candidate)
+			{
+				index = candidate - 1;
+				distance = (historyStart + srcIndex + historySize - index) % historySize;
+
+				if (distance && (distance <= maxDistance))
+				{
+					while (((srcIndex + length) < SrcSize) &&
+							(zgfx->HistoryBuffer[index] == pSrcData[srcIndex + length]))
+					{
+						length++;
+
+						if (++index == historySize)
+							index = 0;
+					}
+				}
+			}
+		}
+
+		if (length >= 3)
+		{
+			token = zgfx_distance_token(distance);
+			matchBits = token->prefixLength + token->valueBits + zgfx_count_bits(length);
+
+			literalBits = 0;
+
+			for (index = 0; (index < length) && (literalBits <= matchBits); index++)
+				literalBits += literalLength[pSrcData[srcIndex + index]];
+
+			if (literalBits > matchBits)
+			{
+				zgfx_PutBits(&bw, token->prefixCode, token->prefixLength);
+				zgfx_PutBits(&bw, distance - token->valueBase, token->valueBits);
+				zgfx_put_count(&bw, length);
+
+				for (index = 1; (index < length) && ((srcIndex + index + 3) <= SrcSize); index++)
+				{
+					hash = ZGFX_HASH(&pSrcData[srcIndex + index]);
+					zgfx->HashTable[hash] = ((historyStart + srcIndex + index) % historySize) + 1;
+				}
+
+				srcIndex += length;
+				continue;
+			}
+		}
+
+		index = pSrcData[srcIndex++];
+		zgfx_PutBits(&bw, literalCode[index], literalLength[index]);
+	}
+
+	if ((srcIndex < SrcSize) || ((bw.pbOutput + (bw.cBitsCurrent ? 1 : 0) + 1) >= &pbHeader[1 + SrcSize]))
+	{
+		/* no savings: the history holds the data already, send it raw */
+		pbHeader[0] = PACKET_COMPR_TYPE_RDP8;
+		CopyMemory(&pbHeader[1], pSrcData, SrcSize);
+		Stream_Seek(s, 1 + SrcSize);
+	}
+	else
+	{
+		/* the last byte is the number of padding bits in the byte before it */
+		length = (8 - (bw.cBitsTotal % 8)) % 8;
+
+		if (length)
+			zgfx_PutBits(&bw, 0, length);
+
+		*(bw.pbOutput)++ = (BYTE) length;
+
+		pbHeader[0] = PACKET_COMPR_TYPE_RDP8 | PACKET_COMPRESSED;
+		Stream_Seek(s, bw.pbOutput - pbHeader);
+	}
+
+	if (pFlags)
+		*pFlags = pbHeader[0];
+
+	return 1;
+}
+
 int zgfx_compress(ZGFX_CONTEXT* zgfx, BYTE* pSrcData, UINT32 SrcSize, BYTE** ppDstData, UINT32* pDstSize, UINT32* pFlags)
 {
+	wStream* s;
+	UINT32 flags;
+	UINT32 segmentSize;
+	UINT32 segmentOffset;
+	UINT32 segmentCount;
+	size_t end;
+	size_t position;
+
+	segmentCount = (SrcSize + ZGFX_SEGMENT_MAX_SIZE - 1) / ZGFX_SEGMENT_MAX_SIZE;
+
+	if (segmentCount > 0xFFFF)
+		return -1;
+
+	s = Stream_New(NULL, 7 + SrcSize + (segmentCount * 4) + 16);
+
+	if (!s)
+		return -1;
+
+	if (SrcSize <= ZGFX_SEGMENT_MAX_SIZE)
+	{
+		Stream_Write_UINT8(s, ZGFX_SEGMENTED_SINGLE); /* descriptor (1 byte) */
+
+		if (zgfx_compress_segment(zgfx, s, pSrcData, SrcSize, &flags) < 0)
+		{
+			Stream_Free(s, TRUE);
+			return -1;
+		}
+	}
+	else
+	{
+		Stream_Write_UINT8(s, ZGFX_SEGMENTED_MULTIPART); /* descriptor (1 byte) */
+		Stream_Write_UINT16(s, segmentCount); /* segmentCount (2 bytes) */
+		Stream_Write_UINT32(s, SrcSize); /* uncompressedSize (4 bytes) */
+
+		for (segmentOffset = 0; segmentOffset < SrcSize; segmentOffset += segmentSize)
+		{
+			segmentSize = MIN(SrcSize - segmentOffset, ZGFX_SEGMENT_MAX_SIZE);
+
+			if (!Stream_EnsureRemainingCapacity(s, 4))
+			{
+				Stream_Free(s, TRUE);
+				return -1;
+			}
+
+			position = Stream_GetPosition(s);
+			Stream_Seek(s, 4); /* size (4 bytes) */
+
+			if (zgfx_compress_segment(zgfx, s, &pSrcData[segmentOffset], segmentSize, &flags) < 0)
+			{
+				Stream_Free(s, TRUE);
+				return -1;
+			}
+
+			end = Stream_GetPosition(s);
+			Stream_SetPosition(s, position);
+			Stream_Write_UINT32(s, (UINT32) (end - position - 4));
+			Stream_SetPosition(s, end);
+		}
+	}
+
+	*ppDstData = Stream_Buffer(s);
+	*pDstSize = Stream_GetPosition(s);
+
+	if (pFlags)
+		*pFlags = flags;
+
+	Stream_Free(s, FALSE);
+
 	return 1;
 }
 
 void zgfx_context_reset(ZGFX_CONTEXT* zgfx, BOOL flush)
 {
 	zgfx->HistoryIndex = 0;
+
+	if (zgfx->HashTable)
+		ZeroMemory(zgfx->HashTable, sizeof(UINT32) << ZGFX_HASH_BITS);
 }
 
 ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor)
@@ -401,6 +707,17 @@ ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor)
 
 		zgfx->HistoryBufferSize = sizeof(zgfx->HistoryBuffer);
 
+		if (Compressor)
+		{
+			zgfx->HashTable = (UINT32*) calloc(1, sizeof(UINT32) << ZGFX_HASH_BITS);
+
+			if (!zgfx->HashTable)
+			{
+				free(zgfx);
+				return NULL;
+			}
+		}
+
 		zgfx_context_reset(zgfx, FALSE);
 	}
 
@@ -409,6 +726,10 @@ ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor)
 
 void zgfx_context_free(ZGFX_CONTEXT* zgfx)
 {
+	if (!zgfx)
+		return;
+
+	free(zgfx->HashTable);
 	free(zgfx);
 }
 
@@ -740,6 +740,9 @@ BOOL freerdp_get_param_bool(rdpSettings* settings, int id)
 		case FreeRDP_UseRdpSecurityLayer:
 			return settings->UseRdpSecurityLayer;
 
+		case FreeRDP_PipelineChannelJoin:
+			return settings->PipelineChannelJoin;
+
 		case FreeRDP_ConsoleSession:
 			return settings->ConsoleSession;
 
@@ -929,6 +932,12 @@ BOOL freerdp_get_param_bool(rdpSettings* settings, int id)
 		case FreeRDP_PlayRemoteFx:
 			return settings->PlayRemoteFx;
 
+		case FreeRDP_DumpSession:
+			return settings->DumpSession;
+
+		case FreeRDP_PlaySession:
+			return settings->PlaySession;
+
 		case FreeRDP_GatewayUseSameCredentials:
 			return settings->GatewayUseSameCredentials;
 
@@ -947,6 +956,9 @@ BOOL freerdp_get_param_bool(rdpSettings* settings, int id)
 		case FreeRDP_GatewayUdpTransport:
 			return settings->GatewayUdpTransport;
 
+		case FreeRDP_GatewayHttpUseWebsockets:
+			return settings->GatewayHttpUseWebsockets;
+
 		case FreeRDP_RemoteApplicationMode:
 			return settings->RemoteApplicationMode;
 
@@ -1019,6 +1031,9 @@ BOOL freerdp_get_param_bool(rdpSettings* settings, int id)
 		case FreeRDP_MultiTouchGestures:
 			return settings->MultiTouchGestures;
 
+		case FreeRDP_InputBatching:
+			return settings->InputBatching;
+
 		case FreeRDP_SoundBeepsEnabled:
 			return settings->SoundBeepsEnabled;
 
@@ -1143,6 +1158,10 @@ int freerdp_set_param_bool(rdpSettings* settings, int id, BOOL param)
 			settings->UseRdpSecurityLayer = param;
 			break;
 
+		case FreeRDP_PipelineChannelJoin:
+			settings->PipelineChannelJoin = param;
+			break;
+
 		case FreeRDP_ConsoleSession:
 			settings->ConsoleSession = param;
 			break;
@@ -1395,6 +1414,14 @@ int freerdp_set_param_bool(rdpSettings* settings, int id, BOOL param)
 			settings->PlayRemoteFx = param;
 			break;
 
+		case FreeRDP_DumpSession:
+			settings->DumpSession = param;
+			break;
+
+		case FreeRDP_PlaySession:
+			settings->PlaySession = param;
+			break;
+
 		case FreeRDP_GatewayUseSameCredentials:
 			settings->GatewayUseSameCredentials = param;
 			break;
@@ -1419,6 +1446,10 @@ int freerdp_set_param_bool(rdpSettings* settings, int id, BOOL param)
 			settings->GatewayUdpTransport = param;
 			break;
 
+		case FreeRDP_GatewayHttpUseWebsockets:
+			settings->GatewayHttpUseWebsockets = param;
+			break;
+
 		case FreeRDP_RemoteApplicationMode:
 			settings->RemoteApplicationMode = param;
 			break;
@@ -1515,6 +1546,10 @@ int freerdp_set_param_bool(rdpSettings* settings, int id, BOOL param)
 			settings->MultiTouchGestures = param;
 			break;
 
+		case FreeRDP_InputBatching:
+			settings->InputBatching = param;
+			break;
+
 		case FreeRDP_SoundBeepsEnabled:
 			settings->SoundBeepsEnabled = param;
 			break;
@@ -1832,6 +1867,10 @@ UINT32 freerdp_get_param_uint32(rdpSettings* settings, int id)
 			return settings->KeyboardHook;
 			break;
 
+		case FreeRDP_InputBatchingInterval:
+			return settings->InputBatchingInterval;
+			break;
+
 		case FreeRDP_BrushSupportLevel:
 			return settings->BrushSupportLevel;
 
@@ -2138,6 +2177,10 @@ int freerdp_set_param_uint32(rdpSettings* settings, int id, UINT32 param)
 			settings->KeyboardHook = param;
 			break;
 
+		case FreeRDP_InputBatchingInterval:
+			settings->InputBatchingInterval = param;
+			break;
+
 		case FreeRDP_BrushSupportLevel:
 			settings->BrushSupportLevel = param;
 			break;
@@ -2388,6 +2431,12 @@ char* freerdp_get_param_string(rdpSettings* settings, int id)
 		case FreeRDP_PlayRemoteFxFile:
 			return settings->PlayRemoteFxFile;
 
+		case FreeRDP_DumpSessionFile:
+			return settings->DumpSessionFile;
+
+		case FreeRDP_PlaySessionFile:
+			return settings->PlaySessionFile;
+
 		case FreeRDP_GatewayHostname:
 			return settings->GatewayHostname;
 
@@ -2599,6 +2648,16 @@ int freerdp_set_param_string(rdpSettings* settings, int id, const char* param)
 			settings->PlayRemoteFxFile = _strdup(param);
 			break;
 
+		case FreeRDP_DumpSessionFile:
+			free(settings->DumpSessionFile);
+			settings->DumpSessionFile = _strdup(param);
+			break;
+
+		case FreeRDP_PlaySessionFile:
+			free(settings->PlaySessionFile);
+			settings->PlaySessionFile = _strdup(param);
+			break;
+
 		case FreeRDP_GatewayHostname:
 			free(settings->GatewayHostname);
 			settings->GatewayHostname = _strdup(param);
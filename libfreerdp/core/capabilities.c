@@ -389,7 +389,7 @@ void rdp_write_bitmap_capability_set(wStream* s, rdpSettings* settings)
 		drawingFlags |= DRAW_ALLOW_DYNAMIC_COLOR_FIDELITY;
 
 	if (settings->DrawAllowColorSubsampling)
-		drawingFlags |= DRAW_ALLOW_COLOR_SUBSAMPLING; /* currently unimplemented */
+		drawingFlags |= DRAW_ALLOW_COLOR_SUBSAMPLING;
 
 	/* While bitmap_decode.c now implements YCoCg, in turning it
 	 * on we have found Microsoft is inconsistent on whether to invert R & B.
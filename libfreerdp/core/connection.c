@@ -641,6 +641,77 @@ end2:
 	return ret;
 }
 
+/**
+ * Send the join requests for the user, global, message and static virtual
+ * channels back to back, instead of waiting for each confirm in turn.
+ * The confirms are then matched in any order by
+ * rdp_client_connect_mcs_channel_join_confirm.
+ */
+
+BOOL rdp_client_send_channel_join_requests(rdpRdp* rdp)
+{
+	BOOL status;
+	UINT32 index;
+	UINT32 count = 0;
+	UINT16* channelIds;
+	rdpMcs* mcs = rdp->mcs;
+
+	channelIds = (UINT16*) calloc(mcs->channelCount + 3, sizeof(UINT16));
+
+	if (!channelIds)
+		return FALSE;
+
+	channelIds[count++] = mcs->userId;
+	channelIds[count++] = MCS_GLOBAL_CHANNEL_ID;
+
+	if (mcs->messageChannelId != 0)
+		channelIds[count++] = mcs->messageChannelId;
+
+	for (index = 0; index < mcs->channelCount; index++)
+		channelIds[count++] = mcs->channels[index].ChannelId;
+
+	status = mcs_send_channel_join_requests(mcs, channelIds, count);
+	free(channelIds);
+
+	return status;
+}
+
+static BOOL rdp_client_match_channel_join_confirm(rdpMcs* mcs, UINT16 channelId)
+{
+	UINT32 index;
+
+	if (!mcs->userChannelJoined && (channelId == mcs->userId))
+	{
+		mcs->userChannelJoined = TRUE;
+		return TRUE;
+	}
+
+	if (!mcs->globalChannelJoined && (channelId == MCS_GLOBAL_CHANNEL_ID))
+	{
+		mcs->globalChannelJoined = TRUE;
+		return TRUE;
+	}
+
+	if ((mcs->messageChannelId != 0) && !mcs->messageChannelJoined &&
+			(channelId == mcs->messageChannelId))
+	{
+		mcs->messageChannelJoined = TRUE;
+		return TRUE;
+	}
+
+	for (index = 0; index < mcs->channelCount; index++)
+	{
+		if (!mcs->channels[index].joined && (mcs->channels[index].ChannelId == channelId))
+		{
+			mcs->channels[index].joined = TRUE;
+			return TRUE;
+		}
+	}
+
+	WLog_ERR(TAG, "unexpected channel join confirm for channel %d", channelId);
+	return FALSE;
+}
+
 BOOL rdp_client_connect_mcs_channel_join_confirm(rdpRdp* rdp, wStream* s)
 {
 	UINT32 i;
@@ -651,7 +722,21 @@ BOOL rdp_client_connect_mcs_channel_join_confirm(rdpRdp* rdp, wStream* s)
 	if (!mcs_recv_channel_join_confirm(mcs, s, &channelId))
 		return FALSE;
 
-	if (!mcs->userChannelJoined)
+	if (rdp->settings->PipelineChannelJoin)
+	{
+		if (!rdp_client_match_channel_join_confirm(mcs, channelId))
+			return FALSE;
+
+		if ((mcs->messageChannelId != 0) && !mcs->messageChannelJoined)
+			allJoined = FALSE;
+
+		for (i = 0; i < mcs->channelCount; i++)
+		{
+			if (!mcs->channels[i].joined)
+				allJoined = FALSE;
+		}
+	}
+	else if (!mcs->userChannelJoined)
 	{
 		if (channelId != mcs->userId)
 			return FALSE;
@@ -52,6 +52,7 @@ BOOL rdp_client_connect(rdpRdp* rdp);
 BOOL rdp_client_disconnect(rdpRdp* rdp);
 BOOL rdp_client_reconnect(rdpRdp* rdp);
 BOOL rdp_client_redirect(rdpRdp* rdp);
+BOOL rdp_client_send_channel_join_requests(rdpRdp* rdp);
 BOOL rdp_client_connect_mcs_channel_join_confirm(rdpRdp* rdp, wStream* s);
 BOOL rdp_client_connect_auto_detect(rdpRdp* rdp, wStream* s);
 int rdp_client_connect_license(rdpRdp* rdp, wStream* s);
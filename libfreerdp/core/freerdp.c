@@ -91,7 +91,30 @@ BOOL freerdp_connect(freerdp* instance)
 		goto freerdp_connect_finally;
 	}
 
-	status = rdp_client_connect(rdp);
+	if (settings->DumpSession && settings->PlaySession)
+	{
+		WLog_ERR(TAG, "a session cannot be recorded and replayed at the same time");
+		status = FALSE;
+		goto freerdp_connect_finally;
+	}
+
+	if (settings->DumpSession)
+	{
+		rdp->record = record_new(rdp, settings->DumpSessionFile, TRUE);
+
+		if (!rdp->record)
+			WLog_ERR(TAG, "unable to record the session to %s", settings->DumpSessionFile);
+	}
+
+	if (settings->PlaySession)
+	{
+		rdp->record = record_new(rdp, settings->PlaySessionFile, FALSE);
+		status = rdp->record ? record_replay_connect(rdp->record) : FALSE;
+	}
+	else
+	{
+		status = rdp_client_connect(rdp);
+	}
 
 	/* --authonly tests the connection without a UI */
 	if (instance->settings->AuthenticationOnly)
@@ -121,6 +144,16 @@ BOOL freerdp_connect(freerdp* instance)
 			goto freerdp_connect_finally;
 		}
 
+		if (settings->PlaySession)
+		{
+			int replayStatus;
+
+			while ((replayStatus = record_replay_pdu(rdp->record)) > 0);
+
+			status = (replayStatus == 0) ? TRUE : FALSE;
+			goto freerdp_connect_finally;
+		}
+
 		if (instance->settings->PlayRemoteFx)
 		{
 			wStream* s;
@@ -205,6 +238,9 @@ BOOL freerdp_check_fds(freerdp* instance)
 
 	status = rdp_check_fds(rdp);
 
+	if ((status >= 0) && !input_check_batch(rdp->input))
+		status = -1;
+
 	if (status < 0)
 	{
 		TerminateEventArgs e;
@@ -234,6 +270,14 @@ DWORD freerdp_get_event_handles(rdpContext* context, HANDLE* events, DWORD count
 	else
 		return 0;
 
+	if (input_get_batch_event_handle(context->input))
+	{
+		if (nCount < count)
+			events[nCount++] = input_get_batch_event_handle(context->input);
+		else
+			return 0;
+	}
+
 	return nCount;
 }
 
@@ -334,6 +378,12 @@ BOOL freerdp_disconnect(freerdp* instance)
 
 	IFCALL(instance->PostDisconnect, instance);
 
+	if (rdp->record)
+	{
+		record_free(rdp->record);
+		rdp->record = NULL;
+	}
+
 	if (instance->update->pcap_rfx)
 	{
 		instance->update->dump_rfx = FALSE;
@@ -254,6 +254,17 @@ BOOL http_request_set_transfer_encoding(HttpRequest* request, const char* Transf
 	return TRUE;
 }
 
+BOOL http_request_set_websocket_key(HttpRequest* request, const char* SecWebSocketKey)
+{
+	free(request->SecWebSocketKey);
+	request->SecWebSocketKey = _strdup(SecWebSocketKey);
+
+	if (!request->SecWebSocketKey)
+		return FALSE;
+
+	return TRUE;
+}
+
 char* http_encode_body_line(char* param, char* value)
 {
 	char* line;
@@ -331,7 +342,11 @@ wStream* http_request_write(HttpContext* context, HttpRequest* request)
 
 	lines[count++] = http_encode_header_line(request->Method, request->URI);
 	lines[count++] = http_encode_body_line("Cache-Control", context->CacheControl);
-	lines[count++] = http_encode_body_line("Connection", context->Connection);
+	if (request->SecWebSocketKey)
+		lines[count++] = http_encode_body_line("Connection", "Upgrade");
+	else
+		lines[count++] = http_encode_body_line("Connection", context->Connection);
+
 	lines[count++] = http_encode_body_line("Pragma", context->Pragma);
 	lines[count++] = http_encode_body_line("Accept", context->Accept);
 	lines[count++] = http_encode_body_line("User-Agent", context->UserAgent);
@@ -365,6 +380,16 @@ wStream* http_request_write(HttpContext* context, HttpRequest* request)
 		count++;
 	}
 
+	if (request->SecWebSocketKey)
+	{
+		lines[count++] = http_encode_body_line("Upgrade", "websocket");
+		lines[count++] = http_encode_body_line("Sec-WebSocket-Version", "13");
+		lines[count++] = http_encode_body_line("Sec-WebSocket-Key", request->SecWebSocketKey);
+
+		if (!lines[count - 3] || !lines[count - 2] || !lines[count - 1])
+			goto out_free;
+	}
+
 	if (request->Authorization)
 	{
 		lines[count] = http_encode_body_line("Authorization", request->Authorization);
@@ -435,6 +460,7 @@ void http_request_free(HttpRequest* request)
 	free(request->Method);
 	free(request->URI);
 	free(request->TransferEncoding);
+	free(request->SecWebSocketKey);
 	free(request);
 }
 
@@ -483,6 +509,20 @@ BOOL http_response_parse_header_field(HttpResponse* response, char* name, char*
 		if (!response->ContentType)
 			return FALSE;
 	}
+	else if (_stricmp(name, "Upgrade") == 0)
+	{
+		response->Upgrade = _strdup(value);
+
+		if (!response->Upgrade)
+			return FALSE;
+	}
+	else if (_stricmp(name, "Sec-WebSocket-Accept") == 0)
+	{
+		response->SecWebSocketAccept = _strdup(value);
+
+		if (!response->SecWebSocketAccept)
+			return FALSE;
+	}
 	else if (_stricmp(name, "WWW-Authenticate") == 0)
 	{
 		char* separator = NULL;
@@ -826,6 +866,8 @@ void http_response_free(HttpResponse* response)
 	free(response->ReasonPhrase);
 
 	free(response->ContentType);
+	free(response->Upgrade);
+	free(response->SecWebSocketAccept);
 
 	ListDictionary_Free(response->Authenticates);
 
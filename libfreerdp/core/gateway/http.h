@@ -66,6 +66,7 @@ struct _http_request
 	int ContentLength;
 	char* Content;
 	char* TransferEncoding;
+	char* SecWebSocketKey;
 };
 
 BOOL http_request_set_method(HttpRequest* request, const char* Method);
@@ -73,6 +74,7 @@ BOOL http_request_set_uri(HttpRequest* request, const char* URI);
 BOOL http_request_set_auth_scheme(HttpRequest* request, const char* AuthScheme);
 BOOL http_request_set_auth_param(HttpRequest* request, const char* AuthParam);
 BOOL http_request_set_transfer_encoding(HttpRequest* request, const char* TransferEncoding);
+BOOL http_request_set_websocket_key(HttpRequest* request, const char* SecWebSocketKey);
 
 wStream* http_request_write(HttpContext* context, HttpRequest* request);
 
@@ -90,6 +92,9 @@ struct _http_response
 	int ContentLength;
 	char* ContentType;
 
+	char* Upgrade;
+	char* SecWebSocketAccept;
+
 	int BodyLength;
 	BYTE* BodyContent;
 
@@ -49,25 +49,66 @@ typedef struct rdg_packet_header
 
 #pragma pack(pop)
 
-BOOL rdg_write_packet(rdpRdg* rdg, wStream* sPacket)
+/* the data packet size field is 16 bits wide */
+#define RDG_DATA_PACKET_MAX_SIZE	0xFFFF
+
+/* worst case framing overhead: 14 bytes of WebSocket header, or chunk size line and trailer */
+#define RDG_FRAME_OVERHEAD		16
+
+/**
+ * Outbound RDG packets are framed as HTTP chunks on the IN channel, or as
+ * masked binary frames on the upgraded OUT channel connection. Frames are
+ * built in buffers taken from the stream pool and sent with a single write.
+ */
+
+static wStream* rdg_frame_new(rdpRdg* rdg, UINT32 payloadLength)
 {
-	int status;
-	wStream* sChunk;
+	wStream* s;
 	char chunkSize[11];
 
-	sprintf_s(chunkSize, sizeof(chunkSize), "%X\r\n", (unsigned int) Stream_Length(sPacket));
-	sChunk = Stream_New(NULL, strlen(chunkSize) + Stream_Length(sPacket) + 2);
+	s = StreamPool_Take(rdg->streamPool, payloadLength + RDG_FRAME_OVERHEAD);
 
-	if (!sChunk)
-		return FALSE;
+	if (!s)
+		return NULL;
 
-	Stream_Write(sChunk, chunkSize, strlen(chunkSize));
-	Stream_Write(sChunk, Stream_Buffer(sPacket), Stream_Length(sPacket));
-	Stream_Write(sChunk, "\r\n", 2);
-	Stream_SealLength(sChunk);
+	if (rdg->transferEncoding == RDG_TRANSFER_ENCODING_WEBSOCKET)
+	{
+		if (!websocket_write_frame_header(s, WEBSOCKET_OPCODE_BINARY, payloadLength, TRUE))
+		{
+			Stream_Release(s);
+			return NULL;
+		}
+	}
+	else
+	{
+		sprintf_s(chunkSize, sizeof(chunkSize), "%X\r\n", (unsigned int) payloadLength);
+		Stream_Write(s, chunkSize, strlen(chunkSize));
+	}
+
+	return s;
+}
+
+static BOOL rdg_frame_send(rdpRdg* rdg, wStream* s, UINT32 payloadLength)
+{
+	int status;
+	int headerLength;
+	rdpTls* tls = rdg->tlsIn;
+	BYTE* buffer = Stream_Buffer(s);
+
+	if (rdg->transferEncoding == RDG_TRANSFER_ENCODING_WEBSOCKET)
+	{
+		/* the masking key is the last part of the frame header */
+		headerLength = websocket_frame_header_length(payloadLength, TRUE);
+		websocket_mask_payload(&buffer[headerLength], payloadLength, &buffer[headerLength - 4], 0);
+		tls = rdg->tlsOut;
+	}
+	else
+	{
+		Stream_Write(s, "\r\n", 2);
+	}
 
-	status = tls_write_all(rdg->tlsIn, Stream_Buffer(sChunk), Stream_Length(sChunk));
-	Stream_Free(sChunk, TRUE);
+	status = tls_write_all(tls, buffer, Stream_GetPosition(s));
+	Stream_Release(s);
 
 	if (status < 0)
 		return FALSE;
@@ -75,6 +116,28 @@ BOOL rdg_write_packet(rdpRdg* rdg, wStream* sPacket)
 	return TRUE;
 }
 
+static int rdg_socket_read(rdpRdg* rdg, BYTE* buffer, int size)
+{
+	if (rdg->transferEncoding == RDG_TRANSFER_ENCODING_WEBSOCKET)
+		return websocket_read(rdg->websocket, rdg->tlsOut->bio, buffer, size);
+
+	return BIO_read(rdg->tlsOut->bio, buffer, size);
+}
+
+BOOL rdg_write_packet(rdpRdg* rdg, wStream* sPacket)
+{
+	wStream* s;
+
+	s = rdg_frame_new(rdg, Stream_Length(sPacket));
+
+	if (!s)
+		return FALSE;
+
+	Stream_Write(s, Stream_Buffer(sPacket), Stream_Length(sPacket));
+
+	return rdg_frame_send(rdg, s, Stream_Length(sPacket));
+}
+
 wStream* rdg_receive_packet(rdpRdg* rdg)
 {
 	int status;
@@ -91,15 +154,21 @@ wStream* rdg_receive_packet(rdpRdg* rdg)
 
 	while (readCount < sizeof(RdgPacketHeader))
 	{
-		status = BIO_read(rdg->tlsOut->bio, Stream_Pointer(s), sizeof(RdgPacketHeader) - readCount);
+		status = rdg_socket_read(rdg, Stream_Pointer(s), sizeof(RdgPacketHeader) - readCount);
 
-		if (status < 0)
+		if (status <= 0)
 		{
+			if (!BIO_should_retry(rdg->tlsOut->bio))
+			{
+				Stream_Free(s, TRUE);
+				return NULL;
+			}
+
 			continue;
 		}
 
 		readCount += status;
-		Stream_Seek(s, readCount);
+		Stream_Seek(s, status);
 	}
 
 	if (Stream_Capacity(s) < packet->packetLength)
@@ -114,15 +183,21 @@ wStream* rdg_receive_packet(rdpRdg* rdg)
 
 	while (readCount < packet->packetLength)
 	{
-		status = BIO_read(rdg->tlsOut->bio, Stream_Pointer(s), packet->packetLength - readCount);
+		status = rdg_socket_read(rdg, Stream_Pointer(s), packet->packetLength - readCount);
 
-		if (status < 0)
+		if (status <= 0)
 		{
+			if (!BIO_should_retry(rdg->tlsOut->bio))
+			{
+				Stream_Free(s, TRUE);
+				return NULL;
+			}
+
 			continue;
 		}
 
 		readCount += status;
-		Stream_Seek(s, readCount);
+		Stream_Seek(s, status);
 	}
 
 	Stream_SealLength(s);
@@ -320,6 +395,12 @@ wStream* rdg_build_http_request(rdpRdg* rdg, char* method)
 		http_request_set_transfer_encoding(request, "chunked");
 	}
 
+	if (rdg->websocketKey && (rdg->state < RDG_CLIENT_STATE_OUT_CHANNEL_AUTHORIZED))
+	{
+		if (!http_request_set_websocket_key(request, rdg->websocketKey))
+			return NULL;
+	}
+
 	s = http_request_write(rdg->http, request);
 	http_request_free(request);
 
@@ -390,7 +471,20 @@ BOOL rdg_process_out_channel_response(rdpRdg* rdg, HttpResponse* response)
 
 BOOL rdg_process_out_channel_authorization(rdpRdg* rdg, HttpResponse* response)
 {
-	if (response->StatusCode != HTTP_STATUS_OK)
+	if (rdg->websocketKey && (response->StatusCode == HTTP_STATUS_SWITCH_PROTOCOLS))
+	{
+		if (!response->Upgrade || (_stricmp(response->Upgrade, "websocket") != 0) ||
+				!websocket_check_accept(rdg->websocketKey, response->SecWebSocketAccept))
+		{
+			WLog_ERR(TAG, "Invalid WebSocket upgrade response");
+			rdg->state = RDG_CLIENT_STATE_CLOSED;
+			return FALSE;
+		}
+
+		WLog_DBG(TAG, "Out Channel upgraded to WebSocket");
+		rdg->transferEncoding = RDG_TRANSFER_ENCODING_WEBSOCKET;
+	}
+	else if (response->StatusCode != HTTP_STATUS_OK)
 	{
 		rdg->state = RDG_CLIENT_STATE_CLOSED;
 		return FALSE;
@@ -749,6 +843,9 @@ BOOL rdg_check_event_handles(rdpRdg* rdg)
 		return rdg_out_channel_recv(rdg);
 	}
 
+	if (!rdg->tlsIn->bio)
+		return TRUE;
+
 	BIO_get_event(rdg->tlsIn->bio, &event);
 
 	if (WaitForSingleObject(event, 0) == WAIT_OBJECT_0)
@@ -1099,10 +1196,14 @@ BOOL rdg_connect(rdpRdg* rdg, const char* hostname, UINT16 port, int timeout)
 	if (!status)
 		return FALSE;
 
-	status = rdg_in_channel_connect(rdg, hostname, port, timeout);
+	/* an upgraded WebSocket connection carries both directions */
+	if (rdg->transferEncoding != RDG_TRANSFER_ENCODING_WEBSOCKET)
+	{
+		status = rdg_in_channel_connect(rdg, hostname, port, timeout);
 
-	if (!status)
-		return FALSE;
+		if (!status)
+			return FALSE;
+	}
 
 	status = rdg_tunnel_connect(rdg);
 
@@ -1114,37 +1215,44 @@ BOOL rdg_connect(rdpRdg* rdg, const char* hostname, UINT16 port, int timeout)
 
 int rdg_write_data_packet(rdpRdg* rdg, BYTE* buf, int size)
 {
-	int status;
-	wStream* sChunk;
-	int packetSize = size + 10;
-	char chunkSize[11];
+	wStream* s;
+	int offset;
+	int dataSize;
+	int packetCount;
+	UINT32 payloadLength;
 
 	if (size < 1)
 		return 0;
 
-	sprintf_s(chunkSize, sizeof(chunkSize), "%X\r\n", packetSize);
+	/**
+	 * Writes larger than a single data packet are split in several packets,
+	 * coalesced in one frame so that they still go out in a single write.
+	 */
 
-	sChunk = Stream_New(NULL, strlen(chunkSize) + packetSize + 2);
+	packetCount = (size + RDG_DATA_PACKET_MAX_SIZE - 1) / RDG_DATA_PACKET_MAX_SIZE;
+	payloadLength = size + (packetCount * 10);
 
-	if (!sChunk)
-		return -1;
+	s = rdg_frame_new(rdg, payloadLength);
 
-	Stream_Write(sChunk, chunkSize, strlen(chunkSize));
+	if (!s)
+		return -1;
 
-	Stream_Write_UINT16(sChunk, PKT_TYPE_DATA);   /* Type */
-	Stream_Write_UINT16(sChunk, 0);   /* Reserved */
-	Stream_Write_UINT32(sChunk, packetSize);   /* Packet length */
+	for (offset = 0; offset < size; offset += dataSize)
+	{
+		dataSize = size - offset;
 
-	Stream_Write_UINT16(sChunk, size);   /* Data size */
-	Stream_Write(sChunk, buf, size);   /* Data */
+		if (dataSize > RDG_DATA_PACKET_MAX_SIZE)
+			dataSize = RDG_DATA_PACKET_MAX_SIZE;
 
-	Stream_Write(sChunk, "\r\n", 2);
-	Stream_SealLength(sChunk);
+		Stream_Write_UINT16(s, PKT_TYPE_DATA);   /* Type */
+		Stream_Write_UINT16(s, 0);   /* Reserved */
+		Stream_Write_UINT32(s, dataSize + 10);   /* Packet length */
 
-	status = tls_write_all(rdg->tlsIn, Stream_Buffer(sChunk), Stream_Length(sChunk));
-	Stream_Free(sChunk, TRUE);
+		Stream_Write_UINT16(s, dataSize);   /* Data size */
+		Stream_Write(s, &buf[offset], dataSize);   /* Data */
+	}
 
-	if (status < 0)
+	if (!rdg_frame_send(rdg, s, payloadLength))
 		return -1;
 
 	return size;
@@ -1152,16 +1260,27 @@ int rdg_write_data_packet(rdpRdg* rdg, BYTE* buf, int size)
 
 BOOL rdg_process_close_packet(rdpRdg* rdg)
 {
-	BYTE buffer[sizeof(RdgPacketHeader) + 4];
-	RdgPacketHeader* header = (RdgPacketHeader*)buffer;
+	BOOL status;
+	wStream* s;
 
-	memset(buffer, 0, sizeof(buffer));
-	header->type = PKT_TYPE_CLOSE_CHANNEL_RESPONSE;
-	header->packetLength = sizeof(buffer);
+	s = Stream_New(NULL, 12);
+
+	if (!s)
+		return FALSE;
+
+	Stream_Write_UINT16(s, PKT_TYPE_CLOSE_CHANNEL_RESPONSE); /* Type (2 bytes) */
+	Stream_Write_UINT16(s, 0); /* Reserved (2 bytes) */
+	Stream_Write_UINT32(s, 12); /* PacketLength (4 bytes) */
+	Stream_Write_UINT32(s, 0); /* StatusCode (4 bytes) */
+	Stream_SealLength(s);
 
 	WLog_DBG(TAG, "Channel Close requested");
 	rdg->state = RDG_CLIENT_STATE_CLOSED;
-	return (rdg_write_data_packet(rdg, buffer, sizeof(buffer)) > 0 ? TRUE : FALSE);
+
+	status = rdg_write_packet(rdg, s);
+	Stream_Free(s, TRUE);
+
+	return status;
 }
 
 BOOL rdg_process_unknown_packet(rdpRdg* rdg, int type)
@@ -1188,7 +1307,7 @@ BOOL rdg_process_control_packet(rdpRdg* rdg, int type, int packetLength)
 
 		while (readCount < payloadSize)
 		{
-			status = BIO_read(rdg->tlsOut->bio, Stream_Pointer(s), sizeof(RdgPacketHeader) - readCount);
+			status = rdg_socket_read(rdg, Stream_Pointer(s), payloadSize - readCount);
 
 			if (status <= 0)
 			{
@@ -1208,6 +1327,7 @@ BOOL rdg_process_control_packet(rdpRdg* rdg, int type, int packetLength)
 	switch (type)
 	{
 	case PKT_TYPE_CLOSE_CHANNEL:
+		Stream_Free(s, TRUE);
 		return rdg_process_close_packet(rdg);
 		break;
 	default:
@@ -1232,7 +1352,7 @@ int rdg_read_data_packet(rdpRdg* rdg, BYTE* buffer, int size)
 	{
 		while (readCount < sizeof(RdgPacketHeader))
 		{
-			status = BIO_read(rdg->tlsOut->bio, (BYTE*)(&header) + readCount, sizeof(RdgPacketHeader) - readCount);
+			status = rdg_socket_read(rdg, (BYTE*)(&header) + readCount, sizeof(RdgPacketHeader) - readCount);
 
 			if (status <= 0)
 			{
@@ -1264,7 +1384,7 @@ int rdg_read_data_packet(rdpRdg* rdg, BYTE* buffer, int size)
 
 		while (readCount < 2)
 		{
-			status = BIO_read(rdg->tlsOut->bio, (BYTE*)(&rdg->packetRemainingCount) + readCount, 2 - readCount);
+			status = rdg_socket_read(rdg, (BYTE*)(&rdg->packetRemainingCount) + readCount, 2 - readCount);
 
 			if (status < 0)
 			{
@@ -1281,7 +1401,7 @@ int rdg_read_data_packet(rdpRdg* rdg, BYTE* buffer, int size)
 
 	readSize = (rdg->packetRemainingCount < size ? rdg->packetRemainingCount : size);
 
-	status = BIO_read(rdg->tlsOut->bio, buffer, readSize);
+	status = rdg_socket_read(rdg, buffer, readSize);
 
 	if (status < 0)
 	{
@@ -1382,7 +1502,9 @@ static long rdg_bio_ctrl(BIO* bio, int cmd, long arg1, void* arg2)
 	if (cmd == BIO_CTRL_FLUSH)
 	{
 		(void)BIO_flush(tlsOut->bio);
-		(void)BIO_flush(tlsIn->bio);
+
+		if (tlsIn->bio)
+			(void)BIO_flush(tlsIn->bio);
 		status = 1;
 	}
 	else if (cmd == BIO_C_GET_EVENT)
@@ -1521,6 +1643,20 @@ rdpRdg* rdg_new(rdpTransport* transport)
 
 		if (!rdg->readEvent)
 			goto rdg_alloc_error;
+
+		rdg->streamPool = StreamPool_New(TRUE, 4096);
+
+		if (!rdg->streamPool)
+			goto rdg_alloc_error;
+
+		if (rdg->settings->GatewayHttpUseWebsockets)
+		{
+			rdg->websocketKey = websocket_new_key();
+			rdg->websocket = websocket_new(TRUE);
+
+			if (!rdg->websocketKey || !rdg->websocket)
+				goto rdg_alloc_error;
+		}
 	}
 
 	return rdg;
@@ -1565,5 +1701,14 @@ void rdg_free(rdpRdg* rdg)
 		rdg->readEvent = NULL;
 	}
 
+	if (rdg->streamPool)
+	{
+		StreamPool_Free(rdg->streamPool);
+		rdg->streamPool = NULL;
+	}
+
+	websocket_free(rdg->websocket);
+	free(rdg->websocketKey);
+
 	free(rdg);
 }
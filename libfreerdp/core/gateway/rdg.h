@@ -38,6 +38,7 @@ typedef struct rdp_rdg rdpRdg;
 
 #include "http.h"
 #include "ntlm.h"
+#include "websocket.h"
 #include "../transport.h"
 
 /* HTTP channel response fields present flags. */
@@ -122,6 +123,12 @@ enum
 	RDG_CLIENT_STATE_NOT_FOUND,
 };
 
+enum
+{
+	RDG_TRANSFER_ENCODING_CHUNKED,
+	RDG_TRANSFER_ENCODING_WEBSOCKET
+};
+
 struct rdp_rdg
 {
 	rdpContext* context;
@@ -133,6 +140,11 @@ struct rdp_rdg
 	HttpContext* http;
 	HANDLE readEvent;
 
+	int transferEncoding;
+	char* websocketKey;
+	rdpWebSocket* websocket;
+	wStreamPool* streamPool;
+
 	UUID guid;
 
 	int state;
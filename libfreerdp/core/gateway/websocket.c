@@ -0,0 +1,390 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * WebSocket Framing (RFC 6455)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+
+#include <freerdp/log.h>
+#include <freerdp/crypto/crypto.h>
+
+#include <openssl/rand.h>
+
+#include "websocket.h"
+
+#define TAG FREERDP_TAG("core.gateway.websocket")
+
+int websocket_frame_header_length(UINT64 payloadLength, BOOL masked)
+{
+	int length = 2;
+
+	if (payloadLength > 0xFFFF)
+		length += 8;
+	else if (payloadLength > 125)
+		length += 2;
+
+	if (masked)
+		length += 4;
+
+	return length;
+}
+
+/**
+ * Writes a single final frame header. When masked, a random masking key
+ * is generated and written as the last four bytes of the header; callers
+ * mask the payload following it with websocket_mask_payload.
+ */
+
+BOOL websocket_write_frame_header(wStream* s, BYTE opcode, UINT64 payloadLength, BOOL masked)
+{
+	BYTE maskBit = masked ? WEBSOCKET_MASK_BIT : 0;
+	BYTE maskingKey[4];
+
+	if (!Stream_EnsureRemainingCapacity(s, websocket_frame_header_length(payloadLength, masked)))
+		return FALSE;
+
+	Stream_Write_UINT8(s, WEBSOCKET_FIN_BIT | opcode);
+
+	if (payloadLength > 0xFFFF)
+	{
+		Stream_Write_UINT8(s, maskBit | 127);
+		Stream_Write_UINT32_BE(s, (UINT32) (payloadLength >> 32));
+		Stream_Write_UINT32_BE(s, (UINT32) (payloadLength & 0xFFFFFFFF));
+	}
+	else if (payloadLength > 125)
+	{
+		Stream_Write_UINT8(s, maskBit | 126);
+		Stream_Write_UINT16_BE(s, (UINT16) payloadLength);
+	}
+	else
+	{
+		Stream_Write_UINT8(s, maskBit | (BYTE) payloadLength);
+	}
+
+	if (masked)
+	{
+		RAND_bytes(maskingKey, sizeof(maskingKey));
+		Stream_Write(s, maskingKey, sizeof(maskingKey));
+	}
+
+	return TRUE;
+}
+
+void websocket_mask_payload(BYTE* data, UINT64 length, const BYTE* maskingKey, UINT64 offset)
+{
+	UINT64 index;
+
+	for (index = 0; index < length; index++)
+		data[index] ^= maskingKey[(offset + index) & 3];
+}
+
+/**
+ * Sec-WebSocket-Key / Sec-WebSocket-Accept handshake values
+ */
+
+char* websocket_new_key(void)
+{
+	BYTE nonce[16];
+
+	RAND_bytes(nonce, sizeof(nonce));
+
+	return crypto_base64_encode(nonce, sizeof(nonce));
+}
+
+BOOL websocket_check_accept(const char* key, const char* accept)
+{
+	BOOL status;
+	char* expected;
+	CryptoSha1 sha1;
+	BYTE digest[CRYPTO_SHA1_DIGEST_LENGTH];
+
+	if (!key || !accept)
+		return FALSE;
+
+	sha1 = crypto_sha1_init();
+
+	if (!sha1)
+		return FALSE;
+
+	crypto_sha1_update(sha1, (const BYTE*) key, strlen(key));
+	crypto_sha1_update(sha1, (const BYTE*) WEBSOCKET_ACCEPT_GUID, strlen(WEBSOCKET_ACCEPT_GUID));
+	crypto_sha1_final(sha1, digest);
+
+	expected = crypto_base64_encode(digest, sizeof(digest));
+
+	if (!expected)
+		return FALSE;
+
+	status = (strcmp(expected, accept) == 0) ? TRUE : FALSE;
+	free(expected);
+
+	return status;
+}
+
+static BOOL websocket_write_all(BIO* bio, const BYTE* data, int length)
+{
+	int status;
+	int offset = 0;
+
+	while (offset < length)
+	{
+		status = BIO_write(bio, &data[offset], length - offset);
+
+		if (status > 0)
+		{
+			offset += status;
+			continue;
+		}
+
+		if (!BIO_should_retry(bio))
+			return FALSE;
+
+		USleep(100);
+	}
+
+	return TRUE;
+}
+
+BOOL websocket_write_control(rdpWebSocket* websocket, BIO* bio, BYTE opcode, const BYTE* data, int length)
+{
+	int headerLength;
+	wStream* s;
+	BYTE buffer[WEBSOCKET_MAX_HEADER_LENGTH + WEBSOCKET_MAX_CONTROL_LENGTH];
+
+	if ((length < 0) || (length > WEBSOCKET_MAX_CONTROL_LENGTH))
+		return FALSE;
+
+	s = Stream_New(buffer, sizeof(buffer));
+
+	if (!s)
+		return FALSE;
+
+	headerLength = websocket_frame_header_length(length, websocket->masking);
+	websocket_write_frame_header(s, opcode, length, websocket->masking);
+	Stream_Write(s, data, length);
+
+	if (websocket->masking)
+		websocket_mask_payload(&buffer[headerLength], length, &buffer[headerLength - 4], 0);
+
+	length = Stream_GetPosition(s);
+	Stream_Free(s, FALSE);
+
+	return websocket_write_all(bio, buffer, length);
+}
+
+static int websocket_header_length(rdpWebSocket* websocket)
+{
+	BYTE lengthCode;
+
+	if (websocket->headerLength < 2)
+		return 2;
+
+	lengthCode = websocket->header[1] & 0x7F;
+
+	return 2 + ((lengthCode == 127) ? 8 : (lengthCode == 126) ? 2 : 0) +
+			((websocket->header[1] & WEBSOCKET_MASK_BIT) ? 4 : 0);
+}
+
+static BOOL websocket_parse_header(rdpWebSocket* websocket)
+{
+	int offset = 2;
+	BYTE lengthCode;
+	BYTE* header = websocket->header;
+
+	websocket->opcode = header[0] & 0x0F;
+	websocket->masked = (header[1] & WEBSOCKET_MASK_BIT) ? TRUE : FALSE;
+	lengthCode = header[1] & 0x7F;
+
+	if (lengthCode == 127)
+	{
+		websocket->payloadLength = 0;
+
+		for (; offset < 10; offset++)
+			websocket->payloadLength = (websocket->payloadLength << 8) | header[offset];
+	}
+	else if (lengthCode == 126)
+	{
+		websocket->payloadLength = (header[2] << 8) | header[3];
+		offset = 4;
+	}
+	else
+	{
+		websocket->payloadLength = lengthCode;
+	}
+
+	if (websocket->masked)
+		CopyMemory(websocket->maskingKey, &header[offset], 4);
+
+	websocket->payloadOffset = 0;
+
+	if (websocket->opcode & 0x08)
+	{
+		/* control frames must not be fragmented and carry at most 125 bytes */
+		if (!(header[0] & WEBSOCKET_FIN_BIT) || (websocket->payloadLength > WEBSOCKET_MAX_CONTROL_LENGTH))
+		{
+			WLog_ERR(TAG, "invalid control frame (opcode 0x%X)", websocket->opcode);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static BOOL websocket_process_control(rdpWebSocket* websocket, BIO* bio)
+{
+	int length = (int) websocket->payloadLength;
+
+	switch (websocket->opcode)
+	{
+		case WEBSOCKET_OPCODE_PING:
+			return websocket_write_control(websocket, bio, WEBSOCKET_OPCODE_PONG, websocket->control, length);
+
+		case WEBSOCKET_OPCODE_CLOSE:
+			WLog_DBG(TAG, "close frame received");
+			websocket->state = WEBSOCKET_STATE_CLOSED;
+			websocket_write_control(websocket, bio, WEBSOCKET_OPCODE_CLOSE, websocket->control, (length >= 2) ? 2 : 0);
+			return FALSE;
+
+		case WEBSOCKET_OPCODE_PONG:
+			return TRUE;
+
+		default:
+			WLog_ERR(TAG, "unknown control frame opcode 0x%X", websocket->opcode);
+			return FALSE;
+	}
+}
+
+/**
+ * Reads frame payload data from the bio, presenting the binary frames as a
+ * plain byte stream. Control frames are consumed transparently. The return
+ * value follows BIO_read semantics, retry flags being those of the bio.
+ */
+
+int websocket_read(rdpWebSocket* websocket, BIO* bio, BYTE* buffer, int size)
+{
+	int status;
+	int readSize;
+
+	while (TRUE)
+	{
+		if (websocket->state == WEBSOCKET_STATE_CLOSED)
+		{
+			BIO_clear_retry_flags(bio);
+			return -1;
+		}
+
+		if (websocket->state == WEBSOCKET_STATE_HEADER)
+		{
+			status = BIO_read(bio, &websocket->header[websocket->headerLength],
+					websocket_header_length(websocket) - websocket->headerLength);
+
+			if (status <= 0)
+				return status;
+
+			websocket->headerLength += status;
+
+			if (websocket->headerLength < websocket_header_length(websocket))
+				continue;
+
+			if (!websocket_parse_header(websocket))
+			{
+				websocket->state = WEBSOCKET_STATE_CLOSED;
+				continue;
+			}
+
+			websocket->headerLength = 0;
+			websocket->state = WEBSOCKET_STATE_PAYLOAD;
+		}
+
+		if (websocket->opcode & 0x08)
+		{
+			readSize = (int) (websocket->payloadLength - websocket->payloadOffset);
+
+			if (readSize > 0)
+			{
+				status = BIO_read(bio, &websocket->control[websocket->payloadOffset], readSize);
+
+				if (status <= 0)
+					return status;
+
+				websocket->payloadOffset += status;
+
+				if (websocket->payloadOffset < websocket->payloadLength)
+					continue;
+			}
+
+			if (websocket->masked)
+				websocket_mask_payload(websocket->control, websocket->payloadLength, websocket->maskingKey, 0);
+
+			websocket->state = WEBSOCKET_STATE_HEADER;
+
+			if (!websocket_process_control(websocket, bio))
+				websocket->state = WEBSOCKET_STATE_CLOSED;
+
+			continue;
+		}
+
+		if (websocket->payloadOffset >= websocket->payloadLength)
+		{
+			websocket->state = WEBSOCKET_STATE_HEADER;
+			continue;
+		}
+
+		readSize = size;
+
+		if ((UINT64) readSize > (websocket->payloadLength - websocket->payloadOffset))
+			readSize = (int) (websocket->payloadLength - websocket->payloadOffset);
+
+		status = BIO_read(bio, buffer, readSize);
+
+		if (status <= 0)
+			return status;
+
+		if (websocket->masked)
+			websocket_mask_payload(buffer, status, websocket->maskingKey, websocket->payloadOffset);
+
+		websocket->payloadOffset += status;
+
+		if (websocket->payloadOffset >= websocket->payloadLength)
+			websocket->state = WEBSOCKET_STATE_HEADER;
+
+		return status;
+	}
+}
+
+rdpWebSocket* websocket_new(BOOL masking)
+{
+	rdpWebSocket* websocket;
+
+	websocket = (rdpWebSocket*) calloc(1, sizeof(rdpWebSocket));
+
+	if (websocket)
+	{
+		websocket->state = WEBSOCKET_STATE_HEADER;
+		websocket->masking = masking;
+	}
+
+	return websocket;
+}
+
+void websocket_free(rdpWebSocket* websocket)
+{
+	free(websocket);
+}
@@ -0,0 +1,81 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * WebSocket Framing (RFC 6455)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_CORE_WEBSOCKET_H
+#define FREERDP_CORE_WEBSOCKET_H
+
+#include <winpr/wtypes.h>
+#include <winpr/stream.h>
+
+#include <openssl/bio.h>
+
+typedef struct rdp_websocket rdpWebSocket;
+
+#define WEBSOCKET_OPCODE_CONTINUATION		0x0
+#define WEBSOCKET_OPCODE_TEXT			0x1
+#define WEBSOCKET_OPCODE_BINARY			0x2
+#define WEBSOCKET_OPCODE_CLOSE			0x8
+#define WEBSOCKET_OPCODE_PING			0x9
+#define WEBSOCKET_OPCODE_PONG			0xA
+
+#define WEBSOCKET_FIN_BIT			0x80
+#define WEBSOCKET_MASK_BIT			0x80
+
+#define WEBSOCKET_MAX_HEADER_LENGTH		14
+#define WEBSOCKET_MAX_CONTROL_LENGTH		125
+
+#define WEBSOCKET_KEY_LENGTH			24
+#define WEBSOCKET_ACCEPT_GUID			"258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+enum
+{
+	WEBSOCKET_STATE_HEADER,
+	WEBSOCKET_STATE_PAYLOAD,
+	WEBSOCKET_STATE_CLOSED
+};
+
+struct rdp_websocket
+{
+	int state;
+	BOOL masking;
+
+	BYTE header[WEBSOCKET_MAX_HEADER_LENGTH];
+	int headerLength;
+
+	BYTE opcode;
+	BOOL masked;
+	BYTE maskingKey[4];
+	UINT64 payloadLength;
+	UINT64 payloadOffset;
+
+	BYTE control[WEBSOCKET_MAX_CONTROL_LENGTH];
+};
+
+int websocket_frame_header_length(UINT64 payloadLength, BOOL masked);
+BOOL websocket_write_frame_header(wStream* s, BYTE opcode, UINT64 payloadLength, BOOL masked);
+void websocket_mask_payload(BYTE* data, UINT64 length, const BYTE* maskingKey, UINT64 offset);
+
+char* websocket_new_key(void);
+BOOL websocket_check_accept(const char* key, const char* accept);
+
+int websocket_read(rdpWebSocket* websocket, BIO* bio, BYTE* buffer, int size);
+BOOL websocket_write_control(rdpWebSocket* websocket, BIO* bio, BYTE opcode, const BYTE* data, int length);
+
+rdpWebSocket* websocket_new(BOOL masking);
+void websocket_free(rdpWebSocket* websocket);
+
+#endif /* FREERDP_CORE_WEBSOCKET_H */
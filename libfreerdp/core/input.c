@@ -333,6 +333,266 @@ BOOL input_send_fastpath_keyboard_pause_event(rdpInput* input)
 	return fastpath_send_multiple_input_pdu(rdp->fastpath, s, 4);
 }
 
+/**
+ * Fast-path input batching
+ *
+ * Pointer motion is coalesced: only the latest position is kept and it is
+ * sent at most once per batching interval. Any other event flushes the
+ * pending motion together with the event in a single fast-path input PDU,
+ * so motion is never reordered across button or key transitions.
+ */
+
+static void input_batch_write_move(rdpInput* input, wStream* s, int* count)
+{
+	rdpInputBatch* batch = input->batch;
+
+	if (!batch->pendingMove)
+		return;
+
+	Stream_Write_UINT8(s, FASTPATH_INPUT_EVENT_MOUSE << 5); /* eventHeader (1 byte) */
+	input_write_mouse_event(s, PTR_FLAGS_MOVE, batch->moveX, batch->moveY);
+	batch->pendingMove = FALSE;
+	(*count)++;
+}
+
+static BOOL input_batch_flush(rdpInput* input)
+{
+	wStream* s;
+	int count = 0;
+	rdpRdp* rdp = input->context->rdp;
+
+	if (!input->batch->pendingMove)
+		return TRUE;
+
+	s = fastpath_input_pdu_init_header(rdp->fastpath);
+	if (!s)
+		return FALSE;
+	input_batch_write_move(input, s, &count);
+	return fastpath_send_multiple_input_pdu(rdp->fastpath, s, count);
+}
+
+static BOOL input_batch_send_event(rdpInput* input, BYTE eventFlags, BYTE eventCode,
+		UINT16 flags, UINT16 code, UINT16 x, UINT16 y)
+{
+	BOOL status;
+	wStream* s;
+	int count = 0;
+	rdpInputBatch* batch = input->batch;
+	rdpRdp* rdp = input->context->rdp;
+
+	EnterCriticalSection(&batch->lock);
+
+	s = fastpath_input_pdu_init_header(rdp->fastpath);
+	if (!s)
+	{
+		LeaveCriticalSection(&batch->lock);
+		return FALSE;
+	}
+
+	input_batch_write_move(input, s, &count);
+
+	Stream_Write_UINT8(s, eventFlags | (eventCode << 5)); /* eventHeader (1 byte) */
+
+	switch (eventCode)
+	{
+		case FASTPATH_INPUT_EVENT_SCANCODE:
+			Stream_Write_UINT8(s, code); /* keyCode (1 byte) */
+			break;
+
+		case FASTPATH_INPUT_EVENT_UNICODE:
+			Stream_Write_UINT16(s, code); /* unicodeCode (2 bytes) */
+			break;
+
+		case FASTPATH_INPUT_EVENT_MOUSE:
+			input_write_mouse_event(s, flags, x, y);
+			break;
+
+		case FASTPATH_INPUT_EVENT_MOUSEX:
+			input_write_extended_mouse_event(s, flags, x, y);
+			break;
+	}
+
+	count++;
+	status = fastpath_send_multiple_input_pdu(rdp->fastpath, s, count);
+
+	LeaveCriticalSection(&batch->lock);
+
+	return status;
+}
+
+static BOOL input_batch_synchronize_event(rdpInput* input, UINT32 flags)
+{
+	/* The FastPath Synchronization eventFlags has identical values as SlowPath */
+	return input_batch_send_event(input, (BYTE) flags, FASTPATH_INPUT_EVENT_SYNC, 0, 0, 0, 0);
+}
+
+static BOOL input_batch_keyboard_event(rdpInput* input, UINT16 flags, UINT16 code)
+{
+	BYTE eventFlags = 0;
+
+	eventFlags |= (flags & KBD_FLAGS_RELEASE) ? FASTPATH_INPUT_KBDFLAGS_RELEASE : 0;
+	eventFlags |= (flags & KBD_FLAGS_EXTENDED) ? FASTPATH_INPUT_KBDFLAGS_EXTENDED : 0;
+	return input_batch_send_event(input, eventFlags, FASTPATH_INPUT_EVENT_SCANCODE, 0, code, 0, 0);
+}
+
+static BOOL input_batch_unicode_keyboard_event(rdpInput* input, UINT16 flags, UINT16 code)
+{
+	BYTE eventFlags = 0;
+
+	eventFlags |= (flags & KBD_FLAGS_RELEASE) ? FASTPATH_INPUT_KBDFLAGS_RELEASE : 0;
+	return input_batch_send_event(input, eventFlags, FASTPATH_INPUT_EVENT_UNICODE, 0, code, 0, 0);
+}
+
+static void input_batch_arm_timer(rdpInputBatch* batch, UINT32 milliseconds)
+{
+	LARGE_INTEGER due;
+
+	if (!batch->timer)
+		return;
+
+	due.QuadPart = -((LONGLONG) milliseconds * 10000LL);
+	SetWaitableTimer(batch->timer, &due, 0, NULL, NULL, FALSE);
+}
+
+static BOOL input_batch_mouse_event(rdpInput* input, UINT16 flags, UINT16 x, UINT16 y)
+{
+	UINT32 now;
+	BOOL status = TRUE;
+	rdpInputBatch* batch = input->batch;
+
+	if (flags != PTR_FLAGS_MOVE)
+		return input_batch_send_event(input, 0, FASTPATH_INPUT_EVENT_MOUSE, flags, 0, x, y);
+
+	EnterCriticalSection(&batch->lock);
+
+	now = GetTickCount();
+	batch->moveX = x;
+	batch->moveY = y;
+
+	if (!batch->pendingMove)
+	{
+		batch->pendingMove = TRUE;
+		batch->moveTime = now;
+
+		if (batch->interval > 0)
+			input_batch_arm_timer(batch, batch->interval);
+	}
+
+	if ((now - batch->moveTime) >= batch->interval)
+		status = input_batch_flush(input);
+
+	LeaveCriticalSection(&batch->lock);
+
+	return status;
+}
+
+static BOOL input_batch_extended_mouse_event(rdpInput* input, UINT16 flags, UINT16 x, UINT16 y)
+{
+	return input_batch_send_event(input, 0, FASTPATH_INPUT_EVENT_MOUSEX, flags, 0, x, y);
+}
+
+static BOOL input_batch_focus_in_event(rdpInput* input, UINT16 toggleStates)
+{
+	BOOL status;
+	rdpInputBatch* batch = input->batch;
+
+	EnterCriticalSection(&batch->lock);
+	status = input_batch_flush(input) && input_send_fastpath_focus_in_event(input, toggleStates);
+	LeaveCriticalSection(&batch->lock);
+
+	return status;
+}
+
+static BOOL input_batch_keyboard_pause_event(rdpInput* input)
+{
+	BOOL status;
+	rdpInputBatch* batch = input->batch;
+
+	EnterCriticalSection(&batch->lock);
+	status = input_batch_flush(input) && input_send_fastpath_keyboard_pause_event(input);
+	LeaveCriticalSection(&batch->lock);
+
+	return status;
+}
+
+/**
+ * Sends the pending pointer motion once the batching interval has elapsed.
+ * Called from the client event loop; the batching timer returned by
+ * input_get_batch_event_handle wakes the loop up when motion is pending.
+ */
+
+BOOL input_check_batch(rdpInput* input)
+{
+	UINT32 elapsed;
+	BOOL status = TRUE;
+	rdpInputBatch* batch = input->batch;
+
+	if (!batch)
+		return TRUE;
+
+	EnterCriticalSection(&batch->lock);
+
+	if (batch->pendingMove)
+	{
+		elapsed = GetTickCount() - batch->moveTime;
+
+		/**
+		 * The timer does not run on the GetTickCount clock and may fire slightly
+		 * early, in which case it is armed again for the time that is left.
+		 */
+		if (elapsed >= batch->interval)
+			status = input_batch_flush(input);
+		else
+			input_batch_arm_timer(batch, batch->interval - elapsed);
+	}
+
+	LeaveCriticalSection(&batch->lock);
+
+	return status;
+}
+
+HANDLE input_get_batch_event_handle(rdpInput* input)
+{
+	if (!input->batch)
+		return NULL;
+
+	return input->batch->timer;
+}
+
+static rdpInputBatch* input_batch_new(rdpSettings* settings)
+{
+	rdpInputBatch* batch;
+
+	batch = (rdpInputBatch*) calloc(1, sizeof(rdpInputBatch));
+
+	if (!batch)
+		return NULL;
+
+	if (!InitializeCriticalSectionAndSpinCount(&batch->lock, 4000))
+	{
+		free(batch);
+		return NULL;
+	}
+
+	batch->interval = settings->InputBatchingInterval;
+	batch->timer = CreateWaitableTimerA(NULL, FALSE, NULL);
+
+	return batch;
+}
+
+static void input_batch_free(rdpInputBatch* batch)
+{
+	if (!batch)
+		return;
+
+	if (batch->timer)
+		CloseHandle(batch->timer);
+
+	DeleteCriticalSection(&batch->lock);
+
+	free(batch);
+}
+
 static BOOL input_recv_sync_event(rdpInput* input, wStream* s)
 {
 	UINT32 toggleFlags;
@@ -502,7 +762,23 @@ void input_register_client_callbacks(rdpInput* input)
 {
 	rdpSettings* settings = input->context->settings;
 
-	if (settings->FastPathInput)
+	if (settings->FastPathInput && settings->InputBatching)
+	{
+		if (!input->batch)
+			input->batch = input_batch_new(settings);
+	}
+
+	if (input->batch)
+	{
+		input->SynchronizeEvent = input_batch_synchronize_event;
+		input->KeyboardEvent = input_batch_keyboard_event;
+		input->KeyboardPauseEvent = input_batch_keyboard_pause_event;
+		input->UnicodeKeyboardEvent = input_batch_unicode_keyboard_event;
+		input->MouseEvent = input_batch_mouse_event;
+		input->ExtendedMouseEvent = input_batch_extended_mouse_event;
+		input->FocusInEvent = input_batch_focus_in_event;
+	}
+	else if (settings->FastPathInput)
 	{
 		input->SynchronizeEvent = input_send_fastpath_synchronize_event;
 		input->KeyboardEvent = input_send_fastpath_keyboard_event;
@@ -613,6 +889,8 @@ void input_free(rdpInput* input)
 
 		MessageQueue_Free(input->queue);
 
+		input_batch_free(input->batch);
+
 		free(input);
 	}
 }
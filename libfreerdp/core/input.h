@@ -38,6 +38,18 @@
 
 #define RDP_CLIENT_INPUT_PDU_HEADER_LENGTH	4
 
+struct rdp_input_batch
+{
+	CRITICAL_SECTION lock;
+	HANDLE timer;
+	UINT32 interval;
+
+	BOOL pendingMove;
+	UINT16 moveX;
+	UINT16 moveY;
+	UINT32 moveTime;
+};
+
 BOOL input_send_synchronize_event(rdpInput* input, UINT32 flags);
 BOOL input_send_keyboard_event(rdpInput* input, UINT16 flags, UINT16 code);
 BOOL input_send_unicode_keyboard_event(rdpInput* input, UINT16 flags, UINT16 code);
@@ -53,6 +65,8 @@ BOOL input_send_fastpath_extended_mouse_event(rdpInput* input, UINT16 flags, UIN
 BOOL input_recv(rdpInput* input, wStream* s);
 
 int input_process_events(rdpInput* input);
+BOOL input_check_batch(rdpInput* input);
+HANDLE input_get_batch_event_handle(rdpInput* input);
 void input_register_client_callbacks(rdpInput* input);
 
 rdpInput* input_new(rdpRdp* rdp);
@@ -1021,6 +1021,45 @@ BOOL mcs_send_channel_join_request(rdpMcs* mcs, UINT16 channelId)
 	return (status < 0) ? FALSE : TRUE;
 }
 
+/**
+ * Send several MCS Channel Join Requests in a single transport write,
+ * without waiting for the corresponding confirms.
+ * @param mcs mcs module
+ * @param channelIds channel ids to join
+ * @param count number of channel ids
+ */
+
+BOOL mcs_send_channel_join_requests(rdpMcs* mcs, const UINT16* channelIds, UINT32 count)
+{
+	wStream* s;
+	int status;
+	UINT32 index;
+	UINT16 length = 12;
+
+	s = Stream_New(NULL, length * count);
+	if (!s)
+	{
+		WLog_ERR(TAG, "Stream_New failed!");
+		return FALSE;
+	}
+
+	for (index = 0; index < count; index++)
+	{
+		mcs_write_domain_mcspdu_header(s, DomainMCSPDU_ChannelJoinRequest, length, 0);
+
+		per_write_integer16(s, mcs->userId, MCS_BASE_CHANNEL_ID);
+		per_write_integer16(s, channelIds[index], 0);
+	}
+
+	Stream_SealLength(s);
+
+	status = transport_write(mcs->transport, s);
+
+	Stream_Free(s, TRUE);
+
+	return (status < 0) ? FALSE : TRUE;
+}
+
 /**
  * Read MCS Channel Join Confirm.\n
  * @msdn{cc240527}
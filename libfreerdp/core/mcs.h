@@ -181,6 +181,7 @@ BOOL mcs_recv_attach_user_confirm(rdpMcs* mcs, wStream* s);
 BOOL mcs_send_attach_user_confirm(rdpMcs* mcs);
 BOOL mcs_recv_channel_join_request(rdpMcs* mcs, wStream* s, UINT16* channelId);
 BOOL mcs_send_channel_join_request(rdpMcs* mcs, UINT16 channelId);
+BOOL mcs_send_channel_join_requests(rdpMcs* mcs, const UINT16* channelIds, UINT32 count);
 BOOL mcs_recv_channel_join_confirm(rdpMcs* mcs, wStream* s, UINT16* channelId);
 BOOL mcs_send_channel_join_confirm(rdpMcs* mcs, UINT16 channelId);
 BOOL mcs_recv_disconnect_provider_ultimatum(rdpMcs* mcs, wStream* s, int* reason);
@@ -189,6 +190,7 @@ BOOL mcs_read_domain_mcspdu_header(wStream* s, enum DomainMCSPDU* domainMCSPDU,
 void mcs_write_domain_mcspdu_header(wStream* s, enum DomainMCSPDU domainMCSPDU, UINT16 length, BYTE options);
 
 BOOL mcs_client_begin(rdpMcs* mcs);
+int mcs_initialize_client_channels(rdpMcs* mcs, rdpSettings* settings);
 
 rdpMcs* mcs_new(rdpTransport* transport);
 void mcs_free(rdpMcs* mcs);
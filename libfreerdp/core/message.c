@@ -31,24 +31,405 @@
 #include <freerdp/freerdp.h>
 
 #include <winpr/crt.h>
+#include <winpr/thread.h>
 #include <winpr/stream.h>
+#include <winpr/interlocked.h>
 #include <winpr/collections.h>
 
 #define TAG FREERDP_TAG("core.message")
 #define WITH_STREAM_POOL	1
 
+/**
+ * Frame Arena
+ *
+ * Messages posted between BeginPaint and EndPaint are copied into a bump arena
+ * owned by the frame and queued as a single Update_Frame message once the frame
+ * ends. The proxy thread then processes them in order and releases the whole
+ * arena at once, instead of freeing each copy individually.
+ */
+
+#define UPDATE_FRAME_BLOCK_SIZE		(64 * 1024)
+#define UPDATE_FRAME_ALIGNMENT		16
+#define UPDATE_FRAME_ALIGN(_size) \
+	(((_size) + (UPDATE_FRAME_ALIGNMENT - 1)) & ~((size_t) (UPDATE_FRAME_ALIGNMENT - 1)))
+
+typedef struct _UPDATE_FRAME_BLOCK UPDATE_FRAME_BLOCK;
+
+struct _UPDATE_FRAME_BLOCK
+{
+	UPDATE_FRAME_BLOCK* next;
+	size_t size;
+	size_t offset;
+};
+
+#define UPDATE_FRAME_BLOCK_HEADER	UPDATE_FRAME_ALIGN(sizeof(UPDATE_FRAME_BLOCK))
+
+struct _UPDATE_FRAME_MESSAGE
+{
+	wMessage message;
+	BOOL heap;
+};
+typedef struct _UPDATE_FRAME_MESSAGE UPDATE_FRAME_MESSAGE;
+
+struct rdp_update_frame
+{
+	UPDATE_FRAME_BLOCK* head;
+	UPDATE_FRAME_BLOCK* block;
+
+	int count;
+	int size;
+	UPDATE_FRAME_MESSAGE* messages;
+
+	int streamCount;
+	int streamSize;
+	wStream** streams;
+};
+
+static int update_message_free_class(wMessage* msg, int msgClass, int msgType);
+
+static UPDATE_FRAME_BLOCK* update_frame_block_new(size_t size)
+{
+	UPDATE_FRAME_BLOCK* block;
+
+	block = (UPDATE_FRAME_BLOCK*) malloc(UPDATE_FRAME_BLOCK_HEADER + size);
+
+	if (!block)
+		return NULL;
+
+	block->next = NULL;
+	block->size = size;
+	block->offset = 0;
+
+	return block;
+}
+
+static rdpUpdateFrame* update_frame_new(void)
+{
+	rdpUpdateFrame* frame;
+
+	frame = (rdpUpdateFrame*) calloc(1, sizeof(rdpUpdateFrame));
+
+	if (!frame)
+		return NULL;
+
+	frame->head = update_frame_block_new(UPDATE_FRAME_BLOCK_SIZE);
+
+	if (!frame->head)
+	{
+		free(frame);
+		return NULL;
+	}
+
+	frame->block = frame->head;
+
+	return frame;
+}
+
+static void update_frame_free(rdpUpdateFrame* frame)
+{
+	UPDATE_FRAME_BLOCK* block;
+
+	if (!frame)
+		return;
+
+	while (frame->head)
+	{
+		block = frame->head;
+		frame->head = block->next;
+		free(block);
+	}
+
+	free(frame->messages);
+	free(frame->streams);
+	free(frame);
+}
+
+static void* update_frame_alloc(rdpUpdateFrame* frame, size_t size)
+{
+	BYTE* ptr;
+	UPDATE_FRAME_BLOCK* next;
+	UPDATE_FRAME_BLOCK* block = frame->block;
+
+	size = UPDATE_FRAME_ALIGN(size ? size : 1);
+
+	while ((block->offset + size) > block->size)
+	{
+		/* blocks following the current one are empty, reuse them when large enough */
+
+		if (!block->next || (block->next->size < size))
+		{
+			next = update_frame_block_new((size > UPDATE_FRAME_BLOCK_SIZE) ? size : UPDATE_FRAME_BLOCK_SIZE);
+
+			if (!next)
+				return NULL;
+
+			next->next = block->next;
+			block->next = next;
+		}
+
+		block = block->next;
+	}
+
+	frame->block = block;
+	ptr = ((BYTE*) block) + UPDATE_FRAME_BLOCK_HEADER + block->offset;
+	block->offset += size;
+
+	return ptr;
+}
+
+/**
+ * Releases what the frame holds outside of its arena: messages which were
+ * allocated on the heap and the receive streams referenced by its messages.
+ * The arena blocks are kept for the next frame, except for oversized ones.
+ */
+
+static void update_frame_reset(rdpUpdateFrame* frame)
+{
+	int index;
+	wMessage* msg;
+	UPDATE_FRAME_BLOCK* block;
+	UPDATE_FRAME_BLOCK** link;
+
+	for (index = 0; index < frame->count; index++)
+	{
+		if (!frame->messages[index].heap)
+			continue;
+
+		msg = &frame->messages[index].message;
+		update_message_free_class(msg, GetMessageClass(msg->id), GetMessageType(msg->id));
+	}
+
+	for (index = 0; index < frame->streamCount; index++)
+		Stream_Release(frame->streams[index]);
+
+	frame->count = 0;
+	frame->streamCount = 0;
+
+	frame->head->offset = 0;
+	link = &(frame->head->next);
+
+	while ((block = *link))
+	{
+		if (block->size > UPDATE_FRAME_BLOCK_SIZE)
+		{
+			*link = block->next;
+			free(block);
+			continue;
+		}
+
+		block->offset = 0;
+		link = &(block->next);
+	}
+
+	frame->block = frame->head;
+}
+
+static rdpUpdateFrame* update_message_frame_take(rdpUpdateProxy* proxy)
+{
+	rdpUpdateFrame* frame = proxy->spareFrame;
+
+	if (frame && (InterlockedCompareExchangePointer((PVOID*) &proxy->spareFrame, NULL, frame) == frame))
+		return frame;
+
+	return update_frame_new();
+}
+
+static void update_message_frame_release(rdpUpdateProxy* proxy, rdpUpdateFrame* frame)
+{
+	update_frame_reset(frame);
+
+	if (!proxy || InterlockedCompareExchangePointer((PVOID*) &proxy->spareFrame, frame, NULL))
+		update_frame_free(frame);
+}
+
+/**
+ * Returns the frame being recorded by the calling thread, if any. Only the
+ * thread which called BeginPaint appends to the frame, updates sent from other
+ * threads (RefreshRect, SuppressOutput) are posted directly.
+ */
+
+static rdpUpdateFrame* update_message_current_frame(rdpContext* context)
+{
+	rdpUpdateProxy* proxy = context->update->proxy;
+
+	if (!proxy || (proxy->frameThreadId != GetCurrentThreadId()))
+		return NULL;
+
+	return proxy->frame;
+}
+
+static void* update_message_alloc(rdpContext* context, size_t size)
+{
+	rdpUpdateFrame* frame = update_message_current_frame(context);
+
+	if (frame)
+		return update_frame_alloc(frame, size);
+
+	return malloc(size);
+}
+
+static void update_message_discard(rdpContext* context, void* ptr)
+{
+	if (!update_message_current_frame(context))
+		free(ptr);
+}
+
+static BOOL update_message_add_ref(rdpContext* context, BYTE* ptr)
+{
+	wStream* s;
+	wStream** streams;
+	rdpUpdateFrame* frame;
+	wStreamPool* pool = context->rdp->transport->ReceivePool;
+
+	frame = update_message_current_frame(context);
+
+	if (!frame)
+	{
+		StreamPool_AddRef(pool, ptr);
+		return TRUE;
+	}
+
+	/* rectangles of a same PDU share its receive stream, reference it once */
+
+	if (frame->streamCount > 0)
+	{
+		s = frame->streams[frame->streamCount - 1];
+
+		if ((ptr >= Stream_Buffer(s)) && (ptr < (Stream_Buffer(s) + Stream_Capacity(s))))
+			return TRUE;
+	}
+
+	s = StreamPool_Find(pool, ptr);
+
+	if (!s)
+		return TRUE;
+
+	if (frame->streamCount >= frame->streamSize)
+	{
+		int size = frame->streamSize ? (frame->streamSize * 2) : 16;
+
+		streams = (wStream**) realloc(frame->streams, sizeof(wStream*) * size);
+
+		if (!streams)
+			return FALSE;
+
+		frame->streams = streams;
+		frame->streamSize = size;
+	}
+
+	Stream_AddRef(s);
+	frame->streams[frame->streamCount++] = s;
+
+	return TRUE;
+}
+
+static void update_message_release_ref(rdpContext* context, BYTE* ptr)
+{
+	/* references taken for a frame are released along with the frame */
+	if (!update_message_current_frame(context))
+		StreamPool_Release(context->rdp->transport->ReceivePool, ptr);
+}
+
+static BOOL update_message_post_ex(rdpContext* context, UINT32 id, void* wParam, void* lParam, BOOL heap)
+{
+	wMessage* msg;
+	rdpUpdateFrame* frame;
+	UPDATE_FRAME_MESSAGE* messages;
+
+	frame = update_message_current_frame(context);
+
+	if (!frame)
+		return MessageQueue_Post(context->update->queue, (void*) context, id, wParam, lParam);
+
+	if (frame->count >= frame->size)
+	{
+		int size = frame->size ? (frame->size * 2) : 64;
+
+		messages = (UPDATE_FRAME_MESSAGE*) realloc(frame->messages, sizeof(UPDATE_FRAME_MESSAGE) * size);
+
+		if (!messages)
+		{
+			if (heap)
+			{
+				wMessage discarded = { id, (void*) context, wParam, lParam };
+				update_message_free_class(&discarded, GetMessageClass(id), GetMessageType(id));
+			}
+
+			return FALSE;
+		}
+
+		frame->messages = messages;
+		frame->size = size;
+	}
+
+	msg = &(frame->messages[frame->count].message);
+	ZeroMemory(msg, sizeof(wMessage));
+	msg->id = id;
+	msg->context = (void*) context;
+	msg->wParam = wParam;
+	msg->lParam = lParam;
+	frame->messages[frame->count++].heap = heap;
+
+	return TRUE;
+}
+
+/* message parameters allocated with update_message_alloc */
+
+static BOOL update_message_post(rdpContext* context, UINT32 id, void* wParam, void* lParam)
+{
+	return update_message_post_ex(context, id, wParam, lParam, FALSE);
+}
+
+/* message parameters allocated on the heap, always freed individually */
+
+static BOOL update_message_post_heap(rdpContext* context, UINT32 id, void* wParam, void* lParam)
+{
+	return update_message_post_ex(context, id, wParam, lParam, TRUE);
+}
+
 /* Update */
 
 static BOOL update_message_BeginPaint(rdpContext* context)
 {
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	rdpUpdateProxy* proxy = context->update->proxy;
+
+	if (proxy && !proxy->frame)
+	{
+		proxy->frame = update_message_frame_take(proxy);
+
+		if (proxy->frame)
+			proxy->frameThreadId = GetCurrentThreadId();
+	}
+
+	return update_message_post(context,
 			MakeMessageId(Update, BeginPaint), NULL, NULL);
 }
 
 static BOOL update_message_EndPaint(rdpContext* context)
 {
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	BOOL status;
+	rdpUpdateFrame* frame;
+	rdpUpdateProxy* proxy = context->update->proxy;
+
+	frame = update_message_current_frame(context);
+
+	status = update_message_post(context,
 			MakeMessageId(Update, EndPaint), NULL, NULL);
+
+	if (!frame)
+		return status;
+
+	proxy->frame = NULL;
+	proxy->frameThreadId = 0;
+
+	if (!MessageQueue_Post(context->update->queue, (void*) context,
+			MakeMessageId(Update, Frame), (void*) frame, NULL))
+	{
+		update_message_frame_release(proxy, frame);
+		return FALSE;
+	}
+
+	return status;
 }
 
 static BOOL update_message_SetBounds(rdpContext* context, rdpBounds* bounds)
@@ -57,25 +438,25 @@ static BOOL update_message_SetBounds(rdpContext* context, rdpBounds* bounds)
 
 	if (bounds)
 	{
-		wParam = (rdpBounds*) malloc(sizeof(rdpBounds));
+		wParam = (rdpBounds*) update_message_alloc(context, sizeof(rdpBounds));
 		if (!wParam)
 			return FALSE;
 		CopyMemory(wParam, bounds, sizeof(rdpBounds));
 	}
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(Update, SetBounds), (void*) wParam, NULL);
 }
 
 static BOOL update_message_Synchronize(rdpContext* context)
 {
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(Update, Synchronize), NULL, NULL);
 }
 
 static BOOL update_message_DesktopResize(rdpContext* context)
 {
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(Update, DesktopResize), NULL, NULL);
 }
 
@@ -84,17 +465,17 @@ static BOOL update_message_BitmapUpdate(rdpContext* context, BITMAP_UPDATE* bitm
 	UINT32 index;
 	BITMAP_UPDATE* wParam;
 
-	wParam = (BITMAP_UPDATE*) malloc(sizeof(BITMAP_UPDATE));
+	wParam = (BITMAP_UPDATE*) update_message_alloc(context, sizeof(BITMAP_UPDATE));
 	if (!wParam)
 		return FALSE;
 
 	wParam->number = bitmap->number;
 	wParam->count = wParam->number;
 
-	wParam->rectangles = (BITMAP_DATA*) malloc(sizeof(BITMAP_DATA) * wParam->number);
+	wParam->rectangles = (BITMAP_DATA*) update_message_alloc(context, sizeof(BITMAP_DATA) * wParam->number);
 	if (!wParam->rectangles)
 	{
-		free(wParam);
+		update_message_discard(context, wParam);
 		return FALSE;
 	}
 	CopyMemory(wParam->rectangles, bitmap->rectangles, sizeof(BITMAP_DATA) * wParam->number);
@@ -102,17 +483,28 @@ static BOOL update_message_BitmapUpdate(rdpContext* context, BITMAP_UPDATE* bitm
 	for (index = 0; index < wParam->number; index++)
 	{
 #ifdef WITH_STREAM_POOL
-		StreamPool_AddRef(context->rdp->transport->ReceivePool, bitmap->rectangles[index].bitmapDataStream);
+		if (!update_message_add_ref(context, bitmap->rectangles[index].bitmapDataStream))
+		{
+			while (index > 0)
+			{
+				index--;
+				update_message_release_ref(context, bitmap->rectangles[index].bitmapDataStream);
+			}
+
+			update_message_discard(context, wParam->rectangles);
+			update_message_discard(context, wParam);
+			return FALSE;
+		}
 #else
-		wParam->rectangles[index].bitmapDataStream = (BYTE*) malloc(wParam->rectangles[index].bitmapLength);
+		wParam->rectangles[index].bitmapDataStream = (BYTE*) update_message_alloc(context, wParam->rectangles[index].bitmapLength);
 		if (!wParam->rectangles[index].bitmapDataStream)
 		{
 			for (index -= 1; index >= 0; --index)
 			{
-				free(wParam->rectangles[index].bitmapDataStream);
+				update_message_discard(context, wParam->rectangles[index].bitmapDataStream);
 			}
-			free(wParam->rectangles);
-			free(wParam);
+			update_message_discard(context, wParam->rectangles);
+			update_message_discard(context, wParam);
 			return FALSE;
 		}
 		CopyMemory(wParam->rectangles[index].bitmapDataStream, bitmap->rectangles[index].bitmapDataStream,
@@ -120,7 +512,7 @@ static BOOL update_message_BitmapUpdate(rdpContext* context, BITMAP_UPDATE* bitm
 #endif
 	}
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(Update, BitmapUpdate), (void*) wParam, NULL);
 }
 
@@ -128,12 +520,12 @@ static BOOL update_message_Palette(rdpContext* context, PALETTE_UPDATE* palette)
 {
 	PALETTE_UPDATE* wParam;
 
-	wParam = (PALETTE_UPDATE*) malloc(sizeof(PALETTE_UPDATE));
+	wParam = (PALETTE_UPDATE*) update_message_alloc(context, sizeof(PALETTE_UPDATE));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, palette, sizeof(PALETTE_UPDATE));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(Update, Palette), (void*) wParam, NULL);
 }
 
@@ -141,18 +533,18 @@ static BOOL update_message_PlaySound(rdpContext* context, PLAY_SOUND_UPDATE* pla
 {
 	PLAY_SOUND_UPDATE* wParam;
 
-	wParam = (PLAY_SOUND_UPDATE*) malloc(sizeof(PLAY_SOUND_UPDATE));
+	wParam = (PLAY_SOUND_UPDATE*) update_message_alloc(context, sizeof(PLAY_SOUND_UPDATE));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, playSound, sizeof(PLAY_SOUND_UPDATE));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(Update, PlaySound), (void*) wParam, NULL);
 }
 
 static BOOL update_message_SetKeyboardIndicators(rdpContext* context, UINT16 led_flags)
 {
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(Update, SetKeyboardIndicators), (void*)(size_t)led_flags, NULL);
 }
 
@@ -160,12 +552,12 @@ static BOOL update_message_RefreshRect(rdpContext* context, BYTE count, RECTANGL
 {
 	RECTANGLE_16* lParam;
 
-	lParam = (RECTANGLE_16*) malloc(sizeof(RECTANGLE_16) * count);
+	lParam = (RECTANGLE_16*) update_message_alloc(context, sizeof(RECTANGLE_16) * count);
 	if (!lParam)
 		return FALSE;
 	CopyMemory(lParam, areas, sizeof(RECTANGLE_16) * count);
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(Update, RefreshRect), (void*) (size_t) count, (void*) lParam);
 }
 
@@ -175,13 +567,13 @@ static BOOL update_message_SuppressOutput(rdpContext* context, BYTE allow, RECTA
 
 	if (area)
 	{
-		lParam = (RECTANGLE_16*) malloc(sizeof(RECTANGLE_16));
+		lParam = (RECTANGLE_16*) update_message_alloc(context, sizeof(RECTANGLE_16));
 		if (!lParam)
 			return FALSE;
 		CopyMemory(lParam, area, sizeof(RECTANGLE_16));
 	}
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(Update, SuppressOutput), (void*) (size_t) allow, (void*) lParam);
 }
 
@@ -189,21 +581,21 @@ static BOOL update_message_SurfaceCommand(rdpContext* context, wStream* s)
 {
 	wStream* wParam;
 
-	wParam = (wStream*) malloc(sizeof(wStream));
+	wParam = (wStream*) update_message_alloc(context, sizeof(wStream));
 	if (!wParam)
 		return FALSE;
 
 	wParam->capacity = Stream_Capacity(s);
-	wParam->buffer = (BYTE*) malloc(wParam->capacity);
+	wParam->buffer = (BYTE*) update_message_alloc(context, wParam->capacity);
 	if (!wParam->buffer)
 	{
-			free(wParam);
+			update_message_discard(context, wParam);
 			return FALSE;
 	}
 
 	wParam->pointer = wParam->buffer;
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(Update, SurfaceCommand), (void*) wParam, NULL);
 }
 
@@ -211,24 +603,28 @@ static BOOL update_message_SurfaceBits(rdpContext* context, SURFACE_BITS_COMMAND
 {
 	SURFACE_BITS_COMMAND* wParam;
 
-	wParam = (SURFACE_BITS_COMMAND*) malloc(sizeof(SURFACE_BITS_COMMAND));
+	wParam = (SURFACE_BITS_COMMAND*) update_message_alloc(context, sizeof(SURFACE_BITS_COMMAND));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, surfaceBitsCommand, sizeof(SURFACE_BITS_COMMAND));
 
 #ifdef WITH_STREAM_POOL
-	StreamPool_AddRef(context->rdp->transport->ReceivePool, surfaceBitsCommand->bitmapData);
+	if (!update_message_add_ref(context, surfaceBitsCommand->bitmapData))
+	{
+		update_message_discard(context, wParam);
+		return FALSE;
+	}
 #else
-	wParam->bitmapData = (BYTE*) malloc(wParam->bitmapDataLength);
+	wParam->bitmapData = (BYTE*) update_message_alloc(context, wParam->bitmapDataLength);
 	if (!wParam->bitmapData)
 	{
-		free(wParam);
+		update_message_discard(context, wParam);
 		return FALSE;
 	}
 	CopyMemory(wParam->bitmapData, surfaceBitsCommand->bitmapData, wParam->bitmapDataLength);
 #endif
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(Update, SurfaceBits), (void*) wParam, NULL);
 }
 
@@ -236,18 +632,18 @@ static BOOL update_message_SurfaceFrameMarker(rdpContext* context, SURFACE_FRAME
 {
 	SURFACE_FRAME_MARKER* wParam;
 
-	wParam = (SURFACE_FRAME_MARKER*) malloc(sizeof(SURFACE_FRAME_MARKER));
+	wParam = (SURFACE_FRAME_MARKER*) update_message_alloc(context, sizeof(SURFACE_FRAME_MARKER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, surfaceFrameMarker, sizeof(SURFACE_FRAME_MARKER));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(Update, SurfaceFrameMarker), (void*) wParam, NULL);
 }
 
 static BOOL update_message_SurfaceFrameAcknowledge(rdpContext* context, UINT32 frameId)
 {
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(Update, SurfaceFrameAcknowledge), (void*) (size_t) frameId, NULL);
 }
 
@@ -257,12 +653,12 @@ static BOOL update_message_DstBlt(rdpContext* context, DSTBLT_ORDER* dstBlt)
 {
 	DSTBLT_ORDER* wParam;
 
-	wParam = (DSTBLT_ORDER*) malloc(sizeof(DSTBLT_ORDER));
+	wParam = (DSTBLT_ORDER*) update_message_alloc(context, sizeof(DSTBLT_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, dstBlt, sizeof(DSTBLT_ORDER));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PrimaryUpdate, DstBlt), (void*) wParam, NULL);
 }
 
@@ -270,14 +666,14 @@ static BOOL update_message_PatBlt(rdpContext* context, PATBLT_ORDER* patBlt)
 {
 	PATBLT_ORDER* wParam;
 
-	wParam = (PATBLT_ORDER*) malloc(sizeof(PATBLT_ORDER));
+	wParam = (PATBLT_ORDER*) update_message_alloc(context, sizeof(PATBLT_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, patBlt, sizeof(PATBLT_ORDER));
 
 	wParam->brush.data = (BYTE*) wParam->brush.p8x8;
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PrimaryUpdate, PatBlt), (void*) wParam, NULL);
 }
 
@@ -285,12 +681,12 @@ static BOOL update_message_ScrBlt(rdpContext* context, SCRBLT_ORDER* scrBlt)
 {
 	SCRBLT_ORDER* wParam;
 
-	wParam = (SCRBLT_ORDER*) malloc(sizeof(SCRBLT_ORDER));
+	wParam = (SCRBLT_ORDER*) update_message_alloc(context, sizeof(SCRBLT_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, scrBlt, sizeof(SCRBLT_ORDER));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PrimaryUpdate, ScrBlt), (void*) wParam, NULL);
 }
 
@@ -298,12 +694,12 @@ static BOOL update_message_OpaqueRect(rdpContext* context, OPAQUE_RECT_ORDER* op
 {
 	OPAQUE_RECT_ORDER* wParam;
 
-	wParam = (OPAQUE_RECT_ORDER*) malloc(sizeof(OPAQUE_RECT_ORDER));
+	wParam = (OPAQUE_RECT_ORDER*) update_message_alloc(context, sizeof(OPAQUE_RECT_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, opaqueRect, sizeof(OPAQUE_RECT_ORDER));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PrimaryUpdate, OpaqueRect), (void*) wParam, NULL);
 }
 
@@ -311,12 +707,12 @@ static BOOL update_message_DrawNineGrid(rdpContext* context, DRAW_NINE_GRID_ORDE
 {
 	DRAW_NINE_GRID_ORDER* wParam;
 
-	wParam = (DRAW_NINE_GRID_ORDER*) malloc(sizeof(DRAW_NINE_GRID_ORDER));
+	wParam = (DRAW_NINE_GRID_ORDER*) update_message_alloc(context, sizeof(DRAW_NINE_GRID_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, drawNineGrid, sizeof(DRAW_NINE_GRID_ORDER));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PrimaryUpdate, DrawNineGrid), (void*) wParam, NULL);
 }
 
@@ -324,12 +720,12 @@ static BOOL update_message_MultiDstBlt(rdpContext* context, MULTI_DSTBLT_ORDER*
 {
 	MULTI_DSTBLT_ORDER* wParam;
 
-	wParam = (MULTI_DSTBLT_ORDER*) malloc(sizeof(MULTI_DSTBLT_ORDER));
+	wParam = (MULTI_DSTBLT_ORDER*) update_message_alloc(context, sizeof(MULTI_DSTBLT_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, multiDstBlt, sizeof(MULTI_DSTBLT_ORDER));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PrimaryUpdate, MultiDstBlt), (void*) wParam, NULL);
 }
 
@@ -337,14 +733,14 @@ static BOOL update_message_MultiPatBlt(rdpContext* context, MULTI_PATBLT_ORDER*
 {
 	MULTI_PATBLT_ORDER* wParam;
 
-	wParam = (MULTI_PATBLT_ORDER*) malloc(sizeof(MULTI_PATBLT_ORDER));
+	wParam = (MULTI_PATBLT_ORDER*) update_message_alloc(context, sizeof(MULTI_PATBLT_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, multiPatBlt, sizeof(MULTI_PATBLT_ORDER));
 
 	wParam->brush.data = (BYTE*) wParam->brush.p8x8;
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PrimaryUpdate, MultiPatBlt), (void*) wParam, NULL);
 }
 
@@ -352,12 +748,12 @@ static BOOL update_message_MultiScrBlt(rdpContext* context, MULTI_SCRBLT_ORDER*
 {
 	MULTI_SCRBLT_ORDER* wParam;
 
-	wParam = (MULTI_SCRBLT_ORDER*) malloc(sizeof(MULTI_SCRBLT_ORDER));
+	wParam = (MULTI_SCRBLT_ORDER*) update_message_alloc(context, sizeof(MULTI_SCRBLT_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, multiScrBlt, sizeof(MULTI_SCRBLT_ORDER));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PrimaryUpdate, MultiScrBlt), (void*) wParam, NULL);
 }
 
@@ -365,12 +761,12 @@ static BOOL update_message_MultiOpaqueRect(rdpContext* context, MULTI_OPAQUE_REC
 {
 	MULTI_OPAQUE_RECT_ORDER* wParam;
 
-	wParam = (MULTI_OPAQUE_RECT_ORDER*) malloc(sizeof(MULTI_OPAQUE_RECT_ORDER));
+	wParam = (MULTI_OPAQUE_RECT_ORDER*) update_message_alloc(context, sizeof(MULTI_OPAQUE_RECT_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, multiOpaqueRect, sizeof(MULTI_OPAQUE_RECT_ORDER));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PrimaryUpdate, MultiOpaqueRect), (void*) wParam, NULL);
 }
 
@@ -378,14 +774,14 @@ static BOOL update_message_MultiDrawNineGrid(rdpContext* context, MULTI_DRAW_NIN
 {
 	MULTI_DRAW_NINE_GRID_ORDER* wParam;
 
-	wParam = (MULTI_DRAW_NINE_GRID_ORDER*) malloc(sizeof(MULTI_DRAW_NINE_GRID_ORDER));
+	wParam = (MULTI_DRAW_NINE_GRID_ORDER*) update_message_alloc(context, sizeof(MULTI_DRAW_NINE_GRID_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, multiDrawNineGrid, sizeof(MULTI_DRAW_NINE_GRID_ORDER));
 
 	/* TODO: complete copy */
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PrimaryUpdate, MultiDrawNineGrid), (void*) wParam, NULL);
 }
 
@@ -393,12 +789,12 @@ static BOOL update_message_LineTo(rdpContext* context, LINE_TO_ORDER* lineTo)
 {
 	LINE_TO_ORDER* wParam;
 
-	wParam = (LINE_TO_ORDER*) malloc(sizeof(LINE_TO_ORDER));
+	wParam = (LINE_TO_ORDER*) update_message_alloc(context, sizeof(LINE_TO_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, lineTo, sizeof(LINE_TO_ORDER));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PrimaryUpdate, LineTo), (void*) wParam, NULL);
 }
 
@@ -406,20 +802,20 @@ static BOOL update_message_Polyline(rdpContext* context, POLYLINE_ORDER* polylin
 {
 	POLYLINE_ORDER* wParam;
 
-	wParam = (POLYLINE_ORDER*) malloc(sizeof(POLYLINE_ORDER));
+	wParam = (POLYLINE_ORDER*) update_message_alloc(context, sizeof(POLYLINE_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, polyline, sizeof(POLYLINE_ORDER));
 
-	wParam->points = (DELTA_POINT*) malloc(sizeof(DELTA_POINT) * wParam->numDeltaEntries);
+	wParam->points = (DELTA_POINT*) update_message_alloc(context, sizeof(DELTA_POINT) * wParam->numDeltaEntries);
 	if (!wParam->points)
 	{
-		free(wParam);
+		update_message_discard(context, wParam);
 		return FALSE;
 	}
 	CopyMemory(wParam->points, polyline->points, sizeof(DELTA_POINT) * wParam->numDeltaEntries);
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PrimaryUpdate, Polyline), (void*) wParam, NULL);
 }
 
@@ -427,12 +823,12 @@ static BOOL update_message_MemBlt(rdpContext* context, MEMBLT_ORDER* memBlt)
 {
 	MEMBLT_ORDER* wParam;
 
-	wParam = (MEMBLT_ORDER*) malloc(sizeof(MEMBLT_ORDER));
+	wParam = (MEMBLT_ORDER*) update_message_alloc(context, sizeof(MEMBLT_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, memBlt, sizeof(MEMBLT_ORDER));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PrimaryUpdate, MemBlt), (void*) wParam, NULL);
 }
 
@@ -440,14 +836,14 @@ static BOOL update_message_Mem3Blt(rdpContext* context, MEM3BLT_ORDER* mem3Blt)
 {
 	MEM3BLT_ORDER* wParam;
 
-	wParam = (MEM3BLT_ORDER*) malloc(sizeof(MEM3BLT_ORDER));
+	wParam = (MEM3BLT_ORDER*) update_message_alloc(context, sizeof(MEM3BLT_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, mem3Blt, sizeof(MEM3BLT_ORDER));
 
 	wParam->brush.data = (BYTE*) wParam->brush.p8x8;
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PrimaryUpdate, Mem3Blt), (void*) wParam, NULL);
 }
 
@@ -455,12 +851,12 @@ static BOOL update_message_SaveBitmap(rdpContext* context, SAVE_BITMAP_ORDER* sa
 {
 	SAVE_BITMAP_ORDER* wParam;
 
-	wParam = (SAVE_BITMAP_ORDER*) malloc(sizeof(SAVE_BITMAP_ORDER));
+	wParam = (SAVE_BITMAP_ORDER*) update_message_alloc(context, sizeof(SAVE_BITMAP_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, saveBitmap, sizeof(SAVE_BITMAP_ORDER));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PrimaryUpdate, SaveBitmap), (void*) wParam, NULL);
 }
 
@@ -468,14 +864,14 @@ static BOOL update_message_GlyphIndex(rdpContext* context, GLYPH_INDEX_ORDER* gl
 {
 	GLYPH_INDEX_ORDER* wParam;
 
-	wParam = (GLYPH_INDEX_ORDER*) malloc(sizeof(GLYPH_INDEX_ORDER));
+	wParam = (GLYPH_INDEX_ORDER*) update_message_alloc(context, sizeof(GLYPH_INDEX_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, glyphIndex, sizeof(GLYPH_INDEX_ORDER));
 
 	wParam->brush.data = (BYTE*) wParam->brush.p8x8;
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PrimaryUpdate, GlyphIndex), (void*) wParam, NULL);
 }
 
@@ -483,12 +879,12 @@ static BOOL update_message_FastIndex(rdpContext* context, FAST_INDEX_ORDER* fast
 {
 	FAST_INDEX_ORDER* wParam;
 
-	wParam = (FAST_INDEX_ORDER*) malloc(sizeof(FAST_INDEX_ORDER));
+	wParam = (FAST_INDEX_ORDER*) update_message_alloc(context, sizeof(FAST_INDEX_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, fastIndex, sizeof(FAST_INDEX_ORDER));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PrimaryUpdate, FastIndex), (void*) wParam, NULL);
 }
 
@@ -496,17 +892,17 @@ static BOOL update_message_FastGlyph(rdpContext* context, FAST_GLYPH_ORDER* fast
 {
 	FAST_GLYPH_ORDER* wParam;
 
-	wParam = (FAST_GLYPH_ORDER*) malloc(sizeof(FAST_GLYPH_ORDER));
+	wParam = (FAST_GLYPH_ORDER*) update_message_alloc(context, sizeof(FAST_GLYPH_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, fastGlyph, sizeof(FAST_GLYPH_ORDER));
 
 	if (wParam->cbData > 1)
 	{
-		wParam->glyphData.aj = (BYTE*) malloc(fastGlyph->glyphData.cb);
+		wParam->glyphData.aj = (BYTE*) update_message_alloc(context, fastGlyph->glyphData.cb);
 		if (!wParam->glyphData.aj)
 		{
-			free(wParam);
+			update_message_discard(context, wParam);
 			return FALSE;
 		}
 		CopyMemory(wParam->glyphData.aj, fastGlyph->glyphData.aj, fastGlyph->glyphData.cb);
@@ -516,7 +912,7 @@ static BOOL update_message_FastGlyph(rdpContext* context, FAST_GLYPH_ORDER* fast
 		wParam->glyphData.aj = NULL;
 	}
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PrimaryUpdate, FastGlyph), (void*) wParam, NULL);
 }
 
@@ -524,20 +920,20 @@ static BOOL update_message_PolygonSC(rdpContext* context, POLYGON_SC_ORDER* poly
 {
 	POLYGON_SC_ORDER* wParam;
 
-	wParam = (POLYGON_SC_ORDER*) malloc(sizeof(POLYGON_SC_ORDER));
+	wParam = (POLYGON_SC_ORDER*) update_message_alloc(context, sizeof(POLYGON_SC_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, polygonSC, sizeof(POLYGON_SC_ORDER));
 
-	wParam->points = (DELTA_POINT*) malloc(sizeof(DELTA_POINT) * wParam->numPoints);
+	wParam->points = (DELTA_POINT*) update_message_alloc(context, sizeof(DELTA_POINT) * wParam->numPoints);
 	if (!wParam->points)
 	{
-		free(wParam);
+		update_message_discard(context, wParam);
 		return FALSE;
 	}
 	CopyMemory(wParam->points, polygonSC, sizeof(DELTA_POINT) * wParam->numPoints);
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PrimaryUpdate, PolygonSC), (void*) wParam, NULL);
 }
 
@@ -545,22 +941,22 @@ static BOOL update_message_PolygonCB(rdpContext* context, POLYGON_CB_ORDER* poly
 {
 	POLYGON_CB_ORDER* wParam;
 
-	wParam = (POLYGON_CB_ORDER*) malloc(sizeof(POLYGON_CB_ORDER));
+	wParam = (POLYGON_CB_ORDER*) update_message_alloc(context, sizeof(POLYGON_CB_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, polygonCB, sizeof(POLYGON_CB_ORDER));
 
-	wParam->points = (DELTA_POINT*) malloc(sizeof(DELTA_POINT) * wParam->numPoints);
+	wParam->points = (DELTA_POINT*) update_message_alloc(context, sizeof(DELTA_POINT) * wParam->numPoints);
 	if (!wParam->points)
 	{
-		free(wParam);
+		update_message_discard(context, wParam);
 		return FALSE;
 	}
 	CopyMemory(wParam->points, polygonCB, sizeof(DELTA_POINT) * wParam->numPoints);
 
 	wParam->brush.data = (BYTE*) wParam->brush.p8x8;
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PrimaryUpdate, PolygonCB), (void*) wParam, NULL);
 }
 
@@ -568,12 +964,12 @@ static BOOL update_message_EllipseSC(rdpContext* context, ELLIPSE_SC_ORDER* elli
 {
 	ELLIPSE_SC_ORDER* wParam;
 
-	wParam = (ELLIPSE_SC_ORDER*) malloc(sizeof(ELLIPSE_SC_ORDER));
+	wParam = (ELLIPSE_SC_ORDER*) update_message_alloc(context, sizeof(ELLIPSE_SC_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, ellipseSC, sizeof(ELLIPSE_SC_ORDER));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PrimaryUpdate, EllipseSC), (void*) wParam, NULL);
 }
 
@@ -581,14 +977,14 @@ static BOOL update_message_EllipseCB(rdpContext* context, ELLIPSE_CB_ORDER* elli
 {
 	ELLIPSE_CB_ORDER* wParam;
 
-	wParam = (ELLIPSE_CB_ORDER*) malloc(sizeof(ELLIPSE_CB_ORDER));
+	wParam = (ELLIPSE_CB_ORDER*) update_message_alloc(context, sizeof(ELLIPSE_CB_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, ellipseCB, sizeof(ELLIPSE_CB_ORDER));
 
 	wParam->brush.data = (BYTE*) wParam->brush.p8x8;
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PrimaryUpdate, EllipseCB), (void*) wParam, NULL);
 }
 
@@ -598,20 +994,20 @@ static BOOL update_message_CacheBitmap(rdpContext* context, CACHE_BITMAP_ORDER*
 {
 	CACHE_BITMAP_ORDER* wParam;
 
-	wParam = (CACHE_BITMAP_ORDER*) malloc(sizeof(CACHE_BITMAP_ORDER));
+	wParam = (CACHE_BITMAP_ORDER*) update_message_alloc(context, sizeof(CACHE_BITMAP_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, cacheBitmapOrder, sizeof(CACHE_BITMAP_ORDER));
 
-	wParam->bitmapDataStream = (BYTE*) malloc(wParam->bitmapLength);
+	wParam->bitmapDataStream = (BYTE*) update_message_alloc(context, wParam->bitmapLength);
 	if (!wParam->bitmapDataStream)
 	{
-		free(wParam);
+		update_message_discard(context, wParam);
 		return FALSE;
 	}
 	CopyMemory(wParam->bitmapDataStream, cacheBitmapOrder, wParam->bitmapLength);
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(SecondaryUpdate, CacheBitmap), (void*) wParam, NULL);
 }
 
@@ -619,20 +1015,20 @@ static BOOL update_message_CacheBitmapV2(rdpContext* context, CACHE_BITMAP_V2_OR
 {
 	CACHE_BITMAP_V2_ORDER* wParam;
 
-	wParam = (CACHE_BITMAP_V2_ORDER*) malloc(sizeof(CACHE_BITMAP_V2_ORDER));
+	wParam = (CACHE_BITMAP_V2_ORDER*) update_message_alloc(context, sizeof(CACHE_BITMAP_V2_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, cacheBitmapV2Order, sizeof(CACHE_BITMAP_V2_ORDER));
 
-	wParam->bitmapDataStream = (BYTE*) malloc(wParam->bitmapLength);
+	wParam->bitmapDataStream = (BYTE*) update_message_alloc(context, wParam->bitmapLength);
 	if (!wParam->bitmapDataStream)
 	{
-		free(wParam);
+		update_message_discard(context, wParam);
 		return FALSE;
 	}
 	CopyMemory(wParam->bitmapDataStream, cacheBitmapV2Order->bitmapDataStream, wParam->bitmapLength);
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(SecondaryUpdate, CacheBitmapV2), (void*) wParam, NULL);
 }
 
@@ -640,20 +1036,20 @@ static BOOL update_message_CacheBitmapV3(rdpContext* context, CACHE_BITMAP_V3_OR
 {
 	CACHE_BITMAP_V3_ORDER* wParam;
 
-	wParam = (CACHE_BITMAP_V3_ORDER*) malloc(sizeof(CACHE_BITMAP_V3_ORDER));
+	wParam = (CACHE_BITMAP_V3_ORDER*) update_message_alloc(context, sizeof(CACHE_BITMAP_V3_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, cacheBitmapV3Order, sizeof(CACHE_BITMAP_V3_ORDER));
 
-	wParam->bitmapData.data = (BYTE*) malloc(wParam->bitmapData.length);
+	wParam->bitmapData.data = (BYTE*) update_message_alloc(context, wParam->bitmapData.length);
 	if (!wParam->bitmapData.data)
 	{
-		free(wParam);
+		update_message_discard(context, wParam);
 		return FALSE;
 	}
 	CopyMemory(wParam->bitmapData.data, cacheBitmapV3Order->bitmapData.data, wParam->bitmapData.length);
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(SecondaryUpdate, CacheBitmapV3), (void*) wParam, NULL);
 }
 
@@ -661,12 +1057,12 @@ static BOOL update_message_CacheColorTable(rdpContext* context, CACHE_COLOR_TABL
 {
 	CACHE_COLOR_TABLE_ORDER* wParam;
 
-	wParam = (CACHE_COLOR_TABLE_ORDER*) malloc(sizeof(CACHE_COLOR_TABLE_ORDER));
+	wParam = (CACHE_COLOR_TABLE_ORDER*) update_message_alloc(context, sizeof(CACHE_COLOR_TABLE_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, cacheColorTableOrder, sizeof(CACHE_COLOR_TABLE_ORDER));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(SecondaryUpdate, CacheColorTable), (void*) wParam, NULL);
 }
 
@@ -674,12 +1070,12 @@ static BOOL update_message_CacheGlyph(rdpContext* context, CACHE_GLYPH_ORDER* ca
 {
 	CACHE_GLYPH_ORDER* wParam;
 
-	wParam = (CACHE_GLYPH_ORDER*) malloc(sizeof(CACHE_GLYPH_ORDER));
+	wParam = (CACHE_GLYPH_ORDER*) update_message_alloc(context, sizeof(CACHE_GLYPH_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, cacheGlyphOrder, sizeof(CACHE_GLYPH_ORDER));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(SecondaryUpdate, CacheGlyph), (void*) wParam, NULL);
 }
 
@@ -687,12 +1083,12 @@ static BOOL update_message_CacheGlyphV2(rdpContext* context, CACHE_GLYPH_V2_ORDE
 {
 	CACHE_GLYPH_V2_ORDER* wParam;
 
-	wParam = (CACHE_GLYPH_V2_ORDER*) malloc(sizeof(CACHE_GLYPH_V2_ORDER));
+	wParam = (CACHE_GLYPH_V2_ORDER*) update_message_alloc(context, sizeof(CACHE_GLYPH_V2_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, cacheGlyphV2Order, sizeof(CACHE_GLYPH_V2_ORDER));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(SecondaryUpdate, CacheGlyphV2), (void*) wParam, NULL);
 }
 
@@ -700,12 +1096,12 @@ static BOOL update_message_CacheBrush(rdpContext* context, CACHE_BRUSH_ORDER* ca
 {
 	CACHE_BRUSH_ORDER* wParam;
 
-	wParam = (CACHE_BRUSH_ORDER*) malloc(sizeof(CACHE_BRUSH_ORDER));
+	wParam = (CACHE_BRUSH_ORDER*) update_message_alloc(context, sizeof(CACHE_BRUSH_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, cacheBrushOrder, sizeof(CACHE_BRUSH_ORDER));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(SecondaryUpdate, CacheBrush), (void*) wParam, NULL);
 }
 
@@ -715,22 +1111,22 @@ static BOOL update_message_CreateOffscreenBitmap(rdpContext* context, CREATE_OFF
 {
 	CREATE_OFFSCREEN_BITMAP_ORDER* wParam;
 
-	wParam = (CREATE_OFFSCREEN_BITMAP_ORDER*) malloc(sizeof(CREATE_OFFSCREEN_BITMAP_ORDER));
+	wParam = (CREATE_OFFSCREEN_BITMAP_ORDER*) update_message_alloc(context, sizeof(CREATE_OFFSCREEN_BITMAP_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, createOffscreenBitmap, sizeof(CREATE_OFFSCREEN_BITMAP_ORDER));
 
 	wParam->deleteList.cIndices = createOffscreenBitmap->deleteList.cIndices;
 	wParam->deleteList.sIndices = wParam->deleteList.cIndices;
-	wParam->deleteList.indices = (UINT16*) malloc(sizeof(UINT16) * wParam->deleteList.cIndices);
+	wParam->deleteList.indices = (UINT16*) update_message_alloc(context, sizeof(UINT16) * wParam->deleteList.cIndices);
 	if (!wParam->deleteList.indices)
 	{
-		free(wParam);
+		update_message_discard(context, wParam);
 		return FALSE;
 	}
 	CopyMemory(wParam->deleteList.indices, createOffscreenBitmap->deleteList.indices, wParam->deleteList.cIndices);
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(AltSecUpdate, CreateOffscreenBitmap), (void*) wParam, NULL);
 }
 
@@ -738,12 +1134,12 @@ static BOOL update_message_SwitchSurface(rdpContext* context, SWITCH_SURFACE_ORD
 {
 	SWITCH_SURFACE_ORDER* wParam;
 
-	wParam = (SWITCH_SURFACE_ORDER*) malloc(sizeof(SWITCH_SURFACE_ORDER));
+	wParam = (SWITCH_SURFACE_ORDER*) update_message_alloc(context, sizeof(SWITCH_SURFACE_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, switchSurface, sizeof(SWITCH_SURFACE_ORDER));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(AltSecUpdate, SwitchSurface), (void*) wParam, NULL);
 }
 
@@ -751,12 +1147,12 @@ static BOOL update_message_CreateNineGridBitmap(rdpContext* context, CREATE_NINE
 {
 	CREATE_NINE_GRID_BITMAP_ORDER* wParam;
 
-	wParam = (CREATE_NINE_GRID_BITMAP_ORDER*) malloc(sizeof(CREATE_NINE_GRID_BITMAP_ORDER));
+	wParam = (CREATE_NINE_GRID_BITMAP_ORDER*) update_message_alloc(context, sizeof(CREATE_NINE_GRID_BITMAP_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, createNineGridBitmap, sizeof(CREATE_NINE_GRID_BITMAP_ORDER));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(AltSecUpdate, CreateNineGridBitmap), (void*) wParam, NULL);
 }
 
@@ -764,12 +1160,12 @@ static BOOL update_message_FrameMarker(rdpContext* context, FRAME_MARKER_ORDER*
 {
 	FRAME_MARKER_ORDER* wParam;
 
-	wParam = (FRAME_MARKER_ORDER*) malloc(sizeof(FRAME_MARKER_ORDER));
+	wParam = (FRAME_MARKER_ORDER*) update_message_alloc(context, sizeof(FRAME_MARKER_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, frameMarker, sizeof(FRAME_MARKER_ORDER));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(AltSecUpdate, FrameMarker), (void*) wParam, NULL);
 }
 
@@ -777,14 +1173,14 @@ static BOOL update_message_StreamBitmapFirst(rdpContext* context, STREAM_BITMAP_
 {
 	STREAM_BITMAP_FIRST_ORDER* wParam;
 
-	wParam = (STREAM_BITMAP_FIRST_ORDER*) malloc(sizeof(STREAM_BITMAP_FIRST_ORDER));
+	wParam = (STREAM_BITMAP_FIRST_ORDER*) update_message_alloc(context, sizeof(STREAM_BITMAP_FIRST_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, streamBitmapFirst, sizeof(STREAM_BITMAP_FIRST_ORDER));
 
 	/* TODO: complete copy */
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(AltSecUpdate, StreamBitmapFirst), (void*) wParam, NULL);
 }
 
@@ -792,14 +1188,14 @@ static BOOL update_message_StreamBitmapNext(rdpContext* context, STREAM_BITMAP_N
 {
 	STREAM_BITMAP_NEXT_ORDER* wParam;
 
-	wParam = (STREAM_BITMAP_NEXT_ORDER*) malloc(sizeof(STREAM_BITMAP_NEXT_ORDER));
+	wParam = (STREAM_BITMAP_NEXT_ORDER*) update_message_alloc(context, sizeof(STREAM_BITMAP_NEXT_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, streamBitmapNext, sizeof(STREAM_BITMAP_NEXT_ORDER));
 
 	/* TODO: complete copy */
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(AltSecUpdate, StreamBitmapNext), (void*) wParam, NULL);
 }
 
@@ -807,14 +1203,14 @@ static BOOL update_message_DrawGdiPlusFirst(rdpContext* context, DRAW_GDIPLUS_FI
 {
 	DRAW_GDIPLUS_FIRST_ORDER* wParam;
 
-	wParam = (DRAW_GDIPLUS_FIRST_ORDER*) malloc(sizeof(DRAW_GDIPLUS_FIRST_ORDER));
+	wParam = (DRAW_GDIPLUS_FIRST_ORDER*) update_message_alloc(context, sizeof(DRAW_GDIPLUS_FIRST_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, drawGdiPlusFirst, sizeof(DRAW_GDIPLUS_FIRST_ORDER));
 
 	/* TODO: complete copy */
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(AltSecUpdate, DrawGdiPlusFirst), (void*) wParam, NULL);
 }
 
@@ -822,14 +1218,14 @@ static BOOL update_message_DrawGdiPlusNext(rdpContext* context, DRAW_GDIPLUS_NEX
 {
 	DRAW_GDIPLUS_NEXT_ORDER* wParam;
 
-	wParam = (DRAW_GDIPLUS_NEXT_ORDER*) malloc(sizeof(DRAW_GDIPLUS_NEXT_ORDER));
+	wParam = (DRAW_GDIPLUS_NEXT_ORDER*) update_message_alloc(context, sizeof(DRAW_GDIPLUS_NEXT_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, drawGdiPlusNext, sizeof(DRAW_GDIPLUS_NEXT_ORDER));
 
 	/* TODO: complete copy */
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(AltSecUpdate, DrawGdiPlusNext), (void*) wParam, NULL);
 }
 
@@ -837,14 +1233,14 @@ static BOOL update_message_DrawGdiPlusEnd(rdpContext* context, DRAW_GDIPLUS_END_
 {
 	DRAW_GDIPLUS_END_ORDER* wParam;
 
-	wParam = (DRAW_GDIPLUS_END_ORDER*) malloc(sizeof(DRAW_GDIPLUS_END_ORDER));
+	wParam = (DRAW_GDIPLUS_END_ORDER*) update_message_alloc(context, sizeof(DRAW_GDIPLUS_END_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, drawGdiPlusEnd, sizeof(DRAW_GDIPLUS_END_ORDER));
 
 	/* TODO: complete copy */
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(AltSecUpdate, DrawGdiPlusEnd), (void*) wParam, NULL);
 }
 
@@ -852,14 +1248,14 @@ static BOOL update_message_DrawGdiPlusCacheFirst(rdpContext* context, DRAW_GDIPL
 {
 	DRAW_GDIPLUS_CACHE_FIRST_ORDER* wParam;
 
-	wParam = (DRAW_GDIPLUS_CACHE_FIRST_ORDER*) malloc(sizeof(DRAW_GDIPLUS_CACHE_FIRST_ORDER));
+	wParam = (DRAW_GDIPLUS_CACHE_FIRST_ORDER*) update_message_alloc(context, sizeof(DRAW_GDIPLUS_CACHE_FIRST_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, drawGdiPlusCacheFirst, sizeof(DRAW_GDIPLUS_CACHE_FIRST_ORDER));
 
 	/* TODO: complete copy */
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(AltSecUpdate, DrawGdiPlusCacheFirst), (void*) wParam, NULL);
 }
 
@@ -867,14 +1263,14 @@ static BOOL update_message_DrawGdiPlusCacheNext(rdpContext* context, DRAW_GDIPLU
 {
 	DRAW_GDIPLUS_CACHE_NEXT_ORDER* wParam;
 
-	wParam = (DRAW_GDIPLUS_CACHE_NEXT_ORDER*) malloc(sizeof(DRAW_GDIPLUS_CACHE_NEXT_ORDER));
+	wParam = (DRAW_GDIPLUS_CACHE_NEXT_ORDER*) update_message_alloc(context, sizeof(DRAW_GDIPLUS_CACHE_NEXT_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, drawGdiPlusCacheNext, sizeof(DRAW_GDIPLUS_CACHE_NEXT_ORDER));
 
 	/* TODO: complete copy */
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(AltSecUpdate, DrawGdiPlusCacheNext), (void*) wParam, NULL);
 }
 
@@ -882,14 +1278,14 @@ static BOOL update_message_DrawGdiPlusCacheEnd(rdpContext* context, DRAW_GDIPLUS
 {
 	DRAW_GDIPLUS_CACHE_END_ORDER* wParam;
 
-	wParam = (DRAW_GDIPLUS_CACHE_END_ORDER*) malloc(sizeof(DRAW_GDIPLUS_CACHE_END_ORDER));
+	wParam = (DRAW_GDIPLUS_CACHE_END_ORDER*) update_message_alloc(context, sizeof(DRAW_GDIPLUS_CACHE_END_ORDER));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, drawGdiPlusCacheEnd, sizeof(DRAW_GDIPLUS_CACHE_END_ORDER));
 
 	/* TODO: complete copy */
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(AltSecUpdate, DrawGdiPlusCacheEnd), (void*) wParam, NULL);
 }
 
@@ -900,20 +1296,20 @@ static BOOL update_message_WindowCreate(rdpContext* context, WINDOW_ORDER_INFO*
 	WINDOW_ORDER_INFO* wParam;
 	WINDOW_STATE_ORDER* lParam;
 
-	wParam = (WINDOW_ORDER_INFO*) malloc(sizeof(WINDOW_ORDER_INFO));
+	wParam = (WINDOW_ORDER_INFO*) update_message_alloc(context, sizeof(WINDOW_ORDER_INFO));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, orderInfo, sizeof(WINDOW_ORDER_INFO));
 
-	lParam = (WINDOW_STATE_ORDER*) malloc(sizeof(WINDOW_STATE_ORDER));
+	lParam = (WINDOW_STATE_ORDER*) update_message_alloc(context, sizeof(WINDOW_STATE_ORDER));
 	if (!lParam)
 	{
-		free(wParam);
+		update_message_discard(context, wParam);
 		return FALSE;
 	}
 	CopyMemory(lParam, windowState, sizeof(WINDOW_STATE_ORDER));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(WindowUpdate, WindowCreate), (void*) wParam, (void*) lParam);
 }
 
@@ -922,20 +1318,20 @@ static BOOL	update_message_WindowUpdate(rdpContext* context, WINDOW_ORDER_INFO*
 	WINDOW_ORDER_INFO* wParam;
 	WINDOW_STATE_ORDER* lParam;
 
-	wParam = (WINDOW_ORDER_INFO*) malloc(sizeof(WINDOW_ORDER_INFO));
+	wParam = (WINDOW_ORDER_INFO*) update_message_alloc(context, sizeof(WINDOW_ORDER_INFO));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, orderInfo, sizeof(WINDOW_ORDER_INFO));
 
-	lParam = (WINDOW_STATE_ORDER*) malloc(sizeof(WINDOW_STATE_ORDER));
+	lParam = (WINDOW_STATE_ORDER*) update_message_alloc(context, sizeof(WINDOW_STATE_ORDER));
 	if (!lParam)
 	{
-		free(wParam);
+		update_message_discard(context, wParam);
 		return FALSE;
 	}
 	CopyMemory(lParam, windowState, sizeof(WINDOW_STATE_ORDER));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(WindowUpdate, WindowUpdate), (void*) wParam, (void*) lParam);
 }
 
@@ -983,7 +1379,7 @@ static BOOL update_message_WindowIcon(rdpContext* context, WINDOW_ORDER_INFO* or
 		CopyMemory(lParam->iconInfo->colorTable, windowIcon->iconInfo->colorTable, windowIcon->iconInfo->cbColorTable);
 	}
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post_heap(context,
 			MakeMessageId(WindowUpdate, WindowIcon), (void*) wParam, (void*) lParam);
 
 out_fail:
@@ -1001,20 +1397,20 @@ static BOOL update_message_WindowCachedIcon(rdpContext* context, WINDOW_ORDER_IN
 	WINDOW_ORDER_INFO* wParam;
 	WINDOW_CACHED_ICON_ORDER* lParam;
 
-	wParam = (WINDOW_ORDER_INFO*) malloc(sizeof(WINDOW_ORDER_INFO));
+	wParam = (WINDOW_ORDER_INFO*) update_message_alloc(context, sizeof(WINDOW_ORDER_INFO));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, orderInfo, sizeof(WINDOW_ORDER_INFO));
 
-	lParam = (WINDOW_CACHED_ICON_ORDER*) malloc(sizeof(WINDOW_CACHED_ICON_ORDER));
+	lParam = (WINDOW_CACHED_ICON_ORDER*) update_message_alloc(context, sizeof(WINDOW_CACHED_ICON_ORDER));
 	if (!lParam)
 	{
-		free(wParam);
+		update_message_discard(context, wParam);
 		return FALSE;
 	}
 	CopyMemory(lParam, windowCachedIcon, sizeof(WINDOW_CACHED_ICON_ORDER));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(WindowUpdate, WindowCachedIcon), (void*) wParam, (void*) lParam);
 }
 
@@ -1022,12 +1418,12 @@ static BOOL update_message_WindowDelete(rdpContext* context, WINDOW_ORDER_INFO*
 {
 	WINDOW_ORDER_INFO* wParam;
 
-	wParam = (WINDOW_ORDER_INFO*) malloc(sizeof(WINDOW_ORDER_INFO));
+	wParam = (WINDOW_ORDER_INFO*) update_message_alloc(context, sizeof(WINDOW_ORDER_INFO));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, orderInfo, sizeof(WINDOW_ORDER_INFO));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(WindowUpdate, WindowDelete), (void*) wParam, NULL);
 }
 
@@ -1036,20 +1432,20 @@ static BOOL update_message_NotifyIconCreate(rdpContext* context, WINDOW_ORDER_IN
 	WINDOW_ORDER_INFO* wParam;
 	NOTIFY_ICON_STATE_ORDER* lParam;
 
-	wParam = (WINDOW_ORDER_INFO*) malloc(sizeof(WINDOW_ORDER_INFO));
+	wParam = (WINDOW_ORDER_INFO*) update_message_alloc(context, sizeof(WINDOW_ORDER_INFO));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, orderInfo, sizeof(WINDOW_ORDER_INFO));
 
-	lParam = (NOTIFY_ICON_STATE_ORDER*) malloc(sizeof(NOTIFY_ICON_STATE_ORDER));
+	lParam = (NOTIFY_ICON_STATE_ORDER*) update_message_alloc(context, sizeof(NOTIFY_ICON_STATE_ORDER));
 	if (!lParam)
 	{
-		free(wParam);
+		update_message_discard(context, wParam);
 		return FALSE;
 	}
 	CopyMemory(lParam, notifyIconState, sizeof(NOTIFY_ICON_STATE_ORDER));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(WindowUpdate, NotifyIconCreate), (void*) wParam, (void*) lParam);
 }
 
@@ -1058,20 +1454,20 @@ static BOOL update_message_NotifyIconUpdate(rdpContext* context, WINDOW_ORDER_IN
 	WINDOW_ORDER_INFO* wParam;
 	NOTIFY_ICON_STATE_ORDER* lParam;
 
-	wParam = (WINDOW_ORDER_INFO*) malloc(sizeof(WINDOW_ORDER_INFO));
+	wParam = (WINDOW_ORDER_INFO*) update_message_alloc(context, sizeof(WINDOW_ORDER_INFO));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, orderInfo, sizeof(WINDOW_ORDER_INFO));
 
-	lParam = (NOTIFY_ICON_STATE_ORDER*) malloc(sizeof(NOTIFY_ICON_STATE_ORDER));
+	lParam = (NOTIFY_ICON_STATE_ORDER*) update_message_alloc(context, sizeof(NOTIFY_ICON_STATE_ORDER));
 	if (!lParam)
 	{
-		free(wParam);
+		update_message_discard(context, wParam);
 		return FALSE;
 	}
 	CopyMemory(lParam, notifyIconState, sizeof(NOTIFY_ICON_STATE_ORDER));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(WindowUpdate, NotifyIconUpdate), (void*) wParam, (void*) lParam);
 }
 
@@ -1079,12 +1475,12 @@ static BOOL update_message_NotifyIconDelete(rdpContext* context, WINDOW_ORDER_IN
 {
 	WINDOW_ORDER_INFO* wParam;
 
-	wParam = (WINDOW_ORDER_INFO*) malloc(sizeof(WINDOW_ORDER_INFO));
+	wParam = (WINDOW_ORDER_INFO*) update_message_alloc(context, sizeof(WINDOW_ORDER_INFO));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, orderInfo, sizeof(WINDOW_ORDER_INFO));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(WindowUpdate, NotifyIconDelete), (void*) wParam, NULL);
 }
 
@@ -1093,15 +1489,15 @@ static BOOL update_message_MonitoredDesktop(rdpContext* context, WINDOW_ORDER_IN
 	WINDOW_ORDER_INFO* wParam;
 	MONITORED_DESKTOP_ORDER* lParam;
 
-	wParam = (WINDOW_ORDER_INFO*) malloc(sizeof(WINDOW_ORDER_INFO));
+	wParam = (WINDOW_ORDER_INFO*) update_message_alloc(context, sizeof(WINDOW_ORDER_INFO));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, orderInfo, sizeof(WINDOW_ORDER_INFO));
 
-	lParam = (MONITORED_DESKTOP_ORDER*) malloc(sizeof(MONITORED_DESKTOP_ORDER));
+	lParam = (MONITORED_DESKTOP_ORDER*) update_message_alloc(context, sizeof(MONITORED_DESKTOP_ORDER));
 	if (!lParam)
 	{
-		free(wParam);
+		update_message_discard(context, wParam);
 		return FALSE;
 	}
 	CopyMemory(lParam, monitoredDesktop, sizeof(MONITORED_DESKTOP_ORDER));
@@ -1110,11 +1506,11 @@ static BOOL update_message_MonitoredDesktop(rdpContext* context, WINDOW_ORDER_IN
 
 	if (lParam->numWindowIds)
 	{
-		lParam->windowIds = (UINT32*) malloc(sizeof(UINT32) * lParam->numWindowIds);
+		lParam->windowIds = (UINT32*) update_message_alloc(context, sizeof(UINT32) * lParam->numWindowIds);
 		CopyMemory(lParam->windowIds, monitoredDesktop->windowIds, lParam->numWindowIds);
 	}
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(WindowUpdate, MonitoredDesktop), (void*) wParam, (void*) lParam);
 }
 
@@ -1122,12 +1518,12 @@ static BOOL update_message_NonMonitoredDesktop(rdpContext* context, WINDOW_ORDER
 {
 	WINDOW_ORDER_INFO* wParam;
 
-	wParam = (WINDOW_ORDER_INFO*) malloc(sizeof(WINDOW_ORDER_INFO));
+	wParam = (WINDOW_ORDER_INFO*) update_message_alloc(context, sizeof(WINDOW_ORDER_INFO));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, orderInfo, sizeof(WINDOW_ORDER_INFO));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(WindowUpdate, NonMonitoredDesktop), (void*) wParam, NULL);
 }
 
@@ -1137,12 +1533,12 @@ static BOOL update_message_PointerPosition(rdpContext* context, POINTER_POSITION
 {
 	POINTER_POSITION_UPDATE* wParam;
 
-	wParam = (POINTER_POSITION_UPDATE*) malloc(sizeof(POINTER_POSITION_UPDATE));
+	wParam = (POINTER_POSITION_UPDATE*) update_message_alloc(context, sizeof(POINTER_POSITION_UPDATE));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, pointerPosition, sizeof(POINTER_POSITION_UPDATE));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PointerUpdate, PointerPosition), (void*) wParam, NULL);
 }
 
@@ -1150,12 +1546,12 @@ static BOOL update_message_PointerSystem(rdpContext* context, POINTER_SYSTEM_UPD
 {
 	POINTER_SYSTEM_UPDATE* wParam;
 
-	wParam = (POINTER_SYSTEM_UPDATE*) malloc(sizeof(POINTER_SYSTEM_UPDATE));
+	wParam = (POINTER_SYSTEM_UPDATE*) update_message_alloc(context, sizeof(POINTER_SYSTEM_UPDATE));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, pointerSystem, sizeof(POINTER_SYSTEM_UPDATE));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PointerUpdate, PointerSystem), (void*) wParam, NULL);
 }
 
@@ -1163,7 +1559,7 @@ static BOOL update_message_PointerColor(rdpContext* context, POINTER_COLOR_UPDAT
 {
 	POINTER_COLOR_UPDATE* wParam;
 
-	wParam = (POINTER_COLOR_UPDATE*) malloc(sizeof(POINTER_COLOR_UPDATE));
+	wParam = (POINTER_COLOR_UPDATE*) update_message_alloc(context, sizeof(POINTER_COLOR_UPDATE));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, pointerColor, sizeof(POINTER_COLOR_UPDATE));
@@ -1172,7 +1568,7 @@ static BOOL update_message_PointerColor(rdpContext* context, POINTER_COLOR_UPDAT
 
 	if (wParam->lengthAndMask)
 	{
-		wParam->andMaskData = (BYTE*) malloc(wParam->lengthAndMask);
+		wParam->andMaskData = (BYTE*) update_message_alloc(context, wParam->lengthAndMask);
 		if (!wParam->andMaskData)
 			goto out_fail;
 		CopyMemory(wParam->andMaskData, pointerColor->andMaskData, wParam->lengthAndMask);
@@ -1180,19 +1576,19 @@ static BOOL update_message_PointerColor(rdpContext* context, POINTER_COLOR_UPDAT
 
 	if (wParam->lengthXorMask)
 	{
-		wParam->xorMaskData = (BYTE*) malloc(wParam->lengthXorMask);
+		wParam->xorMaskData = (BYTE*) update_message_alloc(context, wParam->lengthXorMask);
 		if (!wParam->xorMaskData)
 			goto out_fail;
 		CopyMemory(wParam->xorMaskData, pointerColor->xorMaskData, wParam->lengthXorMask);
 	}
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PointerUpdate, PointerColor), (void*) wParam, NULL);
 
 out_fail:
-	free(wParam->andMaskData);
-	free(wParam->xorMaskData);
-	free(wParam);
+	update_message_discard(context, wParam->andMaskData);
+	update_message_discard(context, wParam->xorMaskData);
+	update_message_discard(context, wParam);
 	return FALSE;
 }
 
@@ -1200,7 +1596,7 @@ static BOOL update_message_PointerNew(rdpContext* context, POINTER_NEW_UPDATE* p
 {
 	POINTER_NEW_UPDATE* wParam;
 
-	wParam = (POINTER_NEW_UPDATE*) malloc(sizeof(POINTER_NEW_UPDATE));
+	wParam = (POINTER_NEW_UPDATE*) update_message_alloc(context, sizeof(POINTER_NEW_UPDATE));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, pointerNew, sizeof(POINTER_NEW_UPDATE));
@@ -1209,7 +1605,7 @@ static BOOL update_message_PointerNew(rdpContext* context, POINTER_NEW_UPDATE* p
 
 	if (wParam->colorPtrAttr.lengthAndMask)
 	{
-		wParam->colorPtrAttr.andMaskData = (BYTE*) malloc(wParam->colorPtrAttr.lengthAndMask);
+		wParam->colorPtrAttr.andMaskData = (BYTE*) update_message_alloc(context, wParam->colorPtrAttr.lengthAndMask);
 		if (!wParam->colorPtrAttr.andMaskData)
 			goto out_fail;
 		CopyMemory(wParam->colorPtrAttr.andMaskData, pointerNew->colorPtrAttr.andMaskData, wParam->colorPtrAttr.lengthAndMask);
@@ -1217,19 +1613,19 @@ static BOOL update_message_PointerNew(rdpContext* context, POINTER_NEW_UPDATE* p
 
 	if (wParam->colorPtrAttr.lengthXorMask)
 	{
-		wParam->colorPtrAttr.xorMaskData = (BYTE*) malloc(wParam->colorPtrAttr.lengthXorMask);
+		wParam->colorPtrAttr.xorMaskData = (BYTE*) update_message_alloc(context, wParam->colorPtrAttr.lengthXorMask);
 		if (!wParam->colorPtrAttr.xorMaskData)
 			goto out_fail;
 		CopyMemory(wParam->colorPtrAttr.xorMaskData, pointerNew->colorPtrAttr.xorMaskData, wParam->colorPtrAttr.lengthXorMask);
 	}
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PointerUpdate, PointerNew), (void*) wParam, NULL);
 
 out_fail:
-	free(wParam->colorPtrAttr.andMaskData);
-	free(wParam->colorPtrAttr.xorMaskData);
-	free(wParam);
+	update_message_discard(context, wParam->colorPtrAttr.andMaskData);
+	update_message_discard(context, wParam->colorPtrAttr.xorMaskData);
+	update_message_discard(context, wParam);
 	return FALSE;
 }
 
@@ -1237,12 +1633,12 @@ static BOOL update_message_PointerCached(rdpContext* context, POINTER_CACHED_UPD
 {
 	POINTER_CACHED_UPDATE* wParam;
 
-	wParam = (POINTER_CACHED_UPDATE*) malloc(sizeof(POINTER_CACHED_UPDATE));
+	wParam = (POINTER_CACHED_UPDATE*) update_message_alloc(context, sizeof(POINTER_CACHED_UPDATE));
 	if (!wParam)
 		return FALSE;
 	CopyMemory(wParam, pointerCached, sizeof(POINTER_CACHED_UPDATE));
 
-	return MessageQueue_Post(context->update->queue, (void*) context,
+	return update_message_post(context,
 			MakeMessageId(PointerUpdate, PointerCached), (void*) wParam, NULL);
 }
 
@@ -1318,6 +1714,7 @@ static int update_message_free_update_class(wMessage* msg, int type)
 				rdpContext* context = (rdpContext*) msg->context;
 				SURFACE_BITS_COMMAND* wParam = (SURFACE_BITS_COMMAND*) msg->wParam;
 				StreamPool_Release(context->rdp->transport->ReceivePool, wParam->bitmapData);
+				free(wParam);
 #else
 				SURFACE_BITS_COMMAND* wParam = (SURFACE_BITS_COMMAND*) msg->wParam;
 				free(wParam->bitmapData);
@@ -2193,6 +2590,23 @@ static int update_message_process_class(rdpUpdateProxy* proxy, wMessage* msg, in
 	return status;
 }
 
+static int update_message_process_frame(rdpUpdate* update, wMessage* message)
+{
+	int index;
+	wMessage* msg;
+	rdpUpdateFrame* frame = (rdpUpdateFrame*) message->wParam;
+
+	for (index = 0; index < frame->count; index++)
+	{
+		msg = &(frame->messages[index].message);
+		update_message_process_class(update->proxy, msg, GetMessageClass(msg->id), GetMessageType(msg->id));
+	}
+
+	update_message_frame_release(update->proxy, frame);
+
+	return 1;
+}
+
 int update_message_queue_process_message(rdpUpdate* update, wMessage* message)
 {
 	int status;
@@ -2202,6 +2616,9 @@ int update_message_queue_process_message(rdpUpdate* update, wMessage* message)
 	if (message->id == WMQ_QUIT)
 		return 0;
 
+	if (message->id == MakeMessageId(Update, Frame))
+		return update_message_process_frame(update, message);
+
 	msgClass = GetMessageClass(message->id);
 	msgType = GetMessageType(message->id);
 
@@ -2225,6 +2642,13 @@ int update_message_queue_free_message(wMessage *message)
 	if (message->id == WMQ_QUIT)
 		return 0;
 
+	if (message->id == MakeMessageId(Update, Frame))
+	{
+		rdpContext* context = (rdpContext*) message->context;
+		update_message_frame_release(context->update->proxy, (rdpUpdateFrame*) message->wParam);
+		return 1;
+	}
+
 	msgClass = GetMessageClass(message->id);
 	msgType = GetMessageType(message->id);
 
@@ -2490,6 +2914,14 @@ void update_message_proxy_free(rdpUpdateProxy* message)
 		if (MessageQueue_PostQuit(message->update->queue, 0))
 			WaitForSingleObject(message->thread, INFINITE);
 		CloseHandle(message->thread);
+
+		if (message->frame)
+		{
+			update_frame_reset(message->frame);
+			update_frame_free(message->frame);
+		}
+
+		update_frame_free(message->spareFrame);
 		free(message);
 	}
 }
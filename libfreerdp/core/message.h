@@ -29,6 +29,11 @@
 
 /* Update Proxy Interface */
 
+/* messages recorded between BeginPaint and EndPaint, posted as one */
+#define Update_Frame						16
+
+typedef struct rdp_update_frame rdpUpdateFrame;
+
 struct rdp_update_proxy
 {
 	rdpUpdate* update;
@@ -123,6 +128,10 @@ struct rdp_update_proxy
 	pPointerCached PointerCached;
 
 	HANDLE thread;
+
+	rdpUpdateFrame* frame;
+	DWORD frameThreadId;
+	rdpUpdateFrame* spareFrame;
 };
 
 int update_message_queue_process_message(rdpUpdate* update, wMessage* message);
@@ -1218,6 +1218,15 @@ int rdp_recv_callback(rdpTransport* transport, wStream* s, void* extra)
 	int status = 0;
 	rdpRdp* rdp = (rdpRdp*) extra;
 
+	if (rdp->record && (rdp->state >= CONNECTION_STATE_CAPABILITIES_EXCHANGE))
+	{
+		if (record_write_pdu(rdp->record, s) < 0)
+		{
+			record_free(rdp->record);
+			rdp->record = NULL;
+		}
+	}
+
 	/* 
 	 * At any point in the connection sequence between when all
 	 * MCS channels have been joined and when the RDP connection
@@ -1278,7 +1287,15 @@ int rdp_recv_callback(rdpTransport* transport, wStream* s, void* extra)
 				return -1;
 			}
 
-			if (!mcs_send_channel_join_request(rdp->mcs, rdp->mcs->userId))
+			if (rdp->settings->PipelineChannelJoin)
+			{
+				if (!rdp_client_send_channel_join_requests(rdp))
+				{
+					WLog_ERR(TAG, "rdp_client_send_channel_join_requests failure");
+					return -1;
+				}
+			}
+			else if (!mcs_send_channel_join_request(rdp->mcs, rdp->mcs->userId))
 			{
 				WLog_ERR(TAG, "mcs_send_channel_join_request failure");
 				return -1;
@@ -1600,6 +1617,7 @@ void rdp_free(rdpRdp* rdp)
 		redirection_free(rdp->redirection);
 		autodetect_free(rdp->autodetect);
 		heartbeat_free(rdp->heartbeat);
+		record_free(rdp->record);
 		multitransport_free(rdp->multitransport);
 		bulk_free(rdp->bulk);
 		free(rdp);
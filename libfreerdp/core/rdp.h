@@ -38,6 +38,7 @@
 #include "errinfo.h"
 #include "autodetect.h"
 #include "heartbeat.h"
+#include "record.h"
 #include "multitransport.h"
 #include "security.h"
 #include "transport.h"
@@ -146,6 +147,7 @@ struct rdp_rdp
 	rdpTransport* transport;
 	rdpAutoDetect* autodetect;
 	rdpHeartbeat* heartbeat;
+	rdpRecord* record;
 	rdpMultitransport* multitransport;
 	struct crypto_rc4_struct* rc4_decrypt_key;
 	int decrypt_use_count;
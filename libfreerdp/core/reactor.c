@@ -0,0 +1,524 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * RDP Server Peer Reactor
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/sysinfo.h>
+#include <winpr/collections.h>
+
+#include <freerdp/log.h>
+#include <freerdp/reactor.h>
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <unistd.h>
+#include <sys/epoll.h>
+#endif
+
+#define TAG FREERDP_TAG("core.reactor")
+
+#ifdef HAVE_SYS_EPOLL_H
+
+#define REACTOR_MAX_EVENTS	256
+#define REACTOR_MSG_CHECK	1
+
+typedef struct rdp_reactor_peer rdpReactorPeer;
+
+struct rdp_reactor_peer
+{
+	freerdp_peer* client;
+	psReactorPeerCheck check;
+	psReactorPeerClosed closed;
+
+	DWORD count;
+	int fds[FREERDP_REACTOR_MAX_PEER_HANDLES];
+
+	/* protected by the reactor lock */
+	BOOL scheduled;
+	BOOL pending;
+	BOOL removed;
+	rdpReactorPeer* prev;
+	rdpReactorPeer* next;
+};
+
+struct rdp_freerdp_reactor
+{
+	int epfd;
+	HANDLE thread;
+	HANDLE stopEvent;
+	DWORD workerCount;
+	HANDLE* workers;
+	wMessageQueue* queue;
+
+	CRITICAL_SECTION lock;
+	DWORD peerCount;
+	rdpReactorPeer* peers;
+	rdpReactorPeer* graveyard;
+};
+
+/**
+ * Peer handles are registered one-shot, so that a peer is handed to a single
+ * worker at a time. Every handle is re-armed once its check has returned.
+ * The file descriptors are duplicated since epoll does not allow the same
+ * descriptor twice in a set, and handles like a subsystem message queue may
+ * be shared by all peers.
+ */
+
+static BOOL reactor_peer_arm(freerdp_reactor* reactor, rdpReactorPeer* peer, int op)
+{
+	DWORD index;
+	struct epoll_event event;
+
+	for (index = 0; index < peer->count; index++)
+	{
+		ZeroMemory(&event, sizeof(event));
+		event.events = EPOLLIN | EPOLLONESHOT;
+		event.data.ptr = peer;
+
+		if (epoll_ctl(reactor->epfd, op, peer->fds[index], &event) < 0)
+		{
+			WLog_ERR(TAG, "epoll_ctl failed (errno: %d)", errno);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static void reactor_peer_unregister(freerdp_reactor* reactor, rdpReactorPeer* peer)
+{
+	DWORD index;
+
+	for (index = 0; index < peer->count; index++)
+	{
+		epoll_ctl(reactor->epfd, EPOLL_CTL_DEL, peer->fds[index], NULL);
+		close(peer->fds[index]);
+	}
+
+	peer->count = 0;
+
+	/**
+	 * The dispatcher may still hold an event referring to this peer from
+	 * its last epoll_wait, so the peer is only freed by the dispatcher.
+	 */
+	EnterCriticalSection(&reactor->lock);
+
+	if (peer->prev)
+		peer->prev->next = peer->next;
+	else
+		reactor->peers = peer->next;
+
+	if (peer->next)
+		peer->next->prev = peer->prev;
+
+	peer->removed = TRUE;
+	peer->prev = NULL;
+	peer->next = reactor->graveyard;
+	reactor->graveyard = peer;
+
+	LeaveCriticalSection(&reactor->lock);
+}
+
+static void reactor_peer_release(freerdp_reactor* reactor)
+{
+	EnterCriticalSection(&reactor->lock);
+	reactor->peerCount--;
+	LeaveCriticalSection(&reactor->lock);
+}
+
+static void reactor_peer_remove(freerdp_reactor* reactor, rdpReactorPeer* peer)
+{
+	freerdp_peer* client = peer->client;
+	psReactorPeerClosed closed = peer->closed;
+
+	reactor_peer_unregister(reactor, peer);
+
+	IFCALL(closed, client);
+
+	/* a peer is counted until its closed callback has returned */
+	reactor_peer_release(reactor);
+}
+
+static void reactor_peer_reschedule(freerdp_reactor* reactor, rdpReactorPeer* peer)
+{
+	BOOL post = FALSE;
+
+	EnterCriticalSection(&reactor->lock);
+
+	if (peer->pending)
+	{
+		peer->pending = FALSE;
+		post = TRUE;
+	}
+	else
+	{
+		peer->scheduled = FALSE;
+	}
+
+	LeaveCriticalSection(&reactor->lock);
+
+	if (post)
+		MessageQueue_Post(reactor->queue, NULL, REACTOR_MSG_CHECK, (void*) peer, NULL);
+}
+
+static void reactor_free_graveyard(freerdp_reactor* reactor)
+{
+	rdpReactorPeer* peer;
+	rdpReactorPeer* next;
+
+	EnterCriticalSection(&reactor->lock);
+	peer = reactor->graveyard;
+	reactor->graveyard = NULL;
+	LeaveCriticalSection(&reactor->lock);
+
+	while (peer)
+	{
+		next = peer->next;
+		free(peer);
+		peer = next;
+	}
+}
+
+static void* reactor_dispatch_thread(freerdp_reactor* reactor)
+{
+	int index;
+	int status;
+	BOOL post;
+	rdpReactorPeer* peer;
+	struct epoll_event events[REACTOR_MAX_EVENTS];
+
+	while (1)
+	{
+		reactor_free_graveyard(reactor);
+
+		status = epoll_wait(reactor->epfd, events, REACTOR_MAX_EVENTS, -1);
+
+		if (status < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			WLog_ERR(TAG, "epoll_wait failed (errno: %d)", errno);
+			break;
+		}
+
+		for (index = 0; index < status; index++)
+		{
+			peer = (rdpReactorPeer*) events[index].data.ptr;
+
+			/* the stop event is the only handle registered without a peer */
+			if (!peer)
+				goto out;
+
+			post = FALSE;
+
+			EnterCriticalSection(&reactor->lock);
+
+			if (!peer->removed)
+			{
+				if (peer->scheduled)
+				{
+					peer->pending = TRUE;
+				}
+				else
+				{
+					peer->scheduled = TRUE;
+					post = TRUE;
+				}
+			}
+
+			LeaveCriticalSection(&reactor->lock);
+
+			if (post)
+				MessageQueue_Post(reactor->queue, NULL, REACTOR_MSG_CHECK, (void*) peer, NULL);
+		}
+	}
+
+out:
+	ExitThread(0);
+	return NULL;
+}
+
+static void* reactor_worker_thread(freerdp_reactor* reactor)
+{
+	BOOL status;
+	wMessage message;
+	rdpReactorPeer* peer;
+	freerdp_peer* client;
+
+	while (MessageQueue_Wait(reactor->queue))
+	{
+		if (!MessageQueue_Peek(reactor->queue, &message, TRUE))
+			continue;
+
+		if (message.id == WMQ_QUIT)
+			break;
+
+		peer = (rdpReactorPeer*) message.wParam;
+		client = peer->client;
+
+		if (peer->check)
+			status = peer->check(client);
+		else
+			status = client->CheckFileDescriptor(client);
+
+		if (status)
+			status = reactor_peer_arm(reactor, peer, EPOLL_CTL_MOD);
+
+		if (!status)
+		{
+			reactor_peer_remove(reactor, peer);
+			continue;
+		}
+
+		reactor_peer_reschedule(reactor, peer);
+	}
+
+	ExitThread(0);
+	return NULL;
+}
+
+freerdp_reactor* freerdp_reactor_new(DWORD workers)
+{
+	DWORD index;
+	int stopfd;
+	SYSTEM_INFO sysinfo;
+	struct epoll_event event;
+	freerdp_reactor* reactor;
+
+	reactor = (freerdp_reactor*) calloc(1, sizeof(freerdp_reactor));
+
+	if (!reactor)
+		return NULL;
+
+	reactor->epfd = -1;
+
+	if (!InitializeCriticalSectionAndSpinCount(&reactor->lock, 4000))
+	{
+		free(reactor);
+		return NULL;
+	}
+
+	if (!workers)
+	{
+		GetSystemInfo(&sysinfo);
+		workers = sysinfo.dwNumberOfProcessors;
+
+		if (workers < 2)
+			workers = 2;
+	}
+
+	reactor->epfd = epoll_create1(EPOLL_CLOEXEC);
+
+	if (reactor->epfd < 0)
+		goto fail;
+
+	if (!(reactor->stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL)))
+		goto fail;
+
+	stopfd = GetEventFileDescriptor(reactor->stopEvent);
+	ZeroMemory(&event, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = NULL;
+
+	if (epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, stopfd, &event) < 0)
+		goto fail;
+
+	if (!(reactor->queue = MessageQueue_New(NULL)))
+		goto fail;
+
+	if (!(reactor->workers = (HANDLE*) calloc(workers, sizeof(HANDLE))))
+		goto fail;
+
+	for (index = 0; index < workers; index++)
+	{
+		reactor->workers[index] = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)
+				reactor_worker_thread, (void*) reactor, 0, NULL);
+
+		if (!reactor->workers[index])
+			goto fail;
+
+		reactor->workerCount++;
+	}
+
+	if (!(reactor->thread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)
+			reactor_dispatch_thread, (void*) reactor, 0, NULL)))
+		goto fail;
+
+	WLog_DBG(TAG, "reactor started with %d workers", workers);
+
+	return reactor;
+
+fail:
+	WLog_ERR(TAG, "failed to create reactor");
+	freerdp_reactor_free(reactor);
+	return NULL;
+}
+
+void freerdp_reactor_free(freerdp_reactor* reactor)
+{
+	DWORD index;
+
+	if (!reactor)
+		return;
+
+	if (reactor->thread)
+	{
+		SetEvent(reactor->stopEvent);
+		WaitForSingleObject(reactor->thread, INFINITE);
+		CloseHandle(reactor->thread);
+	}
+
+	/* peers still queued are checked a last time before the workers quit */
+	for (index = 0; index < reactor->workerCount; index++)
+		MessageQueue_PostQuit(reactor->queue, 0);
+
+	for (index = 0; index < reactor->workerCount; index++)
+	{
+		WaitForSingleObject(reactor->workers[index], INFINITE);
+		CloseHandle(reactor->workers[index]);
+	}
+
+	free(reactor->workers);
+
+	while (reactor->peers)
+		reactor_peer_remove(reactor, reactor->peers);
+
+	reactor_free_graveyard(reactor);
+
+	if (reactor->queue)
+		MessageQueue_Free(reactor->queue);
+
+	if (reactor->stopEvent)
+		CloseHandle(reactor->stopEvent);
+
+	if (reactor->epfd >= 0)
+		close(reactor->epfd);
+
+	DeleteCriticalSection(&reactor->lock);
+
+	free(reactor);
+}
+
+BOOL freerdp_reactor_add_peer(freerdp_reactor* reactor, freerdp_peer* client,
+		HANDLE* events, DWORD nCount, psReactorPeerCheck check, psReactorPeerClosed closed)
+{
+	int fd;
+	DWORD index;
+	rdpReactorPeer* peer;
+
+	if (!reactor || !client || !events || !nCount)
+		return FALSE;
+
+	if (nCount > FREERDP_REACTOR_MAX_PEER_HANDLES)
+		return FALSE;
+
+	peer = (rdpReactorPeer*) calloc(1, sizeof(rdpReactorPeer));
+
+	if (!peer)
+		return FALSE;
+
+	peer->client = client;
+	peer->check = check;
+	peer->closed = closed;
+
+	for (index = 0; index < nCount; index++)
+	{
+		fd = (int)(ULONG_PTR) GetEventWaitObject(events[index]);
+
+		if ((fd < 0) || ((fd = dup(fd)) < 0))
+		{
+			while (peer->count > 0)
+				close(peer->fds[--peer->count]);
+
+			free(peer);
+			return FALSE;
+		}
+
+		peer->fds[peer->count++] = fd;
+	}
+
+	/* keep the peer scheduled until all of its handles are registered */
+	peer->scheduled = TRUE;
+
+	EnterCriticalSection(&reactor->lock);
+	peer->next = reactor->peers;
+
+	if (reactor->peers)
+		reactor->peers->prev = peer;
+
+	reactor->peers = peer;
+	reactor->peerCount++;
+	LeaveCriticalSection(&reactor->lock);
+
+	if (!reactor_peer_arm(reactor, peer, EPOLL_CTL_ADD))
+	{
+		reactor_peer_unregister(reactor, peer);
+		reactor_peer_release(reactor);
+		return FALSE;
+	}
+
+	reactor_peer_reschedule(reactor, peer);
+
+	return TRUE;
+}
+
+DWORD freerdp_reactor_get_peer_count(freerdp_reactor* reactor)
+{
+	DWORD count;
+
+	if (!reactor)
+		return 0;
+
+	EnterCriticalSection(&reactor->lock);
+	count = reactor->peerCount;
+	LeaveCriticalSection(&reactor->lock);
+
+	return count;
+}
+
+#else
+
+freerdp_reactor* freerdp_reactor_new(DWORD workers)
+{
+	WLog_WARN(TAG, "reactor mode is not supported on this platform");
+	return NULL;
+}
+
+void freerdp_reactor_free(freerdp_reactor* reactor)
+{
+
+}
+
+BOOL freerdp_reactor_add_peer(freerdp_reactor* reactor, freerdp_peer* client,
+		HANDLE* events, DWORD nCount, psReactorPeerCheck check, psReactorPeerClosed closed)
+{
+	return FALSE;
+}
+
+DWORD freerdp_reactor_get_peer_count(freerdp_reactor* reactor)
+{
+	return 0;
+}
+
+#endif
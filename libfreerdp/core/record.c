@@ -0,0 +1,321 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Session Recording and Replay
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <winpr/crt.h>
+
+#include "record.h"
+
+/**
+ * A session recording is a pcap file of the PDUs received by the client,
+ * starting with the Demand Active PDU. The transport has already removed
+ * the TLS layer, so the records are the tpkt and fast-path PDUs as they are
+ * handed to rdp_recv_callback, static and dynamic virtual channel data
+ * included. The first record is a header describing the connection state
+ * the recording depends upon:
+ *
+ * magic (4 bytes), version (4 bytes)
+ * DesktopWidth (4 bytes), DesktopHeight (4 bytes), ColorDepth (4 bytes)
+ * userId (2 bytes), messageChannelId (2 bytes)
+ * channelCount (4 bytes), followed by channelCount entries of
+ * Name (8 bytes), ChannelId (2 bytes), joined (2 bytes)
+ */
+
+static int record_write_header(rdpRecord* record)
+{
+	UINT32 index;
+	wStream* s;
+	rdpMcs* mcs = record->rdp->mcs;
+	rdpSettings* settings = record->rdp->settings;
+
+	s = Stream_New(NULL, 32 + (mcs->channelCount * 12));
+
+	if (!s)
+		return -1;
+
+	Stream_Write_UINT32(s, RECORD_MAGIC); /* magic (4 bytes) */
+	Stream_Write_UINT32(s, RECORD_VERSION); /* version (4 bytes) */
+	Stream_Write_UINT32(s, settings->DesktopWidth); /* DesktopWidth (4 bytes) */
+	Stream_Write_UINT32(s, settings->DesktopHeight); /* DesktopHeight (4 bytes) */
+	Stream_Write_UINT32(s, settings->ColorDepth); /* ColorDepth (4 bytes) */
+	Stream_Write_UINT16(s, mcs->userId); /* userId (2 bytes) */
+	Stream_Write_UINT16(s, mcs->messageChannelId); /* messageChannelId (2 bytes) */
+	Stream_Write_UINT32(s, mcs->channelCount); /* channelCount (4 bytes) */
+
+	for (index = 0; index < mcs->channelCount; index++)
+	{
+		Stream_Write(s, mcs->channels[index].Name, 8); /* Name (8 bytes) */
+		Stream_Write_UINT16(s, mcs->channels[index].ChannelId); /* ChannelId (2 bytes) */
+		Stream_Write_UINT16(s, mcs->channels[index].joined); /* joined (2 bytes) */
+	}
+
+	pcap_add_record(record->pcap, Stream_Buffer(s), Stream_GetPosition(s));
+	pcap_flush(record->pcap);
+
+	Stream_Free(s, TRUE);
+	return 1;
+}
+
+static BOOL record_read_header(rdpRecord* record, wStream* s)
+{
+	UINT32 index;
+	UINT32 found;
+	UINT32 magic;
+	UINT32 version;
+	UINT32 channelCount;
+	UINT16 channelId;
+	UINT16 joined;
+	char name[8];
+	rdpMcsChannel* channel;
+	rdpMcs* mcs = record->rdp->mcs;
+	rdpSettings* settings = record->rdp->settings;
+
+	if (Stream_GetRemainingLength(s) < 28)
+		return FALSE;
+
+	Stream_Read_UINT32(s, magic); /* magic (4 bytes) */
+	Stream_Read_UINT32(s, version); /* version (4 bytes) */
+
+	if ((magic != RECORD_MAGIC) || (version != RECORD_VERSION))
+	{
+		WLog_ERR(RECORD_TAG, "%s is not a session recording", record->pcap->name);
+		return FALSE;
+	}
+
+	Stream_Read_UINT32(s, settings->DesktopWidth); /* DesktopWidth (4 bytes) */
+	Stream_Read_UINT32(s, settings->DesktopHeight); /* DesktopHeight (4 bytes) */
+	Stream_Read_UINT32(s, settings->ColorDepth); /* ColorDepth (4 bytes) */
+	Stream_Read_UINT16(s, mcs->userId); /* userId (2 bytes) */
+	Stream_Read_UINT16(s, mcs->messageChannelId); /* messageChannelId (2 bytes) */
+	Stream_Read_UINT32(s, channelCount); /* channelCount (4 bytes) */
+
+	if (channelCount > (Stream_GetRemainingLength(s) / 12))
+		return FALSE;
+
+	/**
+	 * The replaying client has its own set of static channels,
+	 * recorded channels are matched to them by name.
+	 */
+
+	mcs_initialize_client_channels(mcs, settings);
+
+	for (index = 0; index < channelCount; index++)
+	{
+		Stream_Read(s, name, 8); /* Name (8 bytes) */
+		Stream_Read_UINT16(s, channelId); /* ChannelId (2 bytes) */
+		Stream_Read_UINT16(s, joined); /* joined (2 bytes) */
+
+		channel = NULL;
+
+		for (found = 0; found < mcs->channelCount; found++)
+		{
+			if (strncmp(mcs->channels[found].Name, name, 8) == 0)
+			{
+				channel = &mcs->channels[found];
+				break;
+			}
+		}
+
+		if (!channel)
+		{
+			WLog_WARN(RECORD_TAG, "recorded channel %.8s is not loaded, its data will be ignored", name);
+			continue;
+		}
+
+		channel->ChannelId = channelId;
+		channel->joined = joined ? TRUE : FALSE;
+	}
+
+	mcs->userChannelJoined = TRUE;
+	mcs->globalChannelJoined = TRUE;
+	mcs->messageChannelJoined = mcs->messageChannelId ? TRUE : FALSE;
+
+	return TRUE;
+}
+
+int record_write_pdu(rdpRecord* record, wStream* s)
+{
+	if (!record->write || !record->pcap)
+		return 0;
+
+	if (!record->started)
+	{
+		/* standard RDP security decrypts in place after this point */
+		if (record->rdp->do_crypt)
+		{
+			WLog_ERR(RECORD_TAG, "sessions using standard RDP security cannot be recorded, use TLS or NLA");
+			pcap_close(record->pcap);
+			record->pcap = NULL;
+			return -1;
+		}
+
+		if (record_write_header(record) < 0)
+			return -1;
+
+		record->started = TRUE;
+	}
+
+	pcap_add_record(record->pcap, Stream_Buffer(s), Stream_Length(s));
+	pcap_flush(record->pcap);
+	record->count++;
+
+	return 1;
+}
+
+/**
+ * Feeds the next recorded PDU through rdp_recv_callback.
+ * @return 1 if a PDU was replayed, 0 at the end of the recording, -1 on failure
+ */
+
+int record_replay_pdu(rdpRecord* record)
+{
+	int status;
+	wStream* s;
+	pcap_record pcapRecord;
+	rdpRdp* rdp = record->rdp;
+
+	if (record->write || !record->pcap)
+		return -1;
+
+	if (!pcap_has_next_record(record->pcap))
+		return 0;
+
+	if (!pcap_get_next_record_header(record->pcap, &pcapRecord))
+		return 0;
+
+	if (!(s = StreamPool_Take(rdp->transport->ReceivePool, pcapRecord.length)))
+		return -1;
+
+	pcapRecord.data = Stream_Buffer(s);
+	pcap_get_next_record_content(record->pcap, &pcapRecord);
+	Stream_SetLength(s, pcapRecord.length);
+	Stream_SetPosition(s, 0);
+
+	status = rdp_recv_callback(rdp->transport, s, rdp);
+	Stream_Release(s);
+
+	if (status < 0)
+	{
+		WLog_ERR(RECORD_TAG, "replay of PDU %d failed", record->count);
+		return -1;
+	}
+
+	record->count++;
+	return 1;
+}
+
+/**
+ * Stands in for rdp_client_connect: the recorded connection state is
+ * restored, outgoing PDUs are discarded and the recorded capabilities
+ * exchange and connection finalization are replayed up to the active state.
+ */
+
+BOOL record_replay_connect(rdpRecord* record)
+{
+	BOOL status;
+	wStream* s;
+	pcap_record pcapRecord;
+	rdpRdp* rdp = record->rdp;
+	rdpTransport* transport = rdp->transport;
+
+	if (record->write || !record->pcap)
+		return FALSE;
+
+	if (!pcap_get_next_record_header(record->pcap, &pcapRecord))
+	{
+		WLog_ERR(RECORD_TAG, "%s is empty", record->pcap->name);
+		return FALSE;
+	}
+
+	if (!(s = Stream_New(NULL, pcapRecord.length)))
+		return FALSE;
+
+	pcapRecord.data = Stream_Buffer(s);
+	pcap_get_next_record_content(record->pcap, &pcapRecord);
+	Stream_SetLength(s, pcapRecord.length);
+
+	status = record_read_header(record, s);
+	Stream_Free(s, TRUE);
+
+	if (!status)
+		return FALSE;
+
+	/* channels are told the name of the server they are connected to */
+	if (!rdp->settings->ServerHostname)
+	{
+		if (!(rdp->settings->ServerHostname = _strdup(record->pcap->name)))
+			return FALSE;
+	}
+
+	transport->layer = TRANSPORT_LAYER_TCP;
+	transport->frontBio = BIO_new(BIO_s_null());
+
+	if (!transport->frontBio)
+		return FALSE;
+
+	transport->ReceiveCallback = rdp_recv_callback;
+	transport->ReceiveExtra = rdp;
+
+	rdp_client_transition_to_state(rdp, CONNECTION_STATE_CAPABILITIES_EXCHANGE);
+
+	while (rdp->state != CONNECTION_STATE_ACTIVE)
+	{
+		if (record_replay_pdu(record) <= 0)
+		{
+			WLog_ERR(RECORD_TAG, "%s ended before the connection was activated", record->pcap->name);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+rdpRecord* record_new(rdpRdp* rdp, char* name, BOOL write)
+{
+	rdpRecord* record;
+
+	record = (rdpRecord*) calloc(1, sizeof(rdpRecord));
+
+	if (!record)
+		return NULL;
+
+	record->rdp = rdp;
+	record->write = write;
+	record->pcap = pcap_open(name, write);
+
+	if (!record->pcap)
+	{
+		free(record);
+		return NULL;
+	}
+
+	return record;
+}
+
+void record_free(rdpRecord* record)
+{
+	if (!record)
+		return;
+
+	if (record->pcap)
+		pcap_close(record->pcap);
+
+	free(record);
+}
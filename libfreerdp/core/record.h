@@ -0,0 +1,53 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Session Recording and Replay
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __RECORD_H
+#define __RECORD_H
+
+typedef struct rdp_record rdpRecord;
+
+#include "rdp.h"
+
+#include <freerdp/freerdp.h>
+#include <freerdp/log.h>
+#include <freerdp/utils/pcap.h>
+
+#include <winpr/stream.h>
+
+#define RECORD_MAGIC		0x52535246 /* "FRSR" */
+#define RECORD_VERSION		1
+
+struct rdp_record
+{
+	rdpRdp* rdp;
+	rdpPcap* pcap;
+	BOOL write;
+	BOOL started;
+	UINT32 count;
+};
+
+int record_write_pdu(rdpRecord* record, wStream* s);
+
+BOOL record_replay_connect(rdpRecord* record);
+int record_replay_pdu(rdpRecord* record);
+
+rdpRecord* record_new(rdpRdp* rdp, char* name, BOOL write);
+void record_free(rdpRecord* record);
+
+#define RECORD_TAG FREERDP_TAG("core.record")
+
+#endif /* __RECORD_H */
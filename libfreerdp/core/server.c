@@ -151,6 +151,7 @@ static BOOL wts_read_drdynvc_capabilities_response(rdpPeerChannel* channel, UINT
 
 	DEBUG_DVC("Version: %d", Version);
 
+	channel->vcm->drdynvc_version = Version;
 	channel->vcm->drdynvc_state = DRDYNVC_STATE_READY;
 	return TRUE;
 }
@@ -177,9 +178,36 @@ static BOOL wts_read_drdynvc_create_response(rdpPeerChannel* channel, wStream* s
 	return TRUE;
 }
 
-static BOOL wts_read_drdynvc_data_first(rdpPeerChannel* channel, wStream* s, int cbLen, UINT32 length)
+static BOOL wts_decompress_drdynvc_data(WTSVirtualChannelManager* vcm, UINT32 ChannelId,
+		wStream* s, BYTE** data, UINT32* length)
+{
+	/**
+	 * All compressed PDUs of the connection go through one RDP8 bulk
+	 * history, created with the first of them, whatever their channel.
+	 */
+	if (!vcm->zgfx_decompressor)
+	{
+		vcm->zgfx_decompressor = zgfx_context_new(FALSE);
+
+		if (!vcm->zgfx_decompressor)
+			return FALSE;
+	}
+
+	if (zgfx_decompress_segment(vcm->zgfx_decompressor, Stream_Pointer(s), *length) < 0)
+	{
+		WLog_ERR(TAG, "ChannelId %d decompression failed", ChannelId);
+		return FALSE;
+	}
+
+	*data = vcm->zgfx_decompressor->OutputBuffer;
+	*length = vcm->zgfx_decompressor->OutputCount;
+	return TRUE;
+}
+
+static BOOL wts_read_drdynvc_data_first(rdpPeerChannel* channel, wStream* s, int cbLen, UINT32 length, BOOL compressed)
 {
 	int value;
+	BYTE* data;
 
 	value = wts_read_variable_uint(s, cbLen, &channel->dvc_total_length);
 
@@ -187,6 +215,10 @@ static BOOL wts_read_drdynvc_data_first(rdpPeerChannel* channel, wStream* s, int
 		return FALSE;
 
 	length -= value;
+	data = Stream_Pointer(s);
+
+	if (compressed && !wts_decompress_drdynvc_data(channel->vcm, channel->channelId, s, &data, &length))
+		return FALSE;
 
 	if (length > channel->dvc_total_length)
 		return FALSE;
@@ -194,13 +226,20 @@ static BOOL wts_read_drdynvc_data_first(rdpPeerChannel* channel, wStream* s, int
 	Stream_SetPosition(channel->receiveData, 0);
 	if (!Stream_EnsureRemainingCapacity(channel->receiveData, (int) channel->dvc_total_length))
 		return FALSE;
-	Stream_Write(channel->receiveData, Stream_Pointer(s), length);
+	Stream_Write(channel->receiveData, data, length);
 	return TRUE;
 }
 
-static BOOL wts_read_drdynvc_data(rdpPeerChannel* channel, wStream* s, UINT32 length)
+static BOOL wts_read_drdynvc_data(rdpPeerChannel* channel, wStream* s, UINT32 length, BOOL compressed)
 {
-	BOOL ret;
+	BYTE* data;
+	BOOL ret = TRUE;
+
+	data = Stream_Pointer(s);
+
+	if (compressed && !wts_decompress_drdynvc_data(channel->vcm, channel->channelId, s, &data, &length))
+		return FALSE;
+
 	if (channel->dvc_total_length > 0)
 	{
 		if (Stream_GetPosition(channel->receiveData) + length > channel->dvc_total_length)
@@ -210,7 +249,7 @@ static BOOL wts_read_drdynvc_data(rdpPeerChannel* channel, wStream* s, UINT32 le
 			return FALSE;
 		}
 
-		Stream_Write(channel->receiveData, Stream_Pointer(s), length);
+		Stream_Write(channel->receiveData, data, length);
 
 		if (Stream_GetPosition(channel->receiveData) >= (int) channel->dvc_total_length)
 		{
@@ -220,7 +259,7 @@ static BOOL wts_read_drdynvc_data(rdpPeerChannel* channel, wStream* s, UINT32 le
 	}
 	else
 	{
-		ret = wts_queue_receive_data(channel, Stream_Pointer(s), length);
+		ret = wts_queue_receive_data(channel, data, length);
 	}
 	return ret;
 }
@@ -278,10 +317,16 @@ static BOOL wts_read_drdynvc_pdu(rdpPeerChannel* channel)
 					return wts_read_drdynvc_create_response(dvc, channel->receiveData, length);
 
 				case DATA_FIRST_PDU:
-					return wts_read_drdynvc_data_first(dvc, channel->receiveData, Sp, length);
+					return wts_read_drdynvc_data_first(dvc, channel->receiveData, Sp, length, FALSE);
 
 				case DATA_PDU:
-					return wts_read_drdynvc_data(dvc, channel->receiveData, length);
+					return wts_read_drdynvc_data(dvc, channel->receiveData, length, FALSE);
+
+				case DATA_FIRST_COMPRESSED_PDU:
+					return wts_read_drdynvc_data_first(dvc, channel->receiveData, Sp, length, TRUE);
+
+				case DATA_COMPRESSED_PDU:
+					return wts_read_drdynvc_data(dvc, channel->receiveData, length, TRUE);
 
 				case CLOSE_REQUEST_PDU:
 					wts_read_drdynvc_close_response(dvc);
@@ -295,6 +340,26 @@ static BOOL wts_read_drdynvc_pdu(rdpPeerChannel* channel)
 		else
 		{
 			DEBUG_DVC("ChannelId %d not exists.", ChannelId);
+
+			/* the data is dropped, but the shared bulk history must still see it */
+			if ((Cmd == DATA_FIRST_COMPRESSED_PDU) || (Cmd == DATA_COMPRESSED_PDU))
+			{
+				BYTE* data;
+
+				if (Cmd == DATA_FIRST_COMPRESSED_PDU)
+				{
+					UINT32 totalLength;
+
+					value = wts_read_variable_uint(channel->receiveData, Sp, &totalLength);
+
+					if (value == 0)
+						return FALSE;
+
+					length -= value;
+				}
+
+				return wts_decompress_drdynvc_data(channel->vcm, ChannelId, channel->receiveData, &data, &length);
+			}
 		}
 	}
 	else
@@ -442,7 +507,7 @@ BOOL WTSVirtualChannelManagerCheckFileDescriptor(HANDLE hServer)
 	wMessage message;
 	BOOL status = TRUE;
 	rdpPeerChannel* channel;
-	UINT32 dynvc_caps;
+	BYTE dynvc_caps[12];
 	WTSVirtualChannelManager* vcm = (WTSVirtualChannelManager*) hServer;
 
 	if ((vcm->drdynvc_state == DRDYNVC_STATE_NONE) && vcm->client->activated)
@@ -455,10 +520,23 @@ BOOL WTSVirtualChannelManagerCheckFileDescriptor(HANDLE hServer)
 		if (channel)
 		{
 			ULONG written;
+			wStream* s;
 
 			vcm->drdynvc_channel = channel;
-			dynvc_caps = 0x00010050; /* DYNVC_CAPS_VERSION1 (4 bytes) */
-			if (!WTSVirtualChannelWrite(channel, (PCHAR) &dynvc_caps, sizeof(dynvc_caps), &written))
+
+			/* DYNVC_CAPS_VERSION3, which adds the compressed data PDUs */
+			s = Stream_New(dynvc_caps, sizeof(dynvc_caps));
+			if (!s)
+				return FALSE;
+			Stream_Write_UINT16(s, 0x0050); /* Cmd+Sp+cbChId+Pad */
+			Stream_Write_UINT16(s, 3); /* Version (2 bytes) */
+			Stream_Write_UINT16(s, 0x3333); /* PriorityCharge0 (2 bytes) */
+			Stream_Write_UINT16(s, 0x1111); /* PriorityCharge1 (2 bytes) */
+			Stream_Write_UINT16(s, 0x0A3D); /* PriorityCharge2 (2 bytes) */
+			Stream_Write_UINT16(s, 0x04A7); /* PriorityCharge3 (2 bytes) */
+			Stream_Free(s, FALSE);
+
+			if (!WTSVirtualChannelWrite(channel, (PCHAR) dynvc_caps, sizeof(dynvc_caps), &written))
 				return FALSE;
 		}
 	}
@@ -731,6 +809,8 @@ HANDLE WINAPI FreeRDP_WTSOpenServerA(LPSTR pServerName)
 	if (!vcm->dynamicVirtualChannels)
 		goto error_dynamicVirtualChannels;
 
+	InitializeCriticalSection(&vcm->zgfx_lock);
+
 	client->ReceiveChannelData = WTSReceiveChannelData;
 
 	hServer = (HANDLE) vcm;
@@ -792,6 +872,10 @@ VOID WINAPI FreeRDP_WTSCloseServer(HANDLE hServer)
 
 		MessageQueue_Free(vcm->queue);
 
+		zgfx_context_free(vcm->zgfx_compressor);
+		zgfx_context_free(vcm->zgfx_decompressor);
+		DeleteCriticalSection(&vcm->zgfx_lock);
+
 		free(vcm);
 	}
 }
@@ -1192,6 +1276,30 @@ BOOL WINAPI FreeRDP_WTSVirtualChannelRead(HANDLE hChannelHandle, ULONG TimeOut,
 	return TRUE;
 }
 
+static BOOL wts_write_drdynvc_compressed(rdpPeerChannel* channel)
+{
+	BOOL status;
+	WTSVirtualChannelManager* vcm = channel->vcm;
+
+	/**
+	 * Clients negotiating version 3 accept compressed data. The client
+	 * decompresses the PDUs of all channels with one RDP8 bulk history,
+	 * in the order they are sent.
+	 */
+	if ((vcm->drdynvc_version < 3) || !channel->client->settings->CompressionEnabled)
+		return FALSE;
+
+	EnterCriticalSection(&vcm->zgfx_lock);
+
+	if (!vcm->zgfx_compressor)
+		vcm->zgfx_compressor = zgfx_context_new(TRUE);
+
+	status = vcm->zgfx_compressor ? TRUE : FALSE;
+	LeaveCriticalSection(&vcm->zgfx_lock);
+
+	return status;
+}
+
 BOOL WINAPI FreeRDP_WTSVirtualChannelWrite(HANDLE hChannelHandle, PCHAR Buffer, ULONG Length, PULONG pBytesWritten)
 {
 	wStream* s;
@@ -1201,6 +1309,8 @@ BOOL WINAPI FreeRDP_WTSVirtualChannelWrite(HANDLE hChannelHandle, PCHAR Buffer,
 	BYTE* buffer;
 	UINT32 length;
 	UINT32 written;
+	UINT32 available;
+	BOOL compressed;
 	rdpPeerChannel* channel = (rdpPeerChannel*) hChannelHandle;
 	BOOL ret = TRUE;
 
@@ -1225,9 +1335,12 @@ BOOL WINAPI FreeRDP_WTSVirtualChannelWrite(HANDLE hChannelHandle, PCHAR Buffer,
 	else
 	{
 		first = TRUE;
+		compressed = wts_write_drdynvc_compressed(channel);
 
 		while (Length > 0)
 		{
+			BYTE header;
+
 			s = Stream_New(NULL, channel->client->settings->VirtualChannelChunkSize);
 			if (!s)
 			{
@@ -1235,28 +1348,48 @@ BOOL WINAPI FreeRDP_WTSVirtualChannelWrite(HANDLE hChannelHandle, PCHAR Buffer,
 				return FALSE;
 			}
 
-			buffer = Stream_Buffer(s);
-
 			Stream_Seek_UINT8(s);
 			cbChId = wts_write_variable_uint(s, channel->channelId);
 
-			if (first && (Length > (UINT32) Stream_GetRemainingLength(s)))
+			/* a compressed segment that does not shrink is sent raw behind its 1 byte header */
+			available = Stream_GetRemainingLength(s) - (compressed ? 1 : 0);
+
+			if (first && (Length > available))
 			{
 				cbLen = wts_write_variable_uint(s, Length);
-				buffer[0] = (DATA_FIRST_PDU << 4) | (cbLen << 2) | cbChId;
+				header = ((compressed ? DATA_FIRST_COMPRESSED_PDU : DATA_FIRST_PDU) << 4) | (cbLen << 2) | cbChId;
+				available = Stream_GetRemainingLength(s) - (compressed ? 1 : 0);
 			}
 			else
 			{
-				buffer[0] = (DATA_PDU << 4) | cbChId;
+				header = ((compressed ? DATA_COMPRESSED_PDU : DATA_PDU) << 4) | cbChId;
 			}
 
 			first = FALSE;
-			written = Stream_GetRemainingLength(s);
+			written = available;
 
 			if (written > Length)
 				written = Length;
 
-			Stream_Write(s, Buffer, written);
+			/* segments are queued in the order they went through the shared history */
+			if (compressed)
+			{
+				EnterCriticalSection(&channel->vcm->zgfx_lock);
+
+				if (zgfx_compress_segment(channel->vcm->zgfx_compressor, s, (BYTE*) Buffer, written, NULL) < 0)
+				{
+					LeaveCriticalSection(&channel->vcm->zgfx_lock);
+					Stream_Free(s, TRUE);
+					return FALSE;
+				}
+			}
+			else
+			{
+				Stream_Write(s, Buffer, written);
+			}
+
+			buffer = Stream_Buffer(s);
+			buffer[0] = header;
 			length = Stream_GetPosition(s);
 			Stream_Free(s, FALSE);
 
@@ -1264,6 +1397,9 @@ BOOL WINAPI FreeRDP_WTSVirtualChannelWrite(HANDLE hChannelHandle, PCHAR Buffer,
 			Buffer += written;
 
 			ret = wts_queue_send_item(channel->vcm->drdynvc_channel, buffer, length);
+
+			if (compressed)
+				LeaveCriticalSection(&channel->vcm->zgfx_lock);
 		}
 	}
 
@@ -29,6 +29,8 @@
 #include <winpr/stream.h>
 #include <winpr/collections.h>
 
+#include <freerdp/codec/zgfx.h>
+
 typedef struct rdp_peer_channel rdpPeerChannel;
 typedef struct WTSVirtualChannelManager WTSVirtualChannelManager;
 
@@ -40,6 +42,8 @@ typedef struct WTSVirtualChannelManager WTSVirtualChannelManager;
 #define DATA_PDU				0x03
 #define CLOSE_REQUEST_PDU			0x04
 #define CAPABILITY_REQUEST_PDU			0x05
+#define DATA_FIRST_COMPRESSED_PDU		0x06
+#define DATA_COMPRESSED_PDU			0x07
 
 enum
 {
@@ -91,9 +95,15 @@ struct WTSVirtualChannelManager
 
 	rdpPeerChannel* drdynvc_channel;
 	BYTE drdynvc_state;
+	UINT16 drdynvc_version;
 	LONG dvc_channel_id_seq;
 
 	wArrayList* dynamicVirtualChannels;
+
+	/* one RDP8 bulk history per direction, shared by all dynamic channels */
+	CRITICAL_SECTION zgfx_lock;
+	ZGFX_CONTEXT* zgfx_compressor;
+	ZGFX_CONTEXT* zgfx_decompressor;
 };
 
 BOOL WINAPI FreeRDP_WTSStartRemoteControlSessionW(LPWSTR pTargetServerName, ULONG TargetLogonId, BYTE HotkeyVk, USHORT HotkeyModifiers);
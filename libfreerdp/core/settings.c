@@ -268,6 +268,7 @@ rdpSettings* freerdp_settings_new(DWORD flags)
 		settings->AuthenticationLevel = 2;
 
 		settings->ChannelCount = 0;
+		settings->PipelineChannelJoin = FALSE;
 		settings->ChannelDefArraySize = 32;
 		settings->ChannelDefArray = (CHANNEL_DEF*) calloc(settings->ChannelDefArraySize, sizeof(CHANNEL_DEF));
 		if (!settings->ChannelDefArray)
@@ -421,8 +422,11 @@ rdpSettings* freerdp_settings_new(DWORD flags)
 		settings->GatewayRpcTransport = TRUE;
 		settings->GatewayHttpTransport = TRUE;
 		settings->GatewayUdpTransport = TRUE;
+		settings->GatewayHttpUseWebsockets = FALSE;
 
 		settings->FastPathInput = TRUE;
+		settings->InputBatching = FALSE;
+		settings->InputBatchingInterval = 10;
 		settings->FastPathOutput = TRUE;
 
 		settings->FrameAcknowledge = 2;
@@ -591,6 +595,8 @@ rdpSettings* freerdp_settings_clone(rdpSettings* settings)
 		_settings->CurrentPath = _strdup(settings->CurrentPath); /* 1794 */
 		_settings->DumpRemoteFxFile = _strdup(settings->DumpRemoteFxFile); /* 1858 */
 		_settings->PlayRemoteFxFile = _strdup(settings->PlayRemoteFxFile); /* 1859 */
+		_settings->DumpSessionFile = _strdup(settings->DumpSessionFile); /* 1862 */
+		_settings->PlaySessionFile = _strdup(settings->PlaySessionFile); /* 1863 */
 		_settings->GatewayHostname = _strdup(settings->GatewayHostname); /* 1986 */
 		_settings->GatewayUsername = _strdup(settings->GatewayUsername); /* 1987 */
 		_settings->GatewayPassword = _strdup(settings->GatewayPassword); /* 1988 */
@@ -861,6 +867,8 @@ void freerdp_settings_free(rdpSettings* settings)
     free(settings->GatewayUsername);
     free(settings->GatewayPassword);
     free(settings->GatewayDomain);
+	free(settings->DumpSessionFile);
+	free(settings->PlaySessionFile);
     freerdp_target_net_addresses_free(settings);
     freerdp_device_collection_free(settings);
     freerdp_static_channel_collection_free(settings);
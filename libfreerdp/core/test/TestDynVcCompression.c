@@ -0,0 +1,371 @@
+#include <winpr/crt.h>
+#include <winpr/wtsapi.h>
+#include <winpr/stream.h>
+
+#include <freerdp/peer.h>
+#include <freerdp/channels/channels.h>
+#include <freerdp/channels/wtsvc.h>
+#include <freerdp/codec/zgfx.h>
+
+#include "../rdp.h"
+#include "../server.h"
+
+/**
+ * Loopback of the server side dynamic virtual channel manager: the PDUs it
+ * sends are decoded here the way the drdynvc client does, replies are fed
+ * back through ReceiveChannelData.
+ */
+
+#define TEST_DRDYNVC_CHANNEL_ID		1004
+
+struct _TEST_DVC_CLIENT
+{
+	UINT16 offeredVersion;
+	UINT32 channelId;
+	UINT32 wireBytes;
+	UINT32 compressedPdus;
+	wStream* fragment;
+	UINT32 fragmentLength;
+	wStream* received;
+	ZGFX_CONTEXT* zgfx;
+	BOOL error;
+};
+typedef struct _TEST_DVC_CLIENT TEST_DVC_CLIENT;
+
+static TEST_DVC_CLIENT test_client;
+
+static UINT32 test_read_variable_uint(wStream* s, int cbLen)
+{
+	UINT32 val;
+
+	switch (cbLen)
+	{
+		case 0:
+			Stream_Read_UINT8(s, val);
+			break;
+
+		case 1:
+			Stream_Read_UINT16(s, val);
+			break;
+
+		default:
+			Stream_Read_UINT32(s, val);
+			break;
+	}
+
+	return val;
+}
+
+static void test_client_data(const BYTE* data, UINT32 length)
+{
+	if (test_client.fragment)
+	{
+		Stream_Write(test_client.fragment, data, length);
+
+		if (Stream_GetPosition(test_client.fragment) < test_client.fragmentLength)
+			return;
+
+		data = Stream_Buffer(test_client.fragment);
+		length = Stream_GetPosition(test_client.fragment);
+	}
+
+	Stream_EnsureRemainingCapacity(test_client.received, length);
+	Stream_Write(test_client.received, data, length);
+
+	if (test_client.fragment)
+	{
+		Stream_Free(test_client.fragment, TRUE);
+		test_client.fragment = NULL;
+	}
+}
+
+static int test_send_channel_data(freerdp_peer* client, UINT16 channelId, BYTE* data, int size)
+{
+	wStream* s;
+	BYTE value;
+	int Cmd, Sp, cbChId;
+	UINT32 Length;
+
+	if (channelId != TEST_DRDYNVC_CHANNEL_ID)
+		return FALSE;
+
+	s = Stream_New(data, size);
+
+	if (!s)
+		return FALSE;
+
+	Stream_Read_UINT8(s, value);
+	Cmd = (value & 0xF0) >> 4;
+	Sp = (value & 0x0C) >> 2;
+	cbChId = (value & 0x03);
+
+	switch (Cmd)
+	{
+		case CAPABILITY_REQUEST_PDU:
+			Stream_Seek_UINT8(s); /* Pad (1 byte) */
+			Stream_Read_UINT16(s, test_client.offeredVersion);
+			break;
+
+		case CREATE_REQUEST_PDU:
+			test_client.channelId = test_read_variable_uint(s, cbChId);
+			break;
+
+		case DATA_FIRST_PDU:
+		case DATA_FIRST_COMPRESSED_PDU:
+		case DATA_PDU:
+		case DATA_COMPRESSED_PDU:
+			test_client.wireBytes += size;
+
+			if (test_read_variable_uint(s, cbChId) != test_client.channelId)
+				test_client.error = TRUE;
+
+			if ((Cmd == DATA_FIRST_PDU) || (Cmd == DATA_FIRST_COMPRESSED_PDU))
+			{
+				Length = test_read_variable_uint(s, Sp);
+				Stream_Free(test_client.fragment, TRUE);
+				test_client.fragment = Stream_New(NULL, Length);
+				test_client.fragmentLength = Length;
+			}
+
+			if ((Cmd == DATA_FIRST_COMPRESSED_PDU) || (Cmd == DATA_COMPRESSED_PDU))
+			{
+				test_client.compressedPdus++;
+
+				if (zgfx_decompress_segment(test_client.zgfx, Stream_Pointer(s), Stream_GetRemainingLength(s)) < 0)
+					test_client.error = TRUE;
+				else
+					test_client_data(test_client.zgfx->OutputBuffer, test_client.zgfx->OutputCount);
+			}
+			else
+			{
+				test_client_data(Stream_Pointer(s), Stream_GetRemainingLength(s));
+			}
+			break;
+
+		case CLOSE_REQUEST_PDU:
+			break;
+
+		default:
+			test_client.error = TRUE;
+			break;
+	}
+
+	Stream_Free(s, FALSE);
+	return TRUE;
+}
+
+static BOOL test_client_reply(freerdp_peer* client, BYTE* data, int size)
+{
+	return client->ReceiveChannelData(client, TEST_DRDYNVC_CHANNEL_ID, data, size,
+			CHANNEL_FLAG_FIRST | CHANNEL_FLAG_LAST, size) ? TRUE : FALSE;
+}
+
+static void test_fill_payload(BYTE* data, UINT32 size, int kind)
+{
+	UINT32 i;
+	UINT32 seed = 0xCAFEBABE;
+	const char* text = "<clipboard><item format=\"CF_UNICODETEXT\">Hello, dynamic channels</item></clipboard>\r\n";
+	UINT32 length = strlen(text);
+
+	for (i = 0; i < size; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+
+		if (kind == 0)
+			data[i] = text[i % length]; /* clipboard text */
+		else if (kind == 1)
+			data[i] = ((i % 4) == 3) ? 0xFF : (BYTE) ((i / 256) * 3); /* 32bpp gradient */
+		else
+			data[i] = (BYTE) (seed >> 16); /* already compressed file data */
+	}
+}
+
+static int test_dvc_loopback(UINT16 version, int kind, UINT32 size, UINT32* pWireBytes)
+{
+	int status = -1;
+	DWORD BytesReturned;
+	ULONG written;
+	ULONG bytesRead;
+	ULONG* pSessionId = NULL;
+	BYTE* payload = NULL;
+	BYTE* readBuffer = NULL;
+	HANDLE hServer = NULL;
+	HANDLE hChannel = NULL;
+	rdpMcs* mcs;
+	freerdp_peer* client;
+	BYTE caps[4] = { 0x50, 0x00, 0x00, 0x00 };
+	BYTE create[6] = { 0x10, 0x00, 0x00, 0x00, 0x00, 0x00 };
+	BYTE upstream[512];
+	wStream* s;
+	ZGFX_CONTEXT* compressor = NULL;
+
+	ZeroMemory(&test_client, sizeof(test_client));
+	test_client.received = Stream_New(NULL, 1024);
+	test_client.zgfx = zgfx_context_new(FALSE);
+
+	client = freerdp_peer_new(-1);
+
+	if (!client || !freerdp_peer_context_new(client))
+		goto out;
+
+	client->activated = TRUE;
+	client->SendChannelData = test_send_channel_data;
+	client->settings->CompressionEnabled = TRUE;
+
+	mcs = client->context->rdp->mcs;
+	mcs->channelCount = 1;
+	strcpy(mcs->channels[0].Name, "drdynvc");
+	mcs->channels[0].ChannelId = TEST_DRDYNVC_CHANNEL_ID;
+	mcs->channels[0].joined = TRUE;
+
+	hServer = WTSOpenServerA((LPSTR) client->context);
+
+	if (!hServer || (hServer == INVALID_HANDLE_VALUE))
+		goto out;
+
+	/* capabilities, the server offers version 3 */
+	WTSVirtualChannelManagerCheckFileDescriptor(hServer);
+
+	if (test_client.offeredVersion != 3)
+	{
+		printf("server offered version %d\n", test_client.offeredVersion);
+		goto out;
+	}
+
+	caps[2] = (BYTE) version;
+
+	if (!test_client_reply(client, caps, sizeof(caps)))
+		goto out;
+
+	if (!WTSQuerySessionInformationA(hServer, WTS_CURRENT_SESSION, WTSSessionId, (LPSTR*) &pSessionId, &BytesReturned))
+		goto out;
+
+	hChannel = WTSVirtualChannelOpenEx(*pSessionId, "TESTDVC", WTS_CHANNEL_OPTION_DYNAMIC);
+
+	if (!hChannel)
+		goto out;
+
+	WTSVirtualChannelManagerCheckFileDescriptor(hServer);
+
+	create[1] = (BYTE) test_client.channelId;
+
+	if (!test_client_reply(client, create, sizeof(create)))
+		goto out;
+
+	/* server to client */
+	payload = (BYTE*) malloc(size);
+
+	if (!payload)
+		goto out;
+
+	test_fill_payload(payload, size, kind);
+
+	if (!WTSVirtualChannelWrite(hChannel, (PCHAR) payload, size, &written))
+		goto out;
+
+	if (!WTSVirtualChannelWrite(hChannel, (PCHAR) payload, size / 3, &written))
+		goto out;
+
+	WTSVirtualChannelManagerCheckFileDescriptor(hServer);
+
+	if (test_client.error || (Stream_GetPosition(test_client.received) != size + (size / 3)) ||
+			(memcmp(Stream_Buffer(test_client.received), payload, size) != 0) ||
+			(memcmp(Stream_Buffer(test_client.received) + size, payload, size / 3) != 0))
+	{
+		printf("version %d: received data mismatch\n", version);
+		goto out;
+	}
+
+	if ((version >= 3) != (test_client.compressedPdus > 0))
+	{
+		printf("version %d: %d compressed PDUs\n", version, test_client.compressedPdus);
+		goto out;
+	}
+
+	/* client to server, compressed PDUs are accepted as well */
+	compressor = zgfx_context_new(TRUE);
+	s = Stream_New(upstream, sizeof(upstream));
+
+	if (!compressor || !s)
+		goto out;
+
+	Stream_Write_UINT8(s, (DATA_COMPRESSED_PDU << 4));
+	Stream_Write_UINT8(s, test_client.channelId);
+
+	if (zgfx_compress_segment(compressor, s, payload, 256, NULL) < 0)
+	{
+		Stream_Free(s, FALSE);
+		goto out;
+	}
+
+	written = Stream_GetPosition(s);
+	Stream_Free(s, FALSE);
+
+	if (!test_client_reply(client, upstream, written))
+		goto out;
+
+	readBuffer = (BYTE*) malloc(256);
+
+	if (!readBuffer || !WTSVirtualChannelRead(hChannel, 0, (PCHAR) readBuffer, 256, &bytesRead) ||
+			(bytesRead != 256) || (memcmp(readBuffer, payload, 256) != 0))
+	{
+		printf("version %d: upstream data mismatch\n", version);
+		goto out;
+	}
+
+	*pWireBytes = test_client.wireBytes;
+	status = 0;
+
+out:
+	if (hChannel)
+		WTSVirtualChannelClose(hChannel);
+
+	if (hServer && (hServer != INVALID_HANDLE_VALUE))
+		WTSCloseServer(hServer);
+
+	if (client)
+	{
+		freerdp_peer_context_free(client);
+		freerdp_peer_free(client);
+	}
+
+	WTSFreeMemory(pSessionId);
+	zgfx_context_free(compressor);
+	zgfx_context_free(test_client.zgfx);
+	Stream_Free(test_client.received, TRUE);
+	Stream_Free(test_client.fragment, TRUE);
+	free(readBuffer);
+	free(payload);
+	return status;
+}
+
+int TestDynVcCompression(int argc, char* argv[])
+{
+	int kind;
+	UINT32 plain;
+	UINT32 compressed;
+	const char* names[] = { "clipboard", "bitmap", "file" };
+
+	WTSRegisterWtsApiFunctionTable(FreeRDP_InitWtsApi());
+
+	for (kind = 0; kind < 3; kind++)
+	{
+		if (test_dvc_loopback(2, kind, 100000, &plain) < 0)
+			return -1;
+
+		if (test_dvc_loopback(3, kind, 100000, &compressed) < 0)
+			return -1;
+
+		printf("%s: %d bytes on the wire uncompressed, %d compressed (%.1f%%)\n",
+				names[kind], plain, compressed, (compressed * 100.0) / plain);
+
+		/* text and bitmaps shrink, incompressible data grows by its segment headers at most */
+		if ((kind < 2) && ((compressed * 4) > plain))
+			return -1;
+
+		if ((kind == 2) && (compressed > plain + (plain / 500) + 100))
+			return -1;
+	}
+
+	return 0;
+}
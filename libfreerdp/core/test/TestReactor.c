@@ -0,0 +1,328 @@
+#include <winpr/crt.h>
+#include <winpr/path.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/sysinfo.h>
+#include <winpr/interlocked.h>
+
+#include <freerdp/listener.h>
+#include <freerdp/reactor.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+
+#define TEST_REACTOR_PEERS	1024
+#define TEST_REACTOR_WORKERS	4
+#define TEST_REACTOR_ROUNDS	4
+
+static LONG test_bytes = 0;
+static LONG test_closed = 0;
+static freerdp_reactor* test_reactor = NULL;
+
+static BOOL test_peer_check(freerdp_peer* client)
+{
+	int status;
+	BYTE buffer[64];
+
+	status = recv(client->sockfd, (char*) buffer, sizeof(buffer), MSG_DONTWAIT);
+
+	if (status == 0)
+		return FALSE;
+
+	if (status < 0)
+		return (errno == EAGAIN || errno == EWOULDBLOCK) ? TRUE : FALSE;
+
+	InterlockedExchangeAdd(&test_bytes, status);
+
+	/* echo, so that the client side knows the peer has been dispatched */
+	return (send(client->sockfd, (char*) buffer, status, 0) == status) ? TRUE : FALSE;
+}
+
+static void test_peer_closed(freerdp_peer* client)
+{
+	CloseHandle((HANDLE) client->ContextExtra);
+	close(client->sockfd);
+	freerdp_peer_free(client);
+
+	InterlockedIncrement(&test_closed);
+}
+
+static BOOL test_peer_accepted(freerdp_listener* instance, freerdp_peer* client)
+{
+	HANDLE event;
+
+	event = CreateFileDescriptorEvent(NULL, FALSE, FALSE, client->sockfd);
+
+	if (!event)
+		return FALSE;
+
+	client->ContextExtra = (void*) event;
+
+	if (!freerdp_reactor_add_peer(test_reactor, client, &event, 1,
+			test_peer_check, test_peer_closed))
+	{
+		CloseHandle(event);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void* test_listener_thread(void* arg)
+{
+	DWORD count;
+	HANDLE events[8];
+	freerdp_listener* listener = (freerdp_listener*) arg;
+	HANDLE StopEvent = (HANDLE) listener->param1;
+
+	while (1)
+	{
+		count = listener->GetEventHandles(listener, events, 7);
+
+		if (!count)
+			break;
+
+		events[count++] = StopEvent;
+
+		if (WaitForMultipleObjects(count, events, FALSE, INFINITE) == WAIT_FAILED)
+			break;
+
+		if (WaitForSingleObject(StopEvent, 0) == WAIT_OBJECT_0)
+			break;
+
+		if (!listener->CheckFileDescriptor(listener))
+			break;
+	}
+
+	ExitThread(0);
+	return NULL;
+}
+
+static int test_connect(const char* path)
+{
+	int sockfd;
+	size_t length;
+	struct timeval timeout;
+	struct sockaddr_un addr;
+
+	sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (sockfd < 0)
+		return -1;
+
+	/* fail instead of hanging when a peer is never dispatched */
+	timeout.tv_sec = 10;
+	timeout.tv_usec = 0;
+	setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, (void*) &timeout, sizeof(timeout));
+
+	length = strlen(path);
+
+	if (length >= sizeof(addr.sun_path))
+	{
+		close(sockfd);
+		return -1;
+	}
+
+	ZeroMemory(&addr, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	CopyMemory(addr.sun_path, path, length);
+
+	if (connect(sockfd, (struct sockaddr*) &addr, sizeof(addr)) < 0)
+	{
+		close(sockfd);
+		return -1;
+	}
+
+	return sockfd;
+}
+
+static int test_reactor_peers(const char* path, int* sockfds, int count)
+{
+	int index;
+	int round;
+	int status;
+	UINT32 data;
+	UINT32 echo;
+	UINT32 start;
+
+	for (index = 0; index < count; index++)
+	{
+		sockfds[index] = test_connect(path);
+
+		if (sockfds[index] < 0)
+		{
+			printf("connect failed for peer %d (errno: %d)\n", index, errno);
+			return -1;
+		}
+	}
+
+	start = GetTickCount();
+
+	while (freerdp_reactor_get_peer_count(test_reactor) != (DWORD) count)
+	{
+		if ((GetTickCount() - start) > 10000)
+		{
+			printf("only %d of %d peers were accepted\n",
+				freerdp_reactor_get_peer_count(test_reactor), count);
+			return -1;
+		}
+
+		Sleep(10);
+	}
+
+	start = GetTickCount();
+
+	for (round = 0; round < TEST_REACTOR_ROUNDS; round++)
+	{
+		for (index = 0; index < count; index++)
+		{
+			data = (round << 16) | index;
+
+			if (send(sockfds[index], (char*) &data, sizeof(data), 0) != sizeof(data))
+				return -1;
+		}
+
+		for (index = 0; index < count; index++)
+		{
+			data = (round << 16) | index;
+			status = recv(sockfds[index], (char*) &echo, sizeof(echo), MSG_WAITALL);
+
+			if ((status != sizeof(echo)) || (echo != data))
+			{
+				printf("round %d: no echo from peer %d\n", round, index);
+				return -1;
+			}
+		}
+	}
+
+	printf("%d peers, %d rounds in %d ms\n", count, TEST_REACTOR_ROUNDS, GetTickCount() - start);
+
+	for (index = 0; index < count; index++)
+	{
+		close(sockfds[index]);
+		sockfds[index] = -1;
+	}
+
+	start = GetTickCount();
+
+	while (freerdp_reactor_get_peer_count(test_reactor) > 0)
+	{
+		if ((GetTickCount() - start) > 10000)
+		{
+			printf("%d peers were not removed\n", freerdp_reactor_get_peer_count(test_reactor));
+			return -1;
+		}
+
+		Sleep(10);
+	}
+
+	if ((test_closed != count) || (test_bytes != count * TEST_REACTOR_ROUNDS * (int) sizeof(UINT32)))
+	{
+		printf("closed %d peers and received %d bytes\n", test_closed, test_bytes);
+		return -1;
+	}
+
+	return 0;
+}
+
+int TestReactor(int argc, char* argv[])
+{
+	int index;
+	int count;
+	int status = -1;
+	int* sockfds;
+	char path[256];
+	HANDLE thread;
+	HANDLE StopEvent;
+	struct rlimit limit;
+	freerdp_listener* listener;
+
+	count = TEST_REACTOR_PEERS;
+
+	/* each peer uses a client socket, a server socket and a duplicate in the epoll set */
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0)
+	{
+		if (limit.rlim_cur < (rlim_t) (count * 4))
+		{
+			limit.rlim_cur = (limit.rlim_max < (rlim_t) (count * 4)) ? limit.rlim_max : (rlim_t) (count * 4);
+			setrlimit(RLIMIT_NOFILE, &limit);
+			getrlimit(RLIMIT_NOFILE, &limit);
+		}
+
+		if (limit.rlim_cur < (rlim_t) (count * 4))
+			count = (int) (limit.rlim_cur - 64) / 4;
+	}
+
+	test_reactor = freerdp_reactor_new(TEST_REACTOR_WORKERS);
+
+	if (!test_reactor)
+	{
+		printf("reactor not supported, skipping\n");
+		return 0;
+	}
+
+	sprintf_s(path, sizeof(path), "/tmp/TestReactor.%d", (int) getpid());
+
+	sockfds = (int*) calloc(count, sizeof(int));
+	listener = freerdp_listener_new();
+	StopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	if (!sockfds || !listener || !StopEvent)
+		goto out;
+
+	listener->param1 = (void*) StopEvent;
+	listener->PeerAccepted = test_peer_accepted;
+
+	if (!listener->OpenLocal(listener, path))
+		goto out;
+
+	if (!(thread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE) test_listener_thread,
+			(void*) listener, 0, NULL)))
+		goto out;
+
+	for (index = 0; index < count; index++)
+		sockfds[index] = -1;
+
+	status = test_reactor_peers(path, sockfds, count);
+
+	for (index = 0; index < count; index++)
+	{
+		if (sockfds[index] >= 0)
+			close(sockfds[index]);
+	}
+
+	SetEvent(StopEvent);
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+
+	listener->Close(listener);
+	unlink(path);
+
+out:
+	freerdp_reactor_free(test_reactor);
+	test_reactor = NULL;
+
+	if (listener)
+		freerdp_listener_free(listener);
+
+	if (StopEvent)
+		CloseHandle(StopEvent);
+
+	free(sockfds);
+
+	return status;
+}
+
+#else
+
+int TestReactor(int argc, char* argv[])
+{
+	return 0;
+}
+
+#endif
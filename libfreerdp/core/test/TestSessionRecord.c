@@ -0,0 +1,307 @@
+#include <winpr/crt.h>
+#include <winpr/path.h>
+#include <winpr/stream.h>
+
+#include <freerdp/freerdp.h>
+
+#include "../rdp.h"
+#include "../record.h"
+#include "../connection.h"
+#include "../activation.h"
+#include "../capabilities.h"
+
+/**
+ * Records a short synthetic session and replays it: the server side of the
+ * capabilities exchange and connection finalization is produced by a server
+ * mode rdpRdp writing into a memory BIO, followed by a few fast-path
+ * updates. Both the recording and the replaying client must reach the
+ * active state and see the same updates.
+ */
+
+#define TEST_RECORD_USER_ID		1007
+#define TEST_RECORD_WIDTH		1280
+#define TEST_RECORD_HEIGHT		720
+#define TEST_RECORD_UPDATES		16
+
+static int test_pointer_updates = 0;
+
+static BOOL test_pointer_system(rdpContext* context, POINTER_SYSTEM_UPDATE* pointer_system)
+{
+	if (pointer_system->type == SYSPTR_NULL)
+		test_pointer_updates++;
+
+	return TRUE;
+}
+
+/* a fast-path PDU with a single empty null pointer update */
+static const BYTE test_fastpath_ptr_null[] = { 0x00, 0x05, 0x05, 0x00, 0x00 };
+
+static BIO* test_server_session(void)
+{
+	BIO* bio = NULL;
+	rdpRdp* rdp = NULL;
+	rdpContext* context;
+
+	context = (rdpContext*) calloc(1, sizeof(rdpContext));
+
+	if (!context)
+		return NULL;
+
+	context->ServerMode = TRUE;
+
+	if (!(rdp = rdp_new(context)))
+		goto out;
+
+	context->rdp = rdp;
+	rdp->settings->DesktopWidth = TEST_RECORD_WIDTH;
+	rdp->settings->DesktopHeight = TEST_RECORD_HEIGHT;
+	rdp->mcs->userId = TEST_RECORD_USER_ID;
+
+	rdp->transport->layer = TRANSPORT_LAYER_TCP;
+	rdp->transport->frontBio = BIO_new(BIO_s_mem());
+
+	if (!rdp->transport->frontBio)
+		goto out;
+
+	if (!rdp_send_demand_active(rdp) ||
+			!rdp_send_server_synchronize_pdu(rdp) ||
+			!rdp_send_server_control_cooperate_pdu(rdp) ||
+			!rdp_send_server_control_granted_pdu(rdp) ||
+			!rdp_send_server_font_map_pdu(rdp))
+		goto out;
+
+	/* the memory BIO outlives the server */
+	bio = rdp->transport->frontBio;
+	rdp->transport->frontBio = NULL;
+
+out:
+	rdp_free(rdp);
+	free(context);
+	return bio;
+}
+
+static freerdp* test_client_new(void)
+{
+	freerdp* instance;
+
+	if (!(instance = freerdp_new()))
+		return NULL;
+
+	if (!freerdp_context_new(instance))
+	{
+		freerdp_free(instance);
+		return NULL;
+	}
+
+	instance->update->pointer->PointerSystem = test_pointer_system;
+
+	return instance;
+}
+
+static void test_client_free(freerdp* instance)
+{
+	if (!instance)
+		return;
+
+	freerdp_context_free(instance);
+	freerdp_free(instance);
+}
+
+static BOOL test_client_recv(rdpRdp* rdp, const BYTE* data, UINT32 length)
+{
+	int status;
+	wStream* s;
+
+	if (!(s = Stream_New(NULL, length)))
+		return FALSE;
+
+	Stream_Write(s, data, length);
+	Stream_SealLength(s);
+	Stream_SetPosition(s, 0);
+
+	status = rdp_recv_callback(rdp->transport, s, rdp);
+	Stream_Free(s, TRUE);
+
+	return (status >= 0) ? TRUE : FALSE;
+}
+
+static int test_record_session(const char* filename)
+{
+	int index;
+	int result = -1;
+	long size;
+	UINT32 length;
+	BYTE* data;
+	BYTE* end;
+	BIO* bio = NULL;
+	rdpRdp* rdp;
+	freerdp* instance;
+
+	if (!(instance = test_client_new()))
+		return -1;
+
+	rdp = instance->context->rdp;
+	rdp->transport->layer = TRANSPORT_LAYER_TCP;
+	rdp->transport->frontBio = BIO_new(BIO_s_null());
+
+	if (!rdp->transport->frontBio)
+		goto out;
+
+	if (!(rdp->record = record_new(rdp, (char*) filename, TRUE)))
+		goto out;
+
+	if (!(bio = test_server_session()))
+		goto out;
+
+	rdp->mcs->userId = TEST_RECORD_USER_ID;
+	rdp_client_transition_to_state(rdp, CONNECTION_STATE_CAPABILITIES_EXCHANGE);
+
+	size = BIO_get_mem_data(bio, &data);
+	end = data + size;
+
+	while (data < end)
+	{
+		/* the server only sent slow-path PDUs */
+		if ((end - data < 4) || (data[0] != 3))
+			goto out;
+
+		length = (data[2] << 8) | data[3];
+
+		if ((length < 4) || (length > (UINT32) (end - data)))
+			goto out;
+
+		if (!test_client_recv(rdp, data, length))
+			goto out;
+
+		data += length;
+	}
+
+	if (rdp->state != CONNECTION_STATE_ACTIVE)
+	{
+		printf("recording client did not reach the active state\n");
+		goto out;
+	}
+
+	for (index = 0; index < TEST_RECORD_UPDATES; index++)
+	{
+		if (!test_client_recv(rdp, test_fastpath_ptr_null, sizeof(test_fastpath_ptr_null)))
+			goto out;
+	}
+
+	if (rdp->record->count != 5 + TEST_RECORD_UPDATES)
+	{
+		printf("recorded %d PDUs, expected %d\n", rdp->record->count, 5 + TEST_RECORD_UPDATES);
+		goto out;
+	}
+
+	result = 0;
+
+out:
+	if (bio)
+		BIO_free(bio);
+
+	test_client_free(instance);
+	return result;
+}
+
+static int test_replay_session(const char* filename)
+{
+	int status;
+	int result = -1;
+	rdpRdp* rdp;
+	freerdp* instance;
+
+	if (!(instance = test_client_new()))
+		return -1;
+
+	rdp = instance->context->rdp;
+
+	if (!(rdp->record = record_new(rdp, (char*) filename, FALSE)))
+		goto out;
+
+	if (!record_replay_connect(rdp->record))
+	{
+		printf("replaying client did not reach the active state\n");
+		goto out;
+	}
+
+	if ((rdp->mcs->userId != TEST_RECORD_USER_ID) ||
+			(rdp->settings->DesktopWidth != TEST_RECORD_WIDTH) ||
+			(rdp->settings->DesktopHeight != TEST_RECORD_HEIGHT))
+	{
+		printf("recorded connection state was not restored\n");
+		goto out;
+	}
+
+	while ((status = record_replay_pdu(rdp->record)) > 0);
+
+	if (status < 0)
+		goto out;
+
+	if (rdp->record->count != 5 + TEST_RECORD_UPDATES)
+	{
+		printf("replayed %d PDUs, expected %d\n", rdp->record->count, 5 + TEST_RECORD_UPDATES);
+		goto out;
+	}
+
+	result = 0;
+
+out:
+	test_client_free(instance);
+	return result;
+}
+
+int TestSessionRecord(int argc, char* argv[])
+{
+	int result = -1;
+	char name[64];
+	char* tempPath;
+	char* filename;
+
+	tempPath = GetKnownPath(KNOWN_PATH_TEMP);
+
+	if (!tempPath)
+		return -1;
+
+	sprintf_s(name, sizeof(name), "TestSessionRecord.%u.pcap", (unsigned int) GetCurrentProcessId());
+	filename = GetCombinedPath(tempPath, name);
+	free(tempPath);
+
+	if (!filename)
+		return -1;
+
+	if (test_record_session(filename) < 0)
+	{
+		printf("session recording failed\n");
+		goto out;
+	}
+
+	if (test_pointer_updates != TEST_RECORD_UPDATES)
+	{
+		printf("recording client saw %d pointer updates, expected %d\n",
+				test_pointer_updates, TEST_RECORD_UPDATES);
+		goto out;
+	}
+
+	test_pointer_updates = 0;
+
+	if (test_replay_session(filename) < 0)
+	{
+		printf("session replay failed\n");
+		goto out;
+	}
+
+	if (test_pointer_updates != TEST_RECORD_UPDATES)
+	{
+		printf("replaying client saw %d pointer updates, expected %d\n",
+				test_pointer_updates, TEST_RECORD_UPDATES);
+		goto out;
+	}
+
+	result = 0;
+
+out:
+	DeleteFileA(filename);
+	free(filename);
+	return result;
+}
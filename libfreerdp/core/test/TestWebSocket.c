@@ -0,0 +1,192 @@
+#include <winpr/crt.h>
+#include <winpr/stream.h>
+
+#include <openssl/bio.h>
+
+#include "websocket.h"
+
+static int test_websocket_write_frame(BIO* bio, BYTE opcode, const BYTE* data, int length, BOOL masked)
+{
+	int status;
+	int headerLength;
+	wStream* s;
+
+	s = Stream_New(NULL, WEBSOCKET_MAX_HEADER_LENGTH + length);
+
+	if (!s)
+		return -1;
+
+	headerLength = websocket_frame_header_length(length, masked);
+
+	if (!websocket_write_frame_header(s, opcode, length, masked))
+		return -1;
+
+	if (Stream_GetPosition(s) != headerLength)
+		return -1;
+
+	Stream_Write(s, data, length);
+
+	if (masked)
+		websocket_mask_payload(&Stream_Buffer(s)[headerLength], length, &Stream_Buffer(s)[headerLength - 4], 0);
+
+	status = BIO_write(bio, Stream_Buffer(s), Stream_GetPosition(s));
+	Stream_Free(s, TRUE);
+
+	return (status == (headerLength + length)) ? 1 : -1;
+}
+
+static int test_websocket_read_all(rdpWebSocket* websocket, BIO* bio, BYTE* buffer, int length)
+{
+	int status;
+	int offset = 0;
+
+	while (offset < length)
+	{
+		/* small reads exercise header and payload resumption */
+		status = websocket_read(websocket, bio, &buffer[offset], 7);
+
+		if (status <= 0)
+			return -1;
+
+		offset += status;
+	}
+
+	return offset;
+}
+
+static int test_websocket_frames(void)
+{
+	int index;
+	int status;
+	BIO* client = NULL;
+	BIO* server = NULL;
+	BYTE* payload = NULL;
+	BYTE* received = NULL;
+	BYTE pong[16];
+	const int length = 70000;
+	const BYTE ping[] = "ping";
+	rdpWebSocket* clientSocket = NULL;
+	rdpWebSocket* serverSocket = NULL;
+
+	if (!BIO_new_bio_pair(&client, 0x40000, &server, 0x40000))
+		return -1;
+
+	payload = (BYTE*) malloc(length);
+	received = (BYTE*) malloc(length);
+	clientSocket = websocket_new(TRUE);
+	serverSocket = websocket_new(FALSE);
+
+	if (!payload || !received || !clientSocket || !serverSocket)
+		goto fail;
+
+	for (index = 0; index < length; index++)
+		payload[index] = (BYTE) (index * 7);
+
+	/* client to server: one masked frame using the 64-bit length encoding */
+
+	if (test_websocket_write_frame(client, WEBSOCKET_OPCODE_BINARY, payload, length, TRUE) < 0)
+		goto fail;
+
+	ZeroMemory(received, length);
+
+	if (test_websocket_read_all(serverSocket, server, received, length) != length)
+		goto fail;
+
+	if (memcmp(payload, received, length) != 0)
+	{
+		printf("masked payload mismatch\n");
+		goto fail;
+	}
+
+	/* server to client: unmasked fragments with an interleaved ping */
+
+	if (test_websocket_write_frame(server, WEBSOCKET_OPCODE_BINARY, payload, 100, FALSE) < 0)
+		goto fail;
+
+	if (test_websocket_write_frame(server, WEBSOCKET_OPCODE_PING, ping, sizeof(ping) - 1, FALSE) < 0)
+		goto fail;
+
+	if (test_websocket_write_frame(server, WEBSOCKET_OPCODE_BINARY, &payload[100], 1000, FALSE) < 0)
+		goto fail;
+
+	ZeroMemory(received, length);
+
+	if (test_websocket_read_all(clientSocket, client, received, 1100) != 1100)
+		goto fail;
+
+	if (memcmp(payload, received, 1100) != 0)
+	{
+		printf("fragmented payload mismatch\n");
+		goto fail;
+	}
+
+	/* the client must have answered the ping with a masked pong */
+
+	status = BIO_read(server, pong, sizeof(pong));
+
+	if ((status != 2 + 4 + 4) || (pong[0] != (WEBSOCKET_FIN_BIT | WEBSOCKET_OPCODE_PONG)) ||
+			(pong[1] != (WEBSOCKET_MASK_BIT | 4)))
+	{
+		printf("missing pong reply\n");
+		goto fail;
+	}
+
+	websocket_mask_payload(&pong[6], 4, &pong[2], 0);
+
+	if (memcmp(&pong[6], ping, 4) != 0)
+		goto fail;
+
+	/* a close frame terminates the stream */
+
+	if (test_websocket_write_frame(server, WEBSOCKET_OPCODE_CLOSE, NULL, 0, FALSE) < 0)
+		goto fail;
+
+	if (websocket_read(clientSocket, client, received, length) >= 0)
+		goto fail;
+
+	websocket_free(clientSocket);
+	websocket_free(serverSocket);
+	BIO_free(client);
+	BIO_free(server);
+	free(payload);
+	free(received);
+	return 1;
+
+fail:
+	websocket_free(clientSocket);
+	websocket_free(serverSocket);
+	BIO_free(client);
+	BIO_free(server);
+	free(payload);
+	free(received);
+	return -1;
+}
+
+static int test_websocket_accept(void)
+{
+	/* sample handshake from RFC 6455 section 1.3 */
+	if (!websocket_check_accept("dGhlIHNhbXBsZSBub25jZQ==", "s3pPLMBiTxaQ9kYGzzhZRbK+xOo="))
+		return -1;
+
+	if (websocket_check_accept("dGhlIHNhbXBsZSBub25jZQ==", "AAAAAAAAAAAAAAAAAAAAAAAAAAA="))
+		return -1;
+
+	return 1;
+}
+
+int TestWebSocket(int argc, char* argv[])
+{
+	if (test_websocket_accept() < 0)
+	{
+		printf("websocket accept key check failed\n");
+		return -1;
+	}
+
+	if (test_websocket_frames() < 0)
+	{
+		printf("websocket framing test failed\n");
+		return -1;
+	}
+
+	return 0;
+}
@@ -27,6 +27,10 @@
 #include <winpr/crt.h>
 #include <winpr/sspi.h>
 #include <winpr/ssl.h>
+#include <winpr/synch.h>
+#include <winpr/collections.h>
+
+#include <openssl/rand.h>
 
 #include <winpr/stream.h>
 #include <freerdp/utils/ringbuffer.h>
@@ -573,6 +577,153 @@ out_free:
 }
 
 
+/**
+ * TLS session cache
+ *
+ * Client sessions are kept process-wide, keyed by "hostname:port", so that
+ * auto-reconnects and the second channel of a gateway connection can resume
+ * the previous session instead of performing a full handshake. On the server
+ * side every connection uses its own SSL_CTX, so resumption relies on session
+ * tickets encrypted with a process-wide ticket key.
+ */
+
+#define TLS_SESSION_CACHE_MAX_ENTRIES	64
+
+static INIT_ONCE tls_session_cache_once = INIT_ONCE_STATIC_INIT;
+static CRITICAL_SECTION tls_session_cache_lock;
+static wHashTable* tls_session_cache = NULL;
+static BYTE tls_ticket_keys[48];
+static BOOL tls_ticket_keys_valid = FALSE;
+
+static void tls_session_cache_value_free(void* value)
+{
+	SSL_SESSION_free((SSL_SESSION*) value);
+}
+
+static BOOL CALLBACK tls_session_cache_init(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	InitializeCriticalSectionAndSpinCount(&tls_session_cache_lock, 4000);
+
+	tls_session_cache = HashTable_New(FALSE);
+
+	if (tls_session_cache)
+	{
+		tls_session_cache->hash = HashTable_StringHash;
+		tls_session_cache->keyCompare = HashTable_StringCompare;
+		tls_session_cache->keyClone = HashTable_StringClone;
+		tls_session_cache->keyFree = HashTable_StringFree;
+		tls_session_cache->valueFree = tls_session_cache_value_free;
+	}
+
+	if (RAND_bytes(tls_ticket_keys, sizeof(tls_ticket_keys)) == 1)
+		tls_ticket_keys_valid = TRUE;
+
+	return TRUE;
+}
+
+static char* tls_session_cache_key(rdpTls* tls)
+{
+	int length;
+	char* key;
+
+	if (!tls->hostname)
+		return NULL;
+
+	length = strlen(tls->hostname) + 16;
+	key = (char*) malloc(length);
+
+	if (!key)
+		return NULL;
+
+	sprintf_s(key, length, "%s:%d", tls->hostname, tls->port);
+
+	return key;
+}
+
+/**
+ * Offers the cached session for the connection peer, if any. Returns TRUE
+ * when a session was set on the connection.
+ */
+
+static BOOL tls_session_cache_apply(rdpTls* tls)
+{
+	char* key;
+	BOOL status = FALSE;
+	SSL_SESSION* session;
+
+	InitOnceExecuteOnce(&tls_session_cache_once, tls_session_cache_init, NULL, NULL);
+
+	if (!tls_session_cache)
+		return FALSE;
+
+	if (!(key = tls_session_cache_key(tls)))
+		return FALSE;
+
+	EnterCriticalSection(&tls_session_cache_lock);
+
+	session = (SSL_SESSION*) HashTable_GetItemValue(tls_session_cache, key);
+
+	if (session)
+		status = (SSL_set_session(tls->ssl, session) == 1) ? TRUE : FALSE;
+
+	LeaveCriticalSection(&tls_session_cache_lock);
+
+	free(key);
+
+	return status;
+}
+
+static void tls_session_cache_store(rdpTls* tls)
+{
+	char* key;
+	SSL_SESSION* session;
+
+	if (!tls_session_cache)
+		return;
+
+	/* a resumed session is the one already in the cache */
+	if (SSL_session_reused(tls->ssl))
+		return;
+
+	if (!(key = tls_session_cache_key(tls)))
+		return;
+
+	session = SSL_get1_session(tls->ssl);
+
+	EnterCriticalSection(&tls_session_cache_lock);
+
+	if (session)
+	{
+		if ((HashTable_Count(tls_session_cache) >= TLS_SESSION_CACHE_MAX_ENTRIES) &&
+				!HashTable_Contains(tls_session_cache, key))
+			HashTable_Clear(tls_session_cache);
+
+		if (HashTable_Add(tls_session_cache, key, session) < 0)
+			SSL_SESSION_free(session);
+	}
+
+	LeaveCriticalSection(&tls_session_cache_lock);
+
+	free(key);
+}
+
+static void tls_session_cache_remove(rdpTls* tls)
+{
+	char* key;
+
+	if (!tls_session_cache)
+		return;
+
+	if (!(key = tls_session_cache_key(tls)))
+		return;
+
+	EnterCriticalSection(&tls_session_cache_lock);
+	HashTable_Remove(tls_session_cache, key);
+	LeaveCriticalSection(&tls_session_cache_lock);
+
+	free(key);
+}
+
 #if defined(__APPLE__)
 BOOL tls_prepare(rdpTls* tls, BIO* underlying, SSL_METHOD* method, int options, BOOL clientMode)
 #else
@@ -722,6 +873,8 @@ out:
 
 int tls_connect(rdpTls* tls, BIO* underlying)
 {
+	int status;
+	BOOL cached;
 	int options = 0;
 
 	/**
@@ -756,7 +909,21 @@ int tls_connect(rdpTls* tls, BIO* underlying)
 	if (!tls_prepare(tls, underlying, TLSv1_client_method(), options, TRUE))
 		return FALSE;
 
-	return tls_do_handshake(tls, TRUE);
+	cached = tls_session_cache_apply(tls);
+
+	status = tls_do_handshake(tls, TRUE);
+
+	if (status > 0)
+	{
+		WLog_DBG(TAG, "TLS session %s", SSL_session_reused(tls->ssl) ? "resumed" : "established");
+		tls_session_cache_store(tls);
+	}
+	else if (cached)
+	{
+		tls_session_cache_remove(tls);
+	}
+
+	return status;
 }
 
 #ifndef OPENSSL_NO_TLSEXT
@@ -816,6 +983,13 @@ BOOL tls_accept(rdpTls* tls, BIO* underlying, const char* cert_file, const char*
 	if (!tls_prepare(tls, underlying, SSLv23_server_method(), options, FALSE))
 		return FALSE;
 
+	InitOnceExecuteOnce(&tls_session_cache_once, tls_session_cache_init, NULL, NULL);
+
+	SSL_set_session_id_context(tls->ssl, (const unsigned char*) "FreeRDP", 7);
+
+	if (tls_ticket_keys_valid)
+		SSL_CTX_set_tlsext_ticket_keys(tls->ctx, tls_ticket_keys, sizeof(tls_ticket_keys));
+
 	if (SSL_use_RSAPrivateKey_file(tls->ssl, privatekey_file, SSL_FILETYPE_PEM) <= 0)
 	{
 		WLog_ERR(TAG, "SSL_CTX_use_RSAPrivateKey_file failed");
@@ -38,9 +38,15 @@
 #include <freerdp/gdi/drawing.h>
 
 #include <freerdp/gdi/32bpp.h>
+#include <freerdp/primitives.h>
 
 #define TAG FREERDP_TAG("gdi")
 
+/* Index of a ternary raster operation, and whether it uses the source or the pattern */
+#define GDI_ROP3_INDEX(_rop)		((BYTE) (((_rop) >> 16) & 0xFF))
+#define GDI_ROP3_USES_SRC(_rop3)	((((_rop3) >> 2) ^ (_rop3)) & 0x33)
+#define GDI_ROP3_USES_PAT(_rop3)	((((_rop3) >> 4) ^ (_rop3)) & 0x0F)
+
 UINT32 gdi_get_color_32bpp(HGDI_DC hdc, GDI_COLOR color)
 {
 	UINT32 color32;
@@ -63,9 +69,10 @@ UINT32 gdi_get_color_32bpp(HGDI_DC hdc, GDI_COLOR color)
 
 int FillRect_32bpp(HGDI_DC hdc, HGDI_RECT rect, HGDI_BRUSH hbr)
 {
-	int x, y;
+	int y;
 	UINT32 *dstp;
 	UINT32 color32;
+	primitives_t* prims;
 	int nXDest, nYDest;
 	int nWidth, nHeight;
 
@@ -75,19 +82,14 @@ int FillRect_32bpp(HGDI_DC hdc, HGDI_RECT rect, HGDI_BRUSH hbr)
 		return 0;
 
 	color32 = gdi_get_color_32bpp(hdc, hbr->color);
+	prims = primitives_get();
 
 	for (y = 0; y < nHeight; y++)
 	{
 		dstp = (UINT32*) gdi_get_bitmap_pointer(hdc, nXDest, nYDest + y);
 
 		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{
-				*dstp = color32;
-				dstp++;
-			}
-		}
+			prims->set_32u(color32, dstp, nWidth);
 	}
 
 	if (!gdi_InvalidateRegion(hdc, nXDest, nYDest, nWidth, nHeight))
@@ -222,192 +224,115 @@ static int BitBlt_SRCCOPY_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWi
 	return 1;
 }
 
-static int BitBlt_NOTSRCCOPY_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
+/**
+ * Fills the 8x8 pattern of the brush selected in hdc. Brushes are 8x8 in
+ * RDP, solid brushes use their color and no brush the text color, like
+ * gdi_get_brush_pointer.
+ */
+
+static UINT32* gdi_get_brush_pattern_32bpp(HGDI_DC hdc, UINT32* pattern)
 {
 	int x, y;
-	UINT32* srcp;
-	UINT32* dstp;
-
-	if (!hdcDest || !hdcSrc)
-		return 0;
+	UINT32 color32;
+	HGDI_BRUSH brush = hdc->brush;
 
-	for (y = 0; y < nHeight; y++)
+	if (brush && ((brush->style == GDI_BS_PATTERN) || (brush->style == GDI_BS_HATCHED)))
 	{
-		srcp = (UINT32*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-		dstp = (UINT32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-		if (dstp != 0)
+		for (y = 0; y < 8; y++)
 		{
-			for (x = 0; x < nWidth; x++)
-			{
-				*dstp = ~(*srcp);
-				srcp++;
-				dstp++;
-			}
+			for (x = 0; x < 8; x++)
+				pattern[y * 8 + x] = *((UINT32*) gdi_get_brush_pointer(hdc, x, y));
 		}
-	}
 
-	return 1;
-}
-
-static int BitBlt_DSTINVERT_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight)
-{
-	int x, y;
-	UINT32* dstp;
-		
-	for (y = 0; y < nHeight; y++)
-	{
-		dstp = (UINT32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{
-				*dstp = ~(*dstp);
-				dstp++;
-			}
-		}
+		return pattern;
 	}
 
-	return 1;
-}
-
-static int BitBlt_SRCERASE_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
-{
-	int x, y;
-	UINT32* srcp;
-	UINT32* dstp;
-
-	if (!hdcDest || !hdcSrc)
-		return 0;
-
-	for (y = 0; y < nHeight; y++)
-	{
-		srcp = (UINT32*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-		dstp = (UINT32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
+	if (brush && (brush->style == GDI_BS_SOLID))
+		color32 = gdi_get_color_32bpp(hdc, brush->color);
+	else
+		color32 = *((UINT32*) gdi_get_brush_pointer(hdc, 0, 0));
 
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{
-				*dstp = *srcp & ~(*dstp);
-				srcp++;
-				dstp++;
-			}
-		}
-	}
+	for (x = 0; x < 64; x++)
+		pattern[x] = color32;
 
-	return 1;
+	return pattern;
 }
 
-static int BitBlt_NOTSRCERASE_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
+/**
+ * Draws any ternary raster operation with the rop3_32u primitive, from
+ * the source selected in hdcSrc and the given 8x8 pattern aligned on
+ * patX and patY. Either may be NULL when the operation does not use it.
+ */
+
+static int BitBlt_ROP3_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight,
+		HGDI_DC hdcSrc, int nXSrc, int nYSrc, const UINT32* pattern, int patX, int patY, BYTE rop3)
 {
-	int x, y;
-	UINT32* srcp;
-	UINT32* dstp;
+	BYTE* srcp = NULL;
+	BYTE* dstp;
+	INT32 srcStep = 0;
+	INT32 dstStep;
+	HGDI_BITMAP hSrcBmp;
+	HGDI_BITMAP hDstBmp = (HGDI_BITMAP) hdcDest->selectedObject;
 
-	if (!hdcDest || !hdcSrc)
-		return 0;
+	if ((nWidth <= 0) || (nHeight <= 0))
+		return 1;
 
-	for (y = 0; y < nHeight; y++)
+	if (hdcSrc)
 	{
-		srcp = (UINT32*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-		dstp = (UINT32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
+		hSrcBmp = (HGDI_BITMAP) hdcSrc->selectedObject;
 
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{
-				*dstp = ~(*srcp) & ~(*dstp);
-				srcp++;
-				dstp++;
-			}
-		}
-	}
-
-	return 1;
-}
+		/**
+		 * Only the destination has been clipped, clip the source rectangle
+		 * to the source bitmap as well and move the destination and the
+		 * pattern origin along with it.
+		 */
 
-static int BitBlt_SRCINVERT_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
-{
-	int x, y;
-	UINT32* srcp;
-	UINT32* dstp;
-
-	if (!hdcDest || !hdcSrc)
-		return 0;
+		if (nXSrc < 0)
+		{
+			if (nXSrc <= -nWidth)
+				return 1;
 
-	for (y = 0; y < nHeight; y++)
-	{
-		srcp = (UINT32*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-		dstp = (UINT32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
+			nXDest -= nXSrc;
+			patX -= nXSrc;
+			nWidth += nXSrc;
+			nXSrc = 0;
+		}
 
-		if (dstp != 0)
+		if (nYSrc < 0)
 		{
-			for (x = 0; x < nWidth; x++)
-			{
-				*dstp ^= *srcp;
-				srcp++;
-				dstp++;
-			}
+			if (nYSrc <= -nHeight)
+				return 1;
+
+			nYDest -= nYSrc;
+			patY -= nYSrc;
+			nHeight += nYSrc;
+			nYSrc = 0;
 		}
-	}
 
-	return 1;
-}
+		if ((nXSrc >= hSrcBmp->width) || (nYSrc >= hSrcBmp->height))
+			return 1;
 
-static int BitBlt_SRCAND_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
-{
-	int x, y;
-	UINT32* srcp;
-	UINT32* dstp;
+		if (nWidth > hSrcBmp->width - nXSrc)
+			nWidth = hSrcBmp->width - nXSrc;
 
-	if (!hdcDest || !hdcSrc)
-		return 0;
+		if (nHeight > hSrcBmp->height - nYSrc)
+			nHeight = hSrcBmp->height - nYSrc;
 
-	for (y = 0; y < nHeight; y++)
-	{
-		srcp = (UINT32*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-		dstp = (UINT32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
+		srcp = gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc);
+		srcStep = hSrcBmp->width * hdcSrc->bytesPerPixel;
 
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{
-				*dstp &= *srcp;
-				srcp++;
-				dstp++;
-			}
-		}
+		if (!srcp)
+			return 1;
 	}
 
-	return 1;
-}
+	dstp = gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest);
+	dstStep = hDstBmp->width * hdcDest->bytesPerPixel;
 
-static int BitBlt_SRCPAINT_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
-{
-	int x, y;
-	UINT32* srcp;
-	UINT32* dstp;
-		
-	if (!hdcDest || !hdcSrc)
-		return 0;
+	if (!dstp)
+		return 1;
 
-	for (y = 0; y < nHeight; y++)
-	{
-		srcp = (UINT32*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-		dstp = (UINT32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{
-				*dstp |= *srcp;
-				srcp++;
-				dstp++;
-			}
-		}
-	}
+	primitives_get()->rop3_32u((UINT32*) srcp, srcStep, pattern, patX, patY,
+			(UINT32*) dstp, dstStep, nWidth, nHeight, rop3);
 
 	return 1;
 }
@@ -415,13 +340,11 @@ static int BitBlt_SRCPAINT_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nW
 static int BitBlt_DSPDxax_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
 {	
 	int x, y;
-	UINT32* srcp;
 	UINT32* dstp;
-	UINT32* patp;
 	BYTE* srcp8;
 	UINT32 src32;
 	UINT32 color32;
-	HGDI_BITMAP hSrcBmp;
+	UINT32 pattern[64];
 
 	if (!hdcDest || !hdcSrc)
 		return 0;
@@ -430,475 +353,67 @@ static int BitBlt_DSPDxax_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWi
 
 	color32 = gdi_get_color_32bpp(hdcDest, hdcDest->textColor);
 
-	patp = (UINT32*) &color32;
-	hSrcBmp = (HGDI_BITMAP) hdcSrc->selectedObject;
-
-	if (hdcSrc->bytesPerPixel == 1)
-	{
-		/* DSPDxax, used to draw glyphs */
-
-		srcp = (UINT32*) & src32;
-
-		for (y = 0; y < nHeight; y++)
-		{
-			srcp8 = (BYTE*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-			dstp = (UINT32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-			if (dstp != 0)
-			{
-				for (x = 0; x < nWidth; x++)
-				{
-					*srcp = ((*srcp8) | (*srcp8 << 8) | (*srcp8 << 16) | (*srcp8 << 24));
-
-					*dstp = (*srcp & *patp) | (~(*srcp) & *dstp);
-					dstp++;
-
-					srcp8++;
-				}
-			}
-		}
-	}
-	else
-	{
-		for (y = 0; y < nHeight; y++)
-		{
-			srcp = (UINT32*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-			dstp = (UINT32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-			if (dstp != 0)
-			{
-				for (x = 0; x < nWidth; x++)
-				{
-					*dstp = (*srcp & *patp) | (~(*srcp) & *dstp);
-					srcp++;
-					dstp++;
-				}
-			}
-		}
-	}
-
-	return 1;
-}
-
-static int BitBlt_PSDPxax_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
-{
-	int x, y;
-	UINT32* srcp;
-	UINT32* dstp;
-	UINT32* patp;
-	UINT32 color32;
-
-	if (!hdcDest || !hdcSrc)
-		return 0;
-
-	/* D = (S & D) | (~S & P) */
-
-	if (hdcDest->brush->style == GDI_BS_SOLID)
-	{
-		color32 = gdi_get_color_32bpp(hdcDest, hdcDest->brush->color);
-		patp = (UINT32*) &color32;
-
-		for (y = 0; y < nHeight; y++)
-		{
-			srcp = (UINT32*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-			dstp = (UINT32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-			if (dstp != 0)
-			{
-				for (x = 0; x < nWidth; x++)
-				{
-					*dstp = (*srcp & *dstp) | (~(*srcp) & *patp);
-					srcp++;
-					dstp++;
-				}
-			}
-		}
-	}
-	else
-	{
-		for (y = 0; y < nHeight; y++)
-		{
-			srcp = (UINT32*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-			dstp = (UINT32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-			if (dstp != 0)
-			{
-				for (x = 0; x < nWidth; x++)
-				{
-					patp = (UINT32*) gdi_get_brush_pointer(hdcDest, x, y);
-					*dstp = (*srcp & *dstp) | (~(*srcp) & *patp);
-					srcp++;
-					dstp++;
-				}
-			}
-		}
-	}
-
-	return 1;
-}
-
-static int BitBlt_SPDSxax_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
-{
-	int x, y;
-	UINT32* srcp;
-	UINT32* dstp;
-	UINT32* patp;
-	UINT32 color32;
-
-	if (!hdcDest || !hdcSrc)
-		return 0;
-
-	/* D = S ^ (P & (D ^ S)) */
-
-	if (hdcDest->brush->style == GDI_BS_SOLID)
-	{
-		color32 = gdi_get_color_32bpp(hdcDest, hdcDest->brush->color);
-		patp = (UINT32*) &color32;
-
-		for (y = 0; y < nHeight; y++)
-		{
-			srcp = (UINT32*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-			dstp = (UINT32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-			if (dstp != 0)
-			{
-				for (x = 0; x < nWidth; x++)
-				{
-					*dstp = *srcp ^ (*patp & (*dstp ^ *srcp));
-					srcp++;
-					dstp++;
-				}
-			}
-		}
-	}
-	else
-	{
-		for (y = 0; y < nHeight; y++)
-		{
-			srcp = (UINT32*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-			dstp = (UINT32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-			if (dstp != 0)
-			{
-				for (x = 0; x < nWidth; x++)
-				{
-					patp = (UINT32*) gdi_get_brush_pointer(hdcDest, x, y);
-					*dstp = *srcp ^ (*patp & (*dstp ^ *srcp));
-					srcp++;
-					dstp++;
-				}
-			}
-		}
-	}
-
-	return 1;
-}
-
-static int BitBlt_SPna_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
-{
-	int x, y;
-	UINT32* srcp;
-	UINT32* dstp;
-	UINT32* patp;
-
-	if (!hdcDest || !hdcSrc)
-		return 0;
-
-	for (y = 0; y < nHeight; y++)
-	{
-		srcp = (UINT32*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-		dstp = (UINT32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{
-				patp = (UINT32*) gdi_get_brush_pointer(hdcDest, x, y);
-				
-				*dstp = *srcp & ~(*patp);
-				srcp++;
-				dstp++;
-			}
-		}
-	}
-	
-	return 1;
-}
-
-static int BitBlt_DSna_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
-{
-	int x, y;
-	UINT32* srcp;
-	UINT32* dstp;
-
-	if (!hdcDest || !hdcSrc)
-		return 0;
-
-	for (y = 0; y < nHeight; y++)
-	{
-		srcp = (UINT32*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-		dstp = (UINT32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{
-				*dstp = ~(*srcp) & (*dstp);
-				srcp++;
-				dstp++;
-			}
-		}
-	}
-
-	return 1;
-}
-
-static int BitBlt_DPa_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight)
-{
-	int x, y;
-	UINT32* dstp;
-	UINT32* patp;
-
-	for (y = 0; y < nHeight; y++)
+	if (hdcSrc->bytesPerPixel != 1)
 	{
-		dstp = (UINT32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{
-				patp = (UINT32*) gdi_get_brush_pointer(hdcDest, x, y);
+		for (x = 0; x < 64; x++)
+			pattern[x] = color32;
 
-				*dstp = *dstp & *patp;
-				dstp++;
-			}
-		}
+		return BitBlt_ROP3_32bpp(hdcDest, nXDest, nYDest, nWidth, nHeight,
+				hdcSrc, nXSrc, nYSrc, pattern, 0, 0, GDI_ROP3_INDEX(GDI_DSPDxax));
 	}
 
-	return 1;
-}
-
-static int BitBlt_PDxn_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight)
-{
-	int x, y;
-	UINT32* dstp;
-	UINT32* patp;
+	/* DSPDxax, used to draw glyphs */
 
 	for (y = 0; y < nHeight; y++)
 	{
+		srcp8 = (BYTE*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
 		dstp = (UINT32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
 
 		if (dstp != 0)
 		{
 			for (x = 0; x < nWidth; x++)
 			{
-				patp = (UINT32*) gdi_get_brush_pointer(hdcDest, x, y);
+				src32 = ((*srcp8) | (*srcp8 << 8) | (*srcp8 << 16) | (*srcp8 << 24));
 
-				*dstp = *dstp ^ ~(*patp);
+				*dstp = (src32 & color32) | (~src32 & *dstp);
 				dstp++;
-			}
-		}
-	}
 
-	return 1;
-}
-
-static int BitBlt_MERGECOPY_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
-{
-	int x, y;
-	UINT32* srcp;
-	UINT32* dstp;
-	UINT32* patp;
-	
-	if (!hdcDest || !hdcSrc)
-		return 0;
-
-	for (y = 0; y < nHeight; y++)
-	{
-		srcp = (UINT32*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-		dstp = (UINT32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{
-				patp = (UINT32*) gdi_get_brush_pointer(hdcDest, x, y);
-				
-				*dstp = *srcp & *patp;
-				srcp++;
-				dstp++;
+				srcp8++;
 			}
 		}
 	}
-	
-	return 1;
-}
 
-static int BitBlt_MERGEPAINT_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
-{
-	int x, y;
-	UINT32* srcp;
-	UINT32* dstp;
-	
-	if (!hdcDest || !hdcSrc)
-		return 0;
-
-	for (y = 0; y < nHeight; y++)
-	{
-		srcp = (UINT32*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-		dstp = (UINT32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{				
-				*dstp = ~(*srcp) | *dstp;
-				srcp++;
-				dstp++;
-			}
-		}
-	}
-	
 	return 1;
 }
 
 static int BitBlt_PATCOPY_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight)
 {
-	int x, y, xOffset, yOffset;
-	UINT32* dstp;
-	UINT32* patp;
-	UINT32 color32;
-
-	if (hdcDest->brush->style == GDI_BS_SOLID)
-	{
-		color32 = gdi_get_color_32bpp(hdcDest, hdcDest->brush->color);
+	int xOffset, yOffset;
+	UINT32 pattern[64];
 
-		for (y = 0; y < nHeight; y++)
-		{
-			dstp = (UINT32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
+	/* align pattern to 8x8 grid to make sure transition
+	between different pattern blocks are smooth */
 
-			if (dstp != 0)
-			{
-				for (x = 0; x < nWidth; x++)
-				{
-					*dstp = color32;
-					dstp++;
-				}
-			}
-		}
-	}
-	else
+	if (hdcDest->brush && (hdcDest->brush->style == GDI_BS_HATCHED))
 	{
-		/* align pattern to 8x8 grid to make sure transition
-		between different pattern blocks are smooth */
-
-		if (hdcDest->brush->style == GDI_BS_HATCHED)
-		{
-			xOffset = nXDest % 8;
-			yOffset = nYDest % 8 + 2; // +2 added after comparison to mstsc
-		}
-		else
-		{
-			xOffset = 0;
-			yOffset = 0;
-		}
-		for (y = 0; y < nHeight; y++)
-		{
-			dstp = (UINT32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-			if (dstp != 0)
-			{
-				for (x = 0; x < nWidth; x++)
-				{
-					patp = (UINT32*) gdi_get_brush_pointer(hdcDest, x+xOffset, y+yOffset);
-					*dstp = *patp;
-					dstp++;
-				}
-			}
-		}
-	}
-	
-	return 1;
-}
-
-static int BitBlt_PATINVERT_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight)
-{
-	int x, y;
-	UINT32* dstp;
-	UINT32* patp;
-	UINT32 color32;
-		
-	if (hdcDest->brush->style == GDI_BS_SOLID)
-	{
-		color32 = gdi_get_color_32bpp(hdcDest, hdcDest->brush->color);
-
-		for (y = 0; y < nHeight; y++)
-		{
-			dstp = (UINT32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-			if (dstp != 0)
-			{
-				for (x = 0; x < nWidth; x++)
-				{
-					*dstp ^= color32;
-					dstp++;
-				}
-			}
-		}
+		xOffset = nXDest % 8;
+		yOffset = nYDest % 8 + 2; // +2 added after comparison to mstsc
 	}
 	else
 	{
-		for (y = 0; y < nHeight; y++)
-		{
-			dstp = (UINT32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-			if (dstp != 0)
-			{
-				for (x = 0; x < nWidth; x++)
-				{
-					patp = (UINT32*) gdi_get_brush_pointer(hdcDest, x, y);
-					*dstp = *patp ^ *dstp;
-					dstp++;
-				}
-			}
-		}
+		xOffset = 0;
+		yOffset = 0;
 	}
 
-	return 1;
-}
-
-static int BitBlt_PATPAINT_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
-{
-	int x, y;
-	UINT32* srcp;
-	UINT32* dstp;
-	UINT32* patp;
-
-	if (!hdcDest || !hdcSrc)
-		return 0;
-
-	for (y = 0; y < nHeight; y++)
-	{
-		srcp = (UINT32*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-		dstp = (UINT32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{
-				patp = (UINT32*) gdi_get_brush_pointer(hdcDest, x, y);
-				*dstp = *dstp | (*patp | ~(*srcp));
-				srcp++;
-				dstp++;
-			}
-		}
-	}
-	
-	return 1;
+	return BitBlt_ROP3_32bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, NULL, 0, 0,
+			gdi_get_brush_pattern_32bpp(hdcDest, pattern), xOffset, yOffset, GDI_ROP3_INDEX(GDI_PATCOPY));
 }
 
 int BitBlt_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc, int rop)
 {
+	BYTE rop3;
+	UINT32 pattern[64];
+
 	if (!hdcDest)
 		return 0;
 
@@ -927,64 +442,31 @@ int BitBlt_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeigh
 		case GDI_SRCCOPY:
 			return BitBlt_SRCCOPY_32bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
 
-		case GDI_SPna:
-			return BitBlt_SPna_32bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
-
-		case GDI_DSna:
-			return BitBlt_DSna_32bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
-
 		case GDI_DSPDxax:
 			return BitBlt_DSPDxax_32bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
 
-		case GDI_PSDPxax:
-			return BitBlt_PSDPxax_32bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
-
-		case GDI_SPDSxax:
-			return BitBlt_SPDSxax_32bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
-
-		case GDI_NOTSRCCOPY:
-			return BitBlt_NOTSRCCOPY_32bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
-
-		case GDI_DSTINVERT:
-			return BitBlt_DSTINVERT_32bpp(hdcDest, nXDest, nYDest, nWidth, nHeight);
-
-		case GDI_SRCERASE:
-			return BitBlt_SRCERASE_32bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
-
-		case GDI_NOTSRCERASE:
-			return BitBlt_NOTSRCERASE_32bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
-
-		case GDI_SRCINVERT:
-			return BitBlt_SRCINVERT_32bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
-
-		case GDI_SRCAND:
-			return BitBlt_SRCAND_32bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
-
-		case GDI_SRCPAINT:
-			return BitBlt_SRCPAINT_32bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
-
-		case GDI_MERGECOPY:
-			return BitBlt_MERGECOPY_32bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
-
-		case GDI_MERGEPAINT:
-			return BitBlt_MERGEPAINT_32bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
-
 		case GDI_PATCOPY:
 			return BitBlt_PATCOPY_32bpp(hdcDest, nXDest, nYDest, nWidth, nHeight);
+	}
 
-		case GDI_PATINVERT:
-			return BitBlt_PATINVERT_32bpp(hdcDest, nXDest, nYDest, nWidth, nHeight);
+	rop3 = GDI_ROP3_INDEX(rop);
 
-		case GDI_PATPAINT:
-			return BitBlt_PATPAINT_32bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
+	if (GDI_ROP3_USES_SRC(rop3) && !hdcSrc)
+	{
+		WLog_ERR(TAG,  "BitBlt: no source for rop: 0x%08X", rop);
+		return 0;
 	}
 
-	WLog_ERR(TAG,  "BitBlt: unknown rop: 0x%08X", rop);
-	return 1;
+	return BitBlt_ROP3_32bpp(hdcDest, nXDest, nYDest, nWidth, nHeight,
+			GDI_ROP3_USES_SRC(rop3) ? hdcSrc : NULL, nXSrc, nYSrc,
+			GDI_ROP3_USES_PAT(rop3) ? gdi_get_brush_pattern_32bpp(hdcDest, pattern) : NULL, 0, 0, rop3);
 }
 
 int PatBlt_32bpp(HGDI_DC hdc, int nXLeft, int nYLeft, int nWidth, int nHeight, int rop)
 {
+	BYTE rop3;
+	UINT32 pattern[64];
+
 	if (gdi_ClipCoords(hdc, &nXLeft, &nYLeft, &nWidth, &nHeight, NULL, NULL) == 0)
 		return 0;
 	
@@ -996,30 +478,23 @@ int PatBlt_32bpp(HGDI_DC hdc, int nXLeft, int nYLeft, int nWidth, int nHeight, i
 		case GDI_PATCOPY:
 			return BitBlt_PATCOPY_32bpp(hdc, nXLeft, nYLeft, nWidth, nHeight);
 
-		case GDI_PATINVERT:
-			return BitBlt_PATINVERT_32bpp(hdc, nXLeft, nYLeft, nWidth, nHeight);
-
-		case GDI_DSTINVERT:
-			return BitBlt_DSTINVERT_32bpp(hdc, nXLeft, nYLeft, nWidth, nHeight);
-
 		case GDI_BLACKNESS:
 			return BitBlt_BLACKNESS_32bpp(hdc, nXLeft, nYLeft, nWidth, nHeight);
 
 		case GDI_WHITENESS:
 			return BitBlt_WHITENESS_32bpp(hdc, nXLeft, nYLeft, nWidth, nHeight);
+	}
 
-		case GDI_DPa:
-			return BitBlt_DPa_32bpp(hdc, nXLeft, nYLeft, nWidth, nHeight);
-
-		case GDI_PDxn:
-			return BitBlt_PDxn_32bpp(hdc, nXLeft, nYLeft, nWidth, nHeight);
+	rop3 = GDI_ROP3_INDEX(rop);
 
-		default:
-			break;
+	if (GDI_ROP3_USES_SRC(rop3))
+	{
+		WLog_ERR(TAG,  "PatBlt: unknown rop: 0x%08X", rop);
+		return 1;
 	}
 
-	WLog_ERR(TAG,  "PatBlt: unknown rop: 0x%08X", rop);
-	return 1;
+	return BitBlt_ROP3_32bpp(hdc, nXLeft, nYLeft, nWidth, nHeight, NULL, 0, 0,
+			GDI_ROP3_USES_PAT(rop3) ? gdi_get_brush_pattern_32bpp(hdc, pattern) : NULL, 0, 0, rop3);
 }
 
 static INLINE void SetPixel_BLACK_32bpp(UINT32* pixel, UINT32* pen)
@@ -25,10 +25,13 @@
 #include <stdlib.h>
 
 #include <winpr/crt.h>
+#include <winpr/sysinfo.h>
+#include <winpr/interlocked.h>
 
 #include <freerdp/api.h>
 #include <freerdp/log.h>
 #include <freerdp/freerdp.h>
+#include <freerdp/primitives.h>
 
 #include <freerdp/gdi/dc.h>
 #include <freerdp/gdi/pen.h>
@@ -441,110 +444,338 @@ void gdi_bitmap_free_ex(gdiBitmap* bitmap)
 	}
 }
 
-static BOOL gdi_bitmap_update(rdpContext* context, BITMAP_UPDATE* bitmapUpdate)
+struct gdi_bitmap_worker
+{
+	rdpGdi* gdi;
+	PTP_WORK work;
+
+	UINT32 bitmap_size;
+	BYTE* bitmap_buffer;
+	BITMAP_PLANAR_CONTEXT* planar;
+	BITMAP_INTERLEAVED_CONTEXT* interleaved;
+};
+
+/**
+ * Decodes a single bitmap update rectangle. Rectangles which are not clipped
+ * are decoded at their destination in the primary surface, others are decoded
+ * into the bitmap buffer of the worker and then copied to their clipped
+ * destination. Planar and uncompressed rectangles are written straight into
+ * the surface. The interleaved decoder still expands its RLE data into its own
+ * buffer at the wire color depth and converts from there.
+ */
+
+static BOOL gdi_bitmap_decode(rdpGdi* gdi, gdiBitmapWorker* worker, BITMAP_DATA* bitmap)
 {
 	int status;
 	int nXDst;
 	int nYDst;
-	int nXSrc;
-	int nYSrc;
 	int nWidth;
 	int nHeight;
 	int nSrcStep;
 	int nDstStep;
-	UINT32 index;
+	int nClipWidth;
+	int nClipHeight;
+	BOOL direct;
 	BYTE* pSrcData;
 	BYTE* pDstData;
 	UINT32 SrcSize;
-	BOOL compressed;
 	UINT32 SrcFormat;
 	UINT32 bitsPerPixel;
-	BITMAP_DATA* bitmap;
-	rdpGdi* gdi = context->gdi;
-	rdpCodecs* codecs = context->codecs;
-
-	for (index = 0; index < bitmapUpdate->number; index++)
-	{
-		bitmap = &(bitmapUpdate->rectangles[index]);
 
-		nXSrc = 0;
-		nYSrc = 0;
+	nXDst = bitmap->destLeft;
+	nYDst = bitmap->destTop;
 
-		nXDst = bitmap->destLeft;
-		nYDst = bitmap->destTop;
+	nWidth = bitmap->width;
+	nHeight = bitmap->height;
 
-		nWidth = bitmap->width;
-		nHeight = bitmap->height;
+	nClipWidth = bitmap->destRight - bitmap->destLeft + 1;
+	nClipHeight = bitmap->destBottom - bitmap->destTop + 1;
 
-		pSrcData = bitmap->bitmapDataStream;
-		SrcSize = bitmap->bitmapLength;
+	pSrcData = bitmap->bitmapDataStream;
+	SrcSize = bitmap->bitmapLength;
+	bitsPerPixel = bitmap->bitsPerPixel;
 
-		compressed = bitmap->compressed;
-		bitsPerPixel = bitmap->bitsPerPixel;
+	direct = ((nClipWidth == nWidth) && (nClipHeight == nHeight) &&
+			((nXDst + nWidth) <= gdi->width) && ((nYDst + nHeight) <= gdi->height)) ? TRUE : FALSE;
 
-		if (gdi->bitmap_size < (UINT32) (nWidth * nHeight * 4))
+	if (direct)
+	{
+		pDstData = gdi->primary_buffer;
+		nDstStep = gdi->width * gdi->bytesPerPixel;
+	}
+	else
+	{
+		if (worker->bitmap_size < (UINT32) (nWidth * nHeight * 4))
 		{
-			gdi->bitmap_size = nWidth * nHeight * 4;
-			gdi->bitmap_buffer = (BYTE*) _aligned_realloc(gdi->bitmap_buffer, gdi->bitmap_size, 16);
+			worker->bitmap_size = nWidth * nHeight * 4;
+			worker->bitmap_buffer = (BYTE*) _aligned_realloc(worker->bitmap_buffer, worker->bitmap_size, 16);
 
-			if (!gdi->bitmap_buffer)
+			if (!worker->bitmap_buffer)
+			{
+				worker->bitmap_size = 0;
 				return FALSE;
+			}
 		}
 
-		if (compressed)
+		pDstData = worker->bitmap_buffer;
+		nDstStep = nWidth * gdi->bytesPerPixel;
+		nXDst = nYDst = 0;
+	}
+
+	if (bitmap->compressed)
+	{
+		if (bitsPerPixel < 32)
 		{
-			pDstData = gdi->bitmap_buffer;
+			status = interleaved_decompress(worker->interleaved, pSrcData, SrcSize, bitsPerPixel,
+					&pDstData, gdi->format, nDstStep, nXDst, nYDst, nWidth, nHeight, gdi->palette);
+		}
+		else
+		{
+			status = planar_decompress(worker->planar, pSrcData, SrcSize, &pDstData,
+					gdi->format, nDstStep, nXDst, nYDst, nWidth, nHeight, TRUE);
+		}
 
-			if (bitsPerPixel < 32)
-			{
-				if (!freerdp_client_codecs_prepare(codecs, FREERDP_CODEC_INTERLEAVED))
-					return FALSE;
+		if (status < 0)
+		{
+			WLog_ERR(TAG, "bitmap decompression failure");
+			return FALSE;
+		}
+	}
+	else
+	{
+		SrcFormat = gdi_get_pixel_format(bitsPerPixel, TRUE);
 
-				status = interleaved_decompress(codecs->interleaved, pSrcData, SrcSize, bitsPerPixel,
-						&pDstData, gdi->format, -1, 0, 0, nWidth, nHeight, gdi->palette);
-			}
-			else
-			{
-				if (!freerdp_client_codecs_prepare(codecs, FREERDP_CODEC_PLANAR))
-					return FALSE;
+		status = freerdp_image_copy(pDstData, gdi->format, nDstStep, nXDst, nYDst,
+					nWidth, nHeight, pSrcData, SrcFormat, -1, 0, 0, gdi->palette);
+	}
 
-				status = planar_decompress(codecs->planar, pSrcData, SrcSize, &pDstData,
-						gdi->format, -1, 0, 0, nWidth, nHeight, TRUE);
-			}
+	if (direct)
+		return TRUE;
 
-			if (status < 0)
-			{
-				WLog_ERR(TAG, "bitmap decompression failure");
-				return FALSE;
-			}
+	nSrcStep = nWidth * gdi->bytesPerPixel;
 
-			pSrcData = gdi->bitmap_buffer;
+	pSrcData = worker->bitmap_buffer;
+	pDstData = gdi->primary_buffer;
+	nDstStep = gdi->width * gdi->bytesPerPixel;
+
+	status = freerdp_image_copy(pDstData, gdi->format, nDstStep, bitmap->destLeft, bitmap->destTop,
+			nClipWidth, nClipHeight, pSrcData, gdi->format, nSrcStep, 0, 0, gdi->palette);
+
+	return TRUE;
+}
+
+static void gdi_bitmap_decode_rectangles(rdpGdi* gdi, gdiBitmapWorker* worker)
+{
+	LONG index;
+	BITMAP_UPDATE* bitmapUpdate = gdi->bitmapUpdate;
+
+	while ((index = InterlockedIncrement(&gdi->bitmapIndex) - 1) < (LONG) bitmapUpdate->number)
+	{
+		if (!gdi_bitmap_decode(gdi, worker, &(bitmapUpdate->rectangles[index])))
+			InterlockedExchange(&gdi->bitmapFailed, TRUE);
+	}
+}
+
+static void CALLBACK gdi_bitmap_work_callback(PTP_CALLBACK_INSTANCE instance, void* context, PTP_WORK work)
+{
+	gdiBitmapWorker* worker = (gdiBitmapWorker*) context;
+
+	gdi_bitmap_decode_rectangles(worker->gdi, worker);
+}
+
+/**
+ * Rectangles of a bitmap update can only be decoded concurrently when
+ * none of their destinations overlap, otherwise the order matters.
+ */
+
+static BOOL gdi_bitmap_update_overlaps(BITMAP_UPDATE* bitmapUpdate)
+{
+	UINT32 i, j;
+	BITMAP_DATA* a;
+	BITMAP_DATA* b;
+
+	for (i = 0; i < bitmapUpdate->number; i++)
+	{
+		a = &(bitmapUpdate->rectangles[i]);
+
+		for (j = i + 1; j < bitmapUpdate->number; j++)
+		{
+			b = &(bitmapUpdate->rectangles[j]);
+
+			if ((a->destLeft <= b->destRight) && (b->destLeft <= a->destRight) &&
+					(a->destTop <= b->destBottom) && (b->destTop <= a->destBottom))
+				return TRUE;
 		}
-		else
+	}
+
+	return FALSE;
+}
+
+static BOOL gdi_init_bitmap_workers(rdpGdi* gdi)
+{
+	int index;
+	int numWorkers;
+	gdiBitmapWorker* worker;
+
+	gdi->bitmapWorkersInit = TRUE;
+	numWorkers = gdi->maxBitmapWorkers;
+
+	if (numWorkers < 1)
+		return TRUE;
+
+	/* initialize the primitives before they get used from several threads */
+	primitives_get();
+
+	gdi->bitmapThreadPool = CreateThreadpool(NULL);
+
+	if (!gdi->bitmapThreadPool)
+		return FALSE;
+
+	InitializeThreadpoolEnvironment(&gdi->bitmapThreadPoolEnv);
+	SetThreadpoolCallbackPool(&gdi->bitmapThreadPoolEnv, gdi->bitmapThreadPool);
+	SetThreadpoolThreadMaximum(gdi->bitmapThreadPool, numWorkers);
+
+	gdi->bitmapWorkers = (gdiBitmapWorker*) calloc(numWorkers, sizeof(gdiBitmapWorker));
+
+	if (!gdi->bitmapWorkers)
+		return FALSE;
+
+	for (index = 0; index < numWorkers; index++)
+	{
+		worker = &gdi->bitmapWorkers[index];
+		worker->gdi = gdi;
+
+		if (!(worker->interleaved = bitmap_interleaved_context_new(FALSE)))
+			return FALSE;
+
+		if (!(worker->planar = freerdp_bitmap_planar_context_new(FALSE, 64, 64)))
 		{
-			pDstData = gdi->bitmap_buffer;
-			SrcFormat = gdi_get_pixel_format(bitsPerPixel, TRUE);
+			bitmap_interleaved_context_free(worker->interleaved);
+			return FALSE;
+		}
 
-			status = freerdp_image_copy(pDstData, gdi->format, -1, 0, 0,
-						nWidth, nHeight, pSrcData, SrcFormat, -1, 0, 0, gdi->palette);
+		worker->work = CreateThreadpoolWork((PTP_WORK_CALLBACK) gdi_bitmap_work_callback,
+				(void*) worker, &gdi->bitmapThreadPoolEnv);
 
-			pSrcData = gdi->bitmap_buffer;
+		if (!worker->work)
+		{
+			freerdp_bitmap_planar_context_free(worker->planar);
+			bitmap_interleaved_context_free(worker->interleaved);
+			return FALSE;
 		}
 
-		nSrcStep = nWidth * gdi->bytesPerPixel;
+		gdi->numBitmapWorkers++;
+	}
 
-		pDstData = gdi->primary_buffer;
-		nDstStep = gdi->width * gdi->bytesPerPixel;
+	return TRUE;
+}
 
-		nWidth = bitmap->destRight - bitmap->destLeft + 1; /* clip width */
-		nHeight = bitmap->destBottom - bitmap->destTop + 1; /* clip height */
+static void gdi_uninit_bitmap_workers(rdpGdi* gdi)
+{
+	int index;
+	gdiBitmapWorker* worker;
 
-		status = freerdp_image_copy(pDstData, gdi->format, nDstStep, nXDst, nYDst,
-				nWidth, nHeight, pSrcData, gdi->format, nSrcStep, nXSrc, nYSrc, gdi->palette);
+	if (gdi->bitmapWorkers)
+	{
+		for (index = 0; index < gdi->numBitmapWorkers; index++)
+		{
+			worker = &gdi->bitmapWorkers[index];
+
+			CloseThreadpoolWork(worker->work);
+			freerdp_bitmap_planar_context_free(worker->planar);
+			bitmap_interleaved_context_free(worker->interleaved);
+			_aligned_free(worker->bitmap_buffer);
+		}
+
+		free(gdi->bitmapWorkers);
+		gdi->bitmapWorkers = NULL;
+	}
+
+	gdi->numBitmapWorkers = 0;
+
+	if (gdi->bitmapThreadPool)
+	{
+		CloseThreadpool(gdi->bitmapThreadPool);
+		DestroyThreadpoolEnvironment(&gdi->bitmapThreadPoolEnv);
+		gdi->bitmapThreadPool = NULL;
+	}
+}
+
+static BOOL gdi_bitmap_update(rdpContext* context, BITMAP_UPDATE* bitmapUpdate)
+{
+	int index;
+	int numWorkers;
+	UINT32 codecFlags = 0;
+	BITMAP_DATA* bitmap;
+	gdiBitmapWorker worker;
+	rdpGdi* gdi = context->gdi;
+	rdpCodecs* codecs = context->codecs;
+
+	for (index = 0; index < (int) bitmapUpdate->number; index++)
+	{
+		bitmap = &(bitmapUpdate->rectangles[index]);
+
+		if (bitmap->compressed)
+			codecFlags |= (bitmap->bitsPerPixel < 32) ? FREERDP_CODEC_INTERLEAVED : FREERDP_CODEC_PLANAR;
+	}
+
+	if (codecFlags && !freerdp_client_codecs_prepare(codecs, codecFlags))
+		return FALSE;
+
+	/* the calling thread decodes with the shared codec contexts and buffer */
+	ZeroMemory(&worker, sizeof(gdiBitmapWorker));
+	worker.gdi = gdi;
+	worker.planar = codecs->planar;
+	worker.interleaved = codecs->interleaved;
+	worker.bitmap_size = gdi->bitmap_size;
+	worker.bitmap_buffer = gdi->bitmap_buffer;
+
+	gdi->bitmapUpdate = bitmapUpdate;
+	gdi->bitmapIndex = 0;
+	gdi->bitmapFailed = FALSE;
+
+	numWorkers = 0;
 
-		if (!gdi_InvalidateRegion(gdi->primary->hdc, nXDst, nYDst, nWidth, nHeight))
+	if (((int) bitmapUpdate->number > 1) && (gdi->maxBitmapWorkers > 0) &&
+			!gdi_bitmap_update_overlaps(bitmapUpdate))
+	{
+		/* sessions which never split their bitmap updates do not get a pool */
+		if (!gdi->bitmapWorkersInit && !gdi_init_bitmap_workers(gdi))
+		{
+			WLog_WARN(TAG, "failed to create the bitmap decoding threads, decoding serially");
+			gdi_uninit_bitmap_workers(gdi);
+		}
+
+		numWorkers = gdi->numBitmapWorkers;
+
+		if (numWorkers > ((int) bitmapUpdate->number - 1))
+			numWorkers = (int) bitmapUpdate->number - 1;
+	}
+
+	for (index = 0; index < numWorkers; index++)
+		SubmitThreadpoolWork(gdi->bitmapWorkers[index].work);
+
+	gdi_bitmap_decode_rectangles(gdi, &worker);
+
+	for (index = 0; index < numWorkers; index++)
+		WaitForThreadpoolWorkCallbacks(gdi->bitmapWorkers[index].work, FALSE);
+
+	gdi->bitmap_size = worker.bitmap_size;
+	gdi->bitmap_buffer = worker.bitmap_buffer;
+	gdi->bitmapUpdate = NULL;
+
+	if (gdi->bitmapFailed)
+		return FALSE;
+
+	for (index = 0; index < (int) bitmapUpdate->number; index++)
+	{
+		bitmap = &(bitmapUpdate->rectangles[index]);
+
+		if (!gdi_InvalidateRegion(gdi->primary->hdc, bitmap->destLeft, bitmap->destTop,
+				bitmap->destRight - bitmap->destLeft + 1, bitmap->destBottom - bitmap->destTop + 1))
 			return FALSE;
 	}
+
 	return TRUE;
 }
 
@@ -1266,6 +1497,7 @@ BOOL gdi_init(freerdp* instance, UINT32 flags, BYTE* buffer)
 	BOOL rgb555;
 	rdpGdi* gdi;
 	rdpCache* cache = NULL;
+	SYSTEM_INFO sysinfo;
 
 	gdi = (rdpGdi*) calloc(1, sizeof(rdpGdi));
 
@@ -1373,6 +1605,13 @@ BOOL gdi_init(freerdp* instance, UINT32 flags, BYTE* buffer)
 	if (!gdi_register_graphics(instance->context->graphics))
 		goto fail_register_graphics;
 
+	/* the calling thread decodes rectangles as well */
+	GetNativeSystemInfo(&sysinfo);
+	gdi->maxBitmapWorkers = (int) sysinfo.dwNumberOfProcessors - 1;
+
+	if (gdi->maxBitmapWorkers > 15)
+		gdi->maxBitmapWorkers = 15;
+
 	instance->update->BitmapUpdate = gdi_bitmap_update;
 
 	return TRUE;
@@ -1408,6 +1647,7 @@ void gdi_free(freerdp* instance)
 		gdi_bitmap_free_ex(gdi->tile);
 		gdi_bitmap_free_ex(gdi->image);
 		gdi_DeleteDC(gdi->hdc);
+		gdi_uninit_bitmap_workers(gdi);
 		_aligned_free(gdi->bitmap_buffer);
 		free(gdi);
 	}
@@ -336,7 +336,6 @@ int gdi_SurfaceCommand_Planar(rdpGdi* gdi, RdpgfxClientContext* context, RDPGFX_
 int gdi_SurfaceCommand_H264(rdpGdi* gdi, RdpgfxClientContext* context, RDPGFX_SURFACE_COMMAND* cmd)
 {
 	int status;
-	UINT32 i;
 	BYTE* DstData = NULL;
 	gdiGfxSurface* surface;
 	RDPGFX_H264_METABLOCK* meta;
@@ -369,10 +368,8 @@ int gdi_SurfaceCommand_H264(rdpGdi* gdi, RdpgfxClientContext* context, RDPGFX_SU
 		return -1;
 	}
 
-	for (i = 0; i < meta->numRegionRects; i++)
-	{
-		region16_union_rect(&(gdi->invalidRegion), &(gdi->invalidRegion), (RECTANGLE_16*) &(meta->regionRects[i]));
-	}
+	region16_union_rects(&(gdi->invalidRegion), &(gdi->invalidRegion),
+			(RECTANGLE_16*) meta->regionRects, meta->numRegionRects);
 
 	if (!gdi->inGfxFrame)
 		gdi_OutputUpdate(gdi);
@@ -30,6 +30,9 @@
 #include <freerdp/gdi/region.h>
 #include <freerdp/gdi/bitmap.h>
 #include <freerdp/gdi/drawing.h>
+#include <freerdp/gdi/8bpp.h>
+#include <freerdp/gdi/16bpp.h>
+#include <freerdp/gdi/32bpp.h>
 
 #include "graphics.h"
 
@@ -224,37 +227,31 @@ BOOL gdi_Bitmap_SetSurface(rdpContext* context, rdpBitmap* bitmap, BOOL primary)
 
 /* Glyph Class */
 
+/**
+ * Glyphs keep their 1bpp mask and are expanded straight into the drawing
+ * surface. Glyph_BeginDraw computes the clipping rectangle and the text
+ * color once for the whole run of glyphs of an order, and Glyph_EndDraw
+ * invalidates the area covered by the run at once.
+ */
+
 BOOL gdi_Glyph_New(rdpContext* context, rdpGlyph* glyph)
 {
-	BYTE* data;
+	UINT32 size;
 	gdiGlyph* gdi_glyph;
 
 	gdi_glyph = (gdiGlyph*) glyph;
 
-	gdi_glyph->hdc = gdi_GetDC();
-	if (!gdi_glyph->hdc)
-		return FALSE;
-	gdi_glyph->hdc->bytesPerPixel = 1;
-	gdi_glyph->hdc->bitsPerPixel = 1;
+	gdi_glyph->maskStride = (glyph->cx + 7) / 8;
+	size = gdi_glyph->maskStride * glyph->cy;
 
-	data = freerdp_glyph_convert(glyph->cx, glyph->cy, glyph->aj);
-	if (!data)
-	{
-		gdi_DeleteDC(gdi_glyph->hdc);
-		return FALSE;
-	}
-	gdi_glyph->bitmap = gdi_CreateBitmap(glyph->cx, glyph->cy, 1, data);
-	if (!gdi_glyph->bitmap)
-	{
-		gdi_DeleteDC(gdi_glyph->hdc);
-		_aligned_free(data);
+	gdi_glyph->mask = (BYTE*) calloc(1, size ? size : 1);
+
+	if (!gdi_glyph->mask)
 		return FALSE;
-	}
-	gdi_glyph->bitmap->bytesPerPixel = 1;
-	gdi_glyph->bitmap->bitsPerPixel = 1;
 
-	gdi_SelectObject(gdi_glyph->hdc, (HGDIOBJECT) gdi_glyph->bitmap);
-	gdi_glyph->org_bitmap = NULL;
+	if (glyph->aj)
+		CopyMemory(gdi_glyph->mask, glyph->aj, (glyph->cb < size) ? glyph->cb : size);
+
 	return TRUE;
 }
 
@@ -266,23 +263,192 @@ void gdi_Glyph_Free(rdpContext* context, rdpGlyph* glyph)
 
 	if (gdi_glyph)
 	{
-		gdi_SelectObject(gdi_glyph->hdc, (HGDIOBJECT) gdi_glyph->org_bitmap);
-		gdi_DeleteObject((HGDIOBJECT) gdi_glyph->bitmap);
-		gdi_DeleteDC(gdi_glyph->hdc);
+		free(gdi_glyph->mask);
+		gdi_glyph->mask = NULL;
+	}
+}
+
+static void gdi_glyph_run_begin(rdpGdi* gdi, GDI_COLOR textColor)
+{
+	GDI_RECT clip;
+	HGDI_DC hdc = gdi->drawing->hdc;
+	HGDI_BITMAP hBmp = (HGDI_BITMAP) hdc->selectedObject;
+	gdiGlyphRun* run = &gdi->glyphRun;
+
+	run->active = TRUE;
+
+	switch (hdc->bytesPerPixel)
+	{
+		case 4:
+			run->color = gdi_get_color_32bpp(hdc, textColor);
+			break;
+
+		case 2:
+			run->color = gdi_get_color_16bpp(hdc, textColor);
+			break;
+
+		default:
+			run->color = gdi_get_color_8bpp(hdc, textColor);
+			break;
+	}
+
+	/* same clipping rectangle as gdi_ClipCoords, right and bottom inclusive */
+	gdi_CRgnToRect(0, 0, hBmp->width, hBmp->height, &run->clip);
+
+	if (!hdc->clip->null)
+	{
+		gdi_RgnToRect(hdc->clip, &clip);
+
+		if (clip.left > run->clip.left)
+			run->clip.left = clip.left;
+
+		if (clip.top > run->clip.top)
+			run->clip.top = clip.top;
+
+		if (clip.right < run->clip.right)
+			run->clip.right = clip.right;
+
+		if (clip.bottom < run->clip.bottom)
+			run->clip.bottom = clip.bottom;
+	}
+
+	run->bounds.left = run->bounds.top = 0;
+	run->bounds.right = run->bounds.bottom = -1;
+}
+
+static BOOL gdi_glyph_run_end(rdpGdi* gdi)
+{
+	gdiGlyphRun* run = &gdi->glyphRun;
+
+	run->active = FALSE;
+
+	if ((run->bounds.right < run->bounds.left) || (run->bounds.bottom < run->bounds.top))
+		return TRUE;
+
+	return gdi_InvalidateRegion(gdi->drawing->hdc, run->bounds.left, run->bounds.top,
+			run->bounds.right - run->bounds.left + 1, run->bounds.bottom - run->bounds.top + 1);
+}
+
+/**
+ * Expands the mask rows of a glyph between the clipped columns, a mask
+ * byte at a time so that the empty parts of the glyph cost nothing.
+ */
+
+#define GDI_GLYPH_RUN_ROWS(_type) \
+	for (row = top; row <= bottom; row++) \
+	{ \
+		_type* _dst = ((_type*) dst) + x; \
+		for (bit = left - x; bit <= right - x; bit = last + 1) \
+		{ \
+			last = bit | 7; \
+			if (last > right - x) \
+				last = right - x; \
+			bits = src[bit >> 3] & (0xFF >> (bit & 7)) & (0xFF << (7 - (last & 7))); \
+			for (col = bit & ~7; bits; bits = (BYTE) (bits << 1), col++) \
+			{ \
+				if (bits & 0x80) \
+					_dst[col] = (_type) run->color; \
+			} \
+		} \
+		src += gdi_glyph->maskStride; \
+		dst += dstStep; \
+	}
+
+static void gdi_glyph_run_draw(rdpGdi* gdi, gdiGlyph* gdi_glyph, int x, int y)
+{
+	int bit;
+	int row;
+	int col;
+	int last;
+	int left, top;
+	int right, bottom;
+	BYTE bits;
+	BYTE* src;
+	BYTE* dst;
+	int bpp;
+	int dstStep;
+	HGDI_DC hdc = gdi->drawing->hdc;
+	HGDI_BITMAP hBmp = (HGDI_BITMAP) hdc->selectedObject;
+	gdiGlyphRun* run = &gdi->glyphRun;
+	rdpGlyph* glyph = &gdi_glyph->_p;
+
+	left = (x > run->clip.left) ? x : run->clip.left;
+	top = (y > run->clip.top) ? y : run->clip.top;
+	right = x + (int) glyph->cx - 1;
+	bottom = y + (int) glyph->cy - 1;
+
+	if (right > run->clip.right)
+		right = run->clip.right;
+
+	if (bottom > run->clip.bottom)
+		bottom = run->clip.bottom;
+
+	bpp = hdc->bytesPerPixel;
+
+	/* like gdi_BitBlt, there is nothing to draw with on other surfaces */
+	if ((bpp != 1) && (bpp != 2) && (bpp != 4))
+		return;
+
+	if ((left > right) || (top > bottom))
+		return;
+
+	if (run->bounds.right < run->bounds.left)
+	{
+		run->bounds.left = left;
+		run->bounds.top = top;
+		run->bounds.right = right;
+		run->bounds.bottom = bottom;
+	}
+	else
+	{
+		if (left < run->bounds.left)
+			run->bounds.left = left;
+
+		if (top < run->bounds.top)
+			run->bounds.top = top;
+
+		if (right > run->bounds.right)
+			run->bounds.right = right;
+
+		if (bottom > run->bounds.bottom)
+			run->bounds.bottom = bottom;
+	}
+
+	dstStep = hBmp->width * bpp;
+	dst = &hBmp->data[top * dstStep];
+	src = &gdi_glyph->mask[(top - y) * gdi_glyph->maskStride];
+
+	switch (bpp)
+	{
+		case 4:
+			GDI_GLYPH_RUN_ROWS(UINT32);
+			break;
+
+		case 2:
+			GDI_GLYPH_RUN_ROWS(UINT16);
+			break;
+
+		default:
+			GDI_GLYPH_RUN_ROWS(BYTE);
+			break;
 	}
 }
 
 BOOL gdi_Glyph_Draw(rdpContext* context, rdpGlyph* glyph, int x, int y)
 {
-	gdiGlyph* gdi_glyph;
 	rdpGdi* gdi = context->gdi;
 
-	gdi_glyph = (gdiGlyph*) glyph;
+	if (gdi->glyphRun.active)
+	{
+		gdi_glyph_run_draw(gdi, (gdiGlyph*) glyph, x, y);
+		return TRUE;
+	}
 
-	if (gdi_BitBlt(gdi->drawing->hdc, x, y, gdi_glyph->bitmap->width,
-			gdi_glyph->bitmap->height, gdi_glyph->hdc, 0, 0, GDI_DSPDxax) == 0)
-		return FALSE;
-	return TRUE;
+	/* drawn outside of Glyph_BeginDraw/Glyph_EndDraw, as a run of one */
+	gdi_glyph_run_begin(gdi, gdi->drawing->hdc->textColor);
+	gdi_glyph_run_draw(gdi, (gdiGlyph*) glyph, x, y);
+
+	return gdi_glyph_run_end(gdi);
 }
 
 BOOL gdi_Glyph_BeginDraw(rdpContext* context, int x, int y, int width, int height, UINT32 bgcolor, UINT32 fgcolor, BOOL fOpRedundant)
@@ -309,7 +475,13 @@ out_fail:
 	gdi->textColor = gdi_SetTextColor(gdi->drawing->hdc, bgcolor);
 
 	if (ret == 0)
+	{
+		/* no run was started, glyphs drawn anyway are runs of one */
+		gdi->glyphRun.active = FALSE;
 		return FALSE;
+	}
+
+	gdi_glyph_run_begin(gdi, bgcolor);
 	return TRUE;
 }
 
@@ -319,7 +491,8 @@ BOOL gdi_Glyph_EndDraw(rdpContext* context, int x, int y, int width, int height,
 
 	bgcolor = freerdp_convert_gdi_order_color(bgcolor, gdi->srcBpp, gdi->format, gdi->palette);
 	gdi->textColor = gdi_SetTextColor(gdi->drawing->hdc, bgcolor);
-	return TRUE;
+
+	return gdi_glyph_run_end(gdi);
 }
 
 /* Graphics Module */
@@ -0,0 +1,494 @@
+#include <winpr/crt.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/gdi/gdi.h>
+#include <freerdp/gdi/dc.h>
+#include <freerdp/gdi/brush.h>
+#include <freerdp/gdi/bitmap.h>
+#include <freerdp/gdi/32bpp.h>
+#include <freerdp/primitives.h>
+
+/**
+ * Checks the ternary raster operations of the rop3_32u primitive, general
+ * and optimized, and of the 32bpp BitBlt and PatBlt that use it, against a
+ * bit by bit evaluation of the truth table of every ROP. The throughput of
+ * the general and optimized versions is printed for the common ROPs.
+ */
+
+extern pstatus_t general_rop3_32u(const UINT32* pSrc, INT32 srcStep,
+	const UINT32* pPat, UINT32 patX, UINT32 patY,
+	UINT32* pDst, INT32 dstStep,
+	UINT32 width, UINT32 height, BYTE rop);
+
+#define TEST_ROP_PITCH		80
+#define TEST_ROP_ROWS		4
+#define TEST_ROP_BENCH_WIDTH	1024
+#define TEST_ROP_BENCH_HEIGHT	768
+#define TEST_ROP_BENCH_ITERATIONS	20
+
+typedef struct
+{
+	const char* name;
+	UINT32 rop;
+} TEST_ROP;
+
+static const TEST_ROP test_rops[] =
+{
+	{ "SRCCOPY", GDI_SRCCOPY },
+	{ "SRCPAINT", GDI_SRCPAINT },
+	{ "SRCAND", GDI_SRCAND },
+	{ "SRCINVERT", GDI_SRCINVERT },
+	{ "SRCERASE", GDI_SRCERASE },
+	{ "NOTSRCCOPY", GDI_NOTSRCCOPY },
+	{ "NOTSRCERASE", GDI_NOTSRCERASE },
+	{ "MERGECOPY", GDI_MERGECOPY },
+	{ "MERGEPAINT", GDI_MERGEPAINT },
+	{ "PATCOPY", GDI_PATCOPY },
+	{ "PATPAINT", GDI_PATPAINT },
+	{ "PATINVERT", GDI_PATINVERT },
+	{ "DSTINVERT", GDI_DSTINVERT },
+	{ "DSPDxax", GDI_DSPDxax },
+	{ "PSDPxax", GDI_PSDPxax },
+	{ "SPDSxax", GDI_SPDSxax },
+	{ "SPna", GDI_SPna },
+	{ "DSna", GDI_DSna },
+	{ "DPa", GDI_DPa },
+	{ "PDxn", GDI_PDxn },
+	{ "DSxn", GDI_DSxn },
+	{ "PSDnox", GDI_PSDnox },
+	{ "DPSDonox", GDI_DPSDonox },
+};
+
+#define TEST_ROP_COUNT	(sizeof(test_rops) / sizeof(test_rops[0]))
+
+static UINT32 test_rand_seed = 0x12345678;
+
+static UINT32 test_rand(void)
+{
+	test_rand_seed = test_rand_seed * 1103515245 + 12345;
+	return (test_rand_seed >> 16) | (test_rand_seed << 16);
+}
+
+static void test_fill(UINT32* data, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		data[i] = test_rand();
+}
+
+static UINT32 test_rop3_pixel(BYTE rop, UINT32 S, UINT32 P, UINT32 D)
+{
+	int bit;
+	int index;
+	UINT32 result = 0;
+
+	for (bit = 0; bit < 32; bit++)
+	{
+		index = (((P >> bit) & 1) << 2) | (((S >> bit) & 1) << 1) | ((D >> bit) & 1);
+		result |= ((rop >> index) & 1) << bit;
+	}
+
+	return result;
+}
+
+static BOOL test_rop3_primitive(__rop3_32u_t rop3, const char* impl)
+{
+	int rop;
+	int width;
+	int x, y;
+	int offset;
+	UINT32 patX, patY;
+	UINT32 pattern[64];
+	UINT32 src[TEST_ROP_PITCH * TEST_ROP_ROWS];
+	UINT32 dst[TEST_ROP_PITCH * TEST_ROP_ROWS];
+	UINT32 org[TEST_ROP_PITCH * TEST_ROP_ROWS];
+	UINT32 expected;
+	static const int widths[] = { 1, 3, 4, 5, 7, 8, 9, 12, 16, 31, 64, 77 };
+
+	for (rop = 0; rop < 256; rop++)
+	{
+		for (x = 0; x < (int) (sizeof(widths) / sizeof(widths[0])); x++)
+		{
+			width = widths[x];
+			offset = (rop + width) % 3;
+			patX = rop & 7;
+			patY = (rop >> 3) & 7;
+
+			test_fill(pattern, 64);
+			test_fill(src, TEST_ROP_PITCH * TEST_ROP_ROWS);
+			test_fill(org, TEST_ROP_PITCH * TEST_ROP_ROWS);
+			CopyMemory(dst, org, sizeof(dst));
+
+			/* rows of different pitches, at unaligned offsets */
+			rop3(&src[offset], (TEST_ROP_PITCH - 1) * 4, pattern, patX, patY,
+				&dst[1], TEST_ROP_PITCH * 4, width, TEST_ROP_ROWS - 1, (BYTE) rop);
+
+			for (y = 0; y < TEST_ROP_ROWS - 1; y++)
+			{
+				for (offset = 0; offset < width; offset++)
+				{
+					expected = test_rop3_pixel((BYTE) rop,
+						src[((rop + width) % 3) + y * (TEST_ROP_PITCH - 1) + offset],
+						pattern[((patY + y) & 7) * 8 + ((patX + offset) & 7)],
+						org[1 + y * TEST_ROP_PITCH + offset]);
+
+					if (dst[1 + y * TEST_ROP_PITCH + offset] != expected)
+					{
+						printf("%s rop3 0x%02X width %d: pixel (%d,%d) is 0x%08X instead of 0x%08X\n",
+							impl, rop, width, offset, y, dst[1 + y * TEST_ROP_PITCH + offset], expected);
+						return FALSE;
+					}
+				}
+
+				/* pixels around the rows are left alone */
+				if ((dst[y * TEST_ROP_PITCH] != org[y * TEST_ROP_PITCH]) ||
+						(dst[1 + y * TEST_ROP_PITCH + width] != org[1 + y * TEST_ROP_PITCH + width]))
+				{
+					printf("%s rop3 0x%02X width %d: row %d overflows\n", impl, rop, width, y);
+					return FALSE;
+				}
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+/* a source overlapping its destination in the same row reads what was drawn */
+static BOOL test_rop3_overlap(void)
+{
+	int i;
+	int shift;
+	UINT32 pattern[64];
+	UINT32 org[TEST_ROP_PITCH];
+	UINT32 expected[TEST_ROP_PITCH];
+	UINT32 dst[TEST_ROP_PITCH];
+	static const BYTE rops[] = { 0x66, 0xEE, 0x96, 0xB8 };
+
+	test_fill(pattern, 64);
+
+	for (i = 0; i < (int) sizeof(rops); i++)
+	{
+		for (shift = -3; shift <= 3; shift++)
+		{
+			test_fill(org, TEST_ROP_PITCH);
+			CopyMemory(expected, org, sizeof(org));
+			CopyMemory(dst, org, sizeof(org));
+
+			general_rop3_32u(&expected[8 + shift], 0, pattern, 0, 0, &expected[8], 0, 64, 1, rops[i]);
+			primitives_get()->rop3_32u(&dst[8 + shift], 0, pattern, 0, 0, &dst[8], 0, 64, 1, rops[i]);
+
+			if (memcmp(dst, expected, sizeof(dst)) != 0)
+			{
+				printf("rop3 0x%02X with a source shifted by %d differs\n", rops[i], shift);
+				return FALSE;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+static HGDI_DC test_create_dc(int width, int height, HGDI_BITMAP* hBmp)
+{
+	HGDI_DC hdc;
+	BYTE* data;
+
+	hdc = gdi_GetDC();
+	data = (BYTE*) _aligned_malloc(width * height * 4, 16);
+
+	if (!hdc || !data)
+		return NULL;
+
+	hdc->bytesPerPixel = 4;
+	hdc->bitsPerPixel = 32;
+	test_fill((UINT32*) data, width * height);
+	*hBmp = gdi_CreateBitmap(width, height, 32, data);
+	gdi_SelectObject(hdc, (HGDIOBJECT) *hBmp);
+
+	return hdc;
+}
+
+/* BitBlt and PatBlt on 32bpp surfaces, with pattern and solid brushes */
+static BOOL test_rop3_gdi(void)
+{
+	int i, x, y;
+	int brush;
+	BOOL status = FALSE;
+	UINT32 rop3;
+	UINT32 pattern[64];
+	UINT32 expected;
+	UINT32* org = NULL;
+	UINT32* srcp;
+	UINT32* dstp;
+	HGDI_DC hdcSrc;
+	HGDI_DC hdcDst;
+	HGDI_DC hdcPat;
+	HGDI_BITMAP hBmpSrc = NULL;
+	HGDI_BITMAP hBmpDst = NULL;
+	HGDI_BITMAP hBmpPat = NULL;
+	HGDI_BRUSH hBrush;
+	const int width = 64, height = 32;
+	const int nXDest = 3, nYDest = 2, nWidth = 50, nHeight = 20;
+	const int nXSrc = 5, nYSrc = 7;
+
+	hdcSrc = test_create_dc(width, height, &hBmpSrc);
+	hdcDst = test_create_dc(width, height, &hBmpDst);
+	hdcPat = test_create_dc(8, 8, &hBmpPat);
+	org = (UINT32*) malloc(width * height * 4);
+
+	if (!hdcSrc || !hdcDst || !hdcPat || !org)
+		goto out;
+
+	srcp = (UINT32*) hBmpSrc->data;
+	dstp = (UINT32*) hBmpDst->data;
+
+	for (brush = 0; brush < 2; brush++)
+	{
+		if (brush == 0)
+		{
+			/* the brush takes the pattern bitmap */
+			hBrush = gdi_CreatePatternBrush(hBmpPat);
+			CopyMemory(pattern, hBmpPat->data, sizeof(pattern));
+			hBmpPat = NULL;
+		}
+		else
+		{
+			hBrush = gdi_CreateSolidBrush(0x00336699);
+
+			for (i = 0; i < 64; i++)
+				pattern[i] = gdi_get_color_32bpp(hdcDst, 0x00336699);
+		}
+
+		hdcDst->brush = hBrush;
+
+		for (i = 0; i < (int) TEST_ROP_COUNT; i++)
+		{
+			/* DSPDxax takes the text color as pattern */
+			if (test_rops[i].rop == GDI_DSPDxax)
+				continue;
+
+			rop3 = (test_rops[i].rop >> 16) & 0xFF;
+			CopyMemory(org, dstp, width * height * 4);
+
+			if (((rop3 >> 2) ^ rop3) & 0x33)
+				gdi_BitBlt(hdcDst, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc, test_rops[i].rop);
+			else
+				gdi_PatBlt(hdcDst, nXDest, nYDest, nWidth, nHeight, test_rops[i].rop);
+
+			for (y = 0; y < height; y++)
+			{
+				for (x = 0; x < width; x++)
+				{
+					expected = org[y * width + x];
+
+					if ((x >= nXDest) && (x < nXDest + nWidth) && (y >= nYDest) && (y < nYDest + nHeight))
+					{
+						expected = test_rop3_pixel((BYTE) rop3,
+							srcp[(y - nYDest + nYSrc) * width + (x - nXDest + nXSrc)],
+							pattern[((y - nYDest) & 7) * 8 + ((x - nXDest) & 7)], expected);
+					}
+
+					if (dstp[y * width + x] != expected)
+					{
+						printf("%s with a %s brush: pixel (%d,%d) is 0x%08X instead of 0x%08X\n",
+							test_rops[i].name, brush ? "solid" : "pattern", x, y,
+							dstp[y * width + x], expected);
+						goto out;
+					}
+				}
+			}
+		}
+
+		hdcDst->brush = NULL;
+		gdi_DeleteObject((HGDIOBJECT) hBrush);
+	}
+
+	status = TRUE;
+
+out:
+	free(org);
+
+	gdi_DeleteObject((HGDIOBJECT) hBmpSrc);
+	gdi_DeleteObject((HGDIOBJECT) hBmpDst);
+	gdi_DeleteObject((HGDIOBJECT) hBmpPat);
+	gdi_DeleteDC(hdcSrc);
+	gdi_DeleteDC(hdcDst);
+	gdi_DeleteDC(hdcPat);
+
+	return status;
+}
+
+/* source rectangles reaching out of the source bitmap only draw where there is a source */
+static BOOL test_rop3_source_bounds(void)
+{
+	int i, x, y;
+	int sx, sy;
+	BOOL status = FALSE;
+	UINT32 rop3;
+	UINT32 pattern[64];
+	UINT32 expected;
+	UINT32* org = NULL;
+	UINT32* srcp;
+	UINT32* dstp;
+	HGDI_DC hdcSrc;
+	HGDI_DC hdcDst;
+	HGDI_DC hdcPat;
+	HGDI_BITMAP hBmpSrc = NULL;
+	HGDI_BITMAP hBmpDst = NULL;
+	HGDI_BITMAP hBmpPat = NULL;
+	HGDI_BRUSH hBrush = NULL;
+	const int srcWidth = 16, srcHeight = 8;
+	const int width = 64, height = 32;
+	const int nXDest = 3, nYDest = 2, nWidth = 40, nHeight = 20;
+	const int sources[][2] = { { -5, -3 }, { 9, 4 }, { -2, 6 }, { 100, 0 }, { 0, -50 } };
+
+	hdcSrc = test_create_dc(srcWidth, srcHeight, &hBmpSrc);
+	hdcDst = test_create_dc(width, height, &hBmpDst);
+	hdcPat = test_create_dc(8, 8, &hBmpPat);
+	org = (UINT32*) malloc(width * height * 4);
+
+	if (!hdcSrc || !hdcDst || !hdcPat || !org)
+		goto out;
+
+	srcp = (UINT32*) hBmpSrc->data;
+	dstp = (UINT32*) hBmpDst->data;
+
+	/* the brush takes the pattern bitmap */
+	hBrush = gdi_CreatePatternBrush(hBmpPat);
+	CopyMemory(pattern, hBmpPat->data, sizeof(pattern));
+	hBmpPat = NULL;
+	hdcDst->brush = hBrush;
+	rop3 = (GDI_MERGECOPY >> 16) & 0xFF;
+
+	for (i = 0; i < (int) (sizeof(sources) / sizeof(sources[0])); i++)
+	{
+		CopyMemory(org, dstp, width * height * 4);
+		gdi_BitBlt(hdcDst, nXDest, nYDest, nWidth, nHeight, hdcSrc, sources[i][0], sources[i][1], GDI_MERGECOPY);
+
+		for (y = 0; y < height; y++)
+		{
+			for (x = 0; x < width; x++)
+			{
+				expected = org[y * width + x];
+				sx = x - nXDest + sources[i][0];
+				sy = y - nYDest + sources[i][1];
+
+				if ((x >= nXDest) && (x < nXDest + nWidth) && (y >= nYDest) && (y < nYDest + nHeight) &&
+						(sx >= 0) && (sx < srcWidth) && (sy >= 0) && (sy < srcHeight))
+				{
+					expected = test_rop3_pixel((BYTE) rop3, srcp[sy * srcWidth + sx],
+						pattern[((y - nYDest) & 7) * 8 + ((x - nXDest) & 7)], expected);
+				}
+
+				if (dstp[y * width + x] != expected)
+				{
+					printf("MERGECOPY from (%d,%d): pixel (%d,%d) is 0x%08X instead of 0x%08X\n",
+						sources[i][0], sources[i][1], x, y, dstp[y * width + x], expected);
+					goto out;
+				}
+			}
+		}
+	}
+
+	status = TRUE;
+
+out:
+	free(org);
+
+	if (hdcDst)
+		hdcDst->brush = NULL;
+
+	gdi_DeleteObject((HGDIOBJECT) hBrush);
+	gdi_DeleteObject((HGDIOBJECT) hBmpSrc);
+	gdi_DeleteObject((HGDIOBJECT) hBmpDst);
+	gdi_DeleteObject((HGDIOBJECT) hBmpPat);
+	gdi_DeleteDC(hdcSrc);
+	gdi_DeleteDC(hdcDst);
+	gdi_DeleteDC(hdcPat);
+
+	return status;
+}
+
+static double test_rop3_rate(__rop3_32u_t rop3, UINT32* src, UINT32* pattern, UINT32* dst, BYTE rop)
+{
+	int i;
+	UINT32 elapsed;
+	UINT32 start = GetTickCount();
+
+	for (i = 0; i < TEST_ROP_BENCH_ITERATIONS; i++)
+	{
+		rop3(src, TEST_ROP_BENCH_WIDTH * 4, pattern, 0, 0, dst, TEST_ROP_BENCH_WIDTH * 4,
+			TEST_ROP_BENCH_WIDTH, TEST_ROP_BENCH_HEIGHT, rop);
+	}
+
+	elapsed = GetTickCount() - start;
+
+	return ((double) TEST_ROP_BENCH_WIDTH * TEST_ROP_BENCH_HEIGHT * TEST_ROP_BENCH_ITERATIONS) /
+		((elapsed ? elapsed : 1) * 1000.0);
+}
+
+static BOOL test_rop3_bench(void)
+{
+	int i;
+	BYTE rop3;
+	UINT32* src;
+	UINT32* dst;
+	UINT32 pattern[64];
+	double general, optimized;
+	int count = TEST_ROP_BENCH_WIDTH * TEST_ROP_BENCH_HEIGHT;
+
+	src = (UINT32*) _aligned_malloc(count * 4, 16);
+	dst = (UINT32*) _aligned_malloc(count * 4, 16);
+
+	if (!src || !dst)
+	{
+		_aligned_free(src);
+		_aligned_free(dst);
+		return FALSE;
+	}
+
+	test_fill(src, count);
+	test_fill(dst, count);
+	test_fill(pattern, 64);
+
+	printf("%-12s %12s %12s  (Mpixels/s, %dx%d)\n", "ROP", "general", "optimized",
+		TEST_ROP_BENCH_WIDTH, TEST_ROP_BENCH_HEIGHT);
+
+	for (i = 0; i < (int) TEST_ROP_COUNT; i++)
+	{
+		rop3 = (BYTE) ((test_rops[i].rop >> 16) & 0xFF);
+		general = test_rop3_rate(general_rop3_32u, src, pattern, dst, rop3);
+		optimized = test_rop3_rate(primitives_get()->rop3_32u, src, pattern, dst, rop3);
+		printf("%-12s %12.0f %12.0f\n", test_rops[i].name, general, optimized);
+	}
+
+	_aligned_free(src);
+	_aligned_free(dst);
+
+	return TRUE;
+}
+
+int TestGdiBitBltRop(int argc, char* argv[])
+{
+	if (!test_rop3_primitive(general_rop3_32u, "general"))
+		return -1;
+
+	if (!test_rop3_primitive(primitives_get()->rop3_32u, "optimized"))
+		return -1;
+
+	if (!test_rop3_overlap())
+		return -1;
+
+	if (!test_rop3_gdi())
+		return -1;
+
+	if (!test_rop3_source_bounds())
+		return -1;
+
+	if (!test_rop3_bench())
+		return -1;
+
+	return 0;
+}
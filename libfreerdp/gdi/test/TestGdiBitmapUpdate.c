@@ -0,0 +1,365 @@
+#include <winpr/crt.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/codecs.h>
+#include <freerdp/gdi/gdi.h>
+#include <freerdp/codec/color.h>
+#include <freerdp/codec/planar.h>
+#include <freerdp/codec/interleaved.h>
+
+/**
+ * Decodes the same bitmap update serially and on the bitmap decoding
+ * workers and compares the surfaces. The update mixes planar, interleaved
+ * and uncompressed rectangles, some of them decoded in place and some
+ * clipped, one of them across the edge of the surface. Clipped rectangles
+ * are also compared to the same rectangles decoded without clipping.
+ */
+
+#define TEST_BITMAP_WIDTH		320
+#define TEST_BITMAP_HEIGHT		192
+#define TEST_BITMAP_WORKERS		3
+
+struct test_bitmap_rect
+{
+	UINT32 x;
+	UINT32 y;
+	UINT32 width;
+	UINT32 height;
+	UINT32 clipWidth;
+	UINT32 clipHeight;
+	UINT32 bpp;
+	BOOL compressed;
+};
+typedef struct test_bitmap_rect TEST_BITMAP_RECT;
+
+static const TEST_BITMAP_RECT test_bitmap_rects[] =
+{
+	{ 0, 0, 64, 64, 64, 64, 32, TRUE },
+	{ 64, 0, 64, 64, 64, 64, 24, TRUE },
+	{ 128, 0, 64, 64, 64, 64, 16, TRUE },
+	{ 192, 0, 64, 64, 64, 64, 32, FALSE },
+	{ 256, 0, 64, 64, 40, 24, 32, TRUE },
+	{ 0, 64, 64, 64, 36, 64, 24, TRUE },
+	{ 64, 64, 64, 64, 64, 20, 32, FALSE },
+	{ 128, 64, 32, 48, 32, 48, 16, TRUE },
+	{ 192, 64, 64, 64, 52, 60, 16, TRUE },
+	{ 288, 128, 64, 64, 32, 64, 32, TRUE }
+};
+
+#define TEST_BITMAP_RECTS	(sizeof(test_bitmap_rects) / sizeof(test_bitmap_rects[0]))
+
+static void test_bitmap_fill(BYTE* data, UINT32 width, UINT32 height, UINT32 seed)
+{
+	UINT32 x, y;
+	UINT32 value = seed * 2654435761U;
+
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			BYTE* pixel = &data[(y * width + x) * 4];
+
+			/* runs of flat color with noise in between, so that RLE has work to do */
+			if (((x / 8) + (y / 8) + seed) % 3)
+				value = value * 1103515245 + 12345;
+
+			pixel[0] = (BYTE) ((value >> 16) + x);
+			pixel[1] = (BYTE) ((value >> 8) + y);
+			pixel[2] = (BYTE) (value + seed * 40);
+			pixel[3] = 0xFF;
+		}
+	}
+}
+
+static BOOL test_bitmap_update_new(BITMAP_UPDATE* update, BOOL clipped)
+{
+	UINT32 index;
+	UINT32 size;
+	int planarSize;
+	BYTE* pixels;
+	BITMAP_DATA* bitmap;
+	const TEST_BITMAP_RECT* rect;
+	BITMAP_PLANAR_CONTEXT* planar;
+	BITMAP_INTERLEAVED_CONTEXT* interleaved;
+
+	ZeroMemory(update, sizeof(BITMAP_UPDATE));
+	update->rectangles = (BITMAP_DATA*) calloc(TEST_BITMAP_RECTS, sizeof(BITMAP_DATA));
+	pixels = (BYTE*) malloc(64 * 64 * 4);
+	planar = freerdp_bitmap_planar_context_new(PLANAR_FORMAT_HEADER_NA | PLANAR_FORMAT_HEADER_RLE, 64, 64);
+	interleaved = bitmap_interleaved_context_new(TRUE);
+
+	if (!update->rectangles || !pixels || !planar || !interleaved)
+		goto fail;
+
+	update->count = update->number = TEST_BITMAP_RECTS;
+
+	for (index = 0; index < TEST_BITMAP_RECTS; index++)
+	{
+		rect = &test_bitmap_rects[index];
+		bitmap = &update->rectangles[index];
+
+		test_bitmap_fill(pixels, rect->width, rect->height, index);
+
+		bitmap->destLeft = rect->x;
+		bitmap->destTop = rect->y;
+		bitmap->width = rect->width;
+		bitmap->height = rect->height;
+		bitmap->bitsPerPixel = rect->bpp;
+		bitmap->compressed = rect->compressed;
+
+		if (clipped)
+		{
+			bitmap->destRight = rect->x + rect->clipWidth - 1;
+			bitmap->destBottom = rect->y + rect->clipHeight - 1;
+		}
+		else
+		{
+			bitmap->destRight = rect->x + rect->width - 1;
+			bitmap->destBottom = rect->y + rect->height - 1;
+		}
+
+		/* never beyond the surface, the rectangle itself may be */
+		if (bitmap->destRight >= TEST_BITMAP_WIDTH)
+			bitmap->destRight = TEST_BITMAP_WIDTH - 1;
+
+		if (bitmap->destBottom >= TEST_BITMAP_HEIGHT)
+			bitmap->destBottom = TEST_BITMAP_HEIGHT - 1;
+
+		if (!rect->compressed)
+		{
+			size = rect->width * rect->height * 4;
+
+			if (!(bitmap->bitmapDataStream = (BYTE*) malloc(size)))
+				goto fail;
+
+			CopyMemory(bitmap->bitmapDataStream, pixels, size);
+		}
+		else if (rect->bpp == 32)
+		{
+			planarSize = 0;
+			bitmap->bitmapDataStream = freerdp_bitmap_compress_planar(planar, pixels, PIXEL_FORMAT_XRGB32,
+					rect->width, rect->height, rect->width * 4, NULL, &planarSize);
+
+			if (!bitmap->bitmapDataStream)
+				goto fail;
+
+			size = (UINT32) planarSize;
+		}
+		else
+		{
+			size = 64 * 64 * 4;
+
+			if (!(bitmap->bitmapDataStream = (BYTE*) malloc(size)))
+				goto fail;
+
+			if (interleaved_compress(interleaved, bitmap->bitmapDataStream, &size, rect->width, rect->height,
+					pixels, PIXEL_FORMAT_XRGB32, rect->width * 4, 0, 0, NULL, rect->bpp) < 0)
+				goto fail;
+		}
+
+		bitmap->bitmapLength = size;
+	}
+
+	free(pixels);
+	freerdp_bitmap_planar_context_free(planar);
+	bitmap_interleaved_context_free(interleaved);
+	return TRUE;
+
+fail:
+	free(pixels);
+	freerdp_bitmap_planar_context_free(planar);
+	bitmap_interleaved_context_free(interleaved);
+	return FALSE;
+}
+
+static void test_bitmap_update_free(BITMAP_UPDATE* update)
+{
+	UINT32 index;
+
+	if (!update->rectangles)
+		return;
+
+	for (index = 0; index < update->number; index++)
+		free(update->rectangles[index].bitmapDataStream);
+
+	free(update->rectangles);
+	update->rectangles = NULL;
+}
+
+/**
+ * Decodes an update into a fresh 32bpp surface with at most maxWorkers
+ * worker threads and returns a copy of the surface.
+ */
+
+static BYTE* test_bitmap_decode(BITMAP_UPDATE* update, int maxWorkers, int* numWorkers)
+{
+	UINT32 size;
+	BYTE* output = NULL;
+	rdpGdi* gdi;
+	freerdp* instance;
+	rdpContext* context;
+
+	instance = freerdp_new();
+
+	if (!instance || !freerdp_context_new(instance))
+		goto fail;
+
+	context = instance->context;
+	instance->settings->DesktopWidth = TEST_BITMAP_WIDTH;
+	instance->settings->DesktopHeight = TEST_BITMAP_HEIGHT;
+	instance->settings->ColorDepth = 32;
+
+	if (!(context->codecs = codecs_new(context)))
+		goto fail;
+
+	if (!gdi_init(instance, CLRCONV_ALPHA | CLRBUF_32BPP, NULL))
+		goto fail;
+
+	gdi = context->gdi;
+	gdi->maxBitmapWorkers = maxWorkers;
+
+	/* the decoding threads are only created by the first update worth it */
+	if (gdi->bitmapThreadPool || gdi->numBitmapWorkers)
+	{
+		printf("bitmap decoding threads created before the first update\n");
+		goto fail;
+	}
+
+	if (!instance->update->BitmapUpdate(context, update))
+	{
+		printf("bitmap update failed\n");
+		goto fail;
+	}
+
+	*numWorkers = gdi->numBitmapWorkers;
+	size = gdi->width * gdi->height * gdi->bytesPerPixel;
+
+	if (!(output = (BYTE*) malloc(size)))
+		goto fail;
+
+	CopyMemory(output, gdi->primary_buffer, size);
+
+fail:
+	if (instance)
+	{
+		if (instance->context)
+		{
+			gdi_free(instance);
+			codecs_free(instance->context->codecs);
+			freerdp_context_free(instance);
+		}
+
+		freerdp_free(instance);
+	}
+
+	return output;
+}
+
+/**
+ * The surface is XRGB32: decoders without an alpha plane leave the X byte
+ * alone, so it depends on what was in the buffer before. Only the color
+ * channels are compared.
+ */
+
+static int test_bitmap_compare(BYTE* a, BYTE* b, UINT32 left, UINT32 top, UINT32 right, UINT32 bottom)
+{
+	UINT32 x, y;
+	UINT32 offset;
+
+	for (y = top; y <= bottom; y++)
+	{
+		for (x = left; x <= right; x++)
+		{
+			offset = (y * TEST_BITMAP_WIDTH + x) * 4;
+
+			if (memcmp(&a[offset], &b[offset], 3) != 0)
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
+int TestGdiBitmapUpdate(int argc, char* argv[])
+{
+	int status = -1;
+	UINT32 index;
+	UINT32 size;
+	int numWorkers;
+	BYTE* serial = NULL;
+	BYTE* parallel = NULL;
+	BYTE* unclipped = NULL;
+	BITMAP_DATA* bitmap;
+	BITMAP_UPDATE update;
+	BITMAP_UPDATE updateUnclipped;
+
+	ZeroMemory(&update, sizeof(BITMAP_UPDATE));
+	ZeroMemory(&updateUnclipped, sizeof(BITMAP_UPDATE));
+
+	if (!test_bitmap_update_new(&update, TRUE) || !test_bitmap_update_new(&updateUnclipped, FALSE))
+		goto fail;
+
+	size = TEST_BITMAP_WIDTH * TEST_BITMAP_HEIGHT * 4;
+
+	if (!(serial = test_bitmap_decode(&update, 0, &numWorkers)))
+		goto fail;
+
+	if (numWorkers != 0)
+	{
+		printf("serial decoding used %d workers\n", numWorkers);
+		goto fail;
+	}
+
+	if (!(parallel = test_bitmap_decode(&update, TEST_BITMAP_WORKERS, &numWorkers)))
+		goto fail;
+
+	if (numWorkers != TEST_BITMAP_WORKERS)
+	{
+		printf("parallel decoding used %d workers, expected %d\n", numWorkers, TEST_BITMAP_WORKERS);
+		goto fail;
+	}
+
+	if (test_bitmap_compare(serial, parallel, 0, 0, TEST_BITMAP_WIDTH - 1, TEST_BITMAP_HEIGHT - 1) < 0)
+	{
+		printf("parallel decoding differs from serial decoding\n");
+		goto fail;
+	}
+
+	if (!(unclipped = test_bitmap_decode(&updateUnclipped, 0, &numWorkers)))
+		goto fail;
+
+	for (index = 0; index < update.number; index++)
+	{
+		bitmap = &update.rectangles[index];
+
+		if (test_bitmap_compare(serial, unclipped, bitmap->destLeft, bitmap->destTop,
+				bitmap->destRight, bitmap->destBottom) < 0)
+		{
+			printf("rectangle %u differs from the same rectangle decoded unclipped\n", index);
+			goto fail;
+		}
+	}
+
+	/* make sure something was drawn at all */
+	for (index = 0; index < size; index++)
+	{
+		if (serial[index])
+			break;
+	}
+
+	if (index == size)
+	{
+		printf("bitmap update left the surface blank\n");
+		goto fail;
+	}
+
+	status = 0;
+
+fail:
+	free(serial);
+	free(parallel);
+	free(unclipped);
+	test_bitmap_update_free(&update);
+	test_bitmap_update_free(&updateUnclipped);
+	return status;
+}
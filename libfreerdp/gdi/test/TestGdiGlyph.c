@@ -0,0 +1,422 @@
+#include <winpr/crt.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/gdi/gdi.h>
+#include <freerdp/gdi/dc.h>
+#include <freerdp/gdi/brush.h>
+#include <freerdp/gdi/shape.h>
+#include <freerdp/gdi/drawing.h>
+#include <freerdp/gdi/region.h>
+#include <freerdp/gdi/bitmap.h>
+#include <freerdp/gdi/clipping.h>
+#include <freerdp/codec/color.h>
+#include <freerdp/cache/glyph.h>
+
+/**
+ * Replays a recording of the glyph orders a server sends for a terminal:
+ * the glyphs of a font are cached once, then every screen is redrawn line
+ * by line with GlyphIndex orders, the prompt of each line being sent as a
+ * glyph fragment. The same screens are drawn glyph by glyph with
+ * gdi_BitBlt as the glyph class used to, to compare speed and output.
+ */
+
+#define TEST_GLYPH_COLUMNS	100
+#define TEST_GLYPH_ROWS		40
+#define TEST_GLYPH_CELL_WIDTH	8
+#define TEST_GLYPH_CELL_HEIGHT	16
+#define TEST_GLYPH_BASELINE	12
+#define TEST_GLYPH_COUNT	95
+#define TEST_GLYPH_PROMPT	10
+#define TEST_GLYPH_SCREENS	50
+#define TEST_GLYPH_CACHE_ID	7
+
+#define TEST_GLYPH_WIDTH	(TEST_GLYPH_COLUMNS * TEST_GLYPH_CELL_WIDTH)
+#define TEST_GLYPH_HEIGHT	(TEST_GLYPH_ROWS * TEST_GLYPH_CELL_HEIGHT)
+
+#define TEST_GLYPH_RATE(_glyphs, _time, _fill) \
+	(((double) (_glyphs)) * 1000.0 / (((_time) > (_fill)) ? ((_time) - (_fill)) : 1))
+
+typedef struct
+{
+	BYTE index;
+	INT32 x;
+	INT32 y;
+} TEST_GLYPH_DRAW;
+
+typedef struct
+{
+	GLYPH_INDEX_ORDER order;
+	UINT32 count;
+	TEST_GLYPH_DRAW draws[TEST_GLYPH_COLUMNS];
+} TEST_GLYPH_LINE;
+
+static GLYPH_DATA test_glyphs[TEST_GLYPH_COUNT];
+
+static BYTE* test_glyph_mask(int index, UINT32 cx, UINT32 cy, UINT32* cb)
+{
+	UINT32 x, y;
+	UINT32 stride;
+	UINT32 seed;
+	BYTE* mask;
+
+	stride = (cx + 7) / 8;
+	*cb = stride * cy;
+	mask = (BYTE*) calloc(1, *cb);
+
+	if (!mask)
+		return NULL;
+
+	seed = (index + 1) * 2654435761U;
+
+	/* a blocky pseudo-random shape, with strokes like a real font */
+	for (y = 2; y < cy - 2; y++)
+	{
+		for (x = 1; x < cx - 1; x++)
+		{
+			if ((seed >> ((x + (y / 3) * 5) % 29)) & 1)
+				mask[y * stride + x / 8] |= 0x80 >> (x % 8);
+		}
+	}
+
+	return mask;
+}
+
+static BOOL test_glyph_cache_font(rdpContext* context)
+{
+	int index;
+	CACHE_GLYPH_ORDER* cacheGlyph;
+
+	cacheGlyph = (CACHE_GLYPH_ORDER*) calloc(1, sizeof(CACHE_GLYPH_ORDER));
+
+	if (!cacheGlyph)
+		return FALSE;
+
+	cacheGlyph->cacheId = TEST_GLYPH_CACHE_ID;
+	cacheGlyph->cGlyphs = TEST_GLYPH_COUNT;
+
+	for (index = 0; index < TEST_GLYPH_COUNT; index++)
+	{
+		GLYPH_DATA* glyph = &cacheGlyph->glyphData[index];
+
+		glyph->cacheIndex = index;
+		glyph->x = 0;
+		glyph->y = -TEST_GLYPH_BASELINE;
+		glyph->cx = (index % 3) ? TEST_GLYPH_CELL_WIDTH : TEST_GLYPH_CELL_WIDTH - 1;
+		glyph->cy = TEST_GLYPH_CELL_HEIGHT;
+		glyph->aj = test_glyph_mask(index, glyph->cx, glyph->cy, &glyph->cb);
+
+		if (!glyph->aj)
+			return FALSE;
+
+		/* the glyph cache takes ownership of aj, keep a copy for the reference */
+		test_glyphs[index] = *glyph;
+		test_glyphs[index].aj = (BYTE*) malloc(glyph->cb);
+
+		if (!test_glyphs[index].aj)
+			return FALSE;
+
+		CopyMemory(test_glyphs[index].aj, glyph->aj, glyph->cb);
+	}
+
+	if (!context->update->secondary->CacheGlyph(context, cacheGlyph))
+		return FALSE;
+
+	free(cacheGlyph);
+	return TRUE;
+}
+
+static void test_glyph_append(TEST_GLYPH_LINE* line, BYTE index, INT32 offset, INT32* x)
+{
+	*x += offset;
+	line->order.data[line->order.cbData++] = index;
+	line->order.data[line->order.cbData++] = (BYTE) offset;
+	line->draws[line->count].index = index;
+	line->draws[line->count].x = *x;
+	line->draws[line->count].y = line->order.y - TEST_GLYPH_BASELINE;
+	line->count++;
+}
+
+/* records the line, the first line of the recording also adds the prompt fragment */
+static void test_glyph_record_line(TEST_GLYPH_LINE* line, int screen, int row, BOOL addPrompt)
+{
+	int column;
+	INT32 x = 0;
+	GLYPH_INDEX_ORDER* order = &line->order;
+
+	ZeroMemory(line, sizeof(TEST_GLYPH_LINE));
+
+	order->cacheId = TEST_GLYPH_CACHE_ID;
+	order->flAccel = SO_HORIZONTAL;
+	order->ulCharInc = 0;
+	order->backColor = (screen & 1) ? 0xC0C0C0 : 0x00FF00;
+	order->foreColor = 0x000020 + row;
+	order->bkLeft = order->opLeft = 0;
+	order->bkTop = order->opTop = row * TEST_GLYPH_CELL_HEIGHT;
+	order->bkRight = order->opRight = TEST_GLYPH_WIDTH;
+	order->bkBottom = order->opBottom = (row + 1) * TEST_GLYPH_CELL_HEIGHT;
+	order->x = 0;
+	order->y = row * TEST_GLYPH_CELL_HEIGHT + TEST_GLYPH_BASELINE;
+
+	if (addPrompt)
+	{
+		for (column = 0; column < TEST_GLYPH_PROMPT; column++)
+			test_glyph_append(line, (BYTE) column, column ? TEST_GLYPH_CELL_WIDTH : 0, &x);
+
+		order->data[order->cbData++] = GLYPH_FRAGMENT_ADD;
+		order->data[order->cbData++] = 0;
+		order->data[order->cbData++] = TEST_GLYPH_PROMPT * 2;
+	}
+	else
+	{
+		/* the fragment glyphs are drawn from its first offset, the delta follows */
+		for (column = 0; column < TEST_GLYPH_PROMPT; column++)
+		{
+			line->draws[line->count].index = (BYTE) column;
+			line->draws[line->count].x = column * TEST_GLYPH_CELL_WIDTH;
+			line->draws[line->count].y = order->y - TEST_GLYPH_BASELINE;
+			line->count++;
+		}
+
+		x = (TEST_GLYPH_PROMPT - 1) * TEST_GLYPH_CELL_WIDTH;
+		order->data[order->cbData++] = GLYPH_FRAGMENT_USE;
+		order->data[order->cbData++] = 0;
+		order->data[order->cbData++] = 0;
+	}
+
+	for (column = TEST_GLYPH_PROMPT; column < TEST_GLYPH_COLUMNS - 4; column++)
+	{
+		BYTE index = (BYTE) ((screen * 31 + row * 7 + column * 13) % TEST_GLYPH_COUNT);
+
+		test_glyph_append(line, index, TEST_GLYPH_CELL_WIDTH, &x);
+	}
+}
+
+static void test_glyph_reset_invalid(rdpGdi* gdi)
+{
+	gdi->primary->hdc->hwnd->invalid->null = 1;
+	gdi->primary->hdc->hwnd->ninvalid = 0;
+}
+
+/* the glyph class before glyph runs: 8bpp glyph bitmaps drawn with gdi_BitBlt */
+static BOOL test_glyph_reference(rdpGdi* gdi, TEST_GLYPH_LINE* lines, int count, UINT32* elapsed)
+{
+	int index;
+	int glyph;
+	UINT32 start;
+	BYTE* data;
+	GDI_RECT rect;
+	HGDI_BRUSH brush;
+	UINT32 bgcolor, fgcolor;
+	HGDI_DC hdc = gdi->primary->hdc;
+	HGDI_DC glyphDC[TEST_GLYPH_COUNT];
+	HGDI_BITMAP glyphBitmap[TEST_GLYPH_COUNT];
+
+	for (index = 0; index < TEST_GLYPH_COUNT; index++)
+	{
+		glyphDC[index] = gdi_GetDC();
+		data = freerdp_glyph_convert(test_glyphs[index].cx, test_glyphs[index].cy, test_glyphs[index].aj);
+
+		if (!glyphDC[index] || !data)
+			return FALSE;
+
+		glyphDC[index]->bytesPerPixel = 1;
+		glyphDC[index]->bitsPerPixel = 1;
+		glyphBitmap[index] = gdi_CreateBitmap(test_glyphs[index].cx, test_glyphs[index].cy, 1, data);
+		glyphBitmap[index]->bytesPerPixel = 1;
+		glyphBitmap[index]->bitsPerPixel = 1;
+		gdi_SelectObject(glyphDC[index], (HGDIOBJECT) glyphBitmap[index]);
+	}
+
+	start = GetTickCount();
+
+	for (index = 0; index < count; index++)
+	{
+		GLYPH_INDEX_ORDER* order = &lines[index].order;
+
+		bgcolor = freerdp_convert_gdi_order_color(order->backColor, gdi->srcBpp, gdi->format, gdi->palette);
+		fgcolor = freerdp_convert_gdi_order_color(order->foreColor, gdi->srcBpp, gdi->format, gdi->palette);
+
+		brush = gdi_CreateSolidBrush(fgcolor);
+		gdi_CRgnToRect(order->opLeft, order->opTop, order->opRight - order->opLeft,
+			order->opBottom - order->opTop, &rect);
+		gdi_FillRect(hdc, &rect, brush);
+		gdi_DeleteObject((HGDIOBJECT) brush);
+		gdi_SetTextColor(hdc, bgcolor);
+
+		for (glyph = 0; glyph < (int) lines[index].count; glyph++)
+		{
+			TEST_GLYPH_DRAW* draw = &lines[index].draws[glyph];
+
+			gdi_BitBlt(hdc, draw->x, draw->y, test_glyphs[draw->index].cx, test_glyphs[draw->index].cy,
+				glyphDC[draw->index], 0, 0, GDI_DSPDxax);
+		}
+
+		if ((index % TEST_GLYPH_ROWS) == (TEST_GLYPH_ROWS - 1))
+			test_glyph_reset_invalid(gdi);
+	}
+
+	*elapsed = GetTickCount() - start;
+
+	for (index = 0; index < TEST_GLYPH_COUNT; index++)
+	{
+		gdi_DeleteObject((HGDIOBJECT) glyphBitmap[index]);
+		gdi_DeleteDC(glyphDC[index]);
+	}
+
+	return TRUE;
+}
+
+static BOOL test_glyph_replay(rdpContext* context, TEST_GLYPH_LINE* lines, int count, BOOL glyphs, UINT32* elapsed)
+{
+	int index;
+	UINT32 start;
+	GLYPH_INDEX_ORDER order;
+	rdpUpdate* update = context->update;
+
+	start = GetTickCount();
+
+	for (index = 0; index < count; index++)
+	{
+		/* orders are decoded into the same structure over and over */
+		CopyMemory(&order, &lines[index].order, sizeof(GLYPH_INDEX_ORDER));
+
+		if (!glyphs)
+			order.cbData = 0;
+
+		if (!update->primary->GlyphIndex(context, &order))
+			return FALSE;
+
+		if ((index % TEST_GLYPH_ROWS) == (TEST_GLYPH_ROWS - 1))
+			test_glyph_reset_invalid(context->gdi);
+	}
+
+	*elapsed = GetTickCount() - start;
+	return TRUE;
+}
+
+/* draws the recording with glyph runs and with gdi_BitBlt on a surface of the given depth */
+static int test_glyph_compare(const char* name, TEST_GLYPH_LINE* lines, int count, UINT32 glyphs,
+		UINT32 colorDepth, UINT32 flags, BOOL clipped)
+{
+	int index;
+	int status = -1;
+	UINT32 size;
+	UINT32 fillTime;
+	UINT32 replayTime;
+	UINT32 referenceTime;
+	BYTE* output = NULL;
+	rdpGdi* gdi;
+	freerdp* instance;
+	rdpContext* context;
+
+	instance = freerdp_new();
+
+	if (!instance || !freerdp_context_new(instance))
+		goto fail;
+
+	context = instance->context;
+	instance->settings->DesktopWidth = TEST_GLYPH_WIDTH;
+	instance->settings->DesktopHeight = TEST_GLYPH_HEIGHT;
+	instance->settings->ColorDepth = colorDepth;
+
+	if (!gdi_init(instance, flags, NULL))
+		goto fail;
+
+	gdi = context->gdi;
+	size = gdi->width * gdi->height * gdi->bytesPerPixel;
+
+	if (!test_glyph_cache_font(context) || !(output = (BYTE*) malloc(size)))
+		goto fail;
+
+	/* the opaque rectangles are filled the same way by both, time them alone */
+	if (!test_glyph_replay(context, lines, count, FALSE, &fillTime))
+		goto fail;
+
+	ZeroMemory(gdi->primary_buffer, size);
+
+	/* a clipping rectangle that cuts through glyphs and mask bytes */
+	if (clipped)
+		gdi_SetClipRgn(gdi->primary->hdc, 3 * TEST_GLYPH_CELL_WIDTH + 3, 5 * TEST_GLYPH_CELL_HEIGHT + 5,
+			37 * TEST_GLYPH_CELL_WIDTH + 2, 11 * TEST_GLYPH_CELL_HEIGHT + 3);
+
+	if (!test_glyph_replay(context, lines, count, TRUE, &replayTime))
+		goto fail;
+
+	CopyMemory(output, gdi->primary_buffer, size);
+	ZeroMemory(gdi->primary_buffer, size);
+
+	if (!test_glyph_reference(gdi, lines, count, &referenceTime))
+		goto fail;
+
+	printf("%s: %d glyph orders, %d glyphs: glyph runs %d ms, per glyph BitBlt %d ms, of which %d ms filling\n",
+		name, count, glyphs, replayTime, referenceTime, fillTime);
+	printf("%s: glyphs per second: glyph runs %.0f, per glyph BitBlt %.0f\n", name,
+		TEST_GLYPH_RATE(glyphs, replayTime, fillTime), TEST_GLYPH_RATE(glyphs, referenceTime, fillTime));
+
+	if (memcmp(output, gdi->primary_buffer, size) != 0)
+	{
+		printf("%s: glyph runs and per glyph BitBlt do not draw the same\n", name);
+		goto fail;
+	}
+
+	status = 0;
+
+fail:
+	for (index = 0; index < TEST_GLYPH_COUNT; index++)
+	{
+		free(test_glyphs[index].aj);
+		test_glyphs[index].aj = NULL;
+	}
+
+	free(output);
+
+	if (instance)
+	{
+		if (instance->context)
+		{
+			gdi_free(instance);
+			freerdp_context_free(instance);
+		}
+
+		freerdp_free(instance);
+	}
+
+	return status;
+}
+
+int TestGdiGlyph(int argc, char* argv[])
+{
+	int index;
+	int status = -1;
+	int count;
+	UINT32 glyphs = 0;
+	TEST_GLYPH_LINE* lines;
+
+	count = TEST_GLYPH_SCREENS * TEST_GLYPH_ROWS;
+	lines = (TEST_GLYPH_LINE*) calloc(count, sizeof(TEST_GLYPH_LINE));
+
+	if (!lines)
+		return -1;
+
+	for (index = 0; index < count; index++)
+	{
+		test_glyph_record_line(&lines[index], index / TEST_GLYPH_ROWS, index % TEST_GLYPH_ROWS, (index == 0));
+		glyphs += lines[index].count;
+	}
+
+	if (test_glyph_compare("32bpp", lines, count, glyphs, 32, CLRCONV_ALPHA | CLRBUF_32BPP, FALSE) < 0)
+		goto fail;
+
+	if (test_glyph_compare("32bpp clipped", lines, count, glyphs, 32, CLRCONV_ALPHA | CLRBUF_32BPP, TRUE) < 0)
+		goto fail;
+
+	if (test_glyph_compare("16bpp", lines, count, glyphs, 16, CLRCONV_ALPHA | CLRBUF_16BPP, FALSE) < 0)
+		goto fail;
+
+	status = 0;
+
+fail:
+	free(lines);
+	return status;
+}
@@ -120,11 +120,63 @@ pstatus_t general_RGB565ToARGB_16u32u_C3C4(
 	return PRIMITIVES_SUCCESS;
 }
 
+/* ------------------------------------------------------------------------- */
+pstatus_t general_RGB555ToARGB_16u32u_C3C4(
+	const UINT16* pSrc, INT32 srcStep,
+	UINT32* pDst, INT32 dstStep,
+	UINT32 width, UINT32 height,
+	BOOL alpha, BOOL invert)
+{
+	const UINT16* src16;
+	UINT32* dst32;
+	int x,y;
+	int srcRowBump, dstRowBump;
+	BYTE red, green, blue;
+	BYTE a = alpha ? 0xFF : 0x00;
+
+	src16 = pSrc;
+	dst32 = pDst;
+	srcRowBump = (srcStep - (int) (width * sizeof(UINT16))) / (int) sizeof(UINT16);
+	dstRowBump = (dstStep - (int) (width * sizeof(UINT32))) / (int) sizeof(UINT32);
+
+	if (invert)
+	{
+		for (y=0; y<height; y++)
+		{
+			for (x=0; x<width; x++)
+			{
+				UINT32 pixel = (UINT32) *src16++;
+				GetRGB15(red, green, blue, pixel);
+				*dst32++ = ABGR32((UINT32) a, red, green, blue);
+			}
+			src16 += srcRowBump;
+			dst32 += dstRowBump;
+		}
+	}
+	else
+	{
+		for (y=0; y<height; y++)
+		{
+			for (x=0; x<width; x++)
+			{
+				UINT32 pixel = (UINT32) *src16++;
+				GetRGB15(red, green, blue, pixel);
+				*dst32++ = ARGB32((UINT32) a, red, green, blue);
+			}
+			src16 += srcRowBump;
+			dst32 += dstRowBump;
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
 /* ------------------------------------------------------------------------- */
 void primitives_init_16to32bpp(
 	primitives_t *prims)
 {
 	prims->RGB565ToARGB_16u32u_C3C4 = general_RGB565ToARGB_16u32u_C3C4;
+	prims->RGB555ToARGB_16u32u_C3C4 = general_RGB555ToARGB_16u32u_C3C4;
 
 	primitives_init_16to32bpp_opt(prims);
 }
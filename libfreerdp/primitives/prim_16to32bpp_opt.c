@@ -265,6 +265,87 @@ pstatus_t sse3_RGB565ToARGB_16u32u_C3C4(
 			pDst, dstStep, width, height, alpha);
 	}
 }
+
+/* ------------------------------------------------------------------------- */
+/* RGB555 only needs SSE2: the channels are expanded in 16-bit lanes, the
+ * lower word holding G and B (or R when inverted) and the upper one A and
+ * the remaining color, which are then interleaved into 32-bit pixels.
+ */
+pstatus_t sse2_RGB555ToARGB_16u32u_C3C4(
+	const UINT16* pSrc, INT32 srcStep,
+	UINT32* pDst, INT32 dstStep,
+	UINT32 width, UINT32 height,
+	BOOL alpha, BOOL invert)
+{
+	const BYTE *src = (const BYTE *) pSrc;
+	BYTE *dst = (BYTE *) pDst;
+	int h;
+	int srcRowBump = srcStep - (width * sizeof(UINT16));
+	int dstRowBump = dstStep - (width * sizeof(UINT32));
+	__m128i P, R, G, B, R1, R2, R_F800, R_0700, R_00F8, R_0007, R_alpha;
+
+	R_F800 = _mm_set1_epi16(0xF800);
+	R_0700 = _mm_set1_epi16(0x0700);
+	R_00F8 = _mm_set1_epi16(0x00F8);
+	R_0007 = _mm_set1_epi16(0x0007);
+	R_alpha = _mm_set1_epi16(alpha ? 0xFF00 : 0x0000);
+
+	for (h=0; h<height; h++)
+	{
+		int w = width;
+
+		/* The main loop handles eight pixels at a time. */
+		while (w >= 8)
+		{
+			P = _mm_loadu_si128((__m128i *) src);
+			src += (128/8);
+
+			/* B = ((P<<3) & 0x00F8) | ((P>>2) & 0x0007) */
+			B = _mm_and_si128(R_00F8, _mm_slli_epi16(P, 3));
+			B = _mm_or_si128(B, _mm_and_si128(R_0007, _mm_srli_epi16(P, 2)));
+
+			/* G<<8 = ((P<<6) & 0xF800) | ((P<<1) & 0x0700) */
+			G = _mm_and_si128(R_F800, _mm_slli_epi16(P, 6));
+			G = _mm_or_si128(G, _mm_and_si128(R_0700, _mm_slli_epi16(P, 1)));
+
+			/* R = ((P>>7) & 0x00F8) | ((P>>12) & 0x0007) */
+			R = _mm_and_si128(R_00F8, _mm_srli_epi16(P, 7));
+			R = _mm_or_si128(R, _mm_and_si128(R_0007, _mm_srli_epi16(P, 12)));
+
+			if (invert)
+			{
+				R1 = _mm_or_si128(G, R);
+				R2 = _mm_or_si128(R_alpha, B);
+			}
+			else
+			{
+				R1 = _mm_or_si128(G, B);
+				R2 = _mm_or_si128(R_alpha, R);
+			}
+
+			_mm_storeu_si128((__m128i *) dst, _mm_unpacklo_epi16(R1, R2));
+			dst += (128/8);
+			_mm_storeu_si128((__m128i *) dst, _mm_unpackhi_epi16(R1, R2));
+			dst += (128/8);
+			w -= 8;
+		}
+
+		/* Handle any remainder. */
+		if (w > 0)
+		{
+			general_RGB555ToARGB_16u32u_C3C4((const UINT16*) src, srcStep,
+				(UINT32*) dst, dstStep, w, 1, alpha, invert);
+			src += w * sizeof(UINT16);
+			dst += w * sizeof(UINT32);
+		}
+
+		/* Bump to the start of the next row. */
+		src += srcRowBump;
+		dst += dstRowBump;
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
 #endif /* WITH_SSE2 */
 
 /* ------------------------------------------------------------------------- */
@@ -276,5 +357,10 @@ void primitives_init_16to32bpp_opt(
 	{
 		prims->RGB565ToARGB_16u32u_C3C4 = sse3_RGB565ToARGB_16u32u_C3C4;
 	}
+
+	if (IsProcessorFeaturePresent(PF_SSE2_INSTRUCTIONS_AVAILABLE))
+	{
+		prims->RGB555ToARGB_16u32u_C3C4 = sse2_RGB555ToARGB_16u32u_C3C4;
+	}
 #endif
 }
@@ -116,10 +116,72 @@ pstatus_t general_YCoCgToRGB_8u_AC4R(
 	return PRIMITIVES_SUCCESS;
 }
 
+/* ------------------------------------------------------------------------- */
+/* Forward YCoCg-R transform, the inverse of general_YCoCgToRGB_8u_AC4R.
+ * The output pixels are laid out as Cg Co Y A, with the chroma values
+ * reduced by the color loss level (shift) as expected by the decoder.
+ */
+pstatus_t general_RGBToYCoCg_8u_AC4R(
+	const BYTE *pSrc, INT32 srcStep,
+	BYTE *pDst, INT32 dstStep,
+	UINT32 width, UINT32 height,
+	UINT8 shift,
+	BOOL withAlpha,
+	BOOL invert)
+{
+	BYTE A;
+	int x, y;
+	BYTE *dptr = pDst;
+	const BYTE *sptr = pSrc;
+	INT16 Cg, Co, Y, T, R, G, B;
+	int srcPad = srcStep - (width * 4);
+	int dstPad = dstStep - (width * 4);
+
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			if (invert)
+			{
+				R = (INT16) (*sptr++);
+				G = (INT16) (*sptr++);
+				B = (INT16) (*sptr++);
+			}
+			else
+			{
+				B = (INT16) (*sptr++);
+				G = (INT16) (*sptr++);
+				R = (INT16) (*sptr++);
+			}
+
+			A = *sptr++;
+
+			if (!withAlpha)
+				A = 0xFFU;
+
+			Co = R - B;
+			T  = B + (Co >> 1);
+			Cg = G - T;
+			Y  = T + (Cg >> 1);
+
+			*dptr++ = (BYTE) (Cg >> shift);
+			*dptr++ = (BYTE) (Co >> shift);
+			*dptr++ = (BYTE) Y;
+			*dptr++ = A;
+		}
+
+		sptr += srcPad;
+		dptr += dstPad;
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
 /* ------------------------------------------------------------------------- */
 void primitives_init_YCoCg(primitives_t* prims)
 {
 	prims->YCoCgToRGB_8u_AC4R = general_YCoCgToRGB_8u_AC4R;
+	prims->RGBToYCoCg_8u_AC4R = general_RGBToYCoCg_8u_AC4R;
 
 	primitives_init_YCoCg_opt(prims);
 }
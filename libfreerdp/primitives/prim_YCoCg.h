@@ -25,6 +25,7 @@
 #define __PRIM_YCOCG_H_INCLUDED__
 
 pstatus_t general_YCoCgToRGB_8u_AC4R(const BYTE *pSrc, INT32 srcStep, BYTE *pDst, INT32 dstStep, UINT32 width, UINT32 height, UINT8 shift, BOOL withAlpha, BOOL invert);
+pstatus_t general_RGBToYCoCg_8u_AC4R(const BYTE *pSrc, INT32 srcStep, BYTE *pDst, INT32 dstStep, UINT32 width, UINT32 height, UINT8 shift, BOOL withAlpha, BOOL invert);
 
 void primitives_init_YCoCg_opt(primitives_t* prims);
 
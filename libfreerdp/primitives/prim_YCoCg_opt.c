@@ -382,6 +382,85 @@ pstatus_t ssse3_YCoCgRToRGB_8u_AC4R(
 }
 #endif /* WITH_SSE2 */
 
+#ifdef WITH_SSE2
+/* ------------------------------------------------------------------------- */
+pstatus_t sse2_RGBToYCoCgR_8u_AC4R(
+	const BYTE *pSrc, INT32 srcStep,
+	BYTE *pDst, INT32 dstStep,
+	UINT32 width, UINT32 height,
+	UINT8 shift,
+	BOOL withAlpha,
+	BOOL invert)
+{
+	const BYTE *sptr = pSrc;
+	BYTE *dptr = pDst;
+	int sRowBump = srcStep - width*sizeof(UINT32);
+	int dRowBump = dstStep - width*sizeof(UINT32);
+	const __m128i mask = _mm_set1_epi32(0x000000FF);
+	const __m128i alphaMask = _mm_set1_epi32(0xFF000000);
+	const __m128i count = _mm_cvtsi32_si128(shift);
+	int h;
+
+	for (h=0; h<height; h++)
+	{
+		int w = width;
+
+		/* Each loop handles four pixels, one per 32-bit lane. */
+		while (w >= 4)
+		{
+			__m128i P, R, G, B, A, Y, T, Co, Cg;
+
+			P = _mm_loadu_si128((const __m128i *) sptr);  sptr += (128/8);
+				/* P = a3r3g3b3 a2r2g2b2 a1r1g1b1 a0r0g0b0 */
+			if (invert)
+			{
+				R = _mm_and_si128(P, mask);
+				B = _mm_and_si128(_mm_srli_epi32(P, 16), mask);
+			}
+			else
+			{
+				B = _mm_and_si128(P, mask);
+				R = _mm_and_si128(_mm_srli_epi32(P, 16), mask);
+			}
+			G = _mm_and_si128(_mm_srli_epi32(P, 8), mask);
+
+			if (withAlpha) A = _mm_and_si128(P, alphaMask);
+			else A = alphaMask;
+
+			/* Co = R - B, T = B + Co/2, Cg = G - T, Y = T + Cg/2 */
+			Co = _mm_sub_epi32(R, B);
+			T = _mm_add_epi32(B, _mm_srai_epi32(Co, 1));
+			Cg = _mm_sub_epi32(G, T);
+			Y = _mm_add_epi32(T, _mm_srai_epi32(Cg, 1));
+
+			/* Apply the color loss level and keep the low byte. */
+			Co = _mm_and_si128(_mm_sra_epi32(Co, count), mask);
+			Cg = _mm_and_si128(_mm_sra_epi32(Cg, count), mask);
+
+			P = _mm_or_si128(Cg, _mm_slli_epi32(Co, 8));
+			P = _mm_or_si128(P, _mm_slli_epi32(Y, 16));
+			P = _mm_or_si128(P, A);
+				/* P = a3Y3o3g3 a2Y2o2g2 a1Y1o1g1 a0Y0o0g0 */
+
+			_mm_storeu_si128((__m128i *) dptr, P);  dptr += (128/8);
+			w -= 4;
+		}
+
+		/* Handle any remainder pixels. */
+		if (w > 0) {
+			general_RGBToYCoCg_8u_AC4R(sptr, srcStep, dptr, dstStep,
+				w, 1, shift, withAlpha, invert);
+			sptr += w * sizeof(UINT32);
+			dptr += w * sizeof(UINT32);
+		}
+
+		sptr += sRowBump;
+		dptr += dRowBump;
+	}
+	return PRIMITIVES_SUCCESS;
+}
+#endif /* WITH_SSE2 */
+
 /* ------------------------------------------------------------------------- */
 void primitives_init_YCoCg_opt(primitives_t* prims)
 {
@@ -395,5 +474,10 @@ void primitives_init_YCoCg_opt(primitives_t* prims)
 	{
 		prims->YCoCgToRGB_8u_AC4R = ssse3_YCoCgRToRGB_8u_AC4R;
 	}
+
+	if (IsProcessorFeaturePresent(PF_SSE2_INSTRUCTIONS_AVAILABLE))
+	{
+		prims->RGBToYCoCg_8u_AC4R = sse2_RGBToYCoCgR_8u_AC4R;
+	}
 #endif /* WITH_SSE2 */
 }
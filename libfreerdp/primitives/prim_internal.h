@@ -68,4 +68,10 @@ extern void primitives_deinit_YUV(primitives_t *prims);
 extern void primitives_init_16to32bpp(primitives_t *prims);
 extern void primitives_deinit_16to32bpp(primitives_t *prims);
 
+extern void primitives_init_swizzle(primitives_t *prims);
+extern void primitives_deinit_swizzle(primitives_t *prims);
+
+extern void primitives_init_rop(primitives_t *prims);
+extern void primitives_deinit_rop(primitives_t *prims);
+
 #endif /* !__PRIM_INTERNAL_H_INCLUDED__ */
@@ -0,0 +1,168 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * Ternary raster operations.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+
+#include "prim_internal.h"
+#include "prim_rop.h"
+
+#define ROP_AND(_a_, _b_)	((_a_) & (_b_))
+#define ROP_ANDN(_a_, _b_)	(~(_a_) & (_b_))
+#define ROP_OR(_a_, _b_)	((_a_) | (_b_))
+#define ROP_XOR(_a_, _b_)	((_a_) ^ (_b_))
+#define ROP_NOT(_a_)		(~(_a_))
+#define ROP_ZERO			0
+#define ROP_ONES			0xFFFFFFFF
+
+/* _a_ where _sel_ is set, _b_ elsewhere */
+#define ROP_MUX(_sel_, _a_, _b_)	(((_sel_) & (_a_)) | (~(_sel_) & (_b_)))
+
+#define GENERAL_ROP3_ROW(_rop_, _name_, _expr_) \
+static void general_rop3_row_##_name_(const UINT32* pSrc, const UINT32* pPat, \
+	UINT32* pDst, UINT32 width, BYTE rop) \
+{ \
+	UINT32 x; \
+	UINT32 S, P, D; \
+	for (x = 0; x < width; x++) \
+	{ \
+		S = pSrc[x]; \
+		P = pPat[x & 7]; \
+		D = pDst[x]; \
+		pDst[x] = (_expr_); \
+	} \
+	(void) S; (void) P; (void) D; \
+}
+
+PRIM_ROP3_LIST(GENERAL_ROP3_ROW)
+
+/* ------------------------------------------------------------------------- */
+/* Any ternary ROP, from its truth table: bit (P << 2 | S << 1 | D) of the
+ * ROP index is the result for these bits. The table is expanded on D, S
+ * and then P, each step selecting between two halves of the table.
+ */
+static void general_rop3_row_generic(const UINT32* pSrc, const UINT32* pPat,
+	UINT32* pDst, UINT32 width, BYTE rop)
+{
+	int i;
+	UINT32 x;
+	UINT32 S, P, D;
+	UINT32 m[8];
+	UINT32 f0, f1;
+
+	for (i = 0; i < 8; i++)
+		m[i] = (rop & (1 << i)) ? 0xFFFFFFFF : 0;
+
+	for (x = 0; x < width; x++)
+	{
+		S = pSrc[x];
+		P = pPat[x & 7];
+		D = pDst[x];
+
+		f0 = ROP_MUX(S, ROP_MUX(D, m[3], m[2]), ROP_MUX(D, m[1], m[0]));
+		f1 = ROP_MUX(S, ROP_MUX(D, m[7], m[6]), ROP_MUX(D, m[5], m[4]));
+		pDst[x] = ROP_MUX(P, f1, f0);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+prim_rop3_row_t general_rop3_row(BYTE rop)
+{
+#define GENERAL_ROP3_CASE(_rop_, _name_, _expr_) \
+	case _rop_: return general_rop3_row_##_name_;
+
+	switch (rop)
+	{
+		PRIM_ROP3_LIST(GENERAL_ROP3_CASE)
+	}
+
+#undef GENERAL_ROP3_CASE
+
+	return general_rop3_row_generic;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Expands row y of an 8x8 pattern, aligned on patX and patY, into the 16
+ * entries of pRow.
+ */
+void general_rop3_pattern_row(const UINT32* pPat, UINT32 patX, UINT32 patY,
+	UINT32 y, UINT32* pRow)
+{
+	int x;
+	const UINT32* row;
+
+	if (!pPat)
+	{
+		ZeroMemory(pRow, 16 * sizeof(UINT32));
+		return;
+	}
+
+	row = &pPat[((patY + y) & 7) * 8];
+
+	for (x = 0; x < 16; x++)
+		pRow[x] = row[(patX + x) & 7];
+}
+
+/* ------------------------------------------------------------------------- */
+/* Combines the source, an 8x8 pattern and the destination with a ternary
+ * ROP. The source may be NULL when the ROP does not use it, the pattern
+ * when it does not use the pattern. Rows are drawn top to bottom and left
+ * to right, a source overlapping the destination reads what was drawn.
+ */
+pstatus_t general_rop3_32u(
+	const UINT32* pSrc, INT32 srcStep,
+	const UINT32* pPat, UINT32 patX, UINT32 patY,
+	UINT32* pDst, INT32 dstStep,
+	UINT32 width, UINT32 height, BYTE rop)
+{
+	UINT32 y;
+	UINT32 pattern[16];
+	const UINT32* sptr = pSrc;
+	UINT32* dptr = pDst;
+	prim_rop3_row_t row = general_rop3_row(rop);
+
+	for (y = 0; y < height; y++)
+	{
+		general_rop3_pattern_row(pPat, patX, patY, y, pattern);
+		row(sptr ? sptr : dptr, pattern, dptr, width, rop);
+
+		if (sptr)
+			sptr = (const UINT32*) (((const BYTE*) sptr) + srcStep);
+
+		dptr = (UINT32*) (((BYTE*) dptr) + dstStep);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_rop(primitives_t* prims)
+{
+	prims->rop3_32u = general_rop3_32u;
+
+	primitives_init_rop_opt(prims);
+}
+
+/* ------------------------------------------------------------------------- */
+void primitives_deinit_rop(primitives_t* prims)
+{
+	/* Nothing to do. */
+}
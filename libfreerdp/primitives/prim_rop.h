@@ -0,0 +1,74 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * Ternary raster operations.
+ * vi:ts=4 sw=4
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef __GNUC__
+# pragma once
+#endif
+
+#ifndef __PRIM_ROP_H_INCLUDED__
+#define __PRIM_ROP_H_INCLUDED__
+
+/* The raster operations with a dedicated kernel, as the ternary ROP index
+ * and an expression of the source S, the pattern P and the destination D.
+ * Every implementation defines ROP_AND, ROP_ANDN (~a & b), ROP_OR, ROP_XOR,
+ * ROP_NOT, ROP_ZERO and ROP_ONES for its own data type before expanding
+ * the list, any other index goes through the truth table of the ROP.
+ */
+#define PRIM_ROP3_LIST(_op_) \
+	_op_(0x00, BLACKNESS,	ROP_ZERO) \
+	_op_(0x0C, SPna,		ROP_ANDN(P, S)) \
+	_op_(0x11, NOTSRCERASE,	ROP_NOT(ROP_OR(S, D))) \
+	_op_(0x22, DSna,		ROP_ANDN(S, D)) \
+	_op_(0x33, NOTSRCCOPY,	ROP_NOT(S)) \
+	_op_(0x44, SRCERASE,	ROP_ANDN(D, S)) \
+	_op_(0x55, DSTINVERT,	ROP_NOT(D)) \
+	_op_(0x5A, PATINVERT,	ROP_XOR(P, D)) \
+	_op_(0x66, SRCINVERT,	ROP_XOR(S, D)) \
+	_op_(0x88, SRCAND,		ROP_AND(S, D)) \
+	_op_(0xA0, DPa,			ROP_AND(D, P)) \
+	_op_(0xA5, PDxn,		ROP_NOT(ROP_XOR(P, D))) \
+	_op_(0xAC, SPDSxax,		ROP_XOR(S, ROP_AND(P, ROP_XOR(D, S)))) \
+	_op_(0xB8, PSDPxax,		ROP_XOR(P, ROP_AND(S, ROP_XOR(D, P)))) \
+	_op_(0xBB, MERGEPAINT,	ROP_OR(ROP_NOT(S), D)) \
+	_op_(0xC0, MERGECOPY,	ROP_AND(S, P)) \
+	_op_(0xCC, SRCCOPY,		S) \
+	_op_(0xE2, DSPDxax,		ROP_XOR(D, ROP_AND(S, ROP_XOR(P, D)))) \
+	_op_(0xEE, SRCPAINT,	ROP_OR(S, D)) \
+	_op_(0xF0, PATCOPY,		P) \
+	_op_(0xFB, PATPAINT,	ROP_OR(D, ROP_OR(P, ROP_NOT(S)))) \
+	_op_(0xFF, WHITENESS,	ROP_ONES)
+
+/* Draws one row: pSrc and pDst hold width pixels, pPat holds the pattern
+ * row starting at the first pixel, repeated so that pPat[x & 7] and
+ * pPat[4 + (x & 7)] can be read for any x.
+ */
+typedef void (*prim_rop3_row_t)(const UINT32* pSrc, const UINT32* pPat,
+	UINT32* pDst, UINT32 width, BYTE rop);
+
+prim_rop3_row_t general_rop3_row(BYTE rop);
+
+void general_rop3_pattern_row(const UINT32* pPat, UINT32 patX, UINT32 patY,
+	UINT32 y, UINT32* pRow);
+
+pstatus_t general_rop3_32u(const UINT32* pSrc, INT32 srcStep,
+	const UINT32* pPat, UINT32 patX, UINT32 patY,
+	UINT32* pDst, INT32 dstStep,
+	UINT32 width, UINT32 height, BYTE rop);
+
+void primitives_init_rop_opt(primitives_t* prims);
+
+#endif /* !__PRIM_ROP_H_INCLUDED__ */
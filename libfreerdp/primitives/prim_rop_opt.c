@@ -0,0 +1,310 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * Optimized ternary raster operations.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+#include <winpr/sysinfo.h>
+
+#ifdef WITH_SSE2
+#include <emmintrin.h>
+#elif defined(WITH_NEON)
+#include <arm_neon.h>
+#endif /* WITH_SSE2 else WITH_NEON */
+
+#include "prim_internal.h"
+#include "prim_rop.h"
+
+/* The rows are drawn four pixels at a time, the pattern row being two
+ * vectors used in turn. Pixels left over at the end of a row, and rows
+ * where the source overlaps the destination with an offset, are drawn by
+ * the general version.
+ */
+
+#if defined(WITH_SSE2) || defined(WITH_NEON)
+/* Destination rows overlapped by their source with an offset must read what was drawn. */
+#define ROP3_ROW_OVERLAPS(_sptr_, _dptr_, _width_) \
+	(((_sptr_) != (_dptr_)) && ((_sptr_) < (_dptr_) + (_width_)) && ((_dptr_) < (_sptr_) + (_width_)))
+#endif
+
+#ifdef WITH_SSE2
+#define ROP_AND(_a_, _b_)	_mm_and_si128(_a_, _b_)
+#define ROP_ANDN(_a_, _b_)	_mm_andnot_si128(_a_, _b_)
+#define ROP_OR(_a_, _b_)	_mm_or_si128(_a_, _b_)
+#define ROP_XOR(_a_, _b_)	_mm_xor_si128(_a_, _b_)
+#define ROP_NOT(_a_)		_mm_xor_si128(_a_, ones)
+#define ROP_ZERO			_mm_setzero_si128()
+#define ROP_ONES			ones
+
+#define SSE2_ROP_MUX(_sel_, _a_, _b_) \
+	_mm_or_si128(_mm_and_si128(_sel_, _a_), _mm_andnot_si128(_sel_, _b_))
+
+#define SSE2_ROP3_PIXELS(_x_, _pattern_, _expr_) \
+	do { \
+		S = _mm_loadu_si128((const __m128i*) &pSrc[_x_]); \
+		D = _mm_loadu_si128((const __m128i*) &pDst[_x_]); \
+		P = _pattern_; \
+		_mm_storeu_si128((__m128i*) &pDst[_x_], _expr_); \
+	} while (0)
+
+#define SSE2_ROP3_ROW(_rop_, _name_, _expr_) \
+static void sse2_rop3_row_##_name_(const UINT32* pSrc, const UINT32* pPat, \
+	UINT32* pDst, UINT32 width, BYTE rop) \
+{ \
+	UINT32 x = 0; \
+	__m128i S, P, D; \
+	const __m128i ones = _mm_set1_epi32(-1); \
+	const __m128i P0 = _mm_loadu_si128((const __m128i*) &pPat[0]); \
+	const __m128i P1 = _mm_loadu_si128((const __m128i*) &pPat[4]); \
+	for (; x + 8 <= width; x += 8) \
+	{ \
+		SSE2_ROP3_PIXELS(x, P0, _expr_); \
+		SSE2_ROP3_PIXELS(x + 4, P1, _expr_); \
+	} \
+	if (x + 4 <= width) \
+	{ \
+		SSE2_ROP3_PIXELS(x, P0, _expr_); \
+		x += 4; \
+	} \
+	(void) S; (void) P; (void) D; (void) ones; \
+	if (x < width) \
+		general_rop3_row(rop)(&pSrc[x], &pPat[x & 7], &pDst[x], width - x, rop); \
+}
+
+PRIM_ROP3_LIST(SSE2_ROP3_ROW)
+
+/* ------------------------------------------------------------------------- */
+/* Any ternary ROP, see general_rop3_row_generic */
+static void sse2_rop3_row_generic(const UINT32* pSrc, const UINT32* pPat,
+	UINT32* pDst, UINT32 width, BYTE rop)
+{
+	int i;
+	UINT32 x;
+	__m128i m[8];
+	__m128i S, P, D;
+	__m128i f0, f1;
+	const __m128i P0 = _mm_loadu_si128((const __m128i*) &pPat[0]);
+	const __m128i P1 = _mm_loadu_si128((const __m128i*) &pPat[4]);
+
+	for (i = 0; i < 8; i++)
+		m[i] = _mm_set1_epi32((rop & (1 << i)) ? -1 : 0);
+
+	for (x = 0; x + 4 <= width; x += 4)
+	{
+		S = _mm_loadu_si128((const __m128i*) &pSrc[x]);
+		D = _mm_loadu_si128((const __m128i*) &pDst[x]);
+		P = (x & 4) ? P1 : P0;
+
+		f0 = SSE2_ROP_MUX(S, SSE2_ROP_MUX(D, m[3], m[2]), SSE2_ROP_MUX(D, m[1], m[0]));
+		f1 = SSE2_ROP_MUX(S, SSE2_ROP_MUX(D, m[7], m[6]), SSE2_ROP_MUX(D, m[5], m[4]));
+		_mm_storeu_si128((__m128i*) &pDst[x], SSE2_ROP_MUX(P, f1, f0));
+	}
+
+	if (x < width)
+		general_rop3_row(rop)(&pSrc[x], &pPat[x & 7], &pDst[x], width - x, rop);
+}
+
+/* ------------------------------------------------------------------------- */
+static prim_rop3_row_t sse2_rop3_row(BYTE rop)
+{
+#define SSE2_ROP3_CASE(_rop_, _name_, _expr_) \
+	case _rop_: return sse2_rop3_row_##_name_;
+
+	switch (rop)
+	{
+		PRIM_ROP3_LIST(SSE2_ROP3_CASE)
+	}
+
+#undef SSE2_ROP3_CASE
+
+	return sse2_rop3_row_generic;
+}
+
+/* ------------------------------------------------------------------------- */
+pstatus_t sse2_rop3_32u(
+	const UINT32* pSrc, INT32 srcStep,
+	const UINT32* pPat, UINT32 patX, UINT32 patY,
+	UINT32* pDst, INT32 dstStep,
+	UINT32 width, UINT32 height, BYTE rop)
+{
+	UINT32 y;
+	UINT32 pattern[16];
+	const UINT32* sptr = pSrc;
+	UINT32* dptr = pDst;
+	prim_rop3_row_t row = sse2_rop3_row(rop);
+	prim_rop3_row_t overlapRow = general_rop3_row(rop);
+
+	for (y = 0; y < height; y++)
+	{
+		general_rop3_pattern_row(pPat, patX, patY, y, pattern);
+
+		if (sptr && ROP3_ROW_OVERLAPS(sptr, dptr, width))
+			overlapRow(sptr, pattern, dptr, width, rop);
+		else
+			row(sptr ? sptr : dptr, pattern, dptr, width, rop);
+
+		if (sptr)
+			sptr = (const UINT32*) (((const BYTE*) sptr) + srcStep);
+
+		dptr = (UINT32*) (((BYTE*) dptr) + dstStep);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+#endif /* WITH_SSE2 */
+
+#ifdef WITH_NEON
+#define ROP_AND(_a_, _b_)	vandq_u32(_a_, _b_)
+#define ROP_ANDN(_a_, _b_)	vbicq_u32(_b_, _a_)
+#define ROP_OR(_a_, _b_)	vorrq_u32(_a_, _b_)
+#define ROP_XOR(_a_, _b_)	veorq_u32(_a_, _b_)
+#define ROP_NOT(_a_)		vmvnq_u32(_a_)
+#define ROP_ZERO			vdupq_n_u32(0)
+#define ROP_ONES			vdupq_n_u32(0xFFFFFFFF)
+
+#define NEON_ROP3_PIXELS(_x_, _pattern_, _expr_) \
+	do { \
+		S = vld1q_u32(&pSrc[_x_]); \
+		D = vld1q_u32(&pDst[_x_]); \
+		P = _pattern_; \
+		vst1q_u32(&pDst[_x_], _expr_); \
+	} while (0)
+
+#define NEON_ROP3_ROW(_rop_, _name_, _expr_) \
+static void neon_rop3_row_##_name_(const UINT32* pSrc, const UINT32* pPat, \
+	UINT32* pDst, UINT32 width, BYTE rop) \
+{ \
+	UINT32 x = 0; \
+	uint32x4_t S, P, D; \
+	const uint32x4_t P0 = vld1q_u32(&pPat[0]); \
+	const uint32x4_t P1 = vld1q_u32(&pPat[4]); \
+	for (; x + 8 <= width; x += 8) \
+	{ \
+		NEON_ROP3_PIXELS(x, P0, _expr_); \
+		NEON_ROP3_PIXELS(x + 4, P1, _expr_); \
+	} \
+	if (x + 4 <= width) \
+	{ \
+		NEON_ROP3_PIXELS(x, P0, _expr_); \
+		x += 4; \
+	} \
+	(void) S; (void) P; (void) D; \
+	if (x < width) \
+		general_rop3_row(rop)(&pSrc[x], &pPat[x & 7], &pDst[x], width - x, rop); \
+}
+
+PRIM_ROP3_LIST(NEON_ROP3_ROW)
+
+/* ------------------------------------------------------------------------- */
+/* Any ternary ROP, see general_rop3_row_generic */
+static void neon_rop3_row_generic(const UINT32* pSrc, const UINT32* pPat,
+	UINT32* pDst, UINT32 width, BYTE rop)
+{
+	int i;
+	UINT32 x;
+	uint32x4_t m[8];
+	uint32x4_t S, P, D;
+	uint32x4_t f0, f1;
+	const uint32x4_t P0 = vld1q_u32(&pPat[0]);
+	const uint32x4_t P1 = vld1q_u32(&pPat[4]);
+
+	for (i = 0; i < 8; i++)
+		m[i] = vdupq_n_u32((rop & (1 << i)) ? 0xFFFFFFFF : 0);
+
+	for (x = 0; x + 4 <= width; x += 4)
+	{
+		S = vld1q_u32(&pSrc[x]);
+		D = vld1q_u32(&pDst[x]);
+		P = (x & 4) ? P1 : P0;
+
+		/* vbslq selects the bits of its second operand where the first is set */
+		f0 = vbslq_u32(S, vbslq_u32(D, m[3], m[2]), vbslq_u32(D, m[1], m[0]));
+		f1 = vbslq_u32(S, vbslq_u32(D, m[7], m[6]), vbslq_u32(D, m[5], m[4]));
+		vst1q_u32(&pDst[x], vbslq_u32(P, f1, f0));
+	}
+
+	if (x < width)
+		general_rop3_row(rop)(&pSrc[x], &pPat[x & 7], &pDst[x], width - x, rop);
+}
+
+/* ------------------------------------------------------------------------- */
+static prim_rop3_row_t neon_rop3_row(BYTE rop)
+{
+#define NEON_ROP3_CASE(_rop_, _name_, _expr_) \
+	case _rop_: return neon_rop3_row_##_name_;
+
+	switch (rop)
+	{
+		PRIM_ROP3_LIST(NEON_ROP3_CASE)
+	}
+
+#undef NEON_ROP3_CASE
+
+	return neon_rop3_row_generic;
+}
+
+/* ------------------------------------------------------------------------- */
+pstatus_t neon_rop3_32u(
+	const UINT32* pSrc, INT32 srcStep,
+	const UINT32* pPat, UINT32 patX, UINT32 patY,
+	UINT32* pDst, INT32 dstStep,
+	UINT32 width, UINT32 height, BYTE rop)
+{
+	UINT32 y;
+	UINT32 pattern[16];
+	const UINT32* sptr = pSrc;
+	UINT32* dptr = pDst;
+	prim_rop3_row_t row = neon_rop3_row(rop);
+	prim_rop3_row_t overlapRow = general_rop3_row(rop);
+
+	for (y = 0; y < height; y++)
+	{
+		general_rop3_pattern_row(pPat, patX, patY, y, pattern);
+
+		if (sptr && ROP3_ROW_OVERLAPS(sptr, dptr, width))
+			overlapRow(sptr, pattern, dptr, width, rop);
+		else
+			row(sptr ? sptr : dptr, pattern, dptr, width, rop);
+
+		if (sptr)
+			sptr = (const UINT32*) (((const BYTE*) sptr) + srcStep);
+
+		dptr = (UINT32*) (((BYTE*) dptr) + dstStep);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+#endif /* WITH_NEON */
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_rop_opt(primitives_t* prims)
+{
+#if defined(WITH_SSE2)
+	if (IsProcessorFeaturePresent(PF_SSE2_INSTRUCTIONS_AVAILABLE))
+	{
+		prims->rop3_32u = sse2_rop3_32u;
+	}
+#elif defined(WITH_NEON)
+	if (IsProcessorFeaturePresent(PF_ARM_NEON_INSTRUCTIONS_AVAILABLE))
+	{
+		prims->rop3_32u = neon_rop3_32u;
+	}
+#endif /* WITH_SSE2 */
+}
@@ -0,0 +1,134 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * Pixel swizzle and expansion operations.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+
+#include "prim_internal.h"
+#include "prim_swizzle.h"
+
+/* ------------------------------------------------------------------------- */
+/* Swaps the first and third byte of every 32-bit pixel, i.e. converts
+ * between BGRX and RGBX byte orders. The alpha byte is kept when alpha is
+ * set and forced to 0xFF otherwise. Source and destination may be the same.
+ */
+pstatus_t general_RGBToBGR_8u_AC4R(
+	const BYTE* pSrc, INT32 srcStep,
+	BYTE* pDst, INT32 dstStep,
+	UINT32 width, UINT32 height,
+	BOOL alpha)
+{
+	int x, y;
+	BYTE r, g, b, a;
+	const BYTE* sptr = pSrc;
+	BYTE* dptr = pDst;
+	int srcPad = srcStep - (width * 4);
+	int dstPad = dstStep - (width * 4);
+
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			b = *sptr++;
+			g = *sptr++;
+			r = *sptr++;
+			a = *sptr++;
+
+			*dptr++ = r;
+			*dptr++ = g;
+			*dptr++ = b;
+			*dptr++ = alpha ? a : 0xFF;
+		}
+
+		sptr += srcPad;
+		dptr += dstPad;
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Expands packed 24-bit pixels to 32-bit pixels with an opaque alpha byte,
+ * swapping the first and third byte when invert is set.
+ */
+pstatus_t general_RGB24ToRGB32_8u_C3AC4R(
+	const BYTE* pSrc, INT32 srcStep,
+	BYTE* pDst, INT32 dstStep,
+	UINT32 width, UINT32 height,
+	BOOL invert)
+{
+	int x, y;
+	const BYTE* sptr = pSrc;
+	BYTE* dptr = pDst;
+	int srcPad = srcStep - (width * 3);
+	int dstPad = dstStep - (width * 4);
+
+	if (invert)
+	{
+		for (y = 0; y < height; y++)
+		{
+			for (x = 0; x < width; x++)
+			{
+				*dptr++ = sptr[2];
+				*dptr++ = sptr[1];
+				*dptr++ = sptr[0];
+				*dptr++ = 0xFF;
+				sptr += 3;
+			}
+
+			sptr += srcPad;
+			dptr += dstPad;
+		}
+	}
+	else
+	{
+		for (y = 0; y < height; y++)
+		{
+			for (x = 0; x < width; x++)
+			{
+				*dptr++ = *sptr++;
+				*dptr++ = *sptr++;
+				*dptr++ = *sptr++;
+				*dptr++ = 0xFF;
+			}
+
+			sptr += srcPad;
+			dptr += dstPad;
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_swizzle(primitives_t* prims)
+{
+	prims->RGBToBGR_8u_AC4R = general_RGBToBGR_8u_AC4R;
+	prims->RGB24ToRGB32_8u_C3AC4R = general_RGB24ToRGB32_8u_C3AC4R;
+
+	primitives_init_swizzle_opt(prims);
+}
+
+/* ------------------------------------------------------------------------- */
+void primitives_deinit_swizzle(primitives_t* prims)
+{
+	/* Nothing to do. */
+}
@@ -0,0 +1,328 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * Optimized pixel swizzle and expansion operations.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+#include <winpr/sysinfo.h>
+
+#ifdef WITH_SSE2
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#elif defined(WITH_NEON)
+#include <arm_neon.h>
+#endif /* WITH_SSE2 else WITH_NEON */
+
+#include "prim_internal.h"
+#include "prim_swizzle.h"
+
+#ifdef WITH_SSE2
+/* ------------------------------------------------------------------------- */
+pstatus_t sse2_RGBToBGR_8u_AC4R(
+	const BYTE* pSrc, INT32 srcStep,
+	BYTE* pDst, INT32 dstStep,
+	UINT32 width, UINT32 height,
+	BOOL alpha)
+{
+	int h;
+	const BYTE* sptr = pSrc;
+	BYTE* dptr = pDst;
+	int srcRowBump = srcStep - (width * 4);
+	int dstRowBump = dstStep - (width * 4);
+	__m128i P, Q, R_00FF00FF, R_FF00FF00, R_alpha;
+
+	R_00FF00FF = _mm_set1_epi32(0x00FF00FF);
+	R_FF00FF00 = _mm_set1_epi32(0xFF00FF00);
+	R_alpha = _mm_set1_epi32(alpha ? 0x00000000 : 0xFF000000);
+
+	for (h = 0; h < height; h++)
+	{
+		int w = width;
+
+		/* The main loop handles four pixels at a time. */
+		while (w >= 4)
+		{
+			P = _mm_loadu_si128((const __m128i*) sptr);
+			sptr += 16;
+
+			/* Rotating each pixel by 16 bits swaps bytes 0 and 2. */
+			Q = _mm_or_si128(_mm_slli_epi32(P, 16), _mm_srli_epi32(P, 16));
+			Q = _mm_and_si128(R_00FF00FF, Q);
+			P = _mm_and_si128(R_FF00FF00, P);
+			P = _mm_or_si128(_mm_or_si128(P, Q), R_alpha);
+
+			_mm_storeu_si128((__m128i*) dptr, P);
+			dptr += 16;
+			w -= 4;
+		}
+
+		if (w > 0)
+		{
+			general_RGBToBGR_8u_AC4R(sptr, srcStep, dptr, dstStep, w, 1, alpha);
+			sptr += w * 4;
+			dptr += w * 4;
+		}
+
+		sptr += srcRowBump;
+		dptr += dstRowBump;
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+pstatus_t ssse3_RGBToBGR_8u_AC4R(
+	const BYTE* pSrc, INT32 srcStep,
+	BYTE* pDst, INT32 dstStep,
+	UINT32 width, UINT32 height,
+	BOOL alpha)
+{
+	int h;
+	const BYTE* sptr = pSrc;
+	BYTE* dptr = pDst;
+	int srcRowBump = srcStep - (width * 4);
+	int dstRowBump = dstStep - (width * 4);
+	__m128i P0, P1, R_shuffle, R_alpha;
+
+	R_shuffle = _mm_set_epi8(15, 12, 13, 14, 11, 8, 9, 10, 7, 4, 5, 6, 3, 0, 1, 2);
+	R_alpha = _mm_set1_epi32(alpha ? 0x00000000 : 0xFF000000);
+
+	for (h = 0; h < height; h++)
+	{
+		int w = width;
+
+		/* The main loop handles eight pixels at a time. */
+		while (w >= 8)
+		{
+			P0 = _mm_loadu_si128((const __m128i*) sptr);
+			P1 = _mm_loadu_si128((const __m128i*) (sptr + 16));
+			sptr += 32;
+
+			P0 = _mm_or_si128(_mm_shuffle_epi8(P0, R_shuffle), R_alpha);
+			P1 = _mm_or_si128(_mm_shuffle_epi8(P1, R_shuffle), R_alpha);
+
+			_mm_storeu_si128((__m128i*) dptr, P0);
+			_mm_storeu_si128((__m128i*) (dptr + 16), P1);
+			dptr += 32;
+			w -= 8;
+		}
+
+		if (w > 0)
+		{
+			general_RGBToBGR_8u_AC4R(sptr, srcStep, dptr, dstStep, w, 1, alpha);
+			sptr += w * 4;
+			dptr += w * 4;
+		}
+
+		sptr += srcRowBump;
+		dptr += dstRowBump;
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Sixteen packed pixels span three registers. Each group of four pixels is
+ * realigned to the start of a register and then spread to 32-bit lanes
+ * with a single shuffle, which also takes care of the byte order.
+ */
+pstatus_t ssse3_RGB24ToRGB32_8u_C3AC4R(
+	const BYTE* pSrc, INT32 srcStep,
+	BYTE* pDst, INT32 dstStep,
+	UINT32 width, UINT32 height,
+	BOOL invert)
+{
+	int h;
+	const BYTE* sptr = pSrc;
+	BYTE* dptr = pDst;
+	int srcRowBump = srcStep - (width * 3);
+	int dstRowBump = dstStep - (width * 4);
+	__m128i A, B, C, R_shuffle, R_alpha;
+
+	if (invert)
+		R_shuffle = _mm_set_epi8(-1, 9, 10, 11, -1, 6, 7, 8, -1, 3, 4, 5, -1, 0, 1, 2);
+	else
+		R_shuffle = _mm_set_epi8(-1, 11, 10, 9, -1, 8, 7, 6, -1, 5, 4, 3, -1, 2, 1, 0);
+
+	R_alpha = _mm_set1_epi32(0xFF000000);
+
+	for (h = 0; h < height; h++)
+	{
+		int w = width;
+
+		/* The main loop handles sixteen pixels at a time. */
+		while (w >= 16)
+		{
+			A = _mm_loadu_si128((const __m128i*) sptr);
+			B = _mm_loadu_si128((const __m128i*) (sptr + 16));
+			C = _mm_loadu_si128((const __m128i*) (sptr + 32));
+			sptr += 48;
+
+			_mm_storeu_si128((__m128i*) dptr,
+				_mm_or_si128(_mm_shuffle_epi8(A, R_shuffle), R_alpha));
+			_mm_storeu_si128((__m128i*) (dptr + 16),
+				_mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(B, A, 12), R_shuffle), R_alpha));
+			_mm_storeu_si128((__m128i*) (dptr + 32),
+				_mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(C, B, 8), R_shuffle), R_alpha));
+			_mm_storeu_si128((__m128i*) (dptr + 48),
+				_mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128(C, 4), R_shuffle), R_alpha));
+			dptr += 64;
+			w -= 16;
+		}
+
+		if (w > 0)
+		{
+			general_RGB24ToRGB32_8u_C3AC4R(sptr, srcStep, dptr, dstStep, w, 1, invert);
+			sptr += w * 3;
+			dptr += w * 4;
+		}
+
+		sptr += srcRowBump;
+		dptr += dstRowBump;
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+#endif /* WITH_SSE2 */
+
+#ifdef WITH_NEON
+/* ------------------------------------------------------------------------- */
+pstatus_t neon_RGBToBGR_8u_AC4R(
+	const BYTE* pSrc, INT32 srcStep,
+	BYTE* pDst, INT32 dstStep,
+	UINT32 width, UINT32 height,
+	BOOL alpha)
+{
+	int h;
+	uint8x16_t tmp;
+	uint8x16x4_t P;
+	const BYTE* sptr = pSrc;
+	BYTE* dptr = pDst;
+	int srcRowBump = srcStep - (width * 4);
+	int dstRowBump = dstStep - (width * 4);
+
+	for (h = 0; h < height; h++)
+	{
+		int w = width;
+
+		/* The main loop handles sixteen pixels at a time. */
+		while (w >= 16)
+		{
+			P = vld4q_u8(sptr);
+			sptr += 64;
+
+			tmp = P.val[0];
+			P.val[0] = P.val[2];
+			P.val[2] = tmp;
+
+			if (!alpha)
+				P.val[3] = vdupq_n_u8(0xFF);
+
+			vst4q_u8(dptr, P);
+			dptr += 64;
+			w -= 16;
+		}
+
+		if (w > 0)
+		{
+			general_RGBToBGR_8u_AC4R(sptr, srcStep, dptr, dstStep, w, 1, alpha);
+			sptr += w * 4;
+			dptr += w * 4;
+		}
+
+		sptr += srcRowBump;
+		dptr += dstRowBump;
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+pstatus_t neon_RGB24ToRGB32_8u_C3AC4R(
+	const BYTE* pSrc, INT32 srcStep,
+	BYTE* pDst, INT32 dstStep,
+	UINT32 width, UINT32 height,
+	BOOL invert)
+{
+	int h;
+	uint8x16x3_t S;
+	uint8x16x4_t D;
+	const BYTE* sptr = pSrc;
+	BYTE* dptr = pDst;
+	int srcRowBump = srcStep - (width * 3);
+	int dstRowBump = dstStep - (width * 4);
+
+	D.val[3] = vdupq_n_u8(0xFF);
+
+	for (h = 0; h < height; h++)
+	{
+		int w = width;
+
+		/* The main loop handles sixteen pixels at a time. */
+		while (w >= 16)
+		{
+			S = vld3q_u8(sptr);
+			sptr += 48;
+
+			D.val[0] = invert ? S.val[2] : S.val[0];
+			D.val[1] = S.val[1];
+			D.val[2] = invert ? S.val[0] : S.val[2];
+
+			vst4q_u8(dptr, D);
+			dptr += 64;
+			w -= 16;
+		}
+
+		if (w > 0)
+		{
+			general_RGB24ToRGB32_8u_C3AC4R(sptr, srcStep, dptr, dstStep, w, 1, invert);
+			sptr += w * 3;
+			dptr += w * 4;
+		}
+
+		sptr += srcRowBump;
+		dptr += dstRowBump;
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+#endif /* WITH_NEON */
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_swizzle_opt(primitives_t* prims)
+{
+#if defined(WITH_SSE2)
+	if (IsProcessorFeaturePresentEx(PF_EX_SSSE3))
+	{
+		prims->RGBToBGR_8u_AC4R = ssse3_RGBToBGR_8u_AC4R;
+		prims->RGB24ToRGB32_8u_C3AC4R = ssse3_RGB24ToRGB32_8u_C3AC4R;
+	}
+	else if (IsProcessorFeaturePresent(PF_SSE2_INSTRUCTIONS_AVAILABLE))
+	{
+		prims->RGBToBGR_8u_AC4R = sse2_RGBToBGR_8u_AC4R;
+	}
+#elif defined(WITH_NEON)
+	if (IsProcessorFeaturePresent(PF_ARM_NEON_INSTRUCTIONS_AVAILABLE))
+	{
+		prims->RGBToBGR_8u_AC4R = neon_RGBToBGR_8u_AC4R;
+		prims->RGB24ToRGB32_8u_C3AC4R = neon_RGB24ToRGB32_8u_C3AC4R;
+	}
+#endif /* WITH_SSE2 */
+}
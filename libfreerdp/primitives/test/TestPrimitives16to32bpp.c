@@ -23,6 +23,7 @@
 #endif
 
 #include <winpr/sysinfo.h>
+#include <freerdp/codec/color.h>
 #include "prim_test.h"
 
 static const int RGB_TRIAL_ITERATIONS = 1000;
@@ -40,6 +41,16 @@ extern pstatus_t sse3_RGB565ToARGB_16u32u_C3C4(
 	UINT32* pDst, INT32 dstStep,
 	UINT32 width, UINT32 height,
 	BOOL alpha, BOOL invert);
+extern pstatus_t general_RGB555ToARGB_16u32u_C3C4(
+	const UINT16* pSrc, INT32 srcStep,
+	UINT32* pDst, INT32 dstStep,
+	UINT32 width, UINT32 height,
+	BOOL alpha, BOOL invert);
+extern pstatus_t sse2_RGB555ToARGB_16u32u_C3C4(
+	const UINT16* pSrc, INT32 srcStep,
+	UINT32* pDst, INT32 dstStep,
+	UINT32 width, UINT32 height,
+	BOOL alpha, BOOL invert);
 
 /* ------------------------------------------------------------------------- */
 static BOOL try_16To32(
@@ -157,6 +168,64 @@ int test_RGB565ToARGB_16u32u_C3C4_func(void)
 	return success ? SUCCESS : FAILURE;
 }
 
+/* ------------------------------------------------------------------------- */
+int test_RGB555ToARGB_16u32u_C3C4_func(void)
+{
+	int i, k;
+	BYTE r, g, b;
+	BOOL success = TRUE;
+	UINT16 ALIGN(data16[4096+3]);
+	UINT32 ALIGN(out1[4096+3]), ALIGN(out2[4096+3]);
+
+	get_random_data(data16, sizeof(data16));
+
+	for (k = 0; k < 4; k++)
+	{
+		BOOL alpha = (k & 1) ? TRUE : FALSE;
+		BOOL invert = (k & 2) ? TRUE : FALSE;
+
+		/* Odd width, unaligned destination */
+		general_RGB555ToARGB_16u32u_C3C4(data16 + 1, 61 * sizeof(UINT16),
+			out1 + 1, 61 * sizeof(UINT32), 61, 67, alpha, invert);
+
+		for (i = 0; i < 61 * 67; i++)
+		{
+			UINT32 expected;
+
+			GetRGB15(r, g, b, data16[i + 1]);
+			expected = invert ? ABGR32(0, r, g, b) : ARGB32(0, r, g, b);
+
+			if (alpha)
+				expected |= 0xFF000000;
+
+			if (out1[i + 1] != expected)
+			{
+				printf("RGB555ToARGB FAIL 0x%04x -> 0x%08x rather than 0x%08x\n",
+					data16[i + 1], out1[i + 1], expected);
+				success = FALSE;
+				break;
+			}
+		}
+
+#ifdef WITH_SSE2
+		if (IsProcessorFeaturePresent(PF_SSE2_INSTRUCTIONS_AVAILABLE))
+		{
+			sse2_RGB555ToARGB_16u32u_C3C4(data16 + 1, 61 * sizeof(UINT16),
+				out2 + 1, 61 * sizeof(UINT32), 61, 67, alpha, invert);
+
+			if (memcmp(out1 + 1, out2 + 1, 61 * 67 * sizeof(UINT32)) != 0)
+			{
+				printf("RGB555ToARGB-SSE2 FAIL (alpha %d, invert %d)\n", alpha, invert);
+				success = FALSE;
+			}
+		}
+#endif /* WITH_SSE2 */
+	}
+
+	if (success) printf("All RGB555ToARGB_16u32u_C3C4 tests passed.\n");
+	return success ? SUCCESS : FAILURE;
+}
+
 /* ------------------------------------------------------------------------- */
 STD_SPEED_TEST(
 	test16to32_speed, UINT16, UINT32, PRIM_NOP,
@@ -194,6 +263,11 @@ int TestPrimitives16to32bpp(int argc, char* argv[])
 
 	status = test_RGB565ToARGB_16u32u_C3C4_func();
 
+	if (status != SUCCESS)
+		return 1;
+
+	status = test_RGB555ToARGB_16u32u_C3C4_func();
+
 	if (status != SUCCESS)
 		return 1;
 
@@ -0,0 +1,244 @@
+/* TestPrimitivesSwizzle.c
+ * vi:ts=4 sw=4
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <winpr/sysinfo.h>
+#include "prim_test.h"
+
+static const int SWIZZLE_TRIAL_ITERATIONS = 20000;
+static const float TEST_TIME = 4.0;
+
+extern BOOL g_TestPrimitivesPerformance;
+
+extern pstatus_t general_RGBToBGR_8u_AC4R(const BYTE* pSrc, INT32 srcStep,
+	BYTE* pDst, INT32 dstStep, UINT32 width, UINT32 height, BOOL alpha);
+extern pstatus_t sse2_RGBToBGR_8u_AC4R(const BYTE* pSrc, INT32 srcStep,
+	BYTE* pDst, INT32 dstStep, UINT32 width, UINT32 height, BOOL alpha);
+extern pstatus_t ssse3_RGBToBGR_8u_AC4R(const BYTE* pSrc, INT32 srcStep,
+	BYTE* pDst, INT32 dstStep, UINT32 width, UINT32 height, BOOL alpha);
+extern pstatus_t general_RGB24ToRGB32_8u_C3AC4R(const BYTE* pSrc, INT32 srcStep,
+	BYTE* pDst, INT32 dstStep, UINT32 width, UINT32 height, BOOL invert);
+extern pstatus_t ssse3_RGB24ToRGB32_8u_C3AC4R(const BYTE* pSrc, INT32 srcStep,
+	BYTE* pDst, INT32 dstStep, UINT32 width, UINT32 height, BOOL invert);
+
+/* ------------------------------------------------------------------------- */
+int test_RGBToBGR_8u_AC4R_func(void)
+{
+	int x, y, k;
+	BOOL success = TRUE;
+	BYTE ALIGN(in[64 * 4 * 17 + 4]);
+	BYTE ALIGN(out_c[64 * 4 * 17 + 4]);
+	BYTE ALIGN(out_sse[64 * 4 * 17 + 4]);
+	const int width = 61;
+	const int height = 17;
+	const int step = 64 * 4;
+
+	get_random_data(in, sizeof(in));
+
+	for (k = 0; k < 2; k++)
+	{
+		BOOL alpha = k ? TRUE : FALSE;
+
+		ZeroMemory(out_c, sizeof(out_c));
+		general_RGBToBGR_8u_AC4R(in + 4, step, out_c + 4, step, width, height, alpha);
+
+		for (y = 0; y < height; y++)
+		{
+			for (x = 0; x < width; x++)
+			{
+				const BYTE* s = &in[4 + (y * step) + (x * 4)];
+				const BYTE* d = &out_c[4 + (y * step) + (x * 4)];
+
+				if ((d[0] != s[2]) || (d[1] != s[1]) || (d[2] != s[0]) ||
+						(d[3] != (alpha ? s[3] : 0xFF)))
+				{
+					printf("RGBToBGR FAIL at %d,%d (alpha %d)\n", x, y, alpha);
+					return FAILURE;
+				}
+			}
+		}
+
+#ifdef WITH_SSE2
+		if (IsProcessorFeaturePresent(PF_SSE2_INSTRUCTIONS_AVAILABLE))
+		{
+			ZeroMemory(out_sse, sizeof(out_sse));
+			sse2_RGBToBGR_8u_AC4R(in + 4, step, out_sse + 4, step, width, height, alpha);
+
+			if (memcmp(out_c, out_sse, sizeof(out_c)) != 0)
+			{
+				printf("RGBToBGR-SSE2 FAIL (alpha %d)\n", alpha);
+				success = FALSE;
+			}
+		}
+
+		if (IsProcessorFeaturePresentEx(PF_EX_SSSE3))
+		{
+			ZeroMemory(out_sse, sizeof(out_sse));
+			ssse3_RGBToBGR_8u_AC4R(in + 4, step, out_sse + 4, step, width, height, alpha);
+
+			if (memcmp(out_c, out_sse, sizeof(out_c)) != 0)
+			{
+				printf("RGBToBGR-SSSE3 FAIL (alpha %d)\n", alpha);
+				success = FALSE;
+			}
+		}
+#endif /* WITH_SSE2 */
+	}
+
+	if (success) printf("All RGBToBGR_8u_AC4R tests passed.\n");
+	return success ? SUCCESS : FAILURE;
+}
+
+/* ------------------------------------------------------------------------- */
+int test_RGB24ToRGB32_8u_C3AC4R_func(void)
+{
+	int x, y, k;
+	BOOL success = TRUE;
+	BYTE ALIGN(in[64 * 3 * 17 + 3]);
+	BYTE ALIGN(out_c[64 * 4 * 17 + 4]);
+	BYTE ALIGN(out_sse[64 * 4 * 17 + 4]);
+	const int width = 61;
+	const int height = 17;
+	const int srcStep = 64 * 3;
+	const int dstStep = 64 * 4;
+
+	get_random_data(in, sizeof(in));
+
+	for (k = 0; k < 2; k++)
+	{
+		BOOL invert = k ? TRUE : FALSE;
+
+		ZeroMemory(out_c, sizeof(out_c));
+		general_RGB24ToRGB32_8u_C3AC4R(in + 3, srcStep, out_c + 4, dstStep, width, height, invert);
+
+		for (y = 0; y < height; y++)
+		{
+			for (x = 0; x < width; x++)
+			{
+				const BYTE* s = &in[3 + (y * srcStep) + (x * 3)];
+				const BYTE* d = &out_c[4 + (y * dstStep) + (x * 4)];
+
+				if ((d[0] != s[invert ? 2 : 0]) || (d[1] != s[1]) ||
+						(d[2] != s[invert ? 0 : 2]) || (d[3] != 0xFF))
+				{
+					printf("RGB24ToRGB32 FAIL at %d,%d (invert %d)\n", x, y, invert);
+					return FAILURE;
+				}
+			}
+		}
+
+#ifdef WITH_SSE2
+		if (IsProcessorFeaturePresentEx(PF_EX_SSSE3))
+		{
+			ZeroMemory(out_sse, sizeof(out_sse));
+			ssse3_RGB24ToRGB32_8u_C3AC4R(in + 3, srcStep, out_sse + 4, dstStep, width, height, invert);
+
+			if (memcmp(out_c, out_sse, sizeof(out_c)) != 0)
+			{
+				printf("RGB24ToRGB32-SSSE3 FAIL (invert %d)\n", invert);
+				success = FALSE;
+			}
+		}
+#endif /* WITH_SSE2 */
+	}
+
+	if (success) printf("All RGB24ToRGB32_8u_C3AC4R tests passed.\n");
+	return success ? SUCCESS : FAILURE;
+}
+
+/* ------------------------------------------------------------------------- */
+STD_SPEED_TEST(
+	rgb_to_bgr_speed, BYTE, BYTE, PRIM_NOP,
+	TRUE, general_RGBToBGR_8u_AC4R(src1, 64*4, dst, 64*4, 64, 64, FALSE),
+#ifdef WITH_SSE2
+	TRUE, ssse3_RGBToBGR_8u_AC4R(src1, 64*4, dst, 64*4, 64, 64, FALSE),
+		PF_EX_SSSE3, TRUE,
+#else
+	FALSE, PRIM_NOP, 0, FALSE,
+#endif
+	FALSE, PRIM_NOP);
+
+STD_SPEED_TEST(
+	rgb24_to_rgb32_speed, BYTE, BYTE, PRIM_NOP,
+	TRUE, general_RGB24ToRGB32_8u_C3AC4R(src1, 64*3, dst, 64*4, 64, 64, FALSE),
+#ifdef WITH_SSE2
+	TRUE, ssse3_RGB24ToRGB32_8u_C3AC4R(src1, 64*3, dst, 64*4, 64, 64, FALSE),
+		PF_EX_SSSE3, TRUE,
+#else
+	FALSE, PRIM_NOP, 0, FALSE,
+#endif
+	FALSE, PRIM_NOP);
+
+/* ------------------------------------------------------------------------- */
+int test_RGBToBGR_8u_AC4R_speed(void)
+{
+	BYTE ALIGN(src[64 * 64 * 4]);
+	BYTE ALIGN(dst[64 * 64 * 4]);
+	int size_array[] = { 64 };
+
+	get_random_data(src, sizeof(src));
+
+	rgb_to_bgr_speed("RGBToBGR", "aligned", src, NULL, 0, dst,
+		size_array, 1, SWIZZLE_TRIAL_ITERATIONS, TEST_TIME);
+	return SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+int test_RGB24ToRGB32_8u_C3AC4R_speed(void)
+{
+	BYTE ALIGN(src[64 * 64 * 3]);
+	BYTE ALIGN(dst[64 * 64 * 4]);
+	int size_array[] = { 64 };
+
+	get_random_data(src, sizeof(src));
+
+	rgb24_to_rgb32_speed("RGB24ToRGB32", "aligned", src, NULL, 0, dst,
+		size_array, 1, SWIZZLE_TRIAL_ITERATIONS, TEST_TIME);
+	return SUCCESS;
+}
+
+int TestPrimitivesSwizzle(int argc, char* argv[])
+{
+	int status;
+
+	status = test_RGBToBGR_8u_AC4R_func();
+
+	if (status != SUCCESS)
+		return 1;
+
+	status = test_RGB24ToRGB32_8u_C3AC4R_func();
+
+	if (status != SUCCESS)
+		return 1;
+
+	if (g_TestPrimitivesPerformance)
+	{
+		status = test_RGBToBGR_8u_AC4R_speed();
+
+		if (status != SUCCESS)
+			return 1;
+
+		status = test_RGB24ToRGB32_8u_C3AC4R_speed();
+
+		if (status != SUCCESS)
+			return 1;
+	}
+
+	return 0;
+}
@@ -34,6 +34,12 @@ extern pstatus_t general_YCoCgToRGB_8u_AC4R(const BYTE *pSrc, INT32 srcStep,
 extern pstatus_t ssse3_YCoCgRToRGB_8u_AC4R(const BYTE *pSrc, INT32 srcStep,
 	BYTE *pDst, INT32 dstStep, UINT32 width, UINT32 height,
 	UINT8 shift, BOOL withAlpha, BOOL invert);
+extern pstatus_t general_RGBToYCoCg_8u_AC4R(const BYTE *pSrc, INT32 srcStep,
+	BYTE *pDst, INT32 dstStep, UINT32 width, UINT32 height,
+	UINT8 shift, BOOL withAlpha, BOOL invert);
+extern pstatus_t sse2_RGBToYCoCgR_8u_AC4R(const BYTE *pSrc, INT32 srcStep,
+	BYTE *pDst, INT32 dstStep, UINT32 width, UINT32 height,
+	UINT8 shift, BOOL withAlpha, BOOL invert);
 
 /* ------------------------------------------------------------------------- */
 int test_YCoCgRToRGB_8u_AC4R_func(void)
@@ -109,12 +115,107 @@ int test_YCoCgRToRGB_8u_AC4R_speed(void)
 	return SUCCESS;
 }
 
+/* ------------------------------------------------------------------------- */
+int test_RGBToYCoCgR_8u_AC4R_func(void)
+{
+	INT32 ALIGN(in[4098]);
+	INT32 ALIGN(out_c[4098]), ALIGN(out_rgb[4098]);
+	INT32 ALIGN(out_sse[4098]);
+	char testStr[256];
+	BOOL failed = FALSE;
+	BOOL invert;
+	BYTE* a;
+	BYTE* b;
+	int i, j;
+
+	testStr[0] = '\0';
+	get_random_data(in, sizeof(in));
+
+	/* With a color loss level of 1 the conversion is off by one at most. */
+	general_RGBToYCoCg_8u_AC4R((const BYTE *) (in+1), 63*4,
+		(BYTE *) out_c, 63*4, 63, 61, 1, TRUE, FALSE);
+	general_YCoCgToRGB_8u_AC4R((const BYTE *) out_c, 63*4,
+		(BYTE *) out_rgb, 63*4, 63, 61, 1, TRUE, FALSE);
+
+	a = (BYTE *) (in+1);
+	b = (BYTE *) out_rgb;
+
+	for (i=0; i<63*61*4; ++i)
+	{
+		if (abs(a[i] - b[i]) > 1) {
+			printf("RGBToYCoCgR round trip FAIL[%d]: 0x%08x -> 0x%08x\n", i/4,
+				in[i/4+1], out_rgb[i/4]);
+			failed = TRUE;
+			break;
+		}
+	}
+#ifdef WITH_SSE2
+	if (IsProcessorFeaturePresent(PF_SSE2_INSTRUCTIONS_AVAILABLE))
+	{
+		strcat(testStr, " SSE2");
+
+		for (j=0; j<4; ++j)
+		{
+			invert = (j & 1) ? TRUE : FALSE;
+
+			general_RGBToYCoCg_8u_AC4R((const BYTE *) (in+1), 63*4,
+				(BYTE *) out_c, 63*4, 63, 61, (j < 2) ? 1 : 3, (j < 2), invert);
+			sse2_RGBToYCoCgR_8u_AC4R((const BYTE *) (in+1), 63*4,
+				(BYTE *) out_sse, 63*4, 63, 61, (j < 2) ? 1 : 3, (j < 2), invert);
+
+			for (i=0; i<63*61; ++i)
+			{
+				if (out_c[i] != out_sse[i]) {
+					printf("RGBToYCoCgR-SSE FAIL[%d][%d]: 0x%08x -> C 0x%08x vs SSE 0x%08x\n", j, i,
+						in[i+1], out_c[i], out_sse[i]);
+					failed = TRUE;
+					break;
+				}
+			}
+		}
+	}
+#endif /* i386 */
+	if (!failed) printf("All RGBToYCoCgR_8u_AC4R tests passed (%s).\n", testStr);
+	return (failed > 0) ? FAILURE : SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+STD_SPEED_TEST(
+	rgb_to_ycocg_speed, BYTE, BYTE, PRIM_NOP,
+	TRUE, general_RGBToYCoCg_8u_AC4R(src1, 64*4, dst, 64*4, 64, 64, 2, FALSE, FALSE),
+#ifdef WITH_SSE2
+	TRUE, sse2_RGBToYCoCgR_8u_AC4R(src1, 64*4, dst, 64*4, 64, 64, 2, FALSE, FALSE),
+		PF_SSE2_INSTRUCTIONS_AVAILABLE, FALSE,
+#else
+	FALSE, PRIM_NOP, 0, FALSE,
+#endif
+	FALSE, PRIM_NOP);
+
+int test_RGBToYCoCgR_8u_AC4R_speed(void)
+{
+	INT32 ALIGN(in[4096]);
+	INT32 ALIGN(out[4096]);
+	int size_array[] = { 64 };
+
+	get_random_data(in, sizeof(in));
+
+	rgb_to_ycocg_speed("RGBToYCoCg", "aligned", (const BYTE *) in,
+		0, 0, (BYTE *) out,
+		size_array, 1, YCOCG_TRIAL_ITERATIONS, TEST_TIME);
+	return SUCCESS;
+}
+
 int TestPrimitivesYCoCg(int argc, char* argv[])
 {
 	int status;
 
 	status = test_YCoCgRToRGB_8u_AC4R_func();
 
+	if (status != SUCCESS)
+		return 1;
+
+	status = test_RGBToYCoCgR_8u_AC4R_func();
+
 	if (status != SUCCESS)
 		return 1;
 
@@ -122,6 +223,11 @@ int TestPrimitivesYCoCg(int argc, char* argv[])
 	{
 		status = test_YCoCgRToRGB_8u_AC4R_speed();
 
+		if (status != SUCCESS)
+			return 1;
+
+		status = test_RGBToYCoCgR_8u_AC4R_speed();
+
 		if (status != SUCCESS)
 			return 1;
 	}
@@ -85,6 +85,12 @@ extern int test_YCoCgRToRGB_8u_AC4R_speed(void);
 
 extern int test_RGB565ToARGB_16u32u_C3C4_func(void);
 extern int test_RGB565ToARGB_16u32u_C3C4_speed(void);
+extern int test_RGB555ToARGB_16u32u_C3C4_func(void);
+
+extern int test_RGBToBGR_8u_AC4R_func(void);
+extern int test_RGBToBGR_8u_AC4R_speed(void);
+extern int test_RGB24ToRGB32_8u_C3AC4R_func(void);
+extern int test_RGB24ToRGB32_8u_C3AC4R_speed(void);
 
 extern int test_alphaComp_func(void);
 extern int test_alphaComp_speed(void);
@@ -0,0 +1,132 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Allocation Counting
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include "allocations.h"
+
+/**
+ * malloc, calloc, realloc and the aligned allocators (posix_memalign,
+ * memalign, aligned_alloc) are interposed and forwarded to the glibc
+ * allocator, which stays reachable as __libc_malloc and __libc_memalign.
+ * _aligned_malloc is built on malloc and counted with it.
+ *
+ * The interposers are exported even when building with hidden visibility,
+ * so that the shared libraries of the executable allocate through them.
+ */
+
+#ifdef FREERDP_COUNT_ALLOCATIONS
+
+#define ALLOCATIONS_EXPORT	__attribute__((visibility("default")))
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nmemb, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+
+static volatile UINT64 g_Allocations = 0;
+static volatile UINT64 g_AllocatedBytes = 0;
+static __thread UINT64 g_ThreadAllocations = 0;
+static __thread UINT64 g_ThreadAllocatedBytes = 0;
+
+static void allocations_count(size_t size)
+{
+	g_ThreadAllocations++;
+	g_ThreadAllocatedBytes += size;
+	__sync_fetch_and_add(&g_Allocations, 1);
+	__sync_fetch_and_add(&g_AllocatedBytes, size);
+}
+
+ALLOCATIONS_EXPORT void* malloc(size_t size)
+{
+	allocations_count(size);
+	return __libc_malloc(size);
+}
+
+ALLOCATIONS_EXPORT void* calloc(size_t nmemb, size_t size)
+{
+	allocations_count(nmemb * size);
+	return __libc_calloc(nmemb, size);
+}
+
+ALLOCATIONS_EXPORT void* realloc(void* ptr, size_t size)
+{
+	allocations_count(size);
+	return __libc_realloc(ptr, size);
+}
+
+ALLOCATIONS_EXPORT void* memalign(size_t alignment, size_t size)
+{
+	allocations_count(size);
+	return __libc_memalign(alignment, size);
+}
+
+ALLOCATIONS_EXPORT void* aligned_alloc(size_t alignment, size_t size)
+{
+	allocations_count(size);
+	return __libc_memalign(alignment, size);
+}
+
+ALLOCATIONS_EXPORT int posix_memalign(void** memptr, size_t alignment, size_t size)
+{
+	void* ptr;
+
+	if (!alignment || (alignment % sizeof(void*)) || (alignment & (alignment - 1)))
+		return EINVAL;
+
+	allocations_count(size);
+	ptr = __libc_memalign(alignment, size);
+
+	if (!ptr)
+		return ENOMEM;
+
+	*memptr = ptr;
+	return 0;
+}
+
+void freerdp_allocations_get_thread(UINT64* count, UINT64* bytes)
+{
+	*count = g_ThreadAllocations;
+	*bytes = g_ThreadAllocatedBytes;
+}
+
+void freerdp_allocations_get_total(UINT64* count, UINT64* bytes)
+{
+	*count = __sync_fetch_and_add(&g_Allocations, 0);
+	*bytes = __sync_fetch_and_add(&g_AllocatedBytes, 0);
+}
+
+#else
+
+void freerdp_allocations_get_thread(UINT64* count, UINT64* bytes)
+{
+	*count = 0;
+	*bytes = 0;
+}
+
+void freerdp_allocations_get_total(UINT64* count, UINT64* bytes)
+{
+	*count = 0;
+	*bytes = 0;
+}
+
+#endif
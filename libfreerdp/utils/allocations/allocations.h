@@ -0,0 +1,42 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Allocation Counting
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_UTILS_ALLOCATIONS_H
+#define FREERDP_UTILS_ALLOCATIONS_H
+
+#include <winpr/wtypes.h>
+
+/**
+ * Static helper for tools measuring allocations, such as freerdp-codec-bench
+ * and freerdp-replay. Linking it into an executable replaces the process
+ * allocator with a counting one, it must never be linked into a library.
+ *
+ * Counting is only done on glibc, FREERDP_COUNT_ALLOCATIONS is defined there.
+ * Elsewhere the counters stay at zero.
+ */
+
+#ifdef __GLIBC__
+#define FREERDP_COUNT_ALLOCATIONS	1
+#endif
+
+/* allocations made by the calling thread */
+void freerdp_allocations_get_thread(UINT64* count, UINT64* bytes);
+
+/* allocations made by all threads */
+void freerdp_allocations_get_total(UINT64* count, UINT64* bytes);
+
+#endif /* FREERDP_UTILS_ALLOCATIONS_H */
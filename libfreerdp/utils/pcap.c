@@ -205,12 +205,18 @@ rdpPcap* pcap_open(char* name, BOOL write)
 
 void pcap_flush(rdpPcap* pcap)
 {
+	pcap_record* record;
+
 	while (pcap->record != NULL)
 	{
-		pcap_write_record(pcap, pcap->record);
-		pcap->record = pcap->record->next;
+		record = pcap->record;
+		pcap_write_record(pcap, record);
+		pcap->record = record->next;
+		free(record);
 	}
 
+	pcap->head = pcap->tail = NULL;
+
 	if (pcap->fp != NULL)
 		fflush(pcap->fp);
 }
@@ -31,6 +31,9 @@
 
 static const AUDIO_FORMAT test_audio_formats[] =
 {
+#ifdef WITH_OPUS
+	{ WAVE_FORMAT_OPUS, 2, 48000, 12000, 4, 0, 0, NULL },
+#endif
 	{ WAVE_FORMAT_PCM, 2, 44100, 176400, 4, 16, 0, NULL },
 	{ WAVE_FORMAT_ALAW, 2, 22050, 44100, 2, 8, 0, NULL }
 };
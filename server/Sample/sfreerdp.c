@@ -34,6 +34,7 @@
 #include <freerdp/channels/channels.h>
 
 #include <freerdp/constants.h>
+#include <freerdp/reactor.h>
 #include <freerdp/server/rdpsnd.h>
 
 #include "sf_audin.h"
@@ -51,6 +52,7 @@
 
 static char* test_pcap_file = NULL;
 static BOOL test_dump_rfx_realtime = TRUE;
+static freerdp_reactor* test_reactor = NULL;
 
 BOOL test_peer_context_new(freerdp_peer* client, testPeerContext* context)
 {
@@ -700,19 +702,10 @@ static BOOL tf_peer_suppress_output(rdpContext* context, BYTE allow, RECTANGLE_1
 	return TRUE;
 }
 
-static void* test_peer_mainloop(void* arg)
+static BOOL test_peer_setup(freerdp_peer* client)
 {
-	HANDLE handles[32];
-	DWORD count;
-	DWORD status;
-	testPeerContext* context;
-	freerdp_peer* client = (freerdp_peer*) arg;
-
 	if (!test_peer_init(client))
-	{
-		freerdp_peer_free(client);
-		return NULL;
-	}
+		return FALSE;
 
 	/* Initialize the real server settings here */
 	client->settings->CertificateFile = _strdup("server.crt");
@@ -746,9 +739,48 @@ static void* test_peer_mainloop(void* arg)
 	client->settings->MultifragMaxRequestSize = 0xFFFFFF; /* FIXME */
 
 	client->Initialize(client);
-	context = (testPeerContext*) client->context;
 	WLog_INFO(TAG, "We've got a client %s", client->local ? "(local)" : client->hostname);
 
+	return TRUE;
+}
+
+static BOOL test_peer_check_fds(freerdp_peer* client)
+{
+	testPeerContext* context = (testPeerContext*) client->context;
+
+	if (client->CheckFileDescriptor(client) != TRUE)
+		return FALSE;
+
+	if (WTSVirtualChannelManagerCheckFileDescriptor(context->vcm) != TRUE)
+		return FALSE;
+
+	return TRUE;
+}
+
+static void test_peer_closed(freerdp_peer* client)
+{
+	WLog_INFO(TAG, "Client %s disconnected.", client->local ? "(local)" : client->hostname);
+	client->Disconnect(client);
+	freerdp_peer_context_free(client);
+	freerdp_peer_free(client);
+}
+
+static void* test_peer_mainloop(void* arg)
+{
+	HANDLE handles[32];
+	DWORD count;
+	DWORD status;
+	testPeerContext* context;
+	freerdp_peer* client = (freerdp_peer*) arg;
+
+	if (!test_peer_setup(client))
+	{
+		freerdp_peer_free(client);
+		return NULL;
+	}
+
+	context = (testPeerContext*) client->context;
+
 	while (1)
 	{
 		count = 0;
@@ -763,17 +795,11 @@ static void* test_peer_mainloop(void* arg)
 			break;
 		}
 
-		if (client->CheckFileDescriptor(client) != TRUE)
-			break;
-
-		if (WTSVirtualChannelManagerCheckFileDescriptor(context->vcm) != TRUE)
+		if (!test_peer_check_fds(client))
 			break;
 	}
 
-	WLog_INFO(TAG, "Client %s disconnected.", client->local ? "(local)" : client->hostname);
-	client->Disconnect(client);
-	freerdp_peer_context_free(client);
-	freerdp_peer_free(client);
+	test_peer_closed(client);
 
 	return NULL;
 }
@@ -781,6 +807,28 @@ static void* test_peer_mainloop(void* arg)
 static BOOL test_peer_accepted(freerdp_listener* instance, freerdp_peer* client)
 {
 	HANDLE hThread;
+	HANDLE handles[2];
+	testPeerContext* context;
+
+	if (test_reactor)
+	{
+		/* the listener frees the peer when it is not accepted */
+		if (!test_peer_setup(client))
+			return FALSE;
+
+		context = (testPeerContext*) client->context;
+		handles[0] = client->GetEventHandle(client);
+		handles[1] = WTSVirtualChannelManagerGetEventHandle(context->vcm);
+
+		if (!freerdp_reactor_add_peer(test_reactor, client, handles, 2,
+				test_peer_check_fds, test_peer_closed))
+		{
+			freerdp_peer_context_free(client);
+			return FALSE;
+		}
+
+		return TRUE;
+	}
 
 	if (!(hThread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE) test_peer_mainloop, (void*) client, 0, NULL)))
 		return FALSE;
@@ -824,6 +872,8 @@ static void test_server_mainloop(freerdp_listener* instance)
 
 int main(int argc, char* argv[])
 {
+	int index;
+	BOOL reactor = FALSE;
 	WSADATA wsaData;
 	freerdp_listener* instance;
 
@@ -832,15 +882,23 @@ int main(int argc, char* argv[])
 
 	instance->PeerAccepted = test_peer_accepted;
 
-	if (argc > 1)
-		test_pcap_file = argv[1];
-
-	if (argc > 2 && !strcmp(argv[2], "--fast"))
-		test_dump_rfx_realtime = FALSE;
+	for (index = 1; index < argc; index++)
+	{
+		if (!strcmp(argv[index], "--fast"))
+			test_dump_rfx_realtime = FALSE;
+		else if (!strcmp(argv[index], "--reactor"))
+			reactor = TRUE;
+		else if (!test_pcap_file)
+			test_pcap_file = argv[index];
+	}
 
 	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
 		return 0;
 
+	/* Serve all peers from a shared event loop instead of a thread per peer. */
+	if (reactor && !(test_reactor = freerdp_reactor_new(0)))
+		WLog_WARN(TAG, "Failed to create reactor, using a thread per peer");
+
 	/* Open the server socket and start listening. */
 
 	if (instance->Open(instance, NULL, 3389) &&
@@ -850,6 +908,8 @@ int main(int argc, char* argv[])
 		test_server_mainloop(instance);
 	}
 
+	freerdp_reactor_free(test_reactor);
+
 	freerdp_listener_free(instance);
 
 	WSACleanup();
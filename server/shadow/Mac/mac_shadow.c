@@ -367,7 +367,7 @@ void (^mac_capture_stream_handler)(CGDisplayStreamFrameStatus, uint64_t, IOSurfa
 			
 		count = ArrayList_Count(server->clients);
 			
-		shadow_multiclient_publish_and_wait(subsystem->updateEvent);
+		shadow_multiclient_publish(subsystem->updateEvent, surface, &(subsystem->invalidRegion));
 		
 		if (count == 1)
 		{
@@ -288,7 +288,7 @@ int win_shadow_surface_copy(winShadowSubsystem* subsystem)
 
 	count = ArrayList_Count(server->clients);
 
-	shadow_multiclient_publish_and_wait(subsystem->updateEvent);
+	shadow_multiclient_publish(subsystem->updateEvent, surface, &(subsystem->invalidRegion));
 
 	ArrayList_Unlock(server->clients);
 
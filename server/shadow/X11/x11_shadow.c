@@ -481,6 +481,32 @@ int x11_shadow_handle_xevent(x11ShadowSubsystem* subsystem, XEvent* xevent)
 	{
 
 	}
+#ifdef WITH_XDAMAGE
+	else if (subsystem->use_xdamage && (xevent->type == subsystem->xdamage_notify_event))
+	{
+		int left, top;
+		int right, bottom;
+		RECTANGLE_16 damageRect;
+		rdpShadowSurface* surface = subsystem->server->surface;
+		XDamageNotifyEvent* notify = (XDamageNotifyEvent*) xevent;
+
+		/* the damaged area is on the root window, only keep what is on the surface */
+		left = MAX(notify->area.x - surface->x, 0);
+		top = MAX(notify->area.y - surface->y, 0);
+		right = MIN(notify->area.x + notify->area.width - surface->x, surface->width);
+		bottom = MIN(notify->area.y + notify->area.height - surface->y, surface->height);
+
+		if ((left < right) && (top < bottom))
+		{
+			damageRect.left = left;
+			damageRect.top = top;
+			damageRect.right = right;
+			damageRect.bottom = bottom;
+
+			region16_union_rect(&(subsystem->damageRegion), &(subsystem->damageRegion), &damageRect);
+		}
+	}
+#endif
 #ifdef WITH_XFIXES
 	else if (xevent->type == subsystem->xfixes_cursor_notify_event)
 	{
@@ -507,7 +533,7 @@ void x11_shadow_validate_region(x11ShadowSubsystem* subsystem, int x, int y, int
 	region.width = width;
 	region.height = height;
 
-#ifdef WITH_XFIXES
+#if defined(WITH_XFIXES) && defined(WITH_XDAMAGE)
 	XFixesSetRegion(subsystem->display, subsystem->xdamage_region, &region, 1);
 	XDamageSubtract(subsystem->display, subsystem->xdamage, subsystem->xdamage_region, None);
 #endif
@@ -628,6 +654,110 @@ int x11_shadow_blend_cursor(x11ShadowSubsystem* subsystem)
 	return 1;
 }
 
+/**
+ * Captures the accumulated XDamage region only: damaged rectangles are copied
+ * into the XShm pixmap (or fetched with XGetImage), compared against the
+ * surface and copied into it, the changed areas being added to invalidRegion.
+ */
+
+static int x11_shadow_capture_damage(x11ShadowSubsystem* subsystem, const RECTANGLE_16* surfaceRect)
+{
+	int index;
+	int status;
+	int nbRects;
+	int nSrcStep;
+	int x, y;
+	int width, height;
+	XImage* image;
+	BYTE* pSrcData;
+	BYTE* pDstData;
+	RECTANGLE_16 invalidRect;
+	const RECTANGLE_16* rects;
+	rdpShadowSurface* surface;
+
+	surface = subsystem->server->surface;
+
+	region16_intersect_rect(&(subsystem->damageRegion), &(subsystem->damageRegion), surfaceRect);
+
+	if (region16_is_empty(&(subsystem->damageRegion)))
+		return 0;
+
+	rects = region16_rects(&(subsystem->damageRegion), &nbRects);
+
+	XLockDisplay(subsystem->display);
+
+#ifdef WITH_XDAMAGE
+	/* anything damaged from now on is reported again */
+	XDamageSubtract(subsystem->display, subsystem->xdamage, None, None);
+#endif
+
+	if (subsystem->use_xshm)
+	{
+		for (index = 0; index < nbRects; index++)
+		{
+			XCopyArea(subsystem->display, subsystem->root_window, subsystem->fb_pixmap, subsystem->xshm_gc,
+					surface->x + rects[index].left, surface->y + rects[index].top,
+					rects[index].right - rects[index].left, rects[index].bottom - rects[index].top,
+					rects[index].left, rects[index].top);
+		}
+
+		XSync(subsystem->display, False);
+	}
+
+	for (index = 0; index < nbRects; index++)
+	{
+		x = rects[index].left;
+		y = rects[index].top;
+		width = rects[index].right - rects[index].left;
+		height = rects[index].bottom - rects[index].top;
+
+		if (subsystem->use_xshm)
+		{
+			image = subsystem->fb_image;
+			nSrcStep = image->bytes_per_line;
+			pSrcData = (BYTE*) &image->data[(y * nSrcStep) + (x * 4)];
+		}
+		else
+		{
+			image = XGetImage(subsystem->display, subsystem->root_window,
+					surface->x + x, surface->y + y, width, height, AllPlanes, ZPixmap);
+
+			if (!image)
+				continue;
+
+			nSrcStep = image->bytes_per_line;
+			pSrcData = (BYTE*) image->data;
+		}
+
+		pDstData = &surface->data[(y * surface->scanline) + (x * 4)];
+
+		status = shadow_capture_compare(pDstData, surface->scanline, width, height,
+				pSrcData, nSrcStep, &invalidRect);
+
+		if (status > 0)
+		{
+			invalidRect.left += x;
+			invalidRect.top += y;
+			invalidRect.right += x;
+			invalidRect.bottom += y;
+
+			region16_union_rect(&(subsystem->invalidRegion), &(subsystem->invalidRegion), &invalidRect);
+
+			freerdp_image_copy(pDstData, PIXEL_FORMAT_XRGB32, surface->scanline, 0, 0, width, height,
+					pSrcData, PIXEL_FORMAT_XRGB32, nSrcStep, 0, 0, NULL);
+		}
+
+		if (!subsystem->use_xshm)
+			XDestroyImage(image);
+	}
+
+	XUnlockDisplay(subsystem->display);
+
+	region16_clear(&(subsystem->damageRegion));
+
+	return 1;
+}
+
 int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 {
 	int count;
@@ -659,53 +789,68 @@ int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 	surfaceRect.right = surface->width;
 	surfaceRect.bottom = surface->height;
 
-	XLockDisplay(subsystem->display);
-
-	if (subsystem->use_xshm)
+	if (subsystem->use_xdamage)
 	{
-		image = subsystem->fb_image;
+		x11_shadow_capture_damage(subsystem, &surfaceRect);
 
-		XCopyArea(subsystem->display, subsystem->root_window, subsystem->fb_pixmap,
-				subsystem->xshm_gc, 0, 0, subsystem->width, subsystem->height, 0, 0);
-
-		status = shadow_capture_compare(surface->data, surface->scanline, surface->width, surface->height,
-				(BYTE*) &(image->data[surface->width * 4]), image->bytes_per_line, &invalidRect);
+		region16_intersect_rect(&(subsystem->invalidRegion), &(subsystem->invalidRegion), &surfaceRect);
 	}
 	else
 	{
-		image = XGetImage(subsystem->display, subsystem->root_window,
-					surface->x, surface->y, surface->width, surface->height, AllPlanes, ZPixmap);
+		XLockDisplay(subsystem->display);
 
-		status = shadow_capture_compare(surface->data, surface->scanline, surface->width, surface->height,
-				(BYTE*) image->data, image->bytes_per_line, &invalidRect);
-	}
+		if (subsystem->use_xshm)
+		{
+			image = subsystem->fb_image;
 
-	XSync(subsystem->display, False);
+			XCopyArea(subsystem->display, subsystem->root_window, subsystem->fb_pixmap,
+					subsystem->xshm_gc, 0, 0, subsystem->width, subsystem->height, 0, 0);
 
-	XUnlockDisplay(subsystem->display);
+			status = shadow_capture_compare(surface->data, surface->scanline, surface->width, surface->height,
+					(BYTE*) &(image->data[surface->width * 4]), image->bytes_per_line, &invalidRect);
+		}
+		else
+		{
+			image = XGetImage(subsystem->display, subsystem->root_window,
+						surface->x, surface->y, surface->width, surface->height, AllPlanes, ZPixmap);
+
+			status = shadow_capture_compare(surface->data, surface->scanline, surface->width, surface->height,
+					(BYTE*) image->data, image->bytes_per_line, &invalidRect);
+		}
 
-	region16_union_rect(&(subsystem->invalidRegion), &(subsystem->invalidRegion), &invalidRect);
-	region16_intersect_rect(&(subsystem->invalidRegion), &(subsystem->invalidRegion), &surfaceRect);
+		XSync(subsystem->display, False);
 
-	if (!region16_is_empty(&(subsystem->invalidRegion)))
-	{
-		extents = region16_extents(&(subsystem->invalidRegion));
+		XUnlockDisplay(subsystem->display);
 
-		x = extents->left;
-		y = extents->top;
-		width = extents->right - extents->left;
-		height = extents->bottom - extents->top;
+		region16_union_rect(&(subsystem->invalidRegion), &(subsystem->invalidRegion), &invalidRect);
+		region16_intersect_rect(&(subsystem->invalidRegion), &(subsystem->invalidRegion), &surfaceRect);
+
+		if (!region16_is_empty(&(subsystem->invalidRegion)))
+		{
+			extents = region16_extents(&(subsystem->invalidRegion));
 
-		freerdp_image_copy(surface->data, PIXEL_FORMAT_XRGB32,
-				surface->scanline, x, y, width, height,
-				(BYTE*) image->data, PIXEL_FORMAT_XRGB32,
-				image->bytes_per_line, x, y, NULL);
+			x = extents->left;
+			y = extents->top;
+			width = extents->right - extents->left;
+			height = extents->bottom - extents->top;
 
+			freerdp_image_copy(surface->data, PIXEL_FORMAT_XRGB32,
+					surface->scanline, x, y, width, height,
+					(BYTE*) image->data, PIXEL_FORMAT_XRGB32,
+					image->bytes_per_line, x, y, NULL);
+		}
+
+		if (!subsystem->use_xshm)
+			XDestroyImage(image);
+	}
+
+	if (!region16_is_empty(&(subsystem->invalidRegion)))
+	{
 		//x11_shadow_blend_cursor(subsystem);
 
 		count = ArrayList_Count(server->clients);
 
-		shadow_multiclient_publish_and_wait(subsystem->updateEvent);
+		shadow_multiclient_publish(subsystem->updateEvent, surface, &(subsystem->invalidRegion));
 
 		if (count == 1)
 		{
@@ -722,9 +867,6 @@ int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 		region16_clear(&(subsystem->invalidRegion));
 	}
 
-	if (!subsystem->use_xshm)
-		XDestroyImage(image);
-
 	return 1;
 }
 
@@ -741,6 +883,12 @@ int x11_shadow_subsystem_process_message(x11ShadowSubsystem* subsystem, wMessage
 			{
 				region16_union_rect(&(subsystem->invalidRegion),
 						&(subsystem->invalidRegion), &msg->rects[index]);
+
+				if (subsystem->use_xdamage)
+				{
+					region16_union_rect(&(subsystem->damageRegion),
+							&(subsystem->damageRegion), &msg->rects[index]);
+				}
 			}
 		}
 		else
@@ -754,6 +902,12 @@ int x11_shadow_subsystem_process_message(x11ShadowSubsystem* subsystem, wMessage
 
 			region16_union_rect(&(subsystem->invalidRegion),
 						&(subsystem->invalidRegion), &refreshRect);
+
+			if (subsystem->use_xdamage)
+			{
+				region16_union_rect(&(subsystem->damageRegion),
+						&(subsystem->damageRegion), &refreshRect);
+			}
 		}
 	}
 	else if (message->id == SHADOW_MSG_IN_SUPPRESS_OUTPUT_ID)
@@ -775,6 +929,40 @@ int x11_shadow_subsystem_process_message(x11ShadowSubsystem* subsystem, wMessage
 	return 1;
 }
 
+/**
+ * With XDamage, the thread sleeps until the X connection or the message queue
+ * is signaled: damage is captured as soon as it is reported, at most once per
+ * frame interval, and the pointer position is polled only while clients are
+ * connected.
+ */
+
+static DWORD x11_shadow_damage_timeout(x11ShadowSubsystem* subsystem, UINT64 grabTime, UINT64 pointerTime)
+{
+	UINT64 cTime;
+	UINT64 dueTime;
+	rdpShadowServer* server = subsystem->server;
+
+	/* events read by other Xlib calls do not signal the connection */
+	if (XEventsQueued(subsystem->display, QueuedAlready))
+		return 0;
+
+	if (ArrayList_Count(server->clients) < 1)
+		return INFINITE;
+
+	dueTime = pointerTime;
+
+	if (!region16_is_empty(&(subsystem->damageRegion)) ||
+			!region16_is_empty(&(subsystem->invalidRegion)))
+	{
+		if (grabTime < dueTime)
+			dueTime = grabTime;
+	}
+
+	cTime = GetTickCount64();
+
+	return (cTime > dueTime) ? 0 : (DWORD) (dueTime - cTime);
+}
+
 void* x11_shadow_subsystem_thread(x11ShadowSubsystem* subsystem)
 {
 	XEvent xevent;
@@ -784,6 +972,7 @@ void* x11_shadow_subsystem_thread(x11ShadowSubsystem* subsystem)
 	DWORD dwTimeout;
 	DWORD dwInterval;
 	UINT64 frameTime;
+	UINT64 pointerTime;
 	HANDLE events[32];
 	wMessage message;
 	wMessagePipe* MsgPipe;
@@ -797,11 +986,19 @@ void* x11_shadow_subsystem_thread(x11ShadowSubsystem* subsystem)
 	subsystem->captureFrameRate = 16;
 	dwInterval = 1000 / subsystem->captureFrameRate;
 	frameTime = GetTickCount64() + dwInterval;
+	pointerTime = frameTime;
 
 	while (1)
 	{
-		cTime = GetTickCount64();
-		dwTimeout = (cTime > frameTime) ? 0 : frameTime - cTime;
+		if (subsystem->use_xdamage)
+		{
+			dwTimeout = x11_shadow_damage_timeout(subsystem, frameTime, pointerTime);
+		}
+		else
+		{
+			cTime = GetTickCount64();
+			dwTimeout = (cTime > frameTime) ? 0 : frameTime - cTime;
+		}
 
 		status = WaitForMultipleObjects(nCount, events, FALSE, dwTimeout);
 
@@ -816,16 +1013,36 @@ void* x11_shadow_subsystem_thread(x11ShadowSubsystem* subsystem)
 			}
 		}
 
-		if (WaitForSingleObject(subsystem->event, 0) == WAIT_OBJECT_0)
+		if ((WaitForSingleObject(subsystem->event, 0) == WAIT_OBJECT_0) ||
+				XEventsQueued(subsystem->display, QueuedAlready))
 		{
-			if (XEventsQueued(subsystem->display, QueuedAlready))
+			while (XPending(subsystem->display))
 			{
 				XNextEvent(subsystem->display, &xevent);
 				x11_shadow_handle_xevent(subsystem, &xevent);
 			}
 		}
 
-		if ((status == WAIT_TIMEOUT) || (GetTickCount64() > frameTime))
+		if (subsystem->use_xdamage)
+		{
+			cTime = GetTickCount64();
+
+			if ((cTime >= frameTime) && (!region16_is_empty(&(subsystem->damageRegion)) ||
+					!region16_is_empty(&(subsystem->invalidRegion))))
+			{
+				x11_shadow_screen_grab(subsystem);
+
+				dwInterval = 1000 / subsystem->captureFrameRate;
+				frameTime = cTime + dwInterval;
+			}
+
+			if (cTime >= pointerTime)
+			{
+				x11_shadow_query_cursor(subsystem, FALSE);
+				pointerTime = cTime + (1000 / subsystem->captureFrameRate);
+			}
+		}
+		else if ((status == WAIT_TIMEOUT) || (GetTickCount64() > frameTime))
 		{
 			x11_shadow_screen_grab(subsystem);
 			x11_shadow_query_cursor(subsystem, FALSE);
@@ -1142,6 +1359,17 @@ int x11_shadow_subsystem_init(x11ShadowSubsystem* subsystem)
 
 	XFreeExtensionList(extensions);
 
+	if (subsystem->composite)
+	{
+		char name[32];
+
+		/* root window damage is only unreliable with a running compositing manager */
+		sprintf_s(name, sizeof(name), "_NET_WM_CM_S%d", subsystem->number);
+
+		if (XGetSelectionOwner(subsystem->display, XInternAtom(subsystem->display, name, False)) == None)
+			subsystem->composite = FALSE;
+	}
+
 	if (subsystem->composite)
 		subsystem->use_xdamage = FALSE;
 
@@ -1213,16 +1441,22 @@ int x11_shadow_subsystem_init(x11ShadowSubsystem* subsystem)
 			subsystem->use_xinerama = FALSE;
 	}
 
-	if (subsystem->use_xshm)
+	if (subsystem->use_xdamage)
+	{
+		if (x11_shadow_xdamage_init(subsystem) < 0)
+			subsystem->use_xdamage = FALSE;
+	}
+
+	/* XShm is only used for damage-limited capture */
+
+	if (subsystem->use_xshm && subsystem->use_xdamage)
 	{
 		if (x11_shadow_xshm_init(subsystem) < 0)
 			subsystem->use_xshm = FALSE;
 	}
-
-	if (subsystem->use_xdamage)
+	else
 	{
-		if (x11_shadow_xdamage_init(subsystem) < 0)
-			subsystem->use_xdamage = FALSE;
+		subsystem->use_xshm = FALSE;
 	}
 
 	if (!(subsystem->event = CreateFileDescriptorEvent(NULL, FALSE, FALSE, subsystem->xfds)))
@@ -1320,11 +1554,13 @@ x11ShadowSubsystem* x11_shadow_subsystem_new()
 	subsystem->ExtendedMouseEvent = (pfnShadowExtendedMouseEvent) x11_shadow_input_extended_mouse_event;
 
 	subsystem->composite = FALSE;
-	subsystem->use_xshm = FALSE; /* temporarily disabled */
+	subsystem->use_xshm = TRUE;
 	subsystem->use_xfixes = TRUE;
-	subsystem->use_xdamage = FALSE;
+	subsystem->use_xdamage = TRUE;
 	subsystem->use_xinerama = TRUE;
 
+	region16_init(&(subsystem->damageRegion));
+
 	return subsystem;
 }
 
@@ -1335,6 +1571,8 @@ void x11_shadow_subsystem_free(x11ShadowSubsystem* subsystem)
 
 	x11_shadow_subsystem_uninit(subsystem);
 
+	region16_uninit(&(subsystem->damageRegion));
+
 	free(subsystem);
 }
 
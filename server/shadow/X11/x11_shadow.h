@@ -75,11 +75,14 @@ struct x11_shadow_subsystem
 	BOOL use_xdamage;
 	BOOL use_xinerama;
 
+	GC xshm_gc;
 	XImage* fb_image;
 	Pixmap fb_pixmap;
 	Window root_window;
 	XShmSegmentInfo fb_shm_info;
 
+	REGION16 damageRegion;
+
 	int cursorHotX;
 	int cursorHotY;
 	int cursorWidth;
@@ -90,7 +93,6 @@ struct x11_shadow_subsystem
 	int cursorMaxHeight;
 
 #ifdef WITH_XDAMAGE
-	GC xshm_gc;
 	Damage xdamage;
 	int xdamage_notify_event;
 	XserverRegion xdamage_region;
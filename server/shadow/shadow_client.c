@@ -513,14 +513,10 @@ int shadow_client_send_surface_bits(rdpShadowClient* client, rdpShadowSurface* s
 
 int shadow_client_send_bitmap_update(rdpShadowClient* client, rdpShadowSurface* surface, int nXSrc, int nYSrc, int nWidth, int nHeight)
 {
-	BYTE* data;
-	BYTE* buffer;
 	int yIdx, xIdx, k;
 	int rows, cols;
 	int nSrcStep;
 	BYTE* pSrcData;
-	UINT32 DstSize;
-	UINT32 SrcFormat;
 	BITMAP_DATA* bitmap;
 	rdpUpdate* update;
 	rdpContext* context;
@@ -549,7 +545,6 @@ int shadow_client_send_bitmap_update(rdpShadowClient* client, rdpShadowSurface*
 
 	pSrcData = surface->data;
 	nSrcStep = surface->scanline;
-	SrcFormat = PIXEL_FORMAT_RGB32;
 
 	if ((nXSrc % 4) != 0)
 	{
@@ -569,13 +564,13 @@ int shadow_client_send_bitmap_update(rdpShadowClient* client, rdpShadowSurface*
 	k = 0;
 	totalBitmapSize = 0;
 
-	bitmapUpdate.count = bitmapUpdate.number = rows * cols;
-	bitmapData = (BITMAP_DATA*) malloc(sizeof(BITMAP_DATA) * bitmapUpdate.number);
-	bitmapUpdate.rectangles = bitmapData;
-
-	if (!bitmapData)
+	/* the bitmap data array and the tile buffers are sized for the whole screen */
+	if ((rows * cols) > (encoder->gridWidth * encoder->gridHeight))
 		return -1;
 
+	bitmapData = encoder->bitmapData;
+	bitmapUpdate.rectangles = bitmapData;
+
 	if ((nWidth % 4) != 0)
 	{
 		nXSrc -= (nWidth % 4);
@@ -612,48 +607,16 @@ int shadow_client_send_bitmap_update(rdpShadowClient* client, rdpShadowSurface*
 			if ((bitmap->width < 4) || (bitmap->height < 4))
 				continue;
 
-			if (settings->ColorDepth < 32)
-			{
-				int bitsPerPixel = settings->ColorDepth;
-				int bytesPerPixel = (bitsPerPixel + 7) / 8;
-
-				DstSize = 64 * 64 * 4;
-				buffer = encoder->grid[k];
-
-				interleaved_compress(encoder->interleaved, buffer, &DstSize, bitmap->width, bitmap->height,
-						pSrcData, SrcFormat, nSrcStep, bitmap->destLeft, bitmap->destTop, NULL, bitsPerPixel);
-
-				bitmap->bitmapDataStream = buffer;
-				bitmap->bitmapLength = DstSize;
-				bitmap->bitsPerPixel = bitsPerPixel;
-				bitmap->cbScanWidth = bitmap->width * bytesPerPixel;
-				bitmap->cbUncompressedSize = bitmap->width * bitmap->height * bytesPerPixel;
-			}
-			else
-			{
-				int dstSize;
-
-				buffer = encoder->grid[k];
-				data = &pSrcData[(bitmap->destTop * nSrcStep) + (bitmap->destLeft * 4)];
-
-				buffer = freerdp_bitmap_compress_planar(encoder->planar, data, SrcFormat,
-						bitmap->width, bitmap->height, nSrcStep, buffer, &dstSize);
-
-				bitmap->bitmapDataStream = buffer;
-				bitmap->bitmapLength = dstSize;
-				bitmap->bitsPerPixel = 32;
-				bitmap->cbScanWidth = bitmap->width * 4;
-				bitmap->cbUncompressedSize = bitmap->width * bitmap->height * 4;
-			}
-
-			bitmap->cbCompFirstRowSize = 0;
-			bitmap->cbCompMainBodySize = bitmap->bitmapLength;
-
-			totalBitmapSize += bitmap->bitmapLength;
 			k++;
 		}
 	}
 
+	shadow_encoder_compress_bitmaps(encoder, pSrcData, nSrcStep, k,
+			(settings->ColorDepth < 32) ? settings->ColorDepth : 32);
+
+	for (yIdx = 0; yIdx < k; yIdx++)
+		totalBitmapSize += bitmapData[yIdx].bitmapLength;
+
 	bitmapUpdate.count = bitmapUpdate.number = k;
 
 	updateSizeEstimate = totalBitmapSize + (k * bitmapUpdate.count) + 16;
@@ -663,10 +626,11 @@ int shadow_client_send_bitmap_update(rdpShadowClient* client, rdpShadowSurface*
 		UINT32 i, j;
 		UINT32 updateSize;
 		UINT32 newUpdateSize;
-		BITMAP_DATA* fragBitmapData;
 
-		fragBitmapData = (BITMAP_DATA*) malloc(sizeof(BITMAP_DATA) * k);
-		bitmapUpdate.rectangles = fragBitmapData;
+		/**
+		 * Send the tiles in consecutive slices of the bitmap data array,
+		 * no copy of the entries is needed.
+		 */
 
 		i = j = 0;
 		updateSize = 1024;
@@ -675,39 +639,36 @@ int shadow_client_send_bitmap_update(rdpShadowClient* client, rdpShadowSurface*
 		{
 			newUpdateSize = updateSize + (bitmapData[i].bitmapLength + 16);
 
-			if ((newUpdateSize < maxUpdateSize) && ((i + 1) < k))
+			if (((newUpdateSize < maxUpdateSize) || (i == j)) && ((i + 1) < k))
 			{
-				CopyMemory(&fragBitmapData[j++], &bitmapData[i++], sizeof(BITMAP_DATA));
+				i++;
 				updateSize = newUpdateSize;
 			}
 			else
 			{
 				if ((i + 1) >= k)
 				{
-					CopyMemory(&fragBitmapData[j++], &bitmapData[i++], sizeof(BITMAP_DATA));
+					i++;
 					updateSize = newUpdateSize;
 				}
-				
-				bitmapUpdate.count = bitmapUpdate.number = j;
+
+				bitmapUpdate.rectangles = &bitmapData[j];
+				bitmapUpdate.count = bitmapUpdate.number = i - j;
 				IFCALL(update->BitmapUpdate, context, &bitmapUpdate);
 				updateSize = 1024;
-				j = 0;
+				j = i;
 			}
 		}
-
-		free(fragBitmapData);
 	}
 	else
 	{
 		IFCALL(update->BitmapUpdate, context, &bitmapUpdate);
 	}
 
-	free(bitmapData);
-
 	return 1;
 }
 
-int shadow_client_send_surface_update(rdpShadowClient* client)
+int shadow_client_send_surface_update(rdpShadowClient* client, rdpShadowFrame* frame)
 {
 	int status = -1;
 	int nXSrc, nYSrc;
@@ -726,7 +687,12 @@ int shadow_client_send_surface_update(rdpShadowClient* client)
 	server = client->server;
 	encoder = client->encoder;
 
-	surface = client->inLobby ? client->lobby : server->surface;
+	if (client->inLobby)
+		surface = client->lobby;
+	else if (frame)
+		surface = frame->surface;
+	else
+		return 1; /* nothing captured yet */
 
 	EnterCriticalSection(&(client->lock));
 
@@ -780,7 +746,6 @@ int shadow_client_send_surface_update(rdpShadowClient* client)
 
 int shadow_client_surface_update(rdpShadowClient* client, REGION16* region)
 {
-	int index;
 	int numRects = 0;
 	const RECTANGLE_16* rects;
 
@@ -788,10 +753,7 @@ int shadow_client_surface_update(rdpShadowClient* client, REGION16* region)
 
 	rects = region16_rects(region, &numRects);
 
-	for (index = 0; index < numRects; index++)
-	{
-		region16_union_rect(&(client->invalidRegion), &(client->invalidRegion), &rects[index]);
-	}
+	region16_union_rects(&(client->invalidRegion), &(client->invalidRegion), rects, numRects);
 
 	LeaveCriticalSection(&(client->lock));
 
@@ -944,34 +906,10 @@ int shadow_client_subsystem_process_message(rdpShadowClient* client, wMessage* m
 	return 1;
 }
 
-void* shadow_client_thread(rdpShadowClient* client)
+static BOOL shadow_client_init_peer(rdpShadowClient* client)
 {
-	DWORD status;
-	DWORD nCount;
-	wMessage message;
-	HANDLE events[32];
-	HANDLE StopEvent;
-	HANDLE ClientEvent;
-	HANDLE ChannelEvent;
-	void* UpdateSubscriber;
-	HANDLE UpdateEvent;
-	freerdp_peer* peer;
-	rdpContext* context;
-	rdpSettings* settings;
-	rdpShadowServer* server;
-	rdpShadowScreen* screen;
-	rdpShadowEncoder* encoder;
-	rdpShadowSubsystem* subsystem;
-	wMessagePipe* MsgPipe = client->subsystem->MsgPipe;
-
-	server = client->server;
-	screen = server->screen;
-	encoder = client->encoder;
-	subsystem = server->subsystem;
-
-	context = (rdpContext*) client;
-	peer = context->peer;
-	settings = peer->settings;
+	freerdp_peer* peer = ((rdpContext*) client)->peer;
+	rdpShadowSubsystem* subsystem = client->server->subsystem;
 
 	peer->Capabilities = shadow_client_capabilities;
 	peer->PostConnect = shadow_client_post_connect;
@@ -986,99 +924,138 @@ void* shadow_client_thread(rdpShadowClient* client)
 	peer->update->SurfaceFrameAcknowledge = (pSurfaceFrameAcknowledge)shadow_client_surface_frame_acknowledge;
 
 	if ((!client->StopEvent) || (!client->vcm) || (!subsystem->updateEvent))
-		goto out;
+		return FALSE;
 
-	UpdateSubscriber = shadow_multiclient_get_subscriber(subsystem->updateEvent);
-	if (!UpdateSubscriber)
-		goto out;
+	client->updateSubscriber = shadow_multiclient_get_subscriber(subsystem->updateEvent);
 
-	StopEvent = client->StopEvent;
-	UpdateEvent = shadow_multiclient_getevent(UpdateSubscriber);
-	ClientEvent = peer->GetEventHandle(peer);
-	ChannelEvent = WTSVirtualChannelManagerGetEventHandle(client->vcm);
+	if (!client->updateSubscriber)
+		return FALSE;
 
-	while (1)
-	{
-		nCount = 0;
-		events[nCount++] = StopEvent;
-		events[nCount++] = UpdateEvent;
-		events[nCount++] = ClientEvent;
-		events[nCount++] = ChannelEvent;
-		events[nCount++] = MessageQueue_Event(MsgPipe->Out);
+	return TRUE;
+}
 
-		status = WaitForMultipleObjects(nCount, events, FALSE, INFINITE);
+static DWORD shadow_client_get_event_handles(rdpShadowClient* client, HANDLE* events)
+{
+	DWORD nCount = 0;
+	freerdp_peer* peer = ((rdpContext*) client)->peer;
 
-		if (WaitForSingleObject(StopEvent, 0) == WAIT_OBJECT_0)
-		{
-			break;
-		}
+	events[nCount++] = client->StopEvent;
+	events[nCount++] = shadow_multiclient_getevent(client->updateSubscriber);
+	events[nCount++] = peer->GetEventHandle(peer);
+	events[nCount++] = WTSVirtualChannelManagerGetEventHandle(client->vcm);
+	events[nCount++] = MessageQueue_Event(client->subsystem->MsgPipe->Out);
 
-		if (WaitForSingleObject(UpdateEvent, 0) == WAIT_OBJECT_0)
-		{
-			if (client->activated)
-			{
-				int index;
-				int numRects = 0;
-				const RECTANGLE_16* rects;
+	return nCount;
+}
 
-				rects = region16_rects(&(subsystem->invalidRegion), &numRects);
+/**
+ * Services whichever client handles are signaled, returns FALSE
+ * when the client should be disconnected.
+ */
 
-				for (index = 0; index < numRects; index++)
-				{
-					region16_union_rect(&(client->invalidRegion), &(client->invalidRegion), &rects[index]);
-				}
+static BOOL shadow_client_check_events(rdpShadowClient* client)
+{
+	wMessage message;
+	freerdp_peer* peer = ((rdpContext*) client)->peer;
+	void* UpdateSubscriber = client->updateSubscriber;
+	wMessagePipe* MsgPipe = client->subsystem->MsgPipe;
 
-				shadow_client_send_surface_update(client);
-			}
+	if (WaitForSingleObject(client->StopEvent, 0) == WAIT_OBJECT_0)
+	{
+		return FALSE;
+	}
 
-			/* 
-			 * The return value of shadow_multiclient_consume is whether or not the subscriber really consumes the event.
-			 * It's not cared currently.
-			 */
-			(void)shadow_multiclient_consume(UpdateSubscriber);
-		}
+	if (WaitForSingleObject(shadow_multiclient_getevent(UpdateSubscriber), 0) == WAIT_OBJECT_0)
+	{
+		rdpShadowFrame* frame;
+
+		/*
+		 * Damage published while this client was busy is merged into its
+		 * invalid region, and only the latest frame gets encoded.
+		 */
+		EnterCriticalSection(&(client->lock));
+		frame = shadow_multiclient_consume(UpdateSubscriber, &(client->invalidRegion));
+		LeaveCriticalSection(&(client->lock));
+
+		if (client->activated)
+			shadow_client_send_surface_update(client, frame);
+
+		shadow_multiclient_release_frame(UpdateSubscriber, frame);
+	}
 
-		if (WaitForSingleObject(ClientEvent, 0) == WAIT_OBJECT_0)
+	if (WaitForSingleObject(peer->GetEventHandle(peer), 0) == WAIT_OBJECT_0)
+	{
+		if (!peer->CheckFileDescriptor(peer))
 		{
-			if (!peer->CheckFileDescriptor(peer))
-			{
-				WLog_ERR(TAG, "Failed to check FreeRDP file descriptor");
-				break;
-			}
+			WLog_ERR(TAG, "Failed to check FreeRDP file descriptor");
+			return FALSE;
 		}
+	}
 
-		if (WaitForSingleObject(ChannelEvent, 0) == WAIT_OBJECT_0)
+	if (WaitForSingleObject(WTSVirtualChannelManagerGetEventHandle(client->vcm), 0) == WAIT_OBJECT_0)
+	{
+		if (!WTSVirtualChannelManagerCheckFileDescriptor(client->vcm))
 		{
-			if (!WTSVirtualChannelManagerCheckFileDescriptor(client->vcm))
-			{
-				WLog_ERR(TAG, "WTSVirtualChannelManagerCheckFileDescriptor failure");
-				break;
-			}
+			WLog_ERR(TAG, "WTSVirtualChannelManagerCheckFileDescriptor failure");
+			return FALSE;
 		}
+	}
 
-		if (WaitForSingleObject(MessageQueue_Event(MsgPipe->Out), 0) == WAIT_OBJECT_0)
+	if (WaitForSingleObject(MessageQueue_Event(MsgPipe->Out), 0) == WAIT_OBJECT_0)
+	{
+		if (MessageQueue_Peek(MsgPipe->Out, &message, TRUE))
 		{
-			if (MessageQueue_Peek(MsgPipe->Out, &message, TRUE))
-			{
-				if (message.id == WMQ_QUIT)
-					break;
+			if (message.id == WMQ_QUIT)
+				return FALSE;
 
-				shadow_client_subsystem_process_message(client, &message);
-			}
+			shadow_client_subsystem_process_message(client, &message);
 		}
 	}
 
-	if (UpdateSubscriber)
+	return TRUE;
+}
+
+static BOOL shadow_client_reactor_check(freerdp_peer* peer)
+{
+	return shadow_client_check_events((rdpShadowClient*) peer->context);
+}
+
+static void shadow_client_close(freerdp_peer* peer)
+{
+	rdpShadowClient* client = (rdpShadowClient*) peer->context;
+
+	if (client->updateSubscriber)
 	{
-		shadow_multiclient_release_subscriber(UpdateSubscriber);
-		UpdateSubscriber = NULL;
+		shadow_multiclient_release_subscriber(client->updateSubscriber);
+		client->updateSubscriber = NULL;
 	}
 
-out:
 	peer->Disconnect(peer);
-	
+
 	freerdp_peer_context_free(peer);
 	freerdp_peer_free(peer);
+}
+
+void* shadow_client_thread(rdpShadowClient* client)
+{
+	DWORD nCount;
+	HANDLE events[32];
+	freerdp_peer* peer = ((rdpContext*) client)->peer;
+
+	if (shadow_client_init_peer(client))
+	{
+		nCount = shadow_client_get_event_handles(client, events);
+
+		while (1)
+		{
+			WaitForMultipleObjects(nCount, events, FALSE, INFINITE);
+
+			if (!shadow_client_check_events(client))
+				break;
+		}
+	}
+
+	shadow_client_close(peer);
 	ExitThread(0);
 	return NULL;
 }
@@ -1100,6 +1077,30 @@ BOOL shadow_client_accepted(freerdp_listener* listener, freerdp_peer* peer)
 
 	client = (rdpShadowClient*) peer->context;
 
+	if (server->reactor)
+	{
+		DWORD nCount;
+		HANDLE events[FREERDP_REACTOR_MAX_PEER_HANDLES];
+
+		if (shadow_client_init_peer(client))
+		{
+			nCount = shadow_client_get_event_handles(client, events);
+
+			if (freerdp_reactor_add_peer(server->reactor, peer, events, nCount,
+					shadow_client_reactor_check, shadow_client_close))
+				return TRUE;
+		}
+
+		if (client->updateSubscriber)
+		{
+			shadow_multiclient_release_subscriber(client->updateSubscriber);
+			client->updateSubscriber = NULL;
+		}
+
+		freerdp_peer_context_free(peer);
+		return FALSE;
+	}
+
 	if (!(client->thread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)
 			shadow_client_thread, client, 0, NULL)))
 	{
@@ -20,6 +20,11 @@
 #include "config.h"
 #endif
 
+#include <winpr/sysinfo.h>
+#include <winpr/interlocked.h>
+
+#include <freerdp/primitives.h>
+
 #include "shadow.h"
 
 #include "shadow_encoder.h"
@@ -68,7 +73,13 @@ int shadow_encoder_init_grid(rdpShadowEncoder* encoder)
 	encoder->gridWidth = ((encoder->width + (encoder->maxTileWidth - 1)) / encoder->maxTileWidth);
 	encoder->gridHeight = ((encoder->height + (encoder->maxTileHeight - 1)) / encoder->maxTileHeight);
 
-	tileSize = encoder->maxTileWidth * encoder->maxTileHeight * 4;
+	/**
+	 * Raw planar data carries a format header and a pad byte on top of the
+	 * four planes: leave room for them so that a tile never spills into its
+	 * neighbour, which may be compressed concurrently.
+	 */
+
+	tileSize = (encoder->maxTileWidth * encoder->maxTileHeight * 4) + 16;
 	tileCount = encoder->gridWidth * encoder->gridHeight;
 
 	encoder->gridBuffer = (BYTE*) malloc(tileSize * tileCount);
@@ -81,6 +92,11 @@ int shadow_encoder_init_grid(rdpShadowEncoder* encoder)
 	if (!encoder->grid)
 		return -1;
 
+	encoder->bitmapData = (BITMAP_DATA*) malloc(tileCount * sizeof(BITMAP_DATA));
+
+	if (!encoder->bitmapData)
+		return -1;
+
 	for (i = 0; i < encoder->gridHeight; i++)
 	{
 		for (j = 0; j < encoder->gridWidth; j++)
@@ -107,12 +123,205 @@ int shadow_encoder_uninit_grid(rdpShadowEncoder* encoder)
 		encoder->grid = NULL;
 	}
 
+	if (encoder->bitmapData)
+	{
+		free(encoder->bitmapData);
+		encoder->bitmapData = NULL;
+	}
+
 	encoder->gridWidth = 0;
 	encoder->gridHeight = 0;
 
 	return 0;
 }
 
+static void shadow_encoder_compress_bitmap(rdpShadowEncoder* encoder, BITMAP_PLANAR_CONTEXT* planar,
+		BITMAP_INTERLEAVED_CONTEXT* interleaved, int index)
+{
+	BYTE* data;
+	BYTE* buffer;
+	UINT32 DstSize;
+	BITMAP_DATA* bitmap = &encoder->bitmapData[index];
+
+	buffer = encoder->grid[index];
+
+	if (encoder->bitsPerPixel < 32)
+	{
+		int bitsPerPixel = encoder->bitsPerPixel;
+		int bytesPerPixel = (bitsPerPixel + 7) / 8;
+
+		DstSize = 64 * 64 * 4;
+
+		interleaved_compress(interleaved, buffer, &DstSize, bitmap->width, bitmap->height,
+				encoder->bitmapSrcData, PIXEL_FORMAT_RGB32, encoder->bitmapSrcStep,
+				bitmap->destLeft, bitmap->destTop, NULL, bitsPerPixel);
+
+		bitmap->bitmapDataStream = buffer;
+		bitmap->bitmapLength = DstSize;
+		bitmap->bitsPerPixel = bitsPerPixel;
+		bitmap->cbScanWidth = bitmap->width * bytesPerPixel;
+		bitmap->cbUncompressedSize = bitmap->width * bitmap->height * bytesPerPixel;
+	}
+	else
+	{
+		int dstSize;
+
+		data = &encoder->bitmapSrcData[(bitmap->destTop * encoder->bitmapSrcStep) + (bitmap->destLeft * 4)];
+
+		buffer = freerdp_bitmap_compress_planar(planar, data, PIXEL_FORMAT_RGB32,
+				bitmap->width, bitmap->height, encoder->bitmapSrcStep, buffer, &dstSize);
+
+		bitmap->bitmapDataStream = buffer;
+		bitmap->bitmapLength = dstSize;
+		bitmap->bitsPerPixel = 32;
+		bitmap->cbScanWidth = bitmap->width * 4;
+		bitmap->cbUncompressedSize = bitmap->width * bitmap->height * 4;
+	}
+
+	bitmap->cbCompFirstRowSize = 0;
+	bitmap->cbCompMainBodySize = bitmap->bitmapLength;
+}
+
+static void shadow_encoder_compress_bitmap_tiles(rdpShadowEncoder* encoder, BITMAP_PLANAR_CONTEXT* planar,
+		BITMAP_INTERLEAVED_CONTEXT* interleaved)
+{
+	LONG index;
+
+	while ((index = InterlockedIncrement(&encoder->bitmapIndex) - 1) < encoder->bitmapCount)
+		shadow_encoder_compress_bitmap(encoder, planar, interleaved, (int) index);
+}
+
+static void CALLBACK shadow_encoder_bitmap_work_callback(PTP_CALLBACK_INSTANCE instance, void* context, PTP_WORK work)
+{
+	rdpShadowEncoderWorker* worker = (rdpShadowEncoderWorker*) context;
+
+	shadow_encoder_compress_bitmap_tiles(worker->encoder, worker->planar, worker->interleaved);
+}
+
+/**
+ * Compresses the tiles described by the first count entries of bitmapData,
+ * using grid[index] as the output buffer of tile index. The calling thread
+ * takes part in the work, each worker using its own codec contexts.
+ */
+
+int shadow_encoder_compress_bitmaps(rdpShadowEncoder* encoder, BYTE* pSrcData, int nSrcStep, int count, int bitsPerPixel)
+{
+	int index;
+	int numWorkers;
+
+	encoder->bitmapSrcData = pSrcData;
+	encoder->bitmapSrcStep = nSrcStep;
+	encoder->bitsPerPixel = bitsPerPixel;
+	encoder->bitmapCount = count;
+	encoder->bitmapIndex = 0;
+
+	numWorkers = (count > 1) ? encoder->numWorkers : 0;
+
+	if (numWorkers > (count - 1))
+		numWorkers = count - 1;
+
+	for (index = 0; index < numWorkers; index++)
+		SubmitThreadpoolWork(encoder->workers[index].work);
+
+	shadow_encoder_compress_bitmap_tiles(encoder, encoder->planar, encoder->interleaved);
+
+	for (index = 0; index < numWorkers; index++)
+		WaitForThreadpoolWorkCallbacks(encoder->workers[index].work, FALSE);
+
+	return 1;
+}
+
+int shadow_encoder_init_workers(rdpShadowEncoder* encoder)
+{
+	int index;
+	int numWorkers;
+	SYSTEM_INFO sysinfo;
+	rdpShadowEncoderWorker* worker;
+
+	if (encoder->workers)
+		return 1;
+
+	GetNativeSystemInfo(&sysinfo);
+
+	/* the calling thread compresses tiles as well */
+	numWorkers = (int) sysinfo.dwNumberOfProcessors - 1;
+
+	if (numWorkers > 15)
+		numWorkers = 15;
+
+	if (numWorkers < 1)
+		return 1;
+
+	/* initialize the primitives before they get used from several threads */
+	primitives_get();
+
+	encoder->threadPool = CreateThreadpool(NULL);
+
+	if (!encoder->threadPool)
+		return -1;
+
+	InitializeThreadpoolEnvironment(&encoder->threadPoolEnv);
+	SetThreadpoolCallbackPool(&encoder->threadPoolEnv, encoder->threadPool);
+	SetThreadpoolThreadMaximum(encoder->threadPool, numWorkers);
+
+	encoder->workers = (rdpShadowEncoderWorker*) calloc(numWorkers, sizeof(rdpShadowEncoderWorker));
+
+	if (!encoder->workers)
+		return -1;
+
+	for (index = 0; index < numWorkers; index++)
+	{
+		worker = &encoder->workers[index];
+		worker->encoder = encoder;
+
+		worker->work = CreateThreadpoolWork((PTP_WORK_CALLBACK) shadow_encoder_bitmap_work_callback,
+				(void*) worker, &encoder->threadPoolEnv);
+
+		if (!worker->work)
+			return -1;
+
+		encoder->numWorkers++;
+	}
+
+	return 1;
+}
+
+int shadow_encoder_uninit_workers(rdpShadowEncoder* encoder)
+{
+	int index;
+	rdpShadowEncoderWorker* worker;
+
+	if (encoder->workers)
+	{
+		for (index = 0; index < encoder->numWorkers; index++)
+		{
+			worker = &encoder->workers[index];
+
+			CloseThreadpoolWork(worker->work);
+
+			if (worker->planar)
+				freerdp_bitmap_planar_context_free(worker->planar);
+
+			if (worker->interleaved)
+				bitmap_interleaved_context_free(worker->interleaved);
+		}
+
+		free(encoder->workers);
+		encoder->workers = NULL;
+	}
+
+	encoder->numWorkers = 0;
+
+	if (encoder->threadPool)
+	{
+		CloseThreadpool(encoder->threadPool);
+		DestroyThreadpoolEnvironment(&encoder->threadPoolEnv);
+		encoder->threadPool = NULL;
+	}
+
+	return 1;
+}
+
 int shadow_encoder_init_rfx(rdpShadowEncoder* encoder)
 {
 	rdpContext* context = (rdpContext*) encoder->client;
@@ -181,7 +390,9 @@ int shadow_encoder_init_nsc(rdpShadowEncoder* encoder)
 
 int shadow_encoder_init_planar(rdpShadowEncoder* encoder)
 {
+	int index;
 	DWORD planarFlags = 0;
+	rdpShadowEncoderWorker* worker;
 	rdpContext* context = (rdpContext*) encoder->client;
 	rdpSettings* settings = context->settings;
 
@@ -190,6 +401,19 @@ int shadow_encoder_init_planar(rdpShadowEncoder* encoder)
 
 	planarFlags |= PLANAR_FORMAT_HEADER_RLE;
 
+	/**
+	 * The drawing flags reflect the bitmap capabilities of the client. With
+	 * dynamic color fidelity only photographic tiles are sent with color loss,
+	 * at the same level 3 NSCodec uses by default.
+	 */
+	if (settings->DrawAllowDynamicColorFidelity)
+	{
+		planarFlags |= 3;
+
+		if (settings->DrawAllowColorSubsampling)
+			planarFlags |= PLANAR_FORMAT_HEADER_CS;
+	}
+
 	if (!encoder->planar)
 	{
 		encoder->planar = freerdp_bitmap_planar_context_new(planarFlags,
@@ -199,6 +423,23 @@ int shadow_encoder_init_planar(rdpShadowEncoder* encoder)
 	if (!encoder->planar)
 		return -1;
 
+	if (shadow_encoder_init_workers(encoder) < 0)
+		return -1;
+
+	for (index = 0; index < encoder->numWorkers; index++)
+	{
+		worker = &encoder->workers[index];
+
+		if (!worker->planar)
+		{
+			worker->planar = freerdp_bitmap_planar_context_new(planarFlags,
+					encoder->maxTileWidth, encoder->maxTileHeight);
+		}
+
+		if (!worker->planar)
+			return -1;
+	}
+
 	encoder->codecs |= FREERDP_CODEC_PLANAR;
 
 	return 1;
@@ -206,12 +447,29 @@ int shadow_encoder_init_planar(rdpShadowEncoder* encoder)
 
 int shadow_encoder_init_interleaved(rdpShadowEncoder* encoder)
 {
+	int index;
+	rdpShadowEncoderWorker* worker;
+
 	if (!encoder->interleaved)
 		encoder->interleaved = bitmap_interleaved_context_new(TRUE);
 
 	if (!encoder->interleaved)
 		return -1;
 
+	if (shadow_encoder_init_workers(encoder) < 0)
+		return -1;
+
+	for (index = 0; index < encoder->numWorkers; index++)
+	{
+		worker = &encoder->workers[index];
+
+		if (!worker->interleaved)
+			worker->interleaved = bitmap_interleaved_context_new(TRUE);
+
+		if (!worker->interleaved)
+			return -1;
+	}
+
 	encoder->codecs |= FREERDP_CODEC_INTERLEAVED;
 
 	return 1;
@@ -273,12 +531,23 @@ int shadow_encoder_uninit_nsc(rdpShadowEncoder* encoder)
 
 int shadow_encoder_uninit_planar(rdpShadowEncoder* encoder)
 {
+	int index;
+
 	if (encoder->planar)
 	{
 		freerdp_bitmap_planar_context_free(encoder->planar);
 		encoder->planar = NULL;
 	}
 
+	for (index = 0; index < encoder->numWorkers; index++)
+	{
+		if (encoder->workers[index].planar)
+		{
+			freerdp_bitmap_planar_context_free(encoder->workers[index].planar);
+			encoder->workers[index].planar = NULL;
+		}
+	}
+
 	encoder->codecs &= ~FREERDP_CODEC_PLANAR;
 
 	return 1;
@@ -286,12 +555,23 @@ int shadow_encoder_uninit_planar(rdpShadowEncoder* encoder)
 
 int shadow_encoder_uninit_interleaved(rdpShadowEncoder* encoder)
 {
+	int index;
+
 	if (encoder->interleaved)
 	{
 		bitmap_interleaved_context_free(encoder->interleaved);
 		encoder->interleaved = NULL;
 	}
 
+	for (index = 0; index < encoder->numWorkers; index++)
+	{
+		if (encoder->workers[index].interleaved)
+		{
+			bitmap_interleaved_context_free(encoder->workers[index].interleaved);
+			encoder->workers[index].interleaved = NULL;
+		}
+	}
+
 	encoder->codecs &= ~FREERDP_CODEC_INTERLEAVED;
 
 	return 1;
@@ -327,6 +607,8 @@ int shadow_encoder_uninit(rdpShadowEncoder* encoder)
 		shadow_encoder_uninit_interleaved(encoder);
 	}
 
+	shadow_encoder_uninit_workers(encoder);
+
 	return 1;
 }
 
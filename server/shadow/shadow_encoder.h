@@ -20,6 +20,7 @@
 #define FREERDP_SHADOW_SERVER_ENCODER_H
 
 #include <winpr/crt.h>
+#include <winpr/pool.h>
 #include <winpr/stream.h>
 
 #include <freerdp/freerdp.h>
@@ -27,6 +28,17 @@
 
 #include <freerdp/server/shadow.h>
 
+typedef struct rdp_shadow_encoder_worker rdpShadowEncoderWorker;
+
+struct rdp_shadow_encoder_worker
+{
+	PTP_WORK work;
+	rdpShadowEncoder* encoder;
+
+	BITMAP_PLANAR_CONTEXT* planar;
+	BITMAP_INTERLEAVED_CONTEXT* interleaved;
+};
+
 struct rdp_shadow_encoder
 {
 	rdpShadowClient* client;
@@ -50,6 +62,18 @@ struct rdp_shadow_encoder
 	BITMAP_PLANAR_CONTEXT* planar;
 	BITMAP_INTERLEAVED_CONTEXT* interleaved;
 
+	BITMAP_DATA* bitmapData;
+	int bitmapCount;
+	LONG bitmapIndex;
+	BYTE* bitmapSrcData;
+	int bitmapSrcStep;
+	int bitsPerPixel;
+
+	PTP_POOL threadPool;
+	TP_CALLBACK_ENVIRON threadPoolEnv;
+	int numWorkers;
+	rdpShadowEncoderWorker* workers;
+
 	int fps;
 	int maxFps;
 	BOOL frameAck;
@@ -64,6 +88,7 @@ extern "C" {
 int shadow_encoder_reset(rdpShadowEncoder* encoder);
 int shadow_encoder_prepare(rdpShadowEncoder* encoder, UINT32 codecs);
 int shadow_encoder_create_frame_id(rdpShadowEncoder* encoder);
+int shadow_encoder_compress_bitmaps(rdpShadowEncoder* encoder, BYTE* pSrcData, int nSrcStep, int count, int bitsPerPixel);
 
 rdpShadowEncoder* shadow_encoder_new(rdpShadowClient* client);
 void shadow_encoder_free(rdpShadowEncoder* encoder);
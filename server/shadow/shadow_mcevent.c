@@ -20,7 +20,6 @@
 #include "config.h"
 #endif
 
-#include <assert.h>
 #include <freerdp/log.h>
 #include "shadow.h"
 
@@ -29,48 +28,91 @@
 struct rdp_shadow_multiclient_subscriber
 {
 	rdpShadowMultiClientEvent* ref;
-	BOOL pleaseHandle; /* Indicate if server expects my handling in this turn */
+	HANDLE event; /* Signaled while damage is pending */
+	REGION16 invalidRegion; /* Damage accumulated since the last consume */
 };
 
+static void shadow_frame_free(rdpShadowFrame* frame)
+{
+	if (!frame)
+		return;
+
+	shadow_surface_free(frame->surface);
+	free(frame);
+}
+
+/**
+ * Returns a frame matching the surface geometry, reusing the spare one if possible.
+ * The whole surface is copied since the frame content is unknown.
+ */
+
+static rdpShadowFrame* shadow_frame_new(rdpShadowMultiClientEvent* event, rdpShadowSurface* surface)
+{
+	rdpShadowFrame* frame = event->spare;
+
+	event->spare = NULL;
+
+	if (frame && ((frame->surface->width != surface->width) || (frame->surface->height != surface->height)))
+	{
+		shadow_frame_free(frame);
+		frame = NULL;
+	}
+
+	if (!frame)
+	{
+		frame = (rdpShadowFrame*) calloc(1, sizeof(rdpShadowFrame));
+
+		if (!frame)
+			return NULL;
+
+		frame->surface = shadow_surface_new(surface->server, surface->x, surface->y,
+				surface->width, surface->height);
+
+		if (!frame->surface)
+		{
+			free(frame);
+			return NULL;
+		}
+	}
+
+	frame->refCount = 1;
+
+	freerdp_image_copy(frame->surface->data, PIXEL_FORMAT_XRGB32, frame->surface->scanline,
+			0, 0, surface->width, surface->height,
+			surface->data, PIXEL_FORMAT_XRGB32, surface->scanline, 0, 0, NULL);
+
+	return frame;
+}
+
+static void shadow_frame_release(rdpShadowMultiClientEvent* event, rdpShadowFrame* frame)
+{
+	if (InterlockedDecrement(&(frame->refCount)) > 0)
+		return;
+
+	if (!event->spare)
+		event->spare = frame;
+	else
+		shadow_frame_free(frame);
+}
+
 rdpShadowMultiClientEvent* shadow_multiclient_new()
 {
 	rdpShadowMultiClientEvent* event = (rdpShadowMultiClientEvent*) calloc(1, sizeof(rdpShadowMultiClientEvent));
 	if (!event)
 		goto out_error;
 
-	event->event = CreateEvent(NULL, TRUE, FALSE, NULL);
-	if (!event->event)
-		goto out_free;
-
-	event->barrierEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
-	if (!event->barrierEvent)
-		goto out_free_event;
-
-	event->doneEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
-	if (!event->doneEvent)
-		goto out_free_barrierEvent;
-
 	event->subscribers = ArrayList_New(TRUE);
 	if (!event->subscribers)
-		goto out_free_doneEvent;
+		goto out_free;
 
 	if (!InitializeCriticalSectionAndSpinCount(&(event->lock), 4000))
 		goto out_free_subscribers;
 
-	event->consuming = 0;
-	event->waiting = 0;
 	event->eventid = 0;
-	SetEvent(event->doneEvent);
 	return event;
 
 out_free_subscribers:
 	ArrayList_Free(event->subscribers);
-out_free_doneEvent:
-	CloseHandle(event->doneEvent);
-out_free_barrierEvent:
-	CloseHandle(event->barrierEvent);
-out_free_event:
-	CloseHandle(event->event);
 out_free:
 	free(event);
 out_error:
@@ -85,158 +127,98 @@ void shadow_multiclient_free(rdpShadowMultiClientEvent* event)
 	DeleteCriticalSection(&(event->lock));
 
 	ArrayList_Free(event->subscribers);
-	CloseHandle(event->doneEvent);
-	CloseHandle(event->barrierEvent);
-	CloseHandle(event->event);
+	shadow_frame_free(event->frame);
+	shadow_frame_free(event->spare);
 	free(event);
 
 	return;
 }
 
-static void _Publish(rdpShadowMultiClientEvent* event)
+/**
+ * Publishes the surface content with the given damage region. This never
+ * blocks on clients: if no client holds the latest frame, it is updated in
+ * place, otherwise a new frame is taken and the old one is left to the
+ * clients still encoding it.
+ */
+
+BOOL shadow_multiclient_publish(rdpShadowMultiClientEvent* event, rdpShadowSurface* surface, REGION16* region)
 {
+	int i;
+	int index;
+	int numRects = 0;
+	rdpShadowFrame* frame;
+	const RECTANGLE_16* rects;
 	wArrayList* subscribers;
 	struct rdp_shadow_multiclient_subscriber* subscriber = NULL;
-	int i;
-
-	subscribers = event->subscribers;
 
-	assert(event->consuming == 0);
+	if (!event || !surface || !region)
+		return FALSE;
 
-	/* Count subscribing clients */
-	ArrayList_Lock(subscribers);
-	for (i = 0; i < ArrayList_Count(subscribers); i++)
-	{
-		subscriber = (struct rdp_shadow_multiclient_subscriber *)ArrayList_GetItem(subscribers, i);
-		/* Set flag to subscriber: I acknowledge and please handle */
-		subscriber->pleaseHandle = TRUE;
-		event->consuming++;
-	}
-	ArrayList_Unlock(subscribers);
+	rects = region16_rects(region, &numRects);
 
-	if (event->consuming > 0)
-	{
-		event->eventid = (event->eventid & 0xff) + 1;
-		WLog_VRB(TAG, "Server published event %d. %d clients.\n", event->eventid, event->consuming);
-		ResetEvent(event->doneEvent);
-		SetEvent(event->event);
-	}
+	EnterCriticalSection(&(event->lock));
 
-	return;
-}
+	frame = event->frame;
 
-static void _WaitForSubscribers(rdpShadowMultiClientEvent* event)
-{
-	if (event->consuming > 0)
+	if (frame && (frame->refCount == 1) && (frame->surface->width == surface->width) &&
+			(frame->surface->height == surface->height))
 	{
-		/* Wait for clients done */
-		WLog_VRB(TAG, "Server wait event %d. %d clients.\n", event->eventid, event->consuming);
-		LeaveCriticalSection(&(event->lock));
-		WaitForSingleObject(event->doneEvent, INFINITE);
-		EnterCriticalSection(&(event->lock));
-		WLog_VRB(TAG, "Server quit event %d. %d clients.\n", event->eventid, event->consuming);
-	}
-
-	/* Last subscriber should have already reset the event */
-	assert(WaitForSingleObject(event->event, 0) != WAIT_OBJECT_0);
+		for (index = 0; index < numRects; index++)
+		{
+			RECTANGLE_16 rect = rects[index];
 
-	return;
-}
+			if (rect.right > surface->width)
+				rect.right = surface->width;
 
-void shadow_multiclient_publish(rdpShadowMultiClientEvent* event)
-{
-	if (!event)
-		return;
+			if (rect.bottom > surface->height)
+				rect.bottom = surface->height;
 
-	EnterCriticalSection(&(event->lock));
-	_Publish(event);
-	LeaveCriticalSection(&(event->lock));
+			if ((rect.left >= rect.right) || (rect.top >= rect.bottom))
+				continue;
 
-	return;
-}
-void shadow_multiclient_wait(rdpShadowMultiClientEvent* event)
-{
-	if (!event)
-		return;
+			freerdp_image_copy(frame->surface->data, PIXEL_FORMAT_XRGB32, frame->surface->scanline,
+					rect.left, rect.top, rect.right - rect.left, rect.bottom - rect.top,
+					surface->data, PIXEL_FORMAT_XRGB32, surface->scanline,
+					rect.left, rect.top, NULL);
+		}
+	}
+	else
+	{
+		frame = shadow_frame_new(event, surface);
 
-	EnterCriticalSection(&(event->lock));
-	_WaitForSubscribers(event);
-	LeaveCriticalSection(&(event->lock));
+		if (!frame)
+		{
+			LeaveCriticalSection(&(event->lock));
+			return FALSE;
+		}
 
-	return;
-}
-void shadow_multiclient_publish_and_wait(rdpShadowMultiClientEvent* event)
-{
-	if (!event)
-		return;
+		if (event->frame)
+			shadow_frame_release(event, event->frame);
 
-	EnterCriticalSection(&(event->lock));
-	_Publish(event);
-	_WaitForSubscribers(event);
-	LeaveCriticalSection(&(event->lock));
+		event->frame = frame;
+	}
 
-	return;
-}
+	event->eventid = (event->eventid & 0xff) + 1;
+	frame->frameId = event->eventid;
 
-static BOOL _Consume(struct rdp_shadow_multiclient_subscriber* subscriber, BOOL wait)
-{
-	rdpShadowMultiClientEvent* event = subscriber->ref;
-	BOOL ret = FALSE;
+	subscribers = event->subscribers;
 
-	if (WaitForSingleObject(event->event, 0) == WAIT_OBJECT_0
-			&& subscriber->pleaseHandle)
+	ArrayList_Lock(subscribers);
+	for (i = 0; i < ArrayList_Count(subscribers); i++)
 	{
-		/* Consume my share. Server is waiting for us */
-		event->consuming--;
-		ret = TRUE;
-	}
-
-	assert(event->consuming >= 0);
+		subscriber = (struct rdp_shadow_multiclient_subscriber *)ArrayList_GetItem(subscribers, i);
 
-	if (event->consuming == 0)
-	{
-		/* Last client reset event before notify clients to continue */
-		ResetEvent(event->event);
+		/* Merge with the damage a slow client has not consumed yet */
+		region16_union_rects(&(subscriber->invalidRegion), &(subscriber->invalidRegion), rects, numRects);
 
-		if (event->waiting > 0)
-		{
-			/* Notify other clients to continue */
-			SetEvent(event->barrierEvent);
-		}
-		else
-		{
-			/* Only one client. Notify server directly */
-			SetEvent(event->doneEvent);
-		}
-	}
-	else /* (event->consuming > 0) */
-	{
-		if (wait) 
-		{
-			/* 
-			 * This client need to wait. That means the client will
-			 * continue waiting for other clients to finish.
-			 * The last client should reset barrierEvent.
-			 */
-			event->waiting++;
-			LeaveCriticalSection(&(event->lock));
-			WaitForSingleObject(event->barrierEvent, INFINITE);
-			EnterCriticalSection(&(event->lock));
-			event->waiting--;
-			if (event->waiting == 0)
-			{
-				/*
-				 * This is last client waiting for barrierEvent.
-				 * We can now discard barrierEvent and notify 
-				 * server to continue.
-				 */
-				ResetEvent(event->barrierEvent);
-				SetEvent(event->doneEvent);
-			}
-		}
+		SetEvent(subscriber->event);
 	}
+	WLog_VRB(TAG, "Server published event %d. %d clients.\n", event->eventid, ArrayList_Count(subscribers));
+	ArrayList_Unlock(subscribers);
+
+	LeaveCriticalSection(&(event->lock));
 
-	return ret;
+	return TRUE;
 }
 
 void* shadow_multiclient_get_subscriber(rdpShadowMultiClientEvent* event)
@@ -246,39 +228,40 @@ void* shadow_multiclient_get_subscriber(rdpShadowMultiClientEvent* event)
 	if (!event)
 		return NULL;
 
-	EnterCriticalSection(&(event->lock));
-
 	subscriber = (struct rdp_shadow_multiclient_subscriber*) calloc(1, sizeof(struct rdp_shadow_multiclient_subscriber));
 	if (!subscriber)
 		goto out_error;
 
 	subscriber->ref = event;
-	subscriber->pleaseHandle = FALSE;
+	region16_init(&(subscriber->invalidRegion));
 
-	if (ArrayList_Add(event->subscribers, subscriber) < 0)
+	subscriber->event = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!subscriber->event)
 		goto out_free;
 
-	WLog_VRB(TAG, "Get subscriber %p. Wait event %d. %d clients.\n", (void *)subscriber, event->eventid, event->consuming);
-	(void)_Consume(subscriber, TRUE);
-	WLog_VRB(TAG, "Get subscriber %p. Quit event %d. %d clients.\n", (void *)subscriber, event->eventid, event->consuming);
+	EnterCriticalSection(&(event->lock));
+
+	if (ArrayList_Add(event->subscribers, subscriber) < 0)
+	{
+		LeaveCriticalSection(&(event->lock));
+		goto out_free_event;
+	}
+
+	WLog_VRB(TAG, "Get subscriber %p. Event %d.\n", (void *)subscriber, event->eventid);
 
 	LeaveCriticalSection(&(event->lock));
 
 	return subscriber;
 
+out_free_event:
+	CloseHandle(subscriber->event);
 out_free:
+	region16_uninit(&(subscriber->invalidRegion));
 	free(subscriber);
 out_error:
-	LeaveCriticalSection(&(event->lock));
 	return NULL;
 }
 
-/*
- * Consume my share and release my register
- * If we have update event and pleaseHandle flag
- * We need to consume. Anyway we need to clear
- * pleaseHandle flag
- */
 void shadow_multiclient_release_subscriber(void* subscriber)
 {
 	struct rdp_shadow_multiclient_subscriber* s;
@@ -292,40 +275,72 @@ void shadow_multiclient_release_subscriber(void* subscriber)
 
 	EnterCriticalSection(&(event->lock));
 
-	WLog_VRB(TAG, "Release Subscriber %p. Drop event %d. %d clients.\n", subscriber, event->eventid, event->consuming);
-	(void)_Consume(s, FALSE);
-	WLog_VRB(TAG, "Release Subscriber %p. Quit event %d. %d clients.\n", subscriber, event->eventid, event->consuming);
+	WLog_VRB(TAG, "Release Subscriber %p. Event %d.\n", subscriber, event->eventid);
 
 	ArrayList_Remove(event->subscribers, subscriber);
 
 	LeaveCriticalSection(&(event->lock));
 
+	region16_uninit(&(s->invalidRegion));
+	CloseHandle(s->event);
 	free(subscriber);
 
 	return;
 }
 
-BOOL shadow_multiclient_consume(void* subscriber)
+/**
+ * Moves the damage accumulated by the subscriber into region and returns a
+ * reference on the latest frame (NULL if nothing was published yet), to be
+ * released with shadow_multiclient_release_frame.
+ */
+
+rdpShadowFrame* shadow_multiclient_consume(void* subscriber, REGION16* region)
 {
+	int numRects = 0;
+	const RECTANGLE_16* rects;
 	struct rdp_shadow_multiclient_subscriber* s;
 	rdpShadowMultiClientEvent* event;
-	BOOL ret = FALSE;
+	rdpShadowFrame* frame;
 
 	if (!subscriber)
-		return ret;
+		return NULL;
 
 	s = (struct rdp_shadow_multiclient_subscriber*)subscriber;
 	event = s->ref;
 
 	EnterCriticalSection(&(event->lock));
 
-	WLog_VRB(TAG, "Subscriber %p wait event %d. %d clients.\n", subscriber, event->eventid, event->consuming);
-	ret = _Consume(s, TRUE);
-	WLog_VRB(TAG, "Subscriber %p quit event %d. %d clients.\n", subscriber, event->eventid, event->consuming);
+	rects = region16_rects(&(s->invalidRegion), &numRects);
+
+	region16_union_rects(region, region, rects, numRects);
+
+	region16_clear(&(s->invalidRegion));
+	ResetEvent(s->event);
+
+	frame = event->frame;
+
+	if (frame)
+		InterlockedIncrement(&(frame->refCount));
+
+	WLog_VRB(TAG, "Subscriber %p consumed event %d.\n", subscriber, event->eventid);
 
 	LeaveCriticalSection(&(event->lock));
 
-	return ret;
+	return frame;
+}
+
+void shadow_multiclient_release_frame(void* subscriber, rdpShadowFrame* frame)
+{
+	rdpShadowMultiClientEvent* event;
+
+	if (!subscriber || !frame)
+		return;
+
+	event = ((struct rdp_shadow_multiclient_subscriber*)subscriber)->ref;
+
+	EnterCriticalSection(&(event->lock));
+	shadow_frame_release(event, frame);
+	LeaveCriticalSection(&(event->lock));
 }
 
 HANDLE shadow_multiclient_getevent(void* subscriber)
@@ -333,5 +348,5 @@ HANDLE shadow_multiclient_getevent(void* subscriber)
 	if (!subscriber)
 		return (HANDLE)NULL;
 
-	return ((struct rdp_shadow_multiclient_subscriber*)subscriber)->ref->event;
+	return ((struct rdp_shadow_multiclient_subscriber*)subscriber)->event;
 }
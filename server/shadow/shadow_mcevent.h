@@ -23,22 +23,31 @@
 
 #include <winpr/crt.h>
 #include <winpr/synch.h>
+#include <winpr/interlocked.h>
 #include <winpr/collections.h>
 
 /*
- * This file implemented a model that an event is consumed 
- * by multiple clients. All clients should wait others before continue
- * Server should wait for all clients before continue
+ * This file implements a model where captured frames are published to
+ * multiple clients without waiting for them. Each subscriber accumulates
+ * the damage published since it last consumed, and takes a reference on
+ * the latest frame when it does. A slow client thereby skips intermediate
+ * frames and encodes the merged damage of the latest one, while capture
+ * and the other clients proceed at their own pace.
  */
+struct rdp_shadow_frame
+{
+	LONG refCount;
+	UINT32 frameId;
+	rdpShadowSurface* surface;
+};
+typedef struct rdp_shadow_frame rdpShadowFrame;
+
 struct rdp_shadow_multiclient_event
 {
-	HANDLE event; /* Kickoff event */
-	HANDLE barrierEvent; /* Represents that all clients have consumed event */
-	HANDLE doneEvent; /* Event handling finished. Server could continue */
 	wArrayList* subscribers;
 	CRITICAL_SECTION lock;
-	int consuming;
-	int waiting;
+	rdpShadowFrame* frame; /* Latest published frame */
+	rdpShadowFrame* spare; /* Released frame kept for reuse */
 
 	/* For debug */
 	int eventid;
@@ -50,12 +59,11 @@ extern "C" {
 
 rdpShadowMultiClientEvent* shadow_multiclient_new();
 void shadow_multiclient_free(rdpShadowMultiClientEvent* event);
-void shadow_multiclient_publish(rdpShadowMultiClientEvent* event);
-void shadow_multiclient_wait(rdpShadowMultiClientEvent* event);
-void shadow_multiclient_publish_and_wait(rdpShadowMultiClientEvent* event);
+BOOL shadow_multiclient_publish(rdpShadowMultiClientEvent* event, rdpShadowSurface* surface, REGION16* region);
 void* shadow_multiclient_get_subscriber(rdpShadowMultiClientEvent* event);
 void shadow_multiclient_release_subscriber(void* subscriber);
-BOOL shadow_multiclient_consume(void* subscriber);
+rdpShadowFrame* shadow_multiclient_consume(void* subscriber, REGION16* region);
+void shadow_multiclient_release_frame(void* subscriber, rdpShadowFrame* frame);
 HANDLE shadow_multiclient_getevent(void* subscriber);
 
 #ifdef __cplusplus
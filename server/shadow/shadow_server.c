@@ -50,6 +50,7 @@ static COMMAND_LINE_ARGUMENT_A shadow_args[] =
 	{ "auth", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL, "Clients must authenticate" },
 	{ "may-view", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueTrue, NULL, -1, NULL, "Clients may view without prompt" },
 	{ "may-interact", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueTrue, NULL, -1, NULL, "Clients may interact without prompt" },
+	{ "reactor", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL, "Serve clients from a shared event loop instead of a thread each" },
 	{ "version", COMMAND_LINE_VALUE_FLAG | COMMAND_LINE_PRINT_VERSION, NULL, NULL, NULL, -1, NULL, "Print version" },
 	{ "help", COMMAND_LINE_VALUE_FLAG | COMMAND_LINE_PRINT_HELP, NULL, NULL, NULL, -1, "?", "Print help" },
 	{ NULL, 0, NULL, NULL, NULL, -1, NULL, NULL }
@@ -237,6 +238,10 @@ int shadow_server_parse_command_line(rdpShadowServer* server, int argc, char** a
 		{
 			server->authentication = arg->Value ? TRUE : FALSE;
 		}
+		CommandLineSwitchCase(arg, "reactor")
+		{
+			server->reactorMode = arg->Value ? TRUE : FALSE;
+		}
 		CommandLineSwitchDefault(arg)
 		{
 
@@ -381,6 +386,14 @@ int shadow_server_start(rdpShadowServer* server)
 	if (!server->capture)
 		return -1;
 
+	if (server->reactorMode)
+	{
+		server->reactor = freerdp_reactor_new(0);
+
+		if (!server->reactor)
+			WLog_WARN(TAG, "Failed to create reactor, using a thread per client");
+	}
+
 	if (!server->ipcSocket)
 		status = server->listener->Open(server->listener, NULL, (UINT16) server->port);
 	else
@@ -410,6 +423,12 @@ int shadow_server_stop(rdpShadowServer* server)
 		server->listener->Close(server->listener);
 	}
 
+	if (server->reactor)
+	{
+		freerdp_reactor_free(server->reactor);
+		server->reactor = NULL;
+	}
+
 	if (server->screen)
 	{
 		shadow_screen_free(server->screen);
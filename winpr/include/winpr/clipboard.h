@@ -50,6 +50,9 @@ WINPR_API const char* ClipboardGetFormatName(wClipboard* clipboard, UINT32 forma
 WINPR_API void* ClipboardGetData(wClipboard* clipboard, UINT32 formatId, UINT32* pSize);
 WINPR_API BOOL ClipboardSetData(wClipboard* clipboard, UINT32 formatId, const void* data, UINT32 size);
 
+WINPR_API const void* ClipboardGetSharedData(wClipboard* clipboard, UINT32 formatId, UINT32* pSize);
+WINPR_API void ClipboardReleaseSharedData(wClipboard* clipboard, const void* data);
+
 WINPR_API UINT64 ClipboardGetOwner(wClipboard* clipboard);
 WINPR_API void ClipboardSetOwner(wClipboard* clipboard, UINT64 ownerId);
 
@@ -381,12 +381,8 @@ WINPR_API void HashTable_Free(wHashTable* table);
 
 /* BufferPool */
 
-struct _wBufferPoolItem
-{
-	int size;
-	void* buffer;
-};
-typedef struct _wBufferPoolItem wBufferPoolItem;
+typedef struct _wBufferPoolBin wBufferPoolBin;
+typedef struct _wBufferPoolCache wBufferPoolCache;
 
 struct _wBufferPool
 {
@@ -399,13 +395,13 @@ struct _wBufferPool
 	int capacity;
 	void** array;
 
-	int aSize;
-	int aCapacity;
-	wBufferPoolItem* aArray;
+	int headerSize;
+	LONG uSize;
+	wBufferPoolBin* bins;
 
-	int uSize;
-	int uCapacity;
-	wBufferPoolItem* uArray;
+	DWORD cacheTls;
+	wBufferPoolCache* cache;
+	wBufferPoolCache* caches;
 };
 typedef struct _wBufferPool wBufferPool;
 
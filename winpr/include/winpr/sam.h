@@ -54,6 +54,7 @@ WINPR_API void SamResetEntry(WINPR_SAM_ENTRY* entry);
 WINPR_API void SamFreeEntry(WINPR_SAM* sam, WINPR_SAM_ENTRY* entry);
 
 WINPR_API WINPR_SAM* SamOpen(BOOL read_only);
+WINPR_API WINPR_SAM* SamOpenFile(const char* filename, BOOL read_only);
 WINPR_API void SamClose(WINPR_SAM* sam);
 
 #ifdef __cplusplus
@@ -254,11 +254,21 @@ static INLINE BOOL Stream_SafeSeek(wStream* s, size_t size) {
 
 /* StreamPool */
 
+#define STREAM_POOL_SIZE_CLASSES	32
+
+struct _wStreamPoolClass
+{
+	int size;
+	int capacity;
+	wStream** array;
+};
+typedef struct _wStreamPoolClass wStreamPoolClass;
+
 struct _wStreamPool
 {
 	int aSize;
-	int aCapacity;
-	wStream** aArray;
+	UINT32 aMask;
+	wStreamPoolClass aClasses[STREAM_POOL_SIZE_CLASSES];
 
 	int uSize;
 	int uCapacity;
@@ -356,6 +356,20 @@ WINPR_API int SetEventFileDescriptor(HANDLE hEvent, int FileDescriptor);
 
 WINPR_API void* GetEventWaitObject(HANDLE hEvent);
 
+/**
+ * Wait sets keep the handles of a wait loop registered between calls
+ * (with epoll where available), instead of passing them to the kernel
+ * again on every WaitForMultipleObjects call.
+ */
+
+typedef struct winpr_wait_set WINPR_WAIT_SET;
+
+WINPR_API WINPR_WAIT_SET* CreateWaitSet(void);
+WINPR_API void CloseWaitSet(WINPR_WAIT_SET* set);
+WINPR_API BOOL SetWaitSetHandles(WINPR_WAIT_SET* set, DWORD nCount, const HANDLE* lpHandles);
+WINPR_API DWORD WaitForWaitSet(WINPR_WAIT_SET* set, DWORD dwMilliseconds);
+WINPR_API BOOL GetWaitSetStatistics(WINPR_WAIT_SET* set, UINT64* pWaits, UINT64* pSyscalls);
+
 #ifdef __cplusplus
 }
 #endif
@@ -145,22 +145,125 @@ void ClipboardUnlock(wClipboard* clipboard)
 	LeaveCriticalSection(&(clipboard->lock));
 }
 
-BOOL ClipboardEmpty(wClipboard* clipboard)
+static void ClipboardBufferFree(void* obj)
 {
-	if (!clipboard)
-		return FALSE;
-	
-	if (clipboard->data)
+	wClipboardBuffer* buffer = (wClipboardBuffer*) obj;
+
+	if (!buffer)
+		return;
+
+	free(buffer->data);
+	free(buffer);
+}
+
+static wClipboardBuffer* ClipboardFindBuffer(wClipboard* clipboard, UINT32 formatId)
+{
+	int index;
+	int count;
+	wClipboardBuffer* buffer;
+
+	count = ArrayList_Count(clipboard->buffers);
+
+	for (index = 0; index < count; index++)
 	{
-		free((void*) clipboard->data);
-		clipboard->data = NULL;
+		buffer = (wClipboardBuffer*) ArrayList_GetItem(clipboard->buffers, index);
+
+		if (buffer->cached && (buffer->formatId == formatId))
+			return buffer;
 	}
 
+	return NULL;
+}
+
+static wClipboardBuffer* ClipboardFindBufferByData(wClipboard* clipboard, const void* data)
+{
+	int index;
+	int count;
+	wClipboardBuffer* buffer;
+
+	count = ArrayList_Count(clipboard->buffers);
+
+	for (index = 0; index < count; index++)
+	{
+		buffer = (wClipboardBuffer*) ArrayList_GetItem(clipboard->buffers, index);
+
+		if (buffer->data == data)
+			return buffer;
+	}
+
+	return NULL;
+}
+
+static wClipboardBuffer* ClipboardAddBuffer(wClipboard* clipboard, UINT32 formatId, void* data, UINT32 size)
+{
+	wClipboardBuffer* buffer;
+
+	buffer = (wClipboardBuffer*) calloc(1, sizeof(wClipboardBuffer));
+
+	if (!buffer)
+		return NULL;
+
+	buffer->formatId = formatId;
+	buffer->data = data;
+	buffer->size = size;
+	buffer->refCount = 1;
+	buffer->cached = TRUE;
+
+	if (ArrayList_Add(clipboard->buffers, buffer) < 0)
+	{
+		free(buffer);
+		return NULL;
+	}
+
+	return buffer;
+}
+
+static void ClipboardReleaseBuffer(wClipboard* clipboard, wClipboardBuffer* buffer)
+{
+	if (--buffer->refCount < 1)
+		ArrayList_Remove(clipboard->buffers, buffer);
+}
+
+/**
+ * Drops the clipboard references on the current data and on all formats
+ * synthesized from it. Buffers still shared with callers are released
+ * when the last of them calls ClipboardReleaseSharedData.
+ */
+
+static void ClipboardFlushBuffers(wClipboard* clipboard)
+{
+	int index;
+	wClipboardBuffer* buffer;
+
+	for (index = ArrayList_Count(clipboard->buffers) - 1; index >= 0; index--)
+	{
+		buffer = (wClipboardBuffer*) ArrayList_GetItem(clipboard->buffers, index);
+
+		if (!buffer->cached)
+			continue;
+
+		buffer->cached = FALSE;
+		ClipboardReleaseBuffer(clipboard, buffer);
+	}
+
+	clipboard->data = NULL;
 	clipboard->size = 0;
+}
+
+BOOL ClipboardEmpty(wClipboard* clipboard)
+{
+	if (!clipboard)
+		return FALSE;
+
+	EnterCriticalSection(&(clipboard->lock));
+
+	ClipboardFlushBuffers(clipboard);
 
 	clipboard->formatId = 0;
 	clipboard->sequenceNumber++;
 
+	LeaveCriticalSection(&(clipboard->lock));
+
 	return TRUE;
 }
 
@@ -411,61 +514,135 @@ const char* ClipboardGetFormatName(wClipboard* clipboard, UINT32 formatId)
 	return format->formatName;
 }
 
-void* ClipboardGetData(wClipboard* clipboard, UINT32 formatId, UINT32* pSize)
+/**
+ * Returns the buffer holding the clipboard data in the given format,
+ * running the synthesizer only the first time a format is requested.
+ */
+
+static wClipboardBuffer* ClipboardGetBuffer(wClipboard* clipboard, UINT32 formatId)
 {
-	UINT32 SrcSize = 0;
 	UINT32 DstSize = 0;
-	void* pSrcData = NULL;
 	void* pDstData = NULL;
+	wClipboardBuffer* buffer;
 	wClipboardFormat* format;
 	wClipboardSynthesizer* synthesizer;
-	
-	if (!clipboard)
+
+	buffer = ClipboardFindBuffer(clipboard, formatId);
+
+	if (buffer)
+		return buffer;
+
+	format = ClipboardFindFormat(clipboard, clipboard->formatId, NULL);
+
+	if (!format || !clipboard->data)
 		return NULL;
 
-	if (!pSize)
+	synthesizer = ClipboardFindSynthesizer(format, formatId);
+
+	if (!synthesizer || !synthesizer->pfnSynthesize)
 		return NULL;
 
-	format = ClipboardFindFormat(clipboard, clipboard->formatId, NULL);
+	DstSize = clipboard->size;
+	pDstData = synthesizer->pfnSynthesize(clipboard, format->formatId, clipboard->data, &DstSize);
 
-	if (!format)
+	if (!pDstData)
 		return NULL;
 
-	SrcSize = clipboard->size;
-	pSrcData = (void*) clipboard->data;
+	buffer = ClipboardAddBuffer(clipboard, formatId, pDstData, DstSize);
 
-	if (formatId == format->formatId)
-	{
-		DstSize = SrcSize;
+	if (!buffer)
+		free(pDstData);
 
-		pDstData = malloc(DstSize);
+	return buffer;
+}
 
-		if (!pDstData)
-			return NULL;
+void* ClipboardGetData(wClipboard* clipboard, UINT32 formatId, UINT32* pSize)
+{
+	void* pDstData = NULL;
+	wClipboardBuffer* buffer;
 
-		CopyMemory(pDstData, pSrcData, SrcSize);
-		*pSize = DstSize;
-	}
-	else
+	if (!clipboard)
+		return NULL;
+
+	if (!pSize)
+		return NULL;
+
+	EnterCriticalSection(&(clipboard->lock));
+
+	buffer = ClipboardGetBuffer(clipboard, formatId);
+
+	if (buffer)
 	{
-		synthesizer = ClipboardFindSynthesizer(format, formatId);
+		pDstData = malloc(buffer->size ? buffer->size : 1);
 
-		if (!synthesizer || !synthesizer->pfnSynthesize)
-			return NULL;
+		if (pDstData)
+		{
+			CopyMemory(pDstData, buffer->data, buffer->size);
+			*pSize = buffer->size;
+		}
+	}
+
+	LeaveCriticalSection(&(clipboard->lock));
+
+	return pDstData;
+}
+
+/**
+ * Same as ClipboardGetData, but returns the clipboard's own copy of the data
+ * instead of a duplicate. The data stays valid across ClipboardSetData calls
+ * until it is handed back with ClipboardReleaseSharedData or the clipboard is
+ * destroyed, and must not be modified.
+ */
+
+const void* ClipboardGetSharedData(wClipboard* clipboard, UINT32 formatId, UINT32* pSize)
+{
+	const void* pDstData = NULL;
+	wClipboardBuffer* buffer;
+
+	if (!clipboard)
+		return NULL;
+
+	if (!pSize)
+		return NULL;
+
+	EnterCriticalSection(&(clipboard->lock));
 
-		DstSize = SrcSize;
-		pDstData = synthesizer->pfnSynthesize(clipboard, format->formatId, pSrcData, &DstSize);
+	buffer = ClipboardGetBuffer(clipboard, formatId);
 
-		*pSize = DstSize;
+	if (buffer)
+	{
+		buffer->refCount++;
+		pDstData = buffer->data;
+		*pSize = buffer->size;
 	}
 
+	LeaveCriticalSection(&(clipboard->lock));
+
 	return pDstData;
 }
 
+void ClipboardReleaseSharedData(wClipboard* clipboard, const void* data)
+{
+	wClipboardBuffer* buffer;
+
+	if (!clipboard || !data)
+		return;
+
+	EnterCriticalSection(&(clipboard->lock));
+
+	buffer = ClipboardFindBufferByData(clipboard, data);
+
+	if (buffer)
+		ClipboardReleaseBuffer(clipboard, buffer);
+
+	LeaveCriticalSection(&(clipboard->lock));
+}
+
 BOOL ClipboardSetData(wClipboard* clipboard, UINT32 formatId, const void* data, UINT32 size)
 {
 	wClipboardFormat* format;
-	
+	wClipboardBuffer* buffer;
+
 	if (!clipboard)
 		return FALSE;
 
@@ -474,14 +651,29 @@ BOOL ClipboardSetData(wClipboard* clipboard, UINT32 formatId, const void* data,
 	if (!format)
 		return FALSE;
 
-	free((void*) clipboard->data);
-	clipboard->data = data;
-	clipboard->size = size;
+	EnterCriticalSection(&(clipboard->lock));
+
+	ClipboardFlushBuffers(clipboard);
+
+	buffer = ClipboardAddBuffer(clipboard, formatId, (void*) data, size);
+
+	if (buffer)
+	{
+		clipboard->data = data;
+		clipboard->size = size;
+	}
+	else
+	{
+		/* the clipboard owns the data it is given, even when it cannot keep it */
+		free((void*) data);
+	}
 
 	clipboard->formatId = formatId;
 	clipboard->sequenceNumber++;
 
-	return TRUE;
+	LeaveCriticalSection(&(clipboard->lock));
+
+	return buffer ? TRUE : FALSE;
 }
 
 UINT64 ClipboardGetOwner(wClipboard* clipboard)
@@ -519,10 +711,23 @@ wClipboard* ClipboardCreate()
 
 		if (!clipboard->formats)
 		{
+			DeleteCriticalSection(&(clipboard->lock));
 			free(clipboard);
 			return NULL;
 		}
 
+		clipboard->buffers = ArrayList_New(FALSE);
+
+		if (!clipboard->buffers)
+		{
+			DeleteCriticalSection(&(clipboard->lock));
+			free(clipboard->formats);
+			free(clipboard);
+			return NULL;
+		}
+
+		ArrayList_Object(clipboard->buffers)->fnObjectFree = ClipboardBufferFree;
+
 		ClipboardInitFormats(clipboard);
 	}
 
@@ -550,7 +755,7 @@ void ClipboardDestroy(wClipboard* clipboard)
 		}
 	}
 
-	free((void*) clipboard->data);
+	ArrayList_Free(clipboard->buffers);
 	clipboard->data = NULL;
 	clipboard->size = 0;
 
@@ -26,6 +26,7 @@
 
 typedef struct _wClipboardFormat wClipboardFormat;
 typedef struct _wClipboardSynthesizer wClipboardSynthesizer;
+typedef struct _wClipboardBuffer wClipboardBuffer;
 
 struct _wClipboardFormat
 {
@@ -42,6 +43,23 @@ struct _wClipboardSynthesizer
 	CLIPBOARD_SYNTHESIZE_FN pfnSynthesize;
 };
 
+/**
+ * Clipboard data buffers are shared between the clipboard, which holds a
+ * reference for as long as the data is current, and the callers of
+ * ClipboardGetSharedData. Synthesized formats are kept until the next
+ * ClipboardSetData or ClipboardEmpty call.
+ */
+
+struct _wClipboardBuffer
+{
+	UINT32 formatId;
+	UINT32 size;
+	void* data;
+
+	LONG refCount;
+	BOOL cached;
+};
+
 struct _wClipboard
 {
 	UINT64 ownerId;
@@ -60,6 +78,8 @@ struct _wClipboard
 	UINT32 formatId;
 	UINT32 sequenceNumber;
 
+	wArrayList* buffers;
+
 	CRITICAL_SECTION lock;
 };
 
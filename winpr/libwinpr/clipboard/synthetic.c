@@ -104,6 +104,7 @@ static void* clipboard_synthesize_cf_locale(wClipboard* clipboard, UINT32 format
 	if (!pDstData)
 		return NULL;
 	*pDstData = 0x0409; /* English - United States */
+	*pSize = sizeof(UINT32);
 
 	return (void*) pDstData;
 }
@@ -331,22 +332,37 @@ static void* clipboard_synthesize_html_format(wClipboard* clipboard, UINT32 form
 	if (formatId == ClipboardGetFormatId(clipboard, "text/html"))
 	{
 		char* body;
-		BYTE bom[2];
 		char num[11];
 		WCHAR* wstr;
+		size_t offset;
+		size_t SrcLength;
+		const BYTE* bom = (const BYTE*) data;
+		const char header[] =
+			"Version:0.9\r\n"
+			"StartHTML:0000000000\r\n"
+			"EndHTML:0000000000\r\n"
+			"StartFragment:0000000000\r\n"
+			"EndFragment:0000000000\r\n";
 
 		if (SrcSize > 2)
 		{
-			CopyMemory(bom, data, 2);
-
 			if ((bom[0] == 0xFE) && (bom[1] == 0xFF))
 			{
-				ByteSwapUnicode((WCHAR*) data, SrcSize / 2);
-			}
+				/* the source data is shared, swap a copy of it */
+				wstr = (WCHAR*) malloc(SrcSize - 2);
 
-			if ((bom[0] == 0xFF) && (bom[1] == 0xFE))
+				if (!wstr)
+					return NULL;
+
+				CopyMemory(wstr, &bom[2], SrcSize - 2);
+				ByteSwapUnicode(wstr, (SrcSize - 2) / 2);
+				ConvertFromUnicode(CP_UTF8, 0, wstr,
+						(SrcSize - 2) / 2, &pSrcData, 0, NULL, NULL);
+				free(wstr);
+			}
+			else if ((bom[0] == 0xFF) && (bom[1] == 0xFE))
 			{
-				wstr = (WCHAR*) &((BYTE*) data)[2];
+				wstr = (WCHAR*) &bom[2];
 
 				ConvertFromUnicode(CP_UTF8, 0, wstr,
 						(SrcSize - 2) / 2, &pSrcData, 0, NULL, NULL);
@@ -361,52 +377,66 @@ static void* clipboard_synthesize_html_format(wClipboard* clipboard, UINT32 form
 			CopyMemory(pSrcData, data, SrcSize);
 		}
 
-		pDstData = (char*) calloc(1, SrcSize + 200);
+		/**
+		 * Build the document in a single pass, tracking the offsets instead of
+		 * rescanning the output with strcat/strlen, which gets slow on large
+		 * documents. The UTF-8 conversion may be longer than the source data.
+		 */
+
+		SrcLength = strlen(pSrcData);
+		pDstData = (char*) malloc(sizeof(header) + SrcLength + 64);
+
 		if (!pDstData)
 		{
 			free(pSrcData);
 			return NULL;
 		}
 
-		strcpy(pDstData,
-			"Version:0.9\r\n"
-			"StartHTML:0000000000\r\n"
-			"EndHTML:0000000000\r\n"
-			"StartFragment:0000000000\r\n"
-			"EndFragment:0000000000\r\n");
-
 		body = strstr(pSrcData, "<body");
 
 		if (!body)
 			body = strstr(pSrcData, "<BODY");
 
+		offset = sizeof(header) - 1;
+		CopyMemory(pDstData, header, offset);
+
 		/* StartHTML */
-		sprintf_s(num, sizeof(num), "%010lu", strlen(pDstData));
+		sprintf_s(num, sizeof(num), "%010lu", (unsigned long) offset);
 		CopyMemory(&pDstData[23], num, 10);
 
 		if (!body)
-			strcat(pDstData, "<HTML><BODY>");
+		{
+			CopyMemory(&pDstData[offset], "<HTML><BODY>", 12);
+			offset += 12;
+		}
 
-		strcat(pDstData, "<!--StartFragment-->");
+		CopyMemory(&pDstData[offset], "<!--StartFragment-->", 20);
+		offset += 20;
 
 		/* StartFragment */
-		sprintf_s(num, sizeof(num), "%010lu", strlen(pDstData));
+		sprintf_s(num, sizeof(num), "%010lu", (unsigned long) offset);
 		CopyMemory(&pDstData[69], num, 10);
-		strcat(pDstData, pSrcData);
+		CopyMemory(&pDstData[offset], pSrcData, SrcLength);
+		offset += SrcLength;
 
 		/* EndFragment */
-		sprintf_s(num, sizeof(num), "%010lu", strlen(pDstData));
+		sprintf_s(num, sizeof(num), "%010lu", (unsigned long) offset);
 		CopyMemory(&pDstData[93], num, 10);
-		strcat(pDstData, "<!--EndFragment-->");
+		CopyMemory(&pDstData[offset], "<!--EndFragment-->", 18);
+		offset += 18;
 
 		if (!body)
-			strcat(pDstData, "</BODY></HTML>");
+		{
+			CopyMemory(&pDstData[offset], "</BODY></HTML>", 14);
+			offset += 14;
+		}
 
 		/* EndHTML */
-		sprintf_s(num, sizeof(num), "%010lu", strlen(pDstData));
+		sprintf_s(num, sizeof(num), "%010lu", (unsigned long) offset);
 		CopyMemory(&pDstData[43], num, 10);
+		pDstData[offset] = '\0';
 
-		*pSize = (UINT32) strlen(pDstData) + 1;
+		*pSize = (UINT32) offset + 1;
 		free(pSrcData);
 	}
 
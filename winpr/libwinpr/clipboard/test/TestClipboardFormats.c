@@ -74,6 +74,95 @@ int TestClipboardFormats(int argc, char* argv[])
 		free(pSrcData);
 	}
 
+	if (1)
+	{
+		UINT32 SrcSize;
+		UINT32 DstSize;
+		char* pSrcData;
+		const WCHAR* pDstData;
+		const WCHAR* pCachedData;
+
+		/* synthesized data is shared and kept until the clipboard data changes */
+
+		DstSize = 0;
+		pDstData = (const WCHAR*) ClipboardGetSharedData(clipboard, CF_UNICODETEXT, &DstSize);
+		pCachedData = (const WCHAR*) ClipboardGetSharedData(clipboard, CF_UNICODETEXT, &DstSize);
+
+		if (!pDstData || (pDstData != pCachedData))
+		{
+			fprintf(stderr, "ClipboardGetSharedData: synthesized data was not cached\n");
+			return -1;
+		}
+
+		ClipboardReleaseSharedData(clipboard, pCachedData);
+
+		pSrcData = _strdup("another test string");
+		SrcSize = (UINT32) (strlen(pSrcData) + 1);
+
+		if (!ClipboardSetData(clipboard, utf8StringFormatId, (void*) pSrcData, SrcSize))
+			return -1;
+
+		pSrcData = NULL;
+		ConvertFromUnicode(CP_UTF8, 0, pDstData, -1, &pSrcData, 0, NULL, NULL);
+
+		if (!pSrcData || (strcmp(pSrcData, "this is a test string") != 0))
+		{
+			fprintf(stderr, "ClipboardGetSharedData: shared data changed after ClipboardSetData\n");
+			return -1;
+		}
+
+		free(pSrcData);
+		ClipboardReleaseSharedData(clipboard, pDstData);
+
+		pCachedData = (const WCHAR*) ClipboardGetSharedData(clipboard, CF_UNICODETEXT, &DstSize);
+
+		pSrcData = NULL;
+		ConvertFromUnicode(CP_UTF8, 0, pCachedData, -1, &pSrcData, 0, NULL, NULL);
+
+		if (!pSrcData || (strcmp(pSrcData, "another test string") != 0))
+		{
+			fprintf(stderr, "ClipboardGetSharedData: stale synthesized data\n");
+			return -1;
+		}
+
+		free(pSrcData);
+		ClipboardReleaseSharedData(clipboard, pCachedData);
+	}
+
+	if (1)
+	{
+		UINT32 SrcSize;
+		UINT32 DstSize;
+		char* pSrcData;
+		char* pDstData;
+		const char* html = "<b>bold</b>";
+
+		pSrcData = _strdup(html);
+		SrcSize = (UINT32) (strlen(pSrcData) + 1);
+
+		formatId = ClipboardRegisterFormat(clipboard, "text/html");
+
+		if (!ClipboardSetData(clipboard, formatId, (void*) pSrcData, SrcSize))
+			return -1;
+
+		formatId = ClipboardRegisterFormat(clipboard, "HTML Format");
+
+		DstSize = 0;
+		pDstData = (char*) ClipboardGetData(clipboard, formatId, &DstSize);
+
+		if (!pDstData || (DstSize != strlen(pDstData) + 1) ||
+				!strstr(pDstData, "<!--StartFragment--><b>bold</b><!--EndFragment-->") ||
+				(atoi(strstr(pDstData, "EndHTML:") + 8) != (int) (DstSize - 1)))
+		{
+			fprintf(stderr, "ClipboardGetData: unexpected HTML Format data\n");
+			return -1;
+		}
+
+		fprintf(stderr, "ClipboardGetData (HTML Format): %s\n", pDstData);
+
+		free(pDstData);
+	}
+
 	pFormatIds = NULL;
 	count = ClipboardGetFormatIds(clipboard, &pFormatIds);
 
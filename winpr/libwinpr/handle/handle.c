@@ -23,6 +23,7 @@
 #endif
 
 #include <winpr/handle.h>
+#include <winpr/interlocked.h>
 
 #ifndef _WIN32
 
@@ -43,6 +44,13 @@
 
 #include "../handle/handle.h"
 
+static LONG g_HandleGeneration = 0;
+
+ULONG winpr_Handle_NextGeneration(void)
+{
+	return (ULONG) InterlockedIncrement(&g_HandleGeneration);
+}
+
 BOOL CloseHandle(HANDLE hObject)
 {
 	ULONG Type;
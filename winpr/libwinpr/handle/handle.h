@@ -41,6 +41,7 @@
 
 #define WINPR_HANDLE_DEF() \
 	ULONG Type; \
+	ULONG Generation; \
 	HANDLE_OPS *ops
 
 typedef BOOL (*pcIsHandled)(HANDLE handle);
@@ -68,8 +69,14 @@ struct winpr_handle
 };
 typedef struct winpr_handle WINPR_HANDLE;
 
+/* Generation numbers tell a new handle from a closed one allocated at the same address */
+ULONG winpr_Handle_NextGeneration(void);
+
 #define WINPR_HANDLE_SET_TYPE(_handle, _type) \
-	_handle->Type = _type
+	do { \
+		_handle->Type = _type; \
+		_handle->Generation = winpr_Handle_NextGeneration(); \
+	} while (0)
 
 static INLINE BOOL winpr_Handle_GetInfo(HANDLE handle, ULONG* pType, PVOID* pObject)
 {
@@ -86,6 +93,17 @@ static INLINE BOOL winpr_Handle_GetInfo(HANDLE handle, ULONG* pType, PVOID* pObj
 	return TRUE;
 }
 
+static INLINE ULONG winpr_Handle_getGeneration(HANDLE handle)
+{
+	WINPR_HANDLE *hdl;
+	ULONG type;
+
+	if (!winpr_Handle_GetInfo(handle, &type, (PVOID*)&hdl))
+		return 0;
+
+	return hdl->Generation;
+}
+
 static INLINE int winpr_Handle_getFd(HANDLE handle)
 {
 	WINPR_HANDLE *hdl;
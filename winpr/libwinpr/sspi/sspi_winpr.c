@@ -37,6 +37,8 @@
 
 #include "sspi_winpr.h"
 
+#include "../utils/sam.h"
+
 /* Authentication Functions: http://msdn.microsoft.com/en-us/library/windows/desktop/aa374731/ */
 
 extern const SecPkgInfoA NTLM_SecPkgInfoA;
@@ -475,6 +477,9 @@ void sspi_GlobalFinish()
 	if (sspi_initialized)
 	{
 		sspi_ContextBufferAllocTableFree();
+
+		/* NTLM looks users up through the SAM index */
+		winpr_Sam_FreeIndex();
 	}
 
 	sspi_initialized = FALSE;
@@ -153,4 +153,9 @@ struct winpr_barrier
 };
 typedef struct winpr_barrier WINPR_BARRIER;
 
+#ifdef HAVE_SYS_EPOLL_H
+/* Waits on a per-thread cached wait set, returns FALSE when the caller should poll() instead */
+BOOL winpr_WaitSet_CachedWait(DWORD nCount, const HANDLE* lpHandles, DWORD dwMilliseconds, DWORD* pStatus);
+#endif
+
 #endif /* WINPR_SYNCH_PRIVATE_H */
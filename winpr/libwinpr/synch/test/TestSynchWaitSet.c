@@ -0,0 +1,445 @@
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/sysinfo.h>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#define TEST_READY_ITERATIONS	20000
+#define TEST_WAKE_ITERATIONS	5000
+
+static BOOL test_expect(const char* what, DWORD status, DWORD expected)
+{
+	if (status == expected)
+		return TRUE;
+
+	printf("%s: got 0x%08X, expected 0x%08X\n", what, status, expected);
+	return FALSE;
+}
+
+static BOOL test_wait_set_functional(void)
+{
+	int index;
+	BOOL status = FALSE;
+	HANDLE events[4] = { NULL };
+	HANDLE handles[4];
+	HANDLE event;
+	WINPR_WAIT_SET* set;
+	UINT64 waits = 0;
+	UINT64 syscalls = 0;
+
+	set = CreateWaitSet();
+
+	if (!set)
+		return FALSE;
+
+	for (index = 0; index < 4; index++)
+	{
+		if (!(events[index] = CreateEvent(NULL, TRUE, FALSE, NULL)))
+			goto out;
+	}
+
+	if (!SetWaitSetHandles(set, 4, events))
+		goto out;
+
+	if (!test_expect("empty set", WaitForWaitSet(set, 0), WAIT_TIMEOUT))
+		goto out;
+
+	/* the lowest signaled index wins, like WaitForMultipleObjects */
+	SetEvent(events[3]);
+	SetEvent(events[2]);
+
+	if (!test_expect("lowest index", WaitForWaitSet(set, 0), WAIT_OBJECT_0 + 2))
+		goto out;
+
+	ResetEvent(events[2]);
+
+	if (!test_expect("remaining index", WaitForWaitSet(set, INFINITE), WAIT_OBJECT_0 + 3))
+		goto out;
+
+	ResetEvent(events[3]);
+
+	/* reorder the handles, only the changed registrations are updated */
+	handles[0] = events[3];
+	handles[1] = events[2];
+	handles[2] = events[1];
+	handles[3] = events[0];
+
+	if (!SetWaitSetHandles(set, 4, handles))
+		goto out;
+
+	SetEvent(events[0]);
+
+	if (!test_expect("reordered", WaitForWaitSet(set, 0), WAIT_OBJECT_0 + 3))
+		goto out;
+
+	ResetEvent(events[0]);
+
+	/* the same handle twice reports the first index */
+	handles[0] = events[1];
+	handles[1] = events[1];
+
+	if (!SetWaitSetHandles(set, 3, handles))
+		goto out;
+
+	SetEvent(events[1]);
+
+	if (!test_expect("duplicate", WaitForWaitSet(set, 0), WAIT_OBJECT_0 + 0))
+		goto out;
+
+	ResetEvent(events[1]);
+
+	/* closing a handle may release its descriptor to the next one created */
+	CloseHandle(events[2]);
+	events[2] = NULL;
+
+	if (!(event = CreateEvent(NULL, TRUE, FALSE, NULL)))
+		goto out;
+
+	events[2] = event;
+	handles[0] = events[0];
+	handles[1] = events[1];
+	handles[2] = events[2];
+
+	if (!SetWaitSetHandles(set, 3, handles))
+		goto out;
+
+	if (!test_expect("after close", WaitForWaitSet(set, 0), WAIT_TIMEOUT))
+		goto out;
+
+	SetEvent(events[2]);
+
+	if (!test_expect("new handle", WaitForWaitSet(set, 0), WAIT_OBJECT_0 + 2))
+		goto out;
+
+	ResetEvent(events[2]);
+
+	/* WaitForMultipleObjects picks up a wait set for repeated handle lists */
+	for (index = 0; index < 4; index++)
+	{
+		if (!test_expect("WaitForMultipleObjects", WaitForMultipleObjects(4, events, FALSE, 0), WAIT_TIMEOUT))
+			goto out;
+	}
+
+	SetEvent(events[1]);
+
+	for (index = 0; index < 4; index++)
+	{
+		if (!test_expect("WaitForMultipleObjects", WaitForMultipleObjects(4, events, FALSE, 0), WAIT_OBJECT_0 + 1))
+			goto out;
+	}
+
+	SetEvent(events[0]);
+
+	if (!test_expect("WaitForMultipleObjects", WaitForMultipleObjects(4, events, FALSE, 0), WAIT_OBJECT_0 + 0))
+		goto out;
+
+	if (!GetWaitSetStatistics(set, &waits, &syscalls) || (waits != 7))
+	{
+		printf("unexpected statistics: %d waits\n", (int) waits);
+		goto out;
+	}
+
+	status = TRUE;
+
+out:
+	for (index = 0; index < 4; index++)
+	{
+		if (events[index])
+			CloseHandle(events[index]);
+	}
+
+	CloseWaitSet(set);
+
+	return status;
+}
+
+#ifndef _WIN32
+
+static BOOL test_wait_set_borrowed(void)
+{
+	int fds[2];
+	int reused[2] = { -1, -1 };
+	BOOL status = FALSE;
+	HANDLE handles[2] = { NULL };
+	WINPR_WAIT_SET* set;
+
+	set = CreateWaitSet();
+
+	if (!set)
+		return FALSE;
+
+	if (pipe(fds) < 0)
+		goto out;
+
+	if (!(handles[0] = CreateEvent(NULL, TRUE, FALSE, NULL)))
+		goto out;
+
+	if (!(handles[1] = CreateFileDescriptorEvent(NULL, TRUE, FALSE, fds[0])))
+		goto out;
+
+	if (!SetWaitSetHandles(set, 2, handles))
+		goto out;
+
+	if (!test_expect("borrowed", WaitForWaitSet(set, 0), WAIT_TIMEOUT))
+		goto out;
+
+	/* the owner closes the descriptor, a new pipe gets the same numbers */
+	close(fds[0]);
+	close(fds[1]);
+
+	if (pipe(reused) < 0)
+		goto out;
+
+	if (reused[0] != fds[0])
+	{
+		status = TRUE;
+		goto out;
+	}
+
+	if (!SetWaitSetHandles(set, 2, handles))
+		goto out;
+
+	if ((write(reused[1], "x", 1) != 1) ||
+			!test_expect("reused descriptor", WaitForWaitSet(set, 0), WAIT_OBJECT_0 + 1))
+		goto out;
+
+	status = TRUE;
+
+out:
+	if (handles[0])
+		CloseHandle(handles[0]);
+
+	if (handles[1])
+		CloseHandle(handles[1]);
+
+	if (reused[0] >= 0)
+	{
+		close(reused[0]);
+		close(reused[1]);
+	}
+
+	CloseWaitSet(set);
+
+	return status;
+}
+
+#define TEST_MODE_POLL			0
+#define TEST_MODE_WAIT_MULTIPLE		1
+#define TEST_MODE_WAIT_SET		2
+
+static const char* test_mode_names[] = { "poll", "WaitForMultipleObjects", "WaitSet" };
+
+typedef struct
+{
+	HANDLE request;
+	HANDLE response;
+	BOOL stop;
+} TEST_PING;
+
+static void* test_ping_thread(void* arg)
+{
+	TEST_PING* ping = (TEST_PING*) arg;
+
+	while (WaitForSingleObject(ping->request, INFINITE) == WAIT_OBJECT_0)
+	{
+		ResetEvent(ping->request);
+
+		if (ping->stop)
+			break;
+
+		SetEvent(ping->response);
+	}
+
+	ExitThread(0);
+	return NULL;
+}
+
+/* what WaitForMultipleObjects did before wait sets: gather the descriptors and poll() them */
+static DWORD test_poll_wait(DWORD nCount, HANDLE* handles, struct pollfd* pollfds)
+{
+	DWORD index;
+
+	for (index = 0; index < nCount; index++)
+	{
+		pollfds[index].fd = GetEventFileDescriptor(handles[index]);
+		pollfds[index].events = POLLIN;
+		pollfds[index].revents = 0;
+	}
+
+	if (poll(pollfds, nCount, -1) <= 0)
+		return WAIT_FAILED;
+
+	for (index = 0; index < nCount; index++)
+	{
+		if (pollfds[index].revents & POLLIN)
+			return WAIT_OBJECT_0 + index;
+	}
+
+	return WAIT_FAILED;
+}
+
+static DWORD test_wait(int mode, DWORD nCount, HANDLE* handles, WINPR_WAIT_SET* set, struct pollfd* pollfds)
+{
+	if (mode == TEST_MODE_POLL)
+		return test_poll_wait(nCount, handles, pollfds);
+
+	if (mode == TEST_MODE_WAIT_MULTIPLE)
+		return WaitForMultipleObjects(nCount, handles, FALSE, INFINITE);
+
+	return WaitForWaitSet(set, INFINITE);
+}
+
+/**
+ * Measures the cost of a wait on nCount handles where the last one is
+ * signaled, either already ("ready") or by another thread ("wake").
+ */
+
+static int test_wait_set_bench(DWORD nCount)
+{
+	int mode;
+	int index;
+	int status = -1;
+	DWORD waitStatus;
+	ULONGLONG start;
+	double ready[3];
+	double wake[3];
+	UINT64 waits[2];
+	UINT64 syscalls[2];
+	double syscallsPerWake = 0.0;
+	HANDLE thread = NULL;
+	HANDLE handles[MAXIMUM_WAIT_OBJECTS] = { NULL };
+	struct pollfd pollfds[MAXIMUM_WAIT_OBJECTS];
+	WINPR_WAIT_SET* set;
+	TEST_PING ping;
+
+	ZeroMemory(&ping, sizeof(ping));
+	set = CreateWaitSet();
+	ping.request = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	if (!set || !ping.request)
+		goto out;
+
+	for (index = 0; index < (int) nCount; index++)
+	{
+		if (!(handles[index] = CreateEvent(NULL, TRUE, FALSE, NULL)))
+			goto out;
+	}
+
+	ping.response = handles[nCount - 1];
+
+	/* the signaled handle is last, every other handle is idle */
+	SetEvent(ping.response);
+
+	if (!SetWaitSetHandles(set, nCount, handles))
+		goto out;
+
+	for (mode = TEST_MODE_POLL; mode <= TEST_MODE_WAIT_SET; mode++)
+	{
+		start = GetTickCount64();
+
+		for (index = 0; index < TEST_READY_ITERATIONS; index++)
+		{
+			waitStatus = test_wait(mode, nCount, handles, set, pollfds);
+
+			if (waitStatus != (WAIT_OBJECT_0 + nCount - 1))
+			{
+				printf("%s: unexpected ready status 0x%08X\n", test_mode_names[mode], waitStatus);
+				goto out;
+			}
+		}
+
+		ready[mode] = ((double) (GetTickCount64() - start)) * 1000.0 / TEST_READY_ITERATIONS;
+	}
+
+	ResetEvent(ping.response);
+
+	if (!(thread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE) test_ping_thread, &ping, 0, NULL)))
+		goto out;
+
+	for (mode = TEST_MODE_POLL; mode <= TEST_MODE_WAIT_SET; mode++)
+	{
+		GetWaitSetStatistics(set, &waits[0], &syscalls[0]);
+		start = GetTickCount64();
+
+		for (index = 0; index < TEST_WAKE_ITERATIONS; index++)
+		{
+			SetEvent(ping.request);
+			waitStatus = test_wait(mode, nCount, handles, set, pollfds);
+			ResetEvent(ping.response);
+
+			if (waitStatus != (WAIT_OBJECT_0 + nCount - 1))
+			{
+				printf("%s: unexpected wake status 0x%08X\n", test_mode_names[mode], waitStatus);
+				goto out;
+			}
+		}
+
+		wake[mode] = ((double) (GetTickCount64() - start)) * 1000.0 / TEST_WAKE_ITERATIONS;
+		GetWaitSetStatistics(set, &waits[1], &syscalls[1]);
+
+		if (mode == TEST_MODE_WAIT_SET)
+			syscallsPerWake = ((double) (syscalls[1] - syscalls[0])) / (waits[1] - waits[0]);
+	}
+
+	printf("%2d handles   ready (us): poll %6.2f  WaitForMultipleObjects %6.2f  WaitSet %6.2f\n",
+		nCount, ready[0], ready[1], ready[2]);
+	printf("%2d handles    wake (us): poll %6.2f  WaitForMultipleObjects %6.2f  WaitSet %6.2f\n",
+		nCount, wake[0], wake[1], wake[2]);
+	printf("%2d handles   wait syscalls per wake: poll 1.00  WaitSet %.2f\n", nCount, syscallsPerWake);
+
+	/* once the handles are registered, a wake is a single epoll_wait() */
+	if (syscallsPerWake > 1.0)
+		goto out;
+
+	status = 0;
+
+out:
+	if (thread)
+	{
+		ping.stop = TRUE;
+		SetEvent(ping.request);
+		WaitForSingleObject(thread, INFINITE);
+		CloseHandle(thread);
+	}
+
+	for (index = 0; index < (int) nCount; index++)
+	{
+		if (handles[index])
+			CloseHandle(handles[index]);
+	}
+
+	if (ping.request)
+		CloseHandle(ping.request);
+
+	CloseWaitSet(set);
+
+	return status;
+}
+
+#endif
+
+int TestSynchWaitSet(int argc, char* argv[])
+{
+	if (!test_wait_set_functional())
+		return -1;
+
+#ifndef _WIN32
+	if (!test_wait_set_borrowed())
+		return -1;
+
+	if (test_wait_set_bench(2) < 0)
+		return -1;
+
+	if (test_wait_set_bench(16) < 0)
+		return -1;
+
+	if (test_wait_set_bench(64) < 0)
+		return -1;
+#endif
+
+	return 0;
+}
@@ -285,6 +285,12 @@ DWORD WaitForMultipleObjects(DWORD nCount, const HANDLE *lpHandles, BOOL bWaitAl
 		return WAIT_FAILED;
 	}
 
+#ifdef HAVE_SYS_EPOLL_H
+	/* event loops wait on the same handles over and over, keep them in an epoll set */
+	if (!bWaitAll && winpr_WaitSet_CachedWait(nCount, lpHandles, dwMilliseconds, &signalled))
+		return signalled;
+#endif
+
 	if (bWaitAll)
 	{
 		signalled_idx = alloca(nCount * sizeof(BOOL));
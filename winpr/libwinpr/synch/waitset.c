@@ -0,0 +1,554 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * Synchronization Functions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+
+#include "synch.h"
+
+#include "../log.h"
+#define TAG WINPR_TAG("sync.waitset")
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#endif
+
+/**
+ * A wait set keeps a list of handles registered with the kernel between
+ * waits. With epoll, waiting costs a single epoll_wait() no matter how
+ * many handles are in the set, and changing the list of handles only
+ * adds or removes the file descriptors that actually changed.
+ *
+ * Without epoll, the wait set simply forwards to WaitForMultipleObjects.
+ */
+
+struct winpr_wait_set
+{
+	DWORD count;
+	HANDLE handles[MAXIMUM_WAIT_OBJECTS];
+
+	UINT64 waits;
+	UINT64 syscalls;
+
+#ifdef HAVE_SYS_EPOLL_H
+	int epfd;
+	DWORD nfds;
+	ULONG generations[MAXIMUM_WAIT_OBJECTS];
+	int fds[MAXIMUM_WAIT_OBJECTS];
+	struct epoll_event events[MAXIMUM_WAIT_OBJECTS];
+#endif
+};
+
+#ifdef HAVE_SYS_EPOLL_H
+
+static int wait_set_find_fd(const int* fds, DWORD count, int fd)
+{
+	DWORD index;
+
+	for (index = 0; index < count; index++)
+	{
+		if (fds[index] == fd)
+			return (int) index;
+	}
+
+	return -1;
+}
+
+static int wait_set_epoll_ctl(WINPR_WAIT_SET* set, int op, int fd, DWORD index)
+{
+	struct epoll_event event;
+
+	ZeroMemory(&event, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.u32 = index;
+
+	set->syscalls++;
+
+	return epoll_ctl(set->epfd, op, fd, &event);
+}
+
+static BOOL wait_set_ctl(WINPR_WAIT_SET* set, int op, int fd, DWORD index)
+{
+	if (wait_set_epoll_ctl(set, op, fd, index) == 0)
+		return TRUE;
+
+	/* the descriptor number may have been reused behind our back */
+	if ((op == EPOLL_CTL_ADD) && (errno == EEXIST))
+		return (wait_set_epoll_ctl(set, EPOLL_CTL_MOD, fd, index) == 0);
+
+	if ((op == EPOLL_CTL_MOD) && (errno == ENOENT))
+		return (wait_set_epoll_ctl(set, EPOLL_CTL_ADD, fd, index) == 0);
+
+	return FALSE;
+}
+
+static BOOL wait_set_fd_is_borrowed(HANDLE handle)
+{
+	ULONG type;
+	WINPR_HANDLE* object;
+
+	if (!winpr_Handle_GetInfo(handle, &type, (PVOID*) &object))
+		return FALSE;
+
+	/* an attached event waits on a descriptor owned and closed by someone else */
+	return (type == HANDLE_TYPE_EVENT) && ((WINPR_EVENT*) object)->bAttached;
+}
+
+static BOOL wait_set_verify(WINPR_WAIT_SET* set)
+{
+	DWORD index;
+
+	/**
+	 * A borrowed descriptor may have been closed without the handle knowing,
+	 * which silently drops it from the epoll set, and its number reused.
+	 * Modifying the registration re-adds it if it was dropped (ENOENT) and
+	 * fails if the descriptor is gone (EBADF), leaving the wait to poll().
+	 */
+
+	for (index = 0; index < set->count; index++)
+	{
+		if (wait_set_find_fd(set->fds, index, set->fds[index]) >= 0)
+			continue;
+
+		if (!wait_set_fd_is_borrowed(set->handles[index]))
+			continue;
+
+		if (!wait_set_ctl(set, EPOLL_CTL_MOD, set->fds[index], index))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void wait_set_reset(WINPR_WAIT_SET* set)
+{
+	if (set->epfd >= 0)
+		close(set->epfd);
+
+	set->epfd = -1;
+	set->count = 0;
+	set->nfds = 0;
+}
+
+static BOOL wait_set_update(WINPR_WAIT_SET* set, DWORD nCount, const HANDLE* lpHandles,
+		const ULONG* generations, const int* fds)
+{
+	int found;
+	DWORD index;
+	DWORD nfds = 0;
+
+	if (set->epfd < 0)
+	{
+		wait_set_reset(set);
+
+		set->syscalls++;
+		set->epfd = epoll_create1(EPOLL_CLOEXEC);
+
+		if (set->epfd < 0)
+			return FALSE;
+	}
+
+	/* drop descriptors that are no longer waited on, closed ones are already gone */
+	for (index = 0; index < set->count; index++)
+	{
+		if (wait_set_find_fd(set->fds, index, set->fds[index]) >= 0)
+			continue;
+
+		if (wait_set_find_fd(fds, nCount, set->fds[index]) >= 0)
+			continue;
+
+		set->syscalls++;
+		epoll_ctl(set->epfd, EPOLL_CTL_DEL, set->fds[index], NULL);
+	}
+
+	/* several handles may share a descriptor, it reports the lowest index */
+	for (index = 0; index < nCount; index++)
+	{
+		if (wait_set_find_fd(fds, index, fds[index]) >= 0)
+			continue;
+
+		nfds++;
+		found = wait_set_find_fd(set->fds, set->count, fds[index]);
+
+		/**
+		 * A descriptor number kept at the same index still needs a fresh
+		 * registration if its handle was closed and replaced, the number
+		 * may now refer to another file.
+		 */
+
+		if ((found == (int) index) && (set->handles[index] == lpHandles[index]) &&
+				(set->generations[index] == generations[index]))
+			continue;
+
+		if (!wait_set_ctl(set, (found < 0) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fds[index], index))
+		{
+			WLog_DBG(TAG, "epoll_ctl() failure [%d] %s", errno, strerror(errno));
+			wait_set_reset(set);
+			return FALSE;
+		}
+	}
+
+	CopyMemory(set->handles, lpHandles, nCount * sizeof(HANDLE));
+	CopyMemory(set->generations, generations, nCount * sizeof(ULONG));
+	CopyMemory(set->fds, fds, nCount * sizeof(int));
+	set->count = nCount;
+	set->nfds = nfds;
+
+	return TRUE;
+}
+
+#endif
+
+WINPR_WAIT_SET* CreateWaitSet(void)
+{
+	WINPR_WAIT_SET* set;
+
+	set = (WINPR_WAIT_SET*) calloc(1, sizeof(WINPR_WAIT_SET));
+
+	if (!set)
+		return NULL;
+
+#ifdef HAVE_SYS_EPOLL_H
+	set->epfd = -1;
+#endif
+
+	return set;
+}
+
+void CloseWaitSet(WINPR_WAIT_SET* set)
+{
+	if (!set)
+		return;
+
+#ifdef HAVE_SYS_EPOLL_H
+	wait_set_reset(set);
+#endif
+
+	free(set);
+}
+
+BOOL SetWaitSetHandles(WINPR_WAIT_SET* set, DWORD nCount, const HANDLE* lpHandles)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	DWORD index;
+	int fds[MAXIMUM_WAIT_OBJECTS];
+	ULONG generations[MAXIMUM_WAIT_OBJECTS];
+#endif
+
+	if (!set || !lpHandles || !nCount || (nCount > MAXIMUM_WAIT_OBJECTS))
+		return FALSE;
+
+#ifdef HAVE_SYS_EPOLL_H
+	for (index = 0; index < nCount; index++)
+	{
+		fds[index] = winpr_Handle_getFd(lpHandles[index]);
+		generations[index] = winpr_Handle_getGeneration(lpHandles[index]);
+
+		if (fds[index] < 0)
+		{
+			wait_set_reset(set);
+			return FALSE;
+		}
+	}
+
+	if (!((set->epfd >= 0) && (set->count == nCount) &&
+			(memcmp(set->handles, lpHandles, nCount * sizeof(HANDLE)) == 0) &&
+			(memcmp(set->generations, generations, nCount * sizeof(ULONG)) == 0) &&
+			(memcmp(set->fds, fds, nCount * sizeof(int)) == 0)))
+	{
+		if (!wait_set_update(set, nCount, lpHandles, generations, fds))
+			return FALSE;
+	}
+
+	if (!wait_set_verify(set))
+	{
+		WLog_DBG(TAG, "epoll_ctl() failure [%d] %s", errno, strerror(errno));
+		wait_set_reset(set);
+		return FALSE;
+	}
+
+	return TRUE;
+#else
+	CopyMemory(set->handles, lpHandles, nCount * sizeof(HANDLE));
+	set->count = nCount;
+
+	return TRUE;
+#endif
+}
+
+DWORD WaitForWaitSet(WINPR_WAIT_SET* set, DWORD dwMilliseconds)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	int index;
+	int status;
+	DWORD signaled;
+	DWORD rc;
+#endif
+
+	if (!set || !set->count)
+		return WAIT_FAILED;
+
+	set->waits++;
+	set->syscalls++;
+
+#ifdef HAVE_SYS_EPOLL_H
+	if (set->epfd < 0)
+		return WAIT_FAILED;
+
+	do
+	{
+		status = epoll_wait(set->epfd, set->events, set->nfds, (int) dwMilliseconds);
+	}
+	while (status < 0 && errno == EINTR);
+
+	if (status < 0)
+	{
+		WLog_ERR(TAG, "epoll_wait() failure [%d] %s", errno, strerror(errno));
+		return WAIT_FAILED;
+	}
+
+	if (status == 0)
+		return WAIT_TIMEOUT;
+
+	/* report the lowest signaled index, as WaitForMultipleObjects does */
+	signaled = set->count;
+
+	for (index = 0; index < status; index++)
+	{
+		if ((set->events[index].events & EPOLLIN) && (set->events[index].data.u32 < signaled))
+			signaled = set->events[index].data.u32;
+	}
+
+	if (signaled >= set->count)
+	{
+		WLog_ERR(TAG, "failed (unknown error)");
+		return WAIT_FAILED;
+	}
+
+	rc = winpr_Handle_cleanup(set->handles[signaled]);
+
+	if (rc != WAIT_OBJECT_0)
+		return rc;
+
+	return (WAIT_OBJECT_0 + signaled);
+#else
+	return WaitForMultipleObjects(set->count, set->handles, FALSE, dwMilliseconds);
+#endif
+}
+
+BOOL GetWaitSetStatistics(WINPR_WAIT_SET* set, UINT64* pWaits, UINT64* pSyscalls)
+{
+	if (!set)
+		return FALSE;
+
+	if (pWaits)
+		*pWaits = set->waits;
+
+	if (pSyscalls)
+		*pSyscalls = set->syscalls;
+
+	return TRUE;
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+
+/**
+ * WaitForMultipleObjects keeps a few wait sets per thread for the handle
+ * lists it is called with repeatedly, as event loops do. A list is only
+ * given a wait set the second time it is seen, so that one-off waits keep
+ * using poll() without paying for epoll_ctl() calls.
+ */
+
+#define WAIT_SET_CACHE_SIZE		4
+#define WAIT_SET_CACHE_CANDIDATES	8
+#define WAIT_SET_CACHE_REJECTED		4
+
+struct winpr_wait_set_cache
+{
+	DWORD clock;
+	DWORD nextCandidate;
+	DWORD nextRejected;
+	DWORD lastUse[WAIT_SET_CACHE_SIZE];
+	WINPR_WAIT_SET* sets[WAIT_SET_CACHE_SIZE];
+	UINT32 candidates[WAIT_SET_CACHE_CANDIDATES];
+	UINT32 rejected[WAIT_SET_CACHE_REJECTED];
+};
+typedef struct winpr_wait_set_cache WINPR_WAIT_SET_CACHE;
+
+static pthread_key_t g_WaitSetCacheKey;
+static pthread_once_t g_WaitSetCacheOnce = PTHREAD_ONCE_INIT;
+static BOOL g_WaitSetCacheKeyValid = FALSE;
+
+static void wait_set_cache_free(void* arg)
+{
+	int index;
+	WINPR_WAIT_SET_CACHE* cache = (WINPR_WAIT_SET_CACHE*) arg;
+
+	for (index = 0; index < WAIT_SET_CACHE_SIZE; index++)
+		CloseWaitSet(cache->sets[index]);
+
+	free(cache);
+}
+
+static void wait_set_cache_init(void)
+{
+	g_WaitSetCacheKeyValid = (pthread_key_create(&g_WaitSetCacheKey, wait_set_cache_free) == 0);
+}
+
+static UINT32 wait_set_cache_hash(DWORD nCount, const HANDLE* lpHandles)
+{
+	DWORD index;
+	UINT32 hash = 2166136261U;
+
+	for (index = 0; index < nCount; index++)
+		hash = (hash ^ (UINT32) (ULONG_PTR) lpHandles[index]) * 16777619U;
+
+	/* zero marks an empty slot */
+	return (hash ^ nCount) | 1;
+}
+
+static BOOL wait_set_cache_contains(const UINT32* hashes, DWORD count, UINT32 hash)
+{
+	DWORD index;
+
+	for (index = 0; index < count; index++)
+	{
+		if (hashes[index] == hash)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static WINPR_WAIT_SET_CACHE* wait_set_cache_get(void)
+{
+	WINPR_WAIT_SET_CACHE* cache;
+
+	pthread_once(&g_WaitSetCacheOnce, wait_set_cache_init);
+
+	if (!g_WaitSetCacheKeyValid)
+		return NULL;
+
+	cache = (WINPR_WAIT_SET_CACHE*) pthread_getspecific(g_WaitSetCacheKey);
+
+	if (cache)
+		return cache;
+
+	cache = (WINPR_WAIT_SET_CACHE*) calloc(1, sizeof(WINPR_WAIT_SET_CACHE));
+
+	if (!cache)
+		return NULL;
+
+	if (pthread_setspecific(g_WaitSetCacheKey, cache) != 0)
+	{
+		free(cache);
+		return NULL;
+	}
+
+	return cache;
+}
+
+BOOL winpr_WaitSet_CachedWait(DWORD nCount, const HANDLE* lpHandles, DWORD dwMilliseconds, DWORD* pStatus)
+{
+	int index;
+	int slot = -1;
+	UINT32 hash;
+	WINPR_WAIT_SET* set;
+	WINPR_WAIT_SET_CACHE* cache;
+
+	if (nCount < 2)
+		return FALSE;
+
+	cache = wait_set_cache_get();
+
+	if (!cache)
+		return FALSE;
+
+	for (index = 0; index < WAIT_SET_CACHE_SIZE; index++)
+	{
+		set = cache->sets[index];
+
+		if (set && (set->count == nCount) &&
+				(memcmp(set->handles, lpHandles, nCount * sizeof(HANDLE)) == 0))
+		{
+			slot = index;
+			break;
+		}
+	}
+
+	hash = wait_set_cache_hash(nCount, lpHandles);
+
+	if (slot < 0)
+	{
+		if (wait_set_cache_contains(cache->rejected, WAIT_SET_CACHE_REJECTED, hash))
+			return FALSE;
+
+		if (!wait_set_cache_contains(cache->candidates, WAIT_SET_CACHE_CANDIDATES, hash))
+		{
+			cache->candidates[cache->nextCandidate] = hash;
+			cache->nextCandidate = (cache->nextCandidate + 1) % WAIT_SET_CACHE_CANDIDATES;
+			return FALSE;
+		}
+
+		/* seen before: take an empty or the least recently used slot */
+		slot = 0;
+
+		for (index = 0; index < WAIT_SET_CACHE_SIZE; index++)
+		{
+			if (!cache->sets[index])
+			{
+				slot = index;
+				break;
+			}
+
+			if ((cache->clock - cache->lastUse[index]) > (cache->clock - cache->lastUse[slot]))
+				slot = index;
+		}
+
+		if (!cache->sets[slot])
+		{
+			if (!(cache->sets[slot] = CreateWaitSet()))
+				return FALSE;
+		}
+	}
+
+	set = cache->sets[slot];
+
+	if (!SetWaitSetHandles(set, nCount, lpHandles))
+	{
+		/* e.g. regular files cannot be added to epoll, leave them to poll() */
+		CloseWaitSet(set);
+		cache->sets[slot] = NULL;
+		cache->rejected[cache->nextRejected] = hash;
+		cache->nextRejected = (cache->nextRejected + 1) % WAIT_SET_CACHE_REJECTED;
+		return FALSE;
+	}
+
+	cache->lastUse[slot] = ++cache->clock;
+	*pStatus = WaitForWaitSet(set, dwMilliseconds);
+
+	return TRUE;
+}
+
+#endif
@@ -523,7 +523,7 @@ HANDLE CreateProcessHandle(pid_t pid)
 		return NULL;
 
 	process->pid = pid;
-	process->Type = HANDLE_TYPE_PROCESS;
+	WINPR_HANDLE_SET_TYPE(process, HANDLE_TYPE_PROCESS);
 	process->ops = &ops;
 
 	return (HANDLE)process;
@@ -22,6 +22,8 @@
 #endif
 
 #include <winpr/crt.h>
+#include <winpr/thread.h>
+#include <winpr/interlocked.h>
 
 #include <winpr/collections.h>
 
@@ -30,60 +32,339 @@
  * http://msdn.microsoft.com/en-us/library/ms405814.aspx
  */
 
+/**
+ * Variable size buffers are binned in power-of-two size classes. Each thread
+ * taking from a synchronized pool gets its own cache holding a small magazine
+ * of free buffers per size class, so that the common take/return cycle only
+ * touches an uncontended lock. Magazines are refilled from and spilled to a
+ * shared depot, which trims buffers exceeding the recent high water mark.
+ *
+ * Every variable size buffer is prefixed with a header recording its size,
+ * size class and the cache it was taken from, making lookups O(1).
+ */
+
+#define BUFFERPOOL_MIN_CLASS_SHIFT	6
+#define BUFFERPOOL_MAX_CLASS_SHIFT	26
+#define BUFFERPOOL_CLASS_COUNT		(BUFFERPOOL_MAX_CLASS_SHIFT - BUFFERPOOL_MIN_CLASS_SHIFT + 1)
+#define BUFFERPOOL_MAGAZINE_SIZE	8
+#define BUFFERPOOL_TRIM_INTERVAL	256
+#define BUFFERPOOL_HEADER_MAGIC		0x4C4F4F50
+
+struct _wBufferPoolHeader
+{
+	DWORD magic;
+	int size;
+	int sizeClass;
+	wBufferPoolCache* cache;
+	struct _wBufferPoolHeader* prev;
+	struct _wBufferPoolHeader* next;
+};
+typedef struct _wBufferPoolHeader wBufferPoolHeader;
+
+struct _wBufferPoolBin
+{
+	int size;
+	int capacity;
+	void** array;
+
+	int out;
+	int highWater;
+	int ops;
+};
+
+struct _wBufferPoolCache
+{
+	wBufferPool* pool;
+	CRITICAL_SECTION lock;
+
+	int count[BUFFERPOOL_CLASS_COUNT];
+	void* magazine[BUFFERPOOL_CLASS_COUNT][BUFFERPOOL_MAGAZINE_SIZE];
+
+	wBufferPoolHeader* used;
+	wBufferPoolCache* next;
+};
+
+#define BufferPool_Header(_pool, _buffer) ((wBufferPoolHeader*) (((BYTE*) (_buffer)) - (_pool)->headerSize))
+#define BufferPool_Buffer(_pool, _header) ((void*) (((BYTE*) (_header)) + (_pool)->headerSize))
+
 /**
  * Methods
  */
 
-static BOOL BufferPool_ShiftAvailable(wBufferPool* pool, int index, int count)
+static int BufferPool_SizeClass(int size)
 {
-	if (count > 0)
+	int sizeClass = 0;
+	int classSize = (1 << BUFFERPOOL_MIN_CLASS_SHIFT);
+
+	while ((classSize < size) && (sizeClass < BUFFERPOOL_CLASS_COUNT))
 	{
-		if (pool->aSize + count > pool->aCapacity)
-		{
-			wBufferPoolItem *newArray;
-			int newCapacity = pool->aCapacity * 2;
+		classSize <<= 1;
+		sizeClass++;
+	}
 
-			newArray = (wBufferPoolItem*) realloc(pool->aArray, sizeof(wBufferPoolItem) * newCapacity);
-			if (!newArray)
-				return FALSE;
-			pool->aArray = newArray;
-			pool->aCapacity = newCapacity;
-		}
+	return sizeClass;
+}
 
-		MoveMemory(&pool->aArray[index + count], &pool->aArray[index], (pool->aSize - index) * sizeof(wBufferPoolItem));
-		pool->aSize += count;
-	}
-	else if (count < 0)
+static void* BufferPool_Alloc(wBufferPool* pool, int size, int sizeClass)
+{
+	BYTE* base;
+	size_t allocSize;
+	wBufferPoolHeader* header;
+
+	allocSize = pool->headerSize;
+
+	if (sizeClass < BUFFERPOOL_CLASS_COUNT)
+		allocSize += (1 << (BUFFERPOOL_MIN_CLASS_SHIFT + sizeClass));
+	else
+		allocSize += size;
+
+	if (pool->alignment)
+		base = (BYTE*) _aligned_malloc(allocSize, pool->alignment);
+	else
+		base = (BYTE*) malloc(allocSize);
+
+	if (!base)
+		return NULL;
+
+	header = (wBufferPoolHeader*) base;
+	ZeroMemory(header, sizeof(wBufferPoolHeader));
+	header->magic = BUFFERPOOL_HEADER_MAGIC;
+	header->sizeClass = sizeClass;
+
+	return BufferPool_Buffer(pool, header);
+}
+
+static void BufferPool_Dealloc(wBufferPool* pool, void* buffer)
+{
+	wBufferPoolHeader* header = BufferPool_Header(pool, buffer);
+
+	header->magic = 0;
+
+	if (pool->alignment)
+		_aligned_free(header);
+	else
+		free(header);
+}
+
+static wBufferPoolHeader* BufferPool_GetHeader(wBufferPool* pool, void* buffer)
+{
+	wBufferPoolHeader* header;
+
+	if (!buffer)
+		return NULL;
+
+	header = BufferPool_Header(pool, buffer);
+
+	if (header->magic != BUFFERPOOL_HEADER_MAGIC)
+		return NULL;
+
+	/* buffers sitting in a magazine or in the depot are not in use */
+	if (!header->cache || (header->cache->pool != pool))
+		return NULL;
+
+	return header;
+}
+
+static void BufferPool_CacheLock(wBufferPoolCache* cache)
+{
+	if (cache->pool->synchronized)
+		EnterCriticalSection(&cache->lock);
+}
+
+static void BufferPool_CacheUnlock(wBufferPoolCache* cache)
+{
+	if (cache->pool->synchronized)
+		LeaveCriticalSection(&cache->lock);
+}
+
+static wBufferPoolCache* BufferPool_CacheNew(wBufferPool* pool)
+{
+	wBufferPoolCache* cache;
+
+	cache = (wBufferPoolCache*) calloc(1, sizeof(wBufferPoolCache));
+
+	if (!cache)
+		return NULL;
+
+	cache->pool = pool;
+
+	if (pool->synchronized)
+		InitializeCriticalSectionAndSpinCount(&cache->lock, 4000);
+
+	return cache;
+}
+
+static void BufferPool_CacheFree(wBufferPoolCache* cache)
+{
+	if (cache->pool->synchronized)
+		DeleteCriticalSection(&cache->lock);
+
+	free(cache);
+}
+
+/**
+ * Get the cache of the calling thread, creating it on first use.
+ * The shared cache is used for unsynchronized pools and as a fallback.
+ */
+
+static wBufferPoolCache* BufferPool_GetCache(wBufferPool* pool)
+{
+	wBufferPoolCache* cache;
+
+	if (pool->cacheTls == TLS_OUT_OF_INDEXES)
+		return pool->cache;
+
+	cache = (wBufferPoolCache*) TlsGetValue(pool->cacheTls);
+
+	if (!cache)
 	{
-		MoveMemory(&pool->aArray[index], &pool->aArray[index - count], (pool->aSize - index) * sizeof(wBufferPoolItem));
-		pool->aSize += count;
+		cache = BufferPool_CacheNew(pool);
+
+		if (!cache)
+			return pool->cache;
+
+		EnterCriticalSection(&pool->lock);
+		cache->next = pool->caches;
+		pool->caches = cache;
+		LeaveCriticalSection(&pool->lock);
+
+		TlsSetValue(pool->cacheTls, cache);
 	}
-	return TRUE;
+
+	return cache;
 }
 
-static BOOL BufferPool_ShiftUsed(wBufferPool* pool, int index, int count)
+static void BufferPool_CacheAttach(wBufferPoolCache* cache, wBufferPoolHeader* header)
 {
-	if (count > 0)
+	BufferPool_CacheLock(cache);
+
+	header->cache = cache;
+	header->prev = NULL;
+	header->next = cache->used;
+
+	if (cache->used)
+		cache->used->prev = header;
+
+	cache->used = header;
+
+	BufferPool_CacheUnlock(cache);
+}
+
+static void BufferPool_CacheDetach(wBufferPoolHeader* header)
+{
+	wBufferPoolCache* cache = header->cache;
+
+	BufferPool_CacheLock(cache);
+
+	if (header->prev)
+		header->prev->next = header->next;
+	else
+		cache->used = header->next;
+
+	if (header->next)
+		header->next->prev = header->prev;
+
+	header->cache = NULL;
+	header->prev = header->next = NULL;
+
+	BufferPool_CacheUnlock(cache);
+}
+
+/**
+ * Takes up to count free buffers of a size class from the depot. When the
+ * depot is empty, the caller is accounted for allocating one new buffer.
+ */
+
+static int BufferPool_DepotPop(wBufferPool* pool, int sizeClass, void** buffers, int count)
+{
+	int index = 0;
+	wBufferPoolBin* bin = &pool->bins[sizeClass];
+
+	if (pool->synchronized)
+		EnterCriticalSection(&pool->lock);
+
+	while ((index < count) && (bin->size > 0))
+		buffers[index++] = bin->array[--(bin->size)];
+
+	bin->out += (index > 0) ? index : 1;
+
+	if (bin->out > bin->highWater)
+		bin->highWater = bin->out;
+
+	if (pool->synchronized)
+		LeaveCriticalSection(&pool->lock);
+
+	return index;
+}
+
+static void BufferPool_DepotRelease(wBufferPool* pool, int sizeClass)
+{
+	if (pool->synchronized)
+		EnterCriticalSection(&pool->lock);
+
+	pool->bins[sizeClass].out--;
+
+	if (pool->synchronized)
+		LeaveCriticalSection(&pool->lock);
+}
+
+/**
+ * Gives free buffers of a size class back to the depot, releasing the ones
+ * exceeding the high water mark. The high water mark periodically decays
+ * towards the current demand so that bursts do not pin memory forever.
+ */
+
+static void BufferPool_DepotPush(wBufferPool* pool, int sizeClass, void** buffers, int count)
+{
+	int index;
+	int trimCount = 0;
+	void* trimmed[BUFFERPOOL_MAGAZINE_SIZE];
+	wBufferPoolBin* bin = &pool->bins[sizeClass];
+
+	if (pool->synchronized)
+		EnterCriticalSection(&pool->lock);
+
+	for (index = 0; index < count; index++)
 	{
-		if (pool->uSize + count > pool->uCapacity)
+		bin->out--;
+
+		if (++(bin->ops) >= BUFFERPOOL_TRIM_INTERVAL)
 		{
-			int newUCapacity = pool->uCapacity * 2;
-			wBufferPoolItem *newUArray = (wBufferPoolItem *)realloc(pool->uArray, sizeof(wBufferPoolItem) *newUCapacity);
-			if (!newUArray)
-				return FALSE;
-			pool->uCapacity = newUCapacity;
-			pool->uArray = newUArray;
+			bin->ops = 0;
+			bin->highWater = bin->out + ((bin->highWater - bin->out) / 2);
 		}
 
-		MoveMemory(&pool->uArray[index + count], &pool->uArray[index], (pool->uSize - index) * sizeof(wBufferPoolItem));
-		pool->uSize += count;
-	}
-	else if (count < 0)
-	{
-		MoveMemory(&pool->uArray[index], &pool->uArray[index - count], (pool->uSize - index) * sizeof(wBufferPoolItem));
-		pool->uSize += count;
+		if ((bin->size + bin->out) >= bin->highWater)
+		{
+			trimmed[trimCount++] = buffers[index];
+			continue;
+		}
+
+		if (bin->size >= bin->capacity)
+		{
+			void** newArray;
+			int newCapacity = (bin->capacity > 0) ? bin->capacity * 2 : 8;
+
+			newArray = (void**) realloc(bin->array, sizeof(void*) * newCapacity);
+
+			if (!newArray)
+			{
+				trimmed[trimCount++] = buffers[index];
+				continue;
+			}
+
+			bin->capacity = newCapacity;
+			bin->array = newArray;
+		}
+
+		bin->array[(bin->size)++] = buffers[index];
 	}
-	return TRUE;
+
+	if (pool->synchronized)
+		LeaveCriticalSection(&pool->lock);
+
+	for (index = 0; index < trimCount; index++)
+		BufferPool_Dealloc(pool, trimmed[index]);
 }
 
 /**
@@ -105,7 +386,7 @@ int BufferPool_GetPoolSize(wBufferPool* pool)
 	else
 	{
 		/* variable size buffers */
-		size = pool->uSize;
+		size = (int) pool->uSize;
 	}
 
 	if (pool->synchronized)
@@ -120,176 +401,171 @@ int BufferPool_GetPoolSize(wBufferPool* pool)
 
 int BufferPool_GetBufferSize(wBufferPool* pool, void* buffer)
 {
-	int size = 0;
-	int index = 0;
-	BOOL found = FALSE;
-
-	if (pool->synchronized)
-		EnterCriticalSection(&pool->lock);
+	wBufferPoolHeader* header;
 
 	if (pool->fixedSize)
 	{
 		/* fixed size buffers */
-		size = pool->fixedSize;
-		found = TRUE;
+		return pool->fixedSize;
 	}
-	else
-	{
-		/* variable size buffers */
 
-		for (index = 0; index < pool->uSize; index++)
-		{
-			if (pool->uArray[index].buffer == buffer)
-			{
-				size = pool->uArray[index].size;
-				found = TRUE;
-				break;
-			}
-		}
-	}
+	/* variable size buffers */
 
-	if (pool->synchronized)
-		LeaveCriticalSection(&pool->lock);
+	header = BufferPool_GetHeader(pool, buffer);
 
-	return (found) ? size : -1;
+	return (header) ? header->size : -1;
 }
 
-/**
- * Gets a buffer of at least the specified size from the pool.
- */
-
-void* BufferPool_Take(wBufferPool* pool, int size)
+static void* BufferPool_TakeVariable(wBufferPool* pool, int size)
 {
-	int index;
-	int maxSize;
-	int maxIndex;
-	int foundIndex;
-	BOOL found = FALSE;
+	int count;
+	int sizeClass;
 	void* buffer = NULL;
+	wBufferPoolCache* cache;
+	wBufferPoolHeader* header;
+	void* buffers[BUFFERPOOL_MAGAZINE_SIZE / 2];
 
-	if (pool->synchronized)
-		EnterCriticalSection(&pool->lock);
+	if (size < 1)
+		return NULL;
 
-	if (pool->fixedSize)
+	sizeClass = BufferPool_SizeClass(size);
+	cache = BufferPool_GetCache(pool);
+
+	if (sizeClass < BUFFERPOOL_CLASS_COUNT)
 	{
-		/* fixed size buffers */
+		BufferPool_CacheLock(cache);
+
+		if (cache->count[sizeClass] > 0)
+			buffer = cache->magazine[sizeClass][--(cache->count[sizeClass])];
 
-		if (pool->size > 0)
-			buffer = pool->array[--(pool->size)];
+		BufferPool_CacheUnlock(cache);
 
 		if (!buffer)
 		{
-			if (pool->alignment)
-				buffer = _aligned_malloc(pool->fixedSize, pool->alignment);
-			else
-				buffer = malloc(pool->fixedSize);
-		}
+			/* magazine is empty: refill it with up to half a magazine from the depot */
 
-		if (!buffer)
-			goto out_error;
-	}
-	else
-	{
-		/* variable size buffers */
+			count = BufferPool_DepotPop(pool, sizeClass, buffers, BUFFERPOOL_MAGAZINE_SIZE / 2);
 
-		maxSize = 0;
-		maxIndex = 0;
+			if (count > 0)
+			{
+				buffer = buffers[--count];
 
-		if (size < 1)
-			size = pool->fixedSize;
+				BufferPool_CacheLock(cache);
 
-		for (index = 0; index < pool->aSize; index++)
-		{
-			if (pool->aArray[index].size > maxSize)
-			{
-				maxIndex = index;
-				maxSize = pool->aArray[index].size;
-			}
+				while ((count > 0) && (cache->count[sizeClass] < BUFFERPOOL_MAGAZINE_SIZE))
+					cache->magazine[sizeClass][(cache->count[sizeClass])++] = buffers[--count];
 
-			if (pool->aArray[index].size >= size)
-			{
-				foundIndex = index;
-				found = TRUE;
-				break;
+				BufferPool_CacheUnlock(cache);
+
+				if (count > 0)
+					BufferPool_DepotPush(pool, sizeClass, buffers, count);
 			}
 		}
+	}
 
-		if (!found && maxSize)
-		{
-			foundIndex = maxIndex;
-			found = TRUE;
-		}
+	if (!buffer)
+	{
+		buffer = BufferPool_Alloc(pool, size, sizeClass);
 
-		if (!found)
+		if (!buffer)
 		{
-			if (!size)
-				buffer = NULL;
-			else
-			{
-				if (pool->alignment)
-					buffer = _aligned_malloc(size, pool->alignment);
-				else
-					buffer = malloc(size);
+			if (sizeClass < BUFFERPOOL_CLASS_COUNT)
+				BufferPool_DepotRelease(pool, sizeClass);
 
-				if (!buffer)
-					goto out_error;
-			}
+			return NULL;
 		}
-		else
-		{
-			buffer = pool->aArray[foundIndex].buffer;
+	}
 
-			if (maxSize < size)
-			{
-				void *newBuffer;
-				if (pool->alignment)
-					newBuffer = _aligned_realloc(buffer, size, pool->alignment);
-				else
-					newBuffer = realloc(buffer, size);
+	header = BufferPool_Header(pool, buffer);
+	header->size = size;
 
-				if (!newBuffer)
-					goto out_error_no_free;
+	BufferPool_CacheAttach(cache, header);
+	InterlockedIncrement(&pool->uSize);
 
-				buffer = newBuffer;
-			}
+	return buffer;
+}
 
-			if (!BufferPool_ShiftAvailable(pool, foundIndex, -1))
-				goto out_error;
-		}
+/**
+ * Gets a buffer of at least the specified size from the pool.
+ */
 
-		if (!buffer)
-			goto out_error;
+void* BufferPool_Take(wBufferPool* pool, int size)
+{
+	void* buffer = NULL;
 
-		if (pool->uSize + 1 > pool->uCapacity)
-		{
-			int newUCapacity = pool->uCapacity * 2;
-			wBufferPoolItem *newUArray = (wBufferPoolItem *)realloc(pool->uArray, sizeof(wBufferPoolItem) * newUCapacity);
-			if (!newUArray)
-				goto out_error;
+	if (!pool->fixedSize)
+		return BufferPool_TakeVariable(pool, size);
 
-			pool->uCapacity = newUCapacity;
-			pool->uArray = newUArray;
-		}
+	if (pool->synchronized)
+		EnterCriticalSection(&pool->lock);
+
+	/* fixed size buffers */
 
-		pool->uArray[pool->uSize].buffer = buffer;
-		pool->uArray[pool->uSize].size = size;
-		(pool->uSize)++;
+	if (pool->size > 0)
+		buffer = pool->array[--(pool->size)];
+
+	if (!buffer)
+	{
+		if (pool->alignment)
+			buffer = _aligned_malloc(pool->fixedSize, pool->alignment);
+		else
+			buffer = malloc(pool->fixedSize);
 	}
 
 	if (pool->synchronized)
 		LeaveCriticalSection(&pool->lock);
 
 	return buffer;
+}
 
-out_error:
-	if (pool->alignment)
-		_aligned_free(buffer);
-	else
-		free(buffer);
-out_error_no_free:
-	if (pool->synchronized)
-		LeaveCriticalSection(&pool->lock);
-	return NULL;
+static BOOL BufferPool_ReturnVariable(wBufferPool* pool, void* buffer)
+{
+	int count = 0;
+	int sizeClass;
+	wBufferPoolCache* cache;
+	wBufferPoolHeader* header;
+	void* buffers[BUFFERPOOL_MAGAZINE_SIZE / 2];
+
+	header = BufferPool_GetHeader(pool, buffer);
+
+	if (!header)
+		return FALSE;
+
+	sizeClass = header->sizeClass;
+
+	BufferPool_CacheDetach(header);
+	InterlockedDecrement(&pool->uSize);
+
+	if (sizeClass >= BUFFERPOOL_CLASS_COUNT)
+	{
+		/* oversized buffers are not worth caching */
+		BufferPool_Dealloc(pool, buffer);
+		return TRUE;
+	}
+
+	cache = BufferPool_GetCache(pool);
+
+	BufferPool_CacheLock(cache);
+
+	if (cache->count[sizeClass] >= BUFFERPOOL_MAGAZINE_SIZE)
+	{
+		/* magazine is full: spill its older half to the depot */
+
+		count = BUFFERPOOL_MAGAZINE_SIZE / 2;
+		CopyMemory(buffers, cache->magazine[sizeClass], count * sizeof(void*));
+		MoveMemory(cache->magazine[sizeClass], &cache->magazine[sizeClass][count],
+				(BUFFERPOOL_MAGAZINE_SIZE - count) * sizeof(void*));
+		cache->count[sizeClass] -= count;
+	}
+
+	cache->magazine[sizeClass][(cache->count[sizeClass])++] = buffer;
+
+	BufferPool_CacheUnlock(cache);
+
+	if (count > 0)
+		BufferPool_DepotPush(pool, sizeClass, buffers, count);
+
+	return TRUE;
 }
 
 /**
@@ -298,69 +574,27 @@ out_error_no_free:
 
 BOOL BufferPool_Return(wBufferPool* pool, void* buffer)
 {
-	int size = 0;
-	int index = 0;
-	BOOL found = FALSE;
+	if (!pool->fixedSize)
+		return BufferPool_ReturnVariable(pool, buffer);
 
 	if (pool->synchronized)
 		EnterCriticalSection(&pool->lock);
 
-	if (pool->fixedSize)
-	{
-		/* fixed size buffers */
-
-		if ((pool->size + 1) >= pool->capacity)
-		{
-			int newCapacity = pool->capacity * 2;
-			void **newArray = (void **)realloc(pool->array, sizeof(void*) * newCapacity);
-			if (!newArray)
-				goto out_error;
+	/* fixed size buffers */
 
-			pool->capacity = newCapacity;
-			pool->array = newArray;
-		}
-
-		pool->array[(pool->size)++] = buffer;
-	}
-	else
+	if ((pool->size + 1) >= pool->capacity)
 	{
-		/* variable size buffers */
-
-		for (index = 0; index < pool->uSize; index++)
-		{
-			if (pool->uArray[index].buffer == buffer)
-			{
-				found = TRUE;
-				break;
-			}
-		}
-
-		if (found)
-		{
-			size = pool->uArray[index].size;
-			if (!BufferPool_ShiftUsed(pool, index, -1))
-				goto out_error;
-		}
-
-		if (size)
-		{
-			if ((pool->aSize + 1) >= pool->aCapacity)
-			{
-				int newCapacity = pool->aCapacity * 2;
-				wBufferPoolItem *newArray = (wBufferPoolItem*) realloc(pool->aArray, sizeof(wBufferPoolItem) * newCapacity);
-				if (!newArray)
-					goto out_error;
-
-				pool->aCapacity = newCapacity;
-				pool->aArray = newArray;
-			}
+		int newCapacity = pool->capacity * 2;
+		void **newArray = (void **)realloc(pool->array, sizeof(void*) * newCapacity);
+		if (!newArray)
+			goto out_error;
 
-			pool->aArray[pool->aSize].buffer = buffer;
-			pool->aArray[pool->aSize].size = size;
-			(pool->aSize)++;
-		}
+		pool->capacity = newCapacity;
+		pool->array = newArray;
 	}
 
+	pool->array[(pool->size)++] = buffer;
+
 	if (pool->synchronized)
 		LeaveCriticalSection(&pool->lock);
 	return TRUE;
@@ -377,6 +611,11 @@ out_error:
 
 void BufferPool_Clear(wBufferPool* pool)
 {
+	int index;
+	wBufferPoolBin* bin;
+	wBufferPoolCache* cache;
+	wBufferPoolHeader* header;
+
 	if (pool->synchronized)
 		EnterCriticalSection(&pool->lock);
 
@@ -398,25 +637,37 @@ void BufferPool_Clear(wBufferPool* pool)
 	{
 		/* variable size buffers */
 
-		while (pool->aSize > 0)
+		for (cache = pool->caches; cache; cache = cache->next)
 		{
-			(pool->aSize)--;
+			BufferPool_CacheLock(cache);
 
-			if (pool->alignment)
-				_aligned_free(pool->aArray[pool->aSize].buffer);
-			else
-				free(pool->aArray[pool->aSize].buffer);
+			for (index = 0; index < BUFFERPOOL_CLASS_COUNT; index++)
+			{
+				while (cache->count[index] > 0)
+					BufferPool_Dealloc(pool, cache->magazine[index][--(cache->count[index])]);
+			}
+
+			while (cache->used)
+			{
+				header = cache->used;
+				cache->used = header->next;
+				BufferPool_Dealloc(pool, BufferPool_Buffer(pool, header));
+			}
+
+			BufferPool_CacheUnlock(cache);
 		}
 
-		while (pool->uSize > 0)
+		for (index = 0; index < BUFFERPOOL_CLASS_COUNT; index++)
 		{
-			(pool->uSize)--;
+			bin = &pool->bins[index];
 
-			if (pool->alignment)
-				_aligned_free(pool->uArray[pool->uSize].buffer);
-			else
-				free(pool->uArray[pool->uSize].buffer);
+			while (bin->size > 0)
+				BufferPool_Dealloc(pool, bin->array[--(bin->size)]);
+
+			bin->out = bin->highWater = bin->ops = 0;
 		}
+
+		pool->uSize = 0;
 	}
 
 	if (pool->synchronized)
@@ -429,9 +680,10 @@ void BufferPool_Clear(wBufferPool* pool)
 
 wBufferPool* BufferPool_New(BOOL synchronized, int fixedSize, DWORD alignment)
 {
+	size_t headerAlignment;
 	wBufferPool* pool = NULL;
 
-	pool = (wBufferPool*) malloc(sizeof(wBufferPool));
+	pool = (wBufferPool*) calloc(1, sizeof(wBufferPool));
 
 	if (pool)
 	{
@@ -442,6 +694,7 @@ wBufferPool* BufferPool_New(BOOL synchronized, int fixedSize, DWORD alignment)
 
 		pool->alignment = alignment;
 		pool->synchronized = synchronized;
+		pool->cacheTls = TLS_OUT_OF_INDEXES;
 
 		if (pool->synchronized)
 			InitializeCriticalSectionAndSpinCount(&pool->lock, 4000);
@@ -460,20 +713,25 @@ wBufferPool* BufferPool_New(BOOL synchronized, int fixedSize, DWORD alignment)
 		{
 			/* variable size buffers */
 
-			pool->aSize = 0;
-			pool->aCapacity = 32;
-			pool->aArray = (wBufferPoolItem*) malloc(sizeof(wBufferPoolItem) * pool->aCapacity);
-			if (!pool->aArray)
+			headerAlignment = (pool->alignment > 16) ? pool->alignment : 16;
+			pool->headerSize = (int) (((sizeof(wBufferPoolHeader) + headerAlignment - 1) /
+					headerAlignment) * headerAlignment);
+
+			pool->bins = (wBufferPoolBin*) calloc(BUFFERPOOL_CLASS_COUNT, sizeof(wBufferPoolBin));
+			if (!pool->bins)
 				goto out_error;
 
-			pool->uSize = 0;
-			pool->uCapacity = 32;
-			pool->uArray = (wBufferPoolItem*) malloc(sizeof(wBufferPoolItem) * pool->uCapacity);
-			if (!pool->uArray)
+			pool->cache = BufferPool_CacheNew(pool);
+			if (!pool->cache)
 			{
-				free(pool->aArray);
+				free(pool->bins);
 				goto out_error;
 			}
+
+			pool->caches = pool->cache;
+
+			if (pool->synchronized)
+				pool->cacheTls = TlsAlloc();
 		}
 	}
 
@@ -488,13 +746,13 @@ out_error:
 
 void BufferPool_Free(wBufferPool* pool)
 {
+	int index;
+	wBufferPoolCache* cache;
+
 	if (pool)
 	{
 		BufferPool_Clear(pool);
 
-		if (pool->synchronized)
-			DeleteCriticalSection(&pool->lock);
-
 		if (pool->fixedSize)
 		{
 			/* fixed size buffers */
@@ -505,10 +763,25 @@ void BufferPool_Free(wBufferPool* pool)
 		{
 			/* variable size buffers */
 
-			free(pool->aArray);
-			free(pool->uArray);
+			if (pool->cacheTls != TLS_OUT_OF_INDEXES)
+				TlsFree(pool->cacheTls);
+
+			while (pool->caches)
+			{
+				cache = pool->caches;
+				pool->caches = cache->next;
+				BufferPool_CacheFree(cache);
+			}
+
+			for (index = 0; index < BUFFERPOOL_CLASS_COUNT; index++)
+				free(pool->bins[index].array);
+
+			free(pool->bins);
 		}
 
+		if (pool->synchronized)
+			DeleteCriticalSection(&pool->lock);
+
 		free(pool);
 	}
 }
@@ -22,52 +22,163 @@
 #endif
 
 #include <winpr/crt.h>
+#include <winpr/interlocked.h>
 
 #include <winpr/collections.h>
 
 /**
- * Methods
+ * Available streams are kept in per size class stacks, class n holding the
+ * streams with a capacity in [2^n, 2^(n+1)). A bit mask of the non-empty
+ * classes gives the smallest class able to satisfy a request in constant time.
+ *
+ * Used streams are kept sorted by buffer address so that a pointer inside a
+ * buffer can be resolved with a binary search. Since Stream_EnsureCapacity may
+ * move the buffer of a used stream, a lookup that misses falls back to a
+ * linear scan and restores the ordering.
  */
 
-void StreamPool_ShiftUsed(wStreamPool* pool, int index, int count)
+static int StreamPool_SizeClass(size_t size)
 {
-	if (count > 0)
+	int sizeClass = 0;
+
+	while ((size >>= 1) && (sizeClass < (STREAM_POOL_SIZE_CLASSES - 1)))
+		sizeClass++;
+
+	return sizeClass;
+}
+
+static BOOL StreamPool_PushAvailable(wStreamPool* pool, wStream* s)
+{
+	int sizeClass = StreamPool_SizeClass(Stream_Capacity(s));
+	wStreamPoolClass* pc = &pool->aClasses[sizeClass];
+
+	if (pc->size >= pc->capacity)
 	{
-		if (pool->uSize + count > pool->uCapacity)
-		{
-			int new_cap;
-			wStream **new_arr;
-
-			new_cap = pool->uCapacity * 2;
-			new_arr = (wStream**) realloc(pool->uArray, sizeof(wStream*) * new_cap);
-			if (!new_arr)
-				return;
-			pool->uCapacity = new_cap;
-			pool->uArray = new_arr;
-		}
+		int new_cap;
+		wStream** new_arr;
 
-		MoveMemory(&pool->uArray[index + count], &pool->uArray[index], (pool->uSize - index) * sizeof(wStream*));
-		pool->uSize += count;
+		new_cap = pc->capacity ? (pc->capacity * 2) : 8;
+		new_arr = (wStream**) realloc(pc->array, sizeof(wStream*) * new_cap);
+		if (!new_arr)
+			return FALSE;
+		pc->capacity = new_cap;
+		pc->array = new_arr;
 	}
-	else if (count < 0)
+
+	pc->array[(pc->size)++] = s;
+	pool->aMask |= (((UINT32) 1) << sizeClass);
+	pool->aSize++;
+
+	return TRUE;
+}
+
+static wStream* StreamPool_PopAvailable(wStreamPool* pool, size_t size)
+{
+	int sizeClass;
+	UINT32 mask;
+	wStream* s;
+	wStreamPoolClass* pc;
+
+	sizeClass = StreamPool_SizeClass(size);
+	pc = &pool->aClasses[sizeClass];
+
+	/* streams of the same class may still be too small, only check the top one */
+
+	if ((pc->size > 0) && (Stream_Capacity(pc->array[pc->size - 1]) >= size))
+	{
+		s = pc->array[--(pc->size)];
+	}
+	else
 	{
-		if (pool->uSize - index + count > 0)
+		mask = (sizeClass < (STREAM_POOL_SIZE_CLASSES - 1)) ? (pool->aMask & ~((((UINT32) 2) << sizeClass) - 1)) : 0;
+
+		if (!mask)
+			return NULL;
+
+		sizeClass = 0;
+
+		while (!(mask & (((UINT32) 1) << sizeClass)))
+			sizeClass++;
+
+		pc = &pool->aClasses[sizeClass];
+		s = pc->array[--(pc->size)];
+	}
+
+	if (pc->size == 0)
+		pool->aMask &= ~(((UINT32) 1) << sizeClass);
+
+	pool->aSize--;
+
+	return s;
+}
+
+static int StreamPool_CompareUsed(const void* a, const void* b)
+{
+	wStream* sa = *((wStream**) a);
+	wStream* sb = *((wStream**) b);
+	BYTE* pa = Stream_Buffer(sa);
+	BYTE* pb = Stream_Buffer(sb);
+
+	return (pa < pb) ? -1 : ((pa > pb) ? 1 : 0);
+}
+
+/**
+ * Returns the index of the last used stream with a buffer starting at or
+ * before ptr, -1 if there is none.
+ */
+
+static int StreamPool_SearchUsed(wStreamPool* pool, BYTE* ptr)
+{
+	int low = 0;
+	int high = pool->uSize - 1;
+	int middle;
+
+	while (low <= high)
+	{
+		middle = low + ((high - low) / 2);
+
+		if (Stream_Buffer(pool->uArray[middle]) <= ptr)
+			low = middle + 1;
+		else
+			high = middle - 1;
+	}
+
+	return high;
+}
+
+static int StreamPool_IndexOfUsed(wStreamPool* pool, wStream* s)
+{
+	int index;
+
+	index = StreamPool_SearchUsed(pool, Stream_Buffer(s));
+
+	for (; (index >= 0) && (Stream_Buffer(pool->uArray[index]) == Stream_Buffer(s)); index--)
+	{
+		if (pool->uArray[index] == s)
+			return index;
+	}
+
+	for (index = 0; index < pool->uSize; index++)
+	{
+		if (pool->uArray[index] == s)
 		{
-			MoveMemory(&pool->uArray[index], &pool->uArray[index - count],
-					(pool->uSize - index + count) * sizeof(wStream*));
+			qsort(pool->uArray, pool->uSize, sizeof(wStream*), StreamPool_CompareUsed);
+			return StreamPool_IndexOfUsed(pool, s);
 		}
-
-		pool->uSize += count;
 	}
+
+	return -1;
 }
 
 /**
  * Adds a used stream to the pool.
  */
 
-void StreamPool_AddUsed(wStreamPool* pool, wStream* s)
+static BOOL StreamPool_AddUsed(wStreamPool* pool, wStream* s)
 {
-	if ((pool->uSize + 1) >= pool->uCapacity)
+	int index;
+
+	if (pool->uSize >= pool->uCapacity)
 	{
 		int new_cap;
 		wStream **new_arr;
@@ -75,66 +186,35 @@ void StreamPool_AddUsed(wStreamPool* pool, wStream* s)
 		new_cap = pool->uCapacity * 2;
 		new_arr = (wStream**) realloc(pool->uArray, sizeof(wStream*) * new_cap);
 		if (!new_arr)
-			return;
+			return FALSE;
 		pool->uCapacity = new_cap;
 		pool->uArray = new_arr;
 	}
 
-	pool->uArray[(pool->uSize)++] = s;
+	index = StreamPool_SearchUsed(pool, Stream_Buffer(s)) + 1;
+
+	MoveMemory(&pool->uArray[index + 1], &pool->uArray[index], (pool->uSize - index) * sizeof(wStream*));
+	pool->uArray[index] = s;
+	pool->uSize++;
+
+	return TRUE;
 }
 
 /**
  * Removes a used stream from the pool.
  */
 
-void StreamPool_RemoveUsed(wStreamPool* pool, wStream* s)
+static void StreamPool_RemoveUsed(wStreamPool* pool, wStream* s)
 {
 	int index;
-	BOOL found = FALSE;
-
-	for (index = 0; index < pool->uSize; index++)
-	{
-		if (pool->uArray[index] == s)
-		{
-			found = TRUE;
-			break;
-		}
-	}
 
-	if (found)
-		StreamPool_ShiftUsed(pool, index, -1);
-}
-
-void StreamPool_ShiftAvailable(wStreamPool* pool, int index, int count)
-{
-	if (count > 0)
-	{
-		if (pool->aSize + count > pool->aCapacity)
-		{
-			int new_cap;
-			wStream **new_arr;
-
-			new_cap = pool->aCapacity * 2;
-			new_arr = (wStream**) realloc(pool->aArray, sizeof(wStream*) * new_cap);
-			if (!new_arr)
-				return;
-			pool->aCapacity = new_cap;
-			pool->aArray = new_arr;
-		}
+	index = StreamPool_IndexOfUsed(pool, s);
 
-		MoveMemory(&pool->aArray[index + count], &pool->aArray[index], (pool->aSize - index) * sizeof(wStream*));
-		pool->aSize += count;
-	}
-	else if (count < 0)
-	{
-		if (pool->aSize - index + count > 0)
-		{
-			MoveMemory(&pool->aArray[index], &pool->aArray[index - count],
-					(pool->aSize - index + count) * sizeof(wStream*));
-		}
+	if (index < 0)
+		return;
 
-		pool->aSize += count;
-	}
+	MoveMemory(&pool->uArray[index], &pool->uArray[index + 1], (pool->uSize - index - 1) * sizeof(wStream*));
+	pool->uSize--;
 }
 
 /**
@@ -143,8 +223,6 @@ void StreamPool_ShiftAvailable(wStreamPool* pool, int index, int count)
 
 wStream* StreamPool_Take(wStreamPool* pool, size_t size)
 {
-	int index;
-	int foundIndex;
 	wStream* s = NULL;
 
 	if (pool->synchronized)
@@ -153,20 +231,9 @@ wStream* StreamPool_Take(wStreamPool* pool, size_t size)
 	if (size == 0)
 		size = pool->defaultSize;
 
-	foundIndex = -1;
+	s = StreamPool_PopAvailable(pool, size);
 
-	for (index = 0; index < pool->aSize; index++)
-	{
-		s = pool->aArray[index];
-
-		if (Stream_Capacity(s) >= size)
-		{
-			foundIndex = index;
-			break;
-		}
-	}
-
-	if (foundIndex < 0)
+	if (!s)
 	{
 		s = Stream_New(NULL, size);
 		if (!s)
@@ -175,16 +242,18 @@ wStream* StreamPool_Take(wStreamPool* pool, size_t size)
 	else
 	{
 		Stream_SetPosition(s, 0);
-		StreamPool_ShiftAvailable(pool, foundIndex, -1);
 	}
 
-	if (s)
+	if (!StreamPool_AddUsed(pool, s))
 	{
-		s->pool = pool;
-		s->count = 1;
-		StreamPool_AddUsed(pool, s);
+		Stream_Free(s, TRUE);
+		s = NULL;
+		goto out_fail;
 	}
 
+	s->pool = pool;
+	s->count = 1;
+
 out_fail:
 	if (pool->synchronized)
 		LeaveCriticalSection(&pool->lock);
@@ -201,35 +270,11 @@ void StreamPool_Return(wStreamPool* pool, wStream* s)
 	if (pool->synchronized)
 		EnterCriticalSection(&pool->lock);
 
-	if ((pool->aSize + 1) >= pool->aCapacity)
-	{
-		int new_cap;
-		wStream **new_arr;
-
-		new_cap = pool->aCapacity * 2;
-		new_arr = (wStream**) realloc(pool->aArray, sizeof(wStream*) * new_cap);
-		if (!new_arr)
-			goto out_fail;
-		pool->aCapacity = new_cap;
-		pool->aArray = new_arr;
-	}
-	else if ((pool->aSize + 1) * 3 < pool->aCapacity)
-	{
-		int new_cap;
-		wStream **new_arr;
-
-		new_cap = pool->aCapacity / 2;
-		new_arr = (wStream**) realloc(pool->aArray, sizeof(wStream*) * new_cap);
-		if (!new_arr)
-			goto out_fail;
-		pool->aCapacity = new_cap;
-		pool->aArray = new_arr;
-	}
-
-	pool->aArray[(pool->aSize)++] = s;
 	StreamPool_RemoveUsed(pool, s);
 
-out_fail:
+	if (!StreamPool_PushAvailable(pool, s))
+		Stream_Free(s, TRUE);
+
 	if (pool->synchronized)
 		LeaveCriticalSection(&pool->lock);
 }
@@ -259,11 +304,7 @@ void StreamPool_Unlock(wStreamPool* pool)
 void Stream_AddRef(wStream* s)
 {
 	if (s->pool)
-	{
-		StreamPool_Lock(s->pool);
-		s->count++;
-		StreamPool_Unlock(s->pool);
-	}
+		InterlockedIncrement((LONG volatile*) &(s->count));
 }
 
 /**
@@ -272,15 +313,9 @@ void Stream_AddRef(wStream* s)
 
 void Stream_Release(wStream* s)
 {
-	DWORD count;
-
 	if (s->pool)
 	{
-		StreamPool_Lock(s->pool);
-		count = --(s->count);
-		StreamPool_Unlock(s->pool);
-
-		if (count == 0)
+		if (InterlockedDecrement((LONG volatile*) &(s->count)) == 0)
 			StreamPool_Return(s->pool, s);
 	}
 }
@@ -289,28 +324,40 @@ void Stream_Release(wStream* s)
  * Find stream in pool using pointer inside buffer
  */
 
+static BOOL StreamPool_Contains(wStream* s, BYTE* ptr)
+{
+	return ((ptr >= Stream_Buffer(s)) && (ptr < (Stream_Buffer(s) + Stream_Capacity(s)))) ? TRUE : FALSE;
+}
+
 wStream* StreamPool_Find(wStreamPool* pool, BYTE* ptr)
 {
 	int index;
 	wStream* s = NULL;
-	BOOL found = FALSE;
 
 	EnterCriticalSection(&pool->lock);
 
-	for (index = 0; index < pool->uSize; index++)
+	index = StreamPool_SearchUsed(pool, ptr);
+
+	if ((index >= 0) && StreamPool_Contains(pool->uArray[index], ptr))
 	{
 		s = pool->uArray[index];
-
-		if ((ptr >= Stream_Buffer(s)) && (ptr < (Stream_Buffer(s) + Stream_Capacity(s))))
+	}
+	else
+	{
+		for (index = 0; index < pool->uSize; index++)
 		{
-			found = TRUE;
-			break;
+			if (StreamPool_Contains(pool->uArray[index], ptr))
+			{
+				s = pool->uArray[index];
+				qsort(pool->uArray, pool->uSize, sizeof(wStream*), StreamPool_CompareUsed);
+				break;
+			}
 		}
 	}
 
 	LeaveCriticalSection(&pool->lock);
 
-	return (found) ? s : NULL;
+	return s;
 }
 
 /**
@@ -347,15 +394,26 @@ void StreamPool_Release(wStreamPool* pool, BYTE* ptr)
 
 void StreamPool_Clear(wStreamPool* pool)
 {
+	int sizeClass;
+	wStreamPoolClass* pc;
+
 	if (pool->synchronized)
 		EnterCriticalSection(&pool->lock);
 
-	while (pool->aSize > 0)
+	for (sizeClass = 0; sizeClass < STREAM_POOL_SIZE_CLASSES; sizeClass++)
 	{
-		(pool->aSize)--;
-		Stream_Free(pool->aArray[pool->aSize], TRUE);
+		pc = &pool->aClasses[sizeClass];
+
+		while (pc->size > 0)
+		{
+			(pc->size)--;
+			Stream_Free(pc->array[pc->size], TRUE);
+		}
 	}
 
+	pool->aMask = 0;
+	pool->aSize = 0;
+
 	if (pool->synchronized)
 		LeaveCriticalSection(&pool->lock);
 }
@@ -375,23 +433,12 @@ wStreamPool* StreamPool_New(BOOL synchronized, size_t defaultSize)
 		pool->synchronized = synchronized;
 		pool->defaultSize = defaultSize;
 
-		pool->aSize = 0;
-		pool->aCapacity = 32;
-		pool->aArray = (wStream**) calloc(pool->aCapacity, sizeof(wStream*));
-
-		if (!pool->aArray)
-		{
-			free(pool);
-			return NULL;
-		}
-
 		pool->uSize = 0;
 		pool->uCapacity = 32;
 		pool->uArray = (wStream**) calloc(pool->uCapacity, sizeof(wStream*));
 
 		if (!pool->uArray)
 		{
-			free(pool->aArray);
 			free(pool);
 			return NULL;
 		}
@@ -404,13 +451,17 @@ wStreamPool* StreamPool_New(BOOL synchronized, size_t defaultSize)
 
 void StreamPool_Free(wStreamPool* pool)
 {
+	int sizeClass;
+
 	if (pool)
 	{
 		StreamPool_Clear(pool);
 
 		DeleteCriticalSection(&pool->lock);
 
-		free(pool->aArray);
+		for (sizeClass = 0; sizeClass < STREAM_POOL_SIZE_CLASSES; sizeClass++)
+			free(pool->aClasses[sizeClass].array);
+
 		free(pool->uArray);
 
 		free(pool);
@@ -25,9 +25,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <sys/types.h>
+#include <sys/stat.h>
+
 #include <winpr/crt.h>
 #include <winpr/sam.h>
 #include <winpr/print.h>
+#include <winpr/synch.h>
+
+#include "sam.h"
 
 #include "../log.h"
 #ifdef HAVE_UNISTD_H
@@ -41,26 +47,87 @@
 #endif
 #define TAG WINPR_TAG("utils")
 
-WINPR_SAM* SamOpen(BOOL read_only)
+/**
+ * Lookups are served from an index of the SAM file kept in memory, it is
+ * built on the first lookup and again whenever the file changes on disk.
+ * Entries of a user are chained in file order so that the first matching
+ * line wins, as it did when the file was scanned for every lookup.
+ */
+
+#define WINPR_SAM_INDEX_MIN_BUCKETS	64
+
+/* a file rewritten within the same second keeps its st_mtime, compare nanoseconds too */
+#if defined(__APPLE__)
+#define WINPR_SAM_STAT_NSEC(_st, _field)	((_st)->_field##spec.tv_nsec)
+#elif defined(_WIN32)
+#define WINPR_SAM_STAT_NSEC(_st, _field)	0
+#else
+#define WINPR_SAM_STAT_NSEC(_st, _field)	((_st)->_field.tv_nsec)
+#endif
+
+struct winpr_sam_record
+{
+	LPSTR User;
+	UINT32 UserLength;
+	LPSTR Domain;
+	UINT32 DomainLength;
+	BYTE LmHash[16];
+	BYTE NtHash[16];
+	UINT32 next;
+};
+typedef struct winpr_sam_record WINPR_SAM_RECORD;
+
+struct winpr_sam_index
+{
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	time_t mtime;
+	long mtimeNsec;
+	time_t ctime;
+	long ctimeNsec;
+
+	char* buffer;
+	UINT32 count;
+	WINPR_SAM_RECORD* records;
+	UINT32 bucketMask;
+	UINT32* buckets;
+};
+typedef struct winpr_sam_index WINPR_SAM_INDEX;
+
+static INIT_ONCE g_SamIndexOnce = INIT_ONCE_STATIC_INIT;
+static CRITICAL_SECTION g_SamIndexLock;
+static WINPR_SAM_INDEX* g_SamIndex = NULL;
+
+static BOOL CALLBACK SamIndexInitOnce(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	InitializeCriticalSectionAndSpinCount(&g_SamIndexLock, 4000);
+	return TRUE;
+}
+
+WINPR_SAM* SamOpenFile(const char* filename, BOOL read_only)
 {
 	FILE* fp = NULL;
 	WINPR_SAM* sam = NULL;
 
+	if (!filename)
+		return NULL;
+
 	if (read_only)
 	{
-		fp = fopen(WINPR_SAM_FILE, "r");
+		fp = fopen(filename, "r");
 	}
 	else
 	{
-		fp = fopen(WINPR_SAM_FILE, "r+");
+		fp = fopen(filename, "r+");
 
 		if (!fp)
-			fp = fopen(WINPR_SAM_FILE, "w+");
+			fp = fopen(filename, "w+");
 	}
 
 	if (fp)
 	{
-		sam = (WINPR_SAM*) malloc(sizeof(WINPR_SAM));
+		sam = (WINPR_SAM*) calloc(1, sizeof(WINPR_SAM));
 		if (!sam)
 		{
 			fclose(fp);
@@ -75,47 +142,9 @@ WINPR_SAM* SamOpen(BOOL read_only)
 	return sam;
 }
 
-static BOOL SamLookupStart(WINPR_SAM* sam)
-{
-	size_t read_size;
-	long int file_size;
-	fseek(sam->fp, 0, SEEK_END);
-	file_size = ftell(sam->fp);
-	fseek(sam->fp, 0, SEEK_SET);
-
-	if (file_size < 1)
-		return FALSE;
-
-	sam->buffer = (char*) malloc(file_size + 2);
-	if (!sam->buffer)
-		return FALSE;
-
-	read_size = fread(sam->buffer, file_size, 1, sam->fp);
-
-	if (!read_size)
-	{
-		if (!ferror(sam->fp))
-			read_size = file_size;
-	}
-
-	if (read_size < 1)
-	{
-		free(sam->buffer);
-		sam->buffer = NULL;
-		return FALSE;
-	}
-
-	sam->buffer[file_size] = '\n';
-	sam->buffer[file_size + 1] = '\0';
-	sam->line = strtok(sam->buffer, "\n");
-	return TRUE;
-}
-
-static void SamLookupFinish(WINPR_SAM* sam)
+WINPR_SAM* SamOpen(BOOL read_only)
 {
-	free(sam->buffer);
-	sam->buffer = NULL;
-	sam->line = NULL;
+	return SamOpenFile(WINPR_SAM_FILE, read_only);
 }
 
 static void HexStrToBin(char* str, BYTE* bin, int length)
@@ -141,248 +170,392 @@ static void HexStrToBin(char* str, BYTE* bin, int length)
 	}
 }
 
-BOOL SamReadEntry(WINPR_SAM *sam, WINPR_SAM_ENTRY *entry)
+static UINT32 SamHashUser(const char* User, UINT32 UserLength)
 {
-	char* p[7];
-	int LmHashLength;
-	int NtHashLength;
-
-	p[0] = sam->line;
-	p[1] = strchr(p[0], ':') + 1;
-	p[2] = strchr(p[1], ':') + 1;
-	p[3] = strchr(p[2], ':') + 1;
-	p[4] = strchr(p[3], ':') + 1;
-	p[5] = strchr(p[4], ':') + 1;
-	p[6] = p[0] + strlen(p[0]);
-	entry->UserLength = (UINT32)(p[1] - p[0] - 1);
-	entry->User = (LPSTR) malloc(entry->UserLength + 1);
-	if (!entry->User)
-		return FALSE;
-	entry->User[entry->UserLength] = '\0';
-	entry->DomainLength = (UINT32)(p[2] - p[1] - 1);
-	LmHashLength = (int)(p[3] - p[2] - 1);
-	NtHashLength = (int)(p[4] - p[3] - 1);
-	memcpy(entry->User, p[0], entry->UserLength);
-
-	if (entry->DomainLength > 0)
-	{
-		entry->Domain = (LPSTR) malloc(entry->DomainLength + 1);
-		if (!entry->Domain)
-		{
-			free(entry->User);
-			entry->User = NULL;
-			return FALSE;
-		}
-		memcpy(entry->Domain, p[1], entry->DomainLength);
-		entry->Domain[entry->DomainLength] = '\0';
-	}
-	else
+	UINT32 index;
+	UINT32 hash = 2166136261U;
+
+	for (index = 0; index < UserLength; index++)
+		hash = (hash ^ (BYTE) User[index]) * 16777619U;
+
+	return hash;
+}
+
+static void SamIndexFree(WINPR_SAM_INDEX* index)
+{
+	if (!index)
+		return;
+
+	free(index->buckets);
+	free(index->records);
+	free(index->buffer);
+	free(index);
+}
+
+static char* SamReadFile(FILE* fp, long int* size)
+{
+	char* buffer;
+	size_t read_size;
+	long int file_size;
+
+	fseek(fp, 0, SEEK_END);
+	file_size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	if (file_size < 1)
+		return NULL;
+
+	buffer = (char*) malloc(file_size + 2);
+
+	if (!buffer)
+		return NULL;
+
+	read_size = fread(buffer, file_size, 1, fp);
+
+	if (!read_size)
 	{
-		entry->Domain = NULL;
+		if (!ferror(fp))
+			read_size = file_size;
 	}
 
-	if (LmHashLength == 32)
+	if (read_size < 1)
 	{
-		HexStrToBin(p[2], (BYTE*) entry->LmHash, 16);
+		free(buffer);
+		return NULL;
 	}
 
-	if (NtHashLength == 32)
+	buffer[file_size] = '\n';
+	buffer[file_size + 1] = '\0';
+	*size = file_size;
+
+	return buffer;
+}
+
+/* splits a User:Domain:LmHash:NtHash::: line in place */
+static BOOL SamParseLine(char* line, WINPR_SAM_RECORD* record)
+{
+	int index;
+	char* p[5];
+
+	p[0] = line;
+
+	for (index = 1; index < 5; index++)
 	{
-		HexStrToBin(p[3], (BYTE*) entry->NtHash, 16);
+		p[index] = strchr(p[index - 1], ':');
+
+		if (!p[index])
+			return FALSE;
+
+		*p[index]++ = '\0';
 	}
 
+	ZeroMemory(record, sizeof(WINPR_SAM_RECORD));
+
+	record->User = p[0];
+	record->UserLength = (UINT32) (p[1] - p[0] - 1);
+	record->Domain = p[1];
+	record->DomainLength = (UINT32) (p[2] - p[1] - 1);
+
+	if ((p[3] - p[2] - 1) == 32)
+		HexStrToBin(p[2], record->LmHash, 16);
+
+	if ((p[4] - p[3] - 1) == 32)
+		HexStrToBin(p[3], record->NtHash, 16);
+
 	return TRUE;
 }
 
-void SamFreeEntry(WINPR_SAM* sam, WINPR_SAM_ENTRY* entry)
+static WINPR_SAM_INDEX* SamIndexBuild(FILE* fp, struct stat* st)
 {
-	if (entry)
+	char* line;
+	char* context = NULL;
+	UINT32 index;
+	UINT32 bucket;
+	UINT32 lines = 0;
+	UINT32 bucketCount;
+	long int file_size = 0;
+	WINPR_SAM_RECORD* record;
+	WINPR_SAM_INDEX* sam_index;
+
+	sam_index = (WINPR_SAM_INDEX*) calloc(1, sizeof(WINPR_SAM_INDEX));
+
+	if (!sam_index)
+		return NULL;
+
+	sam_index->dev = st->st_dev;
+	sam_index->ino = st->st_ino;
+	sam_index->size = st->st_size;
+	sam_index->mtime = st->st_mtime;
+	sam_index->mtimeNsec = WINPR_SAM_STAT_NSEC(st, st_mtim);
+	sam_index->ctime = st->st_ctime;
+	sam_index->ctimeNsec = WINPR_SAM_STAT_NSEC(st, st_ctim);
+
+	sam_index->buffer = SamReadFile(fp, &file_size);
+
+	if (!sam_index->buffer)
+		goto fail;
+
+	for (index = 0; index < (UINT32) file_size; index++)
 	{
-		if (entry->UserLength > 0)
-			free(entry->User);
+		if (sam_index->buffer[index] == '\n')
+			lines++;
+	}
 
-		if (entry->DomainLength > 0)
-			free(entry->Domain);
+	sam_index->records = (WINPR_SAM_RECORD*) calloc(lines + 1, sizeof(WINPR_SAM_RECORD));
 
-		free(entry);
+	if (!sam_index->records)
+		goto fail;
+
+	line = strtok_s(sam_index->buffer, "\n", &context);
+
+	while (line)
+	{
+		if ((strlen(line) > 1) && (line[0] != '#'))
+		{
+			if (SamParseLine(line, &sam_index->records[sam_index->count]))
+				sam_index->count++;
+		}
+
+		line = strtok_s(NULL, "\n", &context);
 	}
+
+	bucketCount = WINPR_SAM_INDEX_MIN_BUCKETS;
+
+	while (bucketCount < sam_index->count)
+		bucketCount <<= 1;
+
+	sam_index->bucketMask = bucketCount - 1;
+	sam_index->buckets = (UINT32*) calloc(bucketCount, sizeof(UINT32));
+
+	if (!sam_index->buckets)
+		goto fail;
+
+	/* buckets and chains hold record index + 1, prepend backwards to keep file order */
+	for (index = sam_index->count; index > 0; index--)
+	{
+		record = &sam_index->records[index - 1];
+		bucket = SamHashUser(record->User, record->UserLength) & sam_index->bucketMask;
+		record->next = sam_index->buckets[bucket];
+		sam_index->buckets[bucket] = index;
+	}
+
+	return sam_index;
+
+fail:
+	SamIndexFree(sam_index);
+	return NULL;
 }
 
-void SamResetEntry(WINPR_SAM_ENTRY* entry)
+/* called with g_SamIndexLock held, returns the index matching the open file */
+static WINPR_SAM_INDEX* SamIndexGet(WINPR_SAM* sam)
 {
-	if (!entry)
+	struct stat st;
+	WINPR_SAM_INDEX* index = g_SamIndex;
+
+	if (fstat(fileno(sam->fp), &st) != 0)
+		return NULL;
+
+	if (index && (index->dev == st.st_dev) && (index->ino == st.st_ino) &&
+			(index->size == st.st_size) && (index->mtime == st.st_mtime) &&
+			(index->mtimeNsec == WINPR_SAM_STAT_NSEC(&st, st_mtim)) &&
+			(index->ctime == st.st_ctime) &&
+			(index->ctimeNsec == WINPR_SAM_STAT_NSEC(&st, st_ctim)))
+		return index;
+
+	index = SamIndexBuild(sam->fp, &st);
+
+	if (!index)
+		return NULL;
+
+	SamIndexFree(g_SamIndex);
+	g_SamIndex = index;
+
+	return index;
+}
+
+void winpr_Sam_FreeIndex(void)
+{
+	if (!InitOnceExecuteOnce(&g_SamIndexOnce, SamIndexInitOnce, NULL, NULL))
 		return;
 
-	if (entry->UserLength)
+	EnterCriticalSection(&g_SamIndexLock);
+	SamIndexFree(g_SamIndex);
+	g_SamIndex = NULL;
+	LeaveCriticalSection(&g_SamIndexLock);
+}
+
+static WINPR_SAM_ENTRY* SamEntryFromRecord(WINPR_SAM_RECORD* record)
+{
+	WINPR_SAM_ENTRY* entry;
+
+	entry = (WINPR_SAM_ENTRY*) calloc(1, sizeof(WINPR_SAM_ENTRY));
+
+	if (!entry)
+		return NULL;
+
+	entry->UserLength = record->UserLength;
+	entry->User = (LPSTR) malloc(entry->UserLength + 1);
+
+	if (!entry->User)
 	{
-		free(entry->User);
-		entry->User = NULL;
+		free(entry);
+		return NULL;
 	}
 
-	if (entry->DomainLength)
+	CopyMemory(entry->User, record->User, entry->UserLength + 1);
+
+	if (record->DomainLength > 0)
 	{
-		free(entry->Domain);
-		entry->Domain = NULL;
+		entry->DomainLength = record->DomainLength;
+		entry->Domain = (LPSTR) malloc(entry->DomainLength + 1);
+
+		if (!entry->Domain)
+		{
+			free(entry->User);
+			free(entry);
+			return NULL;
+		}
+
+		CopyMemory(entry->Domain, record->Domain, entry->DomainLength + 1);
 	}
-	ZeroMemory(entry->LmHash, sizeof(entry->LmHash));
-	ZeroMemory(entry->NtHash, sizeof(entry->NtHash));
+
+	CopyMemory(entry->LmHash, record->LmHash, sizeof(entry->LmHash));
+	CopyMemory(entry->NtHash, record->NtHash, sizeof(entry->NtHash));
+
+	return entry;
 }
 
+/**
+ * Looks up a user, and a domain when one is given, both UTF-8 and compared
+ * byte for byte. An empty domain matches any entry.
+ */
 
-WINPR_SAM_ENTRY* SamLookupUserA(WINPR_SAM* sam, LPSTR User, UINT32 UserLength, LPSTR Domain, UINT32 DomainLength)
+static WINPR_SAM_ENTRY* SamIndexLookup(WINPR_SAM* sam, const char* User, UINT32 UserLength,
+		const char* Domain, UINT32 DomainLength)
 {
-	int length;
-	BOOL found = FALSE;
-	WINPR_SAM_ENTRY* entry;
-	entry = (WINPR_SAM_ENTRY*) calloc(1, sizeof(WINPR_SAM_ENTRY));
-	if (!entry)
+	UINT32 next;
+	WINPR_SAM_INDEX* index;
+	WINPR_SAM_RECORD* record;
+	WINPR_SAM_ENTRY* entry = NULL;
+
+	if (!sam || !sam->fp || !User)
 		return NULL;
 
-	if (!SamLookupStart(sam))
+	if (!InitOnceExecuteOnce(&g_SamIndexOnce, SamIndexInitOnce, NULL, NULL))
 		return NULL;
 
-	while (sam->line != NULL)
+	EnterCriticalSection(&g_SamIndexLock);
+
+	index = SamIndexGet(sam);
+
+	if (index)
 	{
-		length = (int) strlen(sam->line);
+		next = index->buckets[SamHashUser(User, UserLength) & index->bucketMask];
 
-		if (length > 1)
+		while (next)
 		{
-			if (sam->line[0] != '#')
+			record = &index->records[next - 1];
+			next = record->next;
+
+			if ((record->UserLength != UserLength) || (memcmp(record->User, User, UserLength) != 0))
+				continue;
+
+			if (DomainLength > 0)
 			{
-				if (!SamReadEntry(sam, entry))
-				{
-					goto out_fail;
-				}
-
-				if (strcmp(User, entry->User) == 0)
-				{
-					found = 1;
-					break;
-				}
+				if ((record->DomainLength != DomainLength) ||
+						(memcmp(record->Domain, Domain, DomainLength) != 0))
+					continue;
 			}
+
+			entry = SamEntryFromRecord(record);
+			break;
 		}
-		SamResetEntry(entry);
-		sam->line = strtok(NULL, "\n");
 	}
 
-out_fail:
-	SamLookupFinish(sam);
+	LeaveCriticalSection(&g_SamIndexLock);
 
-	if (!found)
-	{
-		free(entry);
+	return entry;
+}
+
+WINPR_SAM_ENTRY* SamLookupUserA(WINPR_SAM* sam, LPSTR User, UINT32 UserLength, LPSTR Domain, UINT32 DomainLength)
+{
+	if (!User)
 		return NULL;
-	}
 
-	return entry;
+	/* the domain has never been taken into account here */
+	return SamIndexLookup(sam, User, (UINT32) strlen(User), NULL, 0);
 }
 
 WINPR_SAM_ENTRY* SamLookupUserW(WINPR_SAM* sam, LPWSTR User, UINT32 UserLength, LPWSTR Domain, UINT32 DomainLength)
 {
 	int length;
-	BOOL Found = FALSE;
-	BOOL UserMatch;
-	BOOL DomainMatch;
-	LPWSTR EntryUser = NULL;
-	UINT32 EntryUserLength;
-	LPWSTR EntryDomain = NULL;
-	UINT32 EntryDomainLength;
+	int domainLength = 0;
+	char* utf8User = NULL;
+	char* utf8Domain = NULL;
 	WINPR_SAM_ENTRY* entry;
 
-	if (!(entry = (WINPR_SAM_ENTRY*) calloc(1, sizeof(WINPR_SAM_ENTRY))))
+	if (!User || (UserLength < 2))
 		return NULL;
 
-	if (!SamLookupStart(sam))
+	length = ConvertFromUnicode(CP_UTF8, 0, User, UserLength / 2, &utf8User, 0, NULL, NULL);
+
+	if (length <= 0)
 		return NULL;
 
-	while (sam->line != NULL)
+	if (Domain && (DomainLength >= 2))
 	{
-		length = (int) strlen(sam->line);
+		domainLength = ConvertFromUnicode(CP_UTF8, 0, Domain, DomainLength / 2, &utf8Domain, 0, NULL, NULL);
 
-		if (length > 1)
+		if (domainLength <= 0)
 		{
-			if (sam->line[0] != '#')
-			{
-				DomainMatch = 0;
-				UserMatch = 0;
-				if (!SamReadEntry(sam, entry))
-					goto out_fail;
-
-				if (DomainLength > 0)
-				{
-					if (entry->DomainLength > 0)
-					{
-						EntryDomainLength = (UINT32) strlen(entry->Domain) * 2;
-						EntryDomain = (LPWSTR) malloc(EntryDomainLength + 2);
-						if (!EntryDomain)
-							goto out_fail;
-						MultiByteToWideChar(CP_ACP, 0, entry->Domain, EntryDomainLength / 2,
-											(LPWSTR) EntryDomain, EntryDomainLength / 2);
-
-						if (DomainLength == EntryDomainLength)
-						{
-							if (memcmp(Domain, EntryDomain, DomainLength) == 0)
-							{
-								DomainMatch = 1;
-							}
-						}
-
-						free(EntryDomain);
-					}
-					else
-					{
-						DomainMatch = 0;
-					}
-				}
-				else
-				{
-					DomainMatch = 1;
-				}
-
-				if (DomainMatch)
-				{
-					EntryUserLength = (UINT32) strlen(entry->User) * 2;
-					EntryUser = (LPWSTR) malloc(EntryUserLength + 2);
-					if (!EntryUser)
-						goto out_fail;
-					MultiByteToWideChar(CP_ACP, 0, entry->User, EntryUserLength / 2,
-										(LPWSTR) EntryUser, EntryUserLength / 2);
-
-					if (UserLength == EntryUserLength)
-					{
-						if (memcmp(User, EntryUser, UserLength) == 0)
-						{
-							UserMatch = 1;
-						}
-					}
-
-					free(EntryUser);
-
-					if (UserMatch && DomainMatch)
-					{
-						Found = TRUE;
-						break;
-					}
-				}
-			}
+			free(utf8User);
+			return NULL;
 		}
-
-		SamResetEntry(entry);
-		sam->line = strtok(NULL, "\n");
 	}
 
-out_fail:
-	SamLookupFinish(sam);
+	entry = SamIndexLookup(sam, utf8User, (UINT32) length, utf8Domain, (UINT32) domainLength);
 
-	if (!Found)
+	free(utf8User);
+	free(utf8Domain);
+
+	return entry;
+}
+
+void SamFreeEntry(WINPR_SAM* sam, WINPR_SAM_ENTRY* entry)
+{
+	if (entry)
 	{
+		if (entry->UserLength > 0)
+			free(entry->User);
+
+		if (entry->DomainLength > 0)
+			free(entry->Domain);
+
 		free(entry);
-		return NULL;
 	}
+}
 
-	return entry;
+void SamResetEntry(WINPR_SAM_ENTRY* entry)
+{
+	if (!entry)
+		return;
+
+	if (entry->UserLength)
+	{
+		free(entry->User);
+		entry->User = NULL;
+	}
+
+	if (entry->DomainLength)
+	{
+		free(entry->Domain);
+		entry->Domain = NULL;
+	}
+	ZeroMemory(entry->LmHash, sizeof(entry->LmHash));
+	ZeroMemory(entry->NtHash, sizeof(entry->NtHash));
 }
 
+
 void SamClose(WINPR_SAM* sam)
 {
 	if (sam != NULL)
@@ -0,0 +1,26 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * Security Accounts Manager (SAM)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WINPR_UTILS_SAM_PRIVATE_H
+#define WINPR_UTILS_SAM_PRIVATE_H
+
+#include <winpr/sam.h>
+
+/* Releases the in-memory index of the SAM file, the next lookup rebuilds it */
+void winpr_Sam_FreeIndex(void);
+
+#endif /* WINPR_UTILS_SAM_PRIVATE_H */
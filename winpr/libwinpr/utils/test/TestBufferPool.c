@@ -1,8 +1,35 @@
 
 #include <winpr/crt.h>
 #include <winpr/stream.h>
+#include <winpr/thread.h>
 #include <winpr/collections.h>
 
+static void* test_buffer_pool_thread(void* arg)
+{
+	int index;
+	int size;
+	BYTE* buffer;
+	wBufferPool* pool = (wBufferPool*) arg;
+
+	for (index = 0; index < 10000; index++)
+	{
+		size = 1 + ((index * 7919) % 65536);
+		buffer = BufferPool_Take(pool, size);
+
+		if (!buffer)
+			return (void*) (size_t) 1;
+
+		FillMemory(buffer, size, 0xAB);
+
+		if (BufferPool_GetBufferSize(pool, buffer) != size)
+			return (void*) (size_t) 1;
+
+		BufferPool_Return(pool, buffer);
+	}
+
+	return NULL;
+}
+
 int TestBufferPool(int argc, char* argv[])
 {
 	DWORD PoolSize;
@@ -10,6 +37,9 @@ int TestBufferPool(int argc, char* argv[])
 	wBufferPool* pool;
 	BYTE* Buffers[10];
 	DWORD DefaultSize = 1234;
+	int index;
+	DWORD status;
+	HANDLE threads[4];
 
 	pool = BufferPool_New(TRUE, -1, 16);
 	if (!pool)
@@ -55,10 +85,57 @@ int TestBufferPool(int argc, char* argv[])
 		return -1;
 	}
 
+	BufferPool_Return(pool, Buffers[0]);
+	Buffers[3] = BufferPool_Take(pool, DefaultSize);
+
+	if (Buffers[3] != Buffers[0])
+	{
+		printf("BufferPool_Take failure: returned buffer was not reused\n");
+		return -1;
+	}
+
+	if (BufferPool_Return(pool, Buffers[1]))
+	{
+		printf("BufferPool_Return failure: buffer returned twice\n");
+		return -1;
+	}
+
 	BufferPool_Clear(pool);
 
 	BufferPool_Free(pool);
 
+	pool = BufferPool_New(TRUE, 0, 16);
+	if (!pool)
+		return -1;
+
+	for (index = 0; index < 4; index++)
+	{
+		if (!(threads[index] = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE) test_buffer_pool_thread,
+				(void*) pool, 0, NULL)))
+			return -1;
+	}
+
+	for (index = 0; index < 4; index++)
+	{
+		WaitForSingleObject(threads[index], INFINITE);
+		GetExitCodeThread(threads[index], &status);
+		CloseHandle(threads[index]);
+
+		if (status != 0)
+		{
+			printf("BufferPool concurrent take/return failure\n");
+			return -1;
+		}
+	}
+
+	if (BufferPool_GetPoolSize(pool) != 0)
+	{
+		printf("BufferPool_GetPoolSize failure: Actual: %d Expected: %d\n", BufferPool_GetPoolSize(pool), 0);
+		return -1;
+	}
+
+	BufferPool_Free(pool);
+
 	return 0;
 }
 
@@ -0,0 +1,260 @@
+#include <winpr/crt.h>
+#include <winpr/sam.h>
+#include <winpr/path.h>
+#include <winpr/thread.h>
+#include <winpr/file.h>
+#include <winpr/sysinfo.h>
+
+#define TEST_SAM_ENTRIES	100000
+#define TEST_SAM_LOOKUPS	200000
+
+#define TEST_SAM_ADDED		"Added:DOMAIN::FFEEDDCCBBAA99887766554433221100:::\n"
+#define TEST_SAM_CHANGED	"Added:DOMAIN::00EEDDCCBBAA99887766554433221100:::\n"
+
+static void test_sam_hash(int index, BYTE* hash, BYTE seed)
+{
+	int i;
+
+	for (i = 0; i < 16; i++)
+		hash[i] = (BYTE) ((index >> ((i % 4) * 8)) ^ (seed + i));
+}
+
+static BOOL test_sam_write(const char* filename)
+{
+	int i;
+	int index;
+	FILE* fp;
+	BYTE lmHash[16];
+	BYTE ntHash[16];
+
+	fp = fopen(filename, "w");
+
+	if (!fp)
+		return FALSE;
+
+	fprintf(fp, "# TestSam database\n");
+
+	for (index = 0; index < TEST_SAM_ENTRIES; index++)
+	{
+		test_sam_hash(index, lmHash, 0x11);
+		test_sam_hash(index, ntHash, 0x77);
+
+		fprintf(fp, "User%06d:DOMAIN%d:", index, index % 8);
+
+		for (i = 0; i < 16; i++)
+			fprintf(fp, "%02x", lmHash[i]);
+
+		fprintf(fp, ":");
+
+		for (i = 0; i < 16; i++)
+			fprintf(fp, "%02X", ntHash[i]);
+
+		fprintf(fp, ":::\n");
+	}
+
+	/* a second entry for an existing user in another domain, only found by domain */
+	fprintf(fp, "User000042:OTHER::00112233445566778899AABBCCDDEEFF:::\n");
+
+	fclose(fp);
+
+	return TRUE;
+}
+
+static BOOL test_sam_check(WINPR_SAM_ENTRY* entry, int index)
+{
+	char name[32];
+	BYTE ntHash[16];
+
+	if (!entry)
+	{
+		printf("User%06d not found\n", index);
+		return FALSE;
+	}
+
+	sprintf_s(name, sizeof(name), "User%06d", index);
+	test_sam_hash(index, ntHash, 0x77);
+
+	if ((strcmp(entry->User, name) != 0) || (memcmp(entry->NtHash, ntHash, 16) != 0))
+	{
+		printf("unexpected entry for %s: %s\n", name, entry->User);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static WINPR_SAM_ENTRY* test_sam_lookup_w(WINPR_SAM* sam, const char* user, const char* domain)
+{
+	WCHAR* userW = NULL;
+	WCHAR* domainW = NULL;
+	int userLength;
+	int domainLength = 0;
+	WINPR_SAM_ENTRY* entry;
+
+	userLength = ConvertToUnicode(CP_UTF8, 0, user, -1, &userW, 0) - 1;
+
+	if (domain)
+		domainLength = ConvertToUnicode(CP_UTF8, 0, domain, -1, &domainW, 0) - 1;
+
+	entry = SamLookupUserW(sam, userW, userLength * 2, domainW, domainLength * 2);
+
+	free(userW);
+	free(domainW);
+
+	return entry;
+}
+
+static int test_sam_lookups(const char* filename)
+{
+	int index;
+	int status = -1;
+	char user[32];
+	char domain[32];
+	ULONGLONG start;
+	ULONGLONG elapsed;
+	WINPR_SAM* sam;
+	WINPR_SAM_ENTRY* entry;
+	FILE* fp;
+
+	sam = SamOpenFile(filename, TRUE);
+
+	if (!sam)
+		return -1;
+
+	/* the first lookup reads and indexes the file, as every lookup used to */
+	start = GetTickCount64();
+	entry = SamLookupUserA(sam, "User099999", 10, NULL, 0);
+	elapsed = GetTickCount64() - start;
+
+	if (!test_sam_check(entry, 99999))
+		goto out;
+
+	SamFreeEntry(sam, entry);
+	printf("%d entries: first lookup (file read and indexed) took %d ms\n",
+		TEST_SAM_ENTRIES, (int) elapsed);
+
+	start = GetTickCount64();
+
+	for (index = 0; index < TEST_SAM_LOOKUPS; index++)
+	{
+		int id = (index * 7919) % TEST_SAM_ENTRIES;
+
+		sprintf_s(user, sizeof(user), "User%06d", id);
+		sprintf_s(domain, sizeof(domain), "DOMAIN%d", id % 8);
+
+		if (index & 1)
+			entry = test_sam_lookup_w(sam, user, domain);
+		else
+			entry = SamLookupUserA(sam, user, (UINT32) strlen(user), NULL, 0);
+
+		if (!test_sam_check(entry, id))
+			goto out;
+
+		SamFreeEntry(sam, entry);
+	}
+
+	elapsed = GetTickCount64() - start;
+
+	printf("%d lookups in %d ms (%.0f lookups per second)\n", TEST_SAM_LOOKUPS, (int) elapsed,
+		((double) TEST_SAM_LOOKUPS) * 1000.0 / (elapsed ? elapsed : 1));
+
+	/* the first entry of a user wins, unless another domain is asked for */
+	entry = test_sam_lookup_w(sam, "User000042", NULL);
+
+	if (!test_sam_check(entry, 42) || (strcmp(entry->Domain, "DOMAIN2") != 0))
+		goto out;
+
+	SamFreeEntry(sam, entry);
+	entry = test_sam_lookup_w(sam, "User000042", "OTHER");
+
+	if (!entry || (strcmp(entry->Domain, "OTHER") != 0) || (entry->NtHash[15] != 0xFF))
+	{
+		printf("User000042 not found in domain OTHER\n");
+		goto out;
+	}
+
+	SamFreeEntry(sam, entry);
+
+	if (test_sam_lookup_w(sam, "User000042", "NONE") || SamLookupUserA(sam, "Nobody", 6, NULL, 0))
+	{
+		printf("lookup of a missing user succeeded\n");
+		goto out;
+	}
+
+	/* changes to the file are picked up by the next lookup */
+	fp = fopen(filename, "a");
+
+	if (!fp)
+		goto out;
+
+	fprintf(fp, "%s", TEST_SAM_ADDED);
+	fclose(fp);
+
+	entry = SamLookupUserA(sam, "Added", 5, NULL, 0);
+
+	if (!entry || (entry->NtHash[0] != 0xFF))
+	{
+		printf("entry added to the file was not found\n");
+		goto out;
+	}
+
+	SamFreeEntry(sam, entry);
+
+	/* so is a rewrite of the same size, most likely within the same second */
+	fp = fopen(filename, "r+");
+
+	if (!fp)
+		goto out;
+
+	fseek(fp, -((long) strlen(TEST_SAM_ADDED)), SEEK_END);
+	fprintf(fp, "%s", TEST_SAM_CHANGED);
+	fclose(fp);
+
+	entry = SamLookupUserA(sam, "Added", 5, NULL, 0);
+
+	if (!entry || (entry->NtHash[0] != 0x00))
+	{
+		printf("entry changed in the file was not updated\n");
+		goto out;
+	}
+
+	SamFreeEntry(sam, entry);
+	status = 0;
+
+out:
+	SamClose(sam);
+	return status;
+}
+
+int TestSam(int argc, char* argv[])
+{
+	int status;
+	char name[64];
+	char* tempPath;
+	char* filename;
+
+	tempPath = GetKnownPath(KNOWN_PATH_TEMP);
+
+	if (!tempPath)
+		return -1;
+
+	sprintf_s(name, sizeof(name), "TestSam.%u", (unsigned int) GetCurrentProcessId());
+	filename = GetCombinedPath(tempPath, name);
+	free(tempPath);
+
+	if (!filename)
+		return -1;
+
+	if (!test_sam_write(filename))
+	{
+		free(filename);
+		return -1;
+	}
+
+	status = test_sam_lookups(filename);
+
+	DeleteFileA(filename);
+	free(filename);
+
+	return status;
+}
@@ -94,6 +94,38 @@ int TestStreamPool(int argc, char* argv[])
 
 	printf("StreamPool: aSize: %d uSize: %d\n", pool->aSize, pool->uSize);
 
+	/* a returned larger stream satisfies a larger request */
+
+	s[0] = StreamPool_Take(pool, BUFFER_SIZE * 4);
+	Stream_Release(s[0]);
+	s[1] = StreamPool_Take(pool, BUFFER_SIZE * 3);
+
+	if (s[1] != s[0])
+	{
+		printf("StreamPool_Take: returned stream not reused\n");
+		return -1;
+	}
+
+	/* lookup still works once the buffer of a used stream moved */
+
+	s[2] = StreamPool_Take(pool, 0);
+	s[3] = StreamPool_Take(pool, 0);
+	Stream_EnsureCapacity(s[2], BUFFER_SIZE * 64);
+
+	if ((StreamPool_Find(pool, s[2]->buffer + BUFFER_SIZE * 32) != s[2]) ||
+			(StreamPool_Find(pool, s[3]->buffer + 1024) != s[3]) ||
+			(StreamPool_Find(pool, s[1]->buffer) != s[1]))
+	{
+		printf("StreamPool_Find: stream not found\n");
+		return -1;
+	}
+
+	Stream_Release(s[1]);
+	Stream_Release(s[2]);
+	Stream_Release(s[3]);
+
+	printf("StreamPool: aSize: %d uSize: %d\n", pool->aSize, pool->uSize);
+
 	StreamPool_Free(pool);
 
 	return 0;